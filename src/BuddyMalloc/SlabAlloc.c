@@ -0,0 +1,464 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    SlabAlloc.c
+ * \brief   Size-class slab allocator behind the preallocated pools.
+ *
+ * See SlabAlloc.h for the overall design.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "stuff_alloc.h"
+#include "SlabAlloc.h"
+#include "log_macros.h"
+
+#if !defined(_NO_BLOCK_PREALLOC) && !defined(_NO_BUDDY_SYSTEM) && !defined(_DEBUG_MEMLEAKS)
+
+/* The entries of a NUMA node, separated from the other nodes' ones by a cache line */
+typedef struct slab_depot
+{
+  pthread_mutex_t lock;
+  prealloc_header *free;        /* entries released on this node */
+  unsigned int count;           /* number of entries in free */
+  prealloc_header *remote;      /* entries released on other nodes, pushed without lock */
+} __attribute__ ((aligned(SLAB_ALIGN))) slab_depot_t;
+
+typedef struct slab_cache
+{
+  size_t entry_size;            /* size of an entry, header included */
+  constructor ctor;             /* constructor of the entries */
+  size_t slab_size;             /* size (and alignment) of a slab */
+  unsigned int nb_per_slab;     /* number of entries in a slab */
+  unsigned int nb_slabs;        /* number of slabs allocated */
+  slab_depot_t depot[SLAB_MAX_NODES];
+} slab_cache_t;
+
+/* At the beginning of each slab, entries follow */
+typedef struct slab_header
+{
+  slab_cache_t *cache;
+  unsigned int node;
+} __attribute__ ((aligned(SLAB_ALIGN))) slab_header_t;
+
+static pthread_mutex_t slab_registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static slab_cache_t *slab_caches[SLAB_MAX_CACHES];
+static unsigned int slab_nb_caches = 0;
+
+/**
+ *
+ * SlabCurrentNode: the NUMA node the calling thread runs on.
+ *
+ * The thread may be migrated right after: this only matters for performance.
+ *
+ * @return the index of the node's depot.
+ *
+ */
+static unsigned int SlabCurrentNode(void)
+{
+#ifdef SYS_getcpu
+  unsigned int cpu, node;
+
+  if(syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+    return node % SLAB_MAX_NODES;
+#endif
+
+  return 0;
+}                               /* SlabCurrentNode */
+
+/**
+ *
+ * SlabOf: the slab an entry was carved from.
+ *
+ * @param cache [IN] the slab cache of the entry
+ * @param h     [IN] the header of the entry
+ *
+ * @return the slab header.
+ *
+ */
+static inline slab_header_t *SlabOf(slab_cache_t * cache, prealloc_header * h)
+{
+  return (slab_header_t *) ((uintptr_t) h & ~(uintptr_t) (cache->slab_size - 1));
+}                               /* SlabOf */
+
+/**
+ *
+ * SlabCacheGet: gets the slab cache for a kind of entries.
+ *
+ * Pools whose entries have the same size class and constructor share a slab
+ * cache, so that an entry may be released to any of them.
+ *
+ * @param entry_size [IN] the size of an entry, without its pool header
+ * @param ctor       [IN] the constructor of the entries (or NULL)
+ *
+ * @return the slab cache, or NULL if none can be created (the pool then
+ * allocates its entries as without slab caches).
+ *
+ */
+slab_cache_t *SlabCacheGet(size_t entry_size, constructor ctor)
+{
+  slab_cache_t *cache = NULL;
+  size_t size;
+  unsigned int i;
+
+  size = (entry_size + size_prealloc_header64 + SLAB_ALIGN - 1) & ~(size_t) (SLAB_ALIGN - 1);
+
+  pthread_mutex_lock(&slab_registry_mutex);
+
+  for(i = 0; i < slab_nb_caches; i++)
+    if(slab_caches[i]->entry_size == size && slab_caches[i]->ctor == ctor)
+      {
+        cache = slab_caches[i];
+        break;
+      }
+
+  if(cache == NULL && slab_nb_caches < SLAB_MAX_CACHES &&
+     posix_memalign((void **)&cache, SLAB_ALIGN, sizeof(slab_cache_t)) == 0)
+    {
+      memset(cache, 0, sizeof(slab_cache_t));
+      cache->entry_size = size;
+      cache->ctor = ctor;
+
+      cache->slab_size = SLAB_SIZE_MIN;
+      while(cache->slab_size < sizeof(slab_header_t) + SLAB_MIN_ENTRIES * size)
+        cache->slab_size <<= 1;
+
+      cache->nb_per_slab = (cache->slab_size - sizeof(slab_header_t)) / size;
+
+      for(i = 0; i < SLAB_MAX_NODES; i++)
+        pthread_mutex_init(&cache->depot[i].lock, NULL);
+
+      slab_caches[slab_nb_caches++] = cache;
+    }
+  else if(cache == NULL)
+    LogMajor(COMPONENT_MEMALLOC,
+             "SlabCacheGet: no slab cache for entries of %llu bytes",
+             (unsigned long long)entry_size);
+
+  pthread_mutex_unlock(&slab_registry_mutex);
+
+  return cache;
+}                               /* SlabCacheGet */
+
+/**
+ *
+ * SlabGrow: allocates a new slab on the calling thread's node.
+ *
+ * The slab is zeroed, and its entries constructed, by the calling thread so
+ * that its pages are allocated on its node.
+ *
+ * @param cache [INOUT] the slab cache
+ * @param node  [IN]    the node of the calling thread
+ * @param ptail [OUT]   the last entry of the returned list
+ *
+ * @return the list of the new slab's entries, or NULL if out of memory.
+ *
+ */
+static prealloc_header *SlabGrow(slab_cache_t * cache, unsigned int node,
+                                 prealloc_header ** ptail)
+{
+  slab_header_t *slab = NULL;
+  prealloc_header *head = NULL;
+  prealloc_header *h;
+  char *mem;
+  unsigned int i;
+
+  if(posix_memalign((void **)&slab, cache->slab_size, cache->slab_size) != 0)
+    return NULL;
+
+  memset(slab, 0, cache->slab_size);
+  slab->cache = cache;
+  slab->node = node;
+
+  /* Chain them in address order */
+  mem = (char *)slab + sizeof(slab_header_t) + (cache->nb_per_slab - 1) * cache->entry_size;
+  *ptail = (prealloc_header *) mem;
+
+  for(i = 0; i < cache->nb_per_slab; i++, mem -= cache->entry_size)
+    {
+      h = (prealloc_header *) mem;
+      h->pa_next = head;
+      head = h;
+
+      if(cache->ctor != NULL)
+        cache->ctor(get_prealloc_entry(h, void));
+    }
+
+  __sync_fetch_and_add(&cache->nb_slabs, 1);
+
+  return head;
+}                               /* SlabGrow */
+
+/**
+ *
+ * SlabFillPool: refills an empty pool with pa_num entries.
+ *
+ * The entries come from the depot of the calling thread's node, whose remote-free
+ * queue is collected if its free list is short. New slabs are allocated only when
+ * the depot is empty.
+ *
+ * @param pool [INOUT] the pool
+ *
+ * @return nothing (void function), the pool is left empty if out of memory.
+ *
+ */
+void SlabFillPool(struct prealloc_pool *pool)
+{
+  slab_cache_t *cache = pool->pa_slab;
+  slab_depot_t *depot;
+  prealloc_header *head = NULL;
+  prealloc_header *tail = NULL;
+  prealloc_header *h;
+  unsigned int node;
+  int want = pool->pa_num;
+  int got = 0;
+
+  if(want <= 0)
+    return;
+
+  if(cache == NULL)
+    {
+      /* No slab cache for this pool, allocate a block as without them */
+      int size = pool->pa_size + size_prealloc_header64;
+      char *mem = (char *)Mem_Calloc(want, size);
+
+      if(mem == NULL)
+        return;
+
+      for(got = 0; got < want; got++, mem += size)
+        {
+          h = (prealloc_header *) mem;
+          h->pa_next = pool->pa_free;
+          pool->pa_free = h;
+          if(pool->pa_constructor != NULL)
+            pool->pa_constructor(get_prealloc_entry(h, void));
+        }
+
+      pool->pa_count += got;
+      pool->pa_allocated += got;
+      pool->pa_blocks++;
+      return;
+    }
+
+  node = SlabCurrentNode();
+  depot = &cache->depot[node];
+
+  pthread_mutex_lock(&depot->lock);
+
+  if(depot->count < (unsigned int)want && depot->remote != NULL)
+    {
+      /* Adopt what other nodes released */
+      h = __sync_lock_test_and_set(&depot->remote, NULL);
+      while(h != NULL)
+        {
+          prealloc_header *next = h->pa_next;
+
+          h->pa_next = depot->free;
+          depot->free = h;
+          depot->count++;
+          h = next;
+        }
+    }
+
+  while(got < want && depot->free != NULL)
+    {
+      h = depot->free;
+      depot->free = h->pa_next;
+      depot->count--;
+
+      h->pa_next = head;
+      head = h;
+      if(tail == NULL)
+        tail = h;
+      got++;
+    }
+
+  pthread_mutex_unlock(&depot->lock);
+
+  while(got < want)
+    {
+      prealloc_header *slab_head;
+      prealloc_header *slab_tail;
+      prealloc_header *rest = NULL;
+      unsigned int rest_count = 0;
+
+      if((slab_head = SlabGrow(cache, node, &slab_tail)) == NULL)
+        {
+          LogMajor(COMPONENT_MEMALLOC,
+                   "SlabFillPool: could not allocate a slab of %llu bytes",
+                   (unsigned long long)cache->slab_size);
+          break;
+        }
+
+      /* Take what is needed, the rest of the slab goes to the depot */
+      for(h = slab_head; h != NULL; h = rest)
+        {
+          rest = h->pa_next;
+          h->pa_next = head;
+          head = h;
+          if(tail == NULL)
+            tail = h;
+          if(++got == want)
+            break;
+        }
+
+      if(rest != NULL)
+        {
+          for(h = rest, rest_count = 1; h != slab_tail; h = h->pa_next)
+            rest_count++;
+
+          pthread_mutex_lock(&depot->lock);
+          slab_tail->pa_next = depot->free;
+          depot->free = rest;
+          depot->count += rest_count;
+          pthread_mutex_unlock(&depot->lock);
+        }
+    }
+
+  if(head != NULL)
+    {
+      tail->pa_next = pool->pa_free;
+      pool->pa_free = head;
+      pool->pa_count += got;
+      pool->pa_allocated += got;
+      pool->pa_blocks++;
+    }
+}                               /* SlabFillPool */
+
+/**
+ *
+ * SlabDrainPool: gives pa_num entries of a pool back to their slab cache.
+ *
+ * Called when a pool holds more than 2 * pa_num free entries. Each entry goes back
+ * to the depot of its slab's node: entries of the calling thread's node are put in
+ * its free list at once, the other ones are pushed to their node's remote-free queue.
+ *
+ * @param pool [INOUT] the pool
+ *
+ * @return nothing (void function).
+ *
+ */
+void SlabDrainPool(struct prealloc_pool *pool)
+{
+  slab_cache_t *cache = pool->pa_slab;
+  prealloc_header *heads[SLAB_MAX_NODES];
+  prealloc_header *tails[SLAB_MAX_NODES];
+  unsigned int counts[SLAB_MAX_NODES];
+  prealloc_header *h;
+  unsigned int node, home;
+  int nb;
+
+  if(cache == NULL || pool->pa_num <= 0)
+    return;
+
+  memset(heads, 0, sizeof(heads));
+  memset(counts, 0, sizeof(counts));
+
+  for(nb = 0; nb < pool->pa_num && pool->pa_free != NULL; nb++)
+    {
+      h = pool->pa_free;
+      pool->pa_free = h->pa_next;
+
+      home = SlabOf(cache, h)->node;
+      if(heads[home] == NULL)
+        tails[home] = h;
+      h->pa_next = heads[home];
+      heads[home] = h;
+      counts[home]++;
+    }
+
+  pool->pa_count -= nb;
+  pool->pa_allocated -= nb;
+
+  node = SlabCurrentNode();
+
+  for(home = 0; home < SLAB_MAX_NODES; home++)
+    {
+      slab_depot_t *depot = &cache->depot[home];
+
+      if(heads[home] == NULL)
+        continue;
+
+      if(home == node)
+        {
+          pthread_mutex_lock(&depot->lock);
+          tails[home]->pa_next = depot->free;
+          depot->free = heads[home];
+          depot->count += counts[home];
+          pthread_mutex_unlock(&depot->lock);
+        }
+      else
+        {
+          /* Only whole lists are ever taken from the queue, so there is no ABA issue */
+          do
+            {
+              h = depot->remote;
+              tails[home]->pa_next = h;
+            }
+          while(!__sync_bool_compare_and_swap(&depot->remote, h, heads[home]));
+        }
+    }
+}                               /* SlabDrainPool */
+
+/**
+ *
+ * SlabDumpMem: prints the state of the slab caches.
+ *
+ * @param output [IN] the stream to print to
+ *
+ * @return nothing (void function).
+ *
+ */
+void SlabDumpMem(FILE * output)
+{
+  unsigned int i, node;
+  unsigned int depot_count;
+
+  pthread_mutex_lock(&slab_registry_mutex);
+
+  fprintf(output, "%-12s %-12s %-12s %-12s %-12s\n", "entry size", "ctor", "slab size",
+          "slabs", "in depots");
+
+  for(i = 0; i < slab_nb_caches; i++)
+    {
+      for(depot_count = 0, node = 0; node < SLAB_MAX_NODES; node++)
+        depot_count += slab_caches[i]->depot[node].count;
+
+      fprintf(output, "%-12llu %-12p %-12llu %-12u %-12u\n",
+              (unsigned long long)slab_caches[i]->entry_size, slab_caches[i]->ctor,
+              (unsigned long long)slab_caches[i]->slab_size,
+              slab_caches[i]->nb_slabs, depot_count);
+    }
+
+  pthread_mutex_unlock(&slab_registry_mutex);
+}                               /* SlabDumpMem */
+
+#endif
@@ -27,6 +27,7 @@
 #endif
 
 #include "BuddyMalloc.h"
+#include "stuff_alloc.h"
 #include <pthread.h>
 #include "log_macros.h"
 #include <errno.h>
@@ -1224,6 +1225,223 @@ void *TESTB(void *arg)
 
 }
 
+/* Entries of the size of the objects the server keeps in pools */
+#define ENTRY_SIZE 400
+#define ENTRY_MAGIC 0x50BA110C
+
+typedef struct pool_entry
+{
+  unsigned int magic;
+  unsigned int owner;
+  unsigned int seq;
+  char data[ENTRY_SIZE - 3 * sizeof(unsigned int)];
+} pool_entry_t;
+
+#define NB_LOOPC  100000
+#define NB_BATCHC 32
+
+/* TESTC:
+ * GetFromPool/ReleaseToPool loop compared to the same BuddyMalloc/BuddyFree loop.
+ */
+void *TESTC(void *arg)
+{
+
+  int th = (long)arg;
+  int i, j, rc;
+  struct prealloc_pool pool;
+  pool_entry_t *entries[NB_BATCHC];
+  caddr_t blocks[NB_BATCHC];
+  struct timeval tv1, tv2, tv3;
+
+  LogTest("%d:BuddyInit(%llu)=%d",
+          th, MEM_SIZE, rc = BuddyInit(&parameter));
+
+  if(rc)
+    exit(1);
+
+  MakePool(&pool, NB_BATCHC, pool_entry_t, NULL, NULL);
+
+  if(!IsPoolPreallocated(&pool))
+    {
+      LogTest("%d:**** NOT ENOUGH MEMORY TO PREALLOCATE %d entries *****",
+              th, NB_BATCHC);
+      exit(1);
+    }
+
+  gettimeofday(&tv1, NULL);
+
+  for(i = 0; i < NB_LOOPC; i++)
+    {
+      for(j = 0; j < NB_BATCHC; j++)
+        {
+          GetFromPool(entries[j], &pool, pool_entry_t);
+
+          if(entries[j] == NULL)
+            {
+              LogTest("%d:**** NOT ENOUGH MEMORY TO GET AN ENTRY *****", th);
+              exit(1);
+            }
+
+          entries[j]->owner = th;
+          entries[j]->seq = i;
+        }
+
+      for(j = 0; j < NB_BATCHC; j++)
+        {
+          if(entries[j]->owner != th || entries[j]->seq != i)
+            LogTest("************ INTEGRITY ERROR !!! ************");
+
+          ReleaseToPool(entries[j], &pool);
+        }
+    }
+
+  gettimeofday(&tv2, NULL);
+  tv3 = time_diff(tv1, tv2);
+
+  LogTest("%d: %d GetFromPool/ReleaseToPool of %d bytes in %lu.%.6lu s",
+          th, NB_LOOPC * NB_BATCHC, (int)sizeof(pool_entry_t), tv3.tv_sec, tv3.tv_usec);
+
+  gettimeofday(&tv1, NULL);
+
+  for(i = 0; i < NB_LOOPC; i++)
+    {
+      for(j = 0; j < NB_BATCHC; j++)
+        {
+          if((blocks[j] = BuddyMalloc(sizeof(pool_entry_t))) == NULL)
+            {
+              LogTest("%d:**** NOT ENOUGH MEMORY TO ALLOCATE %d : %d *****",
+                      th, (int)sizeof(pool_entry_t), BuddyErrno);
+              exit(1);
+            }
+
+          ((pool_entry_t *) blocks[j])->owner = th;
+        }
+
+      for(j = 0; j < NB_BATCHC; j++)
+        BuddyFree(blocks[j]);
+    }
+
+  gettimeofday(&tv2, NULL);
+  tv3 = time_diff(tv1, tv2);
+
+  LogTest("%d: %d BuddyMalloc/BuddyFree of %d bytes in %lu.%.6lu s",
+          th, NB_LOOPC * NB_BATCHC, (int)sizeof(pool_entry_t), tv3.tv_sec, tv3.tv_usec);
+
+  /* The pool's entries are not given back, so BuddyDestroy is not called */
+
+  return NULL;
+
+}
+
+#define NB_ITEMD  1024
+#define NB_LOOPD  200000
+
+pthread_mutex_t testD_mutex = PTHREAD_MUTEX_INITIALIZER;
+pool_entry_t *tab_entries_testD[NB_ITEMD];
+caddr_t tab_blocks_testD[NB_ITEMD];
+
+/* TESTD:
+ * like TESTA, entries are got by a thread and released by another one, which
+ * releases them to its own pool: they have to go back to their slab cache.
+ * The same is then done with BuddyMalloc/BuddyFree.
+ */
+void *TESTD(void *arg)
+{
+
+  int th = (long)arg;
+  int nloop, rc;
+  unsigned int slot;
+  struct prealloc_pool pool;
+  pool_entry_t *pentry;
+  struct timeval tv1, tv2, tv3;
+
+  LogTest("%d:BuddyInit(%llu)=%d",
+          th, MEM_SIZE, rc = BuddyInit(&parameter));
+
+  if(rc)
+    exit(1);
+
+  MakePool(&pool, NB_BATCHC, pool_entry_t, NULL, NULL);
+
+  gettimeofday(&tv1, NULL);
+
+  for(nloop = 0; nloop < NB_LOOPD; nloop++)
+    {
+      slot = (unsigned int)my_rand() % NB_ITEMD;
+
+      P(testD_mutex);
+
+      if(tab_entries_testD[slot] == NULL)
+        {
+          GetFromPool(pentry, &pool, pool_entry_t);
+
+          if(pentry == NULL)
+            {
+              LogTest("%d:**** NOT ENOUGH MEMORY TO GET AN ENTRY *****", th);
+              exit(1);
+            }
+
+          pentry->magic = ENTRY_MAGIC;
+          pentry->owner = th;
+          tab_entries_testD[slot] = pentry;
+        }
+      else
+        {
+          pentry = tab_entries_testD[slot];
+          tab_entries_testD[slot] = NULL;
+
+          if(pentry->magic != ENTRY_MAGIC)
+            LogTest("************ INTEGRITY ERROR !!! ************");
+
+          pentry->magic = 0;
+          ReleaseToPool(pentry, &pool);
+        }
+
+      V(testD_mutex);
+    }
+
+  gettimeofday(&tv2, NULL);
+  tv3 = time_diff(tv1, tv2);
+
+  LogTest("%d: %d shared GetFromPool/ReleaseToPool in %lu.%.6lu s",
+          th, NB_LOOPD, tv3.tv_sec, tv3.tv_usec);
+
+  gettimeofday(&tv1, NULL);
+
+  for(nloop = 0; nloop < NB_LOOPD; nloop++)
+    {
+      slot = (unsigned int)my_rand() % NB_ITEMD;
+
+      P(testD_mutex);
+
+      if(tab_blocks_testD[slot] == NULL)
+        {
+          if((tab_blocks_testD[slot] = BuddyMalloc(sizeof(pool_entry_t))) == NULL)
+            {
+              LogTest("%d:**** NOT ENOUGH MEMORY TO ALLOCATE %d : %d *****",
+                      th, (int)sizeof(pool_entry_t), BuddyErrno);
+              exit(1);
+            }
+        }
+      else
+        {
+          BuddyFree(tab_blocks_testD[slot]);
+          tab_blocks_testD[slot] = NULL;
+        }
+
+      V(testD_mutex);
+    }
+
+  gettimeofday(&tv2, NULL);
+  tv3 = time_diff(tv1, tv2);
+
+  LogTest("%d: %d shared BuddyMalloc/BuddyFree in %lu.%.6lu s",
+          th, NB_LOOPD, tv3.tv_sec, tv3.tv_usec);
+
+  return NULL;
+
+}
+
 static char usage[] =
     "Usage :\n"
     "\ttest_buddy <test_name>\n\n"
@@ -1238,7 +1456,9 @@ static char usage[] =
     "\t\t8[mt] : garbage collection stats (mt: multithreaded test)\n"
     "\t\t9[mt] : debug labels (mt: multithreaded test)\n"
     "\t\tA     : multithreaded alloc/free on shared memory segments\n"
-    "\t\tB[mt] : memory corruption tests\n";
+    "\t\tB[mt] : memory corruption tests\n"
+    "\t\tC[mt] : performance test for pools compared to malloc/free (mt: multithreaded test)\n"
+    "\t\tDmt   : multithreaded pool get/release on shared entries, compared to malloc/free\n";
 
 /* Multithread launch macro */
 #define LAUNCH_THREADS( _function_ , _nb_threads_ ) do {\
@@ -1309,6 +1529,9 @@ int main(int argc, char **argv)
   else if(!strcmp(argv[1], "B"))
     TESTB(0);
 
+  else if(!strcmp(argv[1], "C"))
+    TESTC(0);
+
   else if(!strcmp(argv[1], "1mt"))
     LAUNCH_THREADS(TEST1, NB_THREADS);
 
@@ -1349,6 +1572,12 @@ int main(int argc, char **argv)
   else if(!strcmp(argv[1], "Bmt"))
     LAUNCH_THREADS(TESTB, NB_THREADS);
 
+  else if(!strcmp(argv[1], "Cmt"))
+    LAUNCH_THREADS(TESTC, NB_THREADS);
+
+  else if(!strcmp(argv[1], "Dmt"))
+    LAUNCH_THREADS(TESTD, NB_THREADS);
+
   else
     {
       LogTest("***** Unknown test: \"%s\" ******", argv[1]);
@@ -0,0 +1,7 @@
+#!/bin/sh
+##
+## test_buddy_C.sh
+## pool performance tests
+##
+
+./test_buddy C
@@ -0,0 +1,7 @@
+#!/bin/sh
+##
+## test_buddy_Cmt.sh
+## pool performance tests (multithreaded test)
+##
+
+./test_buddy Cmt
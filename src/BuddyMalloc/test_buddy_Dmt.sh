@@ -0,0 +1,7 @@
+#!/bin/sh
+##
+## test_buddy_Dmt.sh
+## pool get/release on shared entries (multithreaded test)
+##
+
+./test_buddy Dmt
@@ -98,6 +98,24 @@ cache_inode_access_sw(cache_entry_t * pentry,
     pclient->stat.nb_call_total += 1;
     inc_func_call(pclient, CACHE_INODE_ACCESS);
 
+    /*
+     * Access tested against the cached attributes of an entry already
+     * validated during this second needs no lock. Errors go through the
+     * locked path, which reports them.
+     */
+    if(use_mutex && access_type != FSAL_F_OK && pclient->use_test_access == 1 &&
+       cache_inode_valid_uptodate(pentry, time(NULL)) &&
+       cache_inode_get_attributes_lockless(pentry, &attr) == 0)
+        {
+            fsal_status = FSAL_test_access(pcontext, access_type & ~FSAL_F_OK, &attr);
+            if(!FSAL_IS_ERROR(fsal_status))
+                {
+                    pclient->call_since_last_gc += 1;
+                    inc_func_success(pclient, CACHE_INODE_ACCESS);
+                    return *pstatus;
+                }
+        }
+
     if(use_mutex)
         P_r(&pentry->lock);
     /*
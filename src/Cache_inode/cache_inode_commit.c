@@ -63,7 +63,8 @@
  *
  * cache_inode_commit: commits a write operation on unstable storage
  *
- * Reads/Writes through the cache layer.
+ * Writes the data buffered in the Ganesha write buffer within [offset, offset+count)
+ * to the FSAL (count 0 meaning the whole file), then syncs the file.
  *
  * @param pentry [IN] entry in cache inode layer whose content is to be accessed.
  * @param read_or_write [IN] a flag of type cache_content_io_direction_t to tell if a read or write is to be done.
@@ -95,10 +96,6 @@ cache_inode_commit(cache_entry_t * pentry,
                    cache_inode_status_t * pstatus)
 {
     cache_inode_status_t status;
-    fsal_seek_t seek_descriptor;
-    fsal_size_t size_io_done;
-    fsal_boolean_t eof;
-    cache_inode_unstable_data_t *udata;
     fsal_status_t fsal_status;
 
     /* Do not use this function is Data Cache is used */
@@ -108,126 +105,87 @@ cache_inode_commit(cache_entry_t * pentry,
             return *pstatus;
      }
 
-    /* If we aren't using the Ganesha write buffer, then we're using the filesystem
-     * write buffer so execute a normal fsal_sync() call. */
-    if (typeofcommit == FSAL_UNSAFE_WRITE_TO_FS_BUFFER)
-    {
+    P_w(&pentry->lock);
 
-      P_w(&pentry->lock);
+    /* If we're using the Ganesha write buffer, the dirty extents in the range
+     * are written first, then synced like the writes to the filesystem buffer. */
+    if(typeofcommit == FSAL_UNSAFE_WRITE_TO_GANESHA_BUFFER &&
+       pentry->object.file.unstable_data != NULL)
+      {
+        /* Count = 0 means "flush all data to permanent storage */
+        if(count == 0xFFFFFFFFL)
+          count = 0;
 
-      /* Can't sync a file descriptor if it's currently closed. */
-      if(cache_inode_open(pentry,
-                          pclient,
-                          FSAL_O_WRONLY, pcontext, pstatus) != CACHE_INODE_SUCCESS)
-        {
+        if(cache_inode_unstable_flush(pentry, offset, count, pclient, pcontext,
+                                      pstatus) != CACHE_INODE_SUCCESS)
+          {
+            V_w(&pentry->lock);
 
-          V_w(&pentry->lock);
-          
-          /* stats */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_COMMIT] += 1;
-          
-          return *pstatus;
-        }
+            /* stats */
+            pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_COMMIT] += 1;
 
-#ifdef _USE_MFSL      
-      fsal_status = MFSL_sync(&(pentry->object.file.open_fd.mfsl_fd), NULL); 
-#else
-      fsal_status = FSAL_sync(&(pentry->object.file.open_fd.fd));
-#endif
-      if(FSAL_IS_ERROR(fsal_status))
-      {
-        LogMajor(COMPONENT_CACHE_INODE,
-                 "cache_inode_rdwr: fsal_sync() failed: fsal_status.major = %d",
-                 fsal_status.major);
+            return *pstatus;
+          }
+      }
 
-      /* Close the fd that we just opened before the FSAL_sync(). We are already
-       * replying with an error. No need to catch an additional error form 
-       * a close? */
-         cache_inode_close(pentry, pclient, &status);
+    /* Can't sync a file descriptor if it's currently closed. */
+    if(cache_inode_open(pentry,
+                        pclient,
+                        FSAL_O_WRONLY, pcontext, pstatus) != CACHE_INODE_SUCCESS)
+      {
 
         V_w(&pentry->lock);
 
         /* stats */
         pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_COMMIT] += 1;
 
-        *pstatus = CACHE_INODE_FSAL_ERROR;
         return *pstatus;
       }
-      *pstatus = CACHE_INODE_SUCCESS;
-
-      /* Close the fd that we just opened before the FSAL_sync() */
-      if(cache_inode_close(pentry, pclient, pstatus) != CACHE_INODE_SUCCESS)
-        {
-          LogEvent(COMPONENT_CACHE_INODE,
-                   "cache_inode_rdwr: cache_inode_close = %d",
-                   *pstatus);
-          
-          V_w(&pentry->lock);
-          
-          /* stats */
-          pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_COMMIT] += 1;
-          
-          return *pstatus;
-        }
-
-      V_w(&pentry->lock);      
+
+#ifdef _USE_MFSL      
+    fsal_status = MFSL_sync(&(pentry->object.file.open_fd.mfsl_fd), NULL); 
+#else
+    fsal_status = FSAL_sync(&(pentry->object.file.open_fd.fd));
+#endif
+    if(FSAL_IS_ERROR(fsal_status))
+    {
+      LogMajor(COMPONENT_CACHE_INODE,
+               "cache_inode_rdwr: fsal_sync() failed: fsal_status.major = %d",
+               fsal_status.major);
+
+    /* Close the fd that we just opened before the FSAL_sync(). We are already
+     * replying with an error. No need to catch an additional error form 
+     * a close? */
+       cache_inode_close(pentry, pclient, &status);
+
+      V_w(&pentry->lock);
+
+      /* stats */
+      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_COMMIT] += 1;
+
+      *pstatus = CACHE_INODE_FSAL_ERROR;
       return *pstatus;
     }
+    *pstatus = CACHE_INODE_SUCCESS;
 
-    /* Ok, it looks like we're using the Ganesha write buffer. This means we
-     * will either be writing to the buffer, or writing a stable write to the
-     * file system if the buffer is already full. */
+    /* Close the fd that we just opened before the FSAL_sync() */
+    if(cache_inode_close(pentry, pclient, pstatus) != CACHE_INODE_SUCCESS)
+      {
+        LogEvent(COMPONENT_CACHE_INODE,
+                 "cache_inode_rdwr: cache_inode_close = %d",
+                 *pstatus);
 
-    udata = &pentry->object.file.unstable_data;
-    if(udata->buffer == NULL)
-        {
-            *pstatus = CACHE_INODE_SUCCESS;
-            return *pstatus;
-        }
-    if(count == 0 || count == 0xFFFFFFFFL)
-        {
-            /* Count = 0 means "flush all data to permanent storage */
-            seek_descriptor.offset = udata->offset;
-            seek_descriptor.whence = FSAL_SEEK_SET;
-
-            status = cache_inode_rdwr(pentry,
-                                      CACHE_INODE_WRITE,
-                                      &seek_descriptor, udata->length,
-                                      &size_io_done, pfsal_attr,
-                                      udata->buffer, &eof, ht,
-                                      pclient, pcontext, TRUE, pstatus);
-            if (status != CACHE_INODE_SUCCESS)
-                return *pstatus;
-
-            P_w(&pentry->lock);
-
-            Mem_Free(udata->buffer);
-            udata->buffer = NULL;
+        V_w(&pentry->lock);
 
-            V_w(&pentry->lock);
-        }
-    else
-        {
-            if(offset < udata->offset)
-                {
-                    *pstatus = CACHE_INODE_INVALID_ARGUMENT;
-                    return *pstatus;
-                }
-
-            seek_descriptor.offset = offset;
-            seek_descriptor.whence = FSAL_SEEK_SET;
-
-            return cache_inode_rdwr(pentry,
-                                    CACHE_INODE_WRITE,
-                                    &seek_descriptor,
-                                    count,
-                                    &size_io_done,
-                                    pfsal_attr,
-                                    (char *)(udata->buffer + offset - udata->offset),
-                                    &eof, ht, pclient,
-                                    pcontext, TRUE, pstatus);
-    }
-  /* Regulat exit */
-  *pstatus = CACHE_INODE_SUCCESS;
-  return *pstatus;
+        /* stats */
+        pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_COMMIT] += 1;
+
+        return *pstatus;
+      }
+
+    if(pfsal_attr != NULL)
+      *pfsal_attr = pentry->object.file.attributes;
+
+    V_w(&pentry->lock);
+    return *pstatus;
 }
@@ -28,9 +28,23 @@
  * \author  $Author: deniel $
  * \date    $Date: 2005/12/20 10:51:49 $
  * \version $Revision: 1.21 $
- * \brief   Do garbage collection on a cache inode client.
+ * \brief   Do garbage collection on the cache inode.
  *
- * cache_inode_gc.c: do garbage collection on a cache inode client.
+ * cache_inode_gc.c: do garbage collection on the cache inode.
+ *
+ * The entries that may be garbaged (regular files, symbolic links and
+ * directories) are kept in CACHE_INODE_GC_NB_SHARDS rings, each one with its
+ * own lock, the ring of an entry depending on its address. The rings are swept
+ * by a clock hand (a generalized CLOCK): each access to an entry increments its
+ * reference counter up to CACHE_INODE_GC_MAX_REF, the hand decrements it when
+ * it passes over the entry, and an entry is reclaimed when the hand finds it
+ * with no reference left. Entries accessed often survive several rotations of
+ * the hand, entries accessed once are reclaimed at the next one.
+ *
+ * Reclaiming is made by the garbage collector thread, a few entries at a time,
+ * when the cache is above its high water mark. The memory of a reclaimed entry
+ * is given back to the client it was allocated by, through its gc_recycle
+ * queue, since the prealloc pools are per client.
  *
  */
 #ifdef HAVE_CONFIG_H
@@ -50,15 +64,29 @@
 #include "cache_inode.h"
 #include "stuff_alloc.h"
 #include "nfs4_acls.h"
+#include "mpmc_queue.h"
 
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/param.h>
 #include <time.h>
+#include <string.h>
 #include <pthread.h>
 
 static cache_inode_gc_policy_t cache_inode_gc_policy;   /*<< the policy to be used by the garbage collector */
 
+typedef struct cache_inode_gc_shard__
+{
+  pthread_mutex_t lock;         /**< protects the ring, the hand and the state of its entries */
+  cache_entry_t *hand;          /**< next entry to be examined, NULL if the ring is empty      */
+  unsigned int nb_entries;      /**< number of entries in the ring                             */
+  char pad[MPMC_CACHE_LINE];
+} cache_inode_gc_shard_t;
+
+static cache_inode_gc_shard_t cache_inode_gc_shards[CACHE_INODE_GC_NB_SHARDS];
+static unsigned int cache_inode_gc_next_shard = 0;
+static cache_inode_gc_stat_t cache_inode_gc_stat;
+
 #ifdef _USE_NFS4_ACL
 static void cache_inode_gc_acl(cache_entry_t * pentry);
 #endif                          /* _USE_NFS4_ACL */
@@ -71,6 +99,136 @@ static void cache_inode_gc_acl(cache_entry_t * pentry);
  * @{
  */
 
+/**
+ *
+ * cache_inode_gc_shard_of: gets the GC shard of an entry.
+ *
+ * @param pentry [IN] the entry.
+ *
+ * @return the shard whose ring holds (or will hold) the entry.
+ *
+ */
+static cache_inode_gc_shard_t *cache_inode_gc_shard_of(cache_entry_t * pentry)
+{
+  unsigned long h = (unsigned long)pentry;
+
+  /* The low bits of an entry address are the same for every entry of a pool */
+  h = (h >> 6) * 2654435761UL;
+
+  return &cache_inode_gc_shards[(h >> 16) & (CACHE_INODE_GC_NB_SHARDS - 1)];
+}                               /* cache_inode_gc_shard_of */
+
+/**
+ *
+ * cache_inode_gc_link: puts an entry in the ring of its shard, behind the hand.
+ *
+ * /!\ the shard is supposed to be locked.
+ *
+ * @param pshard [INOUT] the shard of the entry.
+ * @param pentry [INOUT] the entry to be linked.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void cache_inode_gc_link(cache_inode_gc_shard_t * pshard, cache_entry_t * pentry)
+{
+  if(pshard->hand == NULL)
+    {
+      pentry->gc_node.prev = pentry;
+      pentry->gc_node.next = pentry;
+      pshard->hand = pentry;
+    }
+  else
+    {
+      /* The last entry to be examined by the hand is the newest one */
+      pentry->gc_node.next = pshard->hand;
+      pentry->gc_node.prev = pshard->hand->gc_node.prev;
+      pentry->gc_node.prev->gc_node.next = pentry;
+      pshard->hand->gc_node.prev = pentry;
+    }
+
+  pentry->gc_node.state = CACHE_INODE_GC_RINGED;
+  pshard->nb_entries += 1;
+}                               /* cache_inode_gc_link */
+
+/**
+ *
+ * cache_inode_gc_unlink: removes an entry from the ring of its shard.
+ *
+ * /!\ the shard is supposed to be locked, and the entry to be in its ring.
+ *
+ * @param pshard [INOUT] the shard of the entry.
+ * @param pentry [INOUT] the entry to be unlinked.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void cache_inode_gc_unlink(cache_inode_gc_shard_t * pshard, cache_entry_t * pentry)
+{
+  if(pentry->gc_node.next == pentry)
+    pshard->hand = NULL;
+  else
+    {
+      if(pshard->hand == pentry)
+        pshard->hand = pentry->gc_node.next;
+
+      pentry->gc_node.prev->gc_node.next = pentry->gc_node.next;
+      pentry->gc_node.next->gc_node.prev = pentry->gc_node.prev;
+    }
+
+  pentry->gc_node.prev = NULL;
+  pentry->gc_node.next = NULL;
+  pshard->nb_entries -= 1;
+}                               /* cache_inode_gc_unlink */
+
+/**
+ *
+ * cache_inode_gc_release_entry: puts a reclaimed entry back in the pools of a client.
+ *
+ * The entry has already been removed from the hash table, only its memory is
+ * still to be released: the entry itself, its hash key, its parent list and
+ * its dirent data.
+ *
+ * @param pentry  [INOUT] the reclaimed entry.
+ * @param pclient [INOUT] the client whose pools get the memory.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void cache_inode_gc_release_entry(cache_entry_t * pentry,
+                                         cache_inode_client_t * pclient)
+{
+  cache_inode_parent_entry_t *parent_iter = NULL;
+  cache_inode_parent_entry_t *parent_iter_next = NULL;
+  hash_buffer_t old_key;
+
+  /* Release the hash key data */
+  old_key.pdata = pentry->gc_node.recycle_key;
+  old_key.len = sizeof(cache_inode_fsal_data_t);
+  cache_inode_release_fsaldata_key(&old_key, pclient);
+
+  /* Recover the parent list entries */
+  parent_iter = pentry->parent_list;
+  while(parent_iter != NULL)
+    {
+      parent_iter_next = parent_iter->next_parent;
+
+      ReleaseToPool(parent_iter, &pclient->pool_parent);
+
+      parent_iter = parent_iter_next;
+    }
+
+  /* If entry is a DIR_CONTINUE or a DIR_BEGINNING, release pdir_data */
+  if(pentry->internal_md.type == DIR_BEGINNING)
+    ReleaseToPool(pentry->object.dir_begin.pdir_data, &pclient->pool_dir_data);
+
+  if(pentry->internal_md.type == DIR_CONTINUE)
+    ReleaseToPool(pentry->object.dir_cont.pdir_data, &pclient->pool_dir_data);
+
+  /* Put the pentry back to the pool */
+  ReleaseToPool(pentry, &pclient->pool_entry);
+}                               /* cache_inode_gc_release_entry */
+
 /**
  *
  * cache_inode_gc_clean_entry: cleans a entry in the cache_inode.
@@ -87,8 +245,7 @@ static int cache_inode_gc_clean_entry(cache_entry_t * pentry,
                                       cache_inode_param_gc_t * pgcparam)
 {
   fsal_handle_t *pfsal_handle = NULL;
-  cache_inode_parent_entry_t *parent_iter = NULL;
-  cache_inode_parent_entry_t *parent_iter_next = NULL;
+  cache_inode_client_t *powner = NULL;
   cache_inode_fsal_data_t fsaldata;
   cache_inode_status_t status;
   fsal_status_t fsal_status;
@@ -101,11 +258,10 @@ static int cache_inode_gc_clean_entry(cache_entry_t * pentry,
                pentry, pentry->internal_md.type);
 
   /* sanity check */
-  if((pentry->gc_lru_entry != NULL) &&
-     ((cache_entry_t *) pentry->gc_lru_entry->buffdata.pdata) != pentry)
+  if(pentry->gc_node.state == CACHE_INODE_GC_RINGED)
     {
       LogCrit(COMPONENT_CACHE_INODE_GC,
-              "cache_inode_gc_clean_entry: LRU entry pointed by this pentry doesn't match the GC LRU");
+              "cache_inode_gc_clean_entry: pentry %p is still in a GC ring", pentry);
     }
 
   /* Get the FSAL handle */
@@ -167,9 +323,6 @@ static int cache_inode_gc_clean_entry(cache_entry_t * pentry,
   LogFullDebug(COMPONENT_CACHE_INODE_GC,
                "++++> pentry %p deleted from HashTable", pentry);
 
-  /* Release the hash key data */
-  cache_inode_release_fsaldata_key(&old_key, pgcparam->pclient);
-
   /* Sanity check: old_value.pdata is expected to be equal to pentry,
    * and is released later in this function */
   if((cache_entry_t *) old_value.pdata != pentry)
@@ -181,34 +334,8 @@ static int cache_inode_gc_clean_entry(cache_entry_t * pentry,
 
   cache_inode_release_fsaldata_key(&key, pgcparam->pclient);
 
-  /* Recover the parent list entries */
-  parent_iter = pentry->parent_list;
-  while(parent_iter != NULL)
-    {
-      parent_iter_next = parent_iter->next_parent;
-
-      ReleaseToPool(parent_iter, &pgcparam->pclient->pool_parent);
-
-      parent_iter = parent_iter_next;
-    }
-
-  LogFullDebug(COMPONENT_CACHE_INODE_GC,
-               "++++> parent directory sent back to pool");
-
-  /* If entry is a DIR_CONTINUE or a DIR_BEGINNING, release pdir_data */
   if(pentry->internal_md.type == DIR_BEGINNING)
-    {
-      /* Put the pentry back to the pool */
-      ReleaseToPool(pentry->object.dir_begin.pdir_data, &pgcparam->pclient->pool_dir_data);
-    }
-
-  if(pentry->internal_md.type == DIR_CONTINUE)
-    {
-      /* Put the pentry back to the pool */
-      ReleaseToPool(pentry->object.dir_cont.pdir_data, &pgcparam->pclient->pool_dir_data);
-    }
-  LogFullDebug(COMPONENT_CACHE_INODE_GC,
-               "++++> pdir_data (if needed) sent back to pool");
+    cache_inode_dirent_index_release(pentry);
 
 #ifdef _USE_NFS4_ACL
   /* If entry has NFS4 ACL, release it. */
@@ -220,11 +347,30 @@ static int cache_inode_gc_clean_entry(cache_entry_t * pentry,
 
   cache_inode_mutex_destroy(pentry);
 
-  /* Put the pentry back to the pool */
-  ReleaseToPool(pentry, &pgcparam->pclient->pool_entry);
+  /* The memory goes back to the pools of the client that allocated it. The owner
+   * does the release itself when it is not the caller, the pools having no lock */
+  pentry->gc_node.recycle_key = old_key.pdata;
+  powner = pentry->gc_node.powner;
+
+  if(powner != NULL && powner != pgcparam->pclient &&
+     mpmc_queue_push(&powner->gc_recycle, pentry) == 0)
+    {
+      (void)__sync_fetch_and_add(&cache_inode_gc_stat.nb_recycled, 1);
+
+      LogFullDebug(COMPONENT_CACHE_INODE_GC,
+                   "++++> pentry %p given back to its owner", pentry);
+    }
+  else
+    {
+      cache_inode_gc_release_entry(pentry, pgcparam->pclient);
+
+      LogFullDebug(COMPONENT_CACHE_INODE_GC,
+                   "++++> pentry %p sent back to pool", pentry);
+    }
 
   /* Regular exit */
-  pgcparam->nb_to_be_purged = pgcparam->nb_to_be_purged - 1;
+  if(pgcparam->nb_to_be_purged > 0)
+    pgcparam->nb_to_be_purged = pgcparam->nb_to_be_purged - 1;
 
   LogFullDebug(COMPONENT_CACHE_INODE_GC,
                "++++> pentry %p: clean entry is ok", pentry);
@@ -248,6 +394,7 @@ static int cache_inode_gc_invalidate_related_dirent(cache_entry_t * pentry,
                                                     cache_inode_param_gc_t * pgcparam)
 {
   cache_inode_parent_entry_t *parent_iter = NULL;
+  cache_entry_t *pentry_dir = NULL;
 
   /* Set the cache status as INVALID in the directory entries */
   for(parent_iter = pentry->parent_list; parent_iter != NULL;
@@ -262,62 +409,41 @@ static int cache_inode_gc_invalidate_related_dirent(cache_entry_t * pentry,
         }
 
       /* If I reached this point, then parent_iter->parent is not null and is a valid cache_inode pentry */
-      P_w(&parent_iter->parent->lock);
-
       /* Check for type of the parent */
       if(parent_iter->parent->internal_md.type != DIR_BEGINNING &&
          parent_iter->parent->internal_md.type != DIR_CONTINUE)
         {
-          V_w(&parent_iter->parent->lock);
           /* Major parent incoherency: parent is no directory */
           LogDebug(COMPONENT_CACHE_INODE_GC,
                    "cache_inode_gc_invalidate_related_dirent: major inconcistency. Found an entry whose parent is not a directory");
           return LRU_LIST_DO_NOT_SET_INVALID;
         }
 
-      /* Set the entry as invalid in the dirent array */
-      if(parent_iter->parent->internal_md.type == DIR_BEGINNING)
+      if(parent_iter->subdirpos >= CHILDREN_ARRAY_SIZE)
         {
-          if(parent_iter->subdirpos > CHILDREN_ARRAY_SIZE)
-            {
-              V_w(&parent_iter->parent->lock);
-              LogCrit(COMPONENT_CACHE_INODE_GC,
-                      "A known bug occured line %d file %s: pentry=%p type=%u parent_iter->subdirpos=%d, should never exceed %d, entry not removed",
-                      __LINE__, __FILE__, pentry, pentry->internal_md.type,
-                      parent_iter->subdirpos, CHILDREN_ARRAY_SIZE);
-              return LRU_LIST_DO_NOT_SET_INVALID;
-            }
-          else
-            {
-              parent_iter->parent->object.dir_begin.pdir_data->dir_entries[parent_iter->
-                                                                           subdirpos].
-                  active = INVALID;
-              /* Garbage invalidates the effet of the readdir previously made */
-              parent_iter->parent->object.dir_begin.has_been_readdir = CACHE_INODE_NO;
-              parent_iter->parent->object.dir_begin.nbactive -= 1;
-            }
+          LogCrit(COMPONENT_CACHE_INODE_GC,
+                  "A known bug occured line %d file %s: pentry=%p type=%u parent_iter->subdirpos=%d, should never exceed %d, entry not removed",
+                  __LINE__, __FILE__, pentry, pentry->internal_md.type,
+                  parent_iter->subdirpos, CHILDREN_ARRAY_SIZE);
+          return LRU_LIST_DO_NOT_SET_INVALID;
         }
+
+      /* The dirents of the whole dir_chain are indexed in the DIR_BEGINNING, which holds the lock */
+      if(parent_iter->parent->internal_md.type == DIR_BEGINNING)
+        pentry_dir = parent_iter->parent;
       else
-        {
-          if(parent_iter->subdirpos > CHILDREN_ARRAY_SIZE)
-            {
-              V_w(&parent_iter->parent->lock);
-              LogCrit(COMPONENT_CACHE_INODE_GC,
-                      "A known bug occured line %d file %s: pentry=%p type=%u parent_iter->subdirpos=%d, should never exceed %d, entry not removed",
-                      __LINE__, __FILE__, pentry, pentry->internal_md.type,
-                      parent_iter->subdirpos, CHILDREN_ARRAY_SIZE);
-              return LRU_LIST_DO_NOT_SET_INVALID;
-            }
-          else
-            {
-              parent_iter->parent->object.dir_cont.pdir_data->dir_entries[parent_iter->
-                                                                          subdirpos].
-                  active = INVALID;
-              parent_iter->parent->object.dir_cont.nbactive -= 1;
-            }
-        }
+        pentry_dir = parent_iter->parent->object.dir_cont.pdir_begin;
+
+      P_w(&pentry_dir->lock);
+
+      /* Set the entry as invalid in the dirent array */
+      cache_inode_invalidate_dirent(parent_iter->parent, parent_iter->subdirpos);
+
+      /* Garbage invalidates the effet of the readdir previously made */
+      if(parent_iter->parent->internal_md.type == DIR_BEGINNING)
+        pentry_dir->object.dir_begin.has_been_readdir = CACHE_INODE_NO;
 
-      V_w(&parent_iter->parent->lock);
+      V_w(&pentry_dir->lock);
     }
 
   return LRU_LIST_SET_INVALID;
@@ -333,8 +459,7 @@ static int cache_inode_gc_invalidate_related_dirent(cache_entry_t * pentry,
  *
  * @return LRU_LIST_SET_INVALID if entry is successfully suppressed, LRU_LIST_DO_NOT_SET_INVALID otherwise
  *
- * @see LRU_invalidate_by_function
- * @see LRU_gc_invalid
+ * @see cache_inode_gc_evict
  *
  */
 int cache_inode_gc_suppress_file(cache_entry_t * pentry,
@@ -342,6 +467,14 @@ int cache_inode_gc_suppress_file(cache_entry_t * pentry,
 {
   P_w(&pentry->lock);
 
+  /* Unstable writes are kept until the flusher has written them */
+  if(pentry->internal_md.type == REGULAR_FILE &&
+     pentry->object.file.unstable_data != NULL)
+    {
+      V_w(&pentry->lock);
+      return LRU_LIST_DO_NOT_SET_INVALID;
+    }
+
   LogFullDebug(COMPONENT_CACHE_INODE_GC,
                "Entry %p (REGULAR_FILE/SYMBOLIC_LINK) will be garbaged",
                pentry);
@@ -379,8 +512,7 @@ int cache_inode_gc_suppress_file(cache_entry_t * pentry,
  *
  * @return 1 if entry is successfully suppressed, 0 otherwise
  *
- * @see LRU_invalidate_by_function
- * @see LRU_gc_invalid
+ * @see cache_inode_gc_evict
  *
  */
 int cache_inode_gc_suppress_directory(cache_entry_t * pentry,
@@ -447,30 +579,34 @@ int cache_inode_gc_suppress_directory(cache_entry_t * pentry,
 
 /**
  *
- * cache_inode_gc_function: Tests is an entry in cache inode is to be set invalid (has expired).
- *
- * Tests is an entry in cache inode is to be set invalid (has expired).
- * If entry is invalidated, does the cleaning stuff on it.
+ * cache_inode_gc_is_expired: Tests if an entry in cache inode may be garbaged.
  *
- * @param pentry [IN] pointer to the entry to test
+ * Tests if an entry in cache inode may be garbaged: its type must be garbaged
+ * by the policy, and it must not have been used for the expiration delay of
+ * this type.
  *
- * @return 1 if entry must be set invalid, 0 if not.
+ * @param pentry       [IN] pointer to the entry to test
+ * @param current_time [IN] the time of the garbage collection
  *
- * @see LRU_invalidate_by_function
- * @see LRU_gc_invalid
+ * @return TRUE if entry may be garbaged, FALSE if not.
  *
  */
-int cache_inode_gc_function(LRU_entry_t * plru_entry, void *addparam)
+static int cache_inode_gc_is_expired(cache_entry_t * pentry, time_t current_time)
 {
   time_t entry_time = 0;
-  time_t current_time = time(NULL);
-  cache_entry_t *pentry = NULL;
-  cache_inode_param_gc_t *pgcparam = (cache_inode_param_gc_t *) addparam;
+  signed int expiration_delay;
 
-  time_t allocated;
+  if(pentry->internal_md.type == DIR_BEGINNING)
+    expiration_delay = cache_inode_gc_policy.directory_expiration_delay;
+  else if(pentry->internal_md.type == REGULAR_FILE ||
+          pentry->internal_md.type == SYMBOLIC_LINK)
+    expiration_delay = cache_inode_gc_policy.file_expiration_delay;
+  else
+    return FALSE;
 
-  /* Get the entry */
-  pentry = (cache_entry_t *) (plru_entry->buffdata.pdata);
+  /* A negative delay means no gc for this type */
+  if(expiration_delay <= 0)
+    return FALSE;
 
   /* Get the entry time (the larger value in read_time and mod_time ) */
   if(pentry->internal_md.read_time > pentry->internal_md.mod_time)
@@ -478,57 +614,130 @@ int cache_inode_gc_function(LRU_entry_t * plru_entry, void *addparam)
   else
     entry_time = pentry->internal_md.mod_time;
 
-  allocated = pentry->internal_md.alloc_time;
+  return (current_time - entry_time > expiration_delay) ? TRUE : FALSE;
+}                               /* cache_inode_gc_is_expired */
 
-  if(pgcparam->nb_to_be_purged != 0)
+/**
+ *
+ * cache_inode_gc_sweep: moves the clock hand of a shard to choose victims.
+ *
+ * Moves the clock hand of a shard over at most CACHE_INODE_GC_BATCH *
+ * (CACHE_INODE_GC_MAX_REF + 1) entries. The reference counter of each entry
+ * the hand passes over is decremented, and expired entries with no reference
+ * left are taken out of the ring as victims. The shard is locked only for the
+ * duration of the sweep, never while entries are being reclaimed.
+ *
+ * @param pshard       [INOUT] the shard to be swept.
+ * @param current_time [IN]    the time of the garbage collection.
+ * @param victims      [OUT]   the chosen entries.
+ * @param max_victims  [IN]    the size of victims.
+ * @param pnb_scanned  [OUT]   the number of entries the hand passed over.
+ *
+ * @return the number of victims.
+ *
+ */
+static unsigned int cache_inode_gc_sweep(cache_inode_gc_shard_t * pshard,
+                                         time_t current_time,
+                                         cache_entry_t ** victims,
+                                         unsigned int max_victims,
+                                         unsigned int *pnb_scanned)
+{
+  cache_entry_t *pentry = NULL;
+  unsigned int nb_victims = 0;
+  unsigned int nb_scanned = 0;
+
+  P(pshard->lock);
+
+  while(nb_victims < max_victims && pshard->hand != NULL &&
+        nb_scanned < CACHE_INODE_GC_BATCH * (CACHE_INODE_GC_MAX_REF + 1))
     {
-      LogFullDebug(COMPONENT_CACHE_INODE_GC,
-                   "We still need %d entries to be garbaged",
-                   pgcparam->nb_to_be_purged);
+      pentry = pshard->hand;
+      pshard->hand = pentry->gc_node.next;
+      nb_scanned += 1;
 
-      /* Should we get ride of this entry ? */
-      if((pentry->internal_md.type == DIR_BEGINNING) &&
-         (cache_inode_gc_policy.directory_expiration_delay > 0))
+      /* Used since the last pass of the hand: second chance */
+      if(pentry->gc_node.refcount > 0)
         {
-          if(current_time - entry_time > cache_inode_gc_policy.directory_expiration_delay)
-            {
-              /* Entry should be tagged invalid */
-              LogDebug(COMPONENT_CACHE_INODE_GC,
-                       "----->>>>>>>> DIR GC : Garbage collection on dir entry %p",
-                       pentry);
-              return cache_inode_gc_suppress_directory(pentry, pgcparam);
-            }
-          else
-            LogFullDebug(COMPONENT_CACHE_INODE_GC,
-                         "No garbage on dir entry %p used:%d allocated:%d %d",
-                         pentry, (int)(current_time - entry_time),
-                         (int)(current_time - allocated),
-                         cache_inode_gc_policy.directory_expiration_delay);
+          pentry->gc_node.refcount -= 1;
+          continue;
         }
-      else if((pentry->internal_md.type == REGULAR_FILE
-               || pentry->internal_md.type == SYMBOLIC_LINK)
-              && (cache_inode_gc_policy.file_expiration_delay > 0))
+
+      if(!cache_inode_gc_is_expired(pentry, current_time))
+        continue;
+
+      cache_inode_gc_unlink(pshard, pentry);
+      pentry->gc_node.state = CACHE_INODE_GC_EVICTING;
+
+      victims[nb_victims++] = pentry;
+    }
+
+  V(pshard->lock);
+
+  *pnb_scanned = nb_scanned;
+  return nb_victims;
+}                               /* cache_inode_gc_sweep */
+
+/**
+ *
+ * cache_inode_gc_evict: reclaims a victim chosen by cache_inode_gc_sweep.
+ *
+ * The victim is given a last chance if it was used (or forgotten) since it
+ * was chosen. If it can't be reclaimed (a non empty directory for example), it
+ * goes back to its ring with all its references, so that the hand doesn't
+ * choose it again at once.
+ *
+ * @param pentry   [INOUT] the victim.
+ * @param pgcparam [INOUT] the garbage collection parameters.
+ *
+ * @return LRU_LIST_SET_INVALID if entry is reclaimed, LRU_LIST_DO_NOT_SET_INVALID otherwise
+ *
+ */
+static int cache_inode_gc_evict(cache_entry_t * pentry, cache_inode_param_gc_t * pgcparam)
+{
+  cache_inode_gc_shard_t *pshard = cache_inode_gc_shard_of(pentry);
+  int rc;
+
+  P(pshard->lock);
+
+  /* Removed from the cache by a worker in the meantime */
+  if(pentry->gc_node.state != CACHE_INODE_GC_EVICTING)
+    {
+      V(pshard->lock);
+      return LRU_LIST_DO_NOT_SET_INVALID;
+    }
+
+  /* Used since it was chosen */
+  if(pentry->gc_node.refcount > 0)
+    {
+      cache_inode_gc_link(pshard, pentry);
+      V(pshard->lock);
+      return LRU_LIST_DO_NOT_SET_INVALID;
+    }
+
+  V(pshard->lock);
+
+  LogDebug(COMPONENT_CACHE_INODE_GC,
+           "----->>>>>>>> GC : Garbage collection on entry %p, type=%d",
+           pentry, pentry->internal_md.type);
+
+  if(pentry->internal_md.type == DIR_BEGINNING)
+    rc = cache_inode_gc_suppress_directory(pentry, pgcparam);
+  else
+    rc = cache_inode_gc_suppress_file(pentry, pgcparam);
+
+  if(rc != LRU_LIST_SET_INVALID)
+    {
+      P(pshard->lock);
+      if(pentry->gc_node.state == CACHE_INODE_GC_EVICTING)
         {
-          if(current_time - entry_time > cache_inode_gc_policy.file_expiration_delay)
-            {
-              /* Entry should be suppress and tagged invalid */
-              LogDebug(COMPONENT_CACHE_INODE_GC,
-                       "----->>>>>> REGULAR/SYMLINK GC : Garbage collection on regular/symlink entry %p",
-                       pentry);
-              return cache_inode_gc_suppress_file(pentry, pgcparam);
-            }
-          else
-            LogFullDebug(COMPONENT_CACHE_INODE_GC,
-                         "No garbage on regular/symlink entry %p used:%d allocated:%d %d",
-                         pentry, (int)(current_time - entry_time),
-                         (int)(current_time - allocated),
-                         cache_inode_gc_policy.file_expiration_delay);
+          pentry->gc_node.refcount = CACHE_INODE_GC_MAX_REF;
+          cache_inode_gc_link(pshard, pentry);
         }
+      V(pshard->lock);
     }
 
-  /* Default return, entry is not to be set invalid */
-  return LRU_LIST_DO_NOT_SET_INVALID;
-}                               /* cache_inode_gc_function */
+  return rc;
+}                               /* cache_inode_gc_evict */
 
 /* @} */
 
@@ -540,6 +749,223 @@ int cache_inode_gc_function(LRU_entry_t * plru_entry, void *addparam)
  * @{
  */
 
+/**
+ *
+ * cache_inode_gc_init: Init the rings of the garbage collector.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_gc_init(void)
+{
+  unsigned int i;
+
+  for(i = 0; i < CACHE_INODE_GC_NB_SHARDS; i++)
+    {
+      pthread_mutex_init(&cache_inode_gc_shards[i].lock, NULL);
+      cache_inode_gc_shards[i].hand = NULL;
+      cache_inode_gc_shards[i].nb_entries = 0;
+    }
+
+  memset(&cache_inode_gc_stat, 0, sizeof(cache_inode_gc_stat));
+}                               /* cache_inode_gc_init */
+
+/**
+ *
+ * cache_inode_gc_touch: Records an access to an entry for the garbage collector.
+ *
+ * The first access puts the entry in the ring of its shard, the following ones
+ * only increment its reference counter, without any lock.
+ * Entry is supposed to be locked when this function is called.
+ *
+ * @param pentry [INOUT] the accessed entry.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_gc_touch(cache_entry_t * pentry)
+{
+  cache_inode_gc_shard_t *pshard = NULL;
+
+  /* DIR_CONTINUE are garbaged with their DIR_BEGINNING, other types never are */
+  if(pentry->internal_md.type != REGULAR_FILE &&
+     pentry->internal_md.type != SYMBOLIC_LINK &&
+     pentry->internal_md.type != DIR_BEGINNING)
+    return;
+
+  if(pentry->gc_node.state != CACHE_INODE_GC_DETACHED)
+    {
+      /* A lost increment only makes the entry a bit older for the GC */
+      if(pentry->gc_node.refcount < CACHE_INODE_GC_MAX_REF)
+        pentry->gc_node.refcount += 1;
+      return;
+    }
+
+  pshard = cache_inode_gc_shard_of(pentry);
+
+  P(pshard->lock);
+  if(pentry->gc_node.state == CACHE_INODE_GC_DETACHED)
+    {
+      pentry->gc_node.refcount = 0;
+      cache_inode_gc_link(pshard, pentry);
+    }
+  V(pshard->lock);
+}                               /* cache_inode_gc_touch */
+
+/**
+ *
+ * cache_inode_gc_touched: Tells if touching an entry would change nothing.
+ *
+ * This is the case when the entry is in a ring with a saturated reference
+ * counter. Lockless readers use it to avoid writing to a hot entry.
+ *
+ * @param pentry [IN] the entry.
+ *
+ * @return TRUE if cache_inode_gc_touch has nothing to do, FALSE otherwise.
+ *
+ */
+int cache_inode_gc_touched(cache_entry_t * pentry)
+{
+  if(pentry->internal_md.type != REGULAR_FILE &&
+     pentry->internal_md.type != SYMBOLIC_LINK &&
+     pentry->internal_md.type != DIR_BEGINNING)
+    return TRUE;
+
+  return pentry->gc_node.state != CACHE_INODE_GC_DETACHED &&
+      pentry->gc_node.refcount >= CACHE_INODE_GC_MAX_REF;
+}                               /* cache_inode_gc_touched */
+
+/**
+ *
+ * cache_inode_gc_forget: Removes an entry from the garbage collector.
+ *
+ * Called when an entry is removed from the cache by other means than the
+ * garbage collector.
+ *
+ * @param pentry [INOUT] the entry.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_gc_forget(cache_entry_t * pentry)
+{
+  cache_inode_gc_shard_t *pshard = cache_inode_gc_shard_of(pentry);
+
+  P(pshard->lock);
+  if(pentry->gc_node.state == CACHE_INODE_GC_RINGED)
+    cache_inode_gc_unlink(pshard, pentry);
+  pentry->gc_node.state = CACHE_INODE_GC_DETACHED;
+  V(pshard->lock);
+}                               /* cache_inode_gc_forget */
+
+/**
+ *
+ * cache_inode_gc_reclaim: Reclaims entries from the cache.
+ *
+ * Sweeps the shards in turn, one batch at a time, until nb_to_be_purged
+ * entries are reclaimed or the hands did enough moves to age every entry to
+ * no reference at all.
+ *
+ * @param ht              [INOUT] the hashtable used to stored the cache_inode entries.
+ * @param pclient         [INOUT] ressource allocated by the client for the gc.
+ * @param nb_to_be_purged [IN]    the number of entries to be reclaimed.
+ *
+ * @return the number of entries removed from the hashtable.
+ *
+ */
+unsigned int cache_inode_gc_reclaim(hash_table_t * ht,
+                                    cache_inode_client_t * pclient,
+                                    unsigned int nb_to_be_purged)
+{
+  cache_inode_param_gc_t gcparam;
+  cache_entry_t *victims[CACHE_INODE_GC_BATCH];
+  cache_inode_gc_stat_t gcstat;
+  time_t current_time = time(NULL);
+  unsigned long budget;
+  unsigned int nb_victims, nb_scanned, nb_idle_shards = 0;
+  unsigned int i;
+
+  gcparam.ht = ht;
+  gcparam.pclient = pclient;
+  gcparam.nb_to_be_purged = nb_to_be_purged;
+
+  cache_inode_gc_get_stat(&gcstat);
+  budget = (unsigned long)gcstat.nb_ringed * (CACHE_INODE_GC_MAX_REF + 1);
+
+  while(gcparam.nb_to_be_purged > 0 && budget > 0 &&
+        nb_idle_shards < CACHE_INODE_GC_NB_SHARDS)
+    {
+      i = __sync_fetch_and_add(&cache_inode_gc_next_shard, 1) & (CACHE_INODE_GC_NB_SHARDS - 1);
+
+      nb_victims = cache_inode_gc_sweep(&cache_inode_gc_shards[i], current_time, victims,
+                                        (gcparam.nb_to_be_purged < CACHE_INODE_GC_BATCH) ?
+                                        gcparam.nb_to_be_purged : CACHE_INODE_GC_BATCH,
+                                        &nb_scanned);
+
+      if(nb_scanned == 0)
+        nb_idle_shards += 1;
+      else
+        nb_idle_shards = 0;
+
+      budget = (budget > nb_scanned) ? budget - nb_scanned : 0;
+
+      for(i = 0; i < nb_victims; i++)
+        cache_inode_gc_evict(victims[i], &gcparam);
+    }
+
+  (void)__sync_fetch_and_add(&cache_inode_gc_stat.nb_passes, 1);
+  (void)__sync_fetch_and_add(&cache_inode_gc_stat.nb_evicted,
+                             nb_to_be_purged - gcparam.nb_to_be_purged);
+
+  return nb_to_be_purged - gcparam.nb_to_be_purged;
+}                               /* cache_inode_gc_reclaim */
+
+/**
+ *
+ * cache_inode_gc_recycle: Puts the entries reclaimed by the GC back in the pools of their owner.
+ *
+ * Must be called by the thread that owns the client, the pools having no lock.
+ *
+ * @param pclient [INOUT] ressource allocated by the client for the nfs management.
+ *
+ * @return the number of entries put back in the pools.
+ *
+ */
+unsigned int cache_inode_gc_recycle(cache_inode_client_t * pclient)
+{
+  cache_entry_t *pentry = NULL;
+  unsigned int nb_recycled = 0;
+
+  while((pentry = (cache_entry_t *) mpmc_queue_pop(&pclient->gc_recycle)) != NULL)
+    {
+      cache_inode_gc_release_entry(pentry, pclient);
+      nb_recycled += 1;
+    }
+
+  return nb_recycled;
+}                               /* cache_inode_gc_recycle */
+
+/**
+ *
+ * cache_inode_gc_get_stat: Gets the statistics of the garbage collector.
+ *
+ * @param pstat [OUT] the statistics.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_gc_get_stat(cache_inode_gc_stat_t * pstat)
+{
+  unsigned int i;
+
+  *pstat = cache_inode_gc_stat;
+
+  /* Racy sum, but this is only a statistic */
+  pstat->nb_ringed = 0;
+  for(i = 0; i < CACHE_INODE_GC_NB_SHARDS; i++)
+    pstat->nb_ringed += cache_inode_gc_shards[i].nb_entries;
+}                               /* cache_inode_gc_get_stat */
+
 /**
  *
  * cache_inode_set_gc_policy: Set the cache_inode garbage collecting policy.
@@ -568,30 +994,28 @@ cache_inode_gc_policy_t cache_inode_get_gc_policy(void)
 
 /**
  *
- * cache_inode_gc: Perform garbbage collection on the ressources managed by a client.
+ * cache_inode_gc: Perform garbbage collection on the cache inode.
  *
- * Perform garbbage collection on the ressources managed by a client.
+ * Perform garbbage collection on the cache inode, down to the low water mark
+ * if the high water mark is reached. The server does it in the garbage
+ * collector thread, this is for the other users of the cache.
  *
  * @param ht      [INOUT] the hashtable used to stored the cache_inode entries.
  * @param pclient [INOUT] ressource allocated by the client for the nfs management.
  * @param pstatus [OUT]   returned status.
  *
- * @return CACHE_INODE_SUCCESS if operation is a success \n
- * @return CACHE_INODE_LRU_ERROR if allocation error occured when validating the entry
+ * @return CACHE_INODE_SUCCESS (garbage collection can't fail)
  *
  * @see HashTable_GetSize
- * @see LRU_invalidate_by_function
- * @see LRU_gc_invalid
+ * @see cache_inode_gc_reclaim
  *
  */
 cache_inode_status_t cache_inode_gc(hash_table_t * ht,
                                     cache_inode_client_t * pclient,
                                     cache_inode_status_t * pstatus)
 {
-  cache_inode_param_gc_t gcparam;
   unsigned int hash_size;
-  unsigned int invalid_before_gc = 0;
-  unsigned int invalid_after_gc = 0;
+  unsigned int nb_reclaimed;
 
   /* Set the return default to CACHE_INODE_SUCCESS */
   *pstatus = CACHE_INODE_SUCCESS;
@@ -615,98 +1039,42 @@ cache_inode_status_t cache_inode_gc(hash_table_t * ht,
   if(hash_size > cache_inode_gc_policy.hwmark_nb_entries)
     {
       /*
-       * Garbage collection is made in several steps
-       *    1- Set the oldest entry as invalid and garbage their contents
-       *    2- Free the invalid entry in the LRU
-       *
-       *    Behaviour: - A DIR_BEGINNING is garbaged with all its DIR_CONTINUE associated
-       *               - A directory is garbaged when all its entries are garbaged
-       *
+       * Behaviour: - A DIR_BEGINNING is garbaged with all its DIR_CONTINUE associated
+       *            - A directory is garbaged when all its entries are garbaged
        */
-
-      gcparam.ht = ht;
-      gcparam.pclient = pclient;
-      gcparam.nb_to_be_purged = hash_size - cache_inode_gc_policy.lwmark_nb_entries;    /* try to purge until lw mark is reached */
-
       LogInfo(COMPONENT_CACHE_INODE_GC,
-              "Garbage collection started (to be purged=%u, LRU size=%u)",
-              pclient->lru_gc->nb_entry, gcparam.nb_to_be_purged);
-
-      invalid_before_gc = pclient->lru_gc->nb_invalid;
-      if(LRU_invalidate_by_function
-         (pclient->lru_gc, cache_inode_gc_function, (void *)&gcparam) != LRU_LIST_SUCCESS)
-        {
-          *pstatus = CACHE_INODE_LRU_ERROR;
-          return *pstatus;
-        }
-
-      invalid_after_gc = pclient->lru_gc->nb_invalid;
+              "Garbage collection started (to be purged=%u)",
+              hash_size - cache_inode_gc_policy.lwmark_nb_entries);
 
-      /* Removes the LRU entries and put them back to the pool */
-      if(LRU_gc_invalid(pclient->lru_gc, NULL) != LRU_LIST_SUCCESS)
-        {
-          *pstatus = CACHE_INODE_LRU_ERROR;
-          return *pstatus;
-        }
+      nb_reclaimed = cache_inode_gc_reclaim(ht, pclient,
+                                            hash_size -
+                                            cache_inode_gc_policy.lwmark_nb_entries);
 
       LogInfo(COMPONENT_CACHE_INODE_GC,
-              "Garbage collection finished, %u entries removed",
-              invalid_after_gc - invalid_before_gc);
-
-      *pstatus = CACHE_INODE_SUCCESS;
-    }
-  else
-    {
-      /* no garbage is required, just gets ride of the invalid in tyhe LRU list */
-      /* Removes the LRU entries and put them back to the pool */
-      if(LRU_gc_invalid(pclient->lru_gc, NULL) != LRU_LIST_SUCCESS)
-        {
-          *pstatus = CACHE_INODE_LRU_ERROR;
-          return *pstatus;
-        }
-      else
-        *pstatus = CACHE_INODE_SUCCESS;
+              "Garbage collection finished, %u entries removed", nb_reclaimed);
     }
 
+  /* Get back the memory of my entries reclaimed by other clients */
+  cache_inode_gc_recycle(pclient);
+
   return *pstatus;
 }                               /* cache_inode_gc */
 
-int cache_inode_gc_fd_func(LRU_entry_t * plru_entry, void *addparam)
-{
-  cache_entry_t *pentry = NULL;
-  cache_inode_param_gc_t *pgcparam = (cache_inode_param_gc_t *) addparam;
-  cache_inode_status_t status;
-
-  /* Get the entry */
-  pentry = (cache_entry_t *) (plru_entry->buffdata.pdata);
-
-  /* check if a file descriptor is opened on the file for a long time */
-
-  if((pentry->internal_md.type == REGULAR_FILE)
-     && (pentry->object.file.open_fd.fileno != 0)
-     && (time(NULL) - pentry->object.file.open_fd.last_op > pgcparam->pclient->retention))
-    {
-      P_w(&pentry->lock);
-      cache_inode_close(pentry, pgcparam->pclient, &status);
-      V_w(&pentry->lock);
-
-      pgcparam->nb_to_be_purged--;
-    }
-
-  /* return true for continuing */
-  if(pgcparam->nb_to_be_purged == 0)
-    return FALSE;
-  else
-    return TRUE;
-}
-
 /**
  * Garbagge opened file descriptors
  */
 cache_inode_status_t cache_inode_gc_fd(cache_inode_client_t * pclient,
                                        cache_inode_status_t * pstatus)
 {
-  cache_inode_param_gc_t gcparam;
+  cache_entry_t *candidates[CACHE_INODE_GC_BATCH];
+  cache_inode_gc_shard_t *pshard = NULL;
+  cache_entry_t *pentry = NULL;
+  cache_inode_status_t status;
+  unsigned int nb_to_be_closed;
+  unsigned int nb_candidates;
+  unsigned int nb_closed;
+  unsigned int i, j;
+  time_t current_time = time(NULL);
 
   /* Set the return default to CACHE_INODE_SUCCESS */
   *pstatus = CACHE_INODE_SUCCESS;
@@ -716,23 +1084,55 @@ cache_inode_status_t cache_inode_gc_fd(cache_inode_client_t * pclient,
     return *pstatus;
 
   /* do not garbage FD too frequently (wait at least for fd retention) */
-  if(time(NULL) - pclient->time_of_last_gc_fd < pclient->retention)
+  if(current_time - pclient->time_of_last_gc_fd < pclient->retention)
     return *pstatus;
 
-  gcparam.ht = NULL;            /* not used */
-  gcparam.pclient = pclient;
-  gcparam.nb_to_be_purged = pclient->max_fd_per_thread;
+  nb_to_be_closed = pclient->max_fd_per_thread;
 
-  if(LRU_apply_function(pclient->lru_gc, cache_inode_gc_fd_func, (void *)&gcparam) !=
-     LRU_LIST_SUCCESS)
+  i = 0;
+  while(i < CACHE_INODE_GC_NB_SHARDS && nb_to_be_closed > 0)
     {
-      *pstatus = CACHE_INODE_LRU_ERROR;
-      return *pstatus;
+      pshard = &cache_inode_gc_shards[i];
+      nb_candidates = 0;
+      nb_closed = 0;
+
+      /* check if a file descriptor is opened on the file for a long time */
+      P(pshard->lock);
+      pentry = pshard->hand;
+      for(j = 0; j < pshard->nb_entries; j++, pentry = pentry->gc_node.next)
+        {
+          if((pentry->internal_md.type == REGULAR_FILE)
+             && (pentry->object.file.open_fd.fileno != 0)
+             && (current_time - pentry->object.file.open_fd.last_op > pclient->retention))
+            {
+              candidates[nb_candidates++] = pentry;
+
+              if(nb_candidates == CACHE_INODE_GC_BATCH || nb_candidates == nb_to_be_closed)
+                break;
+            }
+        }
+      V(pshard->lock);
+
+      /* Entries are locked out of the shard lock, as cache_inode_gc_touch does the opposite */
+      for(j = 0; j < nb_candidates; j++)
+        {
+          P_w(&candidates[j]->lock);
+          if(candidates[j]->object.file.open_fd.fileno != 0 &&
+             cache_inode_close(candidates[j], pclient, &status) == CACHE_INODE_SUCCESS)
+            nb_closed += 1;
+          V_w(&candidates[j]->lock);
+        }
+
+      nb_to_be_closed -= nb_closed;
+
+      /* A full batch was closed, the shard may have more of them */
+      if(nb_candidates < CACHE_INODE_GC_BATCH || nb_closed == 0)
+        i += 1;
     }
 
   LogDebug(COMPONENT_CACHE_INODE_GC,
            "File descriptor GC: %u files closed",
-           pclient->max_fd_per_thread - gcparam.nb_to_be_purged);
+           pclient->max_fd_per_thread - nb_to_be_closed);
   pclient->time_of_last_gc_fd = time(NULL);
 
   *pstatus = CACHE_INODE_SUCCESS;
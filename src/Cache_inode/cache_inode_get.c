@@ -149,8 +149,11 @@ cache_entry_t *cache_inode_get_located(cache_inode_fsal_data_t * pfsdata,
       /* Entry exists in the cache and was found */
       pentry = (cache_entry_t *) value.pdata;
 
-      /* return attributes additionally */
-      cache_inode_get_attributes(pentry, pattr);
+      /* return attributes additionally. The entry is not locked here, and the
+       * caller may hold its lock already: when the lockless copy fails, the
+       * attributes are copied as they are */
+      if(cache_inode_get_attributes_lockless(pentry, pattr) != 0)
+        cache_inode_get_attributes(pentry, pattr);
 
       break;
 
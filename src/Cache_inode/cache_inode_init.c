@@ -76,6 +76,8 @@ hash_table_t *cache_inode_init(cache_inode_parameter_t param,
 
   ht = HashTable_Init(param.hparam);
 
+  cache_inode_gc_init();
+
   if(ht != NULL)
     *pstatus = CACHE_INODE_SUCCESS;
   else
@@ -103,13 +105,16 @@ int cache_inode_client_init(cache_inode_client_t * pclient,
                             cache_inode_client_parameter_t param,
                             int thread_index, void *pworker_data)
 {
-  LRU_status_t lru_status;
   char name[256];
 
   if(thread_index < SMALL_CLIENT_INDEX)
     sprintf(name, "Cache Inode Worker #%d", thread_index);
   else if(thread_index == SMALL_CLIENT_INDEX)
     sprintf(name, "Cache Inode Small Client");
+  else if(thread_index == GC_THREAD_INDEX)
+    sprintf(name, "Cache Inode GC");
+  else if(thread_index == FLUSH_THREAD_INDEX)
+    sprintf(name, "Cache Inode Flusher");
   else
     sprintf(name, "Cache Inode NLM Async #%d", thread_index - NLM_THREAD_INDEX);
 
@@ -213,12 +218,11 @@ int cache_inode_client_init(cache_inode_client_t * pclient,
       return 1;
     }
 
-  param.lru_param.name = name;
-
-  if((pclient->lru_gc = LRU_Init(param.lru_param, &lru_status)) == NULL)
+  /* Room for all my preallocated entries, reclaimed by the GC */
+  if(mpmc_queue_init(&pclient->gc_recycle, pclient->nb_prealloc) != 0)
     {
       LogCrit(COMPONENT_CACHE_INODE,
-              "Can't init %s lru gc", name);
+              "Can't init %s gc recycle queue", name);
       return 1;
     }
 
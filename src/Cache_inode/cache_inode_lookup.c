@@ -83,7 +83,7 @@ cache_entry_t *cache_inode_lookup_sw(cache_entry_t * pentry_parent,
                                      fsal_op_context_t * pcontext,
                                      cache_inode_status_t * pstatus, int use_mutex)
 {
-  cache_entry_t *pdir_chain = NULL;
+  struct cache_inode_dir_entry__ *pdirent = NULL;
   cache_entry_t *pentry = NULL;
   fsal_status_t fsal_status;
 #ifdef _USE_MFSL
@@ -98,7 +98,6 @@ cache_entry_t *cache_inode_lookup_sw(cache_entry_t * pentry_parent,
   cache_inode_status_t cache_status;
   cache_inode_fsal_data_t new_entry_fsdata;
   fsal_accessflags_t access_mask = 0;
-  int i = 0;
 
   memset( (char *)&new_entry_fsdata, 0, sizeof( new_entry_fsdata ) ) ; 
 
@@ -177,75 +176,14 @@ cache_entry_t *cache_inode_lookup_sw(cache_entry_t * pentry_parent,
           return NULL;
         }
 
-      /* Try to look into the dir and its dir_cont. At this point, it must be said than lock on dir_cont are
-       *  taken when a lock is previously acquired on the related dir_begin */
-      pdir_chain = pentry_parent;
-
-      do
+      /* Look into the name index of the dir and its dir_cont. At this point, it must be said than
+       * lock on dir_cont are taken when a lock is previously acquired on the related dir_begin */
+      if((pdirent = cache_inode_dirent_index_find(pentry_parent, pname)) != NULL)
         {
-          /* Is this entry known ? */
-          if(pdir_chain->internal_md.type == DIR_BEGINNING)
-            {
-              for(i = 0; i < CHILDREN_ARRAY_SIZE; i++)
-                {
-                  if(pdir_chain->object.dir_begin.pdir_data->dir_entries[i].active ==
-                     VALID)
-                    if(!FSAL_namecmp
-                       (pname,
-                        &(pentry_parent->object.dir_begin.pdir_data->dir_entries[i].
-                          name)))
-                      {
-                        /* Entry was found */
-                        pentry =
-                            pentry_parent->object.dir_begin.pdir_data->dir_entries[i].
-                            pentry;
-                        LogFullDebug(COMPONENT_CACHE_INODE,
-                                     "Cache Hit detected (dir_begin)");
-                        break;
-                      }
-                }
-
-              /* Do we have to go on browsing the cache_inode ? */
-              if(pdir_chain->object.dir_begin.end_of_dir == END_OF_DIR)
-                {
-                  break;
-                }
-
-              /* Next step */
-              pdir_chain = pdir_chain->object.dir_begin.pdir_cont;
-            }
-          else
-            {
-              /* The element in the dir_chain is a DIR_CONTINUE */
-              for(i = 0; i < CHILDREN_ARRAY_SIZE; i++)
-                {
-                  if(pdir_chain->object.dir_cont.pdir_data->dir_entries[i].active ==
-                     VALID)
-                    if(!FSAL_namecmp
-                       (pname,
-                        &(pdir_chain->object.dir_cont.pdir_data->dir_entries[i].name)))
-                      {
-                        /* Entry was found */
-                        pentry =
-                            pdir_chain->object.dir_cont.pdir_data->dir_entries[i].pentry;
-                        LogFullDebug(COMPONENT_CACHE_INODE,
-                                     "Cache Hit detected (dir_cont)");
-                        break;
-                      }
-                }
-
-              /* Do we have to go on browsing the cache_inode ? */
-              if(pdir_chain->object.dir_cont.end_of_dir == END_OF_DIR)
-                {
-                  break;
-                }
-
-              /* Next step */
-              pdir_chain = pdir_chain->object.dir_cont.pdir_cont;
-            }
-
+          /* Entry was found */
+          pentry = pdirent->pentry;
+          LogFullDebug(COMPONENT_CACHE_INODE, "Cache Hit detected");
         }
-      while(pentry == NULL);
 
       /* At this point, if pentry == NULL, we are not looking for a known son, query fsal for lookup */
       if(pentry == NULL)
@@ -56,6 +56,7 @@
 #include <time.h>
 #include <pthread.h>
 #include <string.h>
+#include <errno.h>
 
 char *cache_inode_function_names[] = {
   "cache_inode_access",
@@ -441,8 +442,13 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
   pentry->internal_md.mod_time = pentry->internal_md.alloc_time = time(NULL);
   pentry->internal_md.refresh_time = pentry->internal_md.alloc_time;
 
-  pentry->gc_lru_entry = NULL;
-  pentry->gc_lru = NULL;
+  /* The GC knows the entry at its first validation, its memory is mine */
+  pentry->gc_node.prev = NULL;
+  pentry->gc_node.next = NULL;
+  pentry->gc_node.refcount = 0;
+  pentry->gc_node.state = CACHE_INODE_GC_DETACHED;
+  pentry->gc_node.powner = pclient;
+  pentry->gc_node.recycle_key = NULL;
 
   /* No parent for now, it will be added in cache_inode_add_cached_dirent */
   pentry->parent_list = NULL;
@@ -464,7 +470,10 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
       pentry->object.file.pentry_content = NULL;        /* Not yet a File Content entry associated with this entry */
       pentry->object.file.pstate_head = NULL;   /* No associated client yet                                */
       pentry->object.file.pstate_tail = NULL;   /* No associated client yet                                */
+      memset(&pentry->object.file.deleg_heuristics, 0,
+             sizeof(cache_inode_deleg_heuristics_t));   /* Never opened yet */
       init_glist(&pentry->object.file.lock_list);  /* No associated locks yet */
+      memset(&pentry->object.file.lock_trees, 0, sizeof(cache_inode_lock_trees_t));
       if(pthread_mutex_init(&pentry->object.file.lock_list_mutex, NULL) != 0)
         {
           ReleaseToPool(pentry, &pclient->pool_entry);
@@ -487,8 +496,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
 #else
       memset(&(pentry->object.file.open_fd.fd), 0, sizeof(fsal_file_t));
 #endif
-      memset(&(pentry->object.file.unstable_data), 0,
-             sizeof(cache_inode_unstable_data_t));
+      pentry->object.file.unstable_data = NULL;
 #ifdef _USE_PROXY
       pentry->object.file.pname = NULL;
       pentry->object.file.pentry_parent_open = NULL;
@@ -524,6 +532,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
           pentry->object.dir_begin.pdir_data->dir_entries[i].pentry = NULL;
           FSAL_str2name("", 1, &pentry->object.dir_begin.pdir_data->dir_entries[i].name);
         }
+      cache_inode_dirent_index_init(pentry);
 
       break;
 
@@ -683,6 +692,7 @@ cache_entry_t *cache_inode_new_entry(cache_inode_fsal_data_t * pfsdata,
           pentry->object.dir_begin.pdir_data->dir_entries[i].pentry = NULL;
           FSAL_str2name("", 1, &pentry->object.dir_begin.pdir_data->dir_entries[i].name);
         }
+      cache_inode_dirent_index_init(pentry);
 
 
       break ;
@@ -976,7 +986,7 @@ cache_inode_status_t cache_inode_error_convert(fsal_status_t fsal_status)
  * @param pclient [INOUT] ressource allocated by the client for the nfs management.
  *
  * @return CACHE_INODE_SUCCESS if successful
- * @return CACHE_INODE_LRU_ERROR if an errorr occured in LRU management.
+ * @return CACHE_INODE_CACHE_CONTENT_ERROR if an error occured when closing a cached fd.
  *
  */
 cache_inode_status_t cache_inode_valid(cache_entry_t * pentry,
@@ -987,8 +997,6 @@ cache_inode_status_t cache_inode_valid(cache_entry_t * pentry,
 
   cache_inode_status_t cache_status;
   cache_content_status_t cache_content_status;
-  LRU_status_t lru_status;
-  LRU_entry_t *plru_entry = NULL;
   cache_content_client_t *pclient_content = NULL;
   cache_content_entry_t *pentry_content = NULL;
 #ifndef _NO_BUDDY_SYSTEM
@@ -1004,27 +1012,8 @@ cache_inode_status_t cache_inode_valid(cache_entry_t * pentry,
       return cache_inode_valid(pentry->object.dir_cont.pdir_begin, op, pclient);
     }
 
-  /* Invalidate former entry if needed */
-  if(pentry->gc_lru != NULL && pentry->gc_lru_entry)
-    {
-      if(LRU_invalidate(pentry->gc_lru, pentry->gc_lru_entry) != LRU_LIST_SUCCESS)
-        {
-          ReleaseToPool(pentry, &pclient->pool_entry);
-          return CACHE_INODE_LRU_ERROR;
-        }
-    }
-
-  if((plru_entry = LRU_new_entry(pclient->lru_gc, &lru_status)) == NULL)
-    {
-      ReleaseToPool(pentry, &pclient->pool_entry);
-      return CACHE_INODE_LRU_ERROR;
-    }
-  plru_entry->buffdata.pdata = (caddr_t) pentry;
-  plru_entry->buffdata.len = sizeof(cache_entry_t);
-
-  /* Setting the anchors */
-  pentry->gc_lru = pclient->lru_gc;
-  pentry->gc_lru_entry = plru_entry;
+  /* Let the GC know the entry is used */
+  cache_inode_gc_touch(pentry);
 
   /* Update internal md */
   pentry->internal_md.valid_state = VALID;
@@ -1096,36 +1085,30 @@ cache_inode_status_t cache_inode_valid(cache_entry_t * pentry,
 #endif
 
 #endif
-  LogFullDebug(COMPONENT_CACHE_INODE_GC,
-               "(pthread_self=%p) LRU GC state: nb_entries=%d nb_invalid=%d nb_call_gc=%d param.nb_call_gc_invalid=%d",
-               (caddr_t)pthread_self(),
-               pclient->lru_gc->nb_entry,
-               pclient->lru_gc->nb_invalid,
-               pclient->lru_gc->nb_call_gc,
-               pclient->lru_gc->parameter.nb_call_gc_invalid);
-
-  LogFullDebug(COMPONENT_CACHE_INODE_GC,
-               "LRU GC state: nb_entries=%d nb_invalid=%d nb_call_gc=%d param.nb_call_gc_invalid=%d",
-               pclient->lru_gc->nb_entry,
-               pclient->lru_gc->nb_invalid,
-               pclient->lru_gc->nb_call_gc,
-               pclient->lru_gc->parameter.nb_call_gc_invalid);
-
-  LogFullDebug(COMPONENT_CACHE_INODE_GC,
-               "LRU GC state: nb_entries=%d nb_invalid=%d nb_call_gc=%d param.nb_call_gc_invalid=%d",
-               pclient->lru_gc->nb_entry,
-               pclient->lru_gc->nb_invalid,
-               pclient->lru_gc->nb_call_gc,
-               pclient->lru_gc->parameter.nb_call_gc_invalid);
-
-
-  /* Call LRU_gc_invalid to get ride of the unused invalid lru entries */
-  if(LRU_gc_invalid(pclient->lru_gc, NULL) != LRU_LIST_SUCCESS)
-    return CACHE_INODE_LRU_ERROR;
-
   return CACHE_INODE_SUCCESS;
 }                               /* cache_inode_valid */
 
+/**
+ *
+ * cache_inode_valid_uptodate: tells if a read was already recorded in the entry.
+ *
+ * Tells if cache_inode_valid(CACHE_INODE_OP_GET) would change nothing in the
+ * entry during the current second. Readers that don't lock the entry then
+ * skip it, so that a hot entry is not written on every access. The entry
+ * doesn't need to be locked, the answer is only a hint.
+ *
+ * @param pentry [IN] entry to be checked.
+ * @param now [IN] the current time.
+ *
+ * @return TRUE if the read is already recorded, FALSE otherwise.
+ *
+ */
+int cache_inode_valid_uptodate(cache_entry_t * pentry, time_t now)
+{
+  return pentry->internal_md.valid_state == VALID &&
+      pentry->internal_md.read_time == now && cache_inode_gc_touched(pentry);
+}                               /* cache_inode_valid_uptodate */
+
 /**
  *
  * cache_inode_get_attributes: gets the attributes cached in the entry.
@@ -1179,6 +1162,48 @@ void cache_inode_get_attributes(cache_entry_t * pentry, fsal_attrib_list_t * pat
     }
 }                               /* cache_inode_get_attributes */
 
+/**
+ *
+ * cache_inode_get_attributes_lockless: gets the attributes cached in the entry without locking it.
+ *
+ * The attributes are copied without taking the entry lock nor writing to the
+ * entry. The copy is validated against the sequence of the entry lock, which
+ * every writer bumps: it fails if a writer held the lock meanwhile.
+ *
+ * @param pentry [IN] the entry to deal with, not locked by the caller.
+ * @param pattr [OUT] the attributes for this entry.
+ *
+ * @return 0 if the attributes were copied, EBUSY if the caller must lock the
+ * entry and use cache_inode_get_attributes.
+ *
+ */
+int cache_inode_get_attributes_lockless(cache_entry_t * pentry,
+                                        fsal_attrib_list_t * pattr)
+{
+  unsigned int seq;
+
+  if(rw_lock_seq_begin(&pentry->lock, &seq) != 0)
+    return EBUSY;
+
+  /* DIR_CONTINUE attributes are protected by the lock of their DIR_BEGINNING */
+  switch (pentry->internal_md.type)
+    {
+    case DIR_CONTINUE:
+    case UNASSIGNED:
+    case RECYCLED:
+      return EBUSY;
+
+    default:
+      cache_inode_get_attributes(pentry, pattr);
+      break;
+    }
+
+  if(rw_lock_seq_retry(&pentry->lock, seq))
+    return EBUSY;
+
+  return 0;
+}                               /* cache_inode_get_attributes_lockless */
+
 /**
  *
  * cache_inode_init_attributes: sets the initial attributes cached in the entry.
@@ -1697,6 +1722,7 @@ static void cache_inode_invalidate_related_dirent(cache_entry_t * pentry,
                                                   cache_inode_client_t * pclient)
 {
   cache_inode_parent_entry_t *parent_iter = NULL;
+  cache_entry_t *pentry_dir = NULL;
 
   /* Set the cache status as INVALID in the directory entries */
   for(parent_iter = pentry->parent_list; parent_iter != NULL;
@@ -1711,62 +1737,41 @@ static void cache_inode_invalidate_related_dirent(cache_entry_t * pentry,
         }
 
       /* If I reached this point, then parent_iter->parent is not null and is a valid cache_inode pentry */
-      P_w(&parent_iter->parent->lock);
-
       /* Check for type of the parent */
       if(parent_iter->parent->internal_md.type != DIR_BEGINNING &&
          parent_iter->parent->internal_md.type != DIR_CONTINUE)
         {
-          V_w(&parent_iter->parent->lock);
           /* Major parent incoherency: parent is no directory */
           LogDebug(COMPONENT_CACHE_INODE,
                    "cache_inode_gc_invalidate_related_dirent: major incoherency. Found an entry whose parent is no directory");
           return;
         }
 
-      /* Set the entry as invalid in the dirent array */
-      if(parent_iter->parent->internal_md.type == DIR_BEGINNING)
+      if(parent_iter->subdirpos >= CHILDREN_ARRAY_SIZE)
         {
-          if(parent_iter->subdirpos > CHILDREN_ARRAY_SIZE)
-            {
-              V_w(&parent_iter->parent->lock);
-              LogCrit(COMPONENT_CACHE_INODE,
-                      "cache_inode_gc_invalidate_related_dirent: A known bug occured line %d file %s: pentry=%p type=%u parent_iter->subdirpos=%d, should never exceed, entry not removed %d",
-                       __LINE__, __FILE__, pentry, pentry->internal_md.type,
-                       parent_iter->subdirpos, CHILDREN_ARRAY_SIZE);
-              return;
-            }
-          else
-            {
-              parent_iter->parent->object.dir_begin.pdir_data->dir_entries[parent_iter->
-                                                                           subdirpos].
-                  active = INVALID;
-              /* Garbagge invalidates the effet of the readdir previously made */
-              parent_iter->parent->object.dir_begin.has_been_readdir = CACHE_INODE_NO;
-              parent_iter->parent->object.dir_begin.nbactive -= 1;
-            }
+          LogCrit(COMPONENT_CACHE_INODE,
+                  "cache_inode_gc_invalidate_related_dirent: A known bug occured line %d file %s: pentry=%p type=%u parent_iter->subdirpos=%d, should never exceed %d, entry not removed",
+                  __LINE__, __FILE__, pentry, pentry->internal_md.type,
+                  parent_iter->subdirpos, CHILDREN_ARRAY_SIZE);
+          return;
         }
+
+      /* The dirents of the whole dir_chain are indexed in the DIR_BEGINNING, which holds the lock */
+      if(parent_iter->parent->internal_md.type == DIR_BEGINNING)
+        pentry_dir = parent_iter->parent;
       else
-        {
-          if(parent_iter->subdirpos > CHILDREN_ARRAY_SIZE)
-            {
-              V_w(&parent_iter->parent->lock);
-              LogCrit(COMPONENT_CACHE_INODE,
-                      "cache_inode_gc_invalidate_related_dirent: A known bug occured line %d file %s: pentry=%p type=%u parent_iter->subdirpos=%d, should never exceed %d, entry not removed",
-                       __LINE__, __FILE__, pentry, pentry->internal_md.type,
-                       parent_iter->subdirpos, CHILDREN_ARRAY_SIZE);
-              return;
-            }
-          else
-            {
-              parent_iter->parent->object.dir_cont.pdir_data->dir_entries[parent_iter->
-                                                                          subdirpos].
-                  active = INVALID;
-              parent_iter->parent->object.dir_cont.nbactive -= 1;
-            }
-        }
+        pentry_dir = parent_iter->parent->object.dir_cont.pdir_begin;
 
-      V_w(&parent_iter->parent->lock);
+      P_w(&pentry_dir->lock);
+
+      /* Set the entry as invalid in the dirent array */
+      cache_inode_invalidate_dirent(parent_iter->parent, parent_iter->subdirpos);
+
+      /* Garbage invalidates the effet of the readdir previously made */
+      if(parent_iter->parent->internal_md.type == DIR_BEGINNING)
+        pentry_dir->object.dir_begin.has_been_readdir = CACHE_INODE_NO;
+
+      V_w(&pentry_dir->lock);
     }
 }                               /* cache_inode_invalidate_related_dirent */
 
@@ -1825,15 +1830,11 @@ cache_inode_status_t cache_inode_kill_entry(cache_entry_t * pentry,
       return *pstatus;
     }
 
-  /* Invalidate the related LRU gc entry (no more required) */
-  if(pentry->gc_lru_entry != NULL)
-    {
-      if(LRU_invalidate(pentry->gc_lru, pentry->gc_lru_entry) != LRU_LIST_SUCCESS)
-        {
-          *pstatus = CACHE_INODE_LRU_ERROR;
-          return *pstatus;
-        }
-    }
+  /* The entry is no more to be garbaged */
+  cache_inode_gc_forget(pentry);
+
+  /* Buffered unstable writes can't be flushed anymore */
+  cache_inode_unstable_discard(pentry);
 
   fsaldata.handle = *pfsal_handle;
 
@@ -1943,6 +1944,8 @@ cache_inode_status_t cache_inode_kill_entry(cache_entry_t * pentry,
           pentry->object.dir_begin.pdir_data->dir_entries[i].active = INVALID;
           pentry->object.dir_begin.pdir_data->dir_entries[i].pentry = NULL;
         }
+      cache_inode_dirent_index_release(pentry);
+
       /* Put the pentry back to the pool */
       ReleaseToPool(pentry->object.dir_begin.pdir_data, &pclient->pool_dir_data);
     }
@@ -439,7 +439,8 @@ cache_inode_status_t cache_inode_close(cache_entry_t * pentry,
 
   /* if locks are held in the file, do not close */
   P(pentry->object.file.lock_list_mutex);
-  if(!glist_empty(&pentry->object.file.lock_list))
+  if(!glist_empty(&pentry->object.file.lock_list) ||
+     pentry->object.file.lock_trees.nb_locks != 0)
     {
       V(pentry->object.file.lock_list_mutex);
       *pstatus = CACHE_INODE_SUCCESS;
@@ -173,28 +173,15 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t * pentry,
   /* Do we use stable or unstable storage ? */
   if(stable == FSAL_UNSAFE_WRITE_TO_GANESHA_BUFFER)
     {
-      /* Data will be stored in memory and not flush to FSAL */
-
-      /* If the unstable_data buffer allocated ? */
-      if(pentry->object.file.unstable_data.buffer == NULL)
+      /* Data will be stored in memory and flushed later to FSAL, see cache_inode_unstable.c.
+       * The Ganesha write buffer is not used with data cached entries */
+      if(read_or_write == CACHE_INODE_WRITE &&
+         pentry->object.file.pentry_content == NULL &&
+         cache_inode_unstable_write(pentry, seek_descriptor->offset, buffer_size,
+                                    buffer, pclient, pcontext))
         {
-          if((pentry->object.file.unstable_data.buffer =
-              Mem_Alloc_Label(CACHE_INODE_UNSTABLE_BUFFERSIZE,
-                              "Cache_Inode Unstable Buffer")) == NULL)
-            {
-              *pstatus = CACHE_INODE_MALLOC_ERROR;
-              V_w(&pentry->lock);
-
-              /* stats */
-              pclient->stat.func_stats.nb_err_unrecover[statindex] += 1;
-
-              return *pstatus;
-            }
-
-          pentry->object.file.unstable_data.offset = seek_descriptor->offset;
-          pentry->object.file.unstable_data.length = buffer_size;
-
-          memcpy(pentry->object.file.unstable_data.buffer, buffer, buffer_size);
+          if(seek_descriptor->offset + buffer_size > pentry->object.file.attributes.filesize)
+            pentry->object.file.attributes.filesize = seek_descriptor->offset + buffer_size;
 
           /* Set mtime and ctime */
           pentry->object.file.attributes.mtime.seconds = time(NULL);
@@ -204,34 +191,28 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t * pentry,
           pentry->object.file.attributes.ctime = pentry->object.file.attributes.mtime;
 
           *pio_size = buffer_size;
-        }                       /* if( pentry->object.file.unstable_data.buffer == NULL ) */
+        }
       else
         {
-          if((pentry->object.file.unstable_data.offset < seek_descriptor->offset) &&
-             (buffer_size + seek_descriptor->offset < CACHE_INODE_UNSTABLE_BUFFERSIZE))
-            {
-              pentry->object.file.unstable_data.length =
-                  buffer_size + seek_descriptor->offset;
-              memcpy((char *)(pentry->object.file.unstable_data.buffer +
-                              seek_descriptor->offset), buffer, buffer_size);
-
-              /* Set mtime and ctime */
-              pentry->object.file.attributes.mtime.seconds = time(NULL);
-              pentry->object.file.attributes.mtime.nseconds = 0;
+          /* Go back to regular situation */
+          stable = FSAL_SAFE_WRITE_TO_FS;
+        }
+    }
 
-              /* BUGAZOMEU : write operation must NOT modify file's ctime */
-              pentry->object.file.attributes.ctime = pentry->object.file.attributes.mtime;
+  /* Buffered data in the range must reach the FSAL before it is read or overwritten */
+  if((stable == FSAL_SAFE_WRITE_TO_FS || stable == FSAL_UNSAFE_WRITE_TO_FS_BUFFER) &&
+     pentry->object.file.unstable_data != NULL &&
+     cache_inode_unstable_flush(pentry, seek_descriptor->offset, buffer_size,
+                                pclient, pcontext, pstatus) != CACHE_INODE_SUCCESS)
+    {
+      V_w(&pentry->lock);
 
-              *pio_size = buffer_size;
-            }
-          else
-            {
-              /* Go back to regular situation */
-              stable = FSAL_SAFE_WRITE_TO_FS;
-            }
-        }
+      /* stats */
+      pclient->stat.func_stats.nb_err_unrecover[statindex] += 1;
 
+      return *pstatus;
     }
+
   /* if( stable == FALSE ) */
   if(stable == FSAL_SAFE_WRITE_TO_FS ||
      stable == FSAL_UNSAFE_WRITE_TO_FS_BUFFER)
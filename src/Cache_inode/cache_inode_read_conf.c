@@ -57,6 +57,7 @@
 #include <time.h>
 #include <pthread.h>
 #include <string.h>
+#include <stdlib.h>
 
 /**
  *
@@ -131,6 +132,16 @@ cache_inode_status_t cache_inode_read_conf_hash_parameter(config_file_t in_confi
         {
           pparam->hparam.nb_node_prealloc = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Backend"))
+        {
+          if(HashTable_Str2Backend(key_value, &pparam->hparam.backend) != 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "Invalid value for %s: %s (item %s), expected RBT or Open_Addressing",
+                      key_name, key_value, CONF_LABEL_CACHE_INODE_HASH);
+              return CACHE_INODE_INVALID_ARGUMENT;
+            }
+        }
       else
         {
           LogCrit(COMPONENT_CONFIG,
@@ -325,6 +336,14 @@ cache_inode_status_t cache_inode_read_conf_client_parameter(config_file_t in_con
         {
           pparam->use_fsal_hash = StrToBoolean(key_value);
         }
+      else if(!strcasecmp(key_name, "Unstable_Write_Budget"))
+        {
+          pparam->unstable_budget = strtoull(key_value, NULL, 10);
+        }
+      else if(!strcasecmp(key_name, "Unstable_Flush_Delay"))
+        {
+          pparam->unstable_flush_delay = atoi(key_value);
+        }
       else if(!strcasecmp(key_name, "DebugLevel"))
         {
           DebugLevel = ReturnLevelAscii(key_value);
@@ -479,6 +498,8 @@ void cache_inode_print_conf_hash_parameter(FILE * output, cache_inode_parameter_
           param.hparam.alphabet_length);
   fprintf(output, "CacheInode Hash: Prealloc_Node_Pool_Size = %d\n",
           param.hparam.nb_node_prealloc);
+  fprintf(output, "CacheInode Hash: Backend                 = %s\n",
+          param.hparam.backend == HASHTABLE_BACKEND_OPEN ? "Open_Addressing" : "RBT");
 }                               /* cache_inode_print_conf_hash_parameter */
 
 /**
@@ -514,6 +535,10 @@ void cache_inode_print_conf_client_parameter(FILE * output,
           (int)param.grace_period_dirent);
   fprintf(output, "CacheInode Client: Use_Test_Access              = %d\n",
           param.use_test_access);
+  fprintf(output, "CacheInode Client: Unstable_Write_Budget        = %llu\n",
+          (unsigned long long)param.unstable_budget);
+  fprintf(output, "CacheInode Client: Unstable_Flush_Delay         = %d\n",
+          (int)param.unstable_flush_delay);
 }                               /* cache_inode_print_conf_client_parameter */
 
 /**
@@ -51,11 +51,301 @@
 #include "cache_inode.h"
 
 #include <unistd.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/param.h>
 #include <time.h>
 #include <pthread.h>
 
+/*
+ * The active dirents of a directory are indexed by the hash of their names, so
+ * that a lookup does not have to scan the whole dir_chain. The buckets hang off
+ * the DIR_BEGINNING and are chained through the dirent slots themselves. The
+ * free slots of the chain (up to the end of dir) are kept in a list too, so
+ * that adding a dirent does not have to scan the chain either.
+ */
+
+typedef struct cache_inode_dir_entry__ cache_inode_dirent_slot_t;
+
+static cache_entry_t *cache_inode_dir_begin_of(cache_entry_t * pdir_chain)
+{
+  if(pdir_chain->internal_md.type == DIR_CONTINUE)
+    return pdir_chain->object.dir_cont.pdir_begin;
+
+  return pdir_chain;
+}                               /* cache_inode_dir_begin_of */
+
+static cache_inode_dirent_slot_t *cache_inode_dir_slots_of(cache_entry_t * pdir_chain)
+{
+  if(pdir_chain->internal_md.type == DIR_CONTINUE)
+    return pdir_chain->object.dir_cont.pdir_data->dir_entries;
+
+  return pdir_chain->object.dir_begin.pdir_data->dir_entries;
+}                               /* cache_inode_dir_slots_of */
+
+static unsigned int cache_inode_dirent_hash(fsal_name_t * pname)
+{
+  unsigned int h = 2166136261U;
+  unsigned int i;
+
+  /* FNV-1a */
+  for(i = 0; i < pname->len && pname->name[i] != '\0'; i++)
+    {
+      h ^= (unsigned char)pname->name[i];
+      h *= 16777619U;
+    }
+
+  return h;
+}                               /* cache_inode_dirent_hash */
+
+static int cache_inode_dirent_index_grow(cache_entry_t * pentry_dir, unsigned int size)
+{
+  cache_inode_dirent_slot_t **new_index;
+  cache_inode_dirent_slot_t *pslot;
+  cache_inode_dirent_slot_t *pnext;
+  unsigned int i;
+
+  new_index =
+      (cache_inode_dirent_slot_t **) Mem_Alloc_Label(size *
+                                                     sizeof(cache_inode_dirent_slot_t *),
+                                                     "cache_inode_dir_index");
+  if(new_index == NULL)
+    return -1;
+
+  memset(new_index, 0, size * sizeof(cache_inode_dirent_slot_t *));
+
+  for(i = 0; i < pentry_dir->object.dir_begin.dir_index_size; i++)
+    for(pslot = pentry_dir->object.dir_begin.dir_index[i]; pslot != NULL; pslot = pnext)
+      {
+        pnext = pslot->next;
+        pslot->next = new_index[pslot->name_hash & (size - 1)];
+        new_index[pslot->name_hash & (size - 1)] = pslot;
+      }
+
+  if(pentry_dir->object.dir_begin.dir_index != NULL)
+    Mem_Free(pentry_dir->object.dir_begin.dir_index);
+
+  pentry_dir->object.dir_begin.dir_index = new_index;
+  pentry_dir->object.dir_begin.dir_index_size = size;
+
+  return 0;
+}                               /* cache_inode_dirent_index_grow */
+
+static int cache_inode_dirent_link(cache_entry_t * pentry_dir,
+                                   cache_inode_dirent_slot_t * pslot)
+{
+  unsigned int bucket;
+
+  /* Keep about one dirent per bucket. Failing to grow only makes the chains
+   * longer, unless there is no index at all */
+  if(pentry_dir->object.dir_begin.dir_index_count >=
+     pentry_dir->object.dir_begin.dir_index_size)
+    if(cache_inode_dirent_index_grow(pentry_dir,
+                                     pentry_dir->object.dir_begin.dir_index_size ?
+                                     pentry_dir->object.dir_begin.dir_index_size << 1 :
+                                     CACHE_INODE_DIR_INDEX_MIN) != 0
+       && pentry_dir->object.dir_begin.dir_index_size == 0)
+      return -1;
+
+  bucket = pslot->name_hash & (pentry_dir->object.dir_begin.dir_index_size - 1);
+  pslot->next = pentry_dir->object.dir_begin.dir_index[bucket];
+  pentry_dir->object.dir_begin.dir_index[bucket] = pslot;
+  pentry_dir->object.dir_begin.dir_index_count += 1;
+
+  return 0;
+}                               /* cache_inode_dirent_link */
+
+static void cache_inode_dirent_unlink(cache_entry_t * pentry_dir,
+                                      cache_inode_dirent_slot_t * pslot)
+{
+  cache_inode_dirent_slot_t **ppiter;
+
+  if(pentry_dir->object.dir_begin.dir_index_size == 0)
+    return;
+
+  for(ppiter =
+      &pentry_dir->object.dir_begin.dir_index[pslot->name_hash &
+                                              (pentry_dir->object.dir_begin.
+                                               dir_index_size - 1)]; *ppiter != NULL;
+      ppiter = &(*ppiter)->next)
+    if(*ppiter == pslot)
+      {
+        *ppiter = pslot->next;
+        pslot->next = NULL;
+        pentry_dir->object.dir_begin.dir_index_count -= 1;
+        return;
+      }
+}                               /* cache_inode_dirent_unlink */
+
+/* Makes the slots of a DIR_BEGINNING or DIR_CONTINUE free, the first slot
+ * being the first to be used */
+static void cache_inode_dirent_activate_chunk(cache_entry_t * pentry_dir,
+                                              cache_entry_t * pdir_chain)
+{
+  cache_inode_dirent_slot_t *pslots = cache_inode_dir_slots_of(pdir_chain);
+  int i;
+
+  for(i = CHILDREN_ARRAY_SIZE - 1; i >= 0; i--)
+    {
+      pslots[i].active = INVALID;
+      pslots[i].pentry = NULL;
+      pslots[i].pdir_chain = pdir_chain;
+      pslots[i].next = pentry_dir->object.dir_begin.pdir_free;
+      pentry_dir->object.dir_begin.pdir_free = &pslots[i];
+    }
+}                               /* cache_inode_dirent_activate_chunk */
+
+/* Makes room in pdir_chunks for the DIR_CONTINUE at position pos */
+static int cache_inode_dir_chunks_reserve(cache_entry_t * pentry_dir, unsigned int pos)
+{
+  cache_entry_t **new_chunks;
+  unsigned int size;
+
+  if(pos < pentry_dir->object.dir_begin.dir_chunks_size)
+    return 0;
+
+  for(size = pentry_dir->object.dir_begin.dir_chunks_size ?
+      pentry_dir->object.dir_begin.dir_chunks_size : CACHE_INODE_DIR_CHUNKS_MIN;
+      size <= pos; size <<= 1) ;
+
+  new_chunks = (cache_entry_t **) Mem_Alloc_Label(size * sizeof(cache_entry_t *),
+                                                  "cache_inode_dir_chunks");
+  if(new_chunks == NULL)
+    return -1;
+
+  memset(new_chunks, 0, size * sizeof(cache_entry_t *));
+
+  if(pentry_dir->object.dir_begin.pdir_chunks != NULL)
+    {
+      memcpy(new_chunks, pentry_dir->object.dir_begin.pdir_chunks,
+             pentry_dir->object.dir_begin.dir_chunks_size * sizeof(cache_entry_t *));
+      Mem_Free(pentry_dir->object.dir_begin.pdir_chunks);
+    }
+
+  pentry_dir->object.dir_begin.pdir_chunks = new_chunks;
+  pentry_dir->object.dir_begin.dir_chunks_size = size;
+
+  return 0;
+}                               /* cache_inode_dir_chunks_reserve */
+
+/**
+ *
+ * cache_inode_dirent_index_init: initializes the name index of a new DIR_BEGINNING.
+ *
+ * @param pentry_dir [INOUT] the DIR_BEGINNING, whose dirent array is already set.
+ *
+ * @return CACHE_INODE_SUCCESS (the buckets are only allocated with the first dirent)
+ *
+ */
+cache_inode_status_t cache_inode_dirent_index_init(cache_entry_t * pentry_dir)
+{
+  pentry_dir->object.dir_begin.dir_index = NULL;
+  pentry_dir->object.dir_begin.dir_index_size = 0;
+  pentry_dir->object.dir_begin.dir_index_count = 0;
+  pentry_dir->object.dir_begin.pdir_free = NULL;
+  pentry_dir->object.dir_begin.pdir_chunks = NULL;
+  pentry_dir->object.dir_begin.dir_chunks_size = 0;
+
+  cache_inode_dirent_activate_chunk(pentry_dir, pentry_dir);
+
+  return CACHE_INODE_SUCCESS;
+}                               /* cache_inode_dirent_index_init */
+
+/**
+ *
+ * cache_inode_dirent_index_release: frees the name index of a DIR_BEGINNING that is being released.
+ *
+ * @param pentry_dir [INOUT] the DIR_BEGINNING.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_dirent_index_release(cache_entry_t * pentry_dir)
+{
+  if(pentry_dir->object.dir_begin.dir_index != NULL)
+    Mem_Free(pentry_dir->object.dir_begin.dir_index);
+
+  pentry_dir->object.dir_begin.dir_index = NULL;
+  pentry_dir->object.dir_begin.dir_index_size = 0;
+  pentry_dir->object.dir_begin.dir_index_count = 0;
+  pentry_dir->object.dir_begin.pdir_free = NULL;
+
+  if(pentry_dir->object.dir_begin.pdir_chunks != NULL)
+    Mem_Free(pentry_dir->object.dir_begin.pdir_chunks);
+
+  pentry_dir->object.dir_begin.pdir_chunks = NULL;
+  pentry_dir->object.dir_begin.dir_chunks_size = 0;
+}                               /* cache_inode_dirent_index_release */
+
+/**
+ *
+ * cache_inode_dirent_index_find: looks up a name in the active dirents of a directory.
+ *
+ * The directory (its DIR_BEGINNING) is supposed to be locked by the caller.
+ *
+ * @param pentry_dir [IN] the DIR_BEGINNING, or one of its DIR_CONTINUE.
+ * @param pname      [IN] the name to look for.
+ *
+ * @return the dirent slot, or NULL if the name is not cached.
+ *
+ */
+cache_inode_dirent_slot_t *cache_inode_dirent_index_find(cache_entry_t * pentry_dir,
+                                                         fsal_name_t * pname)
+{
+  cache_inode_dirent_slot_t *pslot;
+  unsigned int h;
+
+  pentry_dir = cache_inode_dir_begin_of(pentry_dir);
+
+  if(pentry_dir->object.dir_begin.dir_index_size == 0)
+    return NULL;
+
+  h = cache_inode_dirent_hash(pname);
+
+  for(pslot =
+      pentry_dir->object.dir_begin.dir_index[h &
+                                             (pentry_dir->object.dir_begin.
+                                              dir_index_size - 1)]; pslot != NULL;
+      pslot = pslot->next)
+    if(pslot->name_hash == h && pslot->active == VALID
+       && !FSAL_namecmp(pname, &pslot->name))
+      return pslot;
+
+  return NULL;
+}                               /* cache_inode_dirent_index_find */
+
+/**
+ *
+ * cache_inode_invalidate_dirent: sets a dirent as invalid and frees its slot.
+ *
+ * The directory (its DIR_BEGINNING) is supposed to be locked by the caller.
+ *
+ * @param pdir_chain [INOUT] the DIR_BEGINNING or DIR_CONTINUE holding the dirent.
+ * @param slot       [IN]    position of the dirent in the dirent array.
+ *
+ * @return nothing (void function)
+ *
+ */
+void cache_inode_invalidate_dirent(cache_entry_t * pdir_chain, unsigned int slot)
+{
+  cache_entry_t *pentry_dir = cache_inode_dir_begin_of(pdir_chain);
+  cache_inode_dirent_slot_t *pslot = &cache_inode_dir_slots_of(pdir_chain)[slot];
+
+  if(pslot->active != VALID)
+    return;
+
+  cache_inode_dirent_unlink(pentry_dir, pslot);
+  pslot->active = INVALID;
+
+  if(pdir_chain->internal_md.type == DIR_CONTINUE)
+    pdir_chain->object.dir_cont.nbactive -= 1;
+  else
+    pdir_chain->object.dir_begin.nbactive -= 1;
+
+  pslot->next = pentry_dir->object.dir_begin.pdir_free;
+  pentry_dir->object.dir_begin.pdir_free = pslot;
+}                               /* cache_inode_invalidate_dirent */
+
 /**
  *
  * cache_inode_operate_cached_dirent: locates a dirent in the cached dirent, and perform an operation on it.
@@ -79,10 +369,10 @@ cache_entry_t *cache_inode_operate_cached_dirent(cache_entry_t * pentry_parent,
                                                  cache_inode_dirent_op_t dirent_op,
                                                  cache_inode_status_t * pstatus)
 {
-  cache_entry_t *pdir_chain = NULL;
+  cache_entry_t *pentry_dir = NULL;
+  cache_inode_dirent_slot_t *pslot = NULL;
   cache_entry_t *pentry = NULL;
   fsal_status_t fsal_status;
-  int i = 0;
 
   /* Set the return default to CACHE_INODE_SUCCESS */
   *pstatus = CACHE_INODE_SUCCESS;
@@ -96,159 +386,67 @@ cache_entry_t *cache_inode_operate_cached_dirent(cache_entry_t * pentry_parent,
       return NULL;
     }
 
-  /* Try to look into the dir and its dir_cont. At this point, it must be said than lock on dir_cont are
-   *  taken when a lock is previously acquired on the related dir_begin */
-  pdir_chain = pentry_parent;
+  /* The whole dir_chain is indexed in the DIR_BEGINNING. At this point, it must be said than lock on
+   * dir_cont are taken when a lock is previously acquired on the related dir_begin */
+  pentry_dir = cache_inode_dir_begin_of(pentry_parent);
 
-  do
-    {
-      /* Is this entry known ? */
-      if(pdir_chain->internal_md.type == DIR_BEGINNING)
-        {
-          for(i = 0; i < CHILDREN_ARRAY_SIZE; i++)
-            {
+  pslot = cache_inode_dirent_index_find(pentry_dir, pname);
 
-              LogFullDebug(COMPONENT_NFS_READDIR,
-                           "DIR_BEGINNING %d | %d | %s | %s",
-                           pdir_chain->object.dir_begin.pdir_data->dir_entries[i].active,
-                           pdir_chain->object.dir_begin.pdir_data->dir_entries[i].pentry->
-                           internal_md.valid_state, pname->name,
-                           pdir_chain->object.dir_begin.pdir_data->dir_entries[i].name.name);
-
-              if(pdir_chain->object.dir_begin.pdir_data->dir_entries[i].active == VALID
-                 && pdir_chain->object.dir_begin.pdir_data->dir_entries[i].pentry->
-                 internal_md.valid_state == VALID
-                 && !FSAL_namecmp(pname,
-                                  &(pdir_chain->object.dir_begin.pdir_data->
-                                    dir_entries[i].name)))
-                {
-                  /* Entry was found */
-                  pentry = pdir_chain->object.dir_begin.pdir_data->dir_entries[i].pentry;
-                  *pstatus = CACHE_INODE_SUCCESS;
-                  break;
-                }
-            }
+  if(pslot == NULL || pslot->pentry->internal_md.valid_state != VALID)
+    {
+      *pstatus = CACHE_INODE_NOT_FOUND;
+      return NULL;
+    }
 
-          if(pentry != NULL)
-            break;              /* Exit the do...while loop */
+  pentry = pslot->pentry;
 
-          /* Do we have to go on browsing the cache_inode ? */
-          /* We have to check if eod is reached and no pentry found */
-          if(pdir_chain->object.dir_begin.end_of_dir == END_OF_DIR)
-            {
-              pentry = NULL;
-              *pstatus = CACHE_INODE_NOT_FOUND;
-              break;
-            }
+  LogFullDebug(COMPONENT_NFS_READDIR,
+               "Cached dirent %s found in %p, entry=%p", pname->name, pslot->pdir_chain,
+               pentry);
 
-          /* Next step, release the lock and acquire a new one */
-          pdir_chain = pdir_chain->object.dir_begin.pdir_cont;
-        }
-      else
-        {
-          /* Entry is no DIR_BEGINNING, it is of type DIR_CONTINUE */
-          for(i = 0; i < CHILDREN_ARRAY_SIZE; i++)
-            {
-              /*
-                 printf( "DIR_CONTINUE %d | %d | %s | %s\n",
-                 pdir_chain->object.dir_cont.pdir_data->dir_entries[i].active,
-                 pdir_chain->object.dir_cont.pdir_data->dir_entries[i].pentry->internal_md.valid_state,
-                 name.name,
-                 pdir_chain->object.dir_cont.pdir_data->dir_entries[i].name.name ) ; */
-
-              if(pdir_chain->object.dir_cont.pdir_data->dir_entries[i].active == VALID &&
-                 pdir_chain->object.dir_cont.pdir_data->dir_entries[i].pentry->
-                 internal_md.valid_state == VALID
-                 && !FSAL_namecmp(pname,
-                                  &(pdir_chain->object.dir_cont.pdir_data->
-                                    dir_entries[i].name)))
-                {
-                  /* Entry was found */
-                  pentry = pdir_chain->object.dir_cont.pdir_data->dir_entries[i].pentry;
-                  *pstatus = CACHE_INODE_SUCCESS;
-                  break;
-                }
-            }
+  switch (dirent_op)
+    {
+    case CACHE_INODE_DIRENT_OP_LOOKUP:
+      break;
 
-          if(pentry != NULL)
-            break;              /* Exit the do...while loop */
+    case CACHE_INODE_DIRENT_OP_REMOVE:
+      /* The dirent entry is removed by being set invalid */
+      cache_inode_invalidate_dirent(pslot->pdir_chain,
+                                    pslot - cache_inode_dir_slots_of(pslot->pdir_chain));
+      *pstatus = CACHE_INODE_SUCCESS;
+      break;
 
-          /* Do we have to go on browsing the cache_inode ? */
-          if(pdir_chain->object.dir_cont.end_of_dir == END_OF_DIR)
-            {
-              pentry = NULL;
-              *pstatus = CACHE_INODE_NOT_FOUND;
-              break;
-            }
-          /* Next step */
-          pdir_chain = pdir_chain->object.dir_cont.pdir_cont;
-        }
+    case CACHE_INODE_DIRENT_OP_RENAME:
+      /* The name changes, so does the bucket */
+      cache_inode_dirent_unlink(pentry_dir, pslot);
 
-    }
-  while(pentry == NULL);
+      fsal_status = FSAL_namecpy(&pslot->name, newname);
 
-  /* Did we find something */
-  if(pentry != NULL)
-    {
-      /* Yes, we did ! */
-      switch (dirent_op)
+      pslot->name_hash = cache_inode_dirent_hash(&pslot->name);
+      if(cache_inode_dirent_link(pentry_dir, pslot) != 0)
         {
-        case CACHE_INODE_DIRENT_OP_REMOVE:
-          /* Related DIR_BEGINNING or DIR_CONTINUE is pointed by pdir_chain, entry is the i-th is dir_entries
-           * The dirent entry is removed by being set invalid */
-
-          if(pdir_chain->internal_md.type == DIR_BEGINNING)
-            {
-              pdir_chain->object.dir_begin.pdir_data->dir_entries[i].active = INVALID;
-              pdir_chain->object.dir_begin.nbactive -= 1;
-              *pstatus = CACHE_INODE_SUCCESS;
-            }
-          else if(pdir_chain->internal_md.type == DIR_CONTINUE)
-            {
-              pdir_chain->object.dir_cont.pdir_data->dir_entries[i].active = INVALID;
-              pdir_chain->object.dir_cont.nbactive -= 1;
-              *pstatus = CACHE_INODE_SUCCESS;
-            }
-          else
-            *pstatus = CACHE_INODE_INVALID_ARGUMENT;
-          break;
-
-        case CACHE_INODE_DIRENT_OP_RENAME:
-          /* Entry to rename is the i-th in pdir_chain */
-          if(pdir_chain->internal_md.type == DIR_BEGINNING)
-            {
-              fsal_status =
-                  FSAL_namecpy(&
-                               (pdir_chain->object.dir_begin.pdir_data->dir_entries[i].
-                                name), newname);
-            }
-          else
-            {
-              fsal_status =
-                  FSAL_namecpy(&
-                               (pdir_chain->object.dir_cont.pdir_data->dir_entries[i].
-                                name), newname);
-            }
-
-          if(FSAL_IS_ERROR(fsal_status))
-            {
-              *pstatus = cache_inode_error_convert(fsal_status);
-            }
-          else
-            {
-              *pstatus = CACHE_INODE_SUCCESS;
-            }
-          break;
+          /* Could not happen, the index already exists */
+          LogCrit(COMPONENT_CACHE_INODE,
+                  "cache_inode_operate_cached_dirent: could not index renamed dirent %s",
+                  newname->name);
+        }
 
-        default:
-          /* Should never occurs, in any case, it cost nothing to handle this situation */
-          *pstatus = CACHE_INODE_INVALID_ARGUMENT;
-          break;
+      if(FSAL_IS_ERROR(fsal_status))
+        {
+          *pstatus = cache_inode_error_convert(fsal_status);
+        }
+      else
+        {
+          *pstatus = CACHE_INODE_SUCCESS;
+        }
+      break;
 
-        }                       /* switch */
-    }
+    default:
+      /* Should never occurs, in any case, it cost nothing to handle this situation */
+      *pstatus = CACHE_INODE_INVALID_ARGUMENT;
+      break;
 
-  /* Last lock released */
+    }                           /* switch */
 
   return pentry;
 }                               /* cache_inode_operate_cached_dirent */
@@ -319,13 +517,14 @@ cache_inode_status_t cache_inode_add_cached_dirent(cache_entry_t * pentry_parent
                                                    fsal_op_context_t * pcontext,
                                                    cache_inode_status_t * pstatus)
 {
+  cache_entry_t *pentry_dir = NULL;
   cache_entry_t *pdir_chain = NULL;
   cache_entry_t *pentry = NULL;
+  cache_inode_dirent_slot_t *pslot = NULL;
   fsal_status_t fsal_status;
   cache_inode_fsal_data_t fsdata;
   cache_inode_parent_entry_t *next_parent_entry = NULL;
 
-  int i = 0;
   int slot_index = 0;
 
   /* For the moment, we add no error...
@@ -340,97 +539,18 @@ cache_inode_status_t cache_inode_add_cached_dirent(cache_entry_t * pentry_parent
       return *pstatus;
     }
 
-  /* We don't known where to write, we have to seek for an empty place */
-  /* Search loop. We look for an empty slot in a dirent array */
-  pdir_chain = pentry_parent;
-  do
-    {
-
-      if(pdir_chain->internal_md.type == DIR_BEGINNING)
-        {
-          /* DIR_BEGINNING management */
-
-          if(pdir_chain->object.dir_begin.nbactive != CHILDREN_ARRAY_SIZE)
-            {
-              for(i = 0; i < CHILDREN_ARRAY_SIZE; i++)
-                {
-                  if(pdir_chain->object.dir_begin.pdir_data->dir_entries[i].active ==
-                     INVALID
-                     || pdir_chain->object.dir_begin.pdir_data->dir_entries[i].pentry ==
-                     NULL)
-                    {
-                      /* slot found */
-                      pentry = pdir_chain;
-                      slot_index = i;
-                      break;
-                    }
-                }
-            }
+  pentry_dir = cache_inode_dir_begin_of(pentry_parent);
 
-          /* Next step */
-          if(pdir_chain->object.dir_begin.end_of_dir == END_OF_DIR)
-            {
-              /* Entry was not found, break the main loop */
-              break;
-            }
-          else
-            {
-              pdir_chain = pdir_chain->object.dir_begin.pdir_cont;
-            }
-
-        }
-      else if(pdir_chain->internal_md.type == DIR_CONTINUE)
-        {
-          /* DIR_CONTINUE management */
-
-          if(pdir_chain->object.dir_cont.nbactive != CHILDREN_ARRAY_SIZE)
-            {
-              for(i = 0; i < CHILDREN_ARRAY_SIZE; i++)
-                {
-                  if(pdir_chain->object.dir_cont.pdir_data->dir_entries[i].active ==
-                     INVALID
-                     || pdir_chain->object.dir_cont.pdir_data->dir_entries[i].pentry ==
-                     NULL)
-                    {
-                      pentry = pdir_chain;
-                      slot_index = i;
-                      break;
-                    }
-                }
-            }
-
-          /* Next step */
-          if(pdir_chain->object.dir_cont.end_of_dir == END_OF_DIR)
-            {
-              /* Entry was not found, break the main loop */
-              break;
-            }
-          else
-            {
-              pdir_chain = pdir_chain->object.dir_cont.pdir_cont;
-            }
-        }
-      else
-        {
-          /* entry not found */
-          LogCrit(COMPONENT_CACHE_INODE,
-                  "cache_inode_add_cached_dirent: Critical Warning: a non-directory type has been detected in a dir_chain !!!");
-          *pstatus = CACHE_INODE_BAD_TYPE;
-          return *pstatus;
-        }
-
-    }
-  while(pentry == NULL);
-
-  /* If pentry is NULL, all the dirent are full and a new entry is needed */
-  if(pentry == NULL)
+  /* If no slot is free, all the dirent are full and a new entry is needed */
+  if(pentry_dir->object.dir_begin.pdir_free == NULL)
     {
-      /* Pointer pentry is NULL, a new entry DIR_CONTINUE is required */
-
-      /* There may be previously invalidated dirents, in this case pdir_cont already exists
+      /* The new DIR_CONTINUE goes after the last one in use. There may be previously
+       * invalidated dirents, in this case pdir_cont already exists
        * we won't allocate new things in this case and reuse the old ones
        * This case is identified by pdir_chain->object.*.pdir_cont != NULL
        */
+      pdir_chain = pentry_dir->object.dir_begin.pdir_last;
+
       switch (pdir_chain->internal_md.type)
         {
         case DIR_BEGINNING:
@@ -453,6 +573,14 @@ cache_inode_status_t cache_inode_add_cached_dirent(cache_entry_t * pentry_parent
           return *pstatus;
         }
 
+      /* The new DIR_CONTINUE will be found by readdir at its position in pdir_chunks */
+      if(cache_inode_dir_chunks_reserve(pentry_dir,
+                                        pentry_dir->object.dir_begin.nbdircont + 1) != 0)
+        {
+          *pstatus = CACHE_INODE_MALLOC_ERROR;
+          return *pstatus;
+        }
+
       /* Allocate a new DIR_CONTINUE to the dir chain if needed */
       if(pentry == NULL)
         {
@@ -475,25 +603,19 @@ cache_inode_status_t cache_inode_add_cached_dirent(cache_entry_t * pentry_parent
                  so it is not propagated to caller */
               *pstatus = 0;
             }
-          }
+        }
 
       /* Chain the new entry with the pdir_chain */
       switch (pdir_chain->internal_md.type)
         {
         case DIR_BEGINNING:
           pdir_chain->object.dir_begin.pdir_cont = pentry;
-          pdir_chain->object.dir_begin.pdir_last = pentry;
           pdir_chain->object.dir_begin.end_of_dir = TO_BE_CONTINUED;
-          pdir_chain->object.dir_begin.nbdircont += 1;
           break;
 
         case DIR_CONTINUE:
           pdir_chain->object.dir_cont.pdir_cont = pentry;
-
           pdir_chain->object.dir_cont.end_of_dir = TO_BE_CONTINUED;
-
-          pdir_chain->object.dir_cont.pdir_begin->object.dir_begin.pdir_last = pentry;
-          pdir_chain->object.dir_cont.pdir_begin->object.dir_begin.nbdircont += 1;
           break;
 
         default:
@@ -504,11 +626,21 @@ cache_inode_status_t cache_inode_add_cached_dirent(cache_entry_t * pentry_parent
           return *pstatus;
         }
 
-      /* slot to be used in the dirent array will be the first */
-      slot_index = 0;
+      /* A reused DIR_CONTINUE is the end of the chain again */
+      pentry->object.dir_cont.end_of_dir = END_OF_DIR;
+      pentry->object.dir_cont.nbactive = 0;
+
+      pentry_dir->object.dir_begin.pdir_last = pentry;
+      pentry_dir->object.dir_begin.nbdircont += 1;
+      pentry_dir->object.dir_begin.pdir_chunks[pentry->object.dir_cont.dir_cont_pos] = pentry;
+
+      cache_inode_dirent_activate_chunk(pentry_dir, pentry);
     }
 
-  /* pentry is not NULL, if it was NULL a new DIR_CONTINUE has just been allocated */
+  /* Take the first free slot */
+  pslot = pentry_dir->object.dir_begin.pdir_free;
+  pentry = pslot->pdir_chain;
+  slot_index = pslot - cache_inode_dir_slots_of(pentry);
 
   GetFromPool(next_parent_entry, &pclient->pool_parent, cache_inode_parent_entry_t);
 
@@ -524,44 +656,36 @@ cache_inode_status_t cache_inode_add_cached_dirent(cache_entry_t * pentry_parent
   next_parent_entry->parent = NULL;
   next_parent_entry->next_parent = NULL;
 
-  if(pentry->internal_md.type == DIR_BEGINNING)
+  fsal_status = FSAL_namecpy(&pslot->name, pname);
+  if(FSAL_IS_ERROR(fsal_status))
     {
-      pentry->object.dir_begin.nbactive += 1;
+      ReleaseToPool(next_parent_entry, &pclient->pool_parent);
+      *pstatus = CACHE_INODE_FSAL_ERROR;
+      pentry = NULL;
+      return *pstatus;
+    }
 
-      pentry->object.dir_begin.pdir_data->dir_entries[slot_index].active = VALID;
-      pentry->object.dir_begin.pdir_data->dir_entries[slot_index].pentry = pentry_added;
+  pslot->name_hash = cache_inode_dirent_hash(&pslot->name);
+  pentry_dir->object.dir_begin.pdir_free = pslot->next;
 
-      fsal_status =
-          FSAL_namecpy(&pentry->object.dir_begin.pdir_data->dir_entries[slot_index].name,
-                       pname);
-      if(FSAL_IS_ERROR(fsal_status))
-        {
-          *pstatus = CACHE_INODE_FSAL_ERROR;
-          pentry->object.dir_begin.nbactive -= 1;
-          pentry = NULL;
-          return *pstatus;
-        }
-    }
-  else
+  if(cache_inode_dirent_link(pentry_dir, pslot) != 0)
     {
-      /* DIR_CONTINUE */
-      pentry->object.dir_cont.nbactive += 1;
-
-      pentry->object.dir_cont.pdir_data->dir_entries[slot_index].active = VALID;
-      pentry->object.dir_cont.pdir_data->dir_entries[slot_index].pentry = pentry_added;
+      /* Give the slot back */
+      pslot->next = pentry_dir->object.dir_begin.pdir_free;
+      pentry_dir->object.dir_begin.pdir_free = pslot;
+      ReleaseToPool(next_parent_entry, &pclient->pool_parent);
+      *pstatus = CACHE_INODE_MALLOC_ERROR;
+      pentry = NULL;
+      return *pstatus;
+    }
 
-      fsal_status =
-          FSAL_namecpy(&pentry->object.dir_cont.pdir_data->dir_entries[slot_index].name,
-                       pname);
-      if(FSAL_IS_ERROR(fsal_status))
-        {
-          *pstatus = CACHE_INODE_FSAL_ERROR;
-          pentry->object.dir_cont.nbactive -= 1;
-          pentry = NULL;
-          return *pstatus;
-        }
+  pslot->active = VALID;
+  pslot->pentry = pentry_added;
 
-    }
+  if(pentry->internal_md.type == DIR_BEGINNING)
+    pentry->object.dir_begin.nbactive += 1;
+  else
+    pentry->object.dir_cont.nbactive += 1;
 
   /* link with the parent entry (insert as first entry) */
   next_parent_entry->subdirpos = slot_index;
@@ -629,9 +753,20 @@ cache_inode_status_t cache_inode_invalidate_all_cached_dirent(cache_entry_t * pe
       pentry = pentry->object.dir_cont.pdir_cont;
     }
 
+  /* Empty the name index, the DIR_CONTINUE are kept to be reused */
+  if(pentry_dir->object.dir_begin.dir_index != NULL)
+    memset(pentry_dir->object.dir_begin.dir_index, 0,
+           pentry_dir->object.dir_begin.dir_index_size *
+           sizeof(cache_inode_dirent_slot_t *));
+  pentry_dir->object.dir_begin.dir_index_count = 0;
+  pentry_dir->object.dir_begin.pdir_free = NULL;
+  cache_inode_dirent_activate_chunk(pentry_dir, pentry_dir);
+
   /* Reinit the fields */
   pentry_dir->object.dir_begin.has_been_readdir = CACHE_INODE_NO;
   pentry_dir->object.dir_begin.end_of_dir = END_OF_DIR;
+  pentry_dir->object.dir_begin.pdir_last = pentry_dir;
+  pentry_dir->object.dir_begin.nbdircont = 0;
   *pstatus = CACHE_INODE_SUCCESS;
 
   return *pstatus;
@@ -999,6 +1134,7 @@ cache_inode_status_t cache_inode_readdir(cache_entry_t * dir_pentry,
                                          cache_inode_status_t * pstatus)
 {
   cache_inode_flag_t tstflag;
+  cache_entry_t *pentry_dir;
   cache_entry_t *pentry_iter;
   cache_entry_t *pentry_to_read;
   unsigned int first_pentry_cookie = 0;
@@ -1151,80 +1287,50 @@ cache_inode_status_t cache_inode_readdir(cache_entry_t * dir_pentry,
       /* First call: the two first entries should be '.' and '..' */
     }
 
-  /* loop into the dirent array to locate the pdir_chain item related to the input cookie */
-  nbdirchain = 0;
-  pentry_to_read = dir_pentry;
-
-  while(cookie - first_pentry_cookie >= CHILDREN_ARRAY_SIZE)    /* ????? */
-    {
-      nbdirchain += 1;
-
-      if(pentry_to_read->internal_md.type == DIR_BEGINNING)
-        {
-          /* if cookie - first_pentry_cookie is bigger than  CHILDREN_ARRAY_SIZE
-           * then the provided cookie was far too big for this pdir_chain. The
-           * client to cache_inode tried to read beyond the end of directory.
-           * In this case, return that EOD was met, but no entries found. */
-
-          if(pentry_to_read->object.dir_begin.end_of_dir == END_OF_DIR)
-            {
-              /* stats */
-              pclient->stat.func_stats.nb_success[CACHE_INODE_READDIR] += 1;
-
-              if(pentry_to_read->internal_md.type == DIR_BEGINNING)
-                *pstatus = cache_inode_valid(pentry_to_read, CACHE_INODE_OP_GET, pclient);
-              else
-                *pstatus = CACHE_INODE_SUCCESS;
+  /* Locate the pdir_chain item related to the input cookie: the DIR_CONTINUE at
+   * position cookie / CHILDREN_ARRAY_SIZE in the dir_chain */
+  if(dir_pentry->internal_md.type == DIR_BEGINNING)
+    pentry_dir = dir_pentry;
+  else
+    pentry_dir = dir_pentry->object.dir_cont.pdir_begin;
 
-              V_r(&dir_pentry->lock);
+  nbdirchain = cookie / CHILDREN_ARRAY_SIZE;
 
-              LogFullDebug(COMPONENT_NFS_READDIR,
-                           "Big input cookie found in cache_inode_readdir (DIR_BEGIN) : pentry=%p cookie=%d first_pentry_cookie=%d nbdirchain=%d",
-                           pentry_to_read, cookie,
-                           first_pentry_cookie, nbdirchain);
+  if(cookie < first_pentry_cookie ||
+     nbdirchain > pentry_dir->object.dir_begin.nbdircont)
+    {
+      /* The provided cookie was far too big for this pdir_chain. The
+       * client to cache_inode tried to read beyond the end of directory.
+       * In this case, return that EOD was met, but no entries found. */
 
-              /* Set the returned values */
-              *pnbfound = 0;
-              *pend_cookie = cookie;
-              *peod_met = END_OF_DIR;
+      /* stats */
+      pclient->stat.func_stats.nb_success[CACHE_INODE_READDIR] += 1;
 
-              return *pstatus;
-            }
-          pentry_iter = pentry_to_read->object.dir_begin.pdir_cont;
-        }
+      if(dir_pentry->internal_md.type == DIR_BEGINNING)
+        *pstatus = cache_inode_valid(dir_pentry, CACHE_INODE_OP_GET, pclient);
       else
-        {
-          if(pentry_to_read->object.dir_cont.end_of_dir == END_OF_DIR)
-            {
-              V_r(&dir_pentry->lock);
+        *pstatus = CACHE_INODE_SUCCESS;
 
-              /* stats */
-              pclient->stat.func_stats.nb_success[CACHE_INODE_READDIR] += 1;
+      V_r(&dir_pentry->lock);
 
-              /* OPeration is a success */
-              *pstatus = CACHE_INODE_SUCCESS;
-              LogFullDebug(COMPONENT_NFS_READDIR,
-                           "Trouble found in cache_inode_readdir (DIR_CONTINUE) : pentry=%p cookie=%d first_pentry_cookie=%d nbdirchain=%d",
-                           pentry_to_read, cookie,
-                           first_pentry_cookie, nbdirchain);
-              /* Set the returned values */
-              *pnbfound = 0;
-              *pend_cookie = cookie;
-              *peod_met = END_OF_DIR;
+      LogFullDebug(COMPONENT_NFS_READDIR,
+                   "Big input cookie found in cache_inode_readdir : pentry=%p cookie=%d first_pentry_cookie=%d nbdirchain=%d",
+                   dir_pentry, cookie, first_pentry_cookie, nbdirchain);
 
-              return *pstatus;
-            }
-          pentry_iter = pentry_to_read->object.dir_cont.pdir_cont;
-        }
+      /* Set the returned values */
+      *pnbfound = 0;
+      *pend_cookie = cookie;
+      *peod_met = END_OF_DIR;
 
-      pentry_to_read = pentry_iter;
+      return *pstatus;
+    }
 
-      /* At this step, pentry can't be something different of a DIR_CONTINUE,
-       * becase  cookie - first_pentry_cookie >= CHILDREN_ARRAY_SIZE */
-      first_pentry_cookie =
-          pentry_to_read->object.dir_cont.dir_cont_pos * CHILDREN_ARRAY_SIZE;
+  if(nbdirchain == 0)
+    pentry_to_read = pentry_dir;
+  else
+    pentry_to_read = pentry_dir->object.dir_begin.pdir_chunks[nbdirchain];
 
-    }                           /* while */
+  first_pentry_cookie = nbdirchain * CHILDREN_ARRAY_SIZE;
 
   LogFullDebug(COMPONENT_NFS_READDIR,
                "About to readdir in  cache_inode_readdir: pentry=%p cookie=%d first_pentry_cookie=%d nbdirchain=%d",
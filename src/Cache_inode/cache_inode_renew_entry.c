@@ -600,3 +600,65 @@ cache_inode_status_t cache_inode_renew_entry(cache_entry_t * pentry,
            *pstatus, cache_inode_err_str(*pstatus));
   return *pstatus;
 }                               /* cache_inode_renew_entry */
+
+/**
+ *
+ * cache_inode_renew_needed: Tells if cache_inode_renew_entry would renew an entry.
+ *
+ * Follows the tests of cache_inode_renew_entry, so that an entry whose cached
+ * attributes are still within their grace period can be read without locking
+ * it. The entry doesn't need to be locked: the caller validates what it read
+ * against the sequence of the entry lock.
+ *
+ * @param pentry [IN] entry to be checked.
+ * @param pclient [IN] ressource allocated by the client for the nfs management.
+ * @param now [IN] the current time.
+ *
+ * @return TRUE if the entry may have to be renewed, FALSE if it is fresh.
+ *
+ */
+int cache_inode_renew_needed(cache_entry_t * pentry,
+                             cache_inode_client_t * pclient, time_t now)
+{
+  time_t elapsed = now - pentry->internal_md.refresh_time;
+
+  switch (pentry->internal_md.type)
+    {
+    case REGULAR_FILE:
+      /* Entries with cached data never expire */
+      if(pentry->object.file.pentry_content != NULL)
+        return FALSE;
+      break;
+
+    case SYMBOLIC_LINK:
+      if(pclient->expire_type_link != CACHE_INODE_EXPIRE_NEVER &&
+         elapsed >= pclient->grace_period_link)
+        return TRUE;
+      break;
+
+    case DIR_BEGINNING:
+      /* getattr/mtime checking asks the FSAL every time */
+      if(pclient->getattr_dir_invalidation &&
+         FSAL_TEST_MASK(pclient->attrmask, FSAL_ATTR_MTIME))
+        return TRUE;
+
+      if(pentry->object.dir_begin.has_been_readdir == CACHE_INODE_YES)
+        return pclient->expire_type_dirent != CACHE_INODE_EXPIRE_NEVER &&
+            elapsed >= pclient->grace_period_dirent;
+
+      return pclient->expire_type_attr != CACHE_INODE_EXPIRE_NEVER &&
+          elapsed >= pclient->grace_period_attr;
+
+    case SOCKET_FILE:
+    case FIFO_FILE:
+    case CHARACTER_FILE:
+    case BLOCK_FILE:
+      break;
+
+    default:
+      return TRUE;
+    }
+
+  return pclient->expire_type_attr != CACHE_INODE_EXPIRE_NEVER &&
+      elapsed >= pclient->grace_period_attr;
+}                               /* cache_inode_renew_needed */
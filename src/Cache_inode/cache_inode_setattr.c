@@ -216,6 +216,9 @@ cache_inode_status_t cache_inode_setattr(cache_entry_t * pentry, fsal_attrib_lis
           return *pstatus;
         }
 
+      /* Buffered unstable writes beyond the new end of file are dropped */
+      if(pentry->internal_md.type == REGULAR_FILE)
+        cache_inode_unstable_truncate(pentry, pattr->filesize);
     }
 
   /* Keep the new attribute in cache */
@@ -185,6 +185,9 @@ cache_inode_status_t cache_inode_truncate_sw(cache_entry_t * pentry,
 
           return *pstatus;
         }
+
+      /* Buffered unstable writes beyond the new end of file are dropped */
+      cache_inode_unstable_truncate(pentry, length);
     }
 
 
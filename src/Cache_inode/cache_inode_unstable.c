@@ -0,0 +1,639 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    cache_inode_unstable.c
+ * \brief   Write-behind of the unstable writes.
+ *
+ * cache_inode_unstable.c : keeps the unstable writes made to the Ganesha
+ * write buffer as a sorted list of dirty extents per file. Adjacent and
+ * overlapping writes are merged in memory, an extent never crosses a multiple
+ * of CACHE_INODE_UNSTABLE_EXTENT_SIZE so that a sequential stream is flushed
+ * with large aligned FSAL_write calls. All the files share a single memory
+ * budget; the files with dirty data are chained in a list walked by the
+ * flusher thread.
+ *
+ * Locking: the extents of a file are protected by the entry's lock, the list
+ * of dirty files by unstable_mutex. A thread holding unstable_mutex never
+ * waits for an entry's lock (see cache_inode_unstable_flush_pass).
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif                          /* _SOLARIS */
+
+#include "fsal.h"
+
+#include "LRU_List.h"
+#include "log_macros.h"
+#include "HashData.h"
+#include "HashTable.h"
+#include "cache_inode.h"
+#include "stuff_alloc.h"
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+static pthread_mutex_t unstable_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t unstable_cond = PTHREAD_COND_INITIALIZER;
+
+/* Files with dirty extents, protected by unstable_mutex */
+static cache_inode_unstable_data_t *unstable_dirty_list = NULL;
+static unsigned int unstable_pass = 0;
+
+static fsal_size_t unstable_budget = CACHE_INODE_UNSTABLE_BUDGET;
+static time_t unstable_flush_delay = CACHE_INODE_UNSTABLE_FLUSH_DELAY;
+
+/* Memory allocated for the extents of all the files */
+static fsal_size_t unstable_bytes = 0;
+
+/**
+ *
+ * cache_inode_unstable_set_policy: sets the memory budget and flush delay of the unstable writes.
+ *
+ * @param budget [IN] memory that the buffered unstable writes may use, for all the files.
+ * @param flush_delay [IN] seconds after the last write before a file is flushed.
+ *
+ * @return nothing (void function).
+ *
+ */
+void cache_inode_unstable_set_policy(fsal_size_t budget, time_t flush_delay)
+{
+  unstable_budget = budget;
+  unstable_flush_delay = flush_delay;
+}                               /* cache_inode_unstable_set_policy */
+
+time_t cache_inode_unstable_get_flush_delay(void)
+{
+  return unstable_flush_delay;
+}                               /* cache_inode_unstable_get_flush_delay */
+
+static uint32_t unstable_capacity(fsal_size_t length)
+{
+  uint32_t capacity = CACHE_INODE_UNSTABLE_EXTENT_MIN;
+
+  while(capacity < length && capacity < CACHE_INODE_UNSTABLE_EXTENT_SIZE)
+    capacity <<= 1;
+
+  return capacity;
+}                               /* unstable_capacity */
+
+static void unstable_extent_free(cache_inode_unstable_extent_t * pext)
+{
+  __sync_fetch_and_sub(&unstable_bytes, (fsal_size_t) pext->capacity);
+
+  Mem_Free(pext->buffer);
+  Mem_Free(pext);
+}                               /* unstable_extent_free */
+
+/**
+ *
+ * unstable_merge: adds a write to the extents of a file.
+ *
+ * The write must not cross a multiple of CACHE_INODE_UNSTABLE_EXTENT_SIZE. It is
+ * merged with the extents of the same aligned chunk it overlaps or touches, the new
+ * data superseding the buffered one.
+ *
+ * @return TRUE if the write was buffered, FALSE if memory could not be allocated.
+ *
+ */
+static int unstable_merge(cache_inode_unstable_data_t * pudata,
+                          uint64_t offset, uint32_t length, caddr_t buffer)
+{
+  cache_inode_unstable_extent_t **ppext;
+  cache_inode_unstable_extent_t *pext;
+  cache_inode_unstable_extent_t *plast;
+  cache_inode_unstable_extent_t *pnext;
+  uint64_t chunk_start = offset - offset % CACHE_INODE_UNSTABLE_EXTENT_SIZE;
+  uint64_t chunk_end = chunk_start + CACHE_INODE_UNSTABLE_EXTENT_SIZE;
+  uint64_t low;
+  uint64_t high;
+  uint32_t capacity;
+  caddr_t newbuf;
+
+  /* First extent ending at or after the write, in the same chunk */
+  ppext = &pudata->extents;
+  while(*ppext != NULL &&
+        ((*ppext)->offset < chunk_start ||
+         (*ppext)->offset + (*ppext)->length < offset))
+    ppext = &(*ppext)->next;
+
+  pext = *ppext;
+
+  if(pext == NULL || pext->offset > offset + length || pext->offset >= chunk_end)
+    {
+      /* Nothing to merge with, insert a new extent */
+      capacity = unstable_capacity(length);
+
+      if((pext = (cache_inode_unstable_extent_t *)
+          Mem_Alloc_Label(sizeof(cache_inode_unstable_extent_t),
+                          "cache_inode_unstable_extent_t")) == NULL)
+        return FALSE;
+
+      if((pext->buffer = Mem_Alloc_Label(capacity, "Cache_Inode Unstable Buffer")) == NULL)
+        {
+          Mem_Free(pext);
+          return FALSE;
+        }
+
+      __sync_fetch_and_add(&unstable_bytes, (fsal_size_t) capacity);
+
+      pext->offset = offset;
+      pext->length = length;
+      pext->capacity = capacity;
+      memcpy(pext->buffer, buffer, length);
+
+      pext->next = *ppext;
+      *ppext = pext;
+
+      return TRUE;
+    }
+
+  /* Last extent of the chunk overlapping or touching the write */
+  plast = pext;
+  while(plast->next != NULL &&
+        plast->next->offset <= offset + length && plast->next->offset < chunk_end)
+    plast = plast->next;
+
+  low = (pext->offset < offset) ? pext->offset : offset;
+  high = (plast->offset + plast->length > offset + length) ?
+      plast->offset + plast->length : offset + length;
+
+  /* The first extent receives the merged range */
+  if(high - low > pext->capacity)
+    {
+      capacity = unstable_capacity(high - low);
+
+      if((newbuf = Mem_Realloc_Label(pext->buffer, capacity,
+                                     "Cache_Inode Unstable Buffer")) == NULL)
+        return FALSE;
+
+      __sync_fetch_and_add(&unstable_bytes, (fsal_size_t) (capacity - pext->capacity));
+
+      pext->buffer = newbuf;
+      pext->capacity = capacity;
+    }
+
+  if(low < pext->offset)
+    memmove(pext->buffer + (pext->offset - low), pext->buffer, pext->length);
+
+  pext->offset = low;
+  pext->length = high - low;
+
+  /* Absorb the other extents, then lay the new data over them */
+  while(pext != plast)
+    {
+      pnext = pext->next;
+
+      memcpy(pext->buffer + (pnext->offset - low), pnext->buffer, pnext->length);
+
+      pext->next = pnext->next;
+      if(pnext == plast)
+        plast = pext;
+
+      unstable_extent_free(pnext);
+    }
+
+  memcpy(pext->buffer + (offset - low), buffer, length);
+
+  return TRUE;
+}                               /* unstable_merge */
+
+/* Frees the unstable data of a file and removes it from the dirty list. The entry's lock is held */
+static void unstable_release(cache_entry_t * pentry)
+{
+  cache_inode_unstable_data_t *pudata = pentry->object.file.unstable_data;
+  cache_inode_unstable_extent_t *pext;
+
+  P(unstable_mutex);
+
+  if(pudata->prev_dirty != NULL)
+    pudata->prev_dirty->next_dirty = pudata->next_dirty;
+  else
+    unstable_dirty_list = pudata->next_dirty;
+
+  if(pudata->next_dirty != NULL)
+    pudata->next_dirty->prev_dirty = pudata->prev_dirty;
+
+  V(unstable_mutex);
+
+  while((pext = pudata->extents) != NULL)
+    {
+      pudata->extents = pext->next;
+      unstable_extent_free(pext);
+    }
+
+  Mem_Free(pudata);
+  pentry->object.file.unstable_data = NULL;
+}                               /* unstable_release */
+
+/**
+ *
+ * cache_inode_unstable_write: buffers an unstable write in the Ganesha write buffer.
+ *
+ * The entry's lock is to be held by the caller. When the memory budget is exhausted,
+ * the file's own dirty data is flushed first; if this is not enough the caller has to
+ * write the data to the FSAL itself.
+ *
+ * @param pentry [INOUT] regular file the data is written to.
+ * @param offset [IN] offset of the write in the file.
+ * @param length [IN] length of the write.
+ * @param buffer [IN] the data.
+ * @param pclient [INOUT] ressource allocated by the client for the nfs management.
+ * @param pcontext [IN] fsal context of the writer, kept to flush the data later.
+ *
+ * @return TRUE if the data was buffered, FALSE otherwise.
+ *
+ */
+int cache_inode_unstable_write(cache_entry_t * pentry,
+                               uint64_t offset,
+                               fsal_size_t length,
+                               caddr_t buffer,
+                               cache_inode_client_t * pclient,
+                               fsal_op_context_t * pcontext)
+{
+  cache_inode_unstable_data_t *pudata;
+  cache_inode_status_t status;
+  fsal_size_t done;
+  fsal_size_t piece;
+  uint64_t chunk_end;
+
+  if(length == 0)
+    return FALSE;
+
+  if(unstable_bytes + length > unstable_budget)
+    {
+      /* Make room with this file's own data */
+      if(pentry->object.file.unstable_data != NULL)
+        cache_inode_unstable_flush(pentry, 0, 0, pclient, pcontext, &status);
+
+      if(unstable_bytes + length > unstable_budget)
+        {
+          LogFullDebug(COMPONENT_CACHE_INODE,
+                       "cache_inode_unstable_write: budget exhausted (%llu bytes used), writing through",
+                       (unsigned long long)unstable_bytes);
+
+          P(unstable_mutex);
+          pthread_cond_signal(&unstable_cond);
+          V(unstable_mutex);
+
+          return FALSE;
+        }
+    }
+
+  if((pudata = pentry->object.file.unstable_data) == NULL)
+    {
+      if((pudata = (cache_inode_unstable_data_t *)
+          Mem_Alloc_Label(sizeof(cache_inode_unstable_data_t),
+                          "cache_inode_unstable_data_t")) == NULL)
+        return FALSE;
+
+      memset(pudata, 0, sizeof(cache_inode_unstable_data_t));
+      pudata->pentry = pentry;
+      pentry->object.file.unstable_data = pudata;
+
+      P(unstable_mutex);
+
+      pudata->next_dirty = unstable_dirty_list;
+      if(unstable_dirty_list != NULL)
+        unstable_dirty_list->prev_dirty = pudata;
+      unstable_dirty_list = pudata;
+
+      V(unstable_mutex);
+    }
+
+  pudata->context = *pcontext;
+  pudata->last_write = time(NULL);
+
+  /* Split the write on the extent alignment */
+  for(done = 0; done < length; done += piece)
+    {
+      chunk_end = offset + done + CACHE_INODE_UNSTABLE_EXTENT_SIZE -
+          (offset + done) % CACHE_INODE_UNSTABLE_EXTENT_SIZE;
+      piece = length - done;
+      if(offset + done + piece > chunk_end)
+        piece = chunk_end - offset - done;
+
+      if(!unstable_merge(pudata, offset + done, (uint32_t) piece, buffer + done))
+        {
+          /* What was buffered is the same data the caller will write through */
+          if(pudata->extents == NULL)
+            unstable_release(pentry);
+
+          return FALSE;
+        }
+    }
+
+  /* Wake up the flusher early when half of the budget is used */
+  if(unstable_bytes > unstable_budget / 2)
+    {
+      P(unstable_mutex);
+      pthread_cond_signal(&unstable_cond);
+      V(unstable_mutex);
+    }
+
+  return TRUE;
+}                               /* cache_inode_unstable_write */
+
+/**
+ *
+ * cache_inode_unstable_flush: writes the dirty extents of a file to the FSAL.
+ *
+ * Writes every extent intersecting [offset, offset+length) to the FSAL, length 0
+ * meaning up to the end of the file. The entry's lock is to be held by the caller.
+ * Extents that could not be written are kept, except when the file is stale.
+ *
+ * @param pentry [INOUT] regular file to be flushed.
+ * @param offset [IN] start of the range to flush.
+ * @param length [IN] length of the range to flush, 0 for the whole file.
+ * @param pclient [INOUT] ressource allocated by the client for the nfs management.
+ * @param pcontext [IN] fsal context for the operation, NULL to use the last writer's one.
+ * @param pstatus [OUT] returned status.
+ *
+ * @return CACHE_INODE_SUCCESS if the range was written to the FSAL.
+ *
+ */
+cache_inode_status_t cache_inode_unstable_flush(cache_entry_t * pentry,
+                                                uint64_t offset,
+                                                fsal_size_t length,
+                                                cache_inode_client_t * pclient,
+                                                fsal_op_context_t * pcontext,
+                                                cache_inode_status_t * pstatus)
+{
+  cache_inode_unstable_data_t *pudata = pentry->object.file.unstable_data;
+  cache_inode_unstable_extent_t **ppext;
+  cache_inode_unstable_extent_t *pext;
+  cache_inode_status_t close_status;
+  fsal_status_t fsal_status;
+  fsal_attrib_list_t post_write_attr;
+  fsal_seek_t seek_descriptor;
+  fsal_size_t written;
+  uint64_t end;
+  int opened = FALSE;
+
+  *pstatus = CACHE_INODE_SUCCESS;
+
+  if(pudata == NULL)
+    return *pstatus;
+
+  if(pcontext == NULL)
+    pcontext = &pudata->context;
+
+  if(length == 0 || offset + length < offset)
+    end = UINT64_MAX;
+  else
+    end = offset + length;
+
+  ppext = &pudata->extents;
+  while((pext = *ppext) != NULL && pext->offset < end)
+    {
+      if(pext->offset + pext->length <= offset)
+        {
+          ppext = &pext->next;
+          continue;
+        }
+
+      if(!opened)
+        {
+          if(cache_inode_open(pentry, pclient, FSAL_O_WRONLY, pcontext, pstatus) !=
+             CACHE_INODE_SUCCESS)
+            {
+              LogMajor(COMPONENT_CACHE_INODE,
+                       "cache_inode_unstable_flush: could not open entry %p, status=%d",
+                       pentry, *pstatus);
+              return *pstatus;
+            }
+          opened = TRUE;
+        }
+
+      seek_descriptor.whence = FSAL_SEEK_SET;
+      seek_descriptor.offset = pext->offset;
+
+#ifdef _USE_MFSL
+      fsal_status = MFSL_write(&(pentry->object.file.open_fd.mfsl_fd),
+                               &seek_descriptor,
+                               pext->length, pext->buffer, &written,
+                               &pclient->mfsl_context, NULL);
+#else
+      fsal_status = FSAL_write(&(pentry->object.file.open_fd.fd),
+                               &seek_descriptor, pext->length, pext->buffer, &written);
+#endif
+
+      if(FSAL_IS_ERROR(fsal_status) || written != pext->length)
+        {
+          LogMajor(COMPONENT_CACHE_INODE,
+                   "cache_inode_unstable_flush: write of %u bytes at %llu failed for entry %p, fsal_status.major=%d, written=%llu",
+                   pext->length, (unsigned long long)pext->offset, pentry,
+                   fsal_status.major, (unsigned long long)written);
+
+          if(FSAL_IS_ERROR(fsal_status))
+            *pstatus = cache_inode_error_convert(fsal_status);
+          else
+            *pstatus = CACHE_INODE_IO_ERROR;
+
+          /* The data can't be written anywhere anymore */
+          if(fsal_status.major == ERR_FSAL_STALE)
+            {
+              cache_inode_close(pentry, pclient, &close_status);
+              unstable_release(pentry);
+              return *pstatus;
+            }
+
+          break;
+        }
+
+      *ppext = pext->next;
+      unstable_extent_free(pext);
+    }
+
+  if(opened)
+    {
+      if(cache_inode_close(pentry, pclient, &close_status) != CACHE_INODE_SUCCESS)
+        LogEvent(COMPONENT_CACHE_INODE,
+                 "cache_inode_unstable_flush: cache_inode_close = %d", close_status);
+
+      /* Update the size, after the close (see cache_inode_rdwr) */
+      post_write_attr.asked_attributes = FSAL_ATTR_SIZE | FSAL_ATTR_SPACEUSED;
+      fsal_status = FSAL_getattrs(&(pentry->object.file.handle), pcontext,
+                                  &post_write_attr);
+      if(!FSAL_IS_ERROR(fsal_status))
+        {
+          pentry->object.file.attributes.filesize = post_write_attr.filesize;
+          pentry->object.file.attributes.spaceused = post_write_attr.spaceused;
+        }
+    }
+
+  if(pudata->extents == NULL)
+    unstable_release(pentry);
+
+  return *pstatus;
+}                               /* cache_inode_unstable_flush */
+
+/**
+ *
+ * cache_inode_unstable_truncate: drops the buffered data beyond a new size of the file.
+ *
+ * @param pentry [INOUT] regular file being truncated, its lock is held by the caller.
+ * @param length [IN] the new size of the file.
+ *
+ * @return nothing (void function).
+ *
+ */
+void cache_inode_unstable_truncate(cache_entry_t * pentry, fsal_size_t length)
+{
+  cache_inode_unstable_data_t *pudata = pentry->object.file.unstable_data;
+  cache_inode_unstable_extent_t **ppext;
+  cache_inode_unstable_extent_t *pext;
+
+  if(pudata == NULL)
+    return;
+
+  ppext = &pudata->extents;
+  while((pext = *ppext) != NULL)
+    {
+      if(pext->offset >= length)
+        {
+          *ppext = pext->next;
+          unstable_extent_free(pext);
+          continue;
+        }
+
+      if(pext->offset + pext->length > length)
+        pext->length = length - pext->offset;
+
+      ppext = &pext->next;
+    }
+
+  if(pudata->extents == NULL)
+    unstable_release(pentry);
+}                               /* cache_inode_unstable_truncate */
+
+/**
+ *
+ * cache_inode_unstable_discard: drops the buffered data of an entry removed from the cache.
+ *
+ * @param pentry [INOUT] entry being removed, its lock is held by the caller.
+ *
+ * @return nothing (void function).
+ *
+ */
+void cache_inode_unstable_discard(cache_entry_t * pentry)
+{
+  if(pentry->internal_md.type != REGULAR_FILE ||
+     pentry->object.file.unstable_data == NULL)
+    return;
+
+  LogEvent(COMPONENT_CACHE_INODE,
+           "cache_inode_unstable_discard: dropping unstable data of entry %p", pentry);
+
+  unstable_release(pentry);
+}                               /* cache_inode_unstable_discard */
+
+/**
+ *
+ * cache_inode_unstable_flush_pass: flushes the files that stopped being written to.
+ *
+ * Every file idle for the flush delay is flushed, or every file at all when more than
+ * half of the budget is used. Busy entries are skipped and retried at the next pass:
+ * the entry's lock is only tried while unstable_mutex is held, since the threads that
+ * remove an entry take unstable_mutex with the entry's lock held.
+ *
+ * @param pclient [INOUT] client of the flusher, used to open the files.
+ *
+ * @return the number of files flushed.
+ *
+ */
+unsigned int cache_inode_unstable_flush_pass(cache_inode_client_t * pclient)
+{
+  cache_inode_unstable_data_t *pudata;
+  cache_entry_t *pentry;
+  cache_inode_status_t status;
+  unsigned int pass;
+  unsigned int nb_flushed = 0;
+  time_t now = time(NULL);
+  int force = (unstable_bytes > unstable_budget / 2);
+
+  P(unstable_mutex);
+
+  pass = ++unstable_pass;
+
+ restart:
+  for(pudata = unstable_dirty_list; pudata != NULL; pudata = pudata->next_dirty)
+    {
+      if(pudata->flush_pass == pass)
+        continue;
+
+      if(!force && now - pudata->last_write < unstable_flush_delay)
+        continue;
+
+      pentry = pudata->pentry;
+
+      if(P_w_try(&pentry->lock) != 0)
+        continue;
+
+      pudata->flush_pass = pass;
+
+      V(unstable_mutex);
+
+      if(cache_inode_unstable_flush(pentry, 0, 0, pclient, NULL, &status) ==
+         CACHE_INODE_SUCCESS)
+        nb_flushed += 1;
+
+      V_w(&pentry->lock);
+
+      /* The list may have changed meanwhile */
+      P(unstable_mutex);
+      goto restart;
+    }
+
+  V(unstable_mutex);
+
+  return nb_flushed;
+}                               /* cache_inode_unstable_flush_pass */
+
+/**
+ *
+ * cache_inode_unstable_wait: waits for work for the flusher.
+ *
+ * @param seconds [IN] maximum time to wait, the flusher is woken up earlier when the memory gets short.
+ *
+ * @return nothing (void function).
+ *
+ */
+void cache_inode_unstable_wait(time_t seconds)
+{
+  struct timespec timeout;
+
+  timeout.tv_sec = time(NULL) + seconds;
+  timeout.tv_nsec = 0;
+
+  P(unstable_mutex);
+  pthread_cond_timedwait(&unstable_cond, &unstable_mutex, &timeout);
+  V(unstable_mutex);
+}                               /* cache_inode_unstable_wait */
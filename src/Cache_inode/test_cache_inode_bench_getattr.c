@@ -0,0 +1,411 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    test_cache_inode_bench_getattr.c
+ * \brief   Benchmark of GETATTR and ACCESS storms on one hot inode.
+ *
+ * Caches a file, then nb_threads threads (64 by default) get its attributes
+ * and test its access for a few seconds, each with its own cache inode client
+ * as the worker threads. The attributes stay within their grace period.
+ *
+ * The storm is run twice: first through the locked path cache_inode_getattr
+ * used to follow for such an entry (P_w, renew, downgrade, copy, validation)
+ * and a read locked cache_inode_access, then through cache_inode_getattr and
+ * cache_inode_access themselves.
+ *
+ * Usage: test_cache_inode_bench_getattr <config file> <file> [nb_threads [seconds]]
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/types.h>
+
+#include "fsal.h"
+#include "cache_inode.h"
+#include "LRU_List.h"
+#include "log_macros.h"
+#include "err_fsal.h"
+#include "err_cache_inode.h"
+#include "stuff_alloc.h"
+#include "config_parsing.h"
+#include "MesureTemps.h"
+
+#define NB_THREADS_DEFAULT 64
+#define NB_SECONDS_DEFAULT 5
+#define GRACE_PERIOD_ATTR  3600
+
+/* One ACCESS every ACCESS_PERIOD GETATTR, as in a close to open storm */
+#define ACCESS_PERIOD      4
+
+typedef struct bench_thread__
+{
+  pthread_t thrid;
+  unsigned int index;
+  unsigned long nb_ops;
+  unsigned long nb_errors;
+} bench_thread_t;
+
+static hash_table_t *bench_ht = NULL;
+static cache_entry_t *bench_pentry = NULL;
+static cache_inode_client_parameter_t bench_client_param;
+static fsal_op_context_t bench_context;
+static int bench_locked = FALSE;
+static volatile int bench_go = FALSE;
+static volatile int bench_stop = FALSE;
+
+int lru_entry_to_str(LRU_data_t data, char *str)
+{
+  cache_entry_t *pentry = NULL;
+
+  pentry = (cache_entry_t *) data.pdata;
+
+  return sprintf(str, "Pentry: Addr %p, state=%d", pentry,
+                 pentry->internal_md.valid_state);
+}                               /* lru_entry_to_str */
+
+int lru_clean_entry(LRU_entry_t * entry, void *adddata)
+{
+  return 0;
+}                               /* lru_clean_entry */
+
+/* What cache_inode_getattr did for a fresh entry before it could skip the lock */
+static cache_inode_status_t bench_getattr_locked(cache_entry_t * pentry,
+                                                 fsal_attrib_list_t * pattr,
+                                                 cache_inode_client_t * pclient,
+                                                 fsal_op_context_t * pcontext,
+                                                 cache_inode_status_t * pstatus)
+{
+  P_w(&pentry->lock);
+  if(cache_inode_renew_entry(pentry, pattr, bench_ht, pclient, pcontext,
+                             pstatus) != CACHE_INODE_SUCCESS)
+    {
+      V_w(&pentry->lock);
+      return *pstatus;
+    }
+  rw_lock_downgrade(&pentry->lock);
+
+  cache_inode_get_attributes(pentry, pattr);
+  *pstatus = cache_inode_valid(pentry, CACHE_INODE_OP_GET, pclient);
+
+  V_r(&pentry->lock);
+
+  return *pstatus;
+}                               /* bench_getattr_locked */
+
+static void *bench_thread(void *arg)
+{
+  bench_thread_t *pthr = (bench_thread_t *) arg;
+  cache_inode_client_t client;
+  fsal_op_context_t context = bench_context;
+  fsal_attrib_list_t attr;
+  cache_inode_status_t cache_status;
+
+#ifndef _NO_BUDDY_SYSTEM
+  if(BuddyInit(NULL) != BUDDY_SUCCESS)
+    {
+      LogTest("Error while initializing Buddy system allocator in thread %u",
+              pthr->index);
+      exit(1);
+    }
+#endif
+
+  if(cache_inode_client_init(&client, bench_client_param, pthr->index, NULL) != 0)
+    {
+      LogTest("Error while initializing the cache inode client of thread %u",
+              pthr->index);
+      exit(1);
+    }
+
+  while(!bench_go)
+    sched_yield();
+
+  while(!bench_stop)
+    {
+      pthr->nb_ops += 1;
+
+      if(pthr->nb_ops % ACCESS_PERIOD == 0)
+        {
+          if(bench_locked)
+            {
+              P_r(&bench_pentry->lock);
+              cache_inode_access_sw(bench_pentry, FSAL_R_OK, bench_ht, &client,
+                                    &context, &cache_status, FALSE);
+              V_r(&bench_pentry->lock);
+            }
+          else
+            cache_inode_access(bench_pentry, FSAL_R_OK, bench_ht, &client,
+                               &context, &cache_status);
+        }
+      else if(bench_locked)
+        bench_getattr_locked(bench_pentry, &attr, &client, &context, &cache_status);
+      else
+        cache_inode_getattr(bench_pentry, &attr, bench_ht, &client, &context,
+                            &cache_status);
+
+      if(cache_status != CACHE_INODE_SUCCESS)
+        pthr->nb_errors += 1;
+    }
+
+  return NULL;
+}                               /* bench_thread */
+
+/* Returns the number of operations per second of the storm */
+static double bench_storm(bench_thread_t * threads, unsigned int nb_threads,
+                          unsigned int seconds, int locked)
+{
+  struct Temps debut;
+  struct Temps fin;
+  unsigned long nb_ops = 0;
+  unsigned long nb_errors = 0;
+  unsigned int i;
+  double secs;
+
+  bench_locked = locked;
+  bench_go = FALSE;
+  bench_stop = FALSE;
+
+  for(i = 0; i < nb_threads; i++)
+    {
+      memset(&threads[i], 0, sizeof(bench_thread_t));
+      threads[i].index = i + 1;
+
+      if(pthread_create(&threads[i].thrid, NULL, bench_thread, &threads[i]) != 0)
+        {
+          LogTest("Error: can't create thread %u", i);
+          exit(1);
+        }
+    }
+
+  /* Let the threads initialize their clients */
+  sleep(1);
+
+  MesureTemps(&debut, NULL);
+  bench_go = TRUE;
+  sleep(seconds);
+  bench_stop = TRUE;
+  MesureTemps(&fin, &debut);
+
+  for(i = 0; i < nb_threads; i++)
+    {
+      pthread_join(threads[i].thrid, NULL);
+      nb_ops += threads[i].nb_ops;
+      nb_errors += threads[i].nb_errors;
+    }
+
+  if(nb_errors != 0)
+    {
+      LogTest("Error: %lu operations of %lu failed", nb_errors, nb_ops);
+      exit(1);
+    }
+
+  secs = fin.secondes + fin.micro_secondes / 1000000.0;
+  return secs > 0 ? nb_ops / secs : 0.0;
+}                               /* bench_storm */
+
+int main(int argc, char *argv[])
+{
+  config_file_t config_file;
+  fsal_parameter_t init_param;
+  fsal_export_context_t export_context;
+  fsal_status_t status;
+  fsal_path_t path;
+  fsal_handle_t file_handle;
+  fsal_attrib_list_t attr;
+
+  cache_inode_parameter_t cache_param;
+  cache_inode_client_t client;
+  cache_inode_fsal_data_t fsdata;
+  cache_inode_status_t cache_status;
+
+  bench_thread_t *threads = NULL;
+  unsigned int nb_threads = NB_THREADS_DEFAULT;
+  unsigned int seconds = NB_SECONDS_DEFAULT;
+  double locked, lockless;
+  int rc;
+
+  if(argc < 3)
+    {
+      fprintf(stderr, "Usage: %s <config file> <file> [nb_threads [seconds]]\n",
+              argv[0]);
+      exit(1);
+    }
+
+  if(argc > 3)
+    nb_threads = (unsigned int)atoi(argv[3]);
+  if(argc > 4)
+    seconds = (unsigned int)atoi(argv[4]);
+
+  if(nb_threads == 0 || seconds == 0)
+    {
+      fprintf(stderr, "nb_threads and seconds must be positive\n");
+      exit(1);
+    }
+
+#ifndef _NO_BUDDY_SYSTEM
+  if((rc = BuddyInit(NULL)) != BUDDY_SUCCESS)
+    {
+      fprintf(stderr, "Error while initializing Buddy system allocator\n");
+      exit(1);
+    }
+#endif
+
+  SetNamePgm("test_cache_inode_bench_getattr");
+  SetDefaultLogging("TEST");
+  SetNameFunction("main");
+  InitLogging();
+
+  AddFamilyError(ERR_FSAL, "FSAL related Errors", tab_errstatus_FSAL);
+  AddFamilyError(ERR_CACHE_INODE, "Cache_inode related Errors",
+                 tab_errstatus_cache_inode);
+
+  /* Init of the FSAL */
+  if((config_file = config_ParseFile(argv[1])) == NULL)
+    {
+      LogTest("Error parsing %s: %s", argv[1], config_GetErrorMsg());
+      exit(1);
+    }
+
+  memset(&init_param, 0, sizeof(init_param));
+  status = FSAL_load_FSAL_parameter_from_conf(config_file, &init_param);
+  if(FSAL_IS_ERROR(status) && status.major != ERR_FSAL_NOENT)
+    {
+      LogError(COMPONENT_STDOUT, ERR_FSAL, status.major, status.minor);
+      exit(1);
+    }
+
+  status = FSAL_load_FS_common_parameter_from_conf(config_file, &init_param);
+  if(FSAL_IS_ERROR(status) && status.major != ERR_FSAL_NOENT)
+    {
+      LogError(COMPONENT_STDOUT, ERR_FSAL, status.major, status.minor);
+      exit(1);
+    }
+
+  status = FSAL_load_FS_specific_parameter_from_conf(config_file, &init_param);
+  if(FSAL_IS_ERROR(status) && status.major != ERR_FSAL_NOENT)
+    {
+      LogError(COMPONENT_STDOUT, ERR_FSAL, status.major, status.minor);
+      exit(1);
+    }
+
+  if(FSAL_IS_ERROR(status = FSAL_Init(&init_param)))
+    {
+      LogError(COMPONENT_STDOUT, ERR_FSAL, status.major, status.minor);
+      exit(1);
+    }
+
+  /* Credentials of the user running the benchmark */
+  if(FSAL_IS_ERROR(status = FSAL_BuildExportContext(&export_context, NULL, NULL)) ||
+     FSAL_IS_ERROR(status = FSAL_InitClientContext(&bench_context)) ||
+     FSAL_IS_ERROR(status = FSAL_GetClientContext(&bench_context, &export_context,
+                                                  getuid(), getgid(), NULL, 0)))
+    {
+      LogError(COMPONENT_STDOUT, ERR_FSAL, status.major, status.minor);
+      exit(1);
+    }
+
+  /* Init of the cache inode module */
+  if(cache_inode_read_conf_hash_parameter(config_file, &cache_param) != CACHE_INODE_SUCCESS)
+    {
+      LogTest("Error reading the cache inode hash parameters");
+      exit(1);
+    }
+
+  cache_param.hparam.hash_func_key = cache_inode_fsal_hash_func;
+  cache_param.hparam.hash_func_rbt = cache_inode_fsal_rbt_func;
+  cache_param.hparam.hash_func_both = NULL;
+  cache_param.hparam.compare_key = cache_inode_compare_key_fsal;
+  cache_param.hparam.key_to_str = NULL;
+  cache_param.hparam.val_to_str = NULL;
+
+  if((bench_ht = cache_inode_init(cache_param, &cache_status)) == NULL)
+    {
+      LogTest("Error %d while init hash", cache_status);
+      exit(1);
+    }
+
+  /* The attributes stay within their grace period during the whole benchmark */
+  if(cache_inode_read_conf_client_parameter(config_file, &bench_client_param) !=
+     CACHE_INODE_SUCCESS)
+    {
+      LogTest("Error reading the cache inode client parameters");
+      exit(1);
+    }
+
+  bench_client_param.attrmask =
+      FSAL_ATTRS_MANDATORY | FSAL_ATTR_MTIME | FSAL_ATTR_CTIME | FSAL_ATTR_ATIME;
+  bench_client_param.lru_param.entry_to_str = lru_entry_to_str;
+  bench_client_param.lru_param.clean_entry = lru_clean_entry;
+  bench_client_param.expire_type_attr = CACHE_INODE_EXPIRE;
+  bench_client_param.grace_period_attr = GRACE_PERIOD_ATTR;
+  bench_client_param.expire_type_link = CACHE_INODE_EXPIRE_NEVER;
+  bench_client_param.expire_type_dirent = CACHE_INODE_EXPIRE_NEVER;
+  bench_client_param.use_test_access = 1;
+
+  if(cache_inode_client_init(&client, bench_client_param, 0, NULL) != 0)
+    {
+      LogTest("Error while initializing the cache inode client");
+      exit(1);
+    }
+
+  /* Cache the file, the first GETATTR validate it */
+  if(FSAL_IS_ERROR(status = FSAL_str2path(argv[2], strlen(argv[2]) + 1, &path)) ||
+     FSAL_IS_ERROR(status = FSAL_lookupPath(&path, &bench_context, &file_handle, NULL)))
+    {
+      LogError(COMPONENT_STDOUT, ERR_FSAL, status.major, status.minor);
+      exit(1);
+    }
+
+  fsdata.cookie = 0;
+  fsdata.handle = file_handle;
+
+  if((bench_pentry = cache_inode_get(&fsdata, &attr, bench_ht, &client, &bench_context,
+                                     &cache_status)) == NULL ||
+     cache_inode_getattr(bench_pentry, &attr, bench_ht, &client, &bench_context,
+                         &cache_status) != CACHE_INODE_SUCCESS)
+    {
+      LogTest("Error: can't cache %s, status=%d", argv[2], cache_status);
+      exit(1);
+    }
+
+  if((threads = (bench_thread_t *) malloc(nb_threads * sizeof(bench_thread_t))) == NULL)
+    {
+      LogTest("Error: can't allocate %u threads", nb_threads);
+      exit(1);
+    }
+
+  locked = bench_storm(threads, nb_threads, seconds, TRUE);
+  LogTest("Locked:   %u threads, %.0f ops/s", nb_threads, locked);
+
+  lockless = bench_storm(threads, nb_threads, seconds, FALSE);
+  LogTest("Lockless: %u threads, %.0f ops/s (x%.2f)", nb_threads, lockless,
+          locked > 0 ? lockless / locked : 0.0);
+
+  free(threads);
+  exit(0);
+}                               /* main */
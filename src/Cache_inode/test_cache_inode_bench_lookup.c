@@ -0,0 +1,299 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    test_cache_inode_bench_lookup.c
+ * \brief   Benchmark of cache_inode_lookup in a large directory.
+ *
+ * Fills a directory with nb_entries files (1 million by default) through
+ * cache_inode_create, or caches them with a first cache_inode_lookup if they
+ * already exist, then times cache_inode_lookup on every name of the directory,
+ * all of them being cache hits.
+ *
+ * Usage: test_cache_inode_bench_lookup <config file> <directory> [nb_entries]
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "fsal.h"
+#include "cache_inode.h"
+#include "LRU_List.h"
+#include "log_macros.h"
+#include "err_fsal.h"
+#include "err_cache_inode.h"
+#include "stuff_alloc.h"
+#include "config_parsing.h"
+#include "MesureTemps.h"
+
+#define NB_ENTRIES_DEFAULT 1000000
+#define NB_PASSES          3
+
+/* Visits the names in a scattered order: this is a prime, not dividing nb_entries */
+#define LOOKUP_STRIDE      7919
+
+int lru_entry_to_str(LRU_data_t data, char *str)
+{
+  cache_entry_t *pentry = NULL;
+
+  pentry = (cache_entry_t *) data.pdata;
+
+  return sprintf(str, "Pentry: Addr %p, state=%d", pentry,
+                 pentry->internal_md.valid_state);
+}                               /* lru_entry_to_str */
+
+int lru_clean_entry(LRU_entry_t * entry, void *adddata)
+{
+  return 0;
+}                               /* lru_clean_entry */
+
+static void bench_name(unsigned int i, fsal_name_t * pname)
+{
+  char str[32];
+
+  snprintf(str, sizeof(str), "bench.%07u", i);
+  FSAL_str2name(str, sizeof(str), pname);
+}                               /* bench_name */
+
+int main(int argc, char *argv[])
+{
+  config_file_t config_file;
+  fsal_parameter_t init_param;
+  fsal_export_context_t export_context;
+  fsal_op_context_t context;
+  fsal_status_t status;
+  fsal_path_t path;
+  fsal_handle_t dir_handle;
+  fsal_attrib_list_t attr;
+
+  cache_inode_parameter_t cache_param;
+  cache_inode_client_parameter_t cache_client_param;
+  cache_inode_client_t client;
+  cache_inode_fsal_data_t fsdata;
+  cache_inode_status_t cache_status;
+  hash_table_t *ht = NULL;
+  cache_entry_t *pentry_dir = NULL;
+  cache_entry_t *pentry = NULL;
+
+  struct Temps debut;
+  struct Temps fin;
+  fsal_name_t name;
+  unsigned int nb_entries = NB_ENTRIES_DEFAULT;
+  unsigned int nb_created = 0;
+  unsigned int i, j, pass;
+  double secs;
+  int rc;
+
+  if(argc < 3)
+    {
+      fprintf(stderr, "Usage: %s <config file> <directory> [nb_entries]\n", argv[0]);
+      exit(1);
+    }
+
+  if(argc > 3)
+    nb_entries = (unsigned int)atoi(argv[3]);
+
+  if(nb_entries == 0 || nb_entries % LOOKUP_STRIDE == 0)
+    {
+      fprintf(stderr, "nb_entries must be positive and not a multiple of %d\n",
+              LOOKUP_STRIDE);
+      exit(1);
+    }
+
+#ifndef _NO_BUDDY_SYSTEM
+  if((rc = BuddyInit(NULL)) != BUDDY_SUCCESS)
+    {
+      fprintf(stderr, "Error while initializing Buddy system allocator\n");
+      exit(1);
+    }
+#endif
+
+  SetNamePgm("test_cache_inode_bench_lookup");
+  SetDefaultLogging("TEST");
+  SetNameFunction("main");
+  InitLogging();
+
+  AddFamilyError(ERR_FSAL, "FSAL related Errors", tab_errstatus_FSAL);
+  AddFamilyError(ERR_CACHE_INODE, "Cache_inode related Errors",
+                 tab_errstatus_cache_inode);
+
+  /* Init of the FSAL */
+  if((config_file = config_ParseFile(argv[1])) == NULL)
+    {
+      LogTest("Error parsing %s: %s", argv[1], config_GetErrorMsg());
+      exit(1);
+    }
+
+  memset(&init_param, 0, sizeof(init_param));
+  status = FSAL_load_FSAL_parameter_from_conf(config_file, &init_param);
+  if(FSAL_IS_ERROR(status) && status.major != ERR_FSAL_NOENT)
+    {
+      LogError(COMPONENT_STDOUT, ERR_FSAL, status.major, status.minor);
+      exit(1);
+    }
+
+  status = FSAL_load_FS_common_parameter_from_conf(config_file, &init_param);
+  if(FSAL_IS_ERROR(status) && status.major != ERR_FSAL_NOENT)
+    {
+      LogError(COMPONENT_STDOUT, ERR_FSAL, status.major, status.minor);
+      exit(1);
+    }
+
+  status = FSAL_load_FS_specific_parameter_from_conf(config_file, &init_param);
+  if(FSAL_IS_ERROR(status) && status.major != ERR_FSAL_NOENT)
+    {
+      LogError(COMPONENT_STDOUT, ERR_FSAL, status.major, status.minor);
+      exit(1);
+    }
+
+  if(FSAL_IS_ERROR(status = FSAL_Init(&init_param)))
+    {
+      LogError(COMPONENT_STDOUT, ERR_FSAL, status.major, status.minor);
+      exit(1);
+    }
+
+  /* Credentials of the user running the benchmark */
+  if(FSAL_IS_ERROR(status = FSAL_BuildExportContext(&export_context, NULL, NULL)) ||
+     FSAL_IS_ERROR(status = FSAL_InitClientContext(&context)) ||
+     FSAL_IS_ERROR(status = FSAL_GetClientContext(&context, &export_context,
+                                                  getuid(), getgid(), NULL, 0)))
+    {
+      LogError(COMPONENT_STDOUT, ERR_FSAL, status.major, status.minor);
+      exit(1);
+    }
+
+  /* Init of the cache inode module */
+  if(cache_inode_read_conf_hash_parameter(config_file, &cache_param) != CACHE_INODE_SUCCESS)
+    {
+      LogTest("Error reading the cache inode hash parameters");
+      exit(1);
+    }
+
+  cache_param.hparam.hash_func_key = cache_inode_fsal_hash_func;
+  cache_param.hparam.hash_func_rbt = cache_inode_fsal_rbt_func;
+  cache_param.hparam.hash_func_both = NULL;
+  cache_param.hparam.compare_key = cache_inode_compare_key_fsal;
+  cache_param.hparam.key_to_str = NULL;
+  cache_param.hparam.val_to_str = NULL;
+
+  if((ht = cache_inode_init(cache_param, &cache_status)) == NULL)
+    {
+      LogTest("Error %d while init hash", cache_status);
+      exit(1);
+    }
+
+  /* Never expire anything: every lookup of the timed passes must be a cache hit */
+  if(cache_inode_read_conf_client_parameter(config_file, &cache_client_param) !=
+     CACHE_INODE_SUCCESS)
+    {
+      LogTest("Error reading the cache inode client parameters");
+      exit(1);
+    }
+
+  cache_client_param.attrmask =
+      FSAL_ATTRS_MANDATORY | FSAL_ATTR_MTIME | FSAL_ATTR_CTIME | FSAL_ATTR_ATIME;
+  cache_client_param.lru_param.entry_to_str = lru_entry_to_str;
+  cache_client_param.lru_param.clean_entry = lru_clean_entry;
+  cache_client_param.expire_type_attr = CACHE_INODE_EXPIRE_NEVER;
+  cache_client_param.expire_type_link = CACHE_INODE_EXPIRE_NEVER;
+  cache_client_param.expire_type_dirent = CACHE_INODE_EXPIRE_NEVER;
+
+  if(cache_inode_client_init(&client, cache_client_param, 0, NULL) != 0)
+    {
+      LogTest("Error while initializing the cache inode client");
+      exit(1);
+    }
+
+  /* The directory is cached as a root */
+  if(FSAL_IS_ERROR(status = FSAL_str2path(argv[2], strlen(argv[2]) + 1, &path)) ||
+     FSAL_IS_ERROR(status = FSAL_lookupPath(&path, &context, &dir_handle, NULL)))
+    {
+      LogError(COMPONENT_STDOUT, ERR_FSAL, status.major, status.minor);
+      exit(1);
+    }
+
+  fsdata.cookie = 0;
+  fsdata.handle = dir_handle;
+
+  if((pentry_dir = cache_inode_make_root(&fsdata, ht, &client, &context,
+                                         &cache_status)) == NULL)
+    {
+      LogTest("Error: can't cache directory %s, status=%d", argv[2], cache_status);
+      exit(1);
+    }
+
+  /* Populate the directory and its cached dirents */
+  MesureTemps(&debut, NULL);
+  for(i = 0; i < nb_entries; i++)
+    {
+      bench_name(i, &name);
+
+      pentry = cache_inode_create(pentry_dir, &name, REGULAR_FILE, 0644, NULL, &attr,
+                                  ht, &client, &context, &cache_status);
+
+      if(pentry == NULL && cache_status == CACHE_INODE_ENTRY_EXISTS)
+        pentry = cache_inode_lookup(pentry_dir, &name, &attr, ht, &client, &context,
+                                    &cache_status);
+      else if(pentry != NULL)
+        nb_created += 1;
+
+      if(pentry == NULL)
+        {
+          LogTest("Error: can't create or lookup %s, status=%d", name.name,
+                  cache_status);
+          exit(1);
+        }
+    }
+  MesureTemps(&fin, &debut);
+  LogTest("Cached %u entries (%u created) in %s seconds", nb_entries, nb_created,
+          ConvertiTempsChaine(fin, NULL));
+
+  /* Timed lookups, all of them should hit the cached dirents */
+  for(pass = 0; pass < NB_PASSES; pass++)
+    {
+      MesureTemps(&debut, NULL);
+      for(i = 0, j = 0; i < nb_entries; i++, j = (j + LOOKUP_STRIDE) % nb_entries)
+        {
+          bench_name(j, &name);
+
+          if(cache_inode_lookup(pentry_dir, &name, &attr, ht, &client, &context,
+                                &cache_status) == NULL)
+            {
+              LogTest("Error: lookup of %s failed, status=%d", name.name, cache_status);
+              exit(1);
+            }
+        }
+      MesureTemps(&fin, &debut);
+
+      secs = fin.secondes + fin.micro_secondes / 1000000.0;
+      LogTest("Pass %u: %u lookups in %s seconds, %.0f lookups/s",
+              pass, nb_entries, ConvertiTempsChaine(fin, NULL),
+              secs > 0 ? nb_entries / secs : 0.0);
+    }
+
+  exit(0);
+}                               /* main */
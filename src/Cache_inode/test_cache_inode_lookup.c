@@ -245,6 +245,7 @@ main(int argc, char *argv[])
   cache_param.hparam.index_size = 31;
   cache_param.hparam.alphabet_length = 10;      /* Buffer seen as a decimal polynom */
   cache_param.hparam.nb_node_prealloc = 100;
+  cache_param.hparam.backend = HASHTABLE_BACKEND_RBT;
   cache_param.hparam.hash_func_key = cache_inode_fsal_hash_func;
   cache_param.hparam.hash_func_rbt = cache_inode_fsal_rbt_func;
   cache_param.hparam.hash_func_both = NULL ; /* BUGAZOMEU */
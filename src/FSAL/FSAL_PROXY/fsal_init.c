@@ -186,6 +186,11 @@ static int FS_Specific_Init(proxyfs_specific_initinfo_t * fs_init_info)
         return rc;
     }
 #endif
+  /* Pool of backend connections shared by the worker threads */
+  if(fsal_proxy_rpc_init(fs_init_info) != 0)
+    LogEvent(COMPONENT_FSAL,
+             "FSAL PROXY RPC : using one connection to the remote server per worker");
+
   /* Init the thread in charge of renewing the client id */
   /* Init for thread parameter (mostly for scheduling) */
   pthread_attr_init(&attr_thr);
@@ -138,6 +138,13 @@ int fsal_internal_ClientReconnect(fsal_op_context_t * p_thr_context);
 fsal_status_t FSAL_proxy_open_confirm(fsal_file_t * pfd);
 void *FSAL_proxy_change_user(fsal_op_context_t * p_thr_context);
 
+int fsal_proxy_rpc_init(proxyfs_specific_initinfo_t * pinfo);
+enum clnt_stat fsal_proxy_rpc_compound(proxyfsal_op_context_t * p_context, AUTH * auth,
+                                       COMPOUND4args * args, COMPOUND4res * res,
+                                       struct timeval timeout);
+void fsal_proxy_rpc_get_stats(unsigned long long *pnb_sent,
+                              unsigned long long *pnb_merged);
+
 /* All the call to FSAL to be wrapped */
 fsal_status_t PROXYFSAL_access(proxyfsal_handle_t * p_object_handle,    /* IN */
                                proxyfsal_op_context_t * p_context,      /* IN */
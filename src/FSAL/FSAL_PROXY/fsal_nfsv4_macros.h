@@ -263,15 +263,15 @@ do {
 #define COMPOUNDV4_EXECUTE( pcontext, argcompound, rescompound, rc )                      \
 do {                                                                                      \
   int __renew_rc = 0 ;                                                                    \
+  AUTH * __auth ;                                                                         \
   rc = -1 ;                                                                               \
   do {                                                                                    \
   if( __renew_rc == 0 )                                                                   \
       {                                                                                   \
-        if( FSAL_proxy_change_user( pcontext ) == NULL ) break  ;                         \
-        if( ( rc = clnt_call( pcontext->rpc_client, NFSPROC4_COMPOUND,                    \
-                              (xdrproc_t)xdr_COMPOUND4args, (caddr_t)&argcompound,        \
-                              (xdrproc_t)xdr_COMPOUND4res,  (caddr_t)&rescompound,        \
-                              timeout ) ) == RPC_SUCCESS )                                \
+        if( ( __auth = FSAL_proxy_change_user( pcontext ) ) == NULL ) break  ;            \
+        if( ( rc = fsal_proxy_rpc_compound( pcontext, __auth,                             \
+                                            &argcompound, &rescompound,                   \
+                                            timeout ) ) == RPC_SUCCESS )                  \
               break ;                                                                     \
        }                                                                                  \
   LogEvent(COMPONENT_FSAL, "Reconnecting to the remote server.." ) ;                      \
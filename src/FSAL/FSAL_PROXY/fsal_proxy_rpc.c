@@ -0,0 +1,888 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    fsal_proxy_rpc.c
+ * \brief   Pipelined RPC client to the proxied server.
+ *
+ * fsal_proxy_rpc.c : The COMPOUNDs are sent on a pool of TCP connections
+ * shared by all the worker threads, instead of one synchronous clnt_call
+ * on the connection of each thread. A caller encodes its request with its
+ * own xid, sends it on the least busy connection and sleeps; the receiver
+ * thread of the connection matches the replies to the callers by xid, in
+ * whatever order they come, and decodes each of them in the buffers of its
+ * caller.
+ *
+ * The small read only COMPOUNDs (PUTFH, LOOKUP, GETATTR, GETFH, ACCESS) of
+ * callers with the same credentials are merged when the server is busy: at
+ * most one merged COMPOUND per connection is in flight, the requests coming
+ * meanwhile queue up and go together in the next one. As each of them
+ * starts with a PUTFH, their ops do not interfere; when an op fails the
+ * server stops there, the requests after it are sent again.
+ *
+ * UDP and RPCSEC_GSS keep to the per thread client.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netdb.h>              /* For rresvport */
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "rpc.h"
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "fsal.h"
+#include "fsal_internal.h"
+
+#define FSAL_PROXY_RPC_PENDING_HASH  61
+#define FSAL_PROXY_RPC_LAST_FRAG     0x80000000U
+
+typedef struct fsal_proxy_rpc_call__
+{
+  u_int32_t xid;
+  xdrproc_t xdr_res;
+  caddr_t res;
+  enum clnt_stat status;
+  int done;
+  pthread_cond_t cond;
+  struct fsal_proxy_rpc_call__ *next;
+} fsal_proxy_rpc_call_t;
+
+typedef struct fsal_proxy_rpc_conn__
+{
+  unsigned int index;
+  int fd;                       /* -1 while disconnected */
+  unsigned int nb_pending;
+  pthread_mutex_t lock;         /* fd and pending calls */
+  pthread_mutex_t send_lock;    /* one record at a time on the socket */
+  fsal_proxy_rpc_call_t *pending[FSAL_PROXY_RPC_PENDING_HASH];
+  pthread_t receiver;
+} fsal_proxy_rpc_conn_t;
+
+typedef struct fsal_proxy_merge_req__
+{
+  COMPOUND4args *args;
+  COMPOUND4res *res;
+  struct user_credentials *cred;
+  enum clnt_stat status;
+  int done;
+  int leader;
+  pthread_cond_t cond;
+  struct fsal_proxy_merge_req__ *next;
+} fsal_proxy_merge_req_t;
+
+static int rpc_enabled = FALSE;
+static struct sockaddr_in rpc_addr;
+static unsigned int rpc_prognum;
+static unsigned int rpc_sendsize;
+static unsigned int rpc_recvsize;
+static unsigned int rpc_privileged_port;
+static unsigned int rpc_nb_conns;
+static fsal_proxy_rpc_conn_t *rpc_conns;
+static u_int32_t rpc_xid;
+
+static int merge_enabled = FALSE;
+static pthread_mutex_t merge_lock = PTHREAD_MUTEX_INITIALIZER;
+static fsal_proxy_merge_req_t *merge_head = NULL;
+static fsal_proxy_merge_req_t *merge_tail = NULL;
+static unsigned int merge_inflight = 0;
+
+static unsigned long long nb_compounds_sent = 0;
+static unsigned long long nb_compounds_merged = 0;
+
+static int fsal_proxy_rpc_connect(void)
+{
+  int sock;
+  int priv_port = 0;
+  int one = 1;
+
+  if(rpc_privileged_port)
+    sock = rresvport(&priv_port);
+  else
+    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+  if(sock < 0)
+    return -1;
+
+  if(connect(sock, (struct sockaddr *)&rpc_addr, sizeof(rpc_addr)) < 0)
+    {
+      close(sock);
+      return -1;
+    }
+
+  /* Requests are small and their callers wait for them */
+  setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  return sock;
+}                               /* fsal_proxy_rpc_connect */
+
+/* Removes a pending call, conn->lock held */
+static fsal_proxy_rpc_call_t *fsal_proxy_rpc_unlink(fsal_proxy_rpc_conn_t * conn,
+                                                    u_int32_t xid)
+{
+  fsal_proxy_rpc_call_t **ppcall;
+  fsal_proxy_rpc_call_t *pcall;
+
+  for(ppcall = &conn->pending[xid % FSAL_PROXY_RPC_PENDING_HASH];
+      (pcall = *ppcall) != NULL; ppcall = &pcall->next)
+    if(pcall->xid == xid)
+      {
+        *ppcall = pcall->next;
+        conn->nb_pending -= 1;
+        return pcall;
+      }
+
+  return NULL;
+}                               /* fsal_proxy_rpc_unlink */
+
+/* Fails all the pending calls of a connection, conn->lock held */
+static void fsal_proxy_rpc_fail_all(fsal_proxy_rpc_conn_t * conn, enum clnt_stat status)
+{
+  fsal_proxy_rpc_call_t *pcall;
+  unsigned int i;
+
+  for(i = 0; i < FSAL_PROXY_RPC_PENDING_HASH; i++)
+    while((pcall = conn->pending[i]) != NULL)
+      {
+        conn->pending[i] = pcall->next;
+        pcall->status = status;
+        pcall->done = TRUE;
+        pthread_cond_signal(&pcall->cond);
+      }
+
+  conn->nb_pending = 0;
+}                               /* fsal_proxy_rpc_fail_all */
+
+static int fsal_proxy_rpc_read_all(int fd, char *buf, size_t len)
+{
+  ssize_t rc;
+
+  while(len > 0)
+    {
+      rc = read(fd, buf, len);
+      if(rc <= 0)
+        {
+          if(rc < 0 && errno == EINTR)
+            continue;
+          return -1;
+        }
+      buf += rc;
+      len -= rc;
+    }
+
+  return 0;
+}                               /* fsal_proxy_rpc_read_all */
+
+/**
+ *
+ * fsal_proxy_rpc_read_record: reads a whole RPC record.
+ *
+ * @param fd      [IN]    connected socket
+ * @param pbuf    [INOUT] receive buffer, grown as needed
+ * @param psize   [INOUT] size of the receive buffer
+ *
+ * @return the length of the record, -1 if the connection is broken.
+ *
+ */
+static ssize_t fsal_proxy_rpc_read_record(int fd, char **pbuf, size_t * psize)
+{
+  u_int32_t mark;
+  size_t len = 0;
+  size_t frag_len;
+  char *newbuf;
+
+  do
+    {
+      if(fsal_proxy_rpc_read_all(fd, (char *)&mark, sizeof(mark)) != 0)
+        return -1;
+
+      mark = ntohl(mark);
+      frag_len = mark & ~FSAL_PROXY_RPC_LAST_FRAG;
+
+      if(len + frag_len > *psize)
+        {
+          if((newbuf = (char *)Mem_Alloc_Label(len + frag_len, "proxy_rpc_recv")) == NULL)
+            return -1;
+          memcpy(newbuf, *pbuf, len);
+          Mem_Free(*pbuf);
+          *pbuf = newbuf;
+          *psize = len + frag_len;
+        }
+
+      if(fsal_proxy_rpc_read_all(fd, *pbuf + len, frag_len) != 0)
+        return -1;
+
+      len += frag_len;
+    }
+  while(!(mark & FSAL_PROXY_RPC_LAST_FRAG));
+
+  return len;
+}                               /* fsal_proxy_rpc_read_record */
+
+/**
+ *
+ * fsal_proxy_rpc_decode: decodes a reply in the buffers of its caller.
+ *
+ * @param pcall [IN] the call the reply is for
+ * @param buf   [IN] the reply record
+ * @param len   [IN] its length
+ *
+ * @return the RPC status of the call.
+ *
+ */
+static enum clnt_stat fsal_proxy_rpc_decode(fsal_proxy_rpc_call_t * pcall, char *buf,
+                                            size_t len)
+{
+  XDR xdrs;
+  struct rpc_msg reply;
+  char verf[MAX_AUTH_BYTES];
+  enum clnt_stat status;
+
+  memset(&reply, 0, sizeof(reply));
+  reply.acpted_rply.ar_verf.oa_base = verf;
+  reply.acpted_rply.ar_results.where = pcall->res;
+  reply.acpted_rply.ar_results.proc = pcall->xdr_res;
+
+  xdrmem_create(&xdrs, buf, len, XDR_DECODE);
+
+  if(!xdr_replymsg(&xdrs, &reply))
+    status = RPC_CANTDECODERES;
+  else if(reply.rm_reply.rp_stat != MSG_ACCEPTED)
+    status = reply.rjcted_rply.rj_stat == RPC_MISMATCH ? RPC_VERSMISMATCH : RPC_AUTHERROR;
+  else
+    switch (reply.acpted_rply.ar_stat)
+      {
+      case SUCCESS:
+        status = RPC_SUCCESS;
+        break;
+      case PROG_UNAVAIL:
+        status = RPC_PROGUNAVAIL;
+        break;
+      case PROG_MISMATCH:
+        status = RPC_PROGVERSMISMATCH;
+        break;
+      case PROC_UNAVAIL:
+        status = RPC_PROCUNAVAIL;
+        break;
+      case GARBAGE_ARGS:
+        status = RPC_CANTDECODEARGS;
+        break;
+      default:
+        status = RPC_SYSTEMERROR;
+        break;
+      }
+
+  XDR_DESTROY(&xdrs);
+
+  return status;
+}                               /* fsal_proxy_rpc_decode */
+
+/**
+ *
+ * fsal_proxy_rpc_receiver: receiver thread of a backend connection.
+ *
+ * Connects, then reads the replies and hands them to their callers. When
+ * the connection breaks, its pending calls fail with RPC_CANTRECV and it
+ * is connected again.
+ *
+ * @param arg [IN] the connection
+ *
+ */
+static void *fsal_proxy_rpc_receiver(void *arg)
+{
+  fsal_proxy_rpc_conn_t *conn = (fsal_proxy_rpc_conn_t *) arg;
+  fsal_proxy_rpc_call_t *pcall;
+  char *buf;
+  size_t size = rpc_recvsize;
+  ssize_t len;
+  enum clnt_stat status;
+  u_int32_t xid;
+  int fd;
+
+  SetNameFunction("proxy_rpc_recv");
+
+  if((buf = (char *)Mem_Alloc_Label(size, "proxy_rpc_recv")) == NULL)
+    {
+      LogCrit(COMPONENT_FSAL, "FSAL PROXY RPC : could not allocate a receive buffer");
+      return NULL;
+    }
+
+  while(1)
+    {
+      if((fd = fsal_proxy_rpc_connect()) < 0)
+        {
+          sleep(1);
+          continue;
+        }
+
+      LogDebug(COMPONENT_FSAL, "FSAL PROXY RPC : connection #%u established", conn->index);
+
+      P(conn->lock);
+      conn->fd = fd;
+      V(conn->lock);
+
+      while((len = fsal_proxy_rpc_read_record(fd, &buf, &size)) >= (ssize_t) sizeof(xid))
+        {
+          xid = ntohl(*(u_int32_t *) buf);
+
+          P(conn->lock);
+          pcall = fsal_proxy_rpc_unlink(conn, xid);
+          V(conn->lock);
+
+          if(pcall == NULL)
+            {
+              /* Its caller timed out */
+              LogDebug(COMPONENT_FSAL, "FSAL PROXY RPC : dropping reply xid=%u", xid);
+              continue;
+            }
+
+          status = fsal_proxy_rpc_decode(pcall, buf, len);
+
+          P(conn->lock);
+          pcall->status = status;
+          pcall->done = TRUE;
+          pthread_cond_signal(&pcall->cond);
+          V(conn->lock);
+        }
+
+      LogEvent(COMPONENT_FSAL,
+               "FSAL PROXY RPC : connection #%u to the remote server lost, reconnecting",
+               conn->index);
+
+      /* No sender may still be writing on the socket */
+      P(conn->send_lock);
+      P(conn->lock);
+      close(fd);
+      conn->fd = -1;
+      fsal_proxy_rpc_fail_all(conn, RPC_CANTRECV);
+      V(conn->lock);
+      V(conn->send_lock);
+    }
+
+  return NULL;
+}                               /* fsal_proxy_rpc_receiver */
+
+/**
+ *
+ * fsal_proxy_rpc_init: starts the pool of backend connections.
+ *
+ * The connections are established by their receiver threads, so this does
+ * not fail when the server is not up yet.
+ *
+ * @param pinfo [IN] proxy configuration
+ *
+ * @return 0 if the pool is used, -1 if the callers keep their own client.
+ *
+ */
+int fsal_proxy_rpc_init(proxyfs_specific_initinfo_t * pinfo)
+{
+  pthread_attr_t attr_thr;
+  struct timeval now;
+  unsigned int i;
+  int rc;
+
+  if(pinfo->nb_backend_conns == 0 || strcasecmp(pinfo->srv_proto, "tcp")
+     || pinfo->active_krb5)
+    return -1;
+
+  memset(&rpc_addr, 0, sizeof(rpc_addr));
+  rpc_addr.sin_family = AF_INET;
+  rpc_addr.sin_port = pinfo->srv_port;
+  rpc_addr.sin_addr.s_addr = pinfo->srv_addr;
+  rpc_prognum = pinfo->srv_prognum;
+  rpc_sendsize = pinfo->srv_sendsize;
+  rpc_recvsize = pinfo->srv_recvsize;
+  rpc_privileged_port = pinfo->use_privileged_client_port;
+  rpc_nb_conns = pinfo->nb_backend_conns;
+
+  gettimeofday(&now, NULL);
+  rpc_xid = (u_int32_t) (now.tv_sec ^ now.tv_usec);
+
+  if((rpc_conns = (fsal_proxy_rpc_conn_t *) Mem_Calloc_Label(rpc_nb_conns,
+                                                             sizeof(fsal_proxy_rpc_conn_t),
+                                                             "proxy_rpc_conn")) == NULL)
+    return -1;
+
+  pthread_attr_init(&attr_thr);
+  pthread_attr_setscope(&attr_thr, PTHREAD_SCOPE_SYSTEM);
+  pthread_attr_setdetachstate(&attr_thr, PTHREAD_CREATE_DETACHED);
+
+  for(i = 0; i < rpc_nb_conns; i++)
+    {
+      rpc_conns[i].index = i;
+      rpc_conns[i].fd = -1;
+      pthread_mutex_init(&rpc_conns[i].lock, NULL);
+      pthread_mutex_init(&rpc_conns[i].send_lock, NULL);
+
+      if((rc = pthread_create(&rpc_conns[i].receiver, &attr_thr,
+                              fsal_proxy_rpc_receiver, &rpc_conns[i])) != 0)
+        {
+          LogError(COMPONENT_FSAL, ERR_SYS, ERR_PTHREAD_CREATE, rc);
+          return -1;
+        }
+    }
+
+  merge_enabled = pinfo->merge_compounds;
+  rpc_enabled = TRUE;
+
+  LogEvent(COMPONENT_FSAL,
+           "FSAL PROXY RPC : %u backend connections, COMPOUND merging %s",
+           rpc_nb_conns, merge_enabled ? "enabled" : "disabled");
+
+  return 0;
+}                               /* fsal_proxy_rpc_init */
+
+/* Encodes a call into buf, after room for the record mark */
+static size_t fsal_proxy_rpc_encode(char *buf, size_t size, u_int32_t xid, AUTH * auth,
+                                    xdrproc_t xdr_args, caddr_t args)
+{
+  XDR xdrs;
+  struct rpc_msg call;
+  u_int32_t proc = NFSPROC4_COMPOUND;
+  u_int32_t len;
+
+  memset(&call, 0, sizeof(call));
+  call.rm_xid = xid;
+  call.rm_direction = CALL;
+  call.rm_call.cb_rpcvers = RPC_MSG_VERSION;
+  call.rm_call.cb_prog = rpc_prognum;
+  call.rm_call.cb_vers = FSAL_PROXY_NFS_V4;
+
+  xdrmem_create(&xdrs, buf + sizeof(u_int32_t), size - sizeof(u_int32_t), XDR_ENCODE);
+
+  if(!xdr_callhdr(&xdrs, &call) || !xdr_u_int32_t(&xdrs, &proc)
+     || !AUTH_MARSHALL(auth, &xdrs) || !xdr_args(&xdrs, args))
+    {
+      XDR_DESTROY(&xdrs);
+      return 0;
+    }
+
+  len = XDR_GETPOS(&xdrs);
+  XDR_DESTROY(&xdrs);
+
+  *(u_int32_t *) buf = htonl(FSAL_PROXY_RPC_LAST_FRAG | len);
+
+  return len + sizeof(u_int32_t);
+}                               /* fsal_proxy_rpc_encode */
+
+/**
+ *
+ * fsal_proxy_rpc_call: sends a COMPOUND and waits for its reply.
+ *
+ * The call goes on the connection with the fewest pending calls. Other
+ * callers may send theirs on the same connection while this one waits.
+ *
+ * @param auth    [IN]  credentials of the call
+ * @param args    [IN]  COMPOUND arguments
+ * @param res     [OUT] COMPOUND results, in the buffers set up by the caller
+ * @param timeout [IN]  how long to wait for the reply
+ *
+ * @return the RPC status, as clnt_call.
+ *
+ */
+static enum clnt_stat fsal_proxy_rpc_call(AUTH * auth, COMPOUND4args * args,
+                                          COMPOUND4res * res, struct timeval timeout)
+{
+  fsal_proxy_rpc_conn_t *conn = &rpc_conns[0];
+  fsal_proxy_rpc_call_t call;
+  struct timeval now;
+  struct timespec deadline;
+  char *buf;
+  size_t len;
+  ssize_t rc;
+  size_t off;
+  unsigned int i;
+  int fd;
+
+  /* Least busy of the connected ones */
+  for(i = 1; i < rpc_nb_conns; i++)
+    if(rpc_conns[i].fd >= 0
+       && (conn->fd < 0 || rpc_conns[i].nb_pending < conn->nb_pending))
+      conn = &rpc_conns[i];
+
+  if((buf = (char *)Mem_Alloc_Label(rpc_sendsize, "proxy_rpc_send")) == NULL)
+    return RPC_SYSTEMERROR;
+
+  call.xid = __sync_add_and_fetch(&rpc_xid, 1);
+  call.xdr_res = (xdrproc_t) xdr_COMPOUND4res;
+  call.res = (caddr_t) res;
+  call.done = FALSE;
+  call.status = RPC_SUCCESS;
+  pthread_cond_init(&call.cond, NULL);
+
+  if((len = fsal_proxy_rpc_encode(buf, rpc_sendsize, call.xid, auth,
+                                  (xdrproc_t) xdr_COMPOUND4args, (caddr_t) args)) == 0)
+    {
+      Mem_Free(buf);
+      pthread_cond_destroy(&call.cond);
+      return RPC_CANTENCODEARGS;
+    }
+
+  /* Pending before sent, the reply may come right away */
+  P(conn->lock);
+  if(conn->fd < 0)
+    {
+      V(conn->lock);
+      Mem_Free(buf);
+      pthread_cond_destroy(&call.cond);
+      return RPC_CANTSEND;
+    }
+  call.next = conn->pending[call.xid % FSAL_PROXY_RPC_PENDING_HASH];
+  conn->pending[call.xid % FSAL_PROXY_RPC_PENDING_HASH] = &call;
+  conn->nb_pending += 1;
+  V(conn->lock);
+
+  P(conn->send_lock);
+  fd = conn->fd;
+  for(off = 0, rc = 0; fd >= 0 && off < len; off += rc)
+    if((rc = write(fd, buf + off, len - off)) <= 0)
+      {
+        if(rc < 0 && errno == EINTR)
+          {
+            rc = 0;
+            continue;
+          }
+        /* Let the receiver notice and reconnect */
+        shutdown(fd, SHUT_RDWR);
+        break;
+      }
+  V(conn->send_lock);
+
+  Mem_Free(buf);
+
+  __sync_fetch_and_add(&nb_compounds_sent, 1);
+
+  gettimeofday(&now, NULL);
+  deadline.tv_sec = now.tv_sec + timeout.tv_sec;
+  deadline.tv_nsec = (now.tv_usec + timeout.tv_usec) * 1000;
+  if(deadline.tv_nsec >= 1000000000)
+    {
+      deadline.tv_sec += 1;
+      deadline.tv_nsec -= 1000000000;
+    }
+
+  P(conn->lock);
+  while(!call.done)
+    if(pthread_cond_timedwait(&call.cond, &conn->lock, &deadline) == ETIMEDOUT
+       && !call.done)
+      {
+        /* Unless the receiver is decoding the reply, give up */
+        if(fsal_proxy_rpc_unlink(conn, call.xid) != NULL)
+          {
+            call.status = RPC_TIMEDOUT;
+            break;
+          }
+        deadline.tv_sec += 3600;
+      }
+  V(conn->lock);
+
+  pthread_cond_destroy(&call.cond);
+
+  return call.status;
+}                               /* fsal_proxy_rpc_call */
+
+/* Tells if a COMPOUND may be merged with others */
+static int fsal_proxy_rpc_mergeable(COMPOUND4args * args)
+{
+  unsigned int i;
+
+  if(args->minorversion != 0 || args->argarray.argarray_len == 0
+     || args->argarray.argarray_len > FSAL_PROXY_MERGE_MAX_OPS / 2)
+    return FALSE;
+
+  /* Must not depend on the current filehandle of a previous request */
+  if(args->argarray.argarray_val[0].argop != NFS4_OP_PUTFH
+     && args->argarray.argarray_val[0].argop != NFS4_OP_PUTROOTFH)
+    return FALSE;
+
+  for(i = 1; i < args->argarray.argarray_len; i++)
+    switch (args->argarray.argarray_val[i].argop)
+      {
+      case NFS4_OP_PUTFH:
+      case NFS4_OP_PUTROOTFH:
+      case NFS4_OP_LOOKUP:
+      case NFS4_OP_LOOKUPP:
+      case NFS4_OP_GETATTR:
+      case NFS4_OP_GETFH:
+      case NFS4_OP_ACCESS:
+        break;
+
+      default:
+        return FALSE;
+      }
+
+  return TRUE;
+}                               /* fsal_proxy_rpc_mergeable */
+
+static int fsal_proxy_rpc_same_cred(struct user_credentials *cred1,
+                                    struct user_credentials *cred2)
+{
+  return cred1->user == cred2->user && cred1->group == cred2->group
+      && cred1->nbgroups == cred2->nbgroups
+      && !memcmp(cred1->alt_groups, cred2->alt_groups, cred1->nbgroups * sizeof(gid_t));
+}                               /* fsal_proxy_rpc_same_cred */
+
+/**
+ *
+ * fsal_proxy_rpc_run_batch: sends requests as merged COMPOUNDs.
+ *
+ * The ops of the requests are put one after the other in a COMPOUND whose
+ * results are decoded in the buffers of their requests. The server stops at
+ * the first failing op: the requests before it are done, the one holding it
+ * gets the error as it would have alone, the ones after it go in another
+ * COMPOUND.
+ *
+ * @param auth    [IN]    credentials common to the requests
+ * @param batch   [INOUT] the requests, their status is set
+ * @param nb_reqs [IN]    number of requests
+ * @param timeout [IN]    how long to wait for each reply
+ *
+ */
+static void fsal_proxy_rpc_run_batch(AUTH * auth, fsal_proxy_merge_req_t ** batch,
+                                     unsigned int nb_reqs, struct timeval timeout)
+{
+  fsal_proxy_merge_req_t *reqs[FSAL_PROXY_MERGE_MAX_OPS];
+  nfs_argop4 argops[FSAL_PROXY_MERGE_MAX_OPS];
+  nfs_resop4 resops[FSAL_PROXY_MERGE_MAX_OPS];
+  unsigned int offsets[FSAL_PROXY_MERGE_MAX_OPS];
+  COMPOUND4args margs;
+  COMPOUND4res mres;
+  enum clnt_stat status;
+  unsigned int nb_ops, nb_done, nb_left, len, i;
+
+  /* Those still to be sent */
+  memcpy(reqs, batch, nb_reqs * sizeof(fsal_proxy_merge_req_t *));
+
+  while(nb_reqs > 1)
+    {
+      nb_ops = 0;
+      for(i = 0; i < nb_reqs; i++)
+        {
+          len = reqs[i]->args->argarray.argarray_len;
+          offsets[i] = nb_ops;
+          memcpy(&argops[nb_ops], reqs[i]->args->argarray.argarray_val,
+                 len * sizeof(nfs_argop4));
+          /* Carries the result buffers set up by the caller */
+          memcpy(&resops[nb_ops], reqs[i]->res->resarray.resarray_val,
+                 len * sizeof(nfs_resop4));
+          nb_ops += len;
+        }
+
+      memset(&margs, 0, sizeof(margs));
+      margs.minorversion = 0;
+      margs.argarray.argarray_len = nb_ops;
+      margs.argarray.argarray_val = argops;
+
+      memset(&mres, 0, sizeof(mres));
+      mres.resarray.resarray_len = nb_ops;
+      mres.resarray.resarray_val = resops;
+
+      __sync_fetch_and_add(&nb_compounds_merged, 1);
+
+      if((status = fsal_proxy_rpc_call(auth, &margs, &mres, timeout)) != RPC_SUCCESS)
+        {
+          for(i = 0; i < nb_reqs; i++)
+            reqs[i]->status = status;
+          return;
+        }
+
+      /* The server may not take that many ops */
+      if(mres.status == NFS4ERR_RESOURCE)
+        break;
+
+      nb_done = mres.resarray.resarray_len;
+      for(i = 0, nb_left = 0; i < nb_reqs; i++)
+        {
+          if(offsets[i] >= nb_done)
+            {
+              reqs[nb_left++] = reqs[i];
+              continue;
+            }
+
+          len = reqs[i]->args->argarray.argarray_len;
+          if(offsets[i] + len > nb_done)
+            len = nb_done - offsets[i];
+
+          memcpy(reqs[i]->res->resarray.resarray_val, &resops[offsets[i]],
+                 len * sizeof(nfs_resop4));
+          reqs[i]->res->resarray.resarray_len = len;
+          reqs[i]->res->status = offsets[i] + len == nb_done ? mres.status : NFS4_OK;
+          reqs[i]->res->tag.utf8string_len = 0;
+          reqs[i]->status = RPC_SUCCESS;
+        }
+
+      nb_reqs = nb_left;
+    }
+
+  for(i = 0; i < nb_reqs; i++)
+    reqs[i]->status = fsal_proxy_rpc_call(auth, reqs[i]->args, reqs[i]->res, timeout);
+}                               /* fsal_proxy_rpc_run_batch */
+
+/**
+ *
+ * fsal_proxy_rpc_merge: sends a mergeable COMPOUND.
+ *
+ * While fewer merged COMPOUNDs than connections are in flight, the request
+ * is sent at once. Otherwise it waits in the queue: the caller whose
+ * COMPOUND completes hands over to the first waiting request, which takes
+ * along the other waiting requests with the same credentials.
+ *
+ */
+static enum clnt_stat fsal_proxy_rpc_merge(AUTH * auth, struct user_credentials *cred,
+                                           COMPOUND4args * args, COMPOUND4res * res,
+                                           struct timeval timeout)
+{
+  fsal_proxy_merge_req_t req;
+  fsal_proxy_merge_req_t *batch[FSAL_PROXY_MERGE_MAX_OPS];
+  fsal_proxy_merge_req_t **ppreq;
+  fsal_proxy_merge_req_t *preq;
+  unsigned int nb_reqs, nb_ops, i;
+
+  req.args = args;
+  req.res = res;
+  req.cred = cred;
+  req.done = FALSE;
+  req.leader = FALSE;
+  req.next = NULL;
+  pthread_cond_init(&req.cond, NULL);
+
+  P(merge_lock);
+  if(merge_head == NULL && merge_inflight < rpc_nb_conns)
+    {
+      merge_inflight += 1;
+      req.leader = TRUE;
+    }
+  else
+    {
+      if(merge_tail == NULL)
+        merge_head = &req;
+      else
+        merge_tail->next = &req;
+      merge_tail = &req;
+
+      while(!req.done && !req.leader)
+        pthread_cond_wait(&req.cond, &merge_lock);
+    }
+
+  if(req.done)
+    {
+      V(merge_lock);
+      pthread_cond_destroy(&req.cond);
+      return req.status;
+    }
+
+  /* Take along the waiting requests that fit */
+  batch[0] = &req;
+  nb_reqs = 1;
+  nb_ops = args->argarray.argarray_len;
+  for(ppreq = &merge_head, preq = NULL; (preq = *ppreq) != NULL;)
+    if(nb_ops + preq->args->argarray.argarray_len <= FSAL_PROXY_MERGE_MAX_OPS
+       && fsal_proxy_rpc_same_cred(cred, preq->cred))
+      {
+        *ppreq = preq->next;
+        batch[nb_reqs++] = preq;
+        nb_ops += preq->args->argarray.argarray_len;
+      }
+    else
+      ppreq = &preq->next;
+
+  for(merge_tail = NULL, preq = merge_head; preq != NULL; preq = preq->next)
+    merge_tail = preq;
+  V(merge_lock);
+
+  fsal_proxy_rpc_run_batch(auth, batch, nb_reqs, timeout);
+
+  P(merge_lock);
+  for(i = 1; i < nb_reqs; i++)
+    {
+      batch[i]->done = TRUE;
+      pthread_cond_signal(&batch[i]->cond);
+    }
+
+  /* Hand over to the first waiting request */
+  if((preq = merge_head) != NULL)
+    {
+      merge_head = preq->next;
+      if(merge_head == NULL)
+        merge_tail = NULL;
+      preq->leader = TRUE;
+      pthread_cond_signal(&preq->cond);
+    }
+  else
+    merge_inflight -= 1;
+  V(merge_lock);
+
+  pthread_cond_destroy(&req.cond);
+
+  return req.status;
+}                               /* fsal_proxy_rpc_merge */
+
+/**
+ *
+ * fsal_proxy_rpc_compound: sends a COMPOUND to the proxied server.
+ *
+ * Uses the pool of backend connections when it is set up, the client of
+ * the calling thread otherwise.
+ *
+ * @param p_context [IN]  calling thread's context
+ * @param auth      [IN]  credentials of the call, from FSAL_proxy_change_user
+ * @param args      [IN]  COMPOUND arguments
+ * @param res       [OUT] COMPOUND results
+ * @param timeout   [IN]  how long to wait for the reply
+ *
+ * @return the RPC status, as clnt_call.
+ *
+ */
+enum clnt_stat fsal_proxy_rpc_compound(proxyfsal_op_context_t * p_context, AUTH * auth,
+                                       COMPOUND4args * args, COMPOUND4res * res,
+                                       struct timeval timeout)
+{
+  if(!rpc_enabled)
+    return clnt_call(p_context->rpc_client, NFSPROC4_COMPOUND,
+                     (xdrproc_t) xdr_COMPOUND4args, (caddr_t) args,
+                     (xdrproc_t) xdr_COMPOUND4res, (caddr_t) res, timeout);
+
+  if(merge_enabled && fsal_proxy_rpc_mergeable(args))
+    return fsal_proxy_rpc_merge(auth, &p_context->credential, args, res, timeout);
+
+  return fsal_proxy_rpc_call(auth, args, res, timeout);
+}                               /* fsal_proxy_rpc_compound */
+
+/**
+ *
+ * fsal_proxy_rpc_get_stats: number of COMPOUNDs sent, and merged.
+ *
+ */
+void fsal_proxy_rpc_get_stats(unsigned long long *pnb_sent,
+                              unsigned long long *pnb_merged)
+{
+  *pnb_sent = nb_compounds_sent;
+  *pnb_merged = nb_compounds_merged;
+}                               /* fsal_proxy_rpc_get_stats */
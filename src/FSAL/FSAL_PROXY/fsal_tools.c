@@ -508,6 +508,8 @@ fsal_status_t PROXYFSAL_SetDefault_FS_specific_parameter(fsal_parameter_t * out_
   out_parameter->fs_specific_info.srv_sendsize = FSAL_PROXY_SEND_BUFFER_SIZE;   /* Default Buffer Send Size    */
   out_parameter->fs_specific_info.srv_recvsize = FSAL_PROXY_RECV_BUFFER_SIZE;   /* Default Buffer Send Size    */
   out_parameter->fs_specific_info.use_privileged_client_port = FALSE;   /* No privileged port by default */
+  out_parameter->fs_specific_info.nb_backend_conns = FSAL_PROXY_BACKEND_CONNS;  /* Shared pipelined connections */
+  out_parameter->fs_specific_info.merge_compounds = TRUE;       /* Merge small lookups/getattrs */
 
   out_parameter->fs_specific_info.active_krb5 = FALSE;  /* No RPCSEC_GSS by default */
   strncpy(out_parameter->fs_specific_info.local_principal, "(no principal set)", MAXNAMLEN);    /* Principal is nfs@<host>  */
@@ -958,6 +960,14 @@ fsal_status_t PROXYFSAL_load_FS_specific_parameter_from_conf(config_file_t in_co
         {
            out_parameter->fs_specific_info.use_privileged_client_port = StrToBoolean( key_value ) ;
         }
+      else if(!STRCMP(key_name, "Backend_Connections"))
+        {
+          out_parameter->fs_specific_info.nb_backend_conns = (unsigned int)atoi(key_value);
+        }
+      else if(!STRCMP(key_name, "Merge_Compounds"))
+        {
+          out_parameter->fs_specific_info.merge_compounds = StrToBoolean(key_value);
+        }
       else if(!STRCMP(key_name, "Retry_SleepTime"))
         {
           out_parameter->fs_specific_info.retry_sleeptime = (unsigned int)atoi(key_value);
@@ -0,0 +1,539 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    test_proxy_rpc.c
+ * \brief   Checks the pipelined RPC client against a local stand-in server.
+ *
+ * The stand-in server knows PUTFH, PUTROOTFH, LOOKUP, GETATTR and GETFH:
+ * LOOKUP makes the name the current filehandle (but "missing" gives
+ * NFS4ERR_NOENT), GETATTR returns the current filehandle as attribute
+ * values. It answers the requests it has at hand in reverse order, so the
+ * replies come out of order.
+ *
+ * Client threads with two different credentials send lookups, some of them
+ * failing and some not mergeable, and check that each gets its own results.
+ * The number of COMPOUNDs sent per request and the throughput are printed.
+ *
+ * Usage: test_proxy_rpc [nb_loops]
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "rpc.h"
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "fsal.h"
+#include "fsal_internal.h"
+#include "fsal_nfsv4_macros.h"
+#include "MesureTemps.h"
+
+#define NB_THREADS 16
+#define NB_CONNS 2
+#define NB_LOOPS_DEFAULT 5000
+#define NB_BATCH_MAX 64
+#define TEST_BUFF_SIZE 256
+
+static unsigned int nb_loops = NB_LOOPS_DEFAULT;
+static unsigned int nb_errors = 0;
+
+/* One record from the socket, NULL when it is closed */
+static char *server_read_record(int fd, u_int * plen)
+{
+  u_int32_t mark;
+  size_t len;
+  char *buf;
+  ssize_t rc;
+  size_t off;
+
+  for(off = 0; off < sizeof(mark); off += rc)
+    if((rc = read(fd, (char *)&mark + off, sizeof(mark) - off)) <= 0)
+      return NULL;
+
+  /* The client sends one fragment per record */
+  len = ntohl(mark) & 0x7FFFFFFF;
+  if((buf = (char *)malloc(len)) == NULL)
+    return NULL;
+
+  for(off = 0; off < len; off += rc)
+    if((rc = read(fd, buf + off, len - off)) <= 0)
+      {
+        free(buf);
+        return NULL;
+      }
+
+  *plen = len;
+  return buf;
+}                               /* server_read_record */
+
+/* Executes the ops of a COMPOUND, stopping at the first error. The results
+ * get copies of the filehandles, the next ops change the current one */
+static void server_compound(COMPOUND4args * args, COMPOUND4res * res, char *fhbuf)
+{
+  nfs_argop4 *argop;
+  nfs_resop4 *resop;
+  GETATTR4resok *attrok;
+  u_int fhlen = 0;
+  nfsstat4 status = NFS4_OK;
+  unsigned int i;
+
+  res->tag.utf8string_len = 0;
+  res->tag.utf8string_val = NULL;
+  res->resarray.resarray_val = (nfs_resop4 *) calloc(args->argarray.argarray_len,
+                                                     sizeof(nfs_resop4));
+
+  for(i = 0; i < args->argarray.argarray_len && status == NFS4_OK; i++)
+    {
+      argop = &args->argarray.argarray_val[i];
+      resop = &res->resarray.resarray_val[i];
+      resop->resop = argop->argop;
+
+      switch (argop->argop)
+        {
+        case NFS4_OP_PUTFH:
+          fhlen = argop->nfs_argop4_u.opputfh.object.nfs_fh4_len;
+          memcpy(fhbuf, argop->nfs_argop4_u.opputfh.object.nfs_fh4_val, fhlen);
+          break;
+
+        case NFS4_OP_PUTROOTFH:
+          fhlen = 4;
+          memcpy(fhbuf, "root", fhlen);
+          break;
+
+        case NFS4_OP_LOOKUP:
+          if(fhlen == 0)
+            status = NFS4ERR_NOFILEHANDLE;
+          else if(argop->nfs_argop4_u.oplookup.objname.utf8string_len == 7
+                  && !memcmp(argop->nfs_argop4_u.oplookup.objname.utf8string_val,
+                             "missing", 7))
+            status = NFS4ERR_NOENT;
+          else
+            {
+              fhlen = argop->nfs_argop4_u.oplookup.objname.utf8string_len;
+              memcpy(fhbuf, argop->nfs_argop4_u.oplookup.objname.utf8string_val, fhlen);
+            }
+          break;
+
+        case NFS4_OP_GETATTR:
+          attrok = &resop->nfs_resop4_u.opgetattr.GETATTR4res_u.resok4;
+          attrok->obj_attributes.attrmask = argop->nfs_argop4_u.opgetattr.attr_request;
+          attrok->obj_attributes.attr_vals.attrlist4_len = fhlen;
+          attrok->obj_attributes.attr_vals.attrlist4_val = (char *)malloc(fhlen + 1);
+          memcpy(attrok->obj_attributes.attr_vals.attrlist4_val, fhbuf, fhlen);
+          break;
+
+        case NFS4_OP_GETFH:
+          resop->nfs_resop4_u.opgetfh.GETFH4res_u.resok4.object.nfs_fh4_len = fhlen;
+          resop->nfs_resop4_u.opgetfh.GETFH4res_u.resok4.object.nfs_fh4_val =
+              (char *)malloc(fhlen + 1);
+          memcpy(resop->nfs_resop4_u.opgetfh.GETFH4res_u.resok4.object.nfs_fh4_val, fhbuf,
+                 fhlen);
+          break;
+
+        default:
+          status = NFS4ERR_NOTSUPP;
+          break;
+        }
+
+      /* All the results start with their status */
+      resop->nfs_resop4_u.opgetattr.status = status;
+    }
+
+  res->resarray.resarray_len = i;
+  res->status = status;
+}                               /* server_compound */
+
+static void server_free(COMPOUND4res * res)
+{
+  nfs_resop4 *resop;
+  unsigned int i;
+
+  for(i = 0; i < res->resarray.resarray_len; i++)
+    {
+      resop = &res->resarray.resarray_val[i];
+      if(resop->resop == NFS4_OP_GETATTR && resop->nfs_resop4_u.opgetattr.status == NFS4_OK)
+        free(resop->nfs_resop4_u.opgetattr.GETATTR4res_u.resok4.obj_attributes.
+             attr_vals.attrlist4_val);
+      else if(resop->resop == NFS4_OP_GETFH && resop->nfs_resop4_u.opgetfh.status == NFS4_OK)
+        free(resop->nfs_resop4_u.opgetfh.GETFH4res_u.resok4.object.nfs_fh4_val);
+    }
+
+  free(res->resarray.resarray_val);
+}                               /* server_free */
+
+static int server_reply(int fd, char *call, u_int len)
+{
+  XDR xdrs;
+  struct rpc_msg msg;
+  char credbuf[2 * MAX_AUTH_BYTES];
+  char fhbuf[TEST_BUFF_SIZE];
+  COMPOUND4args args;
+  COMPOUND4res res;
+  char *buf;
+  u_int32_t proc;
+  u_int outlen;
+  ssize_t rc;
+  size_t off;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.rm_call.cb_cred.oa_base = credbuf;
+  msg.rm_call.cb_verf.oa_base = credbuf + MAX_AUTH_BYTES;
+  memset(&args, 0, sizeof(args));
+
+  xdrmem_create(&xdrs, call, len, XDR_DECODE);
+  if(!xdr_callmsg(&xdrs, &msg) || !xdr_COMPOUND4args(&xdrs, &args))
+    return -1;
+  proc = msg.rm_call.cb_proc;
+  XDR_DESTROY(&xdrs);
+
+  if(proc != NFSPROC4_COMPOUND)
+    return -1;
+
+  server_compound(&args, &res, fhbuf);
+
+  memset(&msg, 0, sizeof(msg));
+  msg.rm_xid = ntohl(*(u_int32_t *) call);
+  msg.rm_direction = REPLY;
+  msg.rm_reply.rp_stat = MSG_ACCEPTED;
+  msg.acpted_rply.ar_verf = _null_auth;
+  msg.acpted_rply.ar_stat = SUCCESS;
+  msg.acpted_rply.ar_results.where = (caddr_t) & res;
+  msg.acpted_rply.ar_results.proc = (xdrproc_t) xdr_COMPOUND4res;
+
+  buf = (char *)malloc(32768);
+  xdrmem_create(&xdrs, buf + 4, 32768 - 4, XDR_ENCODE);
+  if(!xdr_replymsg(&xdrs, &msg))
+    return -1;
+  outlen = XDR_GETPOS(&xdrs);
+  XDR_DESTROY(&xdrs);
+  *(u_int32_t *) buf = htonl(0x80000000U | outlen);
+
+  for(off = 0; off < outlen + 4; off += rc)
+    if((rc = write(fd, buf + off, outlen + 4 - off)) <= 0)
+      return -1;
+
+  free(buf);
+  server_free(&res);
+  xdr_free((xdrproc_t) xdr_COMPOUND4args, (caddr_t) & args);
+
+  return 0;
+}                               /* server_reply */
+
+/* Serves a connection: takes the calls already there, answers the last first */
+static void *server_conn_thread(void *arg)
+{
+  int fd = (int)(long)arg;
+  char *calls[NB_BATCH_MAX];
+  u_int lens[NB_BATCH_MAX];
+  struct pollfd pfd;
+  int nb_calls;
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+
+  while(1)
+    {
+      nb_calls = 0;
+      do
+        {
+          if((calls[nb_calls] = server_read_record(fd, &lens[nb_calls])) == NULL)
+            {
+              close(fd);
+              return NULL;
+            }
+          nb_calls += 1;
+        }
+      while(nb_calls < NB_BATCH_MAX && poll(&pfd, 1, 0) == 1);
+
+      while(nb_calls-- > 0)
+        {
+          if(server_reply(fd, calls[nb_calls], lens[nb_calls]) != 0)
+            {
+              LogTest("ERROR: the server could not answer a call");
+              exit(1);
+            }
+          free(calls[nb_calls]);
+        }
+    }
+
+  return NULL;
+}                               /* server_conn_thread */
+
+static void *server_thread(void *arg)
+{
+  int sock = (int)(long)arg;
+  pthread_t thrid;
+  int one = 1;
+  int fd;
+
+  while((fd = accept(sock, NULL, NULL)) >= 0)
+    {
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      pthread_create(&thrid, NULL, server_conn_thread, (void *)(long)fd);
+    }
+
+  return NULL;
+}                               /* server_thread */
+
+/* A lookup from a filehandle, checked against what the server does */
+static int client_lookup(proxyfsal_op_context_t * pcontext, AUTH * auth,
+                         unsigned int thr, unsigned int loop)
+{
+  nfs_argop4 argoparray[4];
+  nfs_resop4 resoparray[4];
+  COMPOUND4args argnfs4;
+  COMPOUND4res resnfs4;
+  struct timeval timeout = { 25, 0 };
+  uint32_t bitmap_val[2] = { 0x12, 0x34 };
+  bitmap4 bitmap;
+  uint32_t bitmap_res[2];
+  char attrs_res[TEST_BUFF_SIZE];
+  char fh_res[TEST_BUFF_SIZE];
+  char fh_val[TEST_BUFF_SIZE];
+  char name_val[TEST_BUFF_SIZE];
+  nfs_fh4 fh;
+  component4 name;
+  int missing = (loop % 7 == 3);
+  int nofh = (loop % 11 == 5);
+  enum clnt_stat rc;
+
+  fh.nfs_fh4_len = sprintf(fh_val, "dir-%u", thr);
+  fh.nfs_fh4_val = fh_val;
+  name.utf8string_len = missing ? sprintf(name_val, "missing")
+      : sprintf(name_val, "file-%u-%u", thr, loop);
+  name.utf8string_val = name_val;
+  bitmap.bitmap4_len = 2;
+  bitmap.bitmap4_val = bitmap_val;
+
+  argnfs4.minorversion = 0;
+  argnfs4.tag.utf8string_val = NULL;
+  argnfs4.tag.utf8string_len = 0;
+  argnfs4.argarray.argarray_val = argoparray;
+  argnfs4.argarray.argarray_len = 0;
+  resnfs4.resarray.resarray_val = resoparray;
+
+  /* Without a PUTFH first, it can not be merged */
+  if(!nofh)
+    COMPOUNDV4_ARG_ADD_OP_PUTFH(argnfs4, fh);
+  COMPOUNDV4_ARG_ADD_OP_LOOKUP(argnfs4, name);
+  COMPOUNDV4_ARG_ADD_OP_GETATTR(argnfs4, bitmap);
+  COMPOUNDV4_ARG_ADD_OP_GETFH(argnfs4);
+
+  resoparray[argnfs4.argarray.argarray_len - 2].nfs_resop4_u.opgetattr.GETATTR4res_u.
+      resok4.obj_attributes.attrmask.bitmap4_val = bitmap_res;
+  resoparray[argnfs4.argarray.argarray_len - 2].nfs_resop4_u.opgetattr.GETATTR4res_u.
+      resok4.obj_attributes.attrmask.bitmap4_len = 2;
+  resoparray[argnfs4.argarray.argarray_len - 2].nfs_resop4_u.opgetattr.GETATTR4res_u.
+      resok4.obj_attributes.attr_vals.attrlist4_val = attrs_res;
+  resoparray[argnfs4.argarray.argarray_len - 2].nfs_resop4_u.opgetattr.GETATTR4res_u.
+      resok4.obj_attributes.attr_vals.attrlist4_len = TEST_BUFF_SIZE;
+  resoparray[argnfs4.argarray.argarray_len - 1].nfs_resop4_u.opgetfh.GETFH4res_u.resok4.
+      object.nfs_fh4_val = fh_res;
+  resoparray[argnfs4.argarray.argarray_len - 1].nfs_resop4_u.opgetfh.GETFH4res_u.resok4.
+      object.nfs_fh4_len = TEST_BUFF_SIZE;
+
+  if((rc = fsal_proxy_rpc_compound(pcontext, auth, &argnfs4, &resnfs4, timeout)) !=
+     RPC_SUCCESS)
+    {
+      LogTest("ERROR: thread %u loop %u: RPC status %d", thr, loop, rc);
+      return 1;
+    }
+
+  if(nofh)
+    {
+      if(resnfs4.status != NFS4ERR_NOFILEHANDLE || resnfs4.resarray.resarray_len != 1)
+        {
+          LogTest("ERROR: thread %u loop %u: status %d with %u results, expected NOFILEHANDLE",
+                  thr, loop, resnfs4.status, resnfs4.resarray.resarray_len);
+          return 1;
+        }
+      return 0;
+    }
+
+  if(missing)
+    {
+      if(resnfs4.status != NFS4ERR_NOENT || resnfs4.resarray.resarray_len != 2)
+        {
+          LogTest("ERROR: thread %u loop %u: status %d with %u results, expected NOENT",
+                  thr, loop, resnfs4.status, resnfs4.resarray.resarray_len);
+          return 1;
+        }
+      return 0;
+    }
+
+  if(resnfs4.status != NFS4_OK || resnfs4.resarray.resarray_len != 4
+     || resoparray[2].nfs_resop4_u.opgetattr.GETATTR4res_u.resok4.obj_attributes.
+     attr_vals.attrlist4_len != name.utf8string_len
+     || memcmp(attrs_res, name_val, name.utf8string_len)
+     || bitmap_res[0] != 0x12 || bitmap_res[1] != 0x34
+     || resoparray[3].nfs_resop4_u.opgetfh.GETFH4res_u.resok4.object.nfs_fh4_len !=
+     name.utf8string_len || memcmp(fh_res, name_val, name.utf8string_len))
+    {
+      LogTest("ERROR: thread %u loop %u: status %d, wrong results for %s",
+              thr, loop, resnfs4.status, name_val);
+      return 1;
+    }
+
+  return 0;
+}                               /* client_lookup */
+
+static void *client_thread(void *arg)
+{
+  unsigned int thr = (unsigned int)(long)arg;
+  proxyfsal_op_context_t context;
+  AUTH *auth;
+  unsigned int loop;
+
+  memset(&context, 0, sizeof(context));
+  context.credential.user = 1000 + thr % 2;
+  context.credential.group = 100;
+  auth = authunix_create("test_proxy_rpc", context.credential.user,
+                         context.credential.group, 0, NULL);
+
+  for(loop = 0; loop < nb_loops; loop++)
+    if(client_lookup(&context, auth, thr, loop) != 0)
+      __sync_fetch_and_add(&nb_errors, 1);
+
+  auth_destroy(auth);
+
+  return NULL;
+}                               /* client_thread */
+
+int main(int argc, char *argv[])
+{
+  proxyfs_specific_initinfo_t info;
+  proxyfsal_op_context_t context;
+  struct sockaddr_in addr;
+  socklen_t addrlen = sizeof(addr);
+  pthread_t thrid[NB_THREADS];
+  pthread_t server_thrid;
+  struct Temps debut;
+  struct Temps fin;
+  double secs;
+  unsigned long long nb_sent;
+  unsigned long long nb_merged;
+  nfs_argop4 argoparray[1];
+  nfs_resop4 resoparray[1];
+  COMPOUND4args argnfs4;
+  COMPOUND4res resnfs4;
+  struct timeval timeout = { 25, 0 };
+  AUTH *auth;
+  unsigned int nb_reqs, i;
+  int sock;
+
+  if(argc > 1)
+    nb_loops = (unsigned int)atoi(argv[1]);
+
+#ifndef _NO_BUDDY_SYSTEM
+  if(BuddyInit(NULL) != BUDDY_SUCCESS)
+    {
+      fprintf(stderr, "Error while initializing Buddy system allocator\n");
+      exit(1);
+    }
+#endif
+
+  SetNamePgm("test_proxy_rpc");
+  SetDefaultLogging("TEST");
+  SetNameFunction("main");
+  InitLogging();
+
+  /* The stand-in server */
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0
+     || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0
+     || listen(sock, 16) < 0 || getsockname(sock, (struct sockaddr *)&addr, &addrlen) < 0)
+    {
+      LogTest("ERROR: could not set up the server socket, errno=%d", errno);
+      exit(1);
+    }
+  pthread_create(&server_thrid, NULL, server_thread, (void *)(long)sock);
+
+  memset(&info, 0, sizeof(info));
+  info.srv_addr = addr.sin_addr.s_addr;
+  info.srv_port = addr.sin_port;
+  info.srv_prognum = 100003;
+  info.srv_sendsize = FSAL_PROXY_SEND_BUFFER_SIZE;
+  info.srv_recvsize = FSAL_PROXY_RECV_BUFFER_SIZE;
+  info.nb_backend_conns = NB_CONNS;
+  info.merge_compounds = TRUE;
+  strcpy(info.srv_proto, "tcp");
+
+  if(fsal_proxy_rpc_init(&info) != 0)
+    {
+      LogTest("ERROR: could not start the backend connections");
+      exit(1);
+    }
+
+  /* Until the receivers are connected */
+  memset(&context, 0, sizeof(context));
+  auth = authunix_create("test_proxy_rpc", 1000, 100, 0, NULL);
+  argnfs4.minorversion = 0;
+  argnfs4.tag.utf8string_len = 0;
+  argnfs4.argarray.argarray_val = argoparray;
+  argnfs4.argarray.argarray_len = 0;
+  resnfs4.resarray.resarray_val = resoparray;
+  COMPOUNDV4_ARG_ADD_OP_PUTROOTFH(argnfs4);
+  for(i = 0; i < 100 && fsal_proxy_rpc_compound(&context, auth, &argnfs4, &resnfs4,
+                                                timeout) != RPC_SUCCESS; i++)
+    usleep(100000);
+  auth_destroy(auth);
+
+  nb_reqs = 1;
+
+  MesureTemps(&debut, NULL);
+  for(i = 0; i < NB_THREADS; i++)
+    pthread_create(&thrid[i], NULL, client_thread, (void *)(long)i);
+  for(i = 0; i < NB_THREADS; i++)
+    pthread_join(thrid[i], NULL);
+  MesureTemps(&fin, &debut);
+  secs = fin.secondes + fin.micro_secondes / 1000000.0;
+
+  fsal_proxy_rpc_get_stats(&nb_sent, &nb_merged);
+  nb_reqs += NB_THREADS * nb_loops;
+
+  LogTest("%u requests in %.3f s (%.0f req/s), %llu COMPOUNDs sent, %llu of them merged, %.2f requests per COMPOUND",
+          NB_THREADS * nb_loops, secs, secs > 0 ? NB_THREADS * nb_loops / secs : 0.0,
+          nb_sent, nb_merged, nb_sent ? (double)nb_reqs / nb_sent : 0.0);
+
+  if(nb_errors != 0)
+    {
+      LogTest("ERROR: %u requests got wrong results", nb_errors);
+      exit(1);
+    }
+
+  LogTest("OK: every request got its own results");
+
+  exit(0);
+}                               /* main */
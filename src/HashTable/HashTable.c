@@ -491,10 +491,13 @@ hash_table_t *HashTable_Init(hash_parameter_t hparam)
                    hparam.nb_node_prealloc);
 
       /* Allocate a group of nodes to be managed by the RB Tree. */
-      MakePool(&ht->node_prealloc[i], hparam.nb_node_prealloc, rbt_node_t, NULL, NULL);
-      NamePool(&ht->node_prealloc[i], "%s Hash RBT Nodes index %d", name, i);
-      if(!IsPoolPreallocated(&ht->node_prealloc[i]))
-        return NULL;
+      if(hparam.backend == HASHTABLE_BACKEND_RBT)
+        {
+          MakePool(&ht->node_prealloc[i], hparam.nb_node_prealloc, rbt_node_t, NULL, NULL);
+          NamePool(&ht->node_prealloc[i], "%s Hash RBT Nodes index %d", name, i);
+          if(!IsPoolPreallocated(&ht->node_prealloc[i]))
+            return NULL;
+        }
 
       /* Allocate a group of hash_data_t to be managed as RBT_OPAQ values. */
       MakePool(&ht->pdata_prealloc[i], hparam.nb_node_prealloc, hash_data_t, NULL, NULL);
@@ -532,6 +535,12 @@ hash_table_t *HashTable_Init(hash_parameter_t hparam)
       ht->stat_dynamic[i].notfound.nb_test = 0;
     }
 
+  /* The open addressing backend uses its own tables instead of the RB-Trees */
+  ht->array_oa = NULL;
+  if(hparam.backend == HASHTABLE_BACKEND_OPEN)
+    if(HashTable_OA_Init(ht) != 0)
+      return NULL;
+
   /* final return, if we arrive here, then everything is alright */
   return ht;
 }                               /* HashTable_Init */
@@ -584,11 +593,15 @@ int HashTable_Test_And_Set(hash_table_t * ht, hash_buffer_t * buffkey,
     rbt_value = (*(ht->parameter.hash_func_rbt)) (&ht->parameter, buffkey);
    }
 
-  tete_rbt = &(ht->array_rbt[hashval]);
   LogFullDebug(COMPONENT_HASHTABLE,
                "Key = %p   Value = %p  hashval = %u  rbt_value = %u",
                buffkey->pdata, buffval->pdata, hashval, rbt_value);
 
+  if(ht->parameter.backend == HASHTABLE_BACKEND_OPEN)
+    return HashTable_OA_Test_And_Set(ht, buffkey, buffval, how, hashval, rbt_value);
+
+  tete_rbt = &(ht->array_rbt[hashval]);
+
   /* acquire mutex for protection */
   P_w(&(ht->array_lock[hashval]));
 
@@ -720,6 +733,9 @@ int HashTable_GetRef(hash_table_t * ht, hash_buffer_t * buffkey, hash_buffer_t *
     rbt_value = (*(ht->parameter.hash_func_rbt)) (&ht->parameter, buffkey);
    }
 
+  if(ht->parameter.backend == HASHTABLE_BACKEND_OPEN)
+    return HashTable_OA_GetRef(ht, buffkey, buffval, get_ref, hashval, rbt_value);
+
   tete_rbt = &(ht->array_rbt[hashval]);
 
   /* Acquire mutex */
@@ -784,6 +800,9 @@ int HashTable_Delall(hash_table_t * ht, int (*free_func)(hash_buffer_t, hash_buf
 
   LogFullDebug(COMPONENT_HASHTABLE, "Deleting all entries in hashtable.");
 
+  if(ht->parameter.backend == HASHTABLE_BACKEND_OPEN)
+    return HashTable_OA_Delall(ht, free_func);
+
   /* For each bucket of the hashtable */
   for(hashval = 0; hashval < ht->parameter.index_size; hashval++)
     {
@@ -872,6 +891,10 @@ int HashTable_DelRef(hash_table_t * ht, hash_buffer_t * buffkey,
     rbt_value = (*(ht->parameter.hash_func_rbt)) (&ht->parameter, buffkey);
    }
 
+  if(ht->parameter.backend == HASHTABLE_BACKEND_OPEN)
+    return HashTable_OA_DelRef(ht, buffkey, p_usedbuffkey, p_usedbuffdata, put_ref,
+                               hashval, rbt_value);
+
   /* acquire mutex */
   P_w(&(ht->array_lock[hashval]));
 
@@ -945,6 +968,7 @@ int HashTable_Del(hash_table_t * ht, hash_buffer_t * buffkey,
 void HashTable_GetStats(hash_table_t * ht, hash_stat_t * hstat)
 {
   unsigned int i = 0;
+  unsigned int nb_node = 0;
 
   /* Sanity check */
   if(ht == NULL || hstat == NULL)
@@ -977,13 +1001,19 @@ void HashTable_GetStats(hash_table_t * ht, hash_stat_t * hstat)
 
   for(i = 0; i < ht->parameter.index_size; i++)
     {
-      if(ht->array_rbt[i].rbt_num_node > hstat->computed.max_rbt_num_node)
-        hstat->computed.max_rbt_num_node = ht->array_rbt[i].rbt_num_node;
+      /* With open addressing, the entries of an index stand for its nodes */
+      if(ht->parameter.backend == HASHTABLE_BACKEND_OPEN)
+        nb_node = ht->stat_dynamic[i].nb_entries;
+      else
+        nb_node = ht->array_rbt[i].rbt_num_node;
+
+      if(nb_node > hstat->computed.max_rbt_num_node)
+        hstat->computed.max_rbt_num_node = nb_node;
 
-      if(ht->array_rbt[i].rbt_num_node < hstat->computed.min_rbt_num_node)
-        hstat->computed.min_rbt_num_node = ht->array_rbt[i].rbt_num_node;
+      if(nb_node < hstat->computed.min_rbt_num_node)
+        hstat->computed.min_rbt_num_node = nb_node;
 
-      hstat->computed.average_rbt_num_node += ht->array_rbt[i].rbt_num_node;
+      hstat->computed.average_rbt_num_node += nb_node;
 
       hstat->dynamic.nb_entries += ht->stat_dynamic[i].nb_entries;
 
@@ -1075,6 +1105,12 @@ void HashTable_Log(log_components_t component, hash_table_t * ht)
 
   LogFullDebug(COMPONENT_HASHTABLE,"The hash contains %d entries", nb_entries);
 
+  if(ht->parameter.backend == HASHTABLE_BACKEND_OPEN)
+    {
+      HashTable_OA_Log(component, ht);
+      return;
+    }
+
   for(i = 0; i < ht->parameter.index_size; i++)
     {
       tete_rbt = &((ht->array_rbt)[i]);
@@ -1128,5 +1164,27 @@ void HashTable_Print(hash_table_t * ht)
   HashTable_Log(COMPONENT_STDOUT, ht);
 }                               /* HashTable_Print */
 
+/**
+ * 
+ * HashTable_Str2Backend: Converts the value of a "Backend" configuration item.
+ *
+ * @param str the value read from the configuration file.
+ * @param pbackend the backend, set only if the value is known.
+ *
+ * @return 0 if successfull, -1 if the value is not a known backend.
+ *
+ */
+int HashTable_Str2Backend(char *str, hash_backend_t * pbackend)
+{
+  if(!strcasecmp(str, "RBT") || !strcasecmp(str, "Red_Black_Tree"))
+    *pbackend = HASHTABLE_BACKEND_RBT;
+  else if(!strcasecmp(str, "Open_Addressing") || !strcasecmp(str, "Open"))
+    *pbackend = HASHTABLE_BACKEND_OPEN;
+  else
+    return -1;
+
+  return 0;
+}                               /* HashTable_Str2Backend */
+
 /* @} */
 
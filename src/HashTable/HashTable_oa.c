@@ -0,0 +1,977 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    HashTable_oa.c
+ * \brief   Open addressing backend for the hash tables.
+ *
+ * Each index of the table (the value of hash_func_key) owns a small open
+ * addressing table instead of a red-black tree. Its slots are packed by 7 in
+ * groups of one cache line: a 8 bytes word holding one tag byte per slot,
+ * then the 7 pointers to the hash_data_t of the entries. The tag of a used
+ * slot is made of 7 bits of the hash of its key, so a lookup compares the
+ * 7 tags of a group to the one it looks for with a few arithmetic operations
+ * on the word, and only calls compare_key for the slots whose tag matches.
+ * Groups are probed in a triangular sequence; a group with an empty slot ends
+ * the probe.
+ *
+ * Writers take the write lock of the index, as the red-black trees do, and
+ * make the sequence number of the index odd while they change it. Lookups
+ * take no lock: they read the sequence number, look for the key, and start
+ * over if the sequence number changed meanwhile.
+ *
+ * A lookup may still be reading an entry, its key or a table after a writer
+ * removed them. Lookups count themselves in the current epoch of the index;
+ * a writer that removes something moves the index to the next epoch and waits
+ * for the lookups of the previous one to be done before it frees the table or
+ * gives the entry back, and before it returns, as the caller may then free
+ * the key.
+ *
+ * A table grows (doubles) when 7/8 of its slots are used or deleted; if most
+ * of them are deleted, it is rehashed in place instead. Only the index being
+ * resized is blocked, the other ones keep working.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include "RW_Lock.h"
+#include "HashTable.h"
+#include "stuff_alloc.h"
+#include "log_macros.h"
+
+#define HASH_OA_CACHE_LINE  64
+#define HASH_OA_GROUP_SLOTS 7           /* tags word + 7 pointers = 64 bytes on 64 bits */
+#define HASH_OA_SPIN        100         /* reads of an odd sequence number before yielding */
+
+/* Statistics updated by concurrent lookups */
+#define hash_oa_stat_inc(counter) __sync_fetch_and_add(&(counter), 1)
+
+/* Tag values: the hash tag of a used slot always has its high bit set */
+#define HASH_OA_EMPTY       0x00
+#define HASH_OA_DELETED     0x01
+#define HASH_OA_FULL        0x80
+
+#define HASH_OA_LSB         0x0101010101010101ULL
+#define HASH_OA_MSB         0x8080808080808080ULL
+
+/* The eighth byte of the tags word has no slot */
+#ifdef BIGEND
+#define HASH_OA_SLOTS_MSB   (HASH_OA_MSB & ~0xFFULL)
+#else
+#define HASH_OA_SLOTS_MSB   (HASH_OA_MSB & ~(0xFFULL << 56))
+#endif
+
+#if defined(__i386__) || defined(__x86_64__)
+/* Loads are not reordered with other loads, nor stores with other stores */
+#define hash_oa_barrier() __asm__ __volatile__("":::"memory")
+#else
+#define hash_oa_barrier() __sync_synchronize()
+#endif
+
+typedef struct hash_oa_group__
+{
+  union
+  {
+    volatile unsigned long long word;
+    volatile unsigned char byte[8];
+  } tags;
+  hash_data_t *volatile slots[HASH_OA_GROUP_SLOTS];
+} hash_oa_group_t;
+
+typedef struct hash_oa_table__
+{
+  unsigned int mask;                    /**< number of groups - 1 */
+  unsigned int nb_used;                 /**< slots used or deleted */
+  unsigned int nb_deleted;              /**< slots deleted */
+  hash_oa_group_t *groups;              /**< the groups, aligned on a cache line */
+  void *mem;                            /**< the groups as allocated */
+} hash_oa_table_t;
+
+typedef struct hash_oa_segment__
+{
+  volatile unsigned int seq;            /**< odd while a writer changes the table */
+  volatile unsigned int epoch;          /**< moved forward by writers removing something */
+  volatile unsigned int readers[2];     /**< lookups running, by epoch parity */
+  hash_oa_table_t *volatile table;
+  char pad[HASH_OA_CACHE_LINE - 4 * sizeof(unsigned int) - sizeof(void *)];
+} hash_oa_segment_t;
+
+/**
+ *
+ * hash_oa_mix: spreads the bits of the rbt value of a key (MurmurHash3 finalizer).
+ *
+ * @param rbt_value [IN] the value computed by hash_func_rbt or hash_func_both.
+ *                       Only its 32 low bits are used, as callers of the
+ *                       red-black trees do not all keep the upper ones.
+ *
+ * @return the hash used inside the table of the index.
+ *
+ */
+static unsigned long long hash_oa_mix(unsigned long rbt_value)
+{
+  unsigned long long h = (unsigned long long)(unsigned int)rbt_value;
+
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+
+  return h;
+}                               /* hash_oa_mix */
+
+static unsigned char hash_oa_tag(unsigned long long h)
+{
+  return (unsigned char)(HASH_OA_FULL | (h >> 57));
+}                               /* hash_oa_tag */
+
+/**
+ *
+ * hash_oa_match: finds the slots of a group with a given tag.
+ *
+ * The high bit of a byte of the result is set if the tag of the matching slot
+ * may be 'tag'. There can be false positives, but only when there is also a
+ * real match in the group: the caller checks each candidate.
+ *
+ * @param tags [IN] the tags word of the group.
+ * @param tag  [IN] the tag to look for.
+ *
+ * @return the candidates, 0 if no slot has this tag.
+ *
+ */
+static unsigned long long hash_oa_match(unsigned long long tags, unsigned char tag)
+{
+  unsigned long long x = tags ^ (HASH_OA_LSB * tag);
+
+  return (x - HASH_OA_LSB) & ~x & HASH_OA_SLOTS_MSB;
+}                               /* hash_oa_match */
+
+/* Index of the first candidate of a hash_oa_match result, and the result without it */
+#ifdef BIGEND
+#define hash_oa_first(m) ((unsigned int)__builtin_clzll(m) >> 3)
+#define hash_oa_next(m)  ((m) & ~(0x8000000000000000ULL >> __builtin_clzll(m)))
+#else
+#define hash_oa_first(m) ((unsigned int)__builtin_ctzll(m) >> 3)
+#define hash_oa_next(m)  ((m) & ((m) - 1))
+#endif
+
+/**
+ *
+ * hash_oa_table_alloc: allocates an empty table.
+ *
+ * @param nb_groups [IN] the number of groups, a power of 2.
+ *
+ * @return the table, NULL if the allocation failed.
+ *
+ */
+static hash_oa_table_t *hash_oa_table_alloc(unsigned int nb_groups)
+{
+  hash_oa_table_t *tbl;
+  unsigned int i;
+
+  if((tbl = (hash_oa_table_t *) Mem_Alloc_Label(sizeof(hash_oa_table_t),
+                                                "hash_oa_table_t")) == NULL)
+    return NULL;
+
+  if((tbl->mem = Mem_Alloc_Label(nb_groups * sizeof(hash_oa_group_t) + HASH_OA_CACHE_LINE,
+                                 "hash_oa_group_t")) == NULL)
+    {
+      Mem_Free(tbl);
+      return NULL;
+    }
+
+  tbl->groups = (hash_oa_group_t *)
+      (((unsigned long)tbl->mem + HASH_OA_CACHE_LINE - 1) & ~(unsigned long)(HASH_OA_CACHE_LINE - 1));
+  memset((char *)tbl->groups, 0, nb_groups * sizeof(hash_oa_group_t));
+
+  /* The eighth byte matches no tag, not even HASH_OA_EMPTY */
+  for(i = 0; i < nb_groups; i++)
+    tbl->groups[i].tags.byte[7] = 0x7F;
+
+  tbl->mask = nb_groups - 1;
+  tbl->nb_used = 0;
+  tbl->nb_deleted = 0;
+
+  return tbl;
+}                               /* hash_oa_table_alloc */
+
+static void hash_oa_table_free(hash_oa_table_t * tbl)
+{
+  Mem_Free(tbl->mem);
+  Mem_Free(tbl);
+}                               /* hash_oa_table_free */
+
+/**
+ *
+ * hash_oa_find: looks for a key in a table.
+ *
+ * Called with the lock of the index held, or inside an optimistic read whose
+ * result is thrown away if a writer was active.
+ *
+ * @param ht      [IN]  the hashtable, for compare_key.
+ * @param tbl     [IN]  the table of the index.
+ * @param buffkey [IN]  the key.
+ * @param h       [IN]  the hash of the key.
+ * @param ppgroup [OUT] the group of the entry found.
+ * @param pidx    [OUT] the slot of the entry in this group.
+ *
+ * @return the entry, NULL if the key is not in the table.
+ *
+ */
+static hash_data_t *hash_oa_find(hash_table_t * ht, hash_oa_table_t * tbl,
+                                 hash_buffer_t * buffkey, unsigned long long h,
+                                 hash_oa_group_t ** ppgroup, unsigned int *pidx)
+{
+  hash_oa_group_t *group;
+  hash_data_t *pdata;
+  unsigned long long tags;
+  unsigned long long m;
+  unsigned char tag = hash_oa_tag(h);
+  unsigned int g = (unsigned int)h & tbl->mask;
+  unsigned int step;
+  unsigned int idx;
+
+  for(step = 0; step <= tbl->mask; step++)
+    {
+      group = &tbl->groups[g];
+      tags = group->tags.word;
+
+      for(m = hash_oa_match(tags, tag); m != 0; m = hash_oa_next(m))
+        {
+          idx = hash_oa_first(m);
+          if(group->tags.byte[idx] != tag)
+            continue;
+
+          pdata = group->slots[idx];
+          if(pdata != NULL && !ht->parameter.compare_key(buffkey, &pdata->buffkey))
+            {
+              *ppgroup = group;
+              *pidx = idx;
+              return pdata;
+            }
+        }
+
+      /* No key was ever moved beyond a group with an empty slot */
+      if(hash_oa_match(tags, HASH_OA_EMPTY) != 0)
+        return NULL;
+
+      g = (g + step + 1) & tbl->mask;
+    }
+
+  return NULL;
+}                               /* hash_oa_find */
+
+/**
+ *
+ * hash_oa_place: puts an entry in the first free slot of its probe sequence.
+ * The table must have a free slot. Writer only.
+ *
+ * @param tbl   [INOUT] the table.
+ * @param pdata [IN]    the entry.
+ * @param h     [IN]    the hash of its key.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void hash_oa_place(hash_oa_table_t * tbl, hash_data_t * pdata, unsigned long long h)
+{
+  hash_oa_group_t *group;
+  unsigned long long m;
+  unsigned int g = (unsigned int)h & tbl->mask;
+  unsigned int step;
+  unsigned int idx;
+
+  for(step = 0; step <= tbl->mask; step++)
+    {
+      group = &tbl->groups[g];
+
+      m = hash_oa_match(group->tags.word, HASH_OA_EMPTY) |
+          hash_oa_match(group->tags.word, HASH_OA_DELETED);
+      for(; m != 0; m = hash_oa_next(m))
+        {
+          idx = hash_oa_first(m);
+          if(group->tags.byte[idx] == HASH_OA_EMPTY)
+            tbl->nb_used += 1;
+          else if(group->tags.byte[idx] == HASH_OA_DELETED)
+            tbl->nb_deleted -= 1;
+          else
+            continue;
+
+          group->slots[idx] = pdata;
+          group->tags.byte[idx] = hash_oa_tag(h);
+          return;
+        }
+
+      g = (g + step + 1) & tbl->mask;
+    }
+}                               /* hash_oa_place */
+
+/**
+ *
+ * hash_oa_rehash: moves the entries of a table to another one. Writer only.
+ *
+ * @param ht   [IN]    the hashtable, to hash the keys again.
+ * @param from [IN]    the table to empty, left unchanged.
+ * @param to   [INOUT] the table to fill.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void hash_oa_rehash(hash_table_t * ht, hash_oa_table_t * from, hash_oa_table_t * to)
+{
+  hash_data_t *pdata;
+  unsigned long rbt_value;
+  uint32_t hashval32, rbt_value32;
+  unsigned int g;
+  unsigned int idx;
+
+  for(g = 0; g <= from->mask; g++)
+    for(idx = 0; idx < HASH_OA_GROUP_SLOTS; idx++)
+      {
+        if(!(from->groups[g].tags.byte[idx] & HASH_OA_FULL))
+          continue;
+
+        pdata = from->groups[g].slots[idx];
+
+        if(ht->parameter.hash_func_both != NULL)
+          {
+            (*(ht->parameter.hash_func_both)) (&ht->parameter, &pdata->buffkey,
+                                               &hashval32, &rbt_value32);
+            rbt_value = (unsigned long)rbt_value32;
+          }
+        else
+          rbt_value = (*(ht->parameter.hash_func_rbt)) (&ht->parameter, &pdata->buffkey);
+
+        hash_oa_place(to, pdata, hash_oa_mix(rbt_value));
+      }
+}                               /* hash_oa_rehash */
+
+/**
+ *
+ * hash_oa_make_room: makes sure a table can take one more entry. Writer only,
+ * with the sequence number odd.
+ *
+ * @param ht     [IN]    the hashtable.
+ * @param seg    [INOUT] the index whose table may be replaced.
+ * @param ppold  [OUT]   the replaced table, to be freed after hash_oa_synchronize,
+ *                       NULL if the table was kept.
+ *
+ * @return HASHTABLE_SUCCESS, or HASHTABLE_INSERT_MALLOC_ERROR.
+ *
+ */
+static int hash_oa_make_room(hash_table_t * ht, hash_oa_segment_t * seg,
+                             hash_oa_table_t ** ppold)
+{
+  hash_oa_table_t *tbl = seg->table;
+  hash_oa_table_t *newtbl;
+  hash_oa_group_t *copy;
+  unsigned int nb_groups = tbl->mask + 1;
+  unsigned int capacity = nb_groups * HASH_OA_GROUP_SLOTS;
+  unsigned int i;
+
+  *ppold = NULL;
+
+  if(tbl->nb_used + 1 <= capacity - capacity / 8)
+    return HASHTABLE_SUCCESS;
+
+  if(tbl->nb_deleted > tbl->nb_used / 2)
+    {
+      /* Mostly deleted slots: rehash in place, through a copy of the groups */
+      if((copy = (hash_oa_group_t *) Mem_Alloc_Label(nb_groups * sizeof(hash_oa_group_t),
+                                                     "hash_oa_group_t")) == NULL)
+        return HASHTABLE_INSERT_MALLOC_ERROR;
+
+      memcpy((char *)copy, (char *)tbl->groups, nb_groups * sizeof(hash_oa_group_t));
+      memset((char *)tbl->groups, 0, nb_groups * sizeof(hash_oa_group_t));
+      for(i = 0; i < nb_groups; i++)
+        tbl->groups[i].tags.byte[7] = 0x7F;
+      tbl->nb_used = 0;
+      tbl->nb_deleted = 0;
+
+      {
+        hash_oa_table_t from = *tbl;
+
+        from.groups = copy;
+        hash_oa_rehash(ht, &from, tbl);
+      }
+
+      Mem_Free(copy);
+      return HASHTABLE_SUCCESS;
+    }
+
+  if((newtbl = hash_oa_table_alloc(nb_groups * 2)) == NULL)
+    return HASHTABLE_INSERT_MALLOC_ERROR;
+
+  hash_oa_rehash(ht, tbl, newtbl);
+
+  LogFullDebug(COMPONENT_HASHTABLE,
+               "%s: table of an index grows from %u to %u groups",
+               ht->parameter.name != NULL ? ht->parameter.name : "Unamed",
+               nb_groups, nb_groups * 2);
+
+  /* Lookups started before may still be reading the old table */
+  *ppold = tbl;
+  seg->table = newtbl;
+
+  return HASHTABLE_SUCCESS;
+}                               /* hash_oa_make_room */
+
+static void hash_oa_write_begin(hash_oa_segment_t * seg)
+{
+  seg->seq += 1;
+  __sync_synchronize();
+}                               /* hash_oa_write_begin */
+
+static void hash_oa_write_end(hash_oa_segment_t * seg)
+{
+  hash_oa_barrier();
+  seg->seq += 1;
+}                               /* hash_oa_write_end */
+
+/**
+ *
+ * hash_oa_read_begin: counts a lookup in the current epoch of an index.
+ *
+ * @param seg [INOUT] the index.
+ *
+ * @return the epoch, to be given to hash_oa_read_end.
+ *
+ */
+static unsigned int hash_oa_read_begin(hash_oa_segment_t * seg)
+{
+  unsigned int epoch;
+
+  for(;;)
+    {
+      epoch = seg->epoch;
+      __sync_fetch_and_add(&seg->readers[epoch & 1], 1);
+
+      /* Either the writer moving the epoch sees this lookup, or this lookup
+       * sees the new epoch and counts itself there */
+      if(seg->epoch == epoch)
+        return epoch;
+
+      __sync_fetch_and_sub(&seg->readers[epoch & 1], 1);
+    }
+}                               /* hash_oa_read_begin */
+
+static void hash_oa_read_end(hash_oa_segment_t * seg, unsigned int epoch)
+{
+  __sync_fetch_and_sub(&seg->readers[epoch & 1], 1);
+}                               /* hash_oa_read_end */
+
+/**
+ *
+ * hash_oa_synchronize: waits for the lookups that may still read what a writer
+ * removed from an index. Writer only, after hash_oa_write_end: the lookups
+ * waited for may be waiting for the sequence number to be even.
+ *
+ * @param seg [INOUT] the index.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void hash_oa_synchronize(hash_oa_segment_t * seg)
+{
+  unsigned int epoch = seg->epoch;
+  unsigned int spin = 0;
+
+  seg->epoch = epoch + 1;
+  __sync_synchronize();
+
+  /* The lookups of the new epoch can't see what was removed before */
+  while(seg->readers[epoch & 1] != 0)
+    if(++spin % HASH_OA_SPIN == 0)
+      sched_yield();
+}                               /* hash_oa_synchronize */
+
+/**
+ *
+ * hash_oa_lookup: looks for a key without taking any lock.
+ *
+ * @param ht      [IN]  the hashtable.
+ * @param seg     [IN]  the index of the key.
+ * @param buffkey [IN]  the key.
+ * @param h       [IN]  the hash of the key.
+ * @param buffval [OUT] the value found, may be NULL.
+ *
+ * @return 1 if the key was found, 0 otherwise.
+ *
+ */
+static int hash_oa_lookup(hash_table_t * ht, hash_oa_segment_t * seg,
+                          hash_buffer_t * buffkey, unsigned long long h,
+                          hash_buffer_t * buffval)
+{
+  hash_oa_group_t *group;
+  hash_data_t *pdata;
+  hash_buffer_t val;
+  unsigned int seq;
+  unsigned int idx;
+  unsigned int epoch;
+  unsigned int spin = 0;
+
+  epoch = hash_oa_read_begin(seg);
+
+  for(;;)
+    {
+      seq = seg->seq;
+      if(seq & 1)
+        {
+          /* A writer is busy on this index */
+          if(++spin % HASH_OA_SPIN == 0)
+            sched_yield();
+          continue;
+        }
+      hash_oa_barrier();
+
+      pdata = hash_oa_find(ht, seg->table, buffkey, h, &group, &idx);
+      if(pdata != NULL)
+        val = pdata->buffval;
+
+      hash_oa_barrier();
+      if(seg->seq == seq)
+        break;
+    }
+
+  hash_oa_read_end(seg, epoch);
+
+  if(pdata == NULL)
+    return 0;
+
+  if(buffval != NULL)
+    *buffval = val;
+
+  return 1;
+}                               /* hash_oa_lookup */
+
+/**
+ *
+ * HashTable_OA_Init: allocates the tables of the indexes.
+ *
+ * Each table starts with room for parameter.nb_node_prealloc entries.
+ *
+ * @param ht [INOUT] the hashtable, parameter and array_lock already set.
+ *
+ * @return 0 if successful, -1 otherwise.
+ *
+ */
+int HashTable_OA_Init(hash_table_t * ht)
+{
+  unsigned int nb_groups = 1;
+  unsigned int i;
+
+  while(nb_groups * HASH_OA_GROUP_SLOTS < ht->parameter.nb_node_prealloc)
+    nb_groups <<= 1;
+
+  if((ht->array_oa =
+      (hash_oa_segment_t *) Mem_Alloc_Label(sizeof(hash_oa_segment_t) *
+                                            ht->parameter.index_size,
+                                            "hash_oa_segment_t")) == NULL)
+    return -1;
+
+  for(i = 0; i < ht->parameter.index_size; i++)
+    {
+      ht->array_oa[i].seq = 0;
+      ht->array_oa[i].epoch = 0;
+      ht->array_oa[i].readers[0] = 0;
+      ht->array_oa[i].readers[1] = 0;
+      if((ht->array_oa[i].table = hash_oa_table_alloc(nb_groups)) == NULL)
+        return -1;
+    }
+
+  return 0;
+}                               /* HashTable_OA_Init */
+
+/**
+ *
+ * HashTable_OA_Test_And_Set: HashTable_Test_And_Set for HASHTABLE_BACKEND_OPEN.
+ *
+ * @param ht        [INOUT] the hashtable.
+ * @param buffkey   [IN]    the key.
+ * @param buffval   [IN]    the value.
+ * @param how       [IN]    test only, or set with or without overwrite.
+ * @param hashval   [IN]    the index of the key.
+ * @param rbt_value [IN]    the rbt value of the key.
+ *
+ * @return the same values as HashTable_Test_And_Set.
+ *
+ */
+int HashTable_OA_Test_And_Set(hash_table_t * ht, hash_buffer_t * buffkey,
+                              hash_buffer_t * buffval, hashtable_set_how_t how,
+                              unsigned int hashval, unsigned long rbt_value)
+{
+  hash_oa_segment_t *seg = &ht->array_oa[hashval];
+  hash_oa_table_t *oldtbl = NULL;
+  hash_oa_group_t *group;
+  hash_data_t *pdata;
+  unsigned long long h = hash_oa_mix(rbt_value);
+  unsigned int idx;
+  int rc;
+
+  if(how == HASHTABLE_SET_HOW_TEST_ONLY)
+    {
+      if(hash_oa_lookup(ht, seg, buffkey, h, NULL))
+        {
+          hash_oa_stat_inc(ht->stat_dynamic[hashval].ok.nb_test);
+          return HASHTABLE_SUCCESS;
+        }
+
+      hash_oa_stat_inc(ht->stat_dynamic[hashval].notfound.nb_test);
+      return HASHTABLE_ERROR_NO_SUCH_KEY;
+    }
+
+  P_w(&(ht->array_lock[hashval]));
+
+  if((pdata = hash_oa_find(ht, seg->table, buffkey, h, &group, &idx)) != NULL)
+    {
+      if(how == HASHTABLE_SET_HOW_SET_NO_OVERWRITE)
+        {
+          ht->stat_dynamic[hashval].err.nb_test += 1;
+          V_w(&(ht->array_lock[hashval]));
+          return HASHTABLE_ERROR_KEY_ALREADY_EXISTS;
+        }
+
+      LogFullDebug(COMPONENT_HASHTABLE,
+                   "Entry already exists (k=%p,v=%p)",
+                   buffkey->pdata, buffval->pdata);
+
+      hash_oa_write_begin(seg);
+      pdata->buffval = *buffval;
+      pdata->buffkey = *buffkey;
+      hash_oa_write_end(seg);
+
+      /* The caller may free the key it replaced */
+      hash_oa_synchronize(seg);
+    }
+  else
+    {
+      GetFromPool(pdata, &ht->pdata_prealloc[hashval], hash_data_t);
+      if(pdata == NULL)
+        {
+          ht->stat_dynamic[hashval].err.nb_set += 1;
+          V_w(&(ht->array_lock[hashval]));
+          return HASHTABLE_INSERT_MALLOC_ERROR;
+        }
+
+      pdata->buffval = *buffval;
+      pdata->buffkey = *buffkey;
+
+      hash_oa_write_begin(seg);
+      if((rc = hash_oa_make_room(ht, seg, &oldtbl)) == HASHTABLE_SUCCESS)
+        hash_oa_place(seg->table, pdata, h);
+      hash_oa_write_end(seg);
+
+      if(oldtbl != NULL)
+        {
+          hash_oa_synchronize(seg);
+          hash_oa_table_free(oldtbl);
+        }
+
+      if(rc != HASHTABLE_SUCCESS)
+        {
+          ReleaseToPool(pdata, &ht->pdata_prealloc[hashval]);
+          ht->stat_dynamic[hashval].err.nb_set += 1;
+          V_w(&(ht->array_lock[hashval]));
+          return rc;
+        }
+
+      ht->stat_dynamic[hashval].nb_entries += 1;
+
+      LogFullDebug(COMPONENT_HASHTABLE,
+                   "Create new entry (k=%p,v=%p), pdata=%p",
+                   buffkey->pdata, buffval->pdata, pdata);
+    }
+
+  ht->stat_dynamic[hashval].ok.nb_set += 1;
+
+  V_w(&(ht->array_lock[hashval]));
+
+  return HASHTABLE_SUCCESS;
+}                               /* HashTable_OA_Test_And_Set */
+
+/**
+ *
+ * HashTable_OA_GetRef: HashTable_GetRef for HASHTABLE_BACKEND_OPEN.
+ *
+ * Without get_ref, the lookup takes no lock. With get_ref, the read lock of
+ * the index is taken so that the entry cannot be deleted before get_ref has
+ * run, as HashTable_DelRef calls put_ref with the write lock held.
+ *
+ * @param ht        [IN]  the hashtable.
+ * @param buffkey   [IN]  the key.
+ * @param buffval   [OUT] the value found.
+ * @param get_ref   [IN]  function called on the value found, may be NULL.
+ * @param hashval   [IN]  the index of the key.
+ * @param rbt_value [IN]  the rbt value of the key.
+ *
+ * @return HASHTABLE_SUCCESS, or HASHTABLE_ERROR_NO_SUCH_KEY.
+ *
+ */
+int HashTable_OA_GetRef(hash_table_t * ht, hash_buffer_t * buffkey, hash_buffer_t * buffval,
+                        void (*get_ref)(hash_buffer_t *),
+                        unsigned int hashval, unsigned long rbt_value)
+{
+  hash_oa_segment_t *seg = &ht->array_oa[hashval];
+  hash_oa_group_t *group;
+  hash_data_t *pdata;
+  unsigned long long h = hash_oa_mix(rbt_value);
+  unsigned int idx;
+
+  if(get_ref == NULL)
+    {
+      if(!hash_oa_lookup(ht, seg, buffkey, h, buffval))
+        {
+          hash_oa_stat_inc(ht->stat_dynamic[hashval].notfound.nb_get);
+          return HASHTABLE_ERROR_NO_SUCH_KEY;
+        }
+
+      hash_oa_stat_inc(ht->stat_dynamic[hashval].ok.nb_get);
+      return HASHTABLE_SUCCESS;
+    }
+
+  P_r(&(ht->array_lock[hashval]));
+
+  if((pdata = hash_oa_find(ht, seg->table, buffkey, h, &group, &idx)) == NULL)
+    {
+      hash_oa_stat_inc(ht->stat_dynamic[hashval].notfound.nb_get);
+      V_r(&(ht->array_lock[hashval]));
+      return HASHTABLE_ERROR_NO_SUCH_KEY;
+    }
+
+  *buffval = pdata->buffval;
+  hash_oa_stat_inc(ht->stat_dynamic[hashval].ok.nb_get);
+
+  get_ref(buffval);
+
+  V_r(&(ht->array_lock[hashval]));
+
+  return HASHTABLE_SUCCESS;
+}                               /* HashTable_OA_GetRef */
+
+/**
+ *
+ * HashTable_OA_DelRef: HashTable_DelRef for HASHTABLE_BACKEND_OPEN.
+ *
+ * @param ht             [INOUT] the hashtable.
+ * @param buffkey        [IN]    the key.
+ * @param p_usedbuffkey  [OUT]   the key stored in the entry, may be NULL.
+ * @param p_usedbuffdata [OUT]   the value stored in the entry, may be NULL.
+ * @param put_ref        [IN]    the entry is only removed if it returns 0, may be NULL.
+ * @param hashval        [IN]    the index of the key.
+ * @param rbt_value      [IN]    the rbt value of the key.
+ *
+ * @return the same values as HashTable_DelRef.
+ *
+ */
+int HashTable_OA_DelRef(hash_table_t * ht, hash_buffer_t * buffkey,
+                        hash_buffer_t * p_usedbuffkey, hash_buffer_t * p_usedbuffdata,
+                        int (*put_ref)(hash_buffer_t *),
+                        unsigned int hashval, unsigned long rbt_value)
+{
+  hash_oa_segment_t *seg = &ht->array_oa[hashval];
+  hash_oa_table_t *tbl;
+  hash_oa_group_t *group;
+  hash_data_t *pdata;
+  unsigned long long h = hash_oa_mix(rbt_value);
+  unsigned int idx;
+
+  P_w(&(ht->array_lock[hashval]));
+
+  tbl = seg->table;
+  if((pdata = hash_oa_find(ht, tbl, buffkey, h, &group, &idx)) == NULL)
+    {
+      ht->stat_dynamic[hashval].notfound.nb_del += 1;
+      V_w(&(ht->array_lock[hashval]));
+      return HASHTABLE_ERROR_NO_SUCH_KEY;
+    }
+
+  if(p_usedbuffkey != NULL)
+    *p_usedbuffkey = pdata->buffkey;
+
+  if(p_usedbuffdata != NULL)
+    *p_usedbuffdata = pdata->buffval;
+
+  if(put_ref != NULL)
+    if(put_ref(&pdata->buffval) != 0)
+      {
+        V_w(&(ht->array_lock[hashval]));
+        return HASHTABLE_NOT_DELETED;
+      }
+
+  hash_oa_write_begin(seg);
+
+  /* A group with an empty slot never made a probe go further, so the slot
+   * can be empty again. Otherwise, keys after this group must still be found */
+  group->slots[idx] = NULL;
+  if(hash_oa_match(group->tags.word, HASH_OA_EMPTY) != 0)
+    {
+      group->tags.byte[idx] = HASH_OA_EMPTY;
+      tbl->nb_used -= 1;
+    }
+  else
+    {
+      group->tags.byte[idx] = HASH_OA_DELETED;
+      tbl->nb_deleted += 1;
+    }
+
+  hash_oa_write_end(seg);
+
+  /* Lookups may still compare the key of the entry, that the caller may free */
+  hash_oa_synchronize(seg);
+
+  ht->stat_dynamic[hashval].nb_entries -= 1;
+  ht->stat_dynamic[hashval].ok.nb_del += 1;
+
+  ReleaseToPool(pdata, &ht->pdata_prealloc[hashval]);
+
+  V_w(&(ht->array_lock[hashval]));
+
+  return HASHTABLE_SUCCESS;
+}                               /* HashTable_OA_DelRef */
+
+/**
+ *
+ * HashTable_OA_Delall: HashTable_Delall for HASHTABLE_BACKEND_OPEN.
+ *
+ * @param ht        [INOUT] the hashtable.
+ * @param free_func [IN]    function called on each removed entry.
+ *
+ * @return HASHTABLE_SUCCESS, or HASHTABLE_ERROR_DELALL_FAIL if free_func failed.
+ *
+ */
+int HashTable_OA_Delall(hash_table_t * ht, int (*free_func)(hash_buffer_t, hash_buffer_t) )
+{
+  hash_oa_segment_t *seg;
+  hash_oa_table_t *tbl;
+  hash_oa_group_t *group;
+  hash_data_t *pdata;
+  hash_buffer_t usedbuffkey;
+  hash_buffer_t usedbuffdata;
+  unsigned int hashval;
+  unsigned int g;
+  unsigned int idx;
+
+  for(hashval = 0; hashval < ht->parameter.index_size; hashval++)
+    {
+      seg = &ht->array_oa[hashval];
+
+      P_w(&(ht->array_lock[hashval]));
+
+      tbl = seg->table;
+      for(g = 0; g <= tbl->mask; g++)
+        {
+          group = &tbl->groups[g];
+          for(idx = 0; idx < HASH_OA_GROUP_SLOTS; idx++)
+            {
+              if(!(group->tags.byte[idx] & HASH_OA_FULL))
+                continue;
+
+              pdata = group->slots[idx];
+              usedbuffkey = pdata->buffkey;
+              usedbuffdata = pdata->buffval;
+
+              /* The other keys must still be found until the table is emptied */
+              hash_oa_write_begin(seg);
+              group->slots[idx] = NULL;
+              group->tags.byte[idx] = HASH_OA_DELETED;
+              tbl->nb_deleted += 1;
+              hash_oa_write_end(seg);
+
+              hash_oa_synchronize(seg);
+
+              ReleaseToPool(pdata, &ht->pdata_prealloc[hashval]);
+              ht->stat_dynamic[hashval].nb_entries -= 1;
+              ht->stat_dynamic[hashval].ok.nb_del += 1;
+
+              if(free_func(usedbuffkey, usedbuffdata) == 0)
+                {
+                  /* The table is left consistent, with the remaining entries */
+                  V_w(&(ht->array_lock[hashval]));
+                  return HASHTABLE_ERROR_DELALL_FAIL;
+                }
+            }
+        }
+
+      hash_oa_write_begin(seg);
+      for(g = 0; g <= tbl->mask; g++)
+        for(idx = 0; idx < HASH_OA_GROUP_SLOTS; idx++)
+          tbl->groups[g].tags.byte[idx] = HASH_OA_EMPTY;
+      tbl->nb_used = 0;
+      tbl->nb_deleted = 0;
+      hash_oa_write_end(seg);
+
+      V_w(&(ht->array_lock[hashval]));
+    }
+
+  return HASHTABLE_SUCCESS;
+}                               /* HashTable_OA_Delall */
+
+/**
+ *
+ * HashTable_OA_Log: HashTable_Log for HASHTABLE_BACKEND_OPEN.
+ *
+ * @param component [IN] the component debugging config to use.
+ * @param ht        [IN] the hashtable.
+ *
+ * @return nothing (void function)
+ *
+ */
+void HashTable_OA_Log(log_components_t component, hash_table_t * ht)
+{
+  hash_oa_table_t *tbl;
+  hash_data_t *pdata;
+  char dispkey[HASHTABLE_DISPLAY_STRLEN];
+  char dispval[HASHTABLE_DISPLAY_STRLEN];
+  unsigned int i;
+  unsigned int g;
+  unsigned int idx;
+
+  for(i = 0; i < ht->parameter.index_size; i++)
+    {
+      P_r(&(ht->array_lock[i]));
+
+      tbl = ht->array_oa[i].table;
+      LogFullDebug(COMPONENT_HASHTABLE,
+                   "The index %d contains: %d entries, %u groups, %u deleted slots",
+                   i, ht->stat_dynamic[i].nb_entries, tbl->mask + 1, tbl->nb_deleted);
+
+      for(g = 0; g <= tbl->mask; g++)
+        for(idx = 0; idx < HASH_OA_GROUP_SLOTS; idx++)
+          {
+            if(!(tbl->groups[g].tags.byte[idx] & HASH_OA_FULL))
+              continue;
+
+            pdata = tbl->groups[g].slots[idx];
+            ht->parameter.key_to_str(&(pdata->buffkey), dispkey);
+            ht->parameter.val_to_str(&(pdata->buffval), dispval);
+
+            LogFullDebug(component, "%s => %s; hashval=%u group=%u slot=%u",
+                         dispkey, dispval, i, g, idx);
+          }
+
+      V_r(&(ht->array_lock[i]));
+    }
+}                               /* HashTable_OA_Log */
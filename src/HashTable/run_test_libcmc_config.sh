@@ -1,3 +1,4 @@
 #!/bin/sh 
 
 ./test_libcmc_config < ../scripts/test_hash1.tst
+./test_libcmc_config -o < ../scripts/test_hash1.tst
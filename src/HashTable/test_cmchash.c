@@ -141,6 +141,7 @@ int main(int argc, char *argv[])
   hparam.index_size = PRIME;
   hparam.alphabet_length = 10;
   hparam.nb_node_prealloc = NB_PREALLOC;
+  hparam.backend = HASHTABLE_BACKEND_RBT;
   hparam.hash_func_key = simple_hash_func;
   hparam.hash_func_rbt = rbt_hash_func;
   hparam.hash_func_both = NULL ; /* BUGAZOMEU */
@@ -79,6 +79,9 @@
 #include <strings.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
 #include "HashTable.h"
 #include "MesureTemps.h"
 #include "log_macros.h"
@@ -94,6 +97,13 @@
 #define CRITERE 12
 #define CRITERE_2 14
 
+/* Defaults of the throughput benchmark (-b) */
+#define BENCH_THREADS 4
+#define BENCH_KEYS 100000
+#define BENCH_OPS 1000000
+#define BENCH_READ_PCT 90
+#define BENCH_INDEX_SIZE 17
+
 int compare_string_buffer(hash_buffer_t * buff1, hash_buffer_t * buff2)
 {
   /* Test if one of teh entries are NULL */
@@ -162,12 +172,17 @@ int do_set(hash_table_t * ht, int key, int val)
 
 int do_new(hash_table_t * ht, int key, int val)
 {
-  char tmpkey[STRSIZE];
-  char tmpval[STRSIZE];
+  char *tmpkey = NULL;
+  char *tmpval = NULL;
 
   hash_buffer_t buffkey;
   hash_buffer_t buffval;
 
+  /* The table keeps the buffers, they must outlive this call */
+  if(((tmpkey = (char *)Mem_Alloc(STRSIZE)) == NULL)
+     || ((tmpval = (char *)Mem_Alloc(STRSIZE)) == NULL))
+    return -1;
+
   sprintf(tmpkey, "%d", key);
   buffkey.pdata = tmpkey;
   buffkey.len = strlen(tmpkey);
@@ -207,6 +222,150 @@ int do_test(hash_table_t * ht, int key)
   return HashTable_Test_And_Set(ht, &buffkey, &buffval, HASHTABLE_SET_HOW_TEST_ONLY);
 }
 
+/*
+ * Throughput benchmark: threads doing gets, and deletes followed by sets of
+ * the same key, on random keys of a prefilled table. A set uses a copy of the
+ * key string, freed by the delete that removes it while other threads may
+ * still be looking for it.
+ */
+typedef struct bench_thread__
+{
+  pthread_t thrid;
+  hash_table_t *ht;
+  char *astrkey;
+  char *astrval;
+  unsigned int nb_keys;
+  unsigned int nb_ops;
+  unsigned int read_pct;
+  unsigned int seed;
+  unsigned int nb_errors;
+} bench_thread_t;
+
+void *bench_thread(void *arg)
+{
+  bench_thread_t *bt = (bench_thread_t *) arg;
+  hash_buffer_t buffkey;
+  hash_buffer_t buffval;
+  hash_buffer_t usedbuffkey;
+  char *keycopy;
+  unsigned int i;
+  unsigned int k;
+  int rc;
+
+  BuddyInit(NULL);
+
+  for(i = 0; i < bt->nb_ops; i++)
+    {
+      k = rand_r(&bt->seed) % bt->nb_keys;
+      buffkey.pdata = bt->astrkey + STRSIZE * k;
+      buffkey.len = strlen(buffkey.pdata);
+
+      if(rand_r(&bt->seed) % 100 < bt->read_pct)
+        {
+          /* A concurrent delete may have removed the key: not an error */
+          rc = HashTable_Get(bt->ht, &buffkey, &buffval);
+          if(rc == HASHTABLE_SUCCESS && strcmp(buffval.pdata, bt->astrval + STRSIZE * k))
+            bt->nb_errors += 1;
+        }
+      else
+        {
+          /* The keys of the prefilled table are not copies */
+          if(HashTable_Del(bt->ht, &buffkey, &usedbuffkey, NULL) == HASHTABLE_SUCCESS &&
+             (usedbuffkey.pdata < bt->astrkey ||
+              usedbuffkey.pdata >= bt->astrkey + STRSIZE * bt->nb_keys))
+            Mem_Free(usedbuffkey.pdata);
+
+          if((keycopy = (char *)Mem_Alloc(STRSIZE)) == NULL)
+            {
+              bt->nb_errors += 1;
+              continue;
+            }
+          strcpy(keycopy, buffkey.pdata);
+          buffkey.pdata = keycopy;
+
+          buffval.pdata = bt->astrval + STRSIZE * k;
+          buffval.len = strlen(buffval.pdata);
+          if(HashTable_Set(bt->ht, &buffkey, &buffval) != HASHTABLE_SUCCESS)
+            bt->nb_errors += 1;
+        }
+    }
+
+  return NULL;
+}                               /* bench_thread */
+
+int do_bench(hash_parameter_t hparam, char *astrkey, char *astrval,
+             unsigned int nb_threads, unsigned int nb_keys, unsigned int nb_ops,
+             unsigned int read_pct)
+{
+  hash_table_t *ht;
+  hash_buffer_t buffkey;
+  hash_buffer_t buffval;
+  bench_thread_t *threads;
+  struct timeval debut;
+  struct timeval fin;
+  double elapsed;
+  unsigned int nb_errors = 0;
+  unsigned int i;
+
+  if((ht = HashTable_Init(hparam)) == NULL)
+    {
+      LogTest("Test FAILED: Bad init");
+      return -1;
+    }
+
+  for(i = 0; i < nb_keys; i++)
+    {
+      buffkey.pdata = astrkey + STRSIZE * i;
+      buffkey.len = strlen(buffkey.pdata);
+      buffval.pdata = astrval + STRSIZE * i;
+      buffval.len = strlen(buffval.pdata);
+
+      if(HashTable_Set(ht, &buffkey, &buffval) != HASHTABLE_SUCCESS)
+        {
+          LogTest("Test FAILED: Inserting a new entry impossible : %d", i);
+          return -1;
+        }
+    }
+
+  if((threads = (bench_thread_t *) Mem_Alloc(nb_threads * sizeof(bench_thread_t))) == NULL)
+    return -1;
+
+  gettimeofday(&debut, NULL);
+  for(i = 0; i < nb_threads; i++)
+    {
+      threads[i].ht = ht;
+      threads[i].astrkey = astrkey;
+      threads[i].astrval = astrval;
+      threads[i].nb_keys = nb_keys;
+      threads[i].nb_ops = nb_ops / nb_threads;
+      threads[i].read_pct = read_pct;
+      threads[i].seed = i + 1;
+      threads[i].nb_errors = 0;
+      if(pthread_create(&threads[i].thrid, NULL, bench_thread, &threads[i]) != 0)
+        {
+          LogTest("Test FAILED: pthread_create");
+          return -1;
+        }
+    }
+
+  for(i = 0; i < nb_threads; i++)
+    {
+      pthread_join(threads[i].thrid, NULL);
+      nb_errors += threads[i].nb_errors;
+    }
+  gettimeofday(&fin, NULL);
+
+  elapsed = (fin.tv_sec - debut.tv_sec) + (fin.tv_usec - debut.tv_usec) / 1000000.0;
+
+  LogTest("%-16s %3u threads %7u keys %3u%% reads: %8.0f ops/s, %u entries left, %u errors",
+          hparam.backend == HASHTABLE_BACKEND_OPEN ? "open addressing" : "rbt",
+          nb_threads, nb_keys, read_pct,
+          elapsed > 0 ? (nb_ops / nb_threads) * nb_threads / elapsed : 0.0,
+          HashTable_GetSize(ht), nb_errors);
+
+  return nb_errors == 0 ? 0 : -1;
+}                               /* do_bench */
+
 int main(int argc, char *argv[])
 {
   SetDefaultLogging("TEST");
@@ -229,7 +388,55 @@ int main(int argc, char *argv[])
   int val;
   int readval;
   int expected_rc;
+  int nb_script_errors = 0;
   char c;
+  int opt;
+  int bench = 0;
+  unsigned int nb_threads = BENCH_THREADS;
+  unsigned int nb_keys = BENCH_KEYS;
+  unsigned int nb_ops = BENCH_OPS;
+  unsigned int read_pct = BENCH_READ_PCT;
+  hash_backend_t backend = HASHTABLE_BACKEND_RBT;
+
+  /*
+   * -o: run the test with the open addressing backend.
+   * -b: compare the throughput of both backends instead,
+   *     with -t threads, -k keys, -n operations and -r % of reads.
+   */
+  while((opt = getopt(argc, argv, "obt:k:n:r:")) != EOF)
+    {
+      switch (opt)
+        {
+        case 'o':
+          backend = HASHTABLE_BACKEND_OPEN;
+          break;
+        case 'b':
+          bench = 1;
+          break;
+        case 't':
+          nb_threads = atoi(optarg);
+          break;
+        case 'k':
+          nb_keys = atoi(optarg);
+          break;
+        case 'n':
+          nb_ops = atoi(optarg);
+          break;
+        case 'r':
+          read_pct = atoi(optarg);
+          break;
+        default:
+          fprintf(stderr, "Usage: %s [-o] [-b [-t threads] [-k keys] [-n ops] [-r read_pct]]\n",
+                  argv[0]);
+          exit(1);
+        }
+    }
+
+  if(nb_threads == 0 || nb_keys == 0 || read_pct > 100)
+    {
+      fprintf(stderr, "Bad benchmark parameters\n");
+      exit(1);
+    }
 
   BuddyInit(NULL);
 
@@ -252,6 +459,36 @@ int main(int argc, char *argv[])
   hparam.compare_key = compare_string_buffer;
   hparam.key_to_str = display_buff;
   hparam.val_to_str = display_buff;
+  hparam.name = "test_libcmc_config";
+  hparam.backend = backend;
+
+  if(bench)
+    {
+      /* Keys and values for the benchmark, never freed */
+      if((astrkey = (char *)Mem_Alloc(nb_keys * STRSIZE)) == NULL
+         || (astrval = (char *)Mem_Alloc(nb_keys * STRSIZE)) == NULL)
+        {
+          LogTest("Test FAILED: problem with Mem_Alloc, BuddyErrno = %d", BuddyErrno);
+          exit(1);
+        }
+
+      for(i = 0; i < nb_keys; i++)
+        {
+          sprintf((astrkey + STRSIZE * i), "%d", i);
+          sprintf((astrval + STRSIZE * i), "%d", i * 10);
+        }
+
+      hparam.index_size = BENCH_INDEX_SIZE;
+
+      hparam.backend = HASHTABLE_BACKEND_RBT;
+      rc = do_bench(hparam, astrkey, astrval, nb_threads, nb_keys, nb_ops, read_pct);
+
+      hparam.backend = HASHTABLE_BACKEND_OPEN;
+      if(do_bench(hparam, astrkey, astrval, nb_threads, nb_keys, nb_ops, read_pct) != 0)
+        rc = -1;
+
+      exit(rc == 0 ? 0 : 1);
+    }
 
   /* Init de la table */
   if((ht = HashTable_Init(hparam)) == NULL)
@@ -359,8 +596,11 @@ int main(int argc, char *argv[])
           hrc = do_set(ht, key, val);
 
           if(hrc != expected_rc)
-            LogTest(">>>> ERROR: set  %d %d: %d != %d (expected)",
-                    key, val, hrc, expected_rc);
+            {
+              LogTest(">>>> ERROR: set  %d %d: %d != %d (expected)",
+                      key, val, hrc, expected_rc);
+              nb_script_errors += 1;
+            }
           else
             LogTest(">>>> OK set  %d %d", key, val);
           break;
@@ -372,8 +612,11 @@ int main(int argc, char *argv[])
           hrc = do_test(ht, key);
 
           if(hrc != expected_rc)
-            LogTest(">>>> ERROR: test %d : %d != %d (expected)",
-                    key, hrc, expected_rc);
+            {
+              LogTest(">>>> ERROR: test %d : %d != %d (expected)",
+                      key, hrc, expected_rc);
+              nb_script_errors += 1;
+            }
           else
             LogTest(">>>> OK test %d ", key);
           break;
@@ -385,8 +628,11 @@ int main(int argc, char *argv[])
           hrc = do_new(ht, key, val);
 
           if(hrc != expected_rc)
-            LogTest(">>>> ERROR: new  %d %d: %d != %d (expected)",
-                    key, val, hrc, expected_rc);
+            {
+              LogTest(">>>> ERROR: new  %d %d: %d != %d (expected)",
+                      key, val, hrc, expected_rc);
+              nb_script_errors += 1;
+            }
           else
             LogTest(">>>> OK new  %d %d", key, val);
           break;
@@ -398,15 +644,21 @@ int main(int argc, char *argv[])
           hrc = do_get(ht, key, &readval);
 
           if(hrc != expected_rc)
-            LogTest(">>>> ERROR: get  %d %d: %d != %d (expected)",
-                    key, val, hrc, expected_rc);
+            {
+              LogTest(">>>> ERROR: get  %d %d: %d != %d (expected)",
+                      key, val, hrc, expected_rc);
+              nb_script_errors += 1;
+            }
           else
             {
               if(hrc == HASHTABLE_SUCCESS)
                 {
                   if(val != readval)
-                    LogTest(">>>> ERROR: get %d Bad read value : %d != %d (expected)",
-                            key, readval, val);
+                    {
+                      LogTest(">>>> ERROR: get %d Bad read value : %d != %d (expected)",
+                              key, readval, val);
+                      nb_script_errors += 1;
+                    }
                   else
                     LogTest(">>>> OK get  %d %d", key, val);
                 }
@@ -420,8 +672,11 @@ int main(int argc, char *argv[])
           hrc = do_del(ht, key);
 
           if(hrc != expected_rc)
-            LogTest(">>>> ERROR: del  %d  %d != %d (expected)",
-                    key, hrc, expected_rc);
+            {
+              LogTest(">>>> ERROR: del  %d  %d != %d (expected)",
+                      key, hrc, expected_rc);
+              nb_script_errors += 1;
+            }
           else
             LogTest(">>>> OK del  %d %d", key, val);
 
@@ -444,6 +699,12 @@ int main(int argc, char *argv[])
   BuddyDumpMem(stderr);
 
   LogTest("====================================================");
+  if(nb_script_errors != 0)
+    {
+      LogTest("Test FAILED: %d commands did not give the expected result",
+              nb_script_errors);
+      exit(1);
+    }
   LogTest("Test succeeded: all tests pass successfully");
 
   exit(0);
@@ -0,0 +1,7 @@
+#!/bin/sh
+##
+## test_libcmc_config_OA.sh
+## run the configurable hash table test (open addressing)
+##
+
+./test_libcmc_config -o < ${srcdir:-.}/../scripts/test_hash1.tst
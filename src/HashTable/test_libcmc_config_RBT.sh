@@ -0,0 +1,7 @@
+#!/bin/sh
+##
+## test_libcmc_config_RBT.sh
+## run the configurable hash table test (red-black trees)
+##
+
+./test_libcmc_config < ${srcdir:-.}/../scripts/test_hash1.tst
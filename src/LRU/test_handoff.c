@@ -0,0 +1,529 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ *
+ * Request handoff benchmark: dispatcher threads handing requests over to
+ * worker threads, either through a LRU list protected by two mutexes and a
+ * condition variable (the way DispatchWork used to do it), through a
+ * mpmc_queue_t per worker, or through the same queues with idle workers
+ * stealing from the others (the way it does it now).
+ *
+ * usage: test_handoff [-p nb_producers] [-n nb_requests] [-w max_workers]
+ *                     [-s spin] [-d slow_delay]
+ *
+ * Runs the three handoffs with 1, 2, 4 ... max_workers workers (default 64)
+ * and prints the number of requests handed over and processed per second.
+ * With -d, one request out of SLOW_EVERY sleeps slow_delay microseconds, like
+ * a slow FSAL call stranding the requests queued behind it.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include "BuddyMalloc.h"
+#include "LRU_List.h"
+#include "mpmc_queue.h"
+#include "log_macros.h"
+
+#define P( a ) pthread_mutex_lock( &a )
+#define V( a ) pthread_mutex_unlock( &a )
+
+#define NB_BEFORE_GC 50         /* same as NB_REQUEST_BEFORE_GC */
+#define QUEUE_SIZE   1024       /* same as NB_PENDING_QUEUE_SIZE */
+#define SLOW_EVERY   1000
+
+typedef enum handoff__
+{
+  HANDOFF_LRU,
+  HANDOFF_QUEUE,
+  HANDOFF_STEAL
+} handoff_t;
+
+typedef struct bench_request__
+{
+  unsigned long value;
+  int slow;
+} bench_request_t;
+
+typedef struct bench_worker__
+{
+  pthread_t thrid;
+  LRU_list_t *lru;
+  pthread_mutex_t request_mutex;
+  pthread_mutex_t pool_mutex;
+  pthread_cond_t req_condvar;
+  mpmc_queue_t queue;
+  volatile int is_idle;
+  unsigned long long nb_done;
+  unsigned long long nb_steal;
+  char pad[MPMC_CACHE_LINE];
+} bench_worker_t;
+
+typedef struct bench_producer__
+{
+  pthread_t thrid;
+  unsigned int index;
+  bench_request_t *requests;
+  unsigned int nb_requests;
+} bench_producer_t;
+
+static handoff_t handoff;
+static bench_worker_t *workers;
+static unsigned int nb_workers;
+static unsigned int spin = 0;
+static unsigned int slow_delay = 0;
+static volatile unsigned int nb_idle_workers;
+static unsigned long long total_steal;
+static volatile int stop = FALSE;
+
+int print_entry(LRU_data_t data, char *str)
+{
+  return snprintf(str, LRU_DISPLAY_STRLEN, "%p", data.pdata);
+}                               /* print_entry */
+
+int clean_entry(LRU_entry_t * pentry, void *addparam)
+{
+  return 0;
+}                               /* clean_entry */
+
+static void process(bench_worker_t * pworker, bench_request_t * preq)
+{
+  unsigned int i;
+
+  for(i = 0; i < spin; i++)
+    preq->value = preq->value * 31 + i;
+
+  if(preq->slow && slow_delay)
+    usleep(slow_delay);
+
+  pworker->nb_done += 1;
+}
+
+static void *lru_worker(void *arg)
+{
+  bench_worker_t *pworker = (bench_worker_t *) arg;
+  LRU_entry_t *pentry;
+  unsigned int passcounter = 0;
+
+#ifndef _NO_BUDDY_SYSTEM
+  BuddyInit(NULL);
+#endif
+
+  for(;;)
+    {
+      P(pworker->request_mutex);
+      while(pworker->lru->nb_entry == pworker->lru->nb_invalid && !stop)
+        pthread_cond_wait(&pworker->req_condvar, &pworker->request_mutex);
+
+      if(pworker->lru->nb_entry == pworker->lru->nb_invalid)
+        {
+          V(pworker->request_mutex);
+          break;
+        }
+      V(pworker->request_mutex);
+
+      P(pworker->pool_mutex);
+      for(pentry = pworker->lru->LRU; pentry != NULL; pentry = pentry->next)
+        if(pentry->valid_state == LRU_ENTRY_VALID)
+          break;
+      V(pworker->pool_mutex);
+
+      if(pentry == NULL)
+        continue;
+
+      process(pworker, (bench_request_t *) pentry->buffdata.pdata);
+
+      P(pworker->pool_mutex);
+      LRU_invalidate(pworker->lru, pentry);
+      V(pworker->pool_mutex);
+
+      if(++passcounter > NB_BEFORE_GC)
+        {
+          P(pworker->pool_mutex);
+          LRU_gc_invalid(pworker->lru, NULL);
+          V(pworker->pool_mutex);
+          passcounter = 0;
+        }
+    }
+
+  return NULL;
+}
+
+static void lru_dispatch(bench_worker_t * pworker, bench_request_t * preq)
+{
+  LRU_entry_t *pentry;
+  LRU_status_t status;
+
+  P(pworker->request_mutex);
+  P(pworker->pool_mutex);
+
+  if((pentry = LRU_new_entry(pworker->lru, &status)) == NULL)
+    {
+      LogTest("Test FAILED: LRU_new_entry returned status %d", status);
+      exit(1);
+    }
+  pentry->buffdata.pdata = (caddr_t) preq;
+  pentry->buffdata.len = sizeof(*preq);
+
+  pthread_cond_signal(&pworker->req_condvar);
+
+  V(pworker->pool_mutex);
+  V(pworker->request_mutex);
+}
+
+static void *queue_worker(void *arg)
+{
+  bench_worker_t *pworker = (bench_worker_t *) arg;
+  bench_request_t *preq;
+
+  for(;;)
+    {
+      if((preq = (bench_request_t *) mpmc_queue_pop(&pworker->queue)) != NULL)
+        {
+          process(pworker, preq);
+          continue;
+        }
+
+      if(stop && mpmc_queue_length(&pworker->queue) == 0)
+        break;
+
+      mpmc_queue_wait(&pworker->queue, MPMC_WAIT_DATA);
+    }
+
+  return NULL;
+}
+
+static void queue_dispatch(bench_worker_t * pworker, bench_request_t * preq)
+{
+  mpmc_queue_push_wait(&pworker->queue, preq);
+}
+
+/* Same as mark_thread_idle and steal_request in nfs_worker_thread.c */
+static void mark_idle(bench_worker_t * pworker, int idle)
+{
+  if(pworker->is_idle == idle)
+    return;
+
+  pworker->is_idle = idle;
+  if(idle)
+    __sync_fetch_and_add(&nb_idle_workers, 1);
+  else
+    __sync_fetch_and_sub(&nb_idle_workers, 1);
+}
+
+static bench_request_t *steal(bench_worker_t * pworker)
+{
+  bench_request_t *preq;
+  unsigned int victim = 0;
+  unsigned int max_pending = 0;
+  unsigned int len;
+  unsigned int i;
+
+  for(i = 0; i < nb_workers; i++)
+    {
+      if(&workers[i] == pworker)
+        continue;
+
+      len = mpmc_queue_length(&workers[i].queue);
+      if(len > max_pending)
+        {
+          max_pending = len;
+          victim = i;
+        }
+    }
+
+  if(max_pending == 0)
+    return NULL;
+
+  if((preq = (bench_request_t *) mpmc_queue_pop(&workers[victim].queue)) != NULL)
+    pworker->nb_steal += 1;
+
+  return preq;
+}
+
+static void *steal_worker(void *arg)
+{
+  bench_worker_t *pworker = (bench_worker_t *) arg;
+  bench_request_t *preq;
+
+  for(;;)
+    {
+      if((preq = (bench_request_t *) mpmc_queue_pop(&pworker->queue)) == NULL)
+        {
+          mark_idle(pworker, TRUE);
+          preq = steal(pworker);
+        }
+
+      if(preq != NULL)
+        {
+          mark_idle(pworker, FALSE);
+          process(pworker, preq);
+          continue;
+        }
+
+      if(stop && mpmc_queue_length(&pworker->queue) == 0)
+        break;
+
+      mpmc_queue_wait(&pworker->queue, MPMC_WAIT_DATA);
+    }
+
+  mark_idle(pworker, FALSE);
+  return NULL;
+}
+
+/* Same as DispatchWork */
+static void steal_dispatch(bench_worker_t * pworker, bench_request_t * preq)
+{
+  unsigned int i;
+
+  queue_dispatch(pworker, preq);
+
+  if(nb_idle_workers > 0 && !pworker->is_idle)
+    for(i = 0; i < nb_workers; i++)
+      if(workers[i].is_idle)
+        {
+          mpmc_queue_wakeup(&workers[i].queue);
+          break;
+        }
+}
+
+static void *producer(void *arg)
+{
+  bench_producer_t *pprod = (bench_producer_t *) arg;
+  unsigned int i;
+  unsigned int w = pprod->index;
+
+#ifndef _NO_BUDDY_SYSTEM
+  BuddyInit(NULL);
+#endif
+
+  /* Requests are spread over the workers in turn */
+  for(i = 0; i < pprod->nb_requests; i++)
+    {
+      w = (w + 1) % nb_workers;
+      pprod->requests[i].slow = (i % SLOW_EVERY == 0);
+      if(handoff == HANDOFF_LRU)
+        lru_dispatch(&workers[w], &pprod->requests[i]);
+      else if(handoff == HANDOFF_QUEUE)
+        queue_dispatch(&workers[w], &pprod->requests[i]);
+      else
+        steal_dispatch(&workers[w], &pprod->requests[i]);
+    }
+
+  return NULL;
+}
+
+static double run(handoff_t how, unsigned int nb_prod, unsigned int nb_requests)
+{
+  bench_producer_t *producers;
+  LRU_parameter_t param;
+  LRU_status_t status;
+  struct timeval start, end;
+  unsigned long long total = 0;
+  double elapsed;
+  unsigned int i;
+
+  handoff = how;
+  stop = FALSE;
+  nb_idle_workers = 0;
+  total_steal = 0;
+
+  param.nb_entry_prealloc = 100;        /* same as NB_PREALLOC_LRU_WORKER */
+  param.nb_call_gc_invalid = 0;
+  param.entry_to_str = print_entry;
+  param.clean_entry = clean_entry;
+  param.name = "Pending Request";
+
+  workers = (bench_worker_t *) calloc(nb_workers, sizeof(bench_worker_t));
+  producers = (bench_producer_t *) calloc(nb_prod, sizeof(bench_producer_t));
+  if(workers == NULL || producers == NULL)
+    {
+      LogTest("Test FAILED: allocation failed");
+      exit(1);
+    }
+
+  for(i = 0; i < nb_workers; i++)
+    {
+      pthread_mutex_init(&workers[i].request_mutex, NULL);
+      pthread_mutex_init(&workers[i].pool_mutex, NULL);
+      pthread_cond_init(&workers[i].req_condvar, NULL);
+
+      if(how == HANDOFF_LRU)
+        {
+          if((workers[i].lru = LRU_Init(param, &status)) == NULL)
+            {
+              LogTest("Test FAILED: LRU_Init returned status %d", status);
+              exit(1);
+            }
+          pthread_create(&workers[i].thrid, NULL, lru_worker, &workers[i]);
+        }
+      else
+        {
+          if(mpmc_queue_init(&workers[i].queue, QUEUE_SIZE) != 0)
+            {
+              LogTest("Test FAILED: mpmc_queue_init failed");
+              exit(1);
+            }
+        }
+    }
+
+  /* Start the workers once all the queues exist, thieves look at all of them */
+  for(i = 0; i < nb_workers && how != HANDOFF_LRU; i++)
+    pthread_create(&workers[i].thrid, NULL,
+                   (how == HANDOFF_QUEUE) ? queue_worker : steal_worker, &workers[i]);
+
+  for(i = 0; i < nb_prod; i++)
+    {
+      producers[i].index = i;
+      producers[i].nb_requests = nb_requests / nb_prod;
+      producers[i].requests =
+          (bench_request_t *) calloc(producers[i].nb_requests, sizeof(bench_request_t));
+      if(producers[i].requests == NULL)
+        {
+          LogTest("Test FAILED: allocation failed");
+          exit(1);
+        }
+    }
+
+  gettimeofday(&start, NULL);
+
+  for(i = 0; i < nb_prod; i++)
+    pthread_create(&producers[i].thrid, NULL, producer, &producers[i]);
+
+  for(i = 0; i < nb_prod; i++)
+    pthread_join(producers[i].thrid, NULL);
+
+  /* Everything is queued, let the workers drain their queue and exit */
+  stop = TRUE;
+  for(i = 0; i < nb_workers; i++)
+    {
+      if(how == HANDOFF_LRU)
+        {
+          P(workers[i].request_mutex);
+          pthread_cond_signal(&workers[i].req_condvar);
+          V(workers[i].request_mutex);
+        }
+      else
+        mpmc_queue_wakeup(&workers[i].queue);
+    }
+
+  for(i = 0; i < nb_workers; i++)
+    {
+      pthread_join(workers[i].thrid, NULL);
+      total += workers[i].nb_done;
+      total_steal += workers[i].nb_steal;
+    }
+
+  gettimeofday(&end, NULL);
+  elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+
+  if(total != (unsigned long long)(nb_requests / nb_prod) * nb_prod)
+    {
+      LogTest("Test FAILED: %llu requests processed, %u expected", total,
+              (nb_requests / nb_prod) * nb_prod);
+      exit(1);
+    }
+
+  for(i = 0; i < nb_workers; i++)
+    {
+      if(how != HANDOFF_LRU)
+        mpmc_queue_destroy(&workers[i].queue);
+      pthread_mutex_destroy(&workers[i].request_mutex);
+      pthread_mutex_destroy(&workers[i].pool_mutex);
+      pthread_cond_destroy(&workers[i].req_condvar);
+    }
+  for(i = 0; i < nb_prod; i++)
+    free(producers[i].requests);
+  free(producers);
+  free(workers);
+
+  /* The LRU lists are not freed, there is no LRU_Destroy */
+  return total / elapsed;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned int nb_prod = 4;
+  unsigned int nb_requests = 2000000;
+  unsigned int max_workers = 64;
+  double lru_rate, queue_rate, steal_rate;
+  int opt;
+
+  SetDefaultLogging("TEST");
+  SetNamePgm("test_handoff");
+
+  while((opt = getopt(argc, argv, "p:n:w:s:d:")) != EOF)
+    {
+      switch (opt)
+        {
+        case 'p':
+          nb_prod = atoi(optarg);
+          break;
+        case 'n':
+          nb_requests = atoi(optarg);
+          break;
+        case 'w':
+          max_workers = atoi(optarg);
+          break;
+        case 's':
+          spin = atoi(optarg);
+          break;
+        case 'd':
+          slow_delay = atoi(optarg);
+          break;
+        default:
+          fprintf(stderr,
+                  "usage: %s [-p nb_producers] [-n nb_requests] [-w max_workers] [-s spin] [-d slow_delay]\n",
+                  argv[0]);
+          exit(1);
+        }
+    }
+
+  if(nb_prod == 0 || nb_requests < nb_prod || max_workers == 0)
+    {
+      fprintf(stderr, "Bad parameters\n");
+      exit(1);
+    }
+
+#ifndef _NO_BUDDY_SYSTEM
+  BuddyInit(NULL);
+#endif
+
+  printf("%u producers, %u requests, spin=%u, slow_delay=%u us\n", nb_prod,
+         nb_requests, spin, slow_delay);
+  printf("%8s %16s %16s %16s %12s\n", "workers", "lru (ops/s)", "queue (ops/s)",
+         "steal (ops/s)", "steals");
+
+  for(nb_workers = 1; nb_workers <= max_workers; nb_workers *= 2)
+    {
+      lru_rate = run(HANDOFF_LRU, nb_prod, nb_requests);
+      queue_rate = run(HANDOFF_QUEUE, nb_prod, nb_requests);
+      steal_rate = run(HANDOFF_STEAL, nb_prod, nb_requests);
+
+      printf("%8u %16.0f %16.0f %16.0f %12llu\n", nb_workers, lru_rate, queue_rate,
+             steal_rate, total_steal);
+    }
+
+  exit(0);
+}                               /* main */
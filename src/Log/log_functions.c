@@ -40,10 +40,13 @@
 #include <sys/types.h>
 #include <sys/param.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <errno.h>
 #include <string.h>
 #include <signal.h>
 #include <libgen.h>
+#include <limits.h>
+#include <sys/uio.h>
 
 #include "log_macros.h"
 //#include "nfs_core.h"
@@ -183,13 +186,72 @@ static int syslog_opened = 0 ;
  * Variables specifiques aux threads.
  */
 
+/*
+ * Asynchronous file logging: each thread formats its messages into a ring
+ * of its own, and a single writer thread drains all the rings to the log
+ * files with writev. Only the owning thread moves the head of a ring and
+ * only the writer moves its tail, so pushing a message takes no lock.
+ *
+ * A record is a log_record_t header followed by the message, padded to
+ * LOG_RECORD_ALIGN. A record that does not fit before the end of the
+ * buffer is preceded by a LOG_RECORD_SKIP record filling the end.
+ */
+
+#define LOG_RING_MIN_SIZE     4096
+#define LOG_RECORD_ALIGN      8
+#define LOG_RECORD_SKIP       ((unsigned int) -1)
+#define LOG_WRITER_PERIOD_MS  100
+#define LOG_BLOCK_DELAY_US    1000
+#define LOG_CACHE_LINE        64
+
+#ifndef IOV_MAX
+#define IOV_MAX               1024
+#endif
+
+#define LOG_RECORD_SIZE(len) \
+  ((sizeof(log_record_t) + (len) + LOG_RECORD_ALIGN - 1) & ~(LOG_RECORD_ALIGN - 1))
+
+typedef struct log_record_t
+{
+  unsigned int len;             /* length of the message, or of the skipped area */
+  unsigned int component;       /* LOG_RECORD_SKIP for a skip record */
+} log_record_t;
+
+typedef struct log_ring_t
+{
+  struct log_ring_t *next;
+  char *buffer;
+  unsigned int size;            /* a power of 2 */
+  volatile unsigned int orphan; /* the owning thread has exited */
+  unsigned int nb_reported;     /* drops already reported by the writer */
+  char pad1[LOG_CACHE_LINE];
+  volatile unsigned int head;   /* written by the owning thread only */
+  volatile unsigned int nb_dropped;
+  char pad2[LOG_CACHE_LINE];
+  volatile unsigned int tail;   /* written by the writer only */
+} log_ring_t;
+
 typedef struct ThreadLogContext_t
 {
 
   char nom_fonction[STR_LEN];
 
+  log_ring_t *ring;             /* asynchronous log ring, allocated on first use */
+  int no_ring;                  /* log synchronously from this thread */
+
 } ThreadLogContext_t;
 
+static int log_async = 0;
+static unsigned int log_ring_size = 0;
+static log_overflow_policy_t log_overflow = LOG_OVERFLOW_BLOCK;
+static log_ring_t *log_rings = NULL;
+static pthread_mutex_t log_rings_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t log_drain_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t log_writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_writer_cond = PTHREAD_COND_INITIALIZER;
+static volatile int log_writer_sleeping = 0;
+static pthread_t log_writer_thrid;
+
 /* threads keys */
 static pthread_key_t thread_key;
 static pthread_once_t once_key = PTHREAD_ONCE_INIT;
@@ -222,6 +284,7 @@ void Cleanup(void)
 
 void Fatal(void)
 {
+  LogFlush();
   Cleanup();
   exit(1);
 }
@@ -261,10 +324,22 @@ static struct tm *Localtime_r(const time_t * p_time, struct tm *p_tm)
 # define Localtime_r localtime_r
 #endif
 
+/* Destructor of the thread specific context */
+static void free_thread_context(void *arg)
+{
+  ThreadLogContext_t *context = (ThreadLogContext_t *) arg;
+
+  /* The writer frees the ring once it has drained it */
+  if(context->ring != NULL)
+    context->ring->orphan = 1;
+
+  free(context);
+}                               /* free_thread_context */
+
 /* Init of pthread_keys */
 static void init_keys(void)
 {
-  if(pthread_key_create(&thread_key, NULL) == -1)
+  if(pthread_key_create(&thread_key, free_thread_context) == -1)
     LogCrit(COMPONENT_LOG,
             "init_keys - pthread_key_create returned %d (%s)",
             errno, strerror(errno));
@@ -310,6 +385,8 @@ static ThreadLogContext_t *Log_GetThreadContext(int ok_errors)
 
       /* inits thread structures */
       p_current_thread_vars->nom_fonction[0] = '\0';
+      p_current_thread_vars->ring = NULL;
+      p_current_thread_vars->no_ring = 0;
 
       /* set the specific value */
       pthread_setspecific(thread_key, (void *)p_current_thread_vars);
@@ -622,6 +699,437 @@ static int DisplayBuffer_valist(char *buffer, log_components_t component, char *
   return log_vsnprintf(buffer, STR_LEN_TXT, format, arguments);
 }
 
+/*
+ * Asynchronous file logging
+ */
+
+typedef struct log_batch_t
+{
+  char *path;                   /* log file the batched messages go to */
+  int fd;
+  int iovcnt;
+  struct iovec iov[IOV_MAX];
+} log_batch_t;
+
+/* Only used with log_drain_mutex held */
+static log_batch_t log_batch;
+
+static void log_wakeup_writer(void)
+{
+  pthread_mutex_lock(&log_writer_mutex);
+  pthread_cond_signal(&log_writer_cond);
+  pthread_mutex_unlock(&log_writer_mutex);
+}                               /* log_wakeup_writer */
+
+/**
+ *
+ * log_ring_new: allocates the log ring of the calling thread.
+ *
+ * Allocates the log ring of the calling thread and registers it to the
+ * writer. On failure, the thread falls back to synchronous logging.
+ *
+ * @param context [INOUT] log context of the calling thread.
+ *
+ * @return the new ring, NULL if allocation failed.
+ *
+ */
+static log_ring_t *log_ring_new(ThreadLogContext_t * context)
+{
+  log_ring_t *ring;
+
+  if((ring = (log_ring_t *) malloc(sizeof(log_ring_t))) == NULL)
+    {
+      context->no_ring = 1;
+      return NULL;
+    }
+
+  if((ring->buffer = (char *)malloc(log_ring_size)) == NULL)
+    {
+      free(ring);
+      context->no_ring = 1;
+      return NULL;
+    }
+
+  ring->size = log_ring_size;
+  ring->orphan = 0;
+  ring->nb_reported = 0;
+  ring->head = 0;
+  ring->nb_dropped = 0;
+  ring->tail = 0;
+
+  pthread_mutex_lock(&log_rings_mutex);
+  ring->next = log_rings;
+  log_rings = ring;
+  pthread_mutex_unlock(&log_rings_mutex);
+
+  context->ring = ring;
+
+  return ring;
+}                               /* log_ring_new */
+
+/**
+ *
+ * log_ring_push: queues a formatted message in the ring of the calling thread.
+ *
+ * Queues a formatted message in the ring of the calling thread. When the ring
+ * is full, the message is either dropped and counted, or the thread waits for
+ * the writer to make room, depending on the overflow policy.
+ *
+ * @param context [INOUT] log context of the calling thread.
+ * @param component [IN] component of the message, gives the log file.
+ * @param text [IN] the formatted message.
+ * @param len [IN] length of the message.
+ *
+ * @return 0 if the message was queued or dropped, -1 if it must be written synchronously.
+ *
+ */
+static int log_ring_push(ThreadLogContext_t * context, log_components_t component,
+                         char *text, unsigned int len)
+{
+  log_ring_t *ring = context->ring;
+  log_record_t *record;
+  unsigned int head, offset, room, size, need;
+
+  if(ring == NULL && (ring = log_ring_new(context)) == NULL)
+    return -1;
+
+  /* Messages that would hog the ring are not worth queueing */
+  size = LOG_RECORD_SIZE(len);
+  if(size > ring->size / 2)
+    return -1;
+
+  head = ring->head;
+  offset = head & (ring->size - 1);
+  room = ring->size - offset;
+  need = (room < size) ? room + size : size;
+
+  while(head - ring->tail + need > ring->size)
+    {
+      if(log_overflow == LOG_OVERFLOW_DROP)
+        {
+          ring->nb_dropped += 1;
+          return 0;
+        }
+
+      log_wakeup_writer();
+      usleep(LOG_BLOCK_DELAY_US);
+    }
+
+  /* Don't overwrite records before the writer is done with them */
+  __sync_synchronize();
+
+  if(room < size)
+    {
+      record = (log_record_t *) (ring->buffer + offset);
+      record->len = room;
+      record->component = LOG_RECORD_SKIP;
+      head += room;
+      offset = 0;
+    }
+
+  record = (log_record_t *) (ring->buffer + offset);
+  record->len = len;
+  record->component = component;
+  memcpy(record + 1, text, len);
+
+  /* Publish the record before the new head */
+  __sync_synchronize();
+  ring->head = head + size;
+
+  /* The writer polls the rings, it is only hurried when one fills up */
+  if(log_writer_sleeping && ring->head - ring->tail > ring->size / 4)
+    log_wakeup_writer();
+
+  return 0;
+}                               /* log_ring_push */
+
+/* Writes the batched messages to their log file */
+static void log_batch_flush(log_batch_t * batch)
+{
+  struct iovec *iov = batch->iov;
+  int iovcnt = batch->iovcnt;
+  ssize_t rc;
+
+  if(iovcnt == 0)
+    return;
+
+  batch->iovcnt = 0;
+
+  if(batch->fd == -1 &&
+     (batch->fd = open(batch->path, O_WRONLY | O_APPEND | O_CREAT, masque_log)) == -1)
+    {
+      fprintf(stderr, "Error %s : %s : status %d on file %s, %d messages lost\n",
+              tab_systeme_err[ERR_FICHIER_LOG].label,
+              tab_systeme_err[ERR_FICHIER_LOG].msg, errno, batch->path, iovcnt);
+      return;
+    }
+
+  /* Resume after short writes */
+  while(iovcnt > 0)
+    {
+      if((rc = writev(batch->fd, iov, iovcnt)) < 0)
+        {
+          if(errno == EINTR)
+            continue;
+
+          fprintf(stderr,
+                  "Error: couldn't complete write to the log file, ensure disk has not filled up\n");
+          return;
+        }
+
+      while(iovcnt > 0 && (size_t) rc >= iov->iov_len)
+        {
+          rc -= iov->iov_len;
+          iov++;
+          iovcnt--;
+        }
+
+      if(iovcnt > 0)
+        {
+          iov->iov_base = (char *)iov->iov_base + rc;
+          iov->iov_len -= rc;
+        }
+    }
+}                               /* log_batch_flush */
+
+/* Closes the current log file, it is reopened on the next flush so that rotated logs are followed */
+static void log_batch_close(log_batch_t * batch)
+{
+  log_batch_flush(batch);
+
+  if(batch->fd != -1)
+    close(batch->fd);
+
+  batch->fd = -1;
+  batch->path = NULL;
+}                               /* log_batch_close */
+
+/**
+ *
+ * log_ring_drain: writes the pending messages of a ring.
+ *
+ * Writes the pending messages of a ring, batching them with the messages of
+ * the rings drained before as long as they go to the same log file.
+ * Must be called with log_drain_mutex held.
+ *
+ * @param ring [INOUT] the ring to drain.
+ * @param batch [INOUT] the current batch.
+ *
+ * @return non-zero if the ring is orphaned and empty, and can be freed.
+ *
+ */
+static int log_ring_drain(log_ring_t * ring, log_batch_t * batch)
+{
+  log_record_t *record;
+  unsigned int head, tail;
+  unsigned int mask = ring->size - 1;
+  int orphan;
+  char *path;
+
+  /* Once orphaned, the head of the ring does not move any more */
+  orphan = ring->orphan;
+  __sync_synchronize();
+  head = ring->head;
+  __sync_synchronize();
+
+  for(tail = ring->tail; tail != head;)
+    {
+      record = (log_record_t *) (ring->buffer + (tail & mask));
+
+      if(record->component == LOG_RECORD_SKIP)
+        {
+          tail += record->len;
+          continue;
+        }
+
+      path = LogComponents[record->component].comp_log_file;
+
+      if(batch->path == NULL || strcmp(batch->path, path))
+        {
+          log_batch_close(batch);
+          batch->path = path;
+        }
+      else if(batch->iovcnt == IOV_MAX)
+        log_batch_flush(batch);
+
+      batch->iov[batch->iovcnt].iov_base = (char *)(record + 1);
+      batch->iov[batch->iovcnt].iov_len = record->len;
+      batch->iovcnt += 1;
+
+      tail += LOG_RECORD_SIZE(record->len);
+    }
+
+  /* The batch points into the ring, write it before giving the room back */
+  log_batch_flush(batch);
+  __sync_synchronize();
+  ring->tail = tail;
+
+  return orphan;
+}                               /* log_ring_drain */
+
+/**
+ *
+ * log_drain_rings: writes the pending messages of all the rings.
+ *
+ * Writes the pending messages of all the rings and frees the rings of the
+ * threads that exited. Must be called with log_drain_mutex held.
+ *
+ * @return the number of messages dropped since the previous call.
+ *
+ */
+static unsigned int log_drain_rings(void)
+{
+  log_ring_t *ring, *next, **pprev;
+  unsigned int nb_dropped = 0;
+
+  /* Rings are only inserted at the head of the list, and only removed here */
+  pthread_mutex_lock(&log_rings_mutex);
+  ring = log_rings;
+  pthread_mutex_unlock(&log_rings_mutex);
+
+  log_batch.fd = -1;
+  log_batch.path = NULL;
+  log_batch.iovcnt = 0;
+
+  for(; ring != NULL; ring = next)
+    {
+      next = ring->next;
+
+      nb_dropped += ring->nb_dropped - ring->nb_reported;
+      ring->nb_reported = ring->nb_dropped;
+
+      if(!log_ring_drain(ring, &log_batch))
+        continue;
+
+      pthread_mutex_lock(&log_rings_mutex);
+      for(pprev = &log_rings; *pprev != ring; pprev = &(*pprev)->next) ;
+      *pprev = ring->next;
+      pthread_mutex_unlock(&log_rings_mutex);
+
+      free(ring->buffer);
+      free(ring);
+    }
+
+  log_batch_close(&log_batch);
+
+  return nb_dropped;
+}                               /* log_drain_rings */
+
+static void *log_writer_thread(void *arg)
+{
+  ThreadLogContext_t *context;
+  struct timeval now;
+  struct timespec timeout;
+  unsigned int nb_dropped;
+
+  SetNameFunction("log_writer");
+
+  /* The writer logs synchronously, it would otherwise feed itself */
+  if((context = Log_GetThreadContext(1)) != NULL)
+    context->no_ring = 1;
+
+  while(1)
+    {
+      pthread_mutex_lock(&log_drain_mutex);
+      nb_dropped = log_drain_rings();
+      pthread_mutex_unlock(&log_drain_mutex);
+
+      if(nb_dropped != 0)
+        LogWarn(COMPONENT_LOG, "LOG: %u messages were dropped, log rings were full",
+                nb_dropped);
+
+      gettimeofday(&now, NULL);
+      timeout.tv_sec = now.tv_sec;
+      timeout.tv_nsec = now.tv_usec * 1000 + LOG_WRITER_PERIOD_MS * 1000000;
+      if(timeout.tv_nsec >= 1000000000)
+        {
+          timeout.tv_sec += 1;
+          timeout.tv_nsec -= 1000000000;
+        }
+
+      pthread_mutex_lock(&log_writer_mutex);
+      log_writer_sleeping = 1;
+      pthread_cond_timedwait(&log_writer_cond, &log_writer_mutex, &timeout);
+      log_writer_sleeping = 0;
+      pthread_mutex_unlock(&log_writer_mutex);
+    }
+
+  return NULL;
+}                               /* log_writer_thread */
+
+/**
+ *
+ * StartAsyncLogging: makes file logging asynchronous.
+ *
+ * From now on, messages to log files are queued in per-thread rings and
+ * written by a dedicated thread. Other log types are not affected.
+ *
+ * @param ring_size [IN] size in bytes of each thread's ring, rounded up to a power of 2.
+ * @param policy [IN] what a thread does when its ring is full.
+ *
+ * @return 0 if ok, an errno value otherwise.
+ *
+ */
+int StartAsyncLogging(unsigned int ring_size, log_overflow_policy_t policy)
+{
+  pthread_attr_t attr;
+  int rc;
+
+  if(log_async)
+    return 0;
+
+  for(log_ring_size = LOG_RING_MIN_SIZE;
+      log_ring_size < ring_size && log_ring_size < (1U << 30); log_ring_size <<= 1) ;
+  log_overflow = policy;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+  rc = pthread_create(&log_writer_thrid, &attr, log_writer_thread, NULL);
+  pthread_attr_destroy(&attr);
+
+  if(rc != 0)
+    {
+      LogCrit(COMPONENT_LOG, "LOG: could not start the log writer thread, error %d (%s)",
+              rc, strerror(rc));
+      return rc;
+    }
+
+  /* Messages still queued at exit are written out */
+  atexit(LogFlush);
+
+  log_async = 1;
+
+  LogEvent(COMPONENT_LOG, "LOG: asynchronous file logging, %u bytes rings, %s when full",
+           log_ring_size, policy == LOG_OVERFLOW_DROP ? "drop" : "block");
+
+  return 0;
+}                               /* StartAsyncLogging */
+
+/**
+ *
+ * LogFlush: writes the messages queued for the log files.
+ *
+ * Writes the messages queued for the log files by all threads, before
+ * returning. Does nothing when logging is synchronous.
+ *
+ */
+void LogFlush(void)
+{
+  unsigned int nb_dropped;
+
+  if(!log_async)
+    return;
+
+  pthread_mutex_lock(&log_drain_mutex);
+  nb_dropped = log_drain_rings();
+  pthread_mutex_unlock(&log_drain_mutex);
+
+  /* The caller may be about to exit, a queued warning would be lost */
+  if(nb_dropped != 0)
+    fprintf(stderr, "LOG: %u messages were dropped, log rings were full\n", nb_dropped);
+}                               /* LogFlush */
+
 static int DisplayLogPath_valist(char *path, char * function, log_components_t component, char *format, va_list arguments)
 {
   char tampon[STR_LEN_TXT];
@@ -629,6 +1137,16 @@ static int DisplayLogPath_valist(char *path, char * function, log_components_t c
 
   DisplayLogString_valist(tampon, function, component, format, arguments);
 
+  /* Queue the message for the writer thread when logging asynchronously */
+  if(log_async && path[0] != '\0')
+    {
+      ThreadLogContext_t *context = Log_GetThreadContext(component != COMPONENT_LOG_EMERG);
+
+      if(context != NULL && !context->no_ring &&
+         log_ring_push(context, component, tampon, strlen(tampon)) == 0)
+        return SUCCES;
+    }
+
   if(path[0] != '\0')
     {
 #ifdef _LOCK_LOG
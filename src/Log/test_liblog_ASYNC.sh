@@ -0,0 +1,7 @@
+#!/bin/sh
+##
+## test_liblog_ASYNC.sh
+## test asynchronous file logging (multi-threaded)
+##
+
+./test_liblog ASYNC /tmp/test_liblog.async.$$
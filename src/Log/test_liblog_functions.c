@@ -35,6 +35,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "log_macros.h"
 
 #ifndef TRUE
@@ -463,10 +465,26 @@ void *run_MT_Tests(void *arg)
   return NULL ;
 }
 
-static char usage[] = "usage:\n\ttest_liblog STD|MT\n";
+static char usage[] = "usage:\n\ttest_liblog STD|MT|ASYNC [file]\n";
 
 #define NB_THREADS 20
 
+/* Small rings so that writers have to wait for the log writer thread */
+#define ASYNC_RING_SIZE 4096
+#define ASYNC_NB_MSG    2000
+
+void *run_ASYNC_Tests(void *arg)
+{
+  int i;
+
+  SetNameFunction((char *)arg);
+
+  for(i = 0; i < ASYNC_NB_MSG; i++)
+    LogEvent(COMPONENT_MAIN, "async message %d", i);
+
+  return NULL;
+}
+
 int main(int argc, char *argv[])
 {
 
@@ -549,6 +567,65 @@ int main(int argc, char *argv[])
 
         }
 
+      /* asynchronous file logging, every message must reach the file */
+
+      else if(!strcmp(argv[1], "ASYNC") && argc >= 3)
+        {
+          pthread_t threads[NB_THREADS];
+          char line[2048];
+          FILE *log_file;
+          int i, nb_lines = 0;
+
+          SetNamePgm("test_liblog");
+          SetNameHost("localhost");
+          SetDefaultLogging("TEST");
+          InitLogging();
+          unlink(argv[2]);
+          SetComponentLogFile(COMPONENT_MAIN, argv[2]);
+          SetComponentLogLevel(COMPONENT_MAIN, NIV_EVENT);
+
+          if(StartAsyncLogging(ASYNC_RING_SIZE, LOG_OVERFLOW_BLOCK) != 0)
+            {
+              LogTest("FAILURE: could not start asynchronous logging");
+              exit(1);
+            }
+
+          for(i = 0; i < NB_THREADS; i++)
+            {
+              char *thread_name = malloc(256);
+              snprintf(thread_name, 256, "thread %3d", i);
+              pthread_create(&threads[i], NULL, run_ASYNC_Tests, (void *)thread_name);
+            }
+
+          for(i = 0; i < NB_THREADS; i++)
+            pthread_join(threads[i], NULL);
+
+          LogFlush();
+
+          if((log_file = fopen(argv[2], "r")) == NULL)
+            {
+              LogTest("FAILURE: could not open %s", argv[2]);
+              exit(1);
+            }
+
+          while(fgets(line, sizeof(line), log_file) != NULL)
+            if(strstr(line, "async message") != NULL)
+              nb_lines++;
+
+          fclose(log_file);
+
+          if(nb_lines != NB_THREADS * ASYNC_NB_MSG)
+            {
+              LogTest("FAILURE: found %d messages in %s, expected %d",
+                      nb_lines, argv[2], NB_THREADS * ASYNC_NB_MSG);
+              exit(1);
+            }
+
+          LogTest("SUCCESS: found the %d messages in %s", nb_lines, argv[2]);
+          unlink(argv[2]);
+          return 0;
+        }
+
       /* unknown test */
       else
         {
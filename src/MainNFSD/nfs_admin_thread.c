@@ -147,6 +147,9 @@ static void ChangeoverExports()
       pcurrent = nfs_param.pexportlist->next;
     }
 
+  nfs_export_latency_free(nfs_param.pexportlist);
+  nfs_export_access_free(nfs_param.pexportlist);
+
   /* Changed the old export list head to the new export list head.
    * All references to the exports list should be up-to-date now. */
   memcpy(nfs_param.pexportlist, temp_pexportlist, sizeof(exportlist_t));
@@ -0,0 +1,83 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_cache_inode_flush_thread.c
+ * \brief   The file that contain the 'cache_inode_flush_thread' routine for the nfsd.
+ *
+ * nfs_cache_inode_flush_thread.c : The flusher of the Ganesha write buffer. It
+ * writes the unstable data of the files that are no more written to, or of
+ * every file when the memory budget gets short, so that COMMIT finds little
+ * to do.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "HashData.h"
+#include "HashTable.h"
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs_core.h"
+#include "cache_inode.h"
+
+/* Client used by the flusher to open the files */
+static cache_inode_client_t cache_inode_flush_client;
+
+void *cache_inode_flush_thread(void *Arg)
+{
+  unsigned int nb_flushed;
+  time_t delay;
+
+  SetNameFunction("cache_inode_flush");
+
+  LogEvent(COMPONENT_CACHE_INODE,
+           "CACHE INODE FLUSHER : Starting flush thread");
+
+  if(cache_inode_client_init(&cache_inode_flush_client,
+                             nfs_param.cache_layers_param.cache_inode_client_param,
+                             FLUSH_THREAD_INDEX, NULL))
+    {
+      LogFatal(COMPONENT_CACHE_INODE,
+               "CACHE INODE FLUSHER : Cache Inode client could not be initialized");
+    }
+
+  while(1)
+    {
+      delay = cache_inode_unstable_get_flush_delay();
+      cache_inode_unstable_wait(delay > 0 ? delay : 1);
+
+      nb_flushed = cache_inode_unstable_flush_pass(&cache_inode_flush_client);
+
+      if(nb_flushed > 0)
+        LogFullDebug(COMPONENT_CACHE_INODE,
+                     "CACHE INODE FLUSHER : %u files flushed", nb_flushed);
+    }
+
+  return NULL;
+}                               /* cache_inode_flush_thread */
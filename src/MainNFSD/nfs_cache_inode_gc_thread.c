@@ -0,0 +1,102 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * Copyright CEA/DAM/DIF  (2008)
+ * contributeur : Philippe DENIEL   philippe.deniel@cea.fr
+ *                Thomas LEIBOVICI  thomas.leibovici@cea.fr
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_cache_inode_gc_thread.c
+ * \brief   The file that contain the 'cache_inode_gc_thread' routine for the nfsd.
+ *
+ * nfs_cache_inode_gc_thread.c : The garbage collector of the cache inode. It
+ * reclaims entries when the cache grows above its high water mark, so that the
+ * workers never stop serving requests to do it.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "HashData.h"
+#include "HashTable.h"
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs_core.h"
+#include "cache_inode.h"
+
+/* The cache size is checked every NFS_CACHE_INODE_GC_PERIOD seconds */
+#define NFS_CACHE_INODE_GC_PERIOD 1
+
+/* Client whose pools are used by the gc for its temporary hash keys */
+static cache_inode_client_t cache_inode_gc_client;
+
+void *cache_inode_gc_thread(void *Arg)
+{
+  hash_table_t *ht = (hash_table_t *) Arg;
+  cache_inode_gc_policy_t gcpol;
+  unsigned int hash_size;
+  unsigned int nb_reclaimed;
+
+  SetNameFunction("cache_inode_gc");
+
+  LogEvent(COMPONENT_CACHE_INODE_GC,
+           "CACHE INODE GARBAGE COLLECTION : Starting GC thread");
+
+  if(cache_inode_client_init(&cache_inode_gc_client,
+                             nfs_param.cache_layers_param.cache_inode_client_param,
+                             GC_THREAD_INDEX, NULL))
+    {
+      LogFatal(COMPONENT_CACHE_INODE_GC,
+               "CACHE INODE GARBAGE COLLECTION : Cache Inode client could not be initialized");
+    }
+
+  while(1)
+    {
+      sleep(NFS_CACHE_INODE_GC_PERIOD);
+
+      gcpol = cache_inode_get_gc_policy();
+      hash_size = HashTable_GetSize(ht);
+
+      if(hash_size <= gcpol.hwmark_nb_entries)
+        continue;
+
+      LogInfo(COMPONENT_CACHE_INODE_GC,
+              "CACHE INODE GARBAGE COLLECTION : High Water Mark is reached, %u entries to be removed",
+              hash_size - gcpol.lwmark_nb_entries);
+
+      nb_reclaimed = cache_inode_gc_reclaim(ht, &cache_inode_gc_client,
+                                            hash_size - gcpol.lwmark_nb_entries);
+
+      LogInfo(COMPONENT_CACHE_INODE_GC,
+              "CACHE INODE GARBAGE COLLECTION : %u entries removed, %u entries left",
+              nb_reclaimed, HashTable_GetSize(ht));
+    }
+
+  return NULL;
+}                               /* cache_inode_gc_thread */
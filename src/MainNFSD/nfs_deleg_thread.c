@@ -0,0 +1,74 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_deleg_thread.c
+ * \brief   The file that contain the 'nfs4_deleg_recall_thread' routine for the nfsd.
+ *
+ * nfs_deleg_thread.c : The sender of the CB_RECALL of NFSv4 delegations. It
+ * also revokes the delegations that are not returned in time.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs_core.h"
+#include "sal_functions.h"
+
+#define NFS4_DELEG_RECALL_DELAY 1
+
+void *nfs4_deleg_recall_thread(void *Arg)
+{
+  state_deleg_recall_t recall;
+
+  SetNameFunction("nfs4_deleg");
+
+#ifndef _NO_BUDDY_SYSTEM
+  if(BuddyInit(NULL) != BUDDY_SUCCESS)
+    {
+      LogFatal(COMPONENT_STATE,
+               "NFS4 DELEG : Memory manager could not be initialized");
+    }
+#endif
+
+  LogEvent(COMPONENT_STATE,
+           "NFS4 DELEG : Starting delegation recall thread");
+
+  while(1)
+    {
+      if(!state_deleg_recall_get(&recall, NFS4_DELEG_RECALL_DELAY))
+        continue;
+
+      if(nfs4_cb_recall_send(&recall) == 0)
+        state_deleg_recall_sent(&recall);
+    }
+
+  return NULL;
+}                               /* nfs4_deleg_recall_thread */
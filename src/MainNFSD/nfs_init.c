@@ -87,6 +87,8 @@ hash_table_t *ht_ip_stats[NB_MAX_WORKER_THREAD];
 nfs_start_info_t nfs_start_info;
 
 pthread_t worker_thrid[NB_MAX_WORKER_THREAD];
+pthread_t tcp_reactor_thrid[NB_MAX_TCP_REACTOR_THREAD];
+pthread_t udp_receiver_thrid[NB_MAX_UDP_RECEIVER_THREAD];
 
 pthread_t flusher_thrid[NB_MAX_FLUSHER_THREAD];
 nfs_flush_thread_data_t flush_info[NB_MAX_FLUSHER_THREAD];
@@ -96,6 +98,11 @@ pthread_t stat_thrid;
 pthread_t stat_exporter_thrid;
 pthread_t admin_thrid;
 pthread_t fcc_gc_thrid;
+pthread_t cache_inode_gc_thrid;
+pthread_t cache_inode_flush_thrid;
+pthread_t recovery_thrid;
+pthread_t deleg_thrid;
+pthread_t lease_thrid;
 pthread_t sigmgr_thrid;
 
 char config_path[MAXPATHLEN];
@@ -220,7 +227,7 @@ void nfs_print_param_config()
   printf("\tNFS_Program = %u ;\n", nfs_param.core_param.program[P_NFS]);
   printf("\tMNT_Program = %u ;\n", nfs_param.core_param.program[P_NFS]);
   printf("\tNb_Worker = %u ; \n", nfs_param.core_param.nb_worker);
-  printf("\tb_Call_Before_Queue_Avg = %u ; \n", nfs_param.core_param.nb_call_before_queue_avg);
+  printf("\tAffinity_Max_Pending = %u ; \n", nfs_param.core_param.nb_affinity_max_pending);
   printf("\tNb_MaxConcurrentGC = %u ; \n", nfs_param.core_param.nb_max_concurrent_gc);
   printf("\tDupReq_Expiration = %lu ; \n", nfs_param.core_param.expiration_dupreq);
   printf("\tCore_Dump_Size = %ld ; \n", nfs_param.core_param.core_dump_size);
@@ -229,6 +236,9 @@ void nfs_print_param_config()
   printf("\tStats_Update_Delay = %d ; \n", nfs_param.core_param.stats_update_delay);
   printf("\tLong_Processing_Threshold = %d ; \n", nfs_param.core_param.long_processing_threshold);
   printf("\tTCP_Fridge_Expiration_Delay = %d ; \n", nfs_param.core_param.tcp_fridge_expiration_delay);
+  printf("\tNb_TCP_Reactor = %u ; \n", nfs_param.core_param.nb_tcp_reactor);
+  printf("\tTCP_Write_Timeout = %d ; \n", nfs_param.core_param.tcp_write_timeout);
+  printf("\tNb_UDP_Receiver = %u ; \n", nfs_param.core_param.nb_udp_receiver);
   printf("\tStats_Per_Client_Directory = %s ; \n",
          nfs_param.core_param.stats_per_client_directory);
 
@@ -252,6 +262,18 @@ void nfs_print_param_config()
   else
     printf("\tDrop_Delay_Errors = FALSE ;\n");
 
+  if(nfs_param.core_param.async_log)
+    printf("\tAsync_Log = TRUE ; \n");
+  else
+    printf("\tAsync_Log = FALSE ;\n");
+
+  printf("\tAsync_Log_Ring_Size = %u ; \n", nfs_param.core_param.async_log_ring_size);
+
+  if(nfs_param.core_param.async_log_overflow == LOG_OVERFLOW_DROP)
+    printf("\tAsync_Log_Overflow = DROP ; \n");
+  else
+    printf("\tAsync_Log_Overflow = BLOCK ;\n");
+
   printf("}\n\n");
 
   printf("NFS_Worker_Param\n{\n");
@@ -272,7 +294,7 @@ void nfs_set_param_default()
 
   /* Core parameters */
   nfs_param.core_param.nb_worker = NB_WORKER_THREAD_DEFAULT;
-  nfs_param.core_param.nb_call_before_queue_avg = NB_REQUEST_BEFORE_QUEUE_AVG;
+  nfs_param.core_param.nb_affinity_max_pending = NB_AFFINITY_MAX_PENDING;
   nfs_param.core_param.nb_max_concurrent_gc = NB_MAX_CONCURRENT_GC;
   nfs_param.core_param.expiration_dupreq = DUPREQ_EXPIRATION;
   nfs_param.core_param.port[P_NFS] = NFS_PORT;
@@ -298,6 +320,9 @@ void nfs_set_param_default()
   nfs_param.core_param.stats_update_delay = 60;
   nfs_param.core_param.long_processing_threshold = 10; /* seconds */
   nfs_param.core_param.tcp_fridge_expiration_delay = -1;
+  nfs_param.core_param.nb_tcp_reactor = NB_TCP_REACTOR_THREAD_DEFAULT;
+  nfs_param.core_param.tcp_write_timeout = 2; /* seconds */
+  nfs_param.core_param.nb_udp_receiver = NB_UDP_RECEIVER_THREAD_DEFAULT;
 /* only NFSv4 is supported for the FSAL_PROXY */
 #if ! defined( _USE_PROXY ) || defined ( _HANDLE_MAPPING )
   nfs_param.core_param.core_options = CORE_OPTION_NFSV3 | CORE_OPTION_NFSV4;
@@ -312,21 +337,16 @@ void nfs_set_param_default()
 
   nfs_param.core_param.max_send_buffer_size = NFS_DEFAULT_SEND_BUFFER_SIZE;
   nfs_param.core_param.max_recv_buffer_size = NFS_DEFAULT_RECV_BUFFER_SIZE;
+  nfs_param.core_param.async_log = FALSE;
+  nfs_param.core_param.async_log_ring_size = NFS_DEFAULT_ASYNC_LOG_RING_SIZE;
+  nfs_param.core_param.async_log_overflow = LOG_OVERFLOW_BLOCK;
 
-  /* Worker parameters : LRU */
-  nfs_param.worker_param.lru_param.nb_entry_prealloc = NB_PREALLOC_LRU_WORKER;
-  nfs_param.worker_param.lru_param.clean_entry = clean_pending_request;
-  nfs_param.worker_param.lru_param.entry_to_str = print_pending_request;
-
-  /* Worker parameters : LRU dupreq */
-  nfs_param.worker_param.lru_dupreq.nb_entry_prealloc = NB_PREALLOC_LRU_DUPREQ;
-  nfs_param.worker_param.lru_dupreq.clean_entry = clean_entry_dupreq;
-  nfs_param.worker_param.lru_dupreq.entry_to_str = print_entry_dupreq;
+  /* Worker parameters : request queue */
+  nfs_param.worker_param.nb_pending_queue_size = NB_PENDING_QUEUE_SIZE;
 
   /* Worker parameters : GC */
   nfs_param.worker_param.nb_pending_prealloc = NB_MAX_PENDING_REQUEST;
   nfs_param.worker_param.nb_before_gc = NB_REQUEST_BEFORE_GC;
-  nfs_param.worker_param.nb_dupreq_prealloc = NB_PREALLOC_HASH_DUPREQ;
   nfs_param.worker_param.nb_dupreq_before_gc = NB_PREALLOC_GC_DUPREQ;
 
   /* Workers parameters : IP/Name values pool prealloc */
@@ -360,17 +380,17 @@ void nfs_set_param_default()
   nfs_param.nfsv4_param.return_bad_stateid = TRUE;
   strncpy(nfs_param.nfsv4_param.domainname, DEFAULT_DOMAIN, MAXNAMLEN);
   strncpy(nfs_param.nfsv4_param.idmapconf, DEFAULT_IDMAPCONF, MAXPATHLEN);
+  strncpy(nfs_param.nfsv4_param.recov_journal, DEFAULT_RECOV_JOURNAL, MAXPATHLEN);
+  nfs_param.nfsv4_param.recov_journal_size = DEFAULT_RECOV_JOURNAL_SIZE;
+  nfs_param.nfsv4_param.allow_delegations = FALSE;
 
   /* Worker parameters : dupreq hash table */
   nfs_param.dupreq_param.hash_param.index_size = PRIME_DUPREQ;
   nfs_param.dupreq_param.hash_param.alphabet_length = 10;    /* Xid is a numerical decimal value */
   nfs_param.dupreq_param.hash_param.nb_node_prealloc = NB_PREALLOC_HASH_DUPREQ;
-  nfs_param.dupreq_param.hash_param.hash_func_key = dupreq_value_hash_func;
-  nfs_param.dupreq_param.hash_param.hash_func_rbt = dupreq_rbt_hash_func;
-  nfs_param.dupreq_param.hash_param.compare_key = compare_req;
-  nfs_param.dupreq_param.hash_param.key_to_str = display_req_key;
-  nfs_param.dupreq_param.hash_param.val_to_str = display_req_val;
   nfs_param.dupreq_param.hash_param.name = "Duplicate Request Cache";
+  nfs_param.dupreq_param.hash_param.backend = HASHTABLE_BACKEND_RBT;
+  nfs_param.dupreq_param.nb_entries_per_client = NB_DUPREQ_PER_CLIENT;
 
   /*  Worker parameters : IP/name hash table */
   nfs_param.ip_name_param.hash_param.index_size = PRIME_IP_NAME;
@@ -467,6 +487,7 @@ void nfs_set_param_default()
   nfs_param.client_id_param.hash_param.key_to_str = display_client_id;
   nfs_param.client_id_param.hash_param.val_to_str = display_client_id_val;
   nfs_param.client_id_param.hash_param.name = "Client ID";
+  nfs_param.client_id_param.hash_param.backend = HASHTABLE_BACKEND_RBT;
 
   /* NFSv4 Client id reverse table */
   nfs_param.client_id_param.hash_param_reverse.index_size = PRIME_CLIENT_ID;
@@ -493,6 +514,7 @@ void nfs_set_param_default()
   nfs_param.state_id_param.hash_param.key_to_str = display_state_id_key;
   nfs_param.state_id_param.hash_param.val_to_str = display_state_id_val;
   nfs_param.state_id_param.hash_param.name = "State ID";
+  nfs_param.state_id_param.hash_param.backend = HASHTABLE_BACKEND_RBT;
 
 #ifdef _USE_NFS4_1
   /* NFSv4 State Id hash */
@@ -505,6 +527,7 @@ void nfs_set_param_default()
   nfs_param.session_id_param.hash_param.key_to_str = display_session_id_key;
   nfs_param.session_id_param.hash_param.val_to_str = display_session_id_val;
   nfs_param.session_id_param.hash_param.name = "Session ID";
+  nfs_param.session_id_param.hash_param.backend = HASHTABLE_BACKEND_RBT;
 
 #ifdef _USE_PNFS
   /* pNFS parameters */
@@ -578,6 +601,7 @@ void nfs_set_param_default()
   nfs_param.cache_layers_param.cache_param.hparam.key_to_str = display_cache;
   nfs_param.cache_layers_param.cache_param.hparam.val_to_str = display_cache;
   nfs_param.cache_layers_param.cache_param.hparam.name = "Cache Inode";
+  nfs_param.cache_layers_param.cache_param.hparam.backend = HASHTABLE_BACKEND_RBT;
 
 #ifdef _USE_NLM
   /* Cache inode parameters : cookie hash table */
@@ -628,6 +652,8 @@ void nfs_set_param_default()
   nfs_param.cache_layers_param.cache_inode_client_param.use_cache = 0;
   nfs_param.cache_layers_param.cache_inode_client_param.use_fsal_hash = 1;
   nfs_param.cache_layers_param.cache_inode_client_param.retention = 60;
+  nfs_param.cache_layers_param.cache_inode_client_param.unstable_budget = CACHE_INODE_UNSTABLE_BUDGET;
+  nfs_param.cache_layers_param.cache_inode_client_param.unstable_flush_delay = CACHE_INODE_UNSTABLE_FLUSH_DELAY;
 
   /* Data cache client parameters */
   nfs_param.cache_layers_param.cache_content_client_param.nb_prealloc_entry = 128;
@@ -1331,26 +1357,38 @@ int nfs_check_param_consistency()
       return 1;
     }
 
-  if(nfs_param.worker_param.nb_before_gc <
-     nfs_param.worker_param.lru_param.nb_entry_prealloc / 2)
+  if(nfs_param.core_param.nb_tcp_reactor == 0 ||
+     nfs_param.core_param.nb_tcp_reactor > NB_MAX_TCP_REACTOR_THREAD)
     {
       LogCrit(COMPONENT_INIT,
-              "BAD PARAMETER: worker_param.nb_before_gc is too small: %d",
-              nfs_param.worker_param.nb_before_gc);
+              "BAD PARAMETER: number of TCP reactors must be between 1 and %d",
+              NB_MAX_TCP_REACTOR_THREAD);
+      return 1;
+    }
+
+  /* 0 leaves the UDP sockets to the dispatcher */
+  if(nfs_param.core_param.nb_udp_receiver > NB_MAX_UDP_RECEIVER_THREAD)
+    {
       LogCrit(COMPONENT_INIT,
-              "BAD PARAMETER: It should be at least half of worker_param.lru_param.nb_entry_prealloc = %d",
-              nfs_param.worker_param.lru_param.nb_entry_prealloc);
+              "BAD PARAMETER: number of UDP receivers is limited to %d",
+              NB_MAX_UDP_RECEIVER_THREAD);
+      return 1;
+    }
 
+  if(nfs_param.worker_param.nb_pending_queue_size == 0)
+    {
+      LogCrit(COMPONENT_INIT,
+              "BAD PARAMETER: worker_param.nb_pending_queue_size must not be 0");
       return 1;
     }
 
-  if(nfs_param.dupreq_param.hash_param.nb_node_prealloc <
-     nfs_param.worker_param.lru_dupreq.nb_entry_prealloc)
+  if(nfs_param.dupreq_param.nb_entries_per_client == 0 ||
+     (nfs_param.dupreq_param.nb_entries_per_client &
+      (nfs_param.dupreq_param.nb_entries_per_client - 1)) != 0)
     {
       LogCrit(COMPONENT_INIT,
-              "BAD PARAMETER(dupreq): nb_node_prealloc = %d should be greater than nb_entry_prealloc = %d",
-              nfs_param.dupreq_param.hash_param.nb_node_prealloc,
-              nfs_param.worker_param.lru_dupreq.nb_entry_prealloc);
+              "BAD PARAMETER(dupreq): nb_entries_per_client = %u should be a power of 2",
+              nfs_param.dupreq_param.nb_entries_per_client);
       return 1;
     }
 #ifdef _USE_MFSL_ASYNC
@@ -1468,6 +1506,9 @@ void nfs_reset_stats(void)
           workers_data[i].stats.stat_req.stat_op_nfs41[j].failed = 0;
         }
 
+      if(workers_data[i].stats.stat_req.platency != NULL)
+        memset(workers_data[i].stats.stat_req.platency, 0, sizeof(nfs_latency_stat_t));
+
       workers_data[i].stats.last_stat_update = 0;
       memset(&workers_data[i].stats.fsal_stats, 0, sizeof(fsal_statistics_t));
 #ifndef _NO_BUDDY_SYSTEM
@@ -1538,6 +1579,58 @@ static void nfs_Start_threads(bool_t flush_datacache_mode)
     nlm_startup();
 #endif
 
+#ifdef _USE_TIRPC
+  /* Non-blocking connections give up on a client not reading its replies */
+  Svc_vc_setwritetimeout(nfs_param.core_param.tcp_write_timeout);
+#endif
+
+#if defined(_USE_TIRPC) && defined(HAVE_SYS_EPOLL_H)
+  /* Starting the TCP reactor threads, they must be ready before the dispatcher
+   * accepts connections */
+  if(nfs_Init_tcp_reactors() != 0)
+    LogFatal(COMPONENT_THREAD, "can't initialize the TCP reactors");
+
+  for(i = 0; i < nfs_param.core_param.nb_tcp_reactor; i++)
+    {
+      if((rc =
+          pthread_create(&(tcp_reactor_thrid[i]), &attr_thr, rpc_tcp_reactor_thread,
+                         (void *)i)) != 0)
+        {
+          LogFatal(COMPONENT_THREAD,
+                   "Could not create rpc_tcp_reactor_thread #%lu, error = %d (%s)",
+                   i, errno, strerror(errno));
+        }
+    }
+  LogEvent(COMPONENT_THREAD,
+           "%u TCP reactor threads were started successfully",
+           nfs_param.core_param.nb_tcp_reactor);
+#endif
+
+#if defined(_USE_TIRPC) && defined(HAVE_SYS_EPOLL_H) && defined(HAVE_RECVMMSG)
+  /* Starting the UDP receiver threads, they take the UDP sockets away from
+   * the dispatcher */
+  if(nfs_param.core_param.nb_udp_receiver > 0)
+    {
+      if(nfs_Init_udp_receivers() != 0)
+        LogFatal(COMPONENT_THREAD, "can't initialize the UDP receivers");
+
+      for(i = 0; i < nfs_param.core_param.nb_udp_receiver; i++)
+        {
+          if((rc =
+              pthread_create(&(udp_receiver_thrid[i]), &attr_thr, rpc_udp_receiver_thread,
+                             (void *)i)) != 0)
+            {
+              LogFatal(COMPONENT_THREAD,
+                       "Could not create rpc_udp_receiver_thread #%lu, error = %d (%s)",
+                       i, errno, strerror(errno));
+            }
+        }
+      LogEvent(COMPONENT_THREAD,
+               "%u UDP receiver threads were started successfully",
+               nfs_param.core_param.nb_udp_receiver);
+    }
+#endif
+
   /* Starting the rpc dispatcher thread */
   if((rc =
       pthread_create(&rpc_dispatcher_thrid, &attr_thr, rpc_dispatcher_thread,
@@ -1594,6 +1687,66 @@ static void nfs_Start_threads(bool_t flush_datacache_mode)
 
 #endif      /*  _USE_STAT_EXPORTER */
 
+  /* Starting the cache inode gc thread */
+  if((rc =
+      pthread_create(&cache_inode_gc_thrid, &attr_thr, cache_inode_gc_thread,
+                     (void *)workers_data[0].ht)) != 0)
+    {
+      LogFatal(COMPONENT_THREAD,
+               "Could not create cache_inode_gc_thread, error = %d (%s)",
+               errno, strerror(errno));
+    }
+  LogEvent(COMPONENT_THREAD, "cache inode gc thread was started successfully");
+
+  /* Starting the flusher of the Ganesha write buffer */
+  if((rc =
+      pthread_create(&cache_inode_flush_thrid, &attr_thr, cache_inode_flush_thread,
+                     NULL)) != 0)
+    {
+      LogFatal(COMPONENT_THREAD,
+               "Could not create cache_inode_flush_thread, error = %d (%s)",
+               errno, strerror(errno));
+    }
+  LogEvent(COMPONENT_THREAD, "cache inode flush thread was started successfully");
+
+  /* Starting the writer of the NFSv4 recovery journal */
+  if(nfs4_recovery_enabled())
+    {
+      if((rc =
+          pthread_create(&recovery_thrid, &attr_thr, nfs4_recovery_thread,
+                         NULL)) != 0)
+        {
+          LogFatal(COMPONENT_THREAD,
+                   "Could not create nfs4_recovery_thread, error = %d (%s)",
+                   errno, strerror(errno));
+        }
+      LogEvent(COMPONENT_THREAD, "nfs4 recovery thread was started successfully");
+    }
+
+  /* Starting the sender of the recalls of NFSv4 delegations */
+  if(nfs_param.nfsv4_param.allow_delegations)
+    {
+      if((rc =
+          pthread_create(&deleg_thrid, &attr_thr, nfs4_deleg_recall_thread,
+                         NULL)) != 0)
+        {
+          LogFatal(COMPONENT_THREAD,
+                   "Could not create nfs4_deleg_recall_thread, error = %d (%s)",
+                   errno, strerror(errno));
+        }
+      LogEvent(COMPONENT_THREAD, "nfs4 delegation recall thread was started successfully");
+    }
+
+  /* Starting the reaper of the NFSv4 clients whose lease expired */
+  if((rc =
+      pthread_create(&lease_thrid, &attr_thr, nfs4_lease_reaper_thread, NULL)) != 0)
+    {
+      LogFatal(COMPONENT_THREAD,
+               "Could not create nfs4_lease_reaper_thread, error = %d (%s)",
+               errno, strerror(errno));
+    }
+  LogEvent(COMPONENT_THREAD, "nfs4 lease reaper thread was started successfully");
+
   if(nfs_param.cache_layers_param.dcgcpol.run_interval != 0)
     {
       /* Starting the nfs file content gc thread  */
@@ -1708,6 +1861,10 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
   /* Set the cache inode GC policy */
   cache_inode_set_gc_policy(nfs_param.cache_layers_param.gcpol);
 
+  /* Set the limits of the Ganesha write buffer */
+  cache_inode_unstable_set_policy(nfs_param.cache_layers_param.cache_inode_client_param.unstable_budget,
+                                  nfs_param.cache_layers_param.cache_inode_client_param.unstable_flush_delay);
+
   /* Set the cache content GC policy */
   cache_content_set_gc_policy(nfs_param.cache_layers_param.dcgcpol);
 
@@ -1843,20 +2000,6 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
           Fatal();
         }
 
-      /* Allocation of the nfs dupreq pool */
-      MakePool(&workers_data[i].dupreq_pool,
-               nfs_param.worker_param.nb_dupreq_prealloc,
-               dupreq_entry_t, NULL, NULL);
-      NamePool(&workers_data[i].dupreq_pool, "Duplicate Request Pool %d", i);
-
-      if(!IsPoolPreallocated(&workers_data[i].dupreq_pool))
-        {
-          LogCrit(COMPONENT_INIT,
-                  "Error while allocating duplicate request pool #%d", i);
-          LogError(COMPONENT_INIT, ERR_SYS, ERR_MALLOC, errno);
-          Fatal();
-        }
-
       /* Allocation of the IP/name pool */
       MakePool(&workers_data[i].ip_stats_pool,
                nfs_param.worker_param.nb_ip_stats_prealloc,
@@ -1896,15 +2039,15 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
           "NFSv4 pseudo file system successfully initialized");
 
   /* Init duplicate request cache */
-  LogDebug(COMPONENT_INIT, "Now building duplicate request hash table cache");
+  LogDebug(COMPONENT_INIT, "Now building duplicate request cache");
   if((rc = nfs_Init_dupreq(nfs_param.dupreq_param)) != DUPREQ_SUCCESS)
     {
       LogFatal(COMPONENT_INIT,
-               "Error %d while initializing duplicate request hash table cache",
+               "Error %d while initializing duplicate request cache",
                rc);
     }
   LogInfo(COMPONENT_INIT,
-          "duplicate request hash table cache successfully initialized");
+          "duplicate request cache successfully initialized");
 
   /* Init the IP/name cache */
   LogDebug(COMPONENT_INIT, "Now building IP/name cache");
@@ -1989,6 +2132,18 @@ static void nfs_Init(const nfs_start_info_t * p_start_info)
   LogInfo(COMPONENT_INIT,
           "NFSv4 Open Owner cache successfully initialized");
 
+  /* The lease timing wheel starts now */
+  nfs4_lease_init(time(NULL));
+
+  /* Replay the NFSv4 recovery journal, this decides on the grace period */
+  LogDebug(COMPONENT_INIT, "Now replaying NFSv4 recovery journal");
+  if(nfs4_recovery_init(nfs_param.nfsv4_param.recov_journal,
+                        nfs_param.nfsv4_param.recov_journal_size) != 0)
+    {
+      LogCrit(COMPONENT_INIT,
+              "NFSv4 recovery journal unavailable, going on without grace period");
+    }
+
 #ifdef _USE_NLM
   /* Init The NLM Owner cache */
   LogDebug(COMPONENT_INIT, "Now building NLM Owner cache");
@@ -2099,6 +2254,7 @@ void nfs_start(nfs_start_info_t * p_start_info)
   fsal_status_t fsal_status;
   fsal_op_context_t fsal_context;
   unsigned int i;
+  uint64_t write_verifier;
 
 #if 0
   /* Will remain as long as all FSAL are not yet in new format */
@@ -2182,6 +2338,12 @@ void nfs_start(nfs_start_info_t * p_start_info)
       exit(0);
     }
 
+  /* From now on, log files are written by a dedicated thread if asked to */
+  if(nfs_param.core_param.async_log &&
+     StartAsyncLogging(nfs_param.core_param.async_log_ring_size,
+                       nfs_param.core_param.async_log_overflow) != 0)
+    LogCrit(COMPONENT_INIT, "Could not start asynchronous logging, logging synchronously");
+
   /* Set the Core dump size if set */
   if(nfs_param.core_param.core_dump_size != -1)
     {
@@ -2247,12 +2409,16 @@ void nfs_start(nfs_start_info_t * p_start_info)
   /* Set the server's boot time */
   ServerBootTime = time(NULL);
 
-  /* Set the write verifiers */
+  /* Set the write verifiers. Unstable writes buffered in memory are lost at
+   * restart: the verifiers must change even for a restart within the same
+   * second, so that the clients send these writes again */
+  write_verifier = (uint64_t) ServerBootTime ^ ((uint64_t) getpid() << 40);
+
   memset(NFS3_write_verifier, 0, sizeof(writeverf3));
-  memcpy(NFS3_write_verifier, &ServerBootTime, sizeof(time_t));
+  memcpy(NFS3_write_verifier, &write_verifier, sizeof(write_verifier));
 
   memset(NFS4_write_verifier, 0, sizeof(verifier4));
-  memcpy(NFS4_write_verifier, &ServerBootTime, sizeof(time_t));
+  memcpy(NFS4_write_verifier, &write_verifier, sizeof(write_verifier));
 
   /* Initialize all layers and service threads */
   nfs_Init(p_start_info);
@@ -0,0 +1,95 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_lease_thread.c
+ * \brief   The file that contain the 'nfs4_lease_reaper_thread' routine for the nfsd.
+ *
+ * nfs_lease_thread.c : The reaper of the NFSv4 clients whose lease expired,
+ * it releases their locks, opens and delegations.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs_core.h"
+#include "cache_inode.h"
+#include "sal_functions.h"
+
+#define NFS4_LEASE_REAP_DELAY 1
+
+/* Client used by the reaper to release the states */
+static cache_inode_client_t lease_reaper_client;
+
+/* Pool the client ids of the expired clients are released to */
+static struct prealloc_pool lease_reaper_clientid_pool;
+
+void *nfs4_lease_reaper_thread(void *Arg)
+{
+  unsigned int nb_expired;
+
+  SetNameFunction("nfs4_lease");
+
+#ifndef _NO_BUDDY_SYSTEM
+  if(BuddyInit(NULL) != BUDDY_SUCCESS)
+    {
+      LogFatal(COMPONENT_STATE,
+               "NFS4 LEASE : Memory manager could not be initialized");
+    }
+#endif
+
+  if(cache_inode_client_init(&lease_reaper_client,
+                             nfs_param.cache_layers_param.cache_inode_client_param,
+                             LEASE_THREAD_INDEX, NULL))
+    {
+      LogFatal(COMPONENT_STATE,
+               "NFS4 LEASE : Cache Inode client could not be initialized");
+    }
+
+  InitPool(&lease_reaper_clientid_pool, nfs_param.worker_param.nb_client_id_prealloc,
+           nfs_client_id_t, NULL, NULL);
+  NamePool(&lease_reaper_clientid_pool, "Lease Reaper Client ID Pool");
+
+  LogEvent(COMPONENT_STATE,
+           "NFS4 LEASE : Starting lease reaper thread");
+
+  while(1)
+    {
+      sleep(NFS4_LEASE_REAP_DELAY);
+
+      nb_expired = nfs4_lease_reap(&lease_reaper_client, &lease_reaper_clientid_pool);
+
+      if(nb_expired > 0)
+        LogFullDebug(COMPONENT_STATE,
+                     "NFS4 LEASE : %u clients expired", nb_expired);
+    }
+
+  return NULL;
+}                               /* nfs4_lease_reaper_thread */
@@ -0,0 +1,70 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_recovery_thread.c
+ * \brief   The file that contain the 'nfs4_recovery_thread' routine for the nfsd.
+ *
+ * nfs_recovery_thread.c : The writer of the NFSv4 recovery journal. It
+ * writes the records staged by the workers in batches, and ends the grace
+ * period when it times out.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs_core.h"
+#include "sal_functions.h"
+
+#define NFS4_RECOVERY_FLUSH_DELAY 1
+
+void *nfs4_recovery_thread(void *Arg)
+{
+  size_t nb_written;
+
+  SetNameFunction("nfs4_recovery");
+
+  LogEvent(COMPONENT_STATE,
+           "NFS4 RECOVERY : Starting journal thread");
+
+  while(1)
+    {
+      nfs4_recovery_wait(NFS4_RECOVERY_FLUSH_DELAY);
+
+      nb_written = nfs4_recovery_flush();
+
+      if(nb_written > 0)
+        LogFullDebug(COMPONENT_STATE,
+                     "NFS4 RECOVERY : %llu bytes journaled",
+                     (unsigned long long)nb_written);
+    }
+
+  return NULL;
+}                               /* nfs4_recovery_thread */
@@ -48,6 +48,9 @@
 #include <fcntl.h>
 #include <sys/file.h>           /* for having FNDELAY */
 #include <sys/select.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 #include "HashData.h"
 #include "HashTable.h"
 #include "rpc.h"
@@ -76,8 +79,6 @@
   #define P_FAMILY AF_INET6
 #endif
 
-static pthread_mutex_t lock_worker_selection = PTHREAD_MUTEX_INITIALIZER;
-
 #if !defined(_NO_BUDDY_SYSTEM) && defined(_DEBUG_MEMLEAKS)
 /**
  *
@@ -183,6 +184,13 @@ int tcp_socket[P_COUNT];
 SVCXPRT *udp_xprt[P_COUNT];
 SVCXPRT *tcp_xprt[P_COUNT];
 
+#if defined(_USE_TIRPC) && defined(HAVE_SYS_EPOLL_H) && defined(HAVE_RECVMMSG)
+/* UDP receiver #0 serves udp_socket[], the others have their own sockets bound
+ * to the same ports with SO_REUSEPORT */
+static int udp_receiver_socket[NB_MAX_UDP_RECEIVER_THREAD][P_COUNT];
+static int udp_receiver_epollfd[NB_MAX_UDP_RECEIVER_THREAD];
+#endif
+
 /**
  * unregister: Unregister an RPC program.
  *
@@ -234,29 +242,42 @@ void unregister_rpc(void)
   (nfs_param.core_param.core_options & (CORE_OPTION_NFSV2 | CORE_OPTION_NFSV3)) != 0)
 #endif
 
-void Create_udp(protos prot)
+static SVCXPRT *Create_udp_xprt(protos prot, int sock)
 {
+  SVCXPRT *xprt;
+
 #ifdef _USE_TIRPC
-  udp_xprt[prot] = Svc_dg_create(udp_socket[prot],
-                                 nfs_param.core_param.max_send_buffer_size,
-                                 nfs_param.core_param.max_recv_buffer_size);
+  xprt = Svc_dg_create(sock,
+                       nfs_param.core_param.max_send_buffer_size,
+                       nfs_param.core_param.max_recv_buffer_size);
 #else
-  udp_xprt[prot] = Svcudp_bufcreate(udp_socket[prot],
-                                    nfs_param.core_param.max_send_buffer_size,
-                                    nfs_param.core_param.max_recv_buffer_size);
+  xprt = Svcudp_bufcreate(sock,
+                          nfs_param.core_param.max_send_buffer_size,
+                          nfs_param.core_param.max_recv_buffer_size);
 #endif
-  if(udp_xprt[prot] == NULL)
+  if(xprt == NULL)
     LogFatal(COMPONENT_DISPATCH,
              "Cannot allocate %s/UDP SVCXPRT", tags[prot]);
 
 #ifdef _USE_TIRPC_IPV6
-  udp_xprt[prot]->xp_netid = Str_Dup(netconfig_udpv6->nc_netid);
-  udp_xprt[prot]->xp_tp    = Str_Dup(netconfig_udpv6->nc_device);
+  xprt->xp_netid = Str_Dup(netconfig_udpv6->nc_netid);
+  xprt->xp_tp    = Str_Dup(netconfig_udpv6->nc_device);
 #endif
+
+  return xprt;
+}
+
+void Create_udp(protos prot)
+{
+  udp_xprt[prot] = Create_udp_xprt(prot, udp_socket[prot]);
 }
 
 void Create_tcp(protos prot)
 {
+#if defined(_USE_TIRPC) && defined(HAVE_SYS_EPOLL_H)
+  int maxrec = NFS_MAX_TCP_RECORD_SIZE;
+#endif
+
 #ifdef _USE_TIRPC
   tcp_xprt[prot] = Svc_vc_create(tcp_socket[prot],
                                  nfs_param.core_param.max_send_buffer_size,
@@ -270,6 +291,12 @@ void Create_tcp(protos prot)
     LogFatal(COMPONENT_DISPATCH,
              "Cannot allocate %s/TCP SVCXPRT", tags[prot]);
 
+#if defined(_USE_TIRPC) && defined(HAVE_SYS_EPOLL_H)
+  /* Connections served by the TCP reactors are non-blocking, a whole record is
+   * buffered before being decoded */
+  SVC_CONTROL(tcp_xprt[prot], SVCSET_CONNMAXREC, &maxrec);
+#endif
+
 #ifdef _USE_TIRPC_IPV6
   if(listen(socket, pdata[prot].bindaddr_udp6.qlen) != 0)
     LogFatal(COMPONENT_DISPATCH,
@@ -528,6 +555,16 @@ void nfs_Init_svc()
                    "Bad udp socket options for %s, error %d (%s)",
                    tags[p], errno, strerror(errno));
 
+#if defined(_USE_TIRPC) && defined(HAVE_SYS_EPOLL_H) && defined(HAVE_RECVMMSG) && defined(SO_REUSEPORT)
+        /* The other UDP receivers bind their own socket to the same port */
+        if(nfs_param.core_param.nb_udp_receiver > 1 &&
+           setsockopt(udp_socket[p],
+                      SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)))
+          LogFatal(COMPONENT_DISPATCH,
+                   "Cannot set SO_REUSEPORT on the udp socket for %s, error %d (%s)",
+                   tags[p], errno, strerror(errno));
+#endif
+
         if(setsockopt(tcp_socket[p],
                       SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)))
           LogFatal(COMPONENT_DISPATCH,
@@ -539,6 +576,14 @@ void nfs_Init_svc()
           LogFatal(COMPONENT_DISPATCH,
                    "Cannot set udp socket for %s as non blocking, error %d (%s)",
                    tags[p], errno, strerror(errno));
+
+#ifdef HAVE_SYS_EPOLL_H
+        /* The edge-triggered dispatcher accepts until accept() fails with EAGAIN */
+        if(fcntl(tcp_socket[p], F_SETFL, FNDELAY) == -1)
+          LogFatal(COMPONENT_DISPATCH,
+                   "Cannot set tcp socket for %s as non blocking, error %d (%s)",
+                   tags[p], errno, strerror(errno));
+#endif
       }
 
   socket_setoptions(tcp_socket[P_NFS]);
@@ -639,74 +684,102 @@ void nfs_Init_svc()
 }                               /* nfs_Init_svc */
 
 /**
- * Selects the smallest request queue,
- * whome the worker is ready and is not garbagging.
+ * select_worker_queue: chooses the worker a decoded request is queued to.
+ *
+ * The requests of a client go to the same worker, chosen by hashing its
+ * address, as long as that worker keeps up: its duplicate request cache and
+ * the entries it works on stay warm for this client. When that worker is not
+ * available or has Affinity_Max_Pending requests waiting, the request goes to
+ * the available worker with the shortest queue. Queue lengths are read without
+ * any lock, idle workers steal what is left behind a slow request anyway.
+ *
+ * @param xprt [IN] the transport the request was received on.
+ *
+ * @return the index of the chosen worker.
+ *
  */
-static unsigned int select_worker_queue()
+static unsigned int select_worker_queue(SVCXPRT *xprt)
 {
   #define NO_VALUE_CHOOSEN  1000000
   unsigned int worker_index = NO_VALUE_CHOOSEN;
-  unsigned int avg_number_pending = NO_VALUE_CHOOSEN;
-  unsigned int total_number_pending = 0;
-
-  static unsigned int counter;
-
+  unsigned int min_pending = NO_VALUE_CHOOSEN;
+  unsigned int nb_worker = nfs_param.core_param.nb_worker;
+  unsigned int preferred = 0;
+  unsigned int len;
   unsigned int i;
-  static unsigned int last;
-  unsigned int cpt = 0;
+  unsigned int cpt;
+  sockaddr_t addr;
   worker_available_rc rc;
 
-  P(lock_worker_selection);
-  counter++;
+  if(copy_xprt_addr(&addr, xprt) == 1)
+    preferred = hash_sockaddr(&addr, IGNORE_PORT) % nb_worker;
 
-  /* Calculate the average queue length if counter is bigger than configured value. */
-  if(counter > nfs_param.core_param.nb_call_before_queue_avg)
-    {
-      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
-        {
-          total_number_pending += workers_data[i].pending_request->nb_entry;
-        }
-      avg_number_pending = total_number_pending / nfs_param.core_param.nb_worker;
-      /* Reset counter. */
-      counter = 0;
-    }
-  V(lock_worker_selection);
+  if(worker_available(preferred,
+                      nfs_param.core_param.nb_affinity_max_pending) == WORKER_AVAILABLE)
+    return preferred;
 
-  /* Choose the queue whose length is smaller than average. */
-      for(i = (last + 1) % nfs_param.core_param.nb_worker, cpt = 0;
-          cpt < nfs_param.core_param.nb_worker;
-          cpt++, i = (i + 1) % nfs_param.core_param.nb_worker)
+  workers_data[preferred].stats.nb_affinity_miss += 1;
+
+  /* Choose the shortest queue, starting after the preferred worker so that
+   * the clients of a busy worker do not all fall back on the same one */
+  for(i = (preferred + 1) % nb_worker, cpt = 0;
+      cpt < nb_worker;
+      cpt++, i = (i + 1) % nb_worker)
+    {
+      /* Choose only fully initialized workers and that does not gc. */
+      rc = worker_available(i, NO_VALUE_CHOOSEN);
+      if(rc == WORKER_AVAILABLE)
         {
-          /* Choose only fully initialized workers and that does not gc. */
-          rc = worker_available(i, avg_number_pending);
-          if(rc == WORKER_AVAILABLE)
+          len = mpmc_queue_length(&workers_data[i].request_queue);
+          if(len < min_pending)
             {
+              min_pending = len;
               worker_index = i;
-              break;
-            }
-          else if(rc == WORKER_ALL_PAUSED)
-            {
-              /* Wait for the threads to awaken */
-              rc = wait_for_workers_to_awaken();
-              /*              if(rc == PAUSE_EXIT)
-                {
-                }
-              */
+              if(len == 0)
+                break;
             }
-          else if(rc == WORKER_EXIT)
-            {
-            } 
         }
+      else if(rc == WORKER_ALL_PAUSED)
+        {
+          /* Wait for the threads to awaken */
+          wait_for_workers_to_awaken();
+        }
+    }
 
   if(worker_index == NO_VALUE_CHOOSEN)
-    worker_index = (last + 1) % nfs_param.core_param.nb_worker;
-
-  last = worker_index;
+    worker_index = preferred;
 
   return worker_index;
-
 }                               /* select_worker_queue */
 
+#ifndef _NO_MOUNT_LIST
+/**
+ * is_mnt_socket: tells if a socket is one of those of the mount protocol.
+ *
+ * @param sock [IN] the socket a request was received on.
+ *
+ * @return TRUE if the request is a mount protocol request, FALSE otherwise.
+ *
+ */
+static int is_mnt_socket(int sock)
+{
+#if defined(_USE_TIRPC) && defined(HAVE_SYS_EPOLL_H) && defined(HAVE_RECVMMSG)
+  unsigned int i;
+#endif
+
+  if(udp_socket[P_MNT] == sock || tcp_socket[P_MNT] == sock)
+    return TRUE;
+
+#if defined(_USE_TIRPC) && defined(HAVE_SYS_EPOLL_H) && defined(HAVE_RECVMMSG)
+  for(i = 1; i < nfs_param.core_param.nb_udp_receiver; i++)
+    if(udp_receiver_socket[i][P_MNT] == sock)
+      return TRUE;
+#endif
+
+  return FALSE;
+}                               /* is_mnt_socket */
+#endif                          /* !_NO_MOUNT_LIST */
+
 /**
  * process_rpc_request: process an RPC request.
  *
@@ -721,37 +794,35 @@ process_status_t process_rpc_request(SVCXPRT *xprt)
   bool_t no_dispatch = TRUE, recv_status;
   nfs_request_data_t *pnfsreq = NULL;
   unsigned int worker_index;
+  unsigned int pool_index;
+  static unsigned int pool_next;
   process_status_t rc = PROCESS_DONE;
+  int is_mnt = FALSE;
+  int recv_errno;
 
   /* A few thread manage only mount protocol, check for this */
-
-  /* Get a worker to do the job */
 #ifndef _NO_MOUNT_LIST
-  if((udp_socket[P_MNT] == xprt->XP_SOCK) ||
-     (tcp_socket[P_MNT] == xprt->XP_SOCK))
-    {
-      /* worker #0 is dedicated to mount protocol */
-      worker_index = 0;
-    }
-  else
+  is_mnt = is_mnt_socket(xprt->XP_SOCK);
 #endif
-    {
-       /* choose a worker depending on its queue length */
-       worker_index = select_worker_queue();
-    }
+
+  /* The worker is chosen once the caller is known, the pools are only
+   * used in turn to spread the contention on their mutexes */
+  if(is_mnt)
+    pool_index = 0;
+  else
+    pool_index = __sync_fetch_and_add(&pool_next, 1) % nfs_param.core_param.nb_worker;
 
   LogFullDebug(COMPONENT_DISPATCH,
-               "Use request from Worker Thread #%u's pool, xprt->xp_sock=%d, thread has %d pending requests",
-               worker_index, xprt->XP_SOCK,
-               workers_data[worker_index].pending_request->nb_entry);
+               "Use request from Worker Thread #%u's pool, xprt->xp_sock=%d",
+               pool_index, xprt->XP_SOCK);
 
   /* Get a pnfsreq from the worker's pool */
-  P(workers_data[worker_index].request_pool_mutex);
+  P(workers_data[pool_index].request_pool_mutex);
 
-  GetFromPool(pnfsreq, &workers_data[worker_index].request_pool,
+  GetFromPool(pnfsreq, &workers_data[pool_index].request_pool,
               nfs_request_data_t);
 
-  V(workers_data[worker_index].request_pool_mutex);
+  V(workers_data[pool_index].request_pool_mutex);
 
   if(pnfsreq == NULL)
     {
@@ -760,6 +831,8 @@ process_status_t process_rpc_request(SVCXPRT *xprt)
       Fatal();
     }
 
+  pnfsreq->pool_index = pool_index;
+
   /* Set up cred area */
   cred_area = pnfsreq->cred_area;
   preq = &(pnfsreq->req);
@@ -781,7 +854,12 @@ process_status_t process_rpc_request(SVCXPRT *xprt)
                "Before calling SVC_RECV on socket %d",
                pnfsreq->xprt->XP_SOCK);
 
+  /* A non-blocking socket with nothing left to read fails with EAGAIN. A listener
+   * out of descriptors fails with EMFILE or ENFILE, it is retried on the next
+   * wakeup so that the other sockets are served meanwhile */
+  errno = 0;
   recv_status = SVC_RECV(pnfsreq->xprt, pmsg);
+  recv_errno = errno;
 
   LogFullDebug(COMPONENT_DISPATCH,
                "Status for SVC_RECV on socket %d is %d, xid=%lu",
@@ -790,7 +868,13 @@ process_status_t process_rpc_request(SVCXPRT *xprt)
 
   /* If status is ok, the request will be processed by the related
    * worker, otherwise, it should be released by being tagged as invalid*/
-  if(!recv_status)
+  if(!recv_status && (recv_errno == EAGAIN || recv_errno == EWOULDBLOCK ||
+                      recv_errno == EMFILE || recv_errno == ENFILE))
+    {
+      rc = PROCESS_DRAINED;
+      goto free_req;
+    }
+  else if(!recv_status)
     {
       /* RPC over TCP specific: RPC/UDP's xprt know only one state: XPRT_IDLE, because UDP is mostly
        * a stateless protocol. With RPC/TCP, they can be XPRT_DIED especially when the client closes
@@ -884,6 +968,18 @@ process_status_t process_rpc_request(SVCXPRT *xprt)
       pnfsreq->xprt = pnfsreq->xprt_copy;
       preq->rq_xprt = pnfsreq->xprt_copy;
 
+      /* Get a worker to do the job */
+      if(is_mnt)
+        {
+          /* worker #0 is dedicated to mount protocol */
+          worker_index = 0;
+        }
+      else
+        {
+          /* prefer the client's worker, unless its queue is too long */
+          worker_index = select_worker_queue(xprt);
+        }
+
       /* Regular management of the request (UDP request or TCP request on connected handler */
       DispatchWork(pnfsreq, worker_index);
 
@@ -911,212 +1007,197 @@ process_status_t process_rpc_request(SVCXPRT *xprt)
 
 free_req:
   /* Release the entry */
-  P(workers_data[worker_index].request_pool_mutex);
-  ReleaseToPool(pnfsreq, &workers_data[worker_index].request_pool);
-  workers_data[worker_index].passcounter += 1;
-  V(workers_data[worker_index].request_pool_mutex);
+  xdr_arena_reset(&pnfsreq->arena);
+  P(workers_data[pool_index].request_pool_mutex);
+  ReleaseToPool(pnfsreq, &workers_data[pool_index].request_pool);
+  workers_data[pool_index].passcounter += 1;
+  V(workers_data[pool_index].request_pool_mutex);
   return rc;
 }
 
 /**
- * nfs_rpc_getreq: Do half of the work done by svc_getreqset.
+ * nfs_rpc_getreq_sock: manages the input waiting on one of the dispatcher's sockets.
  *
- * This function wait for an incoming ONC message by waiting on a 'select' statement. Then getting a request
- * it perform the authentication and extracts the RPC message for the related socket. It then find the less busy
- * worker (the one with the shortest pending queue) and put the msg in this queue.
+ * Finds the SVCXPRT related to the socket and processes the RPC request(s) it
+ * holds. With the epoll based dispatcher, sockets are watched in edge-triggered
+ * mode and are non-blocking: requests are received until the socket reports
+ * EAGAIN.
  *
- * @param readfds File Descriptor Set related to the socket used for RPC management.
+ * @param rpc_sock [IN] the socket with input waiting.
  *
- * @return Nothing (void function), but calls svcerr_* function to notify the client when an error occures.
+ * @return nothing (void function)
  *
  */
-void nfs_rpc_getreq(fd_set * readfds)
+static void nfs_rpc_getreq_sock(int rpc_sock)
 {
   register SVCXPRT *xprt;
-  register int bit;
-  register long mask, *maskp;
-  register int sock;
-  register int rpc_sock;
   process_status_t status;
 
-  /* portable access to fds_bits field */
-  maskp = __FDS_BITS(readfds);
-
-  for(sock = 0; sock < FD_SETSIZE; sock += NFDBITS)
+  xprt = Xports[rpc_sock];
+  if(xprt == NULL)
     {
-      for(mask = *maskp++; (bit = ffs(mask)); mask ^= (1 << (bit - 1)))
-        {
-          /* sock has input waiting */
-          rpc_sock = sock + bit - 1;
+      /* But do we control sock? */
+      LogCrit(COMPONENT_DISPATCH,
+              "CRITICAL ERROR: Incoherency found in Xports array");
+      return;
+    }
 
-          xprt = Xports[rpc_sock];
-          if(xprt == NULL)
-            {
-              /* But do we control sock? */
-              LogCrit(COMPONENT_DISPATCH,
-                      "CRITICAL ERROR: Incoherency found in Xports array");
-              continue;
-            }
+  /*
+   * UDP RPCs are quite simple: everything comes to the same socket, so several SVCXPRT
+   * can be defined, one per tbuf to handle the stuff
+   * TCP RPCs are more complex:
+   *   - a unique SVCXPRT exists that deals with initial tcp rendez vous. It does the accept
+   *     with the client, but recv no message from the client. But SVC_RECV on it creates
+   *     a new SVCXPRT dedicated to the client. This specific SVXPRT is bound on TCPSocket
+   *
+   * while receiving something on the Svc_fdset, I must know if this is a UDP request,
+   * an initial TCP request or a TCP socket from an already connected client.
+   * This is how to distinguish the cases:
+   * UDP connections are bound to socket NFS_UDPSocket
+   * TCP initial connections are bound to socket NFS_TCPSocket
+   * all the other cases are requests from already connected TCP Clients
+   */
 
-          /*
-           * UDP RPCs are quite simple: everything comes to the same socket, so several SVCXPRT
-           * can be defined, one per tbuf to handle the stuff
-           * TCP RPCs are more complex:
-           *   - a unique SVCXPRT exists that deals with initial tcp rendez vous. It does the accept
-           *     with the client, but recv no message from the client. But SVC_RECV on it creates
-           *     a new SVCXPRT dedicated to the client. This specific SVXPRT is bound on TCPSocket
-           *
-           * while receiving something on the Svc_fdset, I must know if this is a UDP request,
-           * an initial TCP request or a TCP socket from an already connected client.
-           * This is how to distinguish the cases:
-           * UDP connections are bound to socket NFS_UDPSocket
-           * TCP initial connections are bound to socket NFS_TCPSocket
-           * all the other cases are requests from already connected TCP Clients
-           */
-
-          if(udp_socket[P_NFS] == rpc_sock)
-            {
-              /* This is a regular UDP connection */
-              LogFullDebug(COMPONENT_DISPATCH, "A NFS UDP request");
-              if(xprt != udp_xprt[P_NFS])
-                LogCrit(COMPONENT_DISPATCH,
-                        "Oops, UDP xprt doesn't match xprt=%p xprt_nfs_udp=%p",
-                        xprt, udp_xprt[P_NFS]);
-              xprt = udp_xprt[P_NFS];
-            }
-          else if(udp_socket[P_MNT] == rpc_sock)
-            {
-              LogFullDebug(COMPONENT_DISPATCH, "A MOUNT UDP request");
-              if(xprt != udp_xprt[P_MNT])
-                LogCrit(COMPONENT_DISPATCH,
-                        "Oops, UDP xprt doesn't match xprt=%p xprt_mnt_udp=%p",
-                        xprt, udp_xprt[P_MNT]);
-              xprt = udp_xprt[P_MNT];
-            }
+  if(udp_socket[P_NFS] == rpc_sock)
+    {
+      /* This is a regular UDP connection */
+      LogFullDebug(COMPONENT_DISPATCH, "A NFS UDP request");
+      if(xprt != udp_xprt[P_NFS])
+        LogCrit(COMPONENT_DISPATCH,
+                "Oops, UDP xprt doesn't match xprt=%p xprt_nfs_udp=%p",
+                xprt, udp_xprt[P_NFS]);
+      xprt = udp_xprt[P_NFS];
+    }
+  else if(udp_socket[P_MNT] == rpc_sock)
+    {
+      LogFullDebug(COMPONENT_DISPATCH, "A MOUNT UDP request");
+      if(xprt != udp_xprt[P_MNT])
+        LogCrit(COMPONENT_DISPATCH,
+                "Oops, UDP xprt doesn't match xprt=%p xprt_mnt_udp=%p",
+                xprt, udp_xprt[P_MNT]);
+      xprt = udp_xprt[P_MNT];
+    }
 #ifdef _USE_NLM
-          else if(udp_socket[P_NLM] == rpc_sock)
-            {
-              LogFullDebug(COMPONENT_DISPATCH, "A NLM UDP request");
-              if(xprt != udp_xprt[P_NLM])
-                LogCrit(COMPONENT_DISPATCH,
-                        "Oops, UDP xprt doesn't match xprt=%p xprt_nlm_udp=%p",
-                        xprt, udp_xprt[P_NLM]);
-              xprt = udp_xprt[P_NLM];
-            }
+  else if(udp_socket[P_NLM] == rpc_sock)
+    {
+      LogFullDebug(COMPONENT_DISPATCH, "A NLM UDP request");
+      if(xprt != udp_xprt[P_NLM])
+        LogCrit(COMPONENT_DISPATCH,
+                "Oops, UDP xprt doesn't match xprt=%p xprt_nlm_udp=%p",
+                xprt, udp_xprt[P_NLM]);
+      xprt = udp_xprt[P_NLM];
+    }
 #endif                          /* _USE_NLM */
 #ifdef _USE_QUOTA
-          else if(udp_socket[P_RQUOTA] == rpc_sock)
-            {
-              LogFullDebug(COMPONENT_DISPATCH, "A RQUOTA UDP request");
-              if(xprt != udp_xprt[P_RQUOTA])
-                LogCrit(COMPONENT_DISPATCH,
-                        "Oops, UDP xprt doesn't match xprt=%p xprt_rquota_udp=%p",
-                        xprt, udp_xprt[P_RQUOTA]);
-              xprt = udp_xprt[P_RQUOTA];
-            }
+  else if(udp_socket[P_RQUOTA] == rpc_sock)
+    {
+      LogFullDebug(COMPONENT_DISPATCH, "A RQUOTA UDP request");
+      if(xprt != udp_xprt[P_RQUOTA])
+        LogCrit(COMPONENT_DISPATCH,
+                "Oops, UDP xprt doesn't match xprt=%p xprt_rquota_udp=%p",
+                xprt, udp_xprt[P_RQUOTA]);
+      xprt = udp_xprt[P_RQUOTA];
+    }
 #endif                          /* _USE_QUOTA */
-          else if(tcp_socket[P_NFS] == rpc_sock)
-            {
-              /*
-               * This is an initial tcp connection
-               * There is no RPC message, this is only a TCP connect.
-               * In this case, the SVC_RECV does only produces a new connected socket (it does
-               * just a call to accept and FD_SET)
-               * there is no need of worker thread processing to be done
-               */
-              LogFullDebug(COMPONENT_DISPATCH,
-                           "An initial NFS TCP request from a new client");
-              if(xprt != tcp_xprt[P_NFS])
-                LogCrit(COMPONENT_DISPATCH,
-                        "Oops, UDP xprt doesn't match xprt=%p xprt_nfs_tcp=%p",
-                        xprt, tcp_xprt[P_NFS]);
-              xprt = tcp_xprt[P_NFS];
-            }
-          else if(tcp_socket[P_MNT] == rpc_sock)
-            {
-              LogFullDebug(COMPONENT_DISPATCH,
-                           "An initial MOUNT TCP request from a new client");
-              if(xprt != tcp_xprt[P_MNT])
-                LogCrit(COMPONENT_DISPATCH,
-                        "Oops, UDP xprt doesn't match xprt=%p xprt_mnt_tcp=%p",
-                        xprt, tcp_xprt[P_MNT]);
-              xprt = tcp_xprt[P_MNT];
-            }
+  else if(tcp_socket[P_NFS] == rpc_sock)
+    {
+      /*
+       * This is an initial tcp connection
+       * There is no RPC message, this is only a TCP connect.
+       * In this case, the SVC_RECV does only produces a new connected socket (it does
+       * just a call to accept and FD_SET)
+       * there is no need of worker thread processing to be done
+       */
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "An initial NFS TCP request from a new client");
+      if(xprt != tcp_xprt[P_NFS])
+        LogCrit(COMPONENT_DISPATCH,
+                "Oops, UDP xprt doesn't match xprt=%p xprt_nfs_tcp=%p",
+                xprt, tcp_xprt[P_NFS]);
+      xprt = tcp_xprt[P_NFS];
+    }
+  else if(tcp_socket[P_MNT] == rpc_sock)
+    {
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "An initial MOUNT TCP request from a new client");
+      if(xprt != tcp_xprt[P_MNT])
+        LogCrit(COMPONENT_DISPATCH,
+                "Oops, UDP xprt doesn't match xprt=%p xprt_mnt_tcp=%p",
+                xprt, tcp_xprt[P_MNT]);
+      xprt = tcp_xprt[P_MNT];
+    }
 #ifdef _USE_NLM
-          else if(tcp_socket[P_NLM] == rpc_sock)
-            {
-              LogFullDebug(COMPONENT_DISPATCH,
-                           "An initial NLM request from a new client");
-              if(xprt != tcp_xprt[P_NLM])
-                LogCrit(COMPONENT_DISPATCH,
-                        "Oops, UDP xprt doesn't match xprt=%p xprt_nlm_tcp=%p",
-                        xprt, tcp_xprt[P_NLM]);
-              xprt = tcp_xprt[P_NLM];
-            }
+  else if(tcp_socket[P_NLM] == rpc_sock)
+    {
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "An initial NLM request from a new client");
+      if(xprt != tcp_xprt[P_NLM])
+        LogCrit(COMPONENT_DISPATCH,
+                "Oops, UDP xprt doesn't match xprt=%p xprt_nlm_tcp=%p",
+                xprt, tcp_xprt[P_NLM]);
+      xprt = tcp_xprt[P_NLM];
+    }
 #endif                          /* _USE_NLM */
 #ifdef _USE_QUOTA
-          else if(tcp_socket[P_RQUOTA] == rpc_sock)
-            {
-              LogFullDebug(COMPONENT_DISPATCH,
-                           "An initial RQUOTA request from a new client");
-              if(xprt != tcp_xprt[P_RQUOTA])
-                LogCrit(COMPONENT_DISPATCH,
-                        "Oops, UDP xprt doesn't match xprt=%p xprt_rquota_tcp=%p",
-                        xprt, tcp_xprt[P_RQUOTA]);
-              xprt = tcp_xprt[P_RQUOTA];
-            }
+  else if(tcp_socket[P_RQUOTA] == rpc_sock)
+    {
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "An initial RQUOTA request from a new client");
+      if(xprt != tcp_xprt[P_RQUOTA])
+        LogCrit(COMPONENT_DISPATCH,
+                "Oops, UDP xprt doesn't match xprt=%p xprt_rquota_tcp=%p",
+                xprt, tcp_xprt[P_RQUOTA]);
+      xprt = tcp_xprt[P_RQUOTA];
+    }
 #endif                          /* _USE_QUOTA */
-          else
-            {
-              /* This is a regular tcp request on an established connection, should be handle by a dedicated thread */
-              LogDebug(COMPONENT_DISPATCH,
-                       "A NFS TCP request from an already connected client");
-            }
-
-          status = process_rpc_request(xprt);
-        }
+  else
+    {
+      /* This is a regular tcp request on an established connection, should be handle by a dedicated thread */
+      LogDebug(COMPONENT_DISPATCH,
+               "A NFS TCP request from an already connected client");
     }
-}                               /* nfs_rpc_getreq */
 
+#ifdef HAVE_SYS_EPOLL_H
+  do
+    status = process_rpc_request(xprt);
+  while(status != PROCESS_LOST_CONN && status != PROCESS_DRAINED);
+#else
+  status = process_rpc_request(xprt);
+#endif
+}                               /* nfs_rpc_getreq_sock */
+
+#ifndef HAVE_SYS_EPOLL_H
 /**
+ * nfs_rpc_getreq: Do half of the work done by svc_getreqset.
  *
- * clean_pending_request: cleans an entry in a nfs request LRU,
- *
- * cleans an entry in a nfs request LRU.
+ * This function wait for an incoming ONC message by waiting on a 'select' statement. Then getting a request
+ * it perform the authentication and extracts the RPC message for the related socket. It then find the less busy
+ * worker (the one with the shortest pending queue) and put the msg in this queue.
  *
- * @param pentry [INOUT] entry to be cleaned.
- * @param addparam [IN] additional parameter used for cleaning.
+ * @param readfds File Descriptor Set related to the socket used for RPC management.
  *
- * @return 0 if ok, other values mean an error.
+ * @return Nothing (void function), but calls svcerr_* function to notify the client when an error occures.
  *
  */
-int clean_pending_request(LRU_entry_t * pentry, void *addparam)
+void nfs_rpc_getreq(fd_set * readfds)
 {
-  struct prealloc_pool *request_pool = (struct prealloc_pool *) addparam;
-  nfs_request_data_t *preqnfs = (nfs_request_data_t *) (pentry->buffdata.pdata);
-
-  /* Send the entry back to the pool */
-  ReleaseToPool(preqnfs, request_pool);
+  register int bit;
+  register long mask, *maskp;
+  register int sock;
 
-  return 0;
-}                               /* clean_pending_request */
+  /* portable access to fds_bits field */
+  maskp = __FDS_BITS(readfds);
 
-/**
- *
- * print_pending_request: prints an entry related to a pending request in the LRU list.
- *
- * prints an entry related to a pending request in the LRU list.
- *
- * @param data [IN] data stored in a LRU entry to be printed.
- * @param str [OUT] string used to store the result.
- *
- * @return 0 if ok, other values mean an error.
- *
- */
-int print_pending_request(LRU_data_t data, char *str)
-{
-  return snprintf(str, LRU_DISPLAY_STRLEN, "not implemented for now");
-}                               /* print_pending_request */
+  for(sock = 0; sock < FD_SETSIZE; sock += NFDBITS)
+    {
+      for(mask = *maskp++; (bit = ffs(mask)); mask ^= (1 << (bit - 1)))
+        {
+          /* sock has input waiting */
+          nfs_rpc_getreq_sock(sock + bit - 1);
+        }
+    }
+}                               /* nfs_rpc_getreq */
+#endif                          /* !HAVE_SYS_EPOLL_H */
 
 /**
  * nfs_rpc_dispatcher_svc_run: the same as svc_run.
@@ -1129,6 +1210,60 @@ int print_pending_request(LRU_data_t data, char *str)
  *
  */
 
+#ifdef HAVE_SYS_EPOLL_H
+void rpc_dispatcher_svc_run()
+{
+  struct epoll_event events[NB_EPOLL_EVENTS_DISPATCHER];
+  int rc = 0;
+  int i;
+
+#ifdef _DEBUG_MEMLEAKS
+  static int nb_iter_memleaks = 0;
+#endif
+
+  while(TRUE)
+    {
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "rpc dispatcher thread waiting for incoming RPC requests");
+
+      /* Wait on the event set build with all socket used in NFS/RPC */
+      rc = epoll_wait(Svc_epollfd, events, NB_EPOLL_EVENTS_DISPATCHER, -1);
+
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "Waiting for incoming RPC requests, after epoll_wait rc=%d",
+                   rc);
+      if(rc == -1)
+        {
+          if(errno == EBADF || errno == EINVAL)
+            {
+              LogCrit(COMPONENT_DISPATCH,
+                      "epoll_wait failed, error %d (%s)", errno, strerror(errno));
+              return;
+            }
+          continue;
+        }
+
+      LogFullDebug(COMPONENT_DISPATCH, "NFS SVC RUN: request(s) received");
+      for(i = 0; i < rc; i++)
+        nfs_rpc_getreq_sock(events[i].data.fd);
+
+#ifdef _DEBUG_MEMLEAKS
+      if(nb_iter_memleaks > 1000)
+        {
+          nb_iter_memleaks = 0;
+#ifndef _NO_BUDDY_SYSTEM
+          nfs_debug_buddy_info();
+#endif
+        }
+      else
+        nb_iter_memleaks += 1;
+#endif
+
+    }                           /* while */
+
+  return;
+}                               /* rpc_dispatcher_svc_run */
+#else
 void rpc_dispatcher_svc_run()
 {
   fd_set readfdset;
@@ -1190,6 +1325,7 @@ void rpc_dispatcher_svc_run()
 
   return;
 }                               /* rpc_dispatcher_svc_run */
+#endif                          /* HAVE_SYS_EPOLL_H */
 
 /**
  * rpc_dispatcher_thread: thread used for RPC dispatching.
@@ -1226,6 +1362,200 @@ void *rpc_dispatcher_thread(void *Arg)
   return NULL;
 }                               /* rpc_dispatcher_thread */
 
+#if defined(_USE_TIRPC) && defined(HAVE_SYS_EPOLL_H) && defined(HAVE_RECVMMSG)
+/**
+ * nfs_Init_udp_receivers: sets up the sockets of the UDP receiver threads.
+ *
+ * Each receiver gets one socket per UDP service: receiver #0 takes over
+ * udp_socket[], the others bind a new socket to the same address with
+ * SO_REUSEPORT, so that the kernel spreads the clients over the receivers.
+ * A client keeps hashing to the same socket, its retransmissions are seen by
+ * the same receiver. The sockets leave the dispatcher's event set and are
+ * read in batches of NB_UDP_RECV_BATCH datagrams.
+ *
+ * Must be called after nfs_Init_svc and before the dispatcher is started.
+ *
+ * @return 0 if successful, -1 otherwise.
+ *
+ */
+int nfs_Init_udp_receivers(void)
+{
+  struct epoll_event ev;
+  struct sockaddr_storage ss;
+  socklen_t slen;
+  SVCXPRT *xprt;
+  unsigned int i;
+  protos p;
+  int sock;
+  int one = 1;
+
+#ifndef SO_REUSEPORT
+  if(nfs_param.core_param.nb_udp_receiver > 1)
+    {
+      LogCrit(COMPONENT_DISPATCH,
+              "SO_REUSEPORT is not available, only one UDP receiver is used");
+      nfs_param.core_param.nb_udp_receiver = 1;
+    }
+#endif
+
+  for(i = 0; i < nfs_param.core_param.nb_udp_receiver; i++)
+    {
+      /* The size is only a hint to the kernel */
+      if((udp_receiver_epollfd[i] = epoll_create(P_COUNT)) == -1)
+        {
+          LogCrit(COMPONENT_DISPATCH,
+                  "Cannot create the epoll set of UDP receiver #%u, errno=%u (%s)",
+                  i, errno, strerror(errno));
+          return -1;
+        }
+
+      for(p = P_NFS; p < P_COUNT; p++)
+        {
+          udp_receiver_socket[i][p] = -1;
+
+          if(udp_socket[p] == -1)
+            continue;
+
+          if(i == 0)
+            {
+              sock = udp_socket[p];
+              xprt = udp_xprt[p];
+            }
+          else
+            {
+#ifdef SO_REUSEPORT
+              slen = sizeof(ss);
+              if(getsockname(udp_socket[p], (struct sockaddr *)&ss, &slen) == -1)
+                {
+                  LogCrit(COMPONENT_DISPATCH,
+                          "Cannot get the address of the %s udp socket, error %d (%s)",
+                          tags[p], errno, strerror(errno));
+                  return -1;
+                }
+
+              if((sock = socket(P_FAMILY, SOCK_DGRAM, IPPROTO_UDP)) == -1)
+                {
+                  LogCrit(COMPONENT_DISPATCH,
+                          "Cannot allocate a udp socket for %s, error %d (%s)",
+                          tags[p], errno, strerror(errno));
+                  return -1;
+                }
+
+              if(setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) ||
+                 setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) ||
+                 fcntl(sock, F_SETFL, FNDELAY) == -1 ||
+                 bind(sock, (struct sockaddr *)&ss, slen) == -1)
+                {
+                  LogCrit(COMPONENT_DISPATCH,
+                          "Cannot bind a new %s udp socket for UDP receiver #%u, error %d (%s)",
+                          tags[p], i, errno, strerror(errno));
+                  close(sock);
+                  return -1;
+                }
+
+              xprt = Create_udp_xprt(p, sock);
+#endif
+            }
+
+          /* Only this receiver reads the socket from now on */
+          Svc_epoll_del(sock);
+
+          if(!Svc_dg_enablebatch(xprt, NB_UDP_RECV_BATCH))
+            {
+              LogCrit(COMPONENT_DISPATCH,
+                      "Cannot allocate the receive batch of %s/UDP for UDP receiver #%u",
+                      tags[p], i);
+              return -1;
+            }
+
+          memset(&ev, 0, sizeof(ev));
+          ev.events = EPOLLIN;
+          ev.data.fd = sock;
+
+          if(epoll_ctl(udp_receiver_epollfd[i], EPOLL_CTL_ADD, sock, &ev) == -1)
+            {
+              LogCrit(COMPONENT_DISPATCH,
+                      "Cannot add socket %d to UDP receiver #%u, errno=%u (%s)",
+                      sock, i, errno, strerror(errno));
+              return -1;
+            }
+
+          udp_receiver_socket[i][p] = sock;
+
+          LogFullDebug(COMPONENT_DISPATCH,
+                       "%s/UDP socket %d is read by UDP receiver #%u", tags[p], sock, i);
+        }
+    }
+
+  return 0;
+}                               /* nfs_Init_udp_receivers */
+
+/**
+ * rpc_udp_receiver_thread: serves the UDP sockets of one receiver.
+ *
+ * Waits for datagrams on the sockets of its epoll set. SVC_RECV fetches a
+ * whole batch with one recvmmsg and decodes its datagrams one at a time,
+ * SVC_STAT tells XPRT_MOREREQS until the batch is used up. The sockets are
+ * watched in level-triggered mode, what is left in a socket after a batch is
+ * reported again by the next epoll_wait.
+ *
+ * @param IndexArg the index of the receiver, cast to a pointer.
+ *
+ * @return Pointer to the result (but this function will mostly loop forever).
+ *
+ */
+void *rpc_udp_receiver_thread(void *IndexArg)
+{
+  long int index = (long int)IndexArg;
+  char my_name[MAXNAMLEN];
+  struct epoll_event events[P_COUNT];
+  SVCXPRT *xprt;
+  int nb_events;
+  int i;
+
+  snprintf(my_name, MAXNAMLEN, "udp_receiver#%ld", index);
+  SetNameFunction(my_name);
+
+#ifndef _NO_BUDDY_SYSTEM
+  if(BuddyInit(&nfs_param.buddy_param_worker) != BUDDY_SUCCESS)
+    LogFatal(COMPONENT_DISPATCH,
+             "Memory manager could not be initialized");
+#endif
+
+  LogDebug(COMPONENT_DISPATCH,
+           "Starting with pthread id #%p",
+           (caddr_t) pthread_self());
+
+  for(;;)
+    {
+      nb_events = epoll_wait(udp_receiver_epollfd[index], events, P_COUNT, -1);
+      if(nb_events == -1)
+        {
+          if(errno == EINTR)
+            continue;
+
+          /* The clients hashed to this receiver would no longer be served */
+          LogFatal(COMPONENT_DISPATCH,
+                   "epoll_wait failed in UDP receiver #%ld, errno=%u (%s)",
+                   index, errno, strerror(errno));
+        }
+
+      for(i = 0; i < nb_events; i++)
+        {
+          xprt = Xports[events[i].data.fd];
+          if(xprt == NULL)
+            continue;
+
+          do
+            (void)process_rpc_request(xprt);
+          while(SVC_STAT(xprt) == XPRT_MOREREQS);
+        }
+    }
+
+  return NULL;
+}                               /* rpc_udp_receiver_thread */
+#endif                          /* _USE_TIRPC && HAVE_SYS_EPOLL_H && HAVE_RECVMMSG */
+
 /**
  * constructor_nfs_request_data_t: Constructor for a nfs_request_data_t structure
  *
@@ -1244,4 +1574,5 @@ void constructor_nfs_request_data_t(void *ptr)
 
   memset(pdata, 0, sizeof(*pdata));
   pdata->xprt_copy = Svcxprt_copycreate();
+  xdr_arena_init(&pdata->arena, (char *)pdata->arena_buf, sizeof(pdata->arena_buf));
 }
@@ -33,6 +33,10 @@
  * nfs_rpc_dispatcher.c : The file that contain the 'rpc_tcp_socket_manager_thread.c' routine for the nfsd (and all
  * the related stuff).
  *
+ * With TIRPC, when epoll is available, connected TCP clients are not given a thread of their own:
+ * they are spread over a small pool of reactor threads (see rpc_tcp_reactor_thread),
+ * each one watching its connections through its own epoll set.
+ *
  */
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -44,10 +48,14 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <pthread.h>
 #include <fcntl.h>
 #include <sys/file.h>           /* for having FNDELAY */
 #include <sys/select.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 #include "HashData.h"
 #include "HashTable.h"
 #include "rpc.h"
@@ -180,3 +188,180 @@ void *rpc_tcp_socket_manager_thread(void *Arg)
 
   return NULL;
 }                               /* rpc_tcp_socket_manager_thread */
+
+#if defined(_USE_TIRPC) && defined(HAVE_SYS_EPOLL_H)
+
+/* One epoll set per reactor thread */
+static int tcp_reactor_epollfd[NB_MAX_TCP_REACTOR_THREAD];
+
+/* Next reactor to be given a connection. Only the dispatcher registers connections */
+static unsigned int tcp_reactor_next = 0;
+
+/* Generation of the connection registered on each socket. An event carries the
+ * generation of its connection, so an event still pending for a closed
+ * connection is not taken for the next connection on the same socket */
+static unsigned int *tcp_reactor_gen = NULL;
+static unsigned int tcp_reactor_next_gen = 0;
+
+#define REACTOR_EVENT(sock, gen) (((uint64_t)(gen) << 32) | (uint32_t)(sock))
+#define REACTOR_EVENT_SOCK(data) ((int)((data) & 0xFFFFFFFF))
+#define REACTOR_EVENT_GEN(data) ((unsigned int)((data) >> 32))
+
+/**
+ * nfs_Init_tcp_reactors: creates the epoll sets of the TCP reactor threads.
+ *
+ * Must be called before the dispatcher accepts its first connection.
+ *
+ * @return 0 if successful, -1 otherwise.
+ *
+ */
+int nfs_Init_tcp_reactors(void)
+{
+  unsigned int i;
+
+  tcp_reactor_gen = (unsigned int *)Mem_Alloc_Label(nfs_param.core_param.nb_max_fd *
+                                                    sizeof(unsigned int),
+                                                    "tcp_reactor_gen");
+  if(tcp_reactor_gen == NULL)
+    {
+      LogCrit(COMPONENT_DISPATCH,
+              "Cannot allocate the connection generations of the TCP reactors");
+      return -1;
+    }
+  memset(tcp_reactor_gen, 0, nfs_param.core_param.nb_max_fd * sizeof(unsigned int));
+
+  for(i = 0; i < nfs_param.core_param.nb_tcp_reactor; i++)
+    {
+      /* The size is only a hint to the kernel */
+      if((tcp_reactor_epollfd[i] = epoll_create(NB_EPOLL_EVENTS_REACTOR)) == -1)
+        {
+          LogCrit(COMPONENT_DISPATCH,
+                  "Cannot create the epoll set of TCP reactor #%u, errno=%u (%s)",
+                  i, errno, strerror(errno));
+          return -1;
+        }
+    }
+
+  return 0;
+}                               /* nfs_Init_tcp_reactors */
+
+/**
+ * rpc_tcp_reactor_register: hands a connected TCP client over to a reactor thread.
+ *
+ * Connections are given to the reactors in turn. The socket is watched in
+ * level-triggered mode: each readiness event leads to one call to
+ * process_rpc_request, a socket with more input pending is reported again by the
+ * next epoll_wait. A connection is only ever served by the reactor it belongs to,
+ * so SVC_RECV is never called concurrently on the same SVCXPRT, and only that
+ * reactor destroys it (Svc_clean_idle shuts the socket down instead). The socket
+ * leaves the epoll set by itself when SVC_DESTROY closes it.
+ *
+ * @param tcp_sock [IN] the connected socket, already registered in Xports.
+ *
+ * @return 0 if successful, -1 otherwise.
+ *
+ */
+int rpc_tcp_reactor_register(int tcp_sock)
+{
+  struct epoll_event ev;
+  unsigned int reactor;
+
+  reactor = tcp_reactor_next;
+  tcp_reactor_next = (tcp_reactor_next + 1) % nfs_param.core_param.nb_tcp_reactor;
+
+  /* The new generation is visible before the first event of the connection */
+  tcp_reactor_gen[tcp_sock] = ++tcp_reactor_next_gen;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.u64 = REACTOR_EVENT(tcp_sock, tcp_reactor_gen[tcp_sock]);
+
+  if(epoll_ctl(tcp_reactor_epollfd[reactor], EPOLL_CTL_ADD, tcp_sock, &ev) == -1)
+    {
+      LogCrit(COMPONENT_DISPATCH,
+              "Cannot add socket %d to TCP reactor #%u, errno=%u (%s)",
+              tcp_sock, reactor, errno, strerror(errno));
+      return -1;
+    }
+
+  LogFullDebug(COMPONENT_DISPATCH,
+               "Socket %d is managed by TCP reactor #%u", tcp_sock, reactor);
+  return 0;
+}                               /* rpc_tcp_reactor_register */
+
+/**
+ * rpc_tcp_reactor_thread: serves the TCP clients given to one reactor.
+ *
+ * Waits for input on the connections of its epoll set and processes the requests
+ * as they come. Sockets are non-blocking, a partially received record is kept in
+ * the SVCXPRT until the rest of it arrives.
+ *
+ * @param IndexArg the index of the reactor, cast to a pointer.
+ *
+ * @return Pointer to the result (but this function will mostly loop forever).
+ *
+ */
+void *rpc_tcp_reactor_thread(void *IndexArg)
+{
+#ifndef _NO_BUDDY_SYSTEM
+  int rc = 0;
+#endif
+  long int index = (long int)IndexArg;
+  char my_name[MAXNAMLEN];
+  struct epoll_event events[NB_EPOLL_EVENTS_REACTOR];
+  int nb_events;
+  int tcp_sock;
+  int i;
+
+  snprintf(my_name, MAXNAMLEN, "tcp_reactor#%ld", index);
+  SetNameFunction(my_name);
+
+#ifndef _NO_BUDDY_SYSTEM
+  if((rc = BuddyInit(&nfs_param.buddy_param_tcp_mgr)) != BUDDY_SUCCESS)
+    {
+      /* Failed init */
+      LogFatal(COMPONENT_DISPATCH, "Memory manager could not be initialized");
+    }
+#endif
+
+  LogDebug(COMPONENT_DISPATCH,
+           "Starting with pthread id #%p",
+           (caddr_t) pthread_self());
+
+  for(;;)
+    {
+      nb_events = epoll_wait(tcp_reactor_epollfd[index], events,
+                             NB_EPOLL_EVENTS_REACTOR, -1);
+      if(nb_events == -1)
+        {
+          if(errno == EINTR)
+            continue;
+
+          /* The connections of this reactor would no longer be served */
+          LogFatal(COMPONENT_DISPATCH,
+                   "epoll_wait failed in TCP reactor #%ld, errno=%u (%s)",
+                   index, errno, strerror(errno));
+        }
+
+      for(i = 0; i < nb_events; i++)
+        {
+          tcp_sock = REACTOR_EVENT_SOCK(events[i].data.u64);
+
+          /* The connection may have been closed by an earlier event of this
+           * batch, and its socket reused by a new connection */
+          if(tcp_reactor_gen[tcp_sock] != REACTOR_EVENT_GEN(events[i].data.u64) ||
+             Xports[tcp_sock] == NULL)
+            continue;
+
+          LogFullDebug(COMPONENT_DISPATCH,
+                       "A NFS TCP request from an already connected client on socket %d",
+                       tcp_sock);
+
+          (void)process_rpc_request(Xports[tcp_sock]);
+        }
+    }
+
+  return NULL;
+}                               /* rpc_tcp_reactor_thread */
+
+#endif                          /* _USE_TIRPC && HAVE_SYS_EPOLL_H */
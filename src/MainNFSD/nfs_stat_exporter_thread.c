@@ -68,6 +68,8 @@
 
 #define BACKLOG 10
 
+#define STAT_BUFFER_SIZE 65536
+
 #define  CONF_STAT_EXPORTER_LABEL  "STAT_EXPORTER"
 #define STRCMP   strcasecmp
 
@@ -420,6 +422,168 @@ int write_stats(char *stat_buf, int num_cmds, char **function_names, nfs_request
   return rc;
 }
 
+/* Percentiles written after the count by write_latency_stat */
+static double latency_percentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+#define NB_LATENCY_PERCENTILES (sizeof(latency_percentiles) / sizeof(double))
+
+/**
+ *
+ * write_latency_stat: appends a histogram's percentiles to the stat buffer.
+ *
+ * Appends "_name_ count p50 p90 p99 p999 max", latencies being in microseconds.
+ *
+ * @param stat_buf [INOUT] the buffer, nul terminated, of STAT_BUFFER_SIZE bytes
+ * @param name     [IN]    the name of the call, the part after the first '_' is used
+ * @param phisto   [IN]    the merged histogram
+ *
+ * @return ERR_STAT_NO_ERROR, or ERR_STAT_ERROR if the buffer is full.
+ *
+ */
+static int write_latency_stat(char *stat_buf, char *name, nfs_latency_histogram_t * phisto)
+{
+  unsigned long long total = nfs_latency_total(phisto);
+  size_t len = strlen(stat_buf);
+  char *call = NULL;
+  unsigned int i;
+  int rc;
+
+  if((call = strchr(name, '_')) != NULL)
+    call += 1;
+  else
+    call = name;
+
+  rc = snprintf(stat_buf + len, STAT_BUFFER_SIZE - len, "%s_%s_ %llu",
+                (len == 0) ? "" : " ", call, total);
+
+  for(i = 0; i < NB_LATENCY_PERCENTILES && rc > 0; i++)
+    {
+      len += rc;
+      if(len >= STAT_BUFFER_SIZE)
+        break;
+      rc = snprintf(stat_buf + len, STAT_BUFFER_SIZE - len, " %u",
+                    nfs_latency_percentile(phisto, total, latency_percentiles[i]));
+    }
+
+  if(len < STAT_BUFFER_SIZE && rc > 0)
+    {
+      len += rc;
+      if(len < STAT_BUFFER_SIZE)
+        len += snprintf(stat_buf + len, STAT_BUFFER_SIZE - len, " %u",
+                        nfs_latency_max(phisto));
+    }
+
+  if(len >= STAT_BUFFER_SIZE)
+    {
+      LogCrit(COMPONENT_MAIN, "Error: latency statistics do not fit in the stat buffer.");
+      return ERR_STAT_ERROR;
+    }
+
+  return ERR_STAT_NO_ERROR;
+}                               /* write_latency_stat */
+
+/**
+ *
+ * merge_latency_stats: writes the latencies of every call of an NFS version.
+ *
+ * Merges the histograms of all the workers, one call at a time, and writes them.
+ * For NFSv4, the COMPOUND sub-operations that were used follow the COMPOUND itself.
+ *
+ * @param stat_buf     [INOUT] the buffer, of STAT_BUFFER_SIZE bytes
+ * @param nfs_version  [IN]    the NFS version (3 or 4)
+ * @param workers_data [IN]    the workers
+ *
+ * @return ERR_STAT_NO_ERROR if successful, ERR_STAT_ERROR otherwise.
+ *
+ */
+static int merge_latency_stats(char *stat_buf, int nfs_version,
+                               nfs_worker_data_t *workers_data)
+{
+  nfs_latency_histogram_t histo;
+  nfs_latency_stat_t *platency;
+  unsigned int i, j;
+  int rc = ERR_STAT_NO_ERROR;
+
+  if(nfs_version != 3 && nfs_version != 4)
+    {
+      LogCrit(COMPONENT_MAIN, "Error: no latency statistics for NFS version %d.",
+              nfs_version);
+      return ERR_STAT_ERROR;
+    }
+
+  for(j = 0; j < (nfs_version == 3 ? NFS_V3_NB_COMMAND : NFS_V4_NB_COMMAND); j++)
+    {
+      memset(&histo, 0, sizeof(histo));
+      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+        if((platency = workers_data[i].stats.stat_req.platency) != NULL)
+          nfs_latency_merge(&histo, nfs_version == 3 ? &platency->nfs3[j]
+                                                     : &platency->nfs4[j]);
+
+      rc = write_latency_stat(stat_buf, nfs_version == 3 ? nfsv3_function_names[j]
+                                                         : nfsv4_function_names[j], &histo);
+      if(rc != ERR_STAT_NO_ERROR)
+        return rc;
+    }
+
+  if(nfs_version == 3)
+    return rc;
+
+  for(j = 0; j < NFS_V4_NB_OP_NUMBER; j++)
+    {
+      memset(&histo, 0, sizeof(histo));
+      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+        if((platency = workers_data[i].stats.stat_req.platency) != NULL)
+          nfs_latency_merge(&histo, &platency->nfs4_op[j]);
+
+      /* The sub-operations a client never used are not worth a line */
+      if(nfs_latency_total(&histo) == 0)
+        continue;
+
+      if((rc = write_latency_stat(stat_buf, nfsv4_op_names[j], &histo)) != ERR_STAT_NO_ERROR)
+        return rc;
+    }
+
+  return rc;
+}                               /* merge_latency_stats */
+
+/**
+ *
+ * merge_share_latency_stats: writes the latencies of every export.
+ *
+ * Each export is written as "_<export id>_ count p50 p90 p99 p999 max". NFSv2 and NFSv3
+ * requests are accounted as a whole, NFSv4 COMPOUND sub-operations one by one on the
+ * export of their current filehandle.
+ *
+ * @param stat_buf [INOUT] the buffer, of STAT_BUFFER_SIZE bytes
+ *
+ * @return ERR_STAT_NO_ERROR if successful, ERR_STAT_ERROR otherwise.
+ *
+ */
+static int merge_share_latency_stats(char *stat_buf)
+{
+  nfs_latency_histogram_t histo;
+  nfs_latency_histogram_t **shards;
+  exportlist_t *pexport;
+  char name[32];
+  unsigned int i;
+  int rc = ERR_STAT_NO_ERROR;
+
+  for(pexport = nfs_param.pexportlist; pexport != NULL; pexport = pexport->next)
+    {
+      memset(&histo, 0, sizeof(histo));
+      if((shards = pexport->latency_shards) != NULL)
+        for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+          if(shards[i] != NULL)
+            nfs_latency_merge(&histo, shards[i]);
+
+      snprintf(name, sizeof(name), "export_%u", pexport->id);
+      if((rc = write_latency_stat(stat_buf, name, &histo)) != ERR_STAT_NO_ERROR)
+        return rc;
+    }
+
+  return rc;
+}                               /* merge_share_latency_stats */
+
 int merge_nfs_stats(char *stat_buf, nfs_stat_client_req_t *stat_client_req,
                     nfs_worker_stat_t *global_data, nfs_worker_data_t *workers_data)
 {
@@ -431,6 +595,12 @@ int merge_nfs_stats(char *stat_buf, nfs_stat_client_req_t *stat_client_req,
   nfs_request_stat_item_t *workers_stat_items[nfs_param.core_param.nb_worker];
   char **function_names = NULL;
 
+  /* Latencies are kept in histograms, not in the request stat items */
+  if(stat_client_req->stat_type == PER_SERVER_LATENCY)
+    return merge_latency_stats(stat_buf, stat_client_req->nfs_version, workers_data);
+  else if(stat_client_req->stat_type == PER_SHARE_LATENCY)
+    return merge_share_latency_stats(stat_buf);
+
   switch(stat_client_req->nfs_version)
     {
       case 2:
@@ -511,7 +681,8 @@ int process_stat_request(void *addr, int new_fd)
 
   char cmd_buf[4096];
 
-  char stat_buf[4096];
+  /* Requests are served one at a time by the stat exporter thread */
+  static char stat_buf[STAT_BUFFER_SIZE];
   char *token = NULL;
   char *key = NULL;
   char *value = NULL;
@@ -550,15 +721,23 @@ int process_stat_request(void *addr, int new_fd)
           {
             stat_client_req.stat_type = PER_SERVER_DETAIL;
           }
+        else if(strcmp(value, "latency") == 0)
+          {
+            stat_client_req.stat_type = PER_SERVER_LATENCY;
+          }
+        else if(strcmp(value, "share_latency") == 0)
+          {
+            stat_client_req.stat_type = PER_SHARE_LATENCY;
+          }
       }
     }
 
     token = strtok_r(NULL, ",", &saveptr1);
   }
 
-  memset(stat_buf, 0, 4096);
+  memset(stat_buf, 0, STAT_BUFFER_SIZE);
   merge_nfs_stats(stat_buf, &stat_client_req, &global_worker_stat, workers_data);
-  if((rc = send(new_fd, stat_buf, 4096, 0)) == -1)
+  if((rc = send(new_fd, stat_buf, strlen(stat_buf) + 1, 0)) == -1)
     LogError(COMPONENT_MAIN, ERR_SYS, errno, rc);
 
   close(new_fd);
@@ -58,6 +58,27 @@ char *nfsv4_function_names[] = {
   "NFSv4_null", "NFSv4_compound"
 };
 
+/* Indexed by operation number, operations 0 to 2 do not exist */
+char *nfsv4_op_names[] = {
+  "NFSv4_op0", "NFSv4_op1", "NFSv4_op2", "NFSv4_access",
+  "NFSv4_close", "NFSv4_commit", "NFSv4_create", "NFSv4_delegpurge",
+  "NFSv4_delegreturn", "NFSv4_getattr", "NFSv4_getfh", "NFSv4_link",
+  "NFSv4_lock", "NFSv4_lockt", "NFSv4_locku", "NFSv4_lookup",
+  "NFSv4_lookupp", "NFSv4_nverify", "NFSv4_open", "NFSv4_openattr",
+  "NFSv4_open-confirm", "NFSv4_open-downgrade", "NFSv4_putfh", "NFSv4_putpubfh",
+  "NFSv4_putrootfh", "NFSv4_read", "NFSv4_readdir", "NFSv4_readlink",
+  "NFSv4_remove", "NFSv4_rename", "NFSv4_renew", "NFSv4_restorefh",
+  "NFSv4_savefh", "NFSv4_secinfo", "NFSv4_setattr", "NFSv4_setclientid",
+  "NFSv4_setclientid-confirm", "NFSv4_verify", "NFSv4_write",
+  "NFSv4_release-lockowner", "NFSv4_backchannel-ctl", "NFSv4_bind-conn-to-session",
+  "NFSv4_exchange-id", "NFSv4_create-session", "NFSv4_destroy-session",
+  "NFSv4_free-stateid", "NFSv4_get-dir-delegation", "NFSv4_getdeviceinfo",
+  "NFSv4_getdevicelist", "NFSv4_layoutcommit", "NFSv4_layoutget",
+  "NFSv4_layoutreturn", "NFSv4_secinfo-no-name", "NFSv4_sequence",
+  "NFSv4_set-ssv", "NFSv4_test-stateid", "NFSv4_want-delegation",
+  "NFSv4_destroy-clientid", "NFSv4_reclaim-complete"
+};
+
 char *mnt_function_names[] = {
   "MNT_null", "MNT_mount", "MNT_dump", "MNT_umount", "MNT_umountall", "MNT_export"
 };
@@ -462,8 +483,7 @@ static int get_pending(snmp_adm_type_union * param, void *opt_arg)
   for(i = 0; i < nfs_param.core_param.nb_worker; i++)
     {
       len_pending_request =
-          workers_data[i].pending_request->nb_entry -
-          workers_data[i].pending_request->nb_invalid;
+          mpmc_queue_length(&workers_data[i].request_queue);
 
       if((len_pending_request < min_pending_request)
          || (min_pending_request == MIN_NOT_SET))
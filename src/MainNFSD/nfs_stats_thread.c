@@ -100,6 +100,8 @@ void *stats_thread(void *addr)
   unsigned int total_pending_request;
   unsigned int average_pending_request;
   unsigned int len_pending_request = 0;
+  unsigned int total_steal;
+  unsigned int total_affinity_miss;
 
   unsigned int avg_latency;
 
@@ -569,8 +571,7 @@ void *stats_thread(void *addr)
 
           /* Computing the pending request stats */
           len_pending_request =
-              workers_data[i].pending_request->nb_entry -
-              workers_data[i].pending_request->nb_invalid;
+              mpmc_queue_length(&workers_data[i].request_queue);
 
           if(len_pending_request < min_pending_request)
             min_pending_request = len_pending_request;
@@ -597,6 +598,26 @@ void *stats_thread(void *addr)
               total_pending_request,
               min_pending_request, max_pending_request, average_pending_request);
 
+      /* Per worker queue depth (current and highest), steals and affinity misses */
+      total_steal = 0;
+      total_affinity_miss = 0;
+      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+        {
+          total_steal += workers_data[i].stats.nb_steal;
+          total_affinity_miss += workers_data[i].stats.nb_affinity_miss;
+        }
+
+      fprintf(stats_file, "WORKER QUEUES,%s;%u,%u", strdate, total_steal,
+              total_affinity_miss);
+      for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+        fprintf(stats_file, "|%u,%u,%u,%u,%u",
+                mpmc_queue_length(&workers_data[i].request_queue),
+                workers_data[i].stats.max_pending,
+                workers_data[i].stats.nb_steal,
+                workers_data[i].stats.nb_stolen,
+                workers_data[i].stats.nb_affinity_miss);
+      fprintf(stats_file, "\n");
+
       fprintf(stats_file, "MNT V1 REQUEST,%s;%u", strdate,
               global_worker_stat.stat_req.nb_mnt1_req);
       for(j = 0; j < MNT_V1_NB_COMMAND; j++)
@@ -84,6 +84,9 @@ nfs_worker_data_t *workers_data;
 unsigned int nb_current_gc_workers;
 pthread_mutex_t lock_nb_current_gc_workers;
 
+/* Number of workers with is_idle set, spares DispatchWork a scan when none is */
+static volatile unsigned int nb_idle_workers;
+
 const nfs_function_desc_t invalid_funcdesc =
   {nfs_Null, nfs_Null_Free, (xdrproc_t) xdr_void, (xdrproc_t) xdr_void, "invalid_function",
    NOTHING_SPECIAL};
@@ -638,6 +641,7 @@ int nfs_rpc_get_args(nfs_request_data_t * preqnfs, const nfs_function_desc_t *pf
 {
   SVCXPRT *ptr_svc = preqnfs->xprt;
   nfs_arg_t *parg_nfs = &preqnfs->arg_nfs;
+  bool_t rc;
 
   memset(parg_nfs, 0, sizeof(nfs_arg_t));
 
@@ -645,7 +649,12 @@ int nfs_rpc_get_args(nfs_request_data_t * preqnfs, const nfs_function_desc_t *pf
                "Before svc_getargs on socket %d, xprt=%p",
                ptr_svc->XP_SOCK, ptr_svc);
 
-  if(svc_getargs(ptr_svc, pfuncdesc->xdr_decode_func, (caddr_t) parg_nfs) == FALSE)
+  /* The variable length fields of the arguments are carved from the arena */
+  xdr_arena_set_current(&preqnfs->arena);
+  rc = svc_getargs(ptr_svc, pfuncdesc->xdr_decode_func, (caddr_t) parg_nfs);
+  xdr_arena_set_current(NULL);
+
+  if(rc == FALSE)
     {
       struct svc_req *ptr_req = &preqnfs->req;
       LogMajor(COMPONENT_DISPATCH,
@@ -658,6 +667,28 @@ int nfs_rpc_get_args(nfs_request_data_t * preqnfs, const nfs_function_desc_t *pf
   return TRUE;
 }
 
+/*
+ * Free RPC argument. What was carved from the arena of the request is given
+ * back when the request is released.
+ */
+static void nfs_rpc_free_args(nfs_request_data_t * preqnfs,
+                              const nfs_function_desc_t *pfuncdesc)
+{
+  if(preqnfs->req.rq_vers != 2 && preqnfs->req.rq_vers != 3 && preqnfs->req.rq_vers != 4)
+    return;
+
+  xdr_arena_set_current(&preqnfs->arena);
+
+  if(!SVC_FREEARGS(preqnfs->xprt, pfuncdesc->xdr_decode_func, (caddr_t) & preqnfs->arg_nfs))
+    {
+      LogCrit(COMPONENT_DISPATCH,
+              "NFS DISPATCHER: FAILURE: Bad SVC_FREEARGS for %s",
+              pfuncdesc->funcname);
+    }
+
+  xdr_arena_set_current(NULL);
+}
+
 /**
  * nfs_rpc_execute: main rpc dispatcher routine
  *
@@ -678,7 +709,6 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
   nfs_arg_t *parg_nfs = &preqnfs->arg_nfs;
   nfs_res_t res_nfs;
   short exportid;
-  LRU_list_t *lru_dupreq = NULL;
   struct svc_req *ptr_req = &preqnfs->req;
   SVCXPRT *ptr_svc = preqnfs->xprt;
   nfs_stat_type_t stat_type;
@@ -701,9 +731,6 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
   struct timeval timer_diff;
   nfs_request_latency_stat_t latency_stat;
 
-  /* Get the value from the worker data */
-  lru_dupreq = pworker_data->duplicate_request;
-
   /* initializing RPC structure */
   memset(&res_nfs, 0, sizeof(res_nfs));
 
@@ -736,57 +763,58 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                rpcxid);
     }
 
+  /* Idempotent requests are simply processed again when retransmitted */
   do_dupreq_cache = pworker_data->pfuncdesc->dispatch_behaviour & CAN_BE_DUP;
   LogFullDebug(COMPONENT_DISPATCH, "do_dupreq_cache = %d", do_dupreq_cache);
-  status = nfs_dupreq_add_not_finished(rpcxid,
-                                       ptr_req,
-                                       preqnfs->xprt,
-                                       &pworker_data->dupreq_pool,
-                                       &res_nfs);
+  if(do_dupreq_cache)
+    status = nfs_dupreq_add_not_finished(rpcxid,
+                                         ptr_req,
+                                         preqnfs->xprt,
+                                         &res_nfs);
+  else
+    status = DUPREQ_NOT_CACHED;
   switch(status)
     {
       /* a new request, continue processing it */
     case DUPREQ_SUCCESS:
       LogFullDebug(COMPONENT_DISPATCH, "Current request is not duplicate.");
       break;
-      /* Found the reuqest in the dupreq cache. It's an old request so resend old reply. */
-    case DUPREQ_ALREADY_EXISTS:
-      if(do_dupreq_cache)
-        {
-          /* Request was known, use the previous reply */
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "NFS DISPATCHER: DupReq Cache Hit: using previous reply, rpcxid=%u",
-                       rpcxid);
 
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "Before svc_sendreply on socket %d (dup req)",
-                       ptr_svc->XP_SOCK);
+      /* a request that is not to be cached, or that the client cache can't hold */
+    case DUPREQ_NOT_CACHED:
+      do_dupreq_cache = FALSE;
+      break;
 
-          P(mutex_cond_xprt[ptr_svc->XP_SOCK]);
+      /* Found the reuqest in the dupreq cache. It's an old request so resend old reply. */
+    case DUPREQ_ALREADY_EXISTS:
+      /* Request was known, use the previous reply */
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "NFS DISPATCHER: DupReq Cache Hit: using previous reply, rpcxid=%u",
+                   rpcxid);
 
-          if(svc_sendreply
-             (ptr_svc, pworker_data->pfuncdesc->xdr_encode_func, (caddr_t) & res_nfs) == FALSE)
-            {
-              LogDebug(COMPONENT_DISPATCH,
-                       "NFS DISPATCHER: FAILURE: Error while calling svc_sendreply");
-              svcerr_systemerr(ptr_svc);
-            }
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "Before svc_sendreply on socket %d (dup req)",
+                   ptr_svc->XP_SOCK);
 
-          V(mutex_cond_xprt[ptr_svc->XP_SOCK]);
+      P(mutex_cond_xprt[ptr_svc->XP_SOCK]);
 
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "After svc_sendreply on socket %d (dup req)",
-                       ptr_svc->XP_SOCK);
-          return;
-        }
-      else
+      if(svc_sendreply
+         (ptr_svc, pworker_data->pfuncdesc->xdr_encode_func, (caddr_t) & res_nfs) == FALSE)
         {
-          LogCrit(COMPONENT_DISPATCH,
-                  "Error: Duplicate request rejected because it was found in the cache but is not allowed to be cached.");
+          LogDebug(COMPONENT_DISPATCH,
+                   "NFS DISPATCHER: FAILURE: Error while calling svc_sendreply");
           svcerr_systemerr(ptr_svc);
-          return;
         }
-      break;
+
+      V(mutex_cond_xprt[ptr_svc->XP_SOCK]);
+
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "After svc_sendreply on socket %d (dup req)",
+                   ptr_svc->XP_SOCK);
+
+      /* The entry was held while its reply was resent */
+      nfs_dupreq_finish(rpcxid, ptr_req, preqnfs->xprt, &res_nfs);
+      return;
 
       /* Another thread owns the request */
     case DUPREQ_BEING_PROCESSED:
@@ -794,13 +822,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                    "Dupreq xid=%u was asked for process since another thread manage it, reject for avoiding threads starvation...",
                    rpcxid);
       /* Free the arguments */
-      if(preqnfs->req.rq_vers == 2 || preqnfs->req.rq_vers == 3 || preqnfs->req.rq_vers == 4)
-        if(!SVC_FREEARGS(ptr_svc, pworker_data->pfuncdesc->xdr_decode_func, (caddr_t) parg_nfs))
-          {
-            LogCrit(COMPONENT_DISPATCH,
-                    "NFS DISPATCHER: FAILURE: Bad SVC_FREEARGS for %s",
-                    pworker_data->pfuncdesc->funcname);
-          }
+      nfs_rpc_free_args(preqnfs, pworker_data->pfuncdesc);
       /* Ignore the request, send no error */
       return;
 
@@ -867,8 +889,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                     }
                   /* Bad argument */
                   svcerr_auth(ptr_svc, AUTH_FAILED);
-                  if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                        &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+                  if (do_dupreq_cache &&
+                      nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                     {
                       LogCrit(COMPONENT_DISPATCH,
                               "Attempt to delete duplicate request failed on line %d",
@@ -917,8 +939,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                     }
                   /* Bad argument */
                   svcerr_auth(ptr_svc, AUTH_FAILED);
-                  if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                        &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+                  if (do_dupreq_cache &&
+                      nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                     {
                       LogCrit(COMPONENT_DISPATCH,
                               "Attempt to delete duplicate request failed on line %d",
@@ -1022,8 +1044,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                 }
               /* Bad argument */
               svcerr_auth(ptr_svc, AUTH_FAILED);
-              if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                    &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+              if (do_dupreq_cache &&
+                  nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                 {
                   LogCrit(COMPONENT_DISPATCH,
                           "Attempt to delete duplicate request failed on line %d",
@@ -1058,8 +1080,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                         "Export %s does not support AUTH_NONE",
                         pexport->dirname);
                 svcerr_auth(ptr_svc, AUTH_TOOWEAK);
-                if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                      &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+                if (do_dupreq_cache &&
+                    nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                   {
                     LogCrit(COMPONENT_DISPATCH,
                             "Attempt to delete duplicate request failed on line %d",
@@ -1076,8 +1098,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                         "Export %s does not support AUTH_UNIX",
                         pexport->dirname);
                 svcerr_auth(ptr_svc, AUTH_TOOWEAK);
-                if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                      &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+                if (do_dupreq_cache &&
+                    nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                   {
                     LogCrit(COMPONENT_DISPATCH,
                             "Attempt to delete duplicate request failed on line %d",
@@ -1097,8 +1119,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                 LogInfo(COMPONENT_DISPATCH,
                         "Export %s does not support RPCSEC_GSS",
                         pexport->dirname);
-                if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                      &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+                if (do_dupreq_cache &&
+                    nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                   {
                     LogCrit(COMPONENT_DISPATCH,
                             "Attempt to delete duplicate request failed on line %d",
@@ -1124,8 +1146,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                                   "Export %s does not support RPCSEC_GSS_SVC_NONE",
                                   pexport->dirname);
                           svcerr_auth(ptr_svc, AUTH_TOOWEAK);
-                          if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                                &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+                          if (do_dupreq_cache &&
+                              nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                             {
                               LogCrit(COMPONENT_DISPATCH,
                                       "Attempt to delete duplicate request failed on line %d",
@@ -1142,8 +1164,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                                   "Export %s does not support RPCSEC_GSS_SVC_INTEGRITY",
                                   pexport->dirname);
                           svcerr_auth(ptr_svc, AUTH_TOOWEAK);
-                          if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                                &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+                          if (do_dupreq_cache &&
+                              nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                             {
                               LogCrit(COMPONENT_DISPATCH,
                                       "Attempt to delete duplicate request failed on line %d",
@@ -1160,8 +1182,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                                   "Export %s does not support RPCSEC_GSS_SVC_PRIVACY",
                                   pexport->dirname);
                           svcerr_auth(ptr_svc, AUTH_TOOWEAK);
-                          if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                                &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+                          if (do_dupreq_cache &&
+                              nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                             {
                               LogCrit(COMPONENT_DISPATCH,
                                       "Attempt to delete duplicate request failed on line %d",
@@ -1176,8 +1198,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                               "Export %s does not support unknown RPCSEC_GSS_SVC %d",
                               pexport->dirname, (int) svc);
                       svcerr_auth(ptr_svc, AUTH_TOOWEAK);
-                      if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                            &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+                      if (do_dupreq_cache &&
+                          nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                         {
                           LogCrit(COMPONENT_DISPATCH,
                                   "Attempt to delete duplicate request failed on line %d",
@@ -1193,8 +1215,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
                     "Export %s does not support unknown oa_flavor %d",
                     pexport->dirname, (int) ptr_req->rq_cred.oa_flavor);
             svcerr_auth(ptr_svc, AUTH_TOOWEAK);
-            if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                  &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+            if (do_dupreq_cache &&
+                nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
               {
                 LogCrit(COMPONENT_DISPATCH,
                         "Attempt to delete duplicate request failed on line %d",
@@ -1226,8 +1248,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
           svcerr_auth(ptr_svc, AUTH_TOOWEAK);
           pworker_data->current_xid = 0;    /* No more xid managed */
 
-          if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+          if (do_dupreq_cache &&
+              nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
             {
               LogCrit(COMPONENT_DISPATCH,
                       "Attempt to delete duplicate request failed on line %d",
@@ -1246,8 +1268,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
           svcerr_auth(ptr_svc, AUTH_TOOWEAK);
           pworker_data->current_xid = 0;    /* No more xid managed */
 
-          if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+          if (do_dupreq_cache &&
+              nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
             {
               LogCrit(COMPONENT_DISPATCH,
                       "Attempt to delete duplicate request failed on line %d",
@@ -1280,8 +1302,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
       svcerr_auth( ptr_svc, AUTH_TOOWEAK );
       pworker_data->current_xid = 0;        /* No more xid managed */
 
-      if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                            &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+      if (do_dupreq_cache &&
+          nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
         {
           LogCrit(COMPONENT_DISPATCH,
                   "Attempt to delete duplicate request failed on line %d",
@@ -1352,8 +1374,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
               svcerr_auth(ptr_svc, AUTH_TOOWEAK);
               pworker_data->current_xid = 0;    /* No more xid managed */
 
-              if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                    &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+              if (do_dupreq_cache &&
+                  nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
                 {
                   LogCrit(COMPONENT_DISPATCH,
                          "Attempt to delete duplicate request failed on line %d",
@@ -1430,6 +1452,12 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
   nfs_stat_update(stat_type, &(pworker_data->stats.stat_req), ptr_req, &latency_stat);
   pworker_data->stats.nb_total_req += 1;
 
+  /* NFSv4 requests are accounted on exports per operation, in nfs4_Compound */
+  if(ptr_req->rq_prog == nfs_param.core_param.program[P_NFS] &&
+     ptr_req->rq_vers != NFS_V4 && ptr_req->rq_proc != NFSPROC_NULL &&
+     pexport != NULL)
+    nfs_export_latency_record(pexport, pworker_data->worker_index, latency_stat.latency);
+
   /* Perform NFSv4 operations statistics if required */
   if(ptr_req->rq_vers == NFS_V4)
     if(ptr_req->rq_proc == NFSPROC4_COMPOUND)
@@ -1450,8 +1478,7 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
        * later. We only remove a reply that is normally cached that has been
        * dropped. */
       if(do_dupreq_cache)
-        if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                              &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+        if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
           {
             LogCrit(COMPONENT_DISPATCH,
                     "Attempt to delete duplicate request failed on line %d",
@@ -1476,8 +1503,8 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
 
           V(mutex_cond_xprt[ptr_svc->XP_SOCK]);
 
-          if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                                &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
+          if (do_dupreq_cache &&
+              nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt) != DUPREQ_SUCCESS)
             {
               LogCrit(COMPONENT_DISPATCH,
                       "Attempt to delete duplicate request failed on line %d",
@@ -1499,33 +1526,19 @@ static void nfs_rpc_execute(nfs_request_data_t * preqnfs,
           status = nfs_dupreq_finish(rpcxid,
                                      ptr_req,
                                      preqnfs->xprt,
-                                     &res_nfs,
-                                     lru_dupreq);
+                                     &res_nfs);
         }
     } /* rc == NFS_REQ_DROP */
 
   /* Free the allocated resources once the work is done */
   /* Free the arguments */
-  if(preqnfs->req.rq_vers == 2 || preqnfs->req.rq_vers == 3 || preqnfs->req.rq_vers == 4)
-    if(!SVC_FREEARGS(ptr_svc, pworker_data->pfuncdesc->xdr_decode_func, (caddr_t) parg_nfs))
-      {
-        LogCrit(COMPONENT_DISPATCH,
-                "NFS DISPATCHER: FAILURE: Bad SVC_FREEARGS for %s",
-                pworker_data->pfuncdesc->funcname);
-      }
+  nfs_rpc_free_args(preqnfs, pworker_data->pfuncdesc);
 
   /* Free the reply.
    * This should not be done if the request is dupreq cached because this will
    * mark the dupreq cached info eligible for being reuse by other requests */
   if(!do_dupreq_cache)
     {
-      if (nfs_dupreq_delete(rpcxid, ptr_req, preqnfs->xprt,
-                            &pworker_data->dupreq_pool) != DUPREQ_SUCCESS)
-        {
-          LogCrit(COMPONENT_DISPATCH,
-                  "Attempt to delete duplicate request failed on line %d",
-                  __LINE__);
-        }
       /* Free only the non dropped requests */
       if(rc == NFS_REQ_OK) {
         pworker_data->pfuncdesc->free_function(&res_nfs);
@@ -1598,7 +1611,7 @@ const char *pause_rc_str[] =
   "PAUSE_EXIT",
 };
 
-worker_available_rc worker_available(unsigned long worker_index, unsigned int avg_number_pending)
+worker_available_rc worker_available(unsigned long worker_index, unsigned int max_pending)
 {
   worker_available_rc rc = WORKER_AVAILABLE;
   P(workers_data[worker_index].request_mutex);
@@ -1619,7 +1632,7 @@ worker_available_rc worker_available(unsigned long worker_index, unsigned int av
                          "worker thread #%lu is doing garbage collection", worker_index);
             rc = WORKER_GC;
           }
-        else if(workers_data[worker_index].pending_request->nb_entry >= avg_number_pending)
+        else if(mpmc_queue_length(&workers_data[worker_index].request_queue) >= max_pending)
           {
             rc = WORKER_BUSY;
           }
@@ -1912,15 +1925,9 @@ void notify_threads_of_new_state()
                pause_state_str[workers_data[worker_index].pause_state],
                pause_state_str[pause_state]);
       workers_data[worker_index].pause_state = pause_state;
-      if(pthread_cond_signal(&(workers_data[worker_index].req_condvar)) == -1)
-        {
-          V(workers_data[worker_index].request_mutex);
-          LogMajor(COMPONENT_THREAD,
-                   "Error %d (%s) while signalling Worker Thread #%u... Exiting",
-                   errno, strerror(errno), worker_index);
-          Fatal();
-        }
       V(workers_data[worker_index].request_mutex);
+
+      mpmc_queue_wakeup(&workers_data[worker_index].request_queue);
     }
 }
 
@@ -2107,87 +2114,99 @@ pause_rc wake_workers(awaken_reason_t reason)
 
 int nfs_Init_worker_data(nfs_worker_data_t * pdata)
 {
-  LRU_status_t status = LRU_LIST_SUCCESS;
-  char name[256];
-
   if(pthread_mutex_init(&(pdata->request_mutex), NULL) != 0)
     return -1;
 
   if(pthread_mutex_init(&(pdata->request_pool_mutex), NULL) != 0)
     return -1;
 
-  if(pthread_cond_init(&(pdata->req_condvar), NULL) != 0)
+  if(mpmc_queue_init(&(pdata->request_queue),
+                     nfs_param.worker_param.nb_pending_queue_size) != 0)
     return -1;
 
-  sprintf(name, "Worker Thread #%u Pending Request", pdata->worker_index);
-  nfs_param.worker_param.lru_param.name = Str_Dup(name);
-
-  if((pdata->pending_request =
-      LRU_Init(nfs_param.worker_param.lru_param, &status)) == NULL)
-    {
-      LogError(COMPONENT_DISPATCH, ERR_LRU, ERR_LRU_LIST_INIT, status);
-      return -1;
-    }
-
-  sprintf(name, "Worker Thread #%u Duplicate Request", pdata->worker_index);
-  nfs_param.worker_param.lru_dupreq.name = Str_Dup(name);
+  if((pdata->stats.stat_req.platency =
+      (nfs_latency_stat_t *) Mem_Alloc_Label(sizeof(nfs_latency_stat_t),
+                                             "nfs_latency_stat_t")) == NULL)
+    return -1;
 
-  if((pdata->duplicate_request =
-      LRU_Init(nfs_param.worker_param.lru_dupreq, &status)) == NULL)
-    {
-      LogError(COMPONENT_DISPATCH, ERR_LRU, ERR_LRU_LIST_INIT, status);
-      return -1;
-    }
+  memset(pdata->stats.stat_req.platency, 0, sizeof(nfs_latency_stat_t));
 
   pdata->passcounter = 0;
   pdata->is_ready = FALSE;
   pdata->gc_in_progress = FALSE;
+  pdata->is_idle = FALSE;
   pdata->pfuncdesc = INVALID_FUNCDESC;
 
   return 0;
 }                               /* nfs_Init_worker_data */
 
+/**
+ * kick_idle_worker: wakes up an idle worker so that it steals a request.
+ *
+ * @param worker_index [IN] the busy worker, which is not kicked.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void kick_idle_worker(unsigned int worker_index)
+{
+  unsigned int nb_worker = nfs_param.core_param.nb_worker;
+  unsigned int i;
+
+  for(i = (worker_index + 1) % nb_worker; i != worker_index; i = (i + 1) % nb_worker)
+    if(workers_data[i].is_idle)
+      {
+        mpmc_queue_wakeup(&workers_data[i].request_queue);
+        return;
+      }
+}                               /* kick_idle_worker */
+
+/**
+ * DispatchWork: queues a request for a worker thread.
+ *
+ * The worker is woken up by mpmc_queue_push if it was idle. If it is busy
+ * and another worker is idle, that one is kicked to steal the request rather
+ * than leave it behind the current one. When the queue is full, the
+ * dispatcher parks until the worker, or a thread stealing from it, makes
+ * room: the client is slowed down instead of burning a CPU.
+ *
+ * @param pnfsreq      [IN] the decoded request.
+ * @param worker_index [IN] the worker chosen by select_worker_queue.
+ *
+ * @return nothing (void function)
+ *
+ */
 void DispatchWork(nfs_request_data_t *pnfsreq, unsigned int worker_index)
 {
-  LRU_entry_t *pentry = NULL;
-  LRU_status_t status;
+  nfs_worker_data_t *pworker = &workers_data[worker_index];
   struct svc_req *ptr_req = &pnfsreq->req;
   unsigned int rpcxid = get_rpc_xid(ptr_req);
+  unsigned int len;
+  int nb_waits;
 
   LogDebug(COMPONENT_DISPATCH,
            "Awaking Worker Thread #%u for request %p, xid=%u",
            worker_index, pnfsreq, rpcxid);
 
-  P(workers_data[worker_index].request_mutex);
-  P(workers_data[worker_index].request_pool_mutex);
-
-  pentry = LRU_new_entry(workers_data[worker_index].pending_request, &status);
-
-  if(pentry == NULL)
-    {
-      V(workers_data[worker_index].request_pool_mutex);
-      V(workers_data[worker_index].request_mutex);
-      LogMajor(COMPONENT_DISPATCH,
-               "Error while inserting pending request to Worker Thread #%u... Exiting",
-               worker_index);
-      Fatal();
-    }
-
-  pentry->buffdata.pdata = (caddr_t) pnfsreq;
-  pentry->buffdata.len = sizeof(*pnfsreq);
+  if((nb_waits = mpmc_queue_push_wait(&pworker->request_queue, pnfsreq)) > 0)
+    LogFullDebug(COMPONENT_DISPATCH,
+                 "Request queue of Worker Thread #%u was full, waited %d times",
+                 worker_index, nb_waits);
+
+  /* The push was a full barrier: either an idle worker sees the request when
+   * it looks for one to steal, or it is counted here and gets kicked */
+  if(nb_idle_workers > 0 && !pworker->is_idle
+#ifndef _NO_MOUNT_LIST
+     /* worker #0 handles the mount requests, nobody steals them */
+     && worker_index != 0
+#endif
+    )
+    kick_idle_worker(worker_index);
 
-  if(pthread_cond_signal(&(workers_data[worker_index].req_condvar)) == -1)
-    {
-      V(workers_data[worker_index].request_pool_mutex);
-      V(workers_data[worker_index].request_mutex);
-      LogMajor(COMPONENT_THREAD,
-               "Error %d (%s) while signalling Worker Thread #%u... Exiting",
-               errno, strerror(errno), worker_index);
-      Fatal();
-    }
-  V(workers_data[worker_index].request_pool_mutex);
-  V(workers_data[worker_index].request_mutex);
-}
+  len = mpmc_queue_length(&pworker->request_queue);
+  if(len > pworker->stats.max_pending)
+    pworker->stats.max_pending = len;
+}                               /* DispatchWork */
 
 enum auth_stat AuthenticateRequest(nfs_request_data_t *pnfsreq,
                                    bool_t *no_dispatch)
@@ -2252,6 +2271,83 @@ enum auth_stat AuthenticateRequest(nfs_request_data_t *pnfsreq,
   return AUTH_OK;
 }
 
+/**
+ * mark_thread_idle: tells the dispatchers whether a worker is out of requests.
+ *
+ * @param pmydata [INOUT] the worker's data.
+ * @param idle    [IN]    TRUE when the worker found nothing to do.
+ *
+ * @return nothing (void function)
+ *
+ */
+static void mark_thread_idle(nfs_worker_data_t *pmydata, int idle)
+{
+  if(pmydata->is_idle == idle)
+    return;
+
+  /* The atomic operations are full barriers, the flag is visible before the
+   * worker looks for a request to steal */
+  pmydata->is_idle = idle;
+  if(idle)
+    __sync_fetch_and_add(&nb_idle_workers, 1);
+  else
+    __sync_fetch_and_sub(&nb_idle_workers, 1);
+}                               /* mark_thread_idle */
+
+/**
+ * steal_request: takes a pending request from the worker with the longest
+ * queue, so that requests queued behind a slow call do not wait for it.
+ *
+ * Worker #0 is left alone when it is dedicated to the mount protocol, and
+ * does not steal either: it never marks itself idle, so it is not kicked.
+ *
+ * @param pmydata [INOUT] the data of the idle worker.
+ *
+ * @return the stolen request, or NULL if the other queues are empty.
+ *
+ */
+static nfs_request_data_t *steal_request(nfs_worker_data_t *pmydata)
+{
+  nfs_request_data_t *pnfsreq;
+  unsigned int victim = 0;
+  unsigned int max_pending = 0;
+  unsigned int len;
+  unsigned int i = 0;
+
+#ifndef _NO_MOUNT_LIST
+  i = 1;
+#endif
+
+  for(; i < nfs_param.core_param.nb_worker; i++)
+    {
+      if(i == pmydata->worker_index)
+        continue;
+
+      len = mpmc_queue_length(&workers_data[i].request_queue);
+      if(len > max_pending)
+        {
+          max_pending = len;
+          victim = i;
+        }
+    }
+
+  if(max_pending == 0)
+    return NULL;
+
+  /* The owner or another thief may have been faster */
+  if((pnfsreq = mpmc_queue_pop(&workers_data[victim].request_queue)) == NULL)
+    return NULL;
+
+  pmydata->stats.nb_steal += 1;
+  __sync_fetch_and_add(&workers_data[victim].stats.nb_stolen, 1);
+
+  LogFullDebug(COMPONENT_DISPATCH,
+               "Stole request %p from Worker Thread #%u, which had %u pending requests",
+               pnfsreq, victim, max_pending);
+
+  return pnfsreq;
+}                               /* steal_request */
+
 /**
  * worker_thread: The main function for a worker thread
  *
@@ -2268,13 +2364,9 @@ void *worker_thread(void *IndexArg)
 {
   nfs_worker_data_t *pmydata;
   nfs_request_data_t *pnfsreq;
-  LRU_entry_t *pentry;
   struct svc_req *preq;
   unsigned long worker_index;
-  bool_t found = FALSE;
   int rc = 0;
-  cache_inode_status_t cache_status = CACHE_INODE_SUCCESS;
-  unsigned int gc_allowed = FALSE;
   char thr_name[32];
 
 #ifdef _USE_MFSL
@@ -2301,8 +2393,8 @@ void *worker_thread(void *IndexArg)
     }
 
   LogFullDebug(COMPONENT_DISPATCH,
-               "Starting, nb_entry=%d",
-               pmydata->pending_request->nb_entry);
+               "Starting, queue length=%u",
+               mpmc_queue_length(&pmydata->request_queue));
   /* Initialisation of the Buddy Malloc */
 #ifndef _NO_BUDDY_SYSTEM
   if((rc = BuddyInit(&nfs_param.buddy_param_worker)) != BUDDY_SUCCESS)
@@ -2423,27 +2515,36 @@ void *worker_thread(void *IndexArg)
           pmydata->stats.last_stat_update = time(NULL);
         }
 
-      /* Wait on condition variable for work to be done */
+      /* Wait for work to be done */
       LogFullDebug(COMPONENT_DISPATCH,
-                   "waiting for requests to process, nb_entry=%d, nb_invalid=%d",
-                   pmydata->pending_request->nb_entry,
-                   pmydata->pending_request->nb_invalid);
+                   "waiting for requests to process, queue length=%u",
+                   mpmc_queue_length(&pmydata->request_queue));
 
-      P(pmydata->request_mutex);
       while(1)
        {
-         if(pmydata->pause_state == STATE_AWAKE &&
-            pmydata->pending_request->nb_entry != pmydata->pending_request->nb_invalid)
+         if(pmydata->pause_state == STATE_AWAKE)
            {
-             /* We have something to do, and we don't need to pause. */
-             LogFullDebug(COMPONENT_DISPATCH,
-                          "Have work, pause_state: %s, nb_entry=%u, nb_invalid=%u",
-                          pause_state_str[pmydata->pause_state],
-                          pmydata->pending_request->nb_entry,
-                          pmydata->pending_request->nb_invalid);
-             break;
+             if((pnfsreq = mpmc_queue_pop(&pmydata->request_queue)) != NULL)
+               {
+                 /* We have something to do, and we don't need to pause. */
+                 break;
+               }
+
+             /* Nothing of our own, help a busy worker. Worker #0 stays
+              * available for the mount requests instead. */
+#ifndef _NO_MOUNT_LIST
+             if(pmydata->worker_index != 0)
+#endif
+               {
+                 mark_thread_idle(pmydata, TRUE);
+                 if((pnfsreq = steal_request(pmydata)) != NULL)
+                   break;
+               }
            }
+         else
+           mark_thread_idle(pmydata, FALSE);
 
+         P(pmydata->request_mutex);
          switch(pmydata->pause_state)
            {
              case STATE_STARTUP:
@@ -2451,7 +2552,6 @@ void *worker_thread(void *IndexArg)
                /* Mark thread as awake */
                V(pmydata->request_mutex);
                mark_thread_awake(pmydata);
-               P(pmydata->request_mutex);
 
                /* Go back and check new state. */
                continue;
@@ -2460,15 +2560,20 @@ void *worker_thread(void *IndexArg)
                /* Mark thread as asleep */
                V(pmydata->request_mutex);
                mark_thread_asleep(pmydata);
-               P(pmydata->request_mutex);
 
                /* Go back and check new state. */
                continue;
 
              case STATE_AWAKE:
+               /* Wait for something to do, or for a new state */
+               V(pmydata->request_mutex);
+               mpmc_queue_wait(&pmydata->request_queue, MPMC_WAIT_DATA);
+               break;
+
              case STATE_PAUSED:
-               /* Wait for something to do */
-               pthread_cond_wait(&(pmydata->req_condvar), &(pmydata->request_mutex));
+               /* Queued requests wait for the workers to be awaken */
+               V(pmydata->request_mutex);
+               mpmc_queue_wait(&pmydata->request_queue, MPMC_WAIT_KICK);
                break;
 
              case STATE_EXIT:
@@ -2481,38 +2586,15 @@ void *worker_thread(void *IndexArg)
            }
        }
 
+      mark_thread_idle(pmydata, FALSE);
+
       LogFullDebug(COMPONENT_DISPATCH,
                    "Processing a new request");
-      V(pmydata->request_mutex);
-
-      found = FALSE;
-      P(pmydata->request_pool_mutex);
-
-      for(pentry = pmydata->pending_request->LRU; pentry != NULL; pentry = pentry->next)
-        {
-          if(pentry->valid_state == LRU_ENTRY_VALID)
-            {
-              found = TRUE;
-              break;
-            }
-        }
-
-      V(pmydata->request_pool_mutex);
-
-      if(!found)
-        {
-          LogMajor(COMPONENT_DISPATCH,
-                   "No pending request available");
-          continue;             /* return to main loop */
-        }
-
-      pnfsreq = (nfs_request_data_t *) (pentry->buffdata.pdata);
 
       LogFullDebug(COMPONENT_DISPATCH,
-                   "I have some work to do, pnfsreq=%p, length=%d, invalid=%d, xid=%lu",
+                   "I have some work to do, pnfsreq=%p, length=%u, xid=%lu",
                    pnfsreq,
-                   pmydata->pending_request->nb_entry,
-                   pmydata->pending_request->nb_invalid,
+                   mpmc_queue_length(&pmydata->request_queue),
                    (unsigned long) pnfsreq->msg.rm_xid);
 
       if(pnfsreq->xprt->XP_SOCK == 0)
@@ -2536,69 +2618,20 @@ void *worker_thread(void *IndexArg)
             nfs_rpc_execute(pnfsreq, pmydata);
         }
 
-      /* Free the req by releasing the entry */
+      /* Free the req by sending it back to the pool it was taken from */
       LogFullDebug(COMPONENT_DISPATCH,
-                   "Invalidating processed entry");
-      P(pmydata->request_pool_mutex);
-      if(LRU_invalidate(pmydata->pending_request, pentry) != LRU_LIST_SUCCESS)
-        {
-          LogCrit(COMPONENT_DISPATCH,
-                  "Incoherency: released entry for dispatch could not be tagged invalid");
-        }
-      V(pmydata->request_pool_mutex);
+                   "Releasing processed request");
+      xdr_arena_reset(&pnfsreq->arena);
+      P(workers_data[pnfsreq->pool_index].request_pool_mutex);
+      ReleaseToPool(pnfsreq, &workers_data[pnfsreq->pool_index].request_pool);
+      V(workers_data[pnfsreq->pool_index].request_pool_mutex);
 
       if(pmydata->passcounter > nfs_param.worker_param.nb_before_gc)
         {
           /* Garbage collection on dup req cache */
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "before dupreq invalidation nb_entry=%d nb_invalid=%d",
-                       pmydata->duplicate_request->nb_entry,
-                       pmydata->duplicate_request->nb_invalid);
-          if((rc =
-              LRU_invalidate_by_function(pmydata->duplicate_request,
-                                         nfs_dupreq_gc_function,
-                                         NULL)) != LRU_LIST_SUCCESS)
-            {
-              LogCrit(COMPONENT_DISPATCH,
-                      "FAILURE: Impossible to invalidate entries for duplicate request cache (error %d)",
-                      rc);
-            }
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "after dupreq invalidation nb_entry=%d nb_invalid=%d",
-                       pmydata->duplicate_request->nb_entry,
-                       pmydata->duplicate_request->nb_invalid);
-          if((rc =
-              LRU_gc_invalid(pmydata->duplicate_request,
-                             (void *)&pmydata->dupreq_pool)) != LRU_LIST_SUCCESS)
-            LogCrit(COMPONENT_DISPATCH,
-                    "FAILURE: Impossible to gc entries for duplicate request cache (error %d)",
-                    rc);
-          else
-            LogFullDebug(COMPONENT_DISPATCH,
-                         "gc entries for duplicate request cache OK");
+          nfs_dupreq_gc();
 
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "after dupreq gc nb_entry=%d nb_invalid=%d",
-                       pmydata->duplicate_request->nb_entry,
-                       pmydata->duplicate_request->nb_invalid);
-
-          /* Performing garbabbge collection */
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "Garbage collecting on pending request list");
           pmydata->passcounter = 0;
-
-          P(pmydata->request_pool_mutex);
-
-          if(LRU_gc_invalid(pmydata->pending_request, (void *)&pmydata->request_pool) !=
-             LRU_LIST_SUCCESS)
-            LogCrit(COMPONENT_DISPATCH,
-                    "ERROR: Impossible garbage collection on pending request list");
-          else
-            LogFullDebug(COMPONENT_DISPATCH,
-                         "Garbage collection on pending request list OK");
-
-          V(pmydata->request_pool_mutex);
-
         }
       else
         LogFullDebug(COMPONENT_DISPATCH,
@@ -2606,41 +2639,10 @@ void *worker_thread(void *IndexArg)
                      pmydata->passcounter, nfs_param.worker_param.nb_before_gc);
       pmydata->passcounter += 1;
 
-      /* If needed, perform garbage collection on cache_inode layer */
-      P(lock_nb_current_gc_workers);
-      if(nb_current_gc_workers < nfs_param.core_param.nb_max_concurrent_gc)
-        {
-          nb_current_gc_workers += 1;
-          gc_allowed = TRUE;
-        }
-      else
-        gc_allowed = FALSE;
-      V(lock_nb_current_gc_workers);
+      /* Get back the memory of my cache_inode entries reclaimed by the gc thread */
+      cache_inode_gc_recycle(&pmydata->cache_inode_client);
 
       P(pmydata->request_mutex);
-      if(gc_allowed == TRUE && pmydata->pause_state == STATE_AWAKE)
-        {
-          pmydata->gc_in_progress = TRUE;
-          V(pmydata->request_mutex);
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "There are %d concurrent garbage collection",
-                       nb_current_gc_workers);
-
-          if(cache_inode_gc(pmydata->ht,
-                            &(pmydata->cache_inode_client),
-                            &cache_status) != CACHE_INODE_SUCCESS)
-            {
-              LogCrit(COMPONENT_DISPATCH,
-                      "NFS WORKER: FAILURE: Bad cache_inode garbage collection");
-            }
-
-          P(lock_nb_current_gc_workers);
-          nb_current_gc_workers -= 1;
-          V(lock_nb_current_gc_workers);
-
-          P(pmydata->request_mutex);
-          pmydata->gc_in_progress = FALSE;
-        }
 #ifdef _USE_MFSL
       /* As MFSL context are refresh, and because this could be a time consuming operation, the worker is
        * set as "making garbagge collection" to avoid new requests to come in its pending queue */
@@ -62,6 +62,7 @@
 #include "nfs_proto_functions.h"
 #include "nfs_file_handle.h"
 #include "nfs_tools.h"
+#include "sal_functions.h"
 
 /**
  *
@@ -133,6 +134,9 @@ int nfs41_op_create_session(struct nfs_argop4 *op,
   pnfs_clientid->confirmed = CONFIRMED_CLIENT_ID;
   pnfs_clientid->cb_program = arg_CREATE_SESSION4.csa_cb_program;
 
+  /* Journal the client, for the grace period of the next start */
+  nfs4_recovery_client_confirm(pnfs_clientid->clientid, pnfs_clientid->client_name);
+
   pnfs_clientid->create_session_sequence += 1;
   /** @todo: BUGAZOMEU Gerer les parametres de secu */
 
@@ -192,6 +196,9 @@ int nfs41_op_create_session(struct nfs_argop4 *op,
       return res_CREATE_SESSION4.csr_status;
     }
 
+  /* The session goes away with the lease of its client */
+  nfs4_lease_session(pnfs41_session, TRUE);
+
   /* Successful exit */
   res_CREATE_SESSION4.csr_status = NFS4_OK;
   return res_CREATE_SESSION4.csr_status;
@@ -62,6 +62,7 @@
 #include "nfs_proto_functions.h"
 #include "nfs_file_handle.h"
 #include "nfs_tools.h"
+#include "sal_functions.h"
 
 /**
  *
@@ -82,6 +83,7 @@
 int nfs41_op_destroy_session(struct nfs_argop4 *op,
                              compound_data_t * data, struct nfs_resop4 *resp)
 {
+  nfs41_session_t *psession = NULL;
 
 #define arg_DESTROY_SESSION4 op->nfs_argop4_u.opdestroy_session
 #define res_DESTROY_SESSION4 resp->nfs_resop4_u.opdestroy_session
@@ -89,6 +91,9 @@ int nfs41_op_destroy_session(struct nfs_argop4 *op,
   resp->resop = NFS4_OP_DESTROY_SESSION;
   res_DESTROY_SESSION4.dsr_status = NFS4_OK;
 
+  if(nfs41_Session_Get_Pointer(arg_DESTROY_SESSION4.dsa_sessionid, &psession))
+    nfs4_lease_session(psession, FALSE);
+
   if(!nfs41_Session_Del(arg_DESTROY_SESSION4.dsa_sessionid))
     res_DESTROY_SESSION4.dsr_status = NFS4ERR_BADSESSION;
   else
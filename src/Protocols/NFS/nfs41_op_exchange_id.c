@@ -62,6 +62,7 @@
 #include "nfs_proto_functions.h"
 #include "nfs_file_handle.h"
 #include "nfs_tools.h"
+#include "sal_functions.h"
 
 /**
  *
@@ -271,6 +272,9 @@ int nfs41_op_exchange_id(struct nfs_argop4 *op,
         }
     }
 
+  /* Start or renew the lease, an unconfirmed client is forgotten when it expires */
+  nfs4_lease_renew(clientid);
+
   res_EXCHANGE_ID4.EXCHANGE_ID4res_u.eir_resok4.eir_clientid = clientid;
   res_EXCHANGE_ID4.EXCHANGE_ID4res_u.eir_resok4.eir_sequenceid =
       nfs_clientid.create_session_sequence;
@@ -294,6 +294,12 @@ int nfs41_op_lock(struct nfs_argop4 *op, compound_data_t * data, struct nfs_reso
               &lock_desc);
     }                           /* if( arg_LOCK4.locker.new_lock_owner ) */
 
+  /* Reclaims only during the grace period, new locks only after it */
+  if((res_LOCK4.status =
+      nfs4_recovery_check_reclaim(popen_owner->so_owner.so_nfs4_owner.so_clientid,
+                                  arg_LOCK4.reclaim)) != NFS4_OK)
+    return res_LOCK4.status;
+
   /* Check for conflicts with previously obtained states */
 
   /* TODO FSF:
@@ -279,6 +279,11 @@ int nfs41_op_open(struct nfs_argop4 *op, compound_data_t * data, struct nfs_reso
                "OPEN Client id = %llx",
                (long long unsigned int)arg_OPEN4.owner.clientid);
 
+      /* No new open during the grace period */
+      if((res_OPEN4.status =
+          nfs4_recovery_check_reclaim(arg_OPEN4.owner.clientid, FALSE)) != NFS4_OK)
+        return res_OPEN4.status;
+
       /* Is this open_owner known ? */
       convert_nfs4_owner(&arg_OPEN4.owner, &owner_name);
 
@@ -1022,6 +1027,11 @@ int nfs41_op_open(struct nfs_argop4 *op, compound_data_t * data, struct nfs_reso
       break;
 
     case CLAIM_PREVIOUS:
+      /* Only the clients known to the recovery journal reclaim, during the
+       * grace period */
+      if((res_OPEN4.status =
+          nfs4_recovery_check_reclaim(arg_OPEN4.owner.clientid, TRUE)) != NFS4_OK)
+        return res_OPEN4.status;
       break;
 
     default:
@@ -63,6 +63,7 @@
 #include "nfs_proto_functions.h"
 #include "nfs_file_handle.h"
 #include "nfs_tools.h"
+#include "sal_functions.h"
 
 /**
  * 
@@ -91,6 +92,11 @@ int nfs41_op_reclaim_complete(struct nfs_argop4 *op, compound_data_t * data,
 
   resp->resop = NFS4_OP_RECLAIM_COMPLETE;
 
+  /* The client is done with all its file systems, it is no more waited for
+   * in the grace period */
+  if(!arg_RECLAIM_COMPLETE4.rca_one_fs && data->psession != NULL)
+    nfs4_recovery_reclaim_complete(data->psession->clientid);
+
   res_RECLAIM_COMPLETE4.rcr_status = NFS4_OK;
   return res_RECLAIM_COMPLETE4.rcr_status;
 }                               /* nfs41_op_reclaim_complete */
@@ -60,6 +60,7 @@
 #include "nfs_creds.h"
 #include "nfs_proto_functions.h"
 #include "nfs_tools.h"
+#include "sal_functions.h"
 #include "nfs_file_handle.h"
 
 /**
@@ -141,6 +142,8 @@ int nfs41_op_sequence(struct nfs_argop4 *op,
   /* Keep memory of the session in the COMPOUND's data */
   data->psession = psession;
 
+  nfs4_lease_renew(psession->clientid);
+
   /* Update the sequence id within the slot */
   psession->slots[arg_SEQUENCE4.sa_slotid].sequence += 1;
 
@@ -83,7 +83,7 @@ int nfs41_op_write(struct nfs_argop4 *op, compound_data_t * data, struct nfs_res
   fsal_size_t              written_size;
   fsal_off_t               offset;
   fsal_boolean_t           eof_met;
-  bool_t                   stable_flag = TRUE;
+  uint64_t                 stable_flag = FSAL_SAFE_WRITE_TO_FS;
   caddr_t                  bufferdata;
   stable_how4              stable_how;
   cache_content_status_t   content_status;
@@ -291,11 +291,14 @@ int nfs41_op_write(struct nfs_argop4 *op, compound_data_t * data, struct nfs_res
 
   if((nfs_param.core_param.use_nfs_commit == TRUE) && (arg_WRITE4.stable == UNSTABLE4))
     {
-      stable_flag = FALSE;
+      if(data->pexport->use_ganesha_write_buffer == TRUE)
+        stable_flag = FSAL_UNSAFE_WRITE_TO_GANESHA_BUFFER;
+      else
+        stable_flag = FSAL_UNSAFE_WRITE_TO_FS_BUFFER;
     }
   else
     {
-      stable_flag = TRUE;
+      stable_flag = FSAL_SAFE_WRITE_TO_FS;
     }
 
   /* An actual write is to be made, prepare it */
@@ -321,7 +324,7 @@ int nfs41_op_write(struct nfs_argop4 *op, compound_data_t * data, struct nfs_res
     }
 
   /* Set the returned value */
-  if(stable_flag == TRUE)
+  if(stable_flag == FSAL_SAFE_WRITE_TO_FS)
     res_WRITE4.WRITE4res_u.resok4.committed = FILE_SYNC4;
   else
     res_WRITE4.WRITE4res_u.resok4.committed = UNSTABLE4;
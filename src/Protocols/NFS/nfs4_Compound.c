@@ -221,6 +221,42 @@ nfs4_op_desc_t *optabvers[] = { (nfs4_op_desc_t *) optab4v0 };
  * 
  */
 
+/**
+ *
+ * nfs4_op_latency_record: records the latency of a COMPOUND sub-operation.
+ *
+ * Records the latency of a COMPOUND sub-operation in the histograms of the worker
+ * thread processing the request, and in the ones of the export the operation ended on.
+ *
+ * @param data    [IN] the compound request's data
+ * @param op      [IN] the operation number
+ * @param pstart  [IN] the time the operation started
+ *
+ * @return nothing (void function)
+ *
+ */
+static void nfs4_op_latency_record(compound_data_t * data, unsigned int op,
+                                   struct timeval *pstart)
+{
+  nfs_worker_data_t *pworker = (nfs_worker_data_t *) data->pclient->pworker;
+  struct timeval end;
+  struct timeval diff;
+  unsigned int latency;
+
+  if(pworker == NULL || op >= NFS_V4_NB_OP_NUMBER)
+    return;
+
+  gettimeofday(&end, NULL);
+  diff = time_diff(*pstart, end);
+  latency = diff.tv_sec * 1000000 + diff.tv_usec;       /* microseconds */
+
+  if(pworker->stats.stat_req.platency != NULL)
+    nfs_latency_record(&pworker->stats.stat_req.platency->nfs4_op[op], latency);
+
+  if(data->pexport != NULL)
+    nfs_export_latency_record(data->pexport, pworker->worker_index, latency);
+}                               /* nfs4_op_latency_record */
+
 int nfs4_Compound(nfs_arg_t * parg /* IN     */ ,
                   exportlist_t * pexport /* IN     */ ,
                   fsal_op_context_t * pcontext /* IN     */ ,
@@ -235,6 +271,7 @@ int nfs4_Compound(nfs_arg_t * parg /* IN     */ ,
   char __attribute__ ((__unused__)) funcname[] = "nfs4_Compound";
   compound_data_t data;
   int opindex;
+  struct timeval op_start;
 
   /* A "local" #define to avoid typo with nfs (too) long structure names */
 #define COMPOUND4_ARRAY parg->arg_compound4.argarray
@@ -285,7 +322,6 @@ int nfs4_Compound(nfs_arg_t * parg /* IN     */ ,
 
   /* Minor version related stuff */
   data.minorversion = parg->arg_compound4.minorversion;
-  /** @todo BUGAZOMEU: Reminder: Stats on NFSv4 operations are to be set here */
 
   data.pfullexportlist = pexport;       /* Full export list is provided in input */
   data.pcontext = pcontext;     /* Get the fsal credentials from the worker thread */
@@ -390,12 +426,17 @@ int nfs4_Compound(nfs_arg_t * parg /* IN     */ ,
                opindex);
 
       memset(&res, 0, sizeof(res));
+      gettimeofday(&op_start, NULL);
       status =
           (optabvers[parg->arg_compound4.minorversion][opindex].funct) (&
                                                                         (COMPOUND4_ARRAY.argarray_val
                                                                          [i]), &data,
                                                                         &res);
 
+      nfs4_op_latency_record(&data,
+                             optabvers[parg->arg_compound4.minorversion][opindex].val,
+                             &op_start);
+
       memcpy(&(pres->res_compound4.resarray.resarray_val[i]), &res, sizeof(res));
 
       if(isDebug(COMPONENT_NFS_V4))
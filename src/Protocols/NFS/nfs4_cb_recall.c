@@ -44,9 +44,15 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
 #include <pthread.h>
 #include <fcntl.h>
 #include <sys/file.h>           /* for having FNDELAY */
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #include "HashData.h"
 #include "HashTable.h"
 #include "rpc.h"
@@ -64,6 +70,9 @@
 #include "nfs_proto_tools.h"
 #include "nfs_tools.h"
 #include "nfs_file_handle.h"
+#include "sal_functions.h"
+
+#define NFS4_CB_TIMEOUT 5       /* Seconds allowed to reach the client and get the reply */
 
 /**
  * nfs4_cb_recall: NFS4_OP_CB_recall, nfsv4 call back to recall from a delegation
@@ -83,3 +92,179 @@ int nfs4_cb_recall(struct nfs_cb_argop4 *op,
 {
   return NFS4_OK;
 }                               /* nfs4_cb_recall */
+
+/**
+ * nfs4_cb_parse_uaddr: converts a callback universal address.
+ *
+ * Converts a "h1.h2.h3.h4.p1.p2" address, as given by SETCLIENTID for the
+ * "tcp" netid, to a sockaddr_in.
+ *
+ * @param uaddr [IN]  the universal address
+ * @param paddr [OUT] the socket address
+ *
+ * @return 0 if successfull, -1 if the address is not an IPv4 one.
+ *
+ */
+static int nfs4_cb_parse_uaddr(char *uaddr, struct sockaddr_in *paddr)
+{
+  unsigned int h1, h2, h3, h4, p1, p2;
+  char trailing;
+
+  if(sscanf(uaddr, "%u.%u.%u.%u.%u.%u%c", &h1, &h2, &h3, &h4, &p1, &p2, &trailing) != 6)
+    return -1;
+
+  if(h1 > 255 || h2 > 255 || h3 > 255 || h4 > 255 || p1 > 255 || p2 > 255)
+    return -1;
+
+  memset(paddr, 0, sizeof(struct sockaddr_in));
+  paddr->sin_family = AF_INET;
+  paddr->sin_addr.s_addr = htonl((h1 << 24) | (h2 << 16) | (h3 << 8) | h4);
+  paddr->sin_port = htons((p1 << 8) | p2);
+
+  return 0;
+}                               /* nfs4_cb_parse_uaddr */
+
+/**
+ * nfs4_cb_recall_usable: tells if a client can be sent a CB_RECALL.
+ *
+ * Delegations are only granted to the clients that can be recalled: a
+ * confirmed client, with a callback program and a tcp callback address.
+ *
+ * @param pclientid [IN] the client
+ *
+ * @return TRUE if the callback path of the client looks usable.
+ *
+ */
+int nfs4_cb_recall_usable(nfs_client_id_t * pclientid)
+{
+  struct sockaddr_in addr;
+
+  if(pclientid->confirmed != CONFIRMED_CLIENT_ID || pclientid->cb_program == 0)
+    return FALSE;
+
+  if(strcmp(pclientid->client_r_netid, "tcp"))
+    return FALSE;
+
+  return nfs4_cb_parse_uaddr(pclientid->client_r_addr, &addr) == 0;
+}                               /* nfs4_cb_recall_usable */
+
+/**
+ * nfs4_cb_recall_send: sends a CB_RECALL to the holder of a delegation.
+ *
+ * Connects to the callback address the client gave to SETCLIENTID and sends
+ * a CB_COMPOUND made of a single CB_RECALL. A reply is enough to know the
+ * client will return the delegation, even an error one.
+ *
+ * @param precall [IN] the recall to send
+ *
+ * @return 0 if the client replied, -1 otherwise.
+ *
+ */
+int nfs4_cb_recall_send(state_deleg_recall_t * precall)
+{
+  nfs_client_id_t nfs_clientid;
+  struct sockaddr_in addr;
+  struct pollfd pfd;
+  struct timeval timeout;
+  CB_COMPOUND4args cb_args;
+  CB_COMPOUND4res cb_res;
+  nfs_cb_argop4 cb_argop;
+  CLIENT *clnt;
+  enum clnt_stat stat;
+  int sock;
+  int flags;
+  int rc = -1;
+
+  if(nfs_client_id_get(precall->sdr_clientid, &nfs_clientid) != CLIENT_ID_SUCCESS)
+    {
+      LogDebug(COMPONENT_NFS_V4,
+               "CB_RECALL: client %"PRIx64" is gone", precall->sdr_clientid);
+      return -1;
+    }
+
+  if(nfs4_cb_parse_uaddr(nfs_clientid.client_r_addr, &addr) != 0)
+    return -1;
+
+  if((sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0)
+    return -1;
+
+  /* Do not let an unreachable client hold the recall thread for long */
+  flags = fcntl(sock, F_GETFL, 0);
+  fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+
+  if(connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+      if(errno != EINPROGRESS)
+        {
+          close(sock);
+          return -1;
+        }
+
+      pfd.fd = sock;
+      pfd.events = POLLOUT;
+      if(poll(&pfd, 1, NFS4_CB_TIMEOUT * 1000) != 1 || (pfd.revents & (POLLERR | POLLHUP)))
+        {
+          LogDebug(COMPONENT_NFS_V4,
+                   "CB_RECALL: cannot connect to client %"PRIx64" at %s",
+                   precall->sdr_clientid, nfs_clientid.client_r_addr);
+          close(sock);
+          return -1;
+        }
+    }
+
+  fcntl(sock, F_SETFL, flags);
+
+  if((clnt = clnttcp_create(&addr, nfs_clientid.cb_program, NFS_CB, &sock, 0, 0)) == NULL)
+    {
+      close(sock);
+      return -1;
+    }
+
+  if((clnt->cl_auth = authnone_create()) == NULL)
+    {
+      clnt_destroy(clnt);
+      close(sock);
+      return -1;
+    }
+
+  memset(&cb_argop, 0, sizeof(cb_argop));
+  cb_argop.argop = NFS4_OP_CB_RECALL;
+  cb_argop.nfs_cb_argop4_u.opcbrecall.stateid = precall->sdr_stateid;
+  cb_argop.nfs_cb_argop4_u.opcbrecall.truncate = FALSE;
+  cb_argop.nfs_cb_argop4_u.opcbrecall.fh.nfs_fh4_len = precall->sdr_fh_len;
+  cb_argop.nfs_cb_argop4_u.opcbrecall.fh.nfs_fh4_val = precall->sdr_fh;
+
+  memset(&cb_args, 0, sizeof(cb_args));
+  cb_args.minorversion = 0;
+  cb_args.callback_ident = nfs_clientid.cb_ident;
+  cb_args.argarray.argarray_len = 1;
+  cb_args.argarray.argarray_val = &cb_argop;
+
+  memset(&cb_res, 0, sizeof(cb_res));
+
+  timeout.tv_sec = NFS4_CB_TIMEOUT;
+  timeout.tv_usec = 0;
+
+  stat = clnt_call(clnt, CB_COMPOUND,
+                   (xdrproc_t) xdr_CB_COMPOUND4args, (caddr_t) & cb_args,
+                   (xdrproc_t) xdr_CB_COMPOUND4res, (caddr_t) & cb_res, timeout);
+
+  if(stat == RPC_SUCCESS)
+    {
+      LogDebug(COMPONENT_NFS_V4,
+               "CB_RECALL: client %"PRIx64" replied with status %d",
+               precall->sdr_clientid, cb_res.status);
+      clnt_freeres(clnt, (xdrproc_t) xdr_CB_COMPOUND4res, (caddr_t) & cb_res);
+      rc = 0;
+    }
+  else
+    LogDebug(COMPONENT_NFS_V4,
+             "CB_RECALL: RPC to client %"PRIx64" failed, rpc status %d",
+             precall->sdr_clientid, stat);
+
+  auth_destroy(clnt->cl_auth);
+  clnt_destroy(clnt);
+  close(sock);
+
+  return rc;
+}                               /* nfs4_cb_recall_send */
@@ -0,0 +1,665 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs4_fattr_plan.c
+ * \brief   Precompiled plans for encoding NFSv4 attributes.
+ *
+ * nfs4_fattr_plan.c: a requested bitmap4 is compiled once into a plan, the
+ * flat list of the encoders of its attributes in wire order. Encoding the
+ * attributes of an object is then a loop over this list, without going
+ * through the bitmap and the big switch of nfs4_FSALattr_To_Fattr_Switch for
+ * each attribute. The attributes at the head of the plan which have a known
+ * size are encoded without any check, and a plan made only of such attributes
+ * is encoded straight into the reply buffer.
+ *
+ * Plans are kept in a small direct mapped cache, they are never freed. The
+ * encoders produce exactly the same bytes as nfs4_FSALattr_To_Fattr_Switch.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "HashData.h"
+#include "HashTable.h"
+#include "rpc.h"
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs23.h"
+#include "nfs4.h"
+#include "nfs_core.h"
+#include "cache_inode.h"
+#include "cache_content.h"
+#include "nfs_exports.h"
+#include "nfs_proto_functions.h"
+#include "nfs_tools.h"
+#include "nfs_file_handle.h"
+
+/* Same limit as in nfs4_FSALattr_To_Fattr_Switch: attributes above are skipped */
+#ifdef _USE_NFS4_1
+#define NFS4_FATTR_PLAN_MAX_ATTR FATTR4_FS_CHARSET_CAP
+#else
+#define NFS4_FATTR_PLAN_MAX_ATTR FATTR4_MOUNTED_ON_FILEID
+#endif
+
+static nfs4_fattr_plan_t *nfs4_fattr_plan_cache[NFS4_FATTR_PLAN_CACHE_SIZE];
+
+static u_int nfs4_encode_uint32(char *buff, uint32_t val)
+{
+  uint32_t netval = htonl(val);
+
+  memcpy(buff, &netval, sizeof(uint32_t));
+  return sizeof(uint32_t);
+}                               /* nfs4_encode_uint32 */
+
+static u_int nfs4_encode_uint64(char *buff, uint64_t val)
+{
+  uint64_t netval = nfs_htonl64(val);
+
+  memcpy(buff, &netval, sizeof(uint64_t));
+  return sizeof(uint64_t);
+}                               /* nfs4_encode_uint64 */
+
+static u_int nfs4_encode_nfstime4(char *buff, int64_t seconds, uint32_t nseconds)
+{
+  nfs4_encode_uint64(buff, (uint64_t) seconds);
+  nfs4_encode_uint32(buff + sizeof(int64_t), nseconds);
+  return sizeof(int64_t) + sizeof(uint32_t);
+}                               /* nfs4_encode_nfstime4 */
+
+static u_int nfs4_encode_utf8(char *buff, utf8string * putf8)
+{
+  u_int deltalen = 0;
+
+  /* Take care of 32 bits alignment */
+  if(putf8->utf8string_len % 4 != 0)
+    deltalen = 4 - putf8->utf8string_len % 4;
+
+  nfs4_encode_uint32(buff, putf8->utf8string_len + deltalen);
+  memcpy(buff + sizeof(u_int), putf8->utf8string_val, putf8->utf8string_len);
+
+  /* Pad with zero to keep xdr alignement */
+  memset(buff + sizeof(u_int) + putf8->utf8string_len, 0, deltalen);
+
+  return sizeof(u_int) + putf8->utf8string_len + deltalen;
+}                               /* nfs4_encode_utf8 */
+
+/* Computes the bitmap of the supported attributes, returns its length */
+static uint_t nfs4_supported_attrs_bitmap(uint32_t * pval)
+{
+  uint_t len = 1;
+  uint_t k;
+
+  pval[0] = 0;
+  pval[1] = 0;
+  pval[2] = 0;
+
+  for(k = FATTR4_SUPPORTED_ATTRS; k <= NFS4_FATTR_PLAN_MAX_ATTR; k++)
+    if(fattr4tab[k].supported)
+      {
+        pval[k / 32] |= 1U << (k % 32);
+        if(k / 32 != 0)
+          len = 2;
+      }
+
+  return len;
+}                               /* nfs4_supported_attrs_bitmap */
+
+static u_int nfs4_encode_supported_attrs(exportlist_t * pexport,
+                                         fsal_attrib_list_t * pattr,
+                                         nfs_fh4 * objFH, char *buff)
+{
+  uint32_t supported[3];
+  uint_t len;
+  uint_t k;
+
+  len = nfs4_supported_attrs_bitmap(supported);
+
+  nfs4_encode_uint32(buff, len);
+  for(k = 0; k < len; k++)
+    nfs4_encode_uint32(buff + sizeof(uint32_t) * (k + 1), supported[k]);
+
+  return sizeof(uint32_t) * (len + 1);
+}                               /* nfs4_encode_supported_attrs */
+
+static u_int nfs4_encode_type(exportlist_t * pexport,
+                              fsal_attrib_list_t * pattr, nfs_fh4 * objFH, char *buff)
+{
+  uint32_t file_type;
+
+  switch (pattr->type)
+    {
+    case FSAL_TYPE_FILE:
+    case FSAL_TYPE_XATTR:
+      file_type = NF4REG;
+      break;
+
+    case FSAL_TYPE_DIR:
+      file_type = NF4DIR;
+      break;
+
+    case FSAL_TYPE_BLK:
+      file_type = NF4BLK;
+      break;
+
+    case FSAL_TYPE_CHR:
+      file_type = NF4CHR;
+      break;
+
+    case FSAL_TYPE_LNK:
+      file_type = NF4LNK;
+      break;
+
+    case FSAL_TYPE_SOCK:
+      file_type = NF4SOCK;
+      break;
+
+    case FSAL_TYPE_FIFO:
+      file_type = NF4FIFO;
+      break;
+
+    default:
+      /* For wanting of a better solution (junctions) */
+      file_type = 0;
+      break;
+    }
+
+  return nfs4_encode_uint32(buff, file_type);
+}                               /* nfs4_encode_type */
+
+static u_int nfs4_encode_fh_expire_type(exportlist_t * pexport,
+                                        fsal_attrib_list_t * pattr,
+                                        nfs_fh4 * objFH, char *buff)
+{
+  if(nfs_param.nfsv4_param.fh_expire == TRUE)
+    return nfs4_encode_uint32(buff, FH4_VOLATILE_ANY);
+  else
+    return nfs4_encode_uint32(buff, FH4_PERSISTENT);
+}                               /* nfs4_encode_fh_expire_type */
+
+static u_int nfs4_encode_change(exportlist_t * pexport,
+                                fsal_attrib_list_t * pattr, nfs_fh4 * objFH, char *buff)
+{
+  return nfs4_encode_uint64(buff, (uint64_t) pattr->change);
+}                               /* nfs4_encode_change */
+
+static u_int nfs4_encode_size(exportlist_t * pexport,
+                              fsal_attrib_list_t * pattr, nfs_fh4 * objFH, char *buff)
+{
+  return nfs4_encode_uint64(buff, (uint64_t) pattr->filesize);
+}                               /* nfs4_encode_size */
+
+static u_int nfs4_encode_true(exportlist_t * pexport,
+                              fsal_attrib_list_t * pattr, nfs_fh4 * objFH, char *buff)
+{
+  return nfs4_encode_uint32(buff, TRUE);
+}                               /* nfs4_encode_true */
+
+static u_int nfs4_encode_false(exportlist_t * pexport,
+                               fsal_attrib_list_t * pattr, nfs_fh4 * objFH, char *buff)
+{
+  return nfs4_encode_uint32(buff, FALSE);
+}                               /* nfs4_encode_false */
+
+static u_int nfs4_encode_fsid(exportlist_t * pexport,
+                              fsal_attrib_list_t * pattr, nfs_fh4 * objFH, char *buff)
+{
+  uint64_t major = nfs_htonl64((uint64_t) pexport->filesystem_id.major);
+  uint64_t minor = nfs_htonl64((uint64_t) pexport->filesystem_id.minor);
+
+  /* A directory attached to a referral has a different fsid */
+  if(nfs4_Is_Fh_Referral(objFH))
+    {
+      major = ~major;
+      minor = ~minor;
+    }
+
+  memcpy(buff, &major, sizeof(uint64_t));
+  memcpy(buff + sizeof(uint64_t), &minor, sizeof(uint64_t));
+
+  return 2 * sizeof(uint64_t);
+}                               /* nfs4_encode_fsid */
+
+static u_int nfs4_encode_rdattr_error(exportlist_t * pexport,
+                                      fsal_attrib_list_t * pattr,
+                                      nfs_fh4 * objFH, char *buff)
+{
+  return nfs4_encode_uint32(buff, NFS4_OK);
+}                               /* nfs4_encode_rdattr_error */
+
+static u_int nfs4_encode_aclsupport(exportlist_t * pexport,
+                                    fsal_attrib_list_t * pattr,
+                                    nfs_fh4 * objFH, char *buff)
+{
+#ifdef _USE_NFS4_ACL
+  return nfs4_encode_uint32(buff, ACL4_SUPPORT_ALLOW_ACL | ACL4_SUPPORT_DENY_ACL);
+#else
+  return nfs4_encode_uint32(buff, 0);
+#endif
+}                               /* nfs4_encode_aclsupport */
+
+static u_int nfs4_encode_filehandle(exportlist_t * pexport,
+                                   fsal_attrib_list_t * pattr,
+                                   nfs_fh4 * objFH, char *buff)
+{
+  u_int deltalen = 0;
+
+  if(objFH->nfs_fh4_len % 4 != 0)
+    deltalen = 4 - objFH->nfs_fh4_len % 4;
+
+  nfs4_encode_uint32(buff, objFH->nfs_fh4_len);
+  memcpy(buff + sizeof(u_int), objFH->nfs_fh4_val, objFH->nfs_fh4_len);
+  memset(buff + sizeof(u_int) + objFH->nfs_fh4_len, 0, deltalen);
+
+  return sizeof(u_int) + objFH->nfs_fh4_len + deltalen;
+}                               /* nfs4_encode_filehandle */
+
+static u_int nfs4_encode_fileid(exportlist_t * pexport,
+                                fsal_attrib_list_t * pattr, nfs_fh4 * objFH, char *buff)
+{
+  return nfs4_encode_uint64(buff, pattr->fileid);
+}                               /* nfs4_encode_fileid */
+
+static u_int nfs4_encode_maxfilesize(exportlist_t * pexport,
+                                     fsal_attrib_list_t * pattr,
+                                     nfs_fh4 * objFH, char *buff)
+{
+  return nfs4_encode_uint64(buff, FSINFO_MAX_FILESIZE);
+}                               /* nfs4_encode_maxfilesize */
+
+static u_int nfs4_encode_mimetype(exportlist_t * pexport,
+                                  fsal_attrib_list_t * pattr,
+                                  nfs_fh4 * objFH, char *buff)
+{
+  /* Not supported for the moment */
+  memset(buff, 0, fattr4tab[FATTR4_MIMETYPE].size_fattr4);
+  return fattr4tab[FATTR4_MIMETYPE].size_fattr4;
+}                               /* nfs4_encode_mimetype */
+
+static u_int nfs4_encode_mode(exportlist_t * pexport,
+                              fsal_attrib_list_t * pattr, nfs_fh4 * objFH, char *buff)
+{
+  return nfs4_encode_uint32(buff, (fattr4_mode) fsal2unix_mode(pattr->mode));
+}                               /* nfs4_encode_mode */
+
+static u_int nfs4_encode_numlinks(exportlist_t * pexport,
+                                  fsal_attrib_list_t * pattr,
+                                  nfs_fh4 * objFH, char *buff)
+{
+  return nfs4_encode_uint32(buff, (fattr4_numlinks) pattr->numlinks);
+}                               /* nfs4_encode_numlinks */
+
+static u_int nfs4_encode_owner(exportlist_t * pexport,
+                               fsal_attrib_list_t * pattr, nfs_fh4 * objFH, char *buff)
+{
+  fattr4_owner file_owner;
+  u_int len;
+
+  if(uid2utf8(pattr->owner, &file_owner) != 0)
+    return 0;
+
+  len = nfs4_encode_utf8(buff, &file_owner);
+  Mem_Free((char *)file_owner.utf8string_val);
+
+  return len;
+}                               /* nfs4_encode_owner */
+
+static u_int nfs4_encode_owner_group(exportlist_t * pexport,
+                                     fsal_attrib_list_t * pattr,
+                                     nfs_fh4 * objFH, char *buff)
+{
+  fattr4_owner_group file_owner_group;
+  u_int len;
+
+  if(gid2utf8(pattr->group, &file_owner_group) != 0)
+    return 0;
+
+  len = nfs4_encode_utf8(buff, &file_owner_group);
+  Mem_Free((char *)file_owner_group.utf8string_val);
+
+  return len;
+}                               /* nfs4_encode_owner_group */
+
+static u_int nfs4_encode_quota_avail_hard(exportlist_t * pexport,
+                                          fsal_attrib_list_t * pattr,
+                                          nfs_fh4 * objFH, char *buff)
+{
+  return nfs4_encode_uint64(buff, NFS_V4_MAX_QUOTA_HARD);
+}                               /* nfs4_encode_quota_avail_hard */
+
+static u_int nfs4_encode_quota_avail_soft(exportlist_t * pexport,
+                                          fsal_attrib_list_t * pattr,
+                                          nfs_fh4 * objFH, char *buff)
+{
+  return nfs4_encode_uint64(buff, NFS_V4_MAX_QUOTA_SOFT);
+}                               /* nfs4_encode_quota_avail_soft */
+
+static u_int nfs4_encode_rawdev(exportlist_t * pexport,
+                                fsal_attrib_list_t * pattr, nfs_fh4 * objFH, char *buff)
+{
+  nfs4_encode_uint32(buff, pattr->rawdev.major);
+  nfs4_encode_uint32(buff + sizeof(uint32_t), pattr->rawdev.minor);
+  return 2 * sizeof(uint32_t);
+}                               /* nfs4_encode_rawdev */
+
+static u_int nfs4_encode_space_used(exportlist_t * pexport,
+                                    fsal_attrib_list_t * pattr,
+                                    nfs_fh4 * objFH, char *buff)
+{
+  return nfs4_encode_uint64(buff, (uint64_t) pattr->spaceused);
+}                               /* nfs4_encode_space_used */
+
+static u_int nfs4_encode_time_access(exportlist_t * pexport,
+                                     fsal_attrib_list_t * pattr,
+                                     nfs_fh4 * objFH, char *buff)
+{
+  return nfs4_encode_nfstime4(buff, (int64_t) pattr->atime.seconds,
+                              (uint32_t) pattr->atime.nseconds);
+}                               /* nfs4_encode_time_access */
+
+static u_int nfs4_encode_time_epoch(exportlist_t * pexport,
+                                    fsal_attrib_list_t * pattr,
+                                    nfs_fh4 * objFH, char *buff)
+{
+  /* No time backup nor time create, return unix's beginning of time */
+  return nfs4_encode_nfstime4(buff, 0LL, 0);
+}                               /* nfs4_encode_time_epoch */
+
+static u_int nfs4_encode_time_delta(exportlist_t * pexport,
+                                    fsal_attrib_list_t * pattr,
+                                    nfs_fh4 * objFH, char *buff)
+{
+  return nfs4_encode_nfstime4(buff, 1LL, 0);
+}                               /* nfs4_encode_time_delta */
+
+static u_int nfs4_encode_time_metadata(exportlist_t * pexport,
+                                       fsal_attrib_list_t * pattr,
+                                       nfs_fh4 * objFH, char *buff)
+{
+  return nfs4_encode_nfstime4(buff, (int64_t) pattr->ctime.seconds,
+                              pattr->ctime.nseconds);
+}                               /* nfs4_encode_time_metadata */
+
+static u_int nfs4_encode_time_modify(exportlist_t * pexport,
+                                     fsal_attrib_list_t * pattr,
+                                     nfs_fh4 * objFH, char *buff)
+{
+  return nfs4_encode_nfstime4(buff, (int64_t) pattr->mtime.seconds,
+                              pattr->mtime.nseconds);
+}                               /* nfs4_encode_time_modify */
+
+/* The encoders, by attribute. Attributes without one have no plan */
+static const struct
+{
+  nfs4_fattr_encoder_t encode;
+  int variable;                 /* TRUE if the encoded size depends on the object */
+} nfs4_fattr_encoders[NFS4_FATTR_PLAN_MAX_ENTRIES] =
+{
+  [FATTR4_SUPPORTED_ATTRS] = {nfs4_encode_supported_attrs, FALSE},
+  [FATTR4_TYPE] = {nfs4_encode_type, FALSE},
+  [FATTR4_FH_EXPIRE_TYPE] = {nfs4_encode_fh_expire_type, FALSE},
+  [FATTR4_CHANGE] = {nfs4_encode_change, FALSE},
+  [FATTR4_SIZE] = {nfs4_encode_size, FALSE},
+  [FATTR4_LINK_SUPPORT] = {nfs4_encode_true, FALSE},
+  [FATTR4_SYMLINK_SUPPORT] = {nfs4_encode_true, FALSE},
+  [FATTR4_NAMED_ATTR] = {nfs4_encode_false, FALSE},
+  [FATTR4_FSID] = {nfs4_encode_fsid, FALSE},
+  [FATTR4_UNIQUE_HANDLES] = {nfs4_encode_true, FALSE},
+  [FATTR4_RDATTR_ERROR] = {nfs4_encode_rdattr_error, FALSE},
+  [FATTR4_ACLSUPPORT] = {nfs4_encode_aclsupport, FALSE},
+  [FATTR4_ARCHIVE] = {nfs4_encode_false, FALSE},
+  [FATTR4_CANSETTIME] = {nfs4_encode_true, FALSE},
+  [FATTR4_FILEHANDLE] = {nfs4_encode_filehandle, TRUE},
+  [FATTR4_FILEID] = {nfs4_encode_fileid, FALSE},
+  [FATTR4_HIDDEN] = {nfs4_encode_false, FALSE},
+  [FATTR4_HOMOGENEOUS] = {nfs4_encode_true, FALSE},
+  [FATTR4_MAXFILESIZE] = {nfs4_encode_maxfilesize, FALSE},
+  [FATTR4_MIMETYPE] = {nfs4_encode_mimetype, FALSE},
+  [FATTR4_MODE] = {nfs4_encode_mode, FALSE},
+  [FATTR4_NUMLINKS] = {nfs4_encode_numlinks, FALSE},
+  [FATTR4_OWNER] = {nfs4_encode_owner, TRUE},
+  [FATTR4_OWNER_GROUP] = {nfs4_encode_owner_group, TRUE},
+  [FATTR4_QUOTA_AVAIL_HARD] = {nfs4_encode_quota_avail_hard, FALSE},
+  [FATTR4_QUOTA_AVAIL_SOFT] = {nfs4_encode_quota_avail_soft, FALSE},
+  [FATTR4_QUOTA_USED] = {nfs4_encode_size, FALSE},
+  [FATTR4_RAWDEV] = {nfs4_encode_rawdev, FALSE},
+  [FATTR4_SPACE_USED] = {nfs4_encode_space_used, FALSE},
+  [FATTR4_SYSTEM] = {nfs4_encode_false, FALSE},
+  [FATTR4_TIME_ACCESS] = {nfs4_encode_time_access, FALSE},
+  [FATTR4_TIME_BACKUP] = {nfs4_encode_time_epoch, FALSE},
+  [FATTR4_TIME_CREATE] = {nfs4_encode_time_epoch, FALSE},
+  [FATTR4_TIME_DELTA] = {nfs4_encode_time_delta, FALSE},
+  [FATTR4_TIME_METADATA] = {nfs4_encode_time_metadata, FALSE},
+  [FATTR4_TIME_MODIFY] = {nfs4_encode_time_modify, FALSE},
+  [FATTR4_MOUNTED_ON_FILEID] = {nfs4_encode_fileid, FALSE}
+};
+
+/**
+ *
+ * nfs4_fattr_plan_compile: compiles a bitmap into a plan.
+ *
+ * Compiles a bitmap into a plan.
+ *
+ * @param bitmap0 [IN]  first word of the bitmap.
+ * @param bitmap1 [IN]  second word of the bitmap.
+ * @param pplan   [OUT] the compiled plan.
+ *
+ * @return 1 if successful, 0 if an attribute of the bitmap has no encoder.
+ *
+ */
+static int nfs4_fattr_plan_compile(uint32_t bitmap0, uint32_t bitmap1,
+                                   nfs4_fattr_plan_t * pplan)
+{
+  uint32_t supported[3];
+  uint32_t attr;
+  nfs4_fattr_plan_entry_t *pentry;
+
+  pplan->bitmap[0] = bitmap0;
+  pplan->bitmap[1] = bitmap1;
+  pplan->result[0] = 0;
+  pplan->result[1] = 0;
+  pplan->nb_entries = 0;
+  pplan->nb_prefix = 0;
+  pplan->prefix_len = 0;
+
+  for(attr = 0; attr < NFS4_FATTR_PLAN_MAX_ENTRIES; attr++)
+    {
+      if(!((attr < 32 ? bitmap0 : bitmap1) & (1U << (attr % 32))))
+        continue;
+
+      /* Erroneous value... skipped, as nfs4_FSALattr_To_Fattr_Switch does */
+      if(attr > NFS4_FATTR_PLAN_MAX_ATTR)
+        continue;
+
+      if(nfs4_fattr_encoders[attr].encode == NULL)
+        return 0;
+
+      pentry = &pplan->entries[pplan->nb_entries++];
+      pentry->attr = attr;
+      pentry->encode = nfs4_fattr_encoders[attr].encode;
+
+      if(nfs4_fattr_encoders[attr].variable)
+        pentry->size = 0;
+      else if(attr == FATTR4_SUPPORTED_ATTRS)
+        pentry->size = sizeof(uint32_t) * (nfs4_supported_attrs_bitmap(supported) + 1);
+      else
+        pentry->size = fattr4tab[attr].size_fattr4;
+
+      pplan->result[attr / 32] |= 1U << (attr % 32);
+    }
+
+  /* The fixed size prefix, encoded at known offsets */
+  while(pplan->nb_prefix < pplan->nb_entries && pplan->entries[pplan->nb_prefix].size != 0)
+    pplan->prefix_len += pplan->entries[pplan->nb_prefix++].size;
+
+  return 1;
+}                               /* nfs4_fattr_plan_compile */
+
+/**
+ *
+ * nfs4_Fattr_Plan: gets the plan of a bitmap.
+ *
+ * Gets the plan of a bitmap from the plan cache, or compiles it. A compiled
+ * plan is put in the cache if its slot is still empty.
+ *
+ * @param Bitmap   [IN]  the requested attributes.
+ * @param pscratch [OUT] where to compile the plan if it is not cached.
+ *
+ * @return the plan, or NULL if the bitmap can't be encoded through a plan.
+ *
+ */
+nfs4_fattr_plan_t *nfs4_Fattr_Plan(bitmap4 * Bitmap, nfs4_fattr_plan_t * pscratch)
+{
+  uint32_t bitmap0 = 0;
+  uint32_t bitmap1 = 0;
+  uint_t i;
+  nfs4_fattr_plan_t **pslot;
+  nfs4_fattr_plan_t *pplan;
+  nfs4_fattr_plan_t *pnew;
+
+  if(Bitmap->bitmap4_len > 0)
+    bitmap0 = Bitmap->bitmap4_val[0];
+  if(Bitmap->bitmap4_len > 1)
+    bitmap1 = Bitmap->bitmap4_val[1];
+
+  for(i = 2; i < Bitmap->bitmap4_len; i++)
+    if(Bitmap->bitmap4_val[i] != 0)
+      return NULL;
+
+  pslot = &nfs4_fattr_plan_cache[((bitmap0 * 2654435761U) ^ (bitmap1 * 40503U)) &
+                                 (NFS4_FATTR_PLAN_CACHE_SIZE - 1)];
+
+  pplan = *pslot;
+  if(pplan != NULL && pplan->bitmap[0] == bitmap0 && pplan->bitmap[1] == bitmap1)
+    return pplan;
+
+  if(!nfs4_fattr_plan_compile(bitmap0, bitmap1, pscratch))
+    return NULL;
+
+  if(pplan == NULL)
+    {
+      /* Plans are published once and never modified nor freed */
+      if((pnew = (nfs4_fattr_plan_t *) Mem_Alloc_Label(sizeof(nfs4_fattr_plan_t),
+                                                         "nfs4_fattr_plan")) != NULL)
+        {
+          memcpy(pnew, pscratch, sizeof(nfs4_fattr_plan_t));
+          if(!__sync_bool_compare_and_swap(pslot, NULL, pnew))
+            Mem_Free(pnew);
+          else
+            LogFullDebug(COMPONENT_NFS_V4,
+                         "Cached attributes plan for bitmap %x|%x: %u entries, prefix of %u entries, %u bytes",
+                         bitmap0, bitmap1, pnew->nb_entries, pnew->nb_prefix,
+                         pnew->prefix_len);
+        }
+    }
+
+  return pscratch;
+}                               /* nfs4_Fattr_Plan */
+
+/**
+ *
+ * nfs4_FSALattr_To_Fattr_Plan: Converts FSAL Attributes to NFSv4 Fattr buffer through a plan.
+ *
+ * Converts FSAL Attributes to NFSv4 Fattr buffer through a plan. The
+ * result is the same as nfs4_FSALattr_To_Fattr_Switch's for the bitmap of the plan.
+ *
+ * @param pplan   [IN]  the plan of the requested attributes.
+ * @param pexport [IN]  the related export entry.
+ * @param pattr   [IN]  pointer to FSAL attributes.
+ * @param Fattr   [OUT] NFSv4 Fattr buffer
+ * @param objFH   [IN]  the object's file handle.
+ *
+ * @return -1 if failed, 0 if successful.
+ *
+ */
+int nfs4_FSALattr_To_Fattr_Plan(nfs4_fattr_plan_t * pplan,
+                                exportlist_t * pexport,
+                                fsal_attrib_list_t * pattr,
+                                fattr4 * Fattr, nfs_fh4 * objFH)
+{
+  char attrvalsBuffer[ATTRVALS_BUFFLEN];
+  char *buff = attrvalsBuffer;
+  uint32_t result[2];
+  u_int LastOffset = 0;
+  u_int len;
+  uint_t i;
+
+  result[0] = pplan->result[0];
+  result[1] = pplan->result[1];
+
+  /* Without variable size attributes, the size of the reply is known */
+  if(pplan->nb_prefix == pplan->nb_entries && pplan->prefix_len != 0)
+    {
+      if((buff = Mem_Alloc_Label(pplan->prefix_len, "FSALattr_To_Fattr:attrvals")) == NULL)
+        return -1;
+    }
+
+  /* These attributes never fail and fit in the buffer */
+  for(i = 0; i < pplan->nb_prefix; i++)
+    LastOffset += pplan->entries[i].encode(pexport, pattr, objFH, buff + LastOffset);
+
+  for(; i < pplan->nb_entries; i++)
+    {
+      if((len = pplan->entries[i].encode(pexport, pattr, objFH, buff + LastOffset)) == 0)
+        {
+          result[pplan->entries[i].attr / 32] &= ~(1U << (pplan->entries[i].attr % 32));
+          continue;
+        }
+
+      /* Be carefull not to get out of attrvalsBuffer */
+      if((LastOffset += len) > ATTRVALS_BUFFLEN)
+        return -1;
+    }
+
+  /* Set the bitmap for result */
+  if((Fattr->attrmask.bitmap4_val = (uint32_t *) Mem_Alloc_Label(2 * sizeof(uint32_t),
+                                                                 "FSALattr_To_Fattr:bitmap")) == NULL)
+    {
+      if(buff != attrvalsBuffer)
+        Mem_Free(buff);
+      return -1;
+    }
+
+  Fattr->attrmask.bitmap4_val[0] = result[0];
+  Fattr->attrmask.bitmap4_val[1] = result[1];
+  Fattr->attrmask.bitmap4_len = (result[1] != 0) ? 2 : 1;
+
+  /* Set the attrlist4 */
+  Fattr->attr_vals.attrlist4_len = LastOffset;
+  if(buff != attrvalsBuffer)
+    Fattr->attr_vals.attrlist4_val = buff;
+  else if(LastOffset != 0)      /* No need to allocate an empty buffer */
+    {
+      if((Fattr->attr_vals.attrlist4_val =
+          Mem_Alloc_Label(LastOffset, "FSALattr_To_Fattr:attrvals")) == NULL)
+        return -1;
+      memcpy(Fattr->attr_vals.attrlist4_val, attrvalsBuffer, LastOffset);
+    }
+
+  return 0;
+}                               /* nfs4_FSALattr_To_Fattr_Plan */
@@ -135,7 +135,12 @@ int nfs4_op_access(struct nfs_argop4 *op, compound_data_t * data, struct nfs_res
     }
 
   /* Get the attributes for the object */
-  cache_inode_get_attributes(data->current_entry, &attr);
+  if(cache_inode_get_attributes_lockless(data->current_entry, &attr) != 0)
+    {
+      P_r(&data->current_entry->lock);
+      cache_inode_get_attributes(data->current_entry, &attr);
+      V_r(&data->current_entry->lock);
+    }
 
   /* determine the rights to be tested in FSAL */
 
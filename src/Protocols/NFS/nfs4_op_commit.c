@@ -89,6 +89,7 @@ int nfs4_op_commit(struct nfs_argop4 *op, compound_data_t * data, struct nfs_res
 
   fsal_attrib_list_t attr;
   cache_inode_status_t cache_status;
+  uint64_t typeofcommit;
 
   /* for the moment, read/write are not done asynchronously, no commit is necessary */
   resp->resop = NFS4_OP_COMMIT;
@@ -138,9 +139,12 @@ int nfs4_op_commit(struct nfs_argop4 *op, compound_data_t * data, struct nfs_res
       return res_COMMIT4.status;
     }
 
-  // FIX ME!! At the moment we just assume the user is _not_ using
-  // the ganesha unsafe buffer. In the future, a check based on
-  // export config params (similar to nfs3_Commit.c) should be made.
+  /* Same choice as in nfs4_op_write */
+  if(data->pexport->use_ganesha_write_buffer == TRUE)
+    typeofcommit = FSAL_UNSAFE_WRITE_TO_GANESHA_BUFFER;
+  else
+    typeofcommit = FSAL_UNSAFE_WRITE_TO_FS_BUFFER;
+
   if(cache_inode_commit(data->current_entry,
                         arg_COMMIT4.offset,
                         arg_COMMIT4.count,
@@ -148,10 +152,10 @@ int nfs4_op_commit(struct nfs_argop4 *op, compound_data_t * data, struct nfs_res
                         data->ht,
                         data->pclient,
                         data->pcontext,
-                        FSAL_UNSAFE_WRITE_TO_FS_BUFFER,
+                        typeofcommit,
                         &cache_status) != CACHE_INODE_SUCCESS)
     {
-      res_COMMIT4.status = NFS4ERR_INVAL;
+      res_COMMIT4.status = nfs4_Errno(cache_status);
       return res_COMMIT4.status;
     }
 
@@ -62,6 +62,8 @@
 #include "nfs_creds.h"
 #include "nfs_proto_functions.h"
 #include "nfs_tools.h"
+#include "nfs_file_handle.h"
+#include "sal_functions.h"
 
 /**
  * nfs4_op_delegreturn: The NFS4_OP_DELEGRETURN
@@ -82,11 +84,73 @@ int nfs4_op_delegreturn(struct nfs_argop4 *op,
                         compound_data_t * data, struct nfs_resop4 *resp)
 {
   char __attribute__ ((__unused__)) funcname[] = "nfs4_op_delegreturn";
+  state_t        * pstate_found = NULL;
+  state_status_t   state_status;
+  int              rc;
 
-  /* Lock are not supported */
   resp->resop = NFS4_OP_DELEGRETURN;
   res_DELEGRETURN4.status = NFS4_OK;
 
+  /* If there is no FH */
+  if(nfs4_Is_Fh_Empty(&(data->currentFH)))
+    {
+      res_DELEGRETURN4.status = NFS4ERR_NOFILEHANDLE;
+      return res_DELEGRETURN4.status;
+    }
+
+  /* If the filehandle is invalid */
+  if(nfs4_Is_Fh_Invalid(&(data->currentFH)))
+    {
+      res_DELEGRETURN4.status = NFS4ERR_BADHANDLE;
+      return res_DELEGRETURN4.status;
+    }
+
+  /* Tests if the Filehandle is expired (for volatile filehandle) */
+  if(nfs4_Is_Fh_Expired(&(data->currentFH)))
+    {
+      res_DELEGRETURN4.status = NFS4ERR_FHEXPIRED;
+      return res_DELEGRETURN4.status;
+    }
+
+  if(data->current_entry == NULL)
+    {
+      res_DELEGRETURN4.status = NFS4ERR_SERVERFAULT;
+      return res_DELEGRETURN4.status;
+    }
+
+  /* Only files are delegated */
+  if(data->current_entry->internal_md.type != REGULAR_FILE)
+    {
+      res_DELEGRETURN4.status = NFS4ERR_INVAL;
+      return res_DELEGRETURN4.status;
+    }
+
+  /* Check stateid correctness and get pointer to state */
+  if((rc = nfs4_Check_Stateid(&arg_DELEGRETURN4.deleg_stateid,
+                              data->current_entry,
+                              0LL,
+                              &pstate_found,
+                              data,
+                              STATEID_NO_SPECIAL,
+                              "DELEGRETURN")) != NFS4_OK)
+    {
+      res_DELEGRETURN4.status = rc;
+      return res_DELEGRETURN4.status;
+    }
+
+  if(pstate_found->state_type != STATE_TYPE_DELEG)
+    {
+      res_DELEGRETURN4.status = NFS4ERR_BAD_STATEID;
+      return res_DELEGRETURN4.status;
+    }
+
+  /* A revoked delegation is dropped as well, but the client learns it was late */
+  if(pstate_found->state_data.deleg.d_revoked)
+    res_DELEGRETURN4.status = NFS4ERR_EXPIRED;
+
+  if(state_del(pstate_found, data->pclient, &state_status) != STATE_SUCCESS)
+    res_DELEGRETURN4.status = nfs4_Errno_state(state_status);
+
   return res_DELEGRETURN4.status;
 }                               /* nfs4_op_delegreturn */
 
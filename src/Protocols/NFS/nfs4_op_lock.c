@@ -339,6 +339,22 @@ int nfs4_op_lock(struct nfs_argop4 *op, compound_data_t * data, struct nfs_resop
       return res_LOCK4.status;
     }
 
+  /* A v4.0 client has no RECLAIM_COMPLETE, its first regular lock tells
+   * it is done reclaiming */
+  if(!arg_LOCK4.reclaim)
+    nfs4_recovery_reclaim_complete(popen_owner->so_owner.so_nfs4_owner.so_clientid);
+
+  /* Reclaims only during the grace period, new locks only after it */
+  if((res_LOCK4.status =
+      nfs4_recovery_check_reclaim(popen_owner->so_owner.so_nfs4_owner.so_clientid,
+                                  arg_LOCK4.reclaim)) != NFS4_OK)
+    {
+      /* Save the response in the lock or open owner */
+      Copy_nfs4_state_req(presp_owner, seqid, op, data, resp, tag);
+
+      return res_LOCK4.status;
+    }
+
   /* Check for range overflow.
    * Comparing beyond 2^64 is not possible int 64 bits precision,
    * but off+len > 2^64-1 is equivalent to len > 2^64-1 - off
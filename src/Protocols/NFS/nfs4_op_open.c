@@ -103,6 +103,8 @@ int nfs4_op_open(struct nfs_argop4 *op, compound_data_t * data, struct nfs_resop
   state_t                 * pstate_previous_iterate = NULL;
   state_nfs4_owner_name_t   owner_name;
   state_owner_t           * powner = NULL;
+  state_t                 * pdeleg_state = NULL;
+  open_read_delegation4   * pread_deleg = NULL;
   const char              * tag = "OPEN";
 
   newfh4.nfs_fh4_val = newfh4_val;
@@ -339,6 +341,20 @@ int nfs4_op_open(struct nfs_argop4 *op, compound_data_t * data, struct nfs_resop
           return res_OPEN4.status;
         }
 
+      /* A v4.0 client has no RECLAIM_COMPLETE, its first regular open tells
+       * it is done reclaiming */
+      nfs4_recovery_reclaim_complete(arg_OPEN4.owner.clientid);
+
+      /* No new open during the grace period */
+      if((res_OPEN4.status =
+          nfs4_recovery_check_reclaim(arg_OPEN4.owner.clientid, FALSE)) != NFS4_OK)
+        {
+          /* Save the response in the open owner */
+          Copy_nfs4_state_req(powner, arg_OPEN4.seqid, op, data, resp, tag);
+
+          return res_OPEN4.status;
+        }
+
       /* Is this open_owner known ? */
       if(powner == NULL)
         {
@@ -525,7 +541,10 @@ int nfs4_op_open(struct nfs_argop4 *op, compound_data_t * data, struct nfs_resop
                                &pfile_state,
                                &state_status) != STATE_SUCCESS)
                     {
-                      res_OPEN4.status = NFS4ERR_SHARE_DENIED;
+                      if(state_status == STATE_DELEG_RECALLED)
+                        res_OPEN4.status = NFS4ERR_DELAY;   /* Delegations are being recalled */
+                      else
+                        res_OPEN4.status = NFS4ERR_SHARE_DENIED;
 
                       /* Save the response in the open owner */
                       Copy_nfs4_state_req(powner, arg_OPEN4.seqid, op, data, resp, tag);
@@ -834,7 +853,10 @@ int nfs4_op_open(struct nfs_argop4 *op, compound_data_t * data, struct nfs_resop
                        data->pcontext,
                        &pfile_state, &state_status) != STATE_SUCCESS)
             {
-              res_OPEN4.status = NFS4ERR_SHARE_DENIED;
+              if(state_status == STATE_DELEG_RECALLED)
+                res_OPEN4.status = NFS4ERR_DELAY;   /* Delegations are being recalled */
+              else
+                res_OPEN4.status = NFS4ERR_SHARE_DENIED;
 
               /* Save the response in the open owner */
               Copy_nfs4_state_req(powner, arg_OPEN4.seqid, op, data, resp, tag);
@@ -1140,7 +1162,26 @@ int nfs4_op_open(struct nfs_argop4 *op, compound_data_t * data, struct nfs_resop
                            &pfile_state,
                            &state_status) != STATE_SUCCESS)
                 {
-                  res_OPEN4.status = NFS4ERR_SHARE_DENIED;
+                  if(state_status == STATE_DELEG_RECALLED)
+                    res_OPEN4.status = NFS4ERR_DELAY;   /* Delegations are being recalled */
+                  else
+                    res_OPEN4.status = NFS4ERR_SHARE_DENIED;
+
+                  /* Save the response in the open owner */
+                  Copy_nfs4_state_req(powner, arg_OPEN4.seqid, op, data, resp, tag);
+
+                  return res_OPEN4.status;
+                }
+            }
+          else if(arg_OPEN4.share_access & OPEN4_SHARE_ACCESS_WRITE)
+            {
+              /* The open state is reused for writing, other clients lose their delegations */
+              if(state_deleg_break(pentry_newfile,
+                                   arg_OPEN4.owner.clientid,
+                                   data->pclient,
+                                   &state_status) != STATE_SUCCESS)
+                {
+                  res_OPEN4.status = nfs4_Errno_state(state_status);
 
                   /* Save the response in the open owner */
                   Copy_nfs4_state_req(powner, arg_OPEN4.seqid, op, data, resp, tag);
@@ -1180,6 +1221,17 @@ int nfs4_op_open(struct nfs_argop4 *op, compound_data_t * data, struct nfs_resop
       break;
 
     case CLAIM_PREVIOUS:
+      /* Only the clients known to the recovery journal reclaim, during the
+       * grace period */
+      if((res_OPEN4.status =
+          nfs4_recovery_check_reclaim(arg_OPEN4.owner.clientid, TRUE)) != NFS4_OK)
+        {
+          /* Save the response in the open owner */
+          Copy_nfs4_state_req(powner, arg_OPEN4.seqid, op, data, resp, tag);
+
+          return res_OPEN4.status;
+        }
+
       // TODO FSF: doesn't this need to do something to re-establish state?
       powner = NULL;
       break;
@@ -1269,9 +1321,33 @@ int nfs4_op_open(struct nfs_argop4 *op, compound_data_t * data, struct nfs_resop
       (changeid4) pentry_parent->internal_md.mod_time;
   res_OPEN4.OPEN4res_u.resok4.cinfo.atomic = TRUE;
 
-  /* No delegation */
+  /* A read delegation, if the client keeps opening this file */
   res_OPEN4.OPEN4res_u.resok4.delegation.delegation_type = OPEN_DELEGATE_NONE;
 
+  if(arg_OPEN4.claim.claim == CLAIM_NULL &&
+     nfs_param.nfsv4_param.allow_delegations &&
+     nfs4_cb_recall_usable(&nfs_clientid) &&
+     state_deleg_grant(pentry_newfile,
+                       powner,
+                       arg_OPEN4.share_access,
+                       &data->currentFH,
+                       data->pclient,
+                       data->pcontext,
+                       &pdeleg_state,
+                       &state_status) == STATE_SUCCESS)
+    {
+      pread_deleg = &res_OPEN4.OPEN4res_u.resok4.delegation.open_delegation4_u.read;
+
+      res_OPEN4.OPEN4res_u.resok4.delegation.delegation_type = OPEN_DELEGATE_READ;
+      pread_deleg->stateid.seqid = pdeleg_state->state_seqid;
+      memcpy(pread_deleg->stateid.other, pdeleg_state->stateid_other, OTHERSIZE);
+      pread_deleg->recall = FALSE;
+
+      /* No ACE: the client has to ask ACCESS before opening for someone else */
+      memset(&pread_deleg->permissions, 0, sizeof(nfsace4));
+      pread_deleg->permissions.type = ACE4_ACCESS_ALLOWED_ACE_TYPE;
+    }
+
   /* If server use OPEN_CONFIRM4, set the correct flag */
   if(powner->so_owner.so_nfs4_owner.so_confirmed == FALSE)
     {
@@ -93,6 +93,9 @@ int nfs4_op_readdir(struct nfs_argop4 *op,
   unsigned int num_entries;
 
   unsigned int i = 0;
+  nfs4_fattr_plan_t plan_scratch;
+  nfs4_fattr_plan_t *pplan;
+  int rc;
 
   bitmap4 RdAttrErrorBitmap = { 1, (uint32_t *) "\0\0\0\b" };   /* 0xB = 11 = FATTR4_RDATTR_ERROR */
   attrlist4 RdAttrErrorVals = { 0, NULL };      /* Nothing to be seen here */
@@ -268,6 +271,9 @@ int nfs4_op_readdir(struct nfs_argop4 *op,
         }
       memset((char *)entry_name_array, 0, num_entries * (FSAL_MAX_NAME_LEN + 1));
 
+      /* The requested attributes are compiled once for all the entries */
+      pplan = nfs4_Fattr_Plan(&(arg_READDIR4.attr_request), &plan_scratch);
+
       if((entry_nfs_array = (entry4 *) Mem_Alloc(num_entries * sizeof(entry4))) == NULL)
         {
           LogError(COMPONENT_NFS_V4, ERR_SYS, ERR_MALLOC, errno);
@@ -339,10 +345,19 @@ int nfs4_op_readdir(struct nfs_argop4 *op,
                 }
             }
 
-          if(nfs4_FSALattr_To_Fattr(data->pexport,
-                                    &attrlookup,
-                                    &(entry_nfs_array[i].attrs),
-                                    data, &entryFH, &(arg_READDIR4.attr_request)) != 0)
+          if(pplan != NULL)
+            rc = nfs4_FSALattr_To_Fattr_Plan(pplan,
+                                             data->pexport,
+                                             &attrlookup,
+                                             &(entry_nfs_array[i].attrs), &entryFH);
+          else
+            rc = nfs4_FSALattr_To_Fattr_Switch(data->pexport,
+                                               &attrlookup,
+                                               &(entry_nfs_array[i].attrs),
+                                               data, &entryFH,
+                                               &(arg_READDIR4.attr_request));
+
+          if(rc != 0)
             {
               /* Return the fattr4_rdattr_error , cf RFC3530, page 192 */
               entry_nfs_array[i].attrs.attrmask = RdAttrErrorBitmap;
@@ -63,6 +63,7 @@
 #include "nfs_proto_functions.h"
 #include "nfs_tools.h"
 #include "nfs_file_handle.h"
+#include "sal_functions.h"
 
 /**
  * nfs4_op_rename: The NFS4_OP_REMOVE operation.
@@ -83,11 +84,14 @@
 int nfs4_op_remove(struct nfs_argop4 *op, compound_data_t * data, struct nfs_resop4 *resp)
 {
   cache_entry_t *parent_entry = NULL;
+  cache_entry_t *pentry_victim = NULL;
 
   fsal_attrib_list_t attr_parent;
+  fsal_attrib_list_t attr_victim;
   fsal_name_t name;
 
   cache_inode_status_t cache_status;
+  state_status_t state_status;
 
   char __attribute__ ((__unused__)) funcname[] = "nfs4_op_remove";
 
@@ -175,6 +179,20 @@ int nfs4_op_remove(struct nfs_argop4 *op, compound_data_t * data, struct nfs_res
       return res_REMOVE4.status;
     }
 
+  /* A delegated file is recalled before it goes away */
+  if(nfs_param.nfsv4_param.allow_delegations &&
+     (pentry_victim = cache_inode_lookup(parent_entry,
+                                         &name,
+                                         &attr_victim,
+                                         data->ht,
+                                         data->pclient,
+                                         data->pcontext, &cache_status)) != NULL &&
+     state_deleg_break(pentry_victim, 0LL, data->pclient, &state_status) != STATE_SUCCESS)
+    {
+      res_REMOVE4.status = nfs4_Errno_state(state_status);
+      return res_REMOVE4.status;
+    }
+
   if((cache_status = cache_inode_remove(parent_entry,
                                         &name,
                                         &attr_parent,
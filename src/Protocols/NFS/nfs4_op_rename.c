@@ -63,6 +63,7 @@
 #include "nfs_proto_functions.h"
 #include "nfs_tools.h"
 #include "nfs_file_handle.h"
+#include "sal_functions.h"
 
 /**
  * nfs4_op_rename: The NFS4_OP_RENAME operation.
@@ -93,6 +94,7 @@ int nfs4_op_rename(struct nfs_argop4 *op, compound_data_t * data, struct nfs_res
   fsal_attrib_list_t attr_tst_src;
 
   cache_inode_status_t cache_status;
+  state_status_t state_status;
 
   fsal_status_t fsal_status;
 
@@ -321,6 +323,15 @@ int nfs4_op_rename(struct nfs_argop4 *op, compound_data_t * data, struct nfs_res
       return res_RENAME4.status;
     }
 
+  /* Delegations of the renamed file and of the file it replaces are recalled */
+  if(state_deleg_break(tst_entry_src, 0LL, data->pclient, &state_status) != STATE_SUCCESS ||
+     (tst_entry_dst != NULL &&
+      state_deleg_break(tst_entry_dst, 0LL, data->pclient, &state_status) != STATE_SUCCESS))
+    {
+      res_RENAME4.status = nfs4_Errno_state(state_status);
+      return res_RENAME4.status;
+    }
+
   /* Renaming dir into existing file should return NFS4ERR_EXIST */
   if(((tst_entry_src->internal_md.type == DIR_BEGINNING)
       || (tst_entry_src->internal_md.type == DIR_CONTINUE)) && ((tst_entry_dst != NULL)
@@ -61,6 +61,7 @@
 #include "nfs_creds.h"
 #include "nfs_proto_functions.h"
 #include "nfs_tools.h"
+#include "sal_functions.h"
 
 /**
  * 
@@ -97,7 +98,7 @@ int nfs4_op_renew(struct nfs_argop4 *op, compound_data_t * data, struct nfs_reso
   /* Is this an existing client id ? */
   if(nfs_client_id_get(arg_RENEW4.clientid, &nfs_clientid) == CLIENT_ID_SUCCESS)
     {
-      nfs_clientid.last_renew = time(NULL);
+      nfs4_lease_renew(arg_RENEW4.clientid);
       res_RENEW4.status = NFS4_OK;      /* Regular exit */
     }
   else
@@ -63,6 +63,7 @@
 #include "nfs_proto_functions.h"
 #include "nfs_tools.h"
 #include "nfs_file_handle.h"
+#include "sal_functions.h"
 
 /**
  * nfs4_op_rename: The NFS4_OP_SETATTR operation.
@@ -86,6 +87,8 @@ int nfs4_op_setattr(struct nfs_argop4 *op,
   fsal_attrib_list_t sattr;
   fsal_attrib_list_t parent_attr;
   cache_inode_status_t cache_status;
+  state_status_t state_status;
+  state_t *pstate_found = NULL;
   int rc = 0;
   char __attribute__ ((__unused__)) funcname[] = "nfs4_op_setattr";
 
@@ -143,6 +146,24 @@ int nfs4_op_setattr(struct nfs_argop4 *op,
       return res_SETATTR4.status;
     }
 
+  /* The attributes cached under a delegation are about to change, recall it.
+   * The client owning the stateid, if any, keeps its own delegation */
+  if(data->current_filetype == REGULAR_FILE)
+    {
+      if(!nfs4_State_Get_Pointer(arg_SETATTR4.stateid.other, &pstate_found))
+        pstate_found = NULL;
+
+      if(state_deleg_break(data->current_entry,
+                           (pstate_found != NULL && pstate_found->state_powner != NULL) ?
+                           pstate_found->state_powner->so_owner.so_nfs4_owner.so_clientid : 0LL,
+                           data->pclient,
+                           &state_status) != STATE_SUCCESS)
+        {
+          res_SETATTR4.status = nfs4_Errno_state(state_status);
+          return res_SETATTR4.status;
+        }
+    }
+
   /*
    * trunc may change Xtime so we have to start with trunc and finish
    * by the mtime and atime 
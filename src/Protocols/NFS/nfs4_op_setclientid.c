@@ -63,6 +63,7 @@
 #include "nfs_proto_functions.h"
 #include "nfs_file_handle.h"
 #include "nfs_tools.h"
+#include "sal_functions.h"
 
 /**
  *
@@ -218,6 +219,7 @@ int nfs4_op_setclientid(struct nfs_argop4 *op,
                        (unsigned int)ServerBootTime);
               nfs_clientid.confirmed = REBOOTED_CLIENT_ID;
               nfs_clientid.cb_program = arg_SETCLIENTID4.callback.cb_program;
+              nfs_clientid.cb_ident = arg_SETCLIENTID4.callback_ident;
               nfs_clientid.clientid = clientid;
               nfs_clientid.last_renew = 0;
 
@@ -296,6 +298,7 @@ int nfs4_op_setclientid(struct nfs_argop4 *op,
                (unsigned int)ServerBootTime);
       nfs_clientid.confirmed = UNCONFIRMED_CLIENT_ID;
       nfs_clientid.cb_program = arg_SETCLIENTID4.callback.cb_program;
+      nfs_clientid.cb_ident = arg_SETCLIENTID4.callback_ident;
       nfs_clientid.clientid = clientid;
       nfs_clientid.last_renew = 0;
       nfs_clientid.credential = data->credential;
@@ -308,6 +311,9 @@ int nfs4_op_setclientid(struct nfs_argop4 *op,
         }
     }
 
+  /* Start or renew the lease, an unconfirmed client is forgotten when it expires */
+  nfs4_lease_renew(clientid);
+
   res_SETCLIENTID4.SETCLIENTID4res_u.resok4.clientid = clientid;
   memset(res_SETCLIENTID4.SETCLIENTID4res_u.resok4.setclientid_confirm, 0,
          NFS4_VERIFIER_SIZE);
@@ -63,6 +63,7 @@
 #include "nfs_proto_functions.h"
 #include "nfs_file_handle.h"
 #include "nfs_tools.h"
+#include "sal_functions.h"
 
 /**
  *
@@ -132,9 +133,6 @@ int nfs4_op_setclientid_confirm(struct nfs_argop4 *op,
           /* Regular situation, set the client id confirmed and returns */
           nfs_clientid.confirmed = CONFIRMED_CLIENT_ID;
 
-          /* Set the time for the client id */
-          nfs_clientid.last_renew = time(NULL);
-
           /* Set the new value */
           if(nfs_client_id_set(clientid, nfs_clientid, &pworker->clientid_pool) !=
              CLIENT_ID_SUCCESS)
@@ -142,6 +140,9 @@ int nfs4_op_setclientid_confirm(struct nfs_argop4 *op,
               res_SETCLIENTID_CONFIRM4.status = NFS4ERR_SERVERFAULT;
               return res_SETCLIENTID_CONFIRM4.status;
             }
+
+          /* Journal the client, for the grace period of the next start */
+          nfs4_recovery_client_confirm(clientid, nfs_clientid.client_name);
         }
     }
   else
@@ -151,6 +152,8 @@ int nfs4_op_setclientid_confirm(struct nfs_argop4 *op,
       return res_SETCLIENTID_CONFIRM4.status;
     }
 
+  nfs4_lease_renew(clientid);
+
   /* Successful exit */
   res_SETCLIENTID_CONFIRM4.status = NFS4_OK;
   return res_SETCLIENTID_CONFIRM4.status;
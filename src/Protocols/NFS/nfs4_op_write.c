@@ -83,7 +83,7 @@ int nfs4_op_write(struct nfs_argop4 *op, compound_data_t * data, struct nfs_reso
   fsal_size_t              written_size;
   fsal_off_t               offset;
   fsal_boolean_t           eof_met;
-  bool_t                   stable_flag = TRUE;
+  uint64_t                 stable_flag = FSAL_SAFE_WRITE_TO_FS;
   caddr_t                  bufferdata;
   stable_how4              stable_how;
   cache_content_status_t   content_status;
@@ -253,6 +253,18 @@ int nfs4_op_write(struct nfs_argop4 *op, compound_data_t * data, struct nfs_reso
     }
   while(pstate_iterate != NULL);
 
+  /* Without an open state, delegations were not recalled by OPEN, do it now */
+  if(pstate_open == NULL &&
+     state_deleg_break(data->current_entry,
+                       (pstate_found != NULL) ?
+                       pstate_found->state_powner->so_owner.so_nfs4_owner.so_clientid : 0LL,
+                       data->pclient,
+                       &state_status) != STATE_SUCCESS)
+    {
+      res_WRITE4.status = nfs4_Errno_state(state_status);
+      return res_WRITE4.status;
+    }
+
   /* Get the characteristics of the I/O to be made */
   offset = arg_WRITE4.offset;
   size = arg_WRITE4.data.data_len;
@@ -333,11 +345,14 @@ int nfs4_op_write(struct nfs_argop4 *op, compound_data_t * data, struct nfs_reso
 
   if((nfs_param.core_param.use_nfs_commit == TRUE) && (arg_WRITE4.stable == UNSTABLE4))
     {
-      stable_flag = FALSE;
+      if(data->pexport->use_ganesha_write_buffer == TRUE)
+        stable_flag = FSAL_UNSAFE_WRITE_TO_GANESHA_BUFFER;
+      else
+        stable_flag = FSAL_UNSAFE_WRITE_TO_FS_BUFFER;
     }
   else
     {
-      stable_flag = TRUE;
+      stable_flag = FSAL_SAFE_WRITE_TO_FS;
     }
 
   /* An actual write is to be made, prepare it */
@@ -363,7 +378,7 @@ int nfs4_op_write(struct nfs_argop4 *op, compound_data_t * data, struct nfs_reso
     }
 
   /* Set the returned value */
-  if(stable_flag == TRUE)
+  if(stable_flag == FSAL_SAFE_WRITE_TO_FS)
     res_WRITE4.WRITE4res_u.resok4.committed = FILE_SYNC4;
   else
     res_WRITE4.WRITE4res_u.resok4.committed = UNSTABLE4;
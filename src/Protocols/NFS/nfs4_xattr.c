@@ -54,6 +54,7 @@ t*
 #include "nfs4.h"
 #include "nfs_core.h"
 #include "nfs_proto_functions.h"
+#include "nfs_proto_tools.h"
 #include "nfs_tools.h"
 #include "nfs_exports.h"
 #include "nfs_file_handle.h"
@@ -1649,8 +1650,8 @@ int nfs4_op_read_xattr(struct nfs_argop4 *op,
    * xattr_pos > 1 ==> The FH is the one for the xattr ghost file whose xattr_id = xattr_pos -2 */
   xattr_id = pfile_handle->xattr_pos - 2;
 
-  /* Get the xattr related to this xattr_id */
-  if((buffer = (char *)Mem_Alloc(XATTR_BUFFERSIZE)) == NULL)
+  /* Get the xattr related to this xattr_id, nfs4_op_read_Free releases it */
+  if((buffer = nfs_read_buffer_get(XATTR_BUFFERSIZE)) == NULL)
     {
       res_READ4.status = NFS4ERR_SERVERFAULT;
       return res_READ4.status;
@@ -1664,6 +1665,7 @@ int nfs4_op_read_xattr(struct nfs_argop4 *op,
 
   if(FSAL_IS_ERROR(fsal_status))
     {
+      nfs_read_buffer_release(buffer);
       res_READ4.status = NFS4ERR_SERVERFAULT;
       return res_READ4.status;
     }
@@ -295,7 +295,8 @@ int nfs_Read(nfs_arg_t * parg,
     }
   else
     {
-      data = Mem_Alloc(size);
+      /* The reply is encoded straight from this buffer */
+      data = nfs_read_buffer_get(size);
 
       if(data == NULL)
         {
@@ -328,6 +329,8 @@ int nfs_Read(nfs_arg_t * parg,
                * The first call will create the file content cache entry, the further will return
                * with error CACHE_INODE_CACHE_CONTENT_EXISTS which is not a pathological thing here */
 
+              nfs_read_buffer_release(data);
+
               /* If we are here, there was an error */
               if(nfs_RetryableError(cache_status))
                 {
@@ -398,6 +401,8 @@ int nfs_Read(nfs_arg_t * parg,
 
           return NFS_REQ_OK;
         }
+
+      nfs_read_buffer_release(data);
     }
 
   /* If we are here, there was an error */
@@ -428,9 +433,8 @@ int nfs_Read(nfs_arg_t * parg,
  */
 void nfs2_Read_Free(nfs_res_t * resp)
 {
-  if((resp->res_read2.status == NFS_OK) &&
-     (resp->res_read2.READ2res_u.readok.data.nfsdata2_len != 0))
-    Mem_Free(resp->res_read2.READ2res_u.readok.data.nfsdata2_val);
+  if(resp->res_read2.status == NFS_OK)
+    nfs_read_buffer_release(resp->res_read2.READ2res_u.readok.data.nfsdata2_val);
 }                               /* nfs2_Read_Free */
 
 /**
@@ -443,7 +447,6 @@ void nfs2_Read_Free(nfs_res_t * resp)
  */
 void nfs3_Read_Free(nfs_res_t * resp)
 {
-  if((resp->res_read3.status == NFS3_OK) &&
-     (resp->res_read3.READ3res_u.resok.data.data_len != 0))
-    Mem_Free(resp->res_read3.READ3res_u.resok.data.data_val);
+  if(resp->res_read3.status == NFS3_OK)
+    nfs_read_buffer_release(resp->res_read3.READ3res_u.resok.data.data_val);
 }                               /* nfs3_Read_Free */
@@ -63,6 +63,7 @@
 #include "nfs_proto_functions.h"
 #include "nfs_tools.h"
 #include "nfs_proto_tools.h"
+#include "sal_functions.h"
 
 /**
  *
@@ -103,6 +104,7 @@ int nfs_Remove(nfs_arg_t * parg /* IN  */ ,
   cache_inode_file_type_t filetype;
   cache_inode_file_type_t childtype;
   cache_inode_status_t cache_status;
+  state_status_t state_status;
   int rc;
   char *file_name = NULL;
   fsal_name_t name;
@@ -237,6 +239,30 @@ int nfs_Remove(nfs_arg_t * parg /* IN  */ ,
                   return NFS_REQ_OK;
                 }
 
+              /* NFSv4 clients give their delegations back first. NFSv2 has
+               * no way to say "later", the request is dropped and retried */
+              if(state_deleg_break(pentry_child, 0LL, pclient, &state_status) !=
+                 STATE_SUCCESS)
+                {
+                  if(preq->rq_vers == NFS_V2)
+                    return NFS_REQ_DROP;
+
+                  pres->res_remove3.status = nfs3_Errno_state(state_status);
+
+                  nfs_SetFailedStatus(pcontext, pexport,
+                                      preq->rq_vers,
+                                      CACHE_INODE_SUCCESS,
+                                      &pres->res_stat2,
+                                      &pres->res_remove3.status,
+                                      NULL, NULL,
+                                      parent_pentry,
+                                      pparent_attr,
+                                      &(pres->res_remove3.REMOVE3res_u.resfail.dir_wcc),
+                                      NULL, NULL, NULL);
+
+                  return NFS_REQ_OK;
+                }
+
               LogFullDebug(COMPONENT_NFSPROTO,
                            "==== NFS REMOVE ====> Trying to remove file %s",
                            name.name);
@@ -63,6 +63,7 @@
 #include "nfs_proto_functions.h"
 #include "nfs_tools.h"
 #include "nfs_proto_tools.h"
+#include "sal_functions.h"
 
 /**
  *
@@ -105,6 +106,7 @@ int nfs_Rename(nfs_arg_t * parg /* IN  */ ,
   cache_entry_t *should_not_exists = NULL;
   cache_entry_t *should_exists = NULL;
   cache_inode_status_t cache_status;
+  state_status_t state_status;
   int rc;
   fsal_attrib_list_t *ppre_attr;
   fsal_attrib_list_t pre_attr;
@@ -243,6 +245,47 @@ int nfs_Rename(nfs_arg_t * parg /* IN  */ ,
     }
   else
     {
+      /* NFSv4 clients give back the delegations of both files first. NFSv2
+       * has no way to say "later", the request is dropped and retried */
+      if(nfs_param.nfsv4_param.allow_delegations)
+        {
+          pentry = cache_inode_lookup(parent_pentry,
+                                      &entry_name,
+                                      &tst_attr,
+                                      ht, pclient, pcontext, &cache_status);
+
+          new_pentry = cache_inode_lookup(new_parent_pentry,
+                                          &new_entry_name,
+                                          &tst_attr,
+                                          ht, pclient, pcontext, &cache_status);
+
+          if((pentry != NULL &&
+              state_deleg_break(pentry, 0LL, pclient, &state_status) != STATE_SUCCESS) ||
+             (new_pentry != NULL &&
+              state_deleg_break(new_pentry, 0LL, pclient, &state_status) != STATE_SUCCESS))
+            {
+              if(preq->rq_vers == NFS_V2)
+                return NFS_REQ_DROP;
+
+              pres->res_rename3.status = nfs3_Errno_state(state_status);
+
+              nfs_SetFailedStatus(pcontext, pexport,
+                                  preq->rq_vers,
+                                  CACHE_INODE_SUCCESS,
+                                  &pres->res_stat2,
+                                  &pres->res_rename3.status,
+                                  NULL, NULL,
+                                  parent_pentry,
+                                  ppre_attr,
+                                  &(pres->res_rename3.RENAME3res_u.resfail.fromdir_wcc),
+                                  new_parent_pentry,
+                                  pnew_pre_attr,
+                                  &(pres->res_rename3.RENAME3res_u.resfail.todir_wcc));
+
+              return NFS_REQ_OK;
+            }
+        }
+
       /*
        * Lookup file to see if new entry exists
        *
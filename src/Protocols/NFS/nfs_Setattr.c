@@ -62,6 +62,7 @@
 #include "nfs_proto_functions.h"
 #include "nfs_tools.h"
 #include "nfs_proto_tools.h"
+#include "sal_functions.h"
 
 /**
  *
@@ -99,6 +100,7 @@ int nfs_Setattr(nfs_arg_t * parg,
   fsal_attrib_list_t parent_attr;
   fsal_attrib_list_t *ppre_attr;
   cache_inode_status_t cache_status;
+  state_status_t state_status;
   int rc;
   int do_trunc = FALSE;
 
@@ -150,6 +152,29 @@ int nfs_Setattr(nfs_arg_t * parg,
   /* get directory attributes before action (for V3 reply) */
   ppre_attr = &pre_attr;
 
+  /* NFSv4 clients give their delegations back first. NFSv2 has no way to
+   * say "later", the request is dropped and the client retries */
+  if(state_deleg_break(pentry, 0LL, pclient, &state_status) != STATE_SUCCESS)
+    {
+      if(preq->rq_vers == NFS_V2)
+        return NFS_REQ_DROP;
+
+      pres->res_setattr3.status = nfs3_Errno_state(state_status);
+
+      nfs_SetFailedStatus(pcontext, pexport,
+                          preq->rq_vers,
+                          CACHE_INODE_SUCCESS,
+                          &pres->res_attr2.status,
+                          &pres->res_setattr3.status,
+                          NULL, NULL,
+                          pentry,
+                          ppre_attr,
+                          &(pres->res_setattr3.SETATTR3res_u.resfail.obj_wcc),
+                          NULL, NULL, NULL);
+
+      return NFS_REQ_OK;
+    }
+
   switch (preq->rq_vers)
     {
     case NFS_V2:
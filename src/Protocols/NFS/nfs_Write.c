@@ -64,6 +64,7 @@
 #include "nfs_proto_functions.h"
 #include "nfs_tools.h"
 #include "nfs_proto_tools.h"
+#include "sal_functions.h"
 
 /**
  *
@@ -101,6 +102,7 @@ int nfs_Write(nfs_arg_t * parg,
   int rc;
   cache_inode_status_t cache_status = CACHE_INODE_SUCCESS;
   cache_content_status_t content_status;
+  state_status_t state_status;
   fsal_seek_t seek_descriptor;
   fsal_size_t size = 0;
   fsal_size_t written_size;
@@ -234,6 +236,29 @@ int nfs_Write(nfs_arg_t * parg,
       return NFS_REQ_OK;
     }
 
+  /* NFSv4 clients give their delegations back first. NFSv2 has no way to
+   * say "later", the request is dropped and the client retries */
+  if(state_deleg_break(pentry, 0LL, pclient, &state_status) != STATE_SUCCESS)
+    {
+      if(preq->rq_vers == NFS_V2)
+        return NFS_REQ_DROP;
+
+      pres->res_write3.status = nfs3_Errno_state(state_status);
+
+      nfs_SetFailedStatus(pcontext, pexport,
+                          preq->rq_vers,
+                          CACHE_INODE_SUCCESS,
+                          &pres->res_attr2.status,
+                          &pres->res_write3.status,
+                          NULL, NULL,
+                          pentry,
+                          ppre_attr,
+                          &(pres->res_write3.WRITE3res_u.resfail.file_wcc),
+                          NULL, NULL, NULL);
+
+      return NFS_REQ_OK;
+    }
+
   /* Extract the argument from the request */
   switch (preq->rq_vers)
     {
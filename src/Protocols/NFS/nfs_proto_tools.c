@@ -682,7 +682,8 @@ static int nfs4_encode_acl(fsal_attrib_list_t * pattr, char *attrvalsBuffer, u_i
  *
  * nfs4_FSALattr_To_Fattr: Converts FSAL Attributes to NFSv4 Fattr buffer.
  *
- * Converts FSAL Attributes to NFSv4 Fattr buffer.
+ * Converts FSAL Attributes to NFSv4 Fattr buffer, through the precompiled plan
+ * of the bitmap if it has one, attribute per attribute otherwise.
  *
  * @param pexport [IN]  the related export entry.
  * @param pattr   [IN]  pointer to FSAL attributes.
@@ -698,6 +699,39 @@ int nfs4_FSALattr_To_Fattr(exportlist_t * pexport,
                            fsal_attrib_list_t * pattr,
                            fattr4 * Fattr,
                            compound_data_t * data, nfs_fh4 * objFH, bitmap4 * Bitmap)
+{
+  nfs4_fattr_plan_t scratch;
+  nfs4_fattr_plan_t *pplan;
+
+  if((pplan = nfs4_Fattr_Plan(Bitmap, &scratch)) == NULL)
+    return nfs4_FSALattr_To_Fattr_Switch(pexport, pattr, Fattr, data, objFH, Bitmap);
+
+  return nfs4_FSALattr_To_Fattr_Plan(pplan, pexport, pattr, Fattr, objFH);
+}                               /* nfs4_FSALattr_To_Fattr */
+
+/**
+ *
+ * nfs4_FSALattr_To_Fattr_Switch: Converts FSAL Attributes to NFSv4 Fattr buffer.
+ *
+ * Converts FSAL Attributes to NFSv4 Fattr buffer, going through the list of
+ * the requested attributes one by one. This handles every attribute, including
+ * the ones that have no plan encoder (see nfs4_fattr_plan.c).
+ *
+ * @param pexport [IN]  the related export entry.
+ * @param pattr   [IN]  pointer to FSAL attributes.
+ * @param Fattr   [OUT] NFSv4 Fattr buffer
+ * @param data    [IN]  NFSv4 compoud request's data.
+ * @param Bitmap  [OUT] NFSv4 attributes bitmap to the Fattr buffer.
+ * 
+ * @return -1 if failed, 0 if successful.
+ *
+ */
+
+int nfs4_FSALattr_To_Fattr_Switch(exportlist_t * pexport,
+                                  fsal_attrib_list_t * pattr,
+                                  fattr4 * Fattr,
+                                  compound_data_t * data,
+                                  nfs_fh4 * objFH, bitmap4 * Bitmap)
 {
   fattr4_type file_type;
   fattr4_link_support link_support;
@@ -769,7 +803,7 @@ int nfs4_FSALattr_To_Fattr(exportlist_t * pexport,
   u_int LastOffset;
   u_int len = 0, off = 0;       /* Use for XDR alignment */
   int op_attr_success = 0;
-  char __attribute__ ((__unused__)) funcname[] = "nfs4_FSALattr_To_Fattr";
+  char __attribute__ ((__unused__)) funcname[] = "nfs4_FSALattr_To_Fattr_Switch";
 
 #ifdef _USE_NFS4_1
   unsigned int attrvalslist_supported[FATTR4_FS_CHARSET_CAP];
@@ -1834,7 +1868,7 @@ int nfs4_FSALattr_To_Fattr(exportlist_t * pexport,
   /* LastOffset contains the length of the attrvalsBuffer usefull data */
 
   return 0;
-}                               /* nfs4_FSALattr_To_Fattr */
+}                               /* nfs4_FSALattr_To_Fattr_Switch */
 
 /**
  *
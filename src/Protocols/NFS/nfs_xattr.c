@@ -1171,8 +1171,8 @@ int nfs3_Read_Xattr(nfs_arg_t * parg,
   offset = parg->arg_read3.offset;
   size = parg->arg_read3.count;
 
-  /* Get the xattr related to this xattr_id */
-  if((data = (char *)Mem_Alloc(XATTR_BUFFERSIZE)) == NULL)
+  /* Get the xattr related to this xattr_id, nfs3_Read_Free releases it */
+  if((data = nfs_read_buffer_get(XATTR_BUFFERSIZE)) == NULL)
     {
       return NFS_REQ_DROP;
     }
@@ -1185,6 +1185,7 @@ int nfs3_Read_Xattr(nfs_arg_t * parg,
 
   if(FSAL_IS_ERROR(fsal_status))
     {
+      nfs_read_buffer_release(data);
       pres->res_read3.status = NFS3ERR_IO;
       return NFS_REQ_OK;
     }
@@ -1198,6 +1199,7 @@ int nfs3_Read_Xattr(nfs_arg_t * parg,
 
   if(FSAL_IS_ERROR(fsal_status))
     {
+      nfs_read_buffer_release(data);
       pres->res_read3.status = nfs3_Errno(cache_inode_error_convert(fsal_status));
       return NFS_REQ_OK;
     }
@@ -0,0 +1,230 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    test_fattr4_plan.c
+ * \brief   Benchmark of the NFSv4 attribute encoders.
+ *
+ * For a few typical bitmaps (the GETATTR and the READDIR of a Linux client,
+ * and the constant attributes asked at mount time), checks that the plan
+ * encoder produces the same bitmap and bytes as the per attribute switch,
+ * then times nb_loops encodings with each of them, the plan being looked up
+ * once as nfs4_op_readdir does for all its entries.
+ *
+ * owner and owner_group are left out, they need the id mapper.
+ *
+ * Usage: test_fattr4_plan [nb_loops]
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "HashData.h"
+#include "HashTable.h"
+#include "rpc.h"
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs23.h"
+#include "nfs4.h"
+#include "nfs_core.h"
+#include "cache_inode.h"
+#include "nfs_exports.h"
+#include "nfs_proto_functions.h"
+#include "nfs_file_handle.h"
+#include "MesureTemps.h"
+
+#define NB_LOOPS_DEFAULT 1000000
+
+typedef struct test_bitmap__
+{
+  char *name;
+  uint_t nb_attrs;
+  uint32_t attrs[FATTR4_MOUNTED_ON_FILEID];
+} test_bitmap_t;
+
+static test_bitmap_t test_bitmaps[] = {
+  {"getattr", 13,
+   {FATTR4_TYPE, FATTR4_CHANGE, FATTR4_SIZE, FATTR4_FSID, FATTR4_FILEID, FATTR4_MODE,
+    FATTR4_NUMLINKS, FATTR4_RAWDEV, FATTR4_SPACE_USED, FATTR4_TIME_ACCESS,
+    FATTR4_TIME_METADATA, FATTR4_TIME_MODIFY, FATTR4_MOUNTED_ON_FILEID}},
+  {"readdir", 15,
+   {FATTR4_TYPE, FATTR4_CHANGE, FATTR4_SIZE, FATTR4_FSID, FATTR4_RDATTR_ERROR,
+    FATTR4_FILEHANDLE, FATTR4_FILEID, FATTR4_MODE, FATTR4_NUMLINKS, FATTR4_RAWDEV,
+    FATTR4_SPACE_USED, FATTR4_TIME_ACCESS, FATTR4_TIME_METADATA, FATTR4_TIME_MODIFY,
+    FATTR4_MOUNTED_ON_FILEID}},
+  {"constant", 10,
+   {FATTR4_SUPPORTED_ATTRS, FATTR4_FH_EXPIRE_TYPE, FATTR4_LINK_SUPPORT,
+    FATTR4_SYMLINK_SUPPORT, FATTR4_UNIQUE_HANDLES, FATTR4_ACLSUPPORT, FATTR4_CANSETTIME,
+    FATTR4_HOMOGENEOUS, FATTR4_MAXFILESIZE, FATTR4_TIME_DELTA}}
+};
+
+static void fattr4_free(fattr4 * Fattr)
+{
+  Mem_Free((char *)Fattr->attrmask.bitmap4_val);
+  if(Fattr->attr_vals.attrlist4_len != 0)
+    Mem_Free(Fattr->attr_vals.attrlist4_val);
+}                               /* fattr4_free */
+
+static int fattr4_compare(fattr4 * Fattr1, fattr4 * Fattr2)
+{
+  return Fattr1->attrmask.bitmap4_len == Fattr2->attrmask.bitmap4_len
+      && Fattr1->attrmask.bitmap4_val[0] == Fattr2->attrmask.bitmap4_val[0]
+      && (Fattr1->attrmask.bitmap4_len < 2
+          || Fattr1->attrmask.bitmap4_val[1] == Fattr2->attrmask.bitmap4_val[1])
+      && Fattr1->attr_vals.attrlist4_len == Fattr2->attr_vals.attrlist4_len
+      && !memcmp(Fattr1->attr_vals.attrlist4_val, Fattr2->attr_vals.attrlist4_val,
+                 Fattr1->attr_vals.attrlist4_len);
+}                               /* fattr4_compare */
+
+int main(int argc, char *argv[])
+{
+  exportlist_t export;
+  fsal_attrib_list_t attr;
+  char val_fh[NFS4_FHSIZE];
+  nfs_fh4 objFH;
+  uint32_t bitmap_val[2];
+  bitmap4 bitmap;
+  fattr4 fattr_switch;
+  fattr4 fattr_plan;
+  nfs4_fattr_plan_t scratch;
+  nfs4_fattr_plan_t *pplan;
+
+  struct Temps debut;
+  struct Temps fin;
+  double secs_switch;
+  double secs_plan;
+  unsigned int nb_loops = NB_LOOPS_DEFAULT;
+  unsigned int i, t;
+  int rc = 0;
+
+  if(argc > 1)
+    nb_loops = (unsigned int)atoi(argv[1]);
+
+#ifndef _NO_BUDDY_SYSTEM
+  if(BuddyInit(NULL) != BUDDY_SUCCESS)
+    {
+      fprintf(stderr, "Error while initializing Buddy system allocator\n");
+      exit(1);
+    }
+#endif
+
+  SetNamePgm("test_fattr4_plan");
+  SetDefaultLogging("TEST");
+  SetNameFunction("main");
+  InitLogging();
+
+  /* A regular file of a plain export */
+  memset(&export, 0, sizeof(export));
+  export.filesystem_id.major = 152;
+  export.filesystem_id.minor = 152;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.type = FSAL_TYPE_FILE;
+  attr.filesize = 123456789;
+  attr.spaceused = 123457536;
+  attr.fileid = 0x123456789abcdefLL;
+  attr.change = 1300000000;
+  attr.mode = 0644;
+  attr.numlinks = 1;
+  attr.atime.seconds = 1300000000;
+  attr.atime.nseconds = 1;
+  attr.mtime.seconds = 1300000001;
+  attr.mtime.nseconds = 2;
+  attr.ctime.seconds = 1300000002;
+  attr.ctime.nseconds = 3;
+
+  memset(val_fh, 0xa5, sizeof(val_fh));
+  ((file_handle_v4_t *) val_fh)->refid = 0;
+  objFH.nfs_fh4_val = val_fh;
+  objFH.nfs_fh4_len = sizeof(file_handle_v4_t);
+
+  bitmap.bitmap4_val = bitmap_val;
+
+  for(t = 0; t < sizeof(test_bitmaps) / sizeof(test_bitmap_t); t++)
+    {
+      nfs4_list_to_bitmap4(&bitmap, &test_bitmaps[t].nb_attrs, test_bitmaps[t].attrs);
+
+      if((pplan = nfs4_Fattr_Plan(&bitmap, &scratch)) == NULL)
+        {
+          LogTest("%s : ERROR no plan for bitmap %x|%x", test_bitmaps[t].name,
+                  bitmap_val[0], bitmap_val[1]);
+          rc = 1;
+          continue;
+        }
+
+      /* Both encoders must give the same result */
+      if(nfs4_FSALattr_To_Fattr_Switch(&export, &attr, &fattr_switch, NULL, &objFH,
+                                       &bitmap) != 0
+         || nfs4_FSALattr_To_Fattr_Plan(pplan, &export, &attr, &fattr_plan,
+                                        &objFH) != 0)
+        {
+          LogTest("%s : ERROR while encoding", test_bitmaps[t].name);
+          rc = 1;
+          continue;
+        }
+
+      if(!fattr4_compare(&fattr_switch, &fattr_plan))
+        {
+          LogTest("%s : ERROR plan and switch encodings differ", test_bitmaps[t].name);
+          rc = 1;
+          continue;
+        }
+
+      LogTest("%s : OK, %u attributes in %u bytes, prefix of %u bytes",
+              test_bitmaps[t].name, test_bitmaps[t].nb_attrs,
+              fattr_plan.attr_vals.attrlist4_len, pplan->prefix_len);
+
+      fattr4_free(&fattr_switch);
+      fattr4_free(&fattr_plan);
+
+      /* Timed encodings */
+      MesureTemps(&debut, NULL);
+      for(i = 0; i < nb_loops; i++)
+        {
+          nfs4_FSALattr_To_Fattr_Switch(&export, &attr, &fattr_switch, NULL, &objFH,
+                                        &bitmap);
+          fattr4_free(&fattr_switch);
+        }
+      MesureTemps(&fin, &debut);
+      secs_switch = fin.secondes + fin.micro_secondes / 1000000.0;
+
+      MesureTemps(&debut, NULL);
+      pplan = nfs4_Fattr_Plan(&bitmap, &scratch);
+      for(i = 0; i < nb_loops; i++)
+        {
+          nfs4_FSALattr_To_Fattr_Plan(pplan, &export, &attr, &fattr_plan, &objFH);
+          fattr4_free(&fattr_plan);
+        }
+      MesureTemps(&fin, &debut);
+      secs_plan = fin.secondes + fin.micro_secondes / 1000000.0;
+
+      LogTest("%s : switch %.0f ns/entry, plan %.0f ns/entry, speedup %.2f",
+              test_bitmaps[t].name,
+              nb_loops ? secs_switch * 1e9 / nb_loops : 0.0,
+              nb_loops ? secs_plan * 1e9 / nb_loops : 0.0,
+              secs_plan > 0 ? secs_switch / secs_plan : 0.0);
+    }
+
+  exit(rc);
+}                               /* main */
@@ -0,0 +1,407 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    xdr_arena.c
+ * \brief   Per-request bump arena for the XDR decoders.
+ *
+ * The arena starts with a buffer held by the request. Allocations move a
+ * cursor forward, and when the buffer is full chunks are allocated and chained
+ * to the arena until it is reset. Nothing is ever freed alone.
+ *
+ * The xdr_arena_* routines behave as the ones of the RPC library they stand
+ * for. They only differ when decoding into a NULL pointer, and when freeing
+ * memory of the arena, while an arena is current for the thread.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "xdr_arena.h"
+
+static pthread_key_t xdr_arena_key;
+static pthread_once_t xdr_arena_once = PTHREAD_ONCE_INIT;
+
+static void xdr_arena_key_init(void)
+{
+  if(pthread_key_create(&xdr_arena_key, NULL) != 0)
+    LogCrit(COMPONENT_RPC, "Cannot create the XDR arena thread key");
+}                               /* xdr_arena_key_init */
+
+/**
+ *
+ * xdr_arena_init: initializes an arena.
+ *
+ * @param parena [OUT] the arena
+ * @param buffer [IN] the buffer the arena starts with, aligned on XDR_ARENA_ALIGN
+ * @param size [IN] the size of the buffer
+ *
+ * @return nothing (void function)
+ *
+ */
+void xdr_arena_init(xdr_arena_t * parena, char *buffer, size_t size)
+{
+  parena->base = buffer;
+  parena->size = size;
+  parena->used = 0;
+  parena->chunks = NULL;
+  parena->nb_chunks = 0;
+}                               /* xdr_arena_init */
+
+/**
+ *
+ * xdr_arena_reset: gives back all the memory of an arena.
+ *
+ * @param parena [INOUT] the arena
+ *
+ * @return nothing (void function)
+ *
+ */
+void xdr_arena_reset(xdr_arena_t * parena)
+{
+  xdr_arena_chunk_t *pchunk;
+
+  while((pchunk = parena->chunks) != NULL)
+    {
+      parena->chunks = pchunk->next;
+      Mem_Free(pchunk);
+    }
+
+  parena->used = 0;
+  parena->nb_chunks = 0;
+}                               /* xdr_arena_reset */
+
+/**
+ *
+ * xdr_arena_alloc: allocates memory from an arena.
+ *
+ * @param parena [INOUT] the arena
+ * @param size [IN] the size to allocate
+ *
+ * @return the memory, aligned on XDR_ARENA_ALIGN, NULL if it can't be allocated.
+ *
+ */
+void *xdr_arena_alloc(xdr_arena_t * parena, size_t size)
+{
+  xdr_arena_chunk_t *pchunk;
+  size_t chunk_size;
+  void *ptr;
+
+  size = (size + XDR_ARENA_ALIGN - 1) & ~((size_t) XDR_ARENA_ALIGN - 1);
+
+  if(parena->size - parena->used >= size)
+    {
+      ptr = parena->base + parena->used;
+      parena->used += size;
+      return ptr;
+    }
+
+  /* Only the last chunk may have some room left */
+  pchunk = parena->chunks;
+  if(pchunk == NULL || pchunk->size - pchunk->used < size)
+    {
+      chunk_size = size > XDR_ARENA_SIZE ? size : XDR_ARENA_SIZE;
+
+      pchunk = (xdr_arena_chunk_t *) Mem_Alloc_Label(sizeof(xdr_arena_chunk_t) + chunk_size,
+                                                     "xdr_arena_chunk_t");
+      if(pchunk == NULL)
+        return NULL;
+
+      pchunk->size = chunk_size;
+      pchunk->used = 0;
+      pchunk->next = parena->chunks;
+      parena->chunks = pchunk;
+      parena->nb_chunks += 1;
+
+      LogFullDebug(COMPONENT_RPC,
+                   "XDR arena %p full, chunk #%u of %llu bytes allocated",
+                   parena, parena->nb_chunks, (unsigned long long)chunk_size);
+    }
+
+  ptr = (char *)(pchunk + 1) + pchunk->used;
+  pchunk->used += size;
+
+  return ptr;
+}                               /* xdr_arena_alloc */
+
+/**
+ *
+ * xdr_arena_owns: tells if some memory comes from an arena.
+ *
+ * @param parena [IN] the arena
+ * @param ptr [IN] the memory
+ *
+ * @return TRUE if ptr was allocated from the arena, FALSE otherwise.
+ *
+ */
+int xdr_arena_owns(xdr_arena_t * parena, void *ptr)
+{
+  xdr_arena_chunk_t *pchunk;
+  char *p = (char *)ptr;
+
+  if(p >= parena->base && p < parena->base + parena->size)
+    return TRUE;
+
+  for(pchunk = parena->chunks; pchunk != NULL; pchunk = pchunk->next)
+    if(p >= (char *)(pchunk + 1) && p < (char *)(pchunk + 1) + pchunk->size)
+      return TRUE;
+
+  return FALSE;
+}                               /* xdr_arena_owns */
+
+/**
+ *
+ * xdr_arena_set_current: sets the arena the decoders of the thread use.
+ *
+ * @param parena [IN] the arena, NULL for none
+ *
+ * @return nothing (void function)
+ *
+ */
+void xdr_arena_set_current(xdr_arena_t * parena)
+{
+  pthread_once(&xdr_arena_once, xdr_arena_key_init);
+  pthread_setspecific(xdr_arena_key, parena);
+}                               /* xdr_arena_set_current */
+
+/**
+ *
+ * xdr_arena_get_current: gets the arena the decoders of the thread use.
+ *
+ * @return the arena, NULL if none.
+ *
+ */
+xdr_arena_t *xdr_arena_get_current(void)
+{
+  pthread_once(&xdr_arena_once, xdr_arena_key_init);
+  return (xdr_arena_t *) pthread_getspecific(xdr_arena_key);
+}                               /* xdr_arena_get_current */
+
+/**
+ *
+ * xdr_arena_bytes: xdr_bytes allocating from the current arena.
+ *
+ */
+bool_t xdr_arena_bytes(XDR * xdrs, char **cpp, u_int * sizep, u_int maxsize)
+{
+  xdr_arena_t *parena = xdr_arena_get_current();
+
+  if(parena == NULL)
+    return xdr_bytes(xdrs, cpp, sizep, maxsize);
+
+  switch (xdrs->x_op)
+    {
+    case XDR_DECODE:
+      if(*cpp != NULL)
+        return xdr_bytes(xdrs, cpp, sizep, maxsize);
+
+      if(!xdr_u_int(xdrs, sizep) || *sizep > maxsize)
+        return FALSE;
+
+      if(*sizep == 0)
+        return TRUE;
+
+      if((*cpp = (char *)xdr_arena_alloc(parena, *sizep)) == NULL)
+        return FALSE;
+
+      return xdr_opaque(xdrs, *cpp, *sizep);
+
+    case XDR_FREE:
+      if(*cpp != NULL && xdr_arena_owns(parena, *cpp))
+        {
+          *cpp = NULL;
+          return TRUE;
+        }
+      return xdr_bytes(xdrs, cpp, sizep, maxsize);
+
+    default:
+      return xdr_bytes(xdrs, cpp, sizep, maxsize);
+    }
+}                               /* xdr_arena_bytes */
+
+/**
+ *
+ * xdr_arena_string: xdr_string allocating from the current arena.
+ *
+ */
+bool_t xdr_arena_string(XDR * xdrs, char **cpp, u_int maxsize)
+{
+  xdr_arena_t *parena = xdr_arena_get_current();
+  u_int size;
+
+  if(parena == NULL)
+    return xdr_string(xdrs, cpp, maxsize);
+
+  switch (xdrs->x_op)
+    {
+    case XDR_DECODE:
+      if(*cpp != NULL)
+        return xdr_string(xdrs, cpp, maxsize);
+
+      if(!xdr_u_int(xdrs, &size) || size > maxsize || size + 1 == 0)
+        return FALSE;
+
+      if((*cpp = (char *)xdr_arena_alloc(parena, size + 1)) == NULL)
+        return FALSE;
+      (*cpp)[size] = '\0';
+
+      return xdr_opaque(xdrs, *cpp, size);
+
+    case XDR_FREE:
+      if(*cpp != NULL && xdr_arena_owns(parena, *cpp))
+        {
+          *cpp = NULL;
+          return TRUE;
+        }
+      return xdr_string(xdrs, cpp, maxsize);
+
+    default:
+      return xdr_string(xdrs, cpp, maxsize);
+    }
+}                               /* xdr_arena_string */
+
+/**
+ *
+ * xdr_arena_array: xdr_array allocating from the current arena.
+ *
+ * The elements of an array of the arena are still freed one by one: they may
+ * hold memory that does not come from the arena.
+ *
+ */
+bool_t xdr_arena_array(XDR * xdrs, caddr_t * addrp, u_int * sizep, u_int maxsize,
+                       u_int elsize, xdrproc_t elproc)
+{
+  xdr_arena_t *parena = xdr_arena_get_current();
+  caddr_t target;
+  u_int i;
+
+  if(parena == NULL)
+    return xdr_array(xdrs, addrp, sizep, maxsize, elsize, elproc);
+
+  switch (xdrs->x_op)
+    {
+    case XDR_DECODE:
+      if(*addrp != NULL)
+        return xdr_array(xdrs, addrp, sizep, maxsize, elsize, elproc);
+
+      if(!xdr_u_int(xdrs, sizep) || *sizep > maxsize || UINT_MAX / elsize < *sizep)
+        return FALSE;
+
+      if(*sizep == 0)
+        return TRUE;
+
+      if((target = (caddr_t) xdr_arena_alloc(parena, *sizep * elsize)) == NULL)
+        return FALSE;
+      memset(target, 0, *sizep * elsize);
+      *addrp = target;
+
+      for(i = 0; i < *sizep; i++, target += elsize)
+        if(!(*elproc) (xdrs, target))
+          return FALSE;
+
+      return TRUE;
+
+    case XDR_FREE:
+      if(*addrp != NULL && xdr_arena_owns(parena, *addrp))
+        {
+          for(i = 0, target = *addrp; i < *sizep; i++, target += elsize)
+            (*elproc) (xdrs, target);
+
+          *addrp = NULL;
+          return TRUE;
+        }
+      return xdr_array(xdrs, addrp, sizep, maxsize, elsize, elproc);
+
+    default:
+      return xdr_array(xdrs, addrp, sizep, maxsize, elsize, elproc);
+    }
+}                               /* xdr_arena_array */
+
+/**
+ *
+ * xdr_arena_reference: xdr_reference allocating from the current arena.
+ *
+ */
+bool_t xdr_arena_reference(XDR * xdrs, caddr_t * pp, u_int size, xdrproc_t proc)
+{
+  xdr_arena_t *parena = xdr_arena_get_current();
+  caddr_t loc;
+
+  if(parena == NULL)
+    return xdr_reference(xdrs, pp, size, proc);
+
+  switch (xdrs->x_op)
+    {
+    case XDR_DECODE:
+      if(*pp != NULL)
+        return xdr_reference(xdrs, pp, size, proc);
+
+      if((loc = (caddr_t) xdr_arena_alloc(parena, size)) == NULL)
+        return FALSE;
+      memset(loc, 0, size);
+      *pp = loc;
+
+      return (*proc) (xdrs, loc);
+
+    case XDR_FREE:
+      if(*pp != NULL && xdr_arena_owns(parena, *pp))
+        {
+          (*proc) (xdrs, *pp);
+          *pp = NULL;
+          return TRUE;
+        }
+      return xdr_reference(xdrs, pp, size, proc);
+
+    default:
+      return xdr_reference(xdrs, pp, size, proc);
+    }
+}                               /* xdr_arena_reference */
+
+/**
+ *
+ * xdr_arena_pointer: xdr_pointer allocating from the current arena.
+ *
+ */
+bool_t xdr_arena_pointer(XDR * xdrs, char **objpp, u_int objsize, xdrproc_t xdrobj)
+{
+  bool_t more_data = (*objpp != NULL);
+
+  if(!xdr_bool(xdrs, &more_data))
+    return FALSE;
+
+  if(!more_data)
+    {
+      *objpp = NULL;
+      return TRUE;
+    }
+
+  return xdr_arena_reference(xdrs, objpp, objsize, xdrobj);
+}                               /* xdr_arena_pointer */
@@ -13,6 +13,10 @@
 #include "rpc.h"
 #include "nfs23.h"
 
+/* Variable length fields are decoded into the arena of the request */
+#define XDR_ARENA_DECODERS
+#include "xdr_arena.h"
+
 bool_t xdr_nfspath2(xdrs, objp)
 register XDR *xdrs;
 nfspath2 *objp;
@@ -13,6 +13,10 @@
 #include "rpc.h"
 #include "nfs4.h"
 
+/* Variable length fields are decoded into the arena of the request */
+#define XDR_ARENA_DECODERS
+#include "xdr_arena.h"
+
 #ifndef RPCSEC_GSS
 #define RPCSEC_GSS 6
 #endif
@@ -15,6 +15,10 @@
 
 #include "nfsv41.h"
 
+/* Variable length fields are decoded into the arena of the request */
+#define XDR_ARENA_DECODERS
+#include "xdr_arena.h"
+
 #ifndef RPCSEC_GSS
 #define RPCSEC_GSS 6
 #endif
@@ -106,6 +106,8 @@ void Xprt_register(SVCXPRT * xprt)
 #endif                          /* def FD_SETSIZE */
   if(sock > svc_maxfd)
     svc_maxfd = sock;
+
+  Svc_epoll_add(sock);
 }
 
 /*
@@ -128,6 +130,7 @@ void Xprt_unregister(SVCXPRT * xprt)
       svc_fds &= ~(1 << sock);
     }
 #endif                          /* def FD_SETSIZE */
+  Svc_epoll_del(sock);
   if(svc_maxfd <= sock)
     {
       while((svc_maxfd > 0) && Xports[svc_maxfd] == 0)
@@ -286,6 +286,7 @@ static bool_t Rendezvous_request(register SVCXPRT * xprt, struct rpc_msg *msg)
   xprt->xp_laddrlen = llen;
 
   FD_CLR(xprt->XP_SOCK, &Svc_fdset);
+  Svc_epoll_del(xprt->XP_SOCK);
 
   if(pthread_cond_init(&condvar_xprt[xprt->XP_SOCK], NULL) != 0)
     return FALSE;
@@ -66,7 +66,8 @@ int Xprt_register(SVCXPRT * xprt)
       mysvc_maxfd = max(mysvc_maxfd, sock);
     }
 
-  return TRUE;
+  /* The event set is not limited to FD_SETSIZE */
+  return Svc_epoll_add(sock);
 }
 
 /*
@@ -80,6 +81,7 @@ void Xprt_unregister(SVCXPRT * xprt)
   if(Xports[sock] == xprt)
     {
       Xports[sock] = (SVCXPRT *) 0;
+      Svc_epoll_del(sock);
     }
 
   if(sock < FD_SETSIZE)
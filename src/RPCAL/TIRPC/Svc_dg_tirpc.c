@@ -32,8 +32,6 @@
  * Copyright (c) 1986-1991 by Sun Microsystems Inc.
  */
 
-#include <sys/cdefs.h>
-
 /*
  * svc_dg.c, Server side for connectionless RPC.
  *
@@ -43,6 +41,8 @@
 #include "config.h"
 #endif
 
+#include <sys/cdefs.h>
+
 #ifdef _SOLARIS
 #include "solaris_port.h"
 #endif
@@ -164,6 +164,12 @@ u_int recvsize;
  /*ARGSUSED*/ static enum xprt_stat Svc_dg_stat(xprt)
 SVCXPRT *xprt;
 {
+  struct svc_dg_batch *sb = dg_batch(xprt);
+
+  /* Datagrams of the last batch are still waiting to be decoded */
+  if(sb != NULL && sb->next < sb->count)
+    return (XPRT_MOREREQS);
+
   return (XPRT_IDLE);
 }
 
@@ -178,15 +184,51 @@ struct rpc_msg *msg;
   socklen_t alen;
   size_t replylen;
   ssize_t rlen;
+#ifdef HAVE_RECVMMSG
+  struct svc_dg_batch *sb = dg_batch(xprt);
+  u_int i;
+#endif
 
  again:
-  alen = sizeof(struct sockaddr_storage);
-  rlen = recvfrom(xprt->xp_fd, rpc_buffer(xprt), su->su_iosz, 0,
-                  (struct sockaddr *)(void *)&ss, &alen);
-  if(rlen == -1 && errno == EINTR)
-    goto again;
-  if(rlen == -1 || (rlen < (ssize_t) (4 * sizeof(u_int32_t))))
-    return (FALSE);
+#ifdef HAVE_RECVMMSG
+  if(sb != NULL)
+    {
+      /* Only go to the socket once the last batch is used up */
+      if(sb->next == sb->count)
+        {
+          int nb;
+
+          for(i = 0; i < sb->nb_slots; i++)
+            sb->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+
+          nb = recvmmsg(xprt->xp_fd, sb->msgs, sb->nb_slots, MSG_DONTWAIT, NULL);
+          if(nb == -1 && errno == EINTR)
+            goto again;
+          if(nb <= 0)
+            return (FALSE);
+          sb->count = nb;
+          sb->next = 0;
+        }
+
+      i = sb->next++;
+      rlen = sb->msgs[i].msg_len;
+      alen = sb->msgs[i].msg_hdr.msg_namelen;
+      if(rlen < (ssize_t) (4 * sizeof(u_int32_t)))
+        return (FALSE);
+      memcpy(&ss, &sb->addrs[i], alen);
+      memcpy(rpc_buffer(xprt), sb->iovs[i].iov_base, rlen);
+    }
+  else
+#endif
+    {
+      alen = sizeof(struct sockaddr_storage);
+      rlen = recvfrom(xprt->xp_fd, rpc_buffer(xprt), su->su_iosz, 0,
+                      (struct sockaddr *)(void *)&ss, &alen);
+      if(rlen == -1 && errno == EINTR)
+        goto again;
+      if(rlen == -1 || (rlen < (ssize_t) (4 * sizeof(u_int32_t))))
+        return (FALSE);
+    }
   if(xprt->xp_rtaddr.len < alen)
     {
       if(xprt->xp_rtaddr.len != 0)
@@ -344,6 +386,79 @@ SVCXPRT *xprt;
   xprt->xp_ops2 = &dg_ops2;
 }
 
+/*
+ * Receive the datagrams in batches of nb_slots with recvmmsg. They are
+ * then decoded one by one by Svc_dg_recv, Svc_dg_stat tells XPRT_MOREREQS
+ * while some are left. The transport must not be shared by several threads.
+ * Returns 1 on success, 0 on failure.
+ */
+static const char batch_enable_str[] = "svc_dg_enablebatch: %s";
+
+int Svc_dg_enablebatch(xprt, nb_slots)
+SVCXPRT *xprt;
+u_int nb_slots;
+{
+#ifdef HAVE_RECVMMSG
+  struct svc_dg_data *su = su_data(xprt);
+  struct svc_dg_batch *sb;
+  u_int i;
+
+  if(dg_batch(xprt) != NULL || nb_slots == 0)
+    return (0);
+
+  sb = (struct svc_dg_batch *)Mem_Alloc(sizeof(struct svc_dg_batch));
+  if(sb == NULL)
+    {
+      warnx(batch_enable_str, __no_mem_str);
+      return (0);
+    }
+  memset(sb, 0, sizeof(struct svc_dg_batch));
+  sb->nb_slots = nb_slots;
+  xprt->xp_p3 = sb;
+
+  sb->msgs = (struct mmsghdr *)Mem_Alloc(sizeof(struct mmsghdr) * nb_slots);
+  sb->iovs = (struct iovec *)Mem_Alloc(sizeof(struct iovec) * nb_slots);
+  sb->addrs = (struct sockaddr_storage *)Mem_Alloc(sizeof(struct sockaddr_storage) * nb_slots);
+  sb->bufs = Mem_Alloc(su->su_iosz * nb_slots);
+  if(sb->msgs == NULL || sb->iovs == NULL || sb->addrs == NULL || sb->bufs == NULL)
+    {
+      warnx(batch_enable_str, __no_mem_str);
+      Svc_dg_freebatch(xprt);
+      return (0);
+    }
+
+  memset(sb->msgs, 0, sizeof(struct mmsghdr) * nb_slots);
+  for(i = 0; i < nb_slots; i++)
+    {
+      sb->iovs[i].iov_base = sb->bufs + i * su->su_iosz;
+      sb->iovs[i].iov_len = su->su_iosz;
+      sb->msgs[i].msg_hdr.msg_iov = &sb->iovs[i];
+      sb->msgs[i].msg_hdr.msg_iovlen = 1;
+      sb->msgs[i].msg_hdr.msg_name = &sb->addrs[i];
+    }
+  return (1);
+#else
+  warnx(batch_enable_str, "recvmmsg is not available");
+  return (0);
+#endif
+}
+
+void Svc_dg_freebatch(xprt)
+SVCXPRT *xprt;
+{
+  struct svc_dg_batch *sb = dg_batch(xprt);
+
+  if(sb == NULL)
+    return;
+
+  xp_free(sb->msgs);
+  xp_free(sb->iovs);
+  xp_free(sb->addrs);
+  xp_free(sb->bufs);
+  Mem_Free(sb);
+  xprt->xp_p3 = NULL;
+}
+
 /*  The CACHING COMPONENT */
 
 /*
@@ -59,6 +59,8 @@
 rw_lock_t Svc_fd_lock;
 int Svc_maxfd;
 
+static void __Xprt_do_unregister(SVCXPRT * xprt, bool_t dolock);
+
 /* ***************  SVCXPRT related stuff **************** */
 
 /*
@@ -95,6 +97,13 @@ SVCXPRT *xprt;
 
   Xports[sock] = xprt;
 
+  /* The event set is not limited to FD_SETSIZE */
+  if(!Svc_epoll_add(sock))
+    {
+      __Xprt_do_unregister(xprt, TRUE);
+      return FALSE;
+    }
+
   return TRUE;
 }
 
@@ -117,6 +126,7 @@ bool_t dolock;
   if(Xports[sock] == xprt)
     {
       Xports[sock] = NULL;
+      Svc_epoll_del(sock);
 
       if(sock < FD_SETSIZE)
         {
@@ -181,6 +191,7 @@ void FreeXprt(SVCXPRT *xprt)
         }
       xp_free(su_data(xprt));
       xp_free(rpc_buffer(xprt));
+      Svc_dg_freebatch(xprt);
     }
   else if (xprt->xp_ops == &vc_ops)
     {
@@ -297,6 +308,7 @@ SVCXPRT *Svcxprt_copy(SVCXPRT *xprt_copy, SVCXPRT *xprt_orig)
       xprt_copy->xp_p1 = cd_c;
 #ifndef NO_XDRREC_PATCH
       Xdrrec_create(&(cd_c->xdrs), cd_c->sendsize, cd_c->recvsize, xprt_copy, Read_vc, Write_vc);
+      Xdrrec_setwritev(&(cd_c->xdrs), Writev_vc);
 #else
       xdrrec_create(&(cd_c->xdrs), cd_c->sendsize, cd_c->recvsize, xprt_copy, Read_vc, Write_vc);
 #endif
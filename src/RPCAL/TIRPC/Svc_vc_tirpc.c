@@ -73,6 +73,15 @@ int fridgethr_get( pthread_t * pthrid, void *(*thrfunc)(void*), void * thrarg )
 extern rw_lock_t Svc_fd_lock;
 
 extern void *rpc_tcp_socket_manager_thread(void *Arg);
+#ifdef HAVE_SYS_EPOLL_H
+extern int rpc_tcp_reactor_register(int tcp_sock);
+#endif
+
+/* Attempts of Rendezvous_request to free a descriptor when it runs out */
+#define RENDEZVOUS_CLEAN_RETRIES 100
+
+/* Seconds a non-blocking connection may stall while its reply is written */
+static int Svc_vc_write_timeout = 2;
 
 static SVCXPRT *Makefd_xprt(int, u_int, u_int);
 static bool_t Rendezvous_request(SVCXPRT *, struct rpc_msg *);
@@ -200,8 +209,10 @@ static SVCXPRT *Makefd_xprt(int fd, u_int sendsize, u_int recvsize)
   xprt->xp_p1 = cd;
 
   cd->strm_stat = XPRT_IDLE;
+  cd->reactor = FALSE;
 #ifndef NO_XDRREC_PATCH
   Xdrrec_create(&(cd->xdrs), sendsize, recvsize, xprt, Read_vc, Write_vc);
+  Xdrrec_setwritev(&(cd->xdrs), Writev_vc);
 #else
   xdrrec_create(&(cd->xdrs), sendsize, recvsize, xprt, Read_vc, Write_vc);
 #endif
@@ -232,9 +243,12 @@ static bool_t Rendezvous_request(SVCXPRT *xprt, struct rpc_msg *msg)
   socklen_t len;
   struct __rpc_sockinfo si;
   SVCXPRT *newxprt;
+  int nb_clean = 0;
 
+#ifndef HAVE_SYS_EPOLL_H
   pthread_t sockmgr_thrid;
   int rc = 0;
+#endif
 
   assert(xprt != NULL);
   assert(msg != NULL);
@@ -247,14 +261,23 @@ static bool_t Rendezvous_request(SVCXPRT *xprt, struct rpc_msg *msg)
     {
       if(errno == EINTR)
         goto again;
+      /* The dispatcher accepted every pending connection */
+      if(errno == EAGAIN || errno == EWOULDBLOCK)
+        return (FALSE);
       /*
        * Clean out the most idle file descriptor when we're
-       * running out.
+       * running out. A connection of a TCP reactor is closed by its
+       * reactor, give it a moment. If nothing can be freed, errno tells
+       * the dispatcher to stop accepting until the next event.
        */
       if(errno == EMFILE || errno == ENFILE)
         {
-          Svc_clean_idle(0, FALSE);
-          goto again;
+          if(nb_clean++ < RENDEZVOUS_CLEAN_RETRIES && Svc_clean_idle(0, FALSE))
+            {
+              usleep(1000);
+              goto again;
+            }
+          return (FALSE);
         }
       LogCrit(COMPONENT_DISPATCH,
               "Error in accept xp_fd=%u, errno=%u (%s)",
@@ -298,16 +321,20 @@ static bool_t Rendezvous_request(SVCXPRT *xprt, struct rpc_msg *msg)
   cd->sendsize = r->sendsize;
   cd->maxrec = r->maxrec;
 
+#ifdef HAVE_SYS_EPOLL_H
+  /* A TCP reactor serves many connections, none of them may block it */
+  if(cd->maxrec == 0)
+    cd->maxrec = cd->recvsize;
+#endif
+
   if(cd->maxrec != 0)
     {
       flags = fcntl(sock, F_GETFL);
-      if(flags == -1)
+      if(flags == -1 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1)
         {
-          FreeXprt(xprt);
+          Svc_vc_destroy(newxprt);
           return (FALSE);
         }
-      /*if (fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1)
-         return (FALSE); */
       if(cd->recvsize > cd->maxrec)
         cd->recvsize = cd->maxrec;
       cd->nonblock = TRUE;
@@ -317,15 +344,28 @@ static bool_t Rendezvous_request(SVCXPRT *xprt, struct rpc_msg *msg)
     cd->nonblock = FALSE;
   gettimeofday(&cd->last_recv_time, NULL);
 
+  /* The connection is not managed by the dispatcher */
   FD_CLR(newxprt->xp_fd, &Svc_fdset);
+  Svc_epoll_del(newxprt->xp_fd);
 
+#ifdef HAVE_SYS_EPOLL_H
+  /* It is served by one of the TCP reactors */
+  cd->reactor = TRUE;
+  if(rpc_tcp_reactor_register(newxprt->xp_fd) != 0)
+    {
+      Svc_vc_destroy(newxprt);
+      return FALSE;
+    }
+#else
+  /* It is managed by its own thread */
   if((rc =
       fridgethr_get(&sockmgr_thrid, rpc_tcp_socket_manager_thread,
                      (void *)((unsigned long)newxprt->xp_fd))) != 0)
     {
-      FreeXprt(xprt);
+      Svc_vc_destroy(newxprt);
       return FALSE;
     }
+#endif
 
   return (FALSE);               /* there is never an rpc msg to be processed */
 }
@@ -400,15 +440,18 @@ int Read_vc(void *xprtp, void *buf, int len)
 
   if(cfp->nonblock)
     {
+      /* 0 means "nothing to read for now", end of stream is an error */
       len = read(sock, buf, (size_t) len);
       if(len < 0)
         {
-          if(errno == EAGAIN)
+          if(errno == EAGAIN || errno == EINTR)
             len = 0;
           else
             goto fatal_err;
         }
-      if(len != 0)
+      else if(len == 0)
+        goto fatal_err;
+      else
         gettimeofday(&cfp->last_recv_time, NULL);
       return len;
     }
@@ -453,6 +496,7 @@ int Write_vc(void *xprtp, void *buf, int len)
   int i, cnt;
   struct cf_conn *cd;
   struct timeval tv0, tv1;
+  struct pollfd pollfd;
 
   xprt = (SVCXPRT *) xprtp;
   assert(xprt != NULL);
@@ -476,18 +520,91 @@ int Write_vc(void *xprtp, void *buf, int len)
             {
               /*
                * For non-blocking connections, do not
-               * take more than 2 seconds writing the
-               * data out.
-               *
-               * XXX 2 is an arbitrary amount.
+               * take more than Svc_vc_write_timeout seconds
+               * writing the data out.
                */
               gettimeofday(&tv1, NULL);
-              if(tv1.tv_sec - tv0.tv_sec >= 2)
+              if(tv1.tv_sec - tv0.tv_sec >= Svc_vc_write_timeout)
                 {
                   cd->strm_stat = XPRT_DIED;
                   return (-1);
                 }
+
+              /* Wait for room in the socket buffer rather than spinning */
+              pollfd.fd = xprt->xp_fd;
+              pollfd.events = POLLOUT;
+              pollfd.revents = 0;
+              (void)poll(&pollfd, 1, 100);
             }
+          i = 0;                /* nothing was written */
+        }
+    }
+
+  return (len);
+}
+
+/*
+ * writes an iovec array to the tcp connection, this lets large replies
+ * go out from the buffers they were read into.
+ * Any error is fatal and the connection is closed.
+ */
+int Writev_vc(void *xprtp, struct iovec *iov, int iovcnt)
+{
+  SVCXPRT *xprt;
+  int i, len;
+  struct cf_conn *cd;
+  struct timeval tv0, tv1;
+  struct pollfd pollfd;
+
+  xprt = (SVCXPRT *) xprtp;
+  assert(xprt != NULL);
+
+  cd = (struct cf_conn *)xprt->xp_p1;
+
+  if(cd->nonblock)
+    gettimeofday(&tv0, NULL);
+
+  for(len = 0, i = 0; i < iovcnt; i++)
+    len += iov[i].iov_len;
+
+  while(iovcnt > 0)
+    {
+      i = writev(xprt->xp_fd, iov, iovcnt);
+      if(i < 0)
+        {
+          if(errno != EAGAIN || !cd->nonblock)
+            {
+              cd->strm_stat = XPRT_DIED;
+              return (-1);
+            }
+
+          /* Same limit as Write_vc */
+          gettimeofday(&tv1, NULL);
+          if(tv1.tv_sec - tv0.tv_sec >= Svc_vc_write_timeout)
+            {
+              cd->strm_stat = XPRT_DIED;
+              return (-1);
+            }
+
+          pollfd.fd = xprt->xp_fd;
+          pollfd.events = POLLOUT;
+          pollfd.revents = 0;
+          (void)poll(&pollfd, 1, 100);
+          continue;
+        }
+
+      /* Skip what was written, resume in the middle of a partly written iovec */
+      while(iovcnt > 0 && i >= (int)iov->iov_len)
+        {
+          i -= iov->iov_len;
+          iov++;
+          iovcnt--;
+        }
+
+      if(iovcnt > 0)
+        {
+          iov->iov_base = (char *)iov->iov_base + i;
+          iov->iov_len -= i;
         }
     }
 
@@ -520,14 +637,18 @@ bool_t Svc_vc_recv(SVCXPRT *xprt, struct rpc_msg *msg)
   cd = (struct cf_conn *)(xprt->xp_p1);
   xdrs = &(cd->xdrs);
 
+  xdrs->x_op = XDR_DECODE;
+
+  /* In non-blocking mode, __Xdrrec_getrec leaves the stream at the start of a
+   * complete record: skipping would read the header of the next one */
   if(cd->nonblock)
     {
       if(!__Xdrrec_getrec(xdrs, &cd->strm_stat, TRUE))
         return FALSE;
     }
+  else
+    (void)Xdrrec_skiprecord(xdrs);
 
-  xdrs->x_op = XDR_DECODE;
-  (void)Xdrrec_skiprecord(xdrs);
   if(xdr_callmsg(xdrs, msg))
     {
       cd->x_id = msg->rm_xid;
@@ -679,10 +800,41 @@ int __rpc_get_local_uid(SVCXPRT * transp, uid_t * uid)
     return (-1);
 }
 
+/*
+ * Sets how long a non-blocking connection may stall while a reply is written
+ * before it is dropped. A client this slow to read is likely gone.
+ */
+void Svc_vc_setwritetimeout(int seconds)
+{
+  if(seconds > 0)
+    Svc_vc_write_timeout = seconds;
+}
+
+/*
+ * Destroy the idle xprt of a sweep, or hand it back to its TCP reactor.
+ * A reactor may be using the xprt: shutting the socket down makes the reactor
+ * see the end of the stream and destroy the xprt itself.
+ */
+static void Svc_clean_one(SVCXPRT *xprt)
+{
+  struct cf_conn *cd = (struct cf_conn *)xprt->xp_p1;
+
+  if(cd->reactor)
+    {
+      (void)shutdown(xprt->xp_fd, SHUT_RDWR);
+      return;
+    }
+
+  __Xprt_unregister_unlocked(xprt);
+  __Svc_vc_dodestroy(xprt);
+}
+
 /*
  * Destroy xprts that have not have had any activity in 'timeout' seconds.
  * If 'cleanblock' is true, blocking connections (the default) are also
  * cleaned. If timeout is 0, the least active connection is picked.
+ * Connections of the TCP reactors are closed by their reactor, soon after
+ * this returns.
  */
 bool_t Svc_clean_idle(int timeout, bool_t cleanblock)
 {
@@ -718,16 +870,14 @@ bool_t Svc_clean_idle(int timeout, bool_t cleanblock)
             }
           if(tv.tv_sec - cd->last_recv_time.tv_sec > timeout)
             {
-              __Xprt_unregister_unlocked(xprt);
-              __Svc_vc_dodestroy(xprt);
+              Svc_clean_one(xprt);
               ncleaned++;
             }
         }
     }
   if(timeout == 0 && least_active != NULL)
     {
-      __Xprt_unregister_unlocked(least_active);
-      __Svc_vc_dodestroy(least_active);
+      Svc_clean_one(least_active);
       ncleaned++;
     }
   V_w(&Svc_fd_lock);
@@ -123,6 +123,14 @@ static const struct  xdr_ops Xdrrec_ops = {
 
 #define LAST_FRAG ((u_int32_t)(1 << 31))
 
+/*
+ * Opaque data at least this large is not copied to the output buffer when
+ * the stream has a writevit: it ends the current fragment and is sent from
+ * the caller's memory, along with the buffer, when the buffer is flushed.
+ * The caller's memory must stay valid until the end of the record.
+ */
+#define XDRREC_ZEROCOPY_MIN 8192
+
 typedef struct rec_strm {
 	char *tcp_handle;
 	/*
@@ -134,6 +142,10 @@ typedef struct rec_strm {
 	char *out_boundry;	/* data cannot up to this address */
 	u_int32_t *frag_header;	/* beginning of curren fragment */
 	bool_t frag_sent;	/* true if buffer sent in middle of record */
+	int (*writevit)(void *, struct iovec *, int);
+	const char *zc_base;	/* data sent without copy, if any */
+	u_int zc_len;
+	u_int zc_prefix;	/* buffer bytes to send before zc_base */
 	/*
 	 * in-coming bits
 	 */
@@ -224,6 +236,10 @@ Xdrrec_create(xdrs, sendsize, recvsize, tcp_handle, readit, writeit)
 	rstrm->out_finger += sizeof(u_int32_t);
 	rstrm->out_boundry += sendsize;
 	rstrm->frag_sent = FALSE;
+	rstrm->writevit = NULL;
+	rstrm->zc_base = NULL;
+	rstrm->zc_len = 0;
+	rstrm->zc_prefix = 0;
 	rstrm->in_size = recvsize;
 	rstrm->in_boundry = rstrm->in_base;
 	rstrm->in_finger = (rstrm->in_boundry += recvsize);
@@ -237,6 +253,20 @@ Xdrrec_create(xdrs, sendsize, recvsize, tcp_handle, readit, writeit)
 	rstrm->in_received = 0;
 }
 
+/*
+ * Lets the stream send large opaque data without copying it, through
+ * writevit, which is like writev but is passed the tcp_handle.
+ */
+void
+Xdrrec_setwritev(xdrs, writevit)
+	XDR *xdrs;
+	int (*writevit)(void *, struct iovec *, int);
+{
+	RECSTREAM *rstrm = (RECSTREAM *)(xdrs->x_private);
+
+	rstrm->writevit = writevit;
+}
+
 
 /*
  * The reoutines defined below are the xdr ops which will go into the
@@ -327,6 +357,29 @@ Xdrrec_putbytes(xdrs, addr, len)
 {
 	RECSTREAM *rstrm = (RECSTREAM *)(xdrs->x_private);
 	size_t current;
+	u_int32_t frag_len;
+
+	if (rstrm->writevit != NULL && len >= XDRREC_ZEROCOPY_MIN) {
+		/* Only one piece of data is held back at a time */
+		if (rstrm->zc_len != 0 ||
+		    rstrm->out_finger + sizeof(u_int32_t) > rstrm->out_boundry) {
+			rstrm->frag_sent = TRUE;
+			if (! flush_out(rstrm, FALSE))
+				return (FALSE);
+		}
+
+		/* The data ends the current fragment, a new one follows it */
+		frag_len = (u_int32_t)((u_long)(rstrm->out_finger) - 
+		    (u_long)(rstrm->frag_header) - sizeof(u_int32_t)) + len;
+		*(rstrm->frag_header) = htonl(frag_len);
+		rstrm->zc_base = addr;
+		rstrm->zc_len = len;
+		rstrm->zc_prefix = (u_int)((u_long)(rstrm->out_finger) -
+		    (u_long)(rstrm->out_base));
+		rstrm->frag_header = (u_int32_t *)(void *)rstrm->out_finger;
+		rstrm->out_finger += sizeof(u_int32_t);
+		return (TRUE);
+	}
 
 	while (len > 0) {
 		current = (size_t)((u_long)rstrm->out_boundry -
@@ -356,6 +409,10 @@ Xdrrec_getpos(xdrs)
 
 		case XDR_ENCODE:
 			pos = rstrm->out_finger - rstrm->out_base - BYTES_PER_XDR_UNIT;
+			/* The data held back counts, the header of the fragment
+			 * started after it does not */
+			if (rstrm->zc_len != 0)
+				pos += rstrm->zc_len - sizeof(u_int32_t);
 			break;
 
 		case XDR_DECODE:
@@ -383,8 +440,11 @@ Xdrrec_setpos(xdrs, pos)
 		switch (xdrs->x_op) {
 
 		case XDR_ENCODE:
+			/* Positions count the data held back (see Xdrrec_getpos),
+			 * only the bytes after it are still in the buffer */
 			newpos = rstrm->out_finger - delta;
-			if ((newpos > (char *)(void *)(rstrm->frag_header)) &&
+			if ((newpos >= (char *)(void *)(rstrm->frag_header) +
+				sizeof(u_int32_t)) &&
 				(newpos < rstrm->out_boundry)) {
 				rstrm->out_finger = newpos;
 				return (TRUE);
@@ -528,7 +588,7 @@ Xdrrec_endofrecord(xdrs, sendnow)
 	RECSTREAM *rstrm = (RECSTREAM *)(xdrs->x_private);
 	u_long len;  /* fragment length */
 
-	if (sendnow || rstrm->frag_sent ||
+	if (sendnow || rstrm->frag_sent || rstrm->zc_len != 0 ||
 		((u_long)rstrm->out_finger + sizeof(u_int32_t) >=
 		(u_long)rstrm->out_boundry)) {
 		rstrm->frag_sent = FALSE;
@@ -545,6 +605,9 @@ Xdrrec_endofrecord(xdrs, sendnow)
 /*
  * Fill the stream buffer with a record for a non-blocking connection.
  * Return true if a record is available in the buffer, false if not.
+ * The readit routine returns 0 when no data can be read for now (the
+ * end of the stream is reported as an error), the record is then
+ * completed by a later call.
  */
 bool_t
 __Xdrrec_getrec(xdrs, statp, expectdata)
@@ -560,7 +623,7 @@ __Xdrrec_getrec(xdrs, statp, expectdata)
 		n = rstrm->readit(rstrm->tcp_handle, rstrm->in_hdrp,
 		    (int)sizeof (rstrm->in_header) - rstrm->in_hdrlen);
 		if (n == 0) {
-			*statp = expectdata ? XPRT_DIED : XPRT_IDLE;
+			*statp = rstrm->in_hdrlen ? XPRT_MOREREQS : XPRT_IDLE;
 			return FALSE;
 		}
 		if (n < 0) {
@@ -599,7 +662,7 @@ __Xdrrec_getrec(xdrs, statp, expectdata)
 	}
 
 	if (n == 0) {
-		*statp = expectdata ? XPRT_DIED : XPRT_IDLE;
+		*statp = XPRT_MOREREQS;
 		return FALSE;
 	}
 
@@ -649,11 +712,26 @@ flush_out(rstrm, eor)
 	u_int32_t len = (u_int32_t)((u_long)(rstrm->out_finger) - 
 		(u_long)(rstrm->frag_header) - sizeof(u_int32_t));
 
+	struct iovec iov[3];
+
 	*(rstrm->frag_header) = htonl(len | eormask);
 	len = (u_int32_t)((u_long)(rstrm->out_finger) - 
 	    (u_long)(rstrm->out_base));
-	if ((*(rstrm->writeit))(rstrm->tcp_handle, rstrm->out_base, (int)len)
-		!= (int)len)
+	if (rstrm->zc_len != 0) {
+		/* The held back data goes out between the two fragments */
+		iov[0].iov_base = rstrm->out_base;
+		iov[0].iov_len = rstrm->zc_prefix;
+		iov[1].iov_base = (void *)rstrm->zc_base;
+		iov[1].iov_len = rstrm->zc_len;
+		iov[2].iov_base = rstrm->out_base + rstrm->zc_prefix;
+		iov[2].iov_len = len - rstrm->zc_prefix;
+		len += rstrm->zc_len;
+		rstrm->zc_base = NULL;
+		rstrm->zc_len = 0;
+		if ((*(rstrm->writevit))(rstrm->tcp_handle, iov, 3) != (int)len)
+			return (FALSE);
+	} else if ((*(rstrm->writeit))(rstrm->tcp_handle, rstrm->out_base,
+	    (int)len) != (int)len)
 		return (FALSE);
 	rstrm->frag_header = (u_int32_t *)(void *)rstrm->out_base;
 	rstrm->out_finger = (char *)rstrm->out_base + sizeof(u_int32_t);
@@ -4,6 +4,7 @@
 #ifndef GANESHA_TIRPC_H
 #define GANESHA_TIRPC_H
 
+#include <sys/uio.h>
 #include "../rpcal.h"
 #include <Rpc_com_tirpc.h>
 #ifdef PORTMAP
@@ -21,6 +22,7 @@ extern int Svc_maxfd;
 #define	su_data(xprt)	((struct svc_dg_data *)(xprt->xp_p2))
 #define	su_data_set(xprt)	(xprt->xp_p2)
 #define	rpc_buffer(xprt) ((xprt)->xp_p1)
+#define	dg_batch(xprt)	((struct svc_dg_batch *)(xprt->xp_p3))
 
 struct cf_rendezvous
 {                               /* kept in xprt->xp_p1 for rendezvouser */
@@ -39,9 +41,21 @@ struct cf_conn
   u_int recvsize;
   int maxrec;
   bool_t nonblock;
+  bool_t reactor;               /* served by a TCP reactor, only it may destroy the xprt */
   struct timeval last_recv_time;
 };
 
+struct svc_dg_batch
+{                               /* kept in xprt->xp_p3, datagrams received by one recvmmsg */
+  u_int nb_slots;
+  u_int count;                  /* datagrams received by the last recvmmsg */
+  u_int next;                   /* next datagram to be decoded */
+  struct mmsghdr *msgs;
+  struct iovec *iovs;
+  struct sockaddr_storage *addrs;
+  char *bufs;                   /* nb_slots buffers of su_iosz bytes */
+};
+
 #define	SPARSENESS 4            /* 75% sparse */
 
 /*
@@ -93,8 +107,10 @@ struct cl_cache
 extern pthread_mutex_t dupreq_lock;
 
 extern int Svc_dg_enablecache(SVCXPRT *, u_int);
+extern void Svc_dg_freebatch(SVCXPRT *);
 extern int Read_vc(void *, void *, int);
 extern int Write_vc(void *, void *, int);
+extern int Writev_vc(void *, struct iovec *, int);
 
 #ifndef NO_XDRREC_PATCH
 extern void Xdrrec_create(XDR *xdrs,
@@ -103,6 +119,8 @@ extern void Xdrrec_create(XDR *xdrs,
                           void *tcp_handle,
                           int (*readit)(void *, void *, int), /* like read, but pass it a tcp_handle, not sock */
                           int (*writeit)(void *, void *, int)); /* like write, but pass it a tcp_handle, not sock */
+extern void     Xdrrec_setwritev(XDR *xdrs,
+                                 int (*writevit)(void *, struct iovec *, int)); /* like writev, but pass it a tcp_handle */
 extern bool_t   Xdrrec_eof(XDR *);
 extern bool_t   __Xdrrec_setnonblock(XDR *, int);
 extern bool_t   Xdrrec_endofrecord(XDR *, bool_t);
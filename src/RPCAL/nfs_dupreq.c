@@ -84,7 +84,10 @@ extern nfs_function_desc_t rquota1_func_desc[];
 extern nfs_function_desc_t rquota2_func_desc[];
 #endif                          /* _USE_QUOTA */
 /* Structure used for duplicated request cache */
-hash_table_t *ht_dupreq;
+static dupreq_partition_t *dupreq_partitions = NULL;
+static unsigned int dupreq_nb_partitions = 0;
+static unsigned int dupreq_nb_entries = 0;      /* per transport, a power of 2 */
+static time_t dupreq_last_gc = 0;
 
 void LogDupReq(const char *label, sockaddr_t *addr, long xid, u_long rq_prog)
 {
@@ -155,51 +158,31 @@ unsigned int get_rpc_xid(struct svc_req *reqp)
 
 /**
  *
- * print_entry_dupreq: prints an entry in the LRU list.
+ * nfs_dupreq_func_desc: locates the function descriptor of a cached request.
  *
- * prints an entry in the LRU list.
+ * @param pdupreq [IN] the cached request
  *
- * @param data [IN] data stored in a LRU entry to be printed.
- * @param str [OUT] string used to store the result.
- *
- * @return 0 if ok, other values mean an error.
+ * @return the function descriptor, the one of NFSv2 NULL if unknown.
  *
  */
-int print_entry_dupreq(LRU_data_t data, char *str)
-{
-  strcpy(str, "");
-  return 0;
-}
-
-static int _remove_dupreq(hash_buffer_t *buffkey, dupreq_entry_t *pdupreq,
-                          struct prealloc_pool *dupreq_pool, int nfs_req_status)
+static nfs_function_desc_t *nfs_dupreq_func_desc(dupreq_entry_t * pdupreq)
 {
-  int rc;
-  nfs_function_desc_t funcdesc = nfs2_func_desc[0];
-
-  rc = HashTable_Del(ht_dupreq, buffkey, NULL, NULL);
-
-  /* if hashtable no such key => dupreq garbaged by another thread */
-  if(rc != HASHTABLE_SUCCESS && rc != HASHTABLE_ERROR_NO_SUCH_KEY)
-    return 1;                   /* Error while cleaning */
-  else if(rc == HASHTABLE_ERROR_NO_SUCH_KEY)
-    return 0;                   /* don't free the dupreq twice */
+  nfs_function_desc_t *pfuncdesc = &nfs2_func_desc[0];
 
-  /* Locate the function descriptor associated with this cached request */
   if(pdupreq->rq_prog == nfs_param.core_param.program[P_NFS])
     {
       switch (pdupreq->rq_vers)
         {
         case NFS_V2:
-          funcdesc = nfs2_func_desc[pdupreq->rq_proc];
+          pfuncdesc = &nfs2_func_desc[pdupreq->rq_proc];
           break;
 
         case NFS_V3:
-          funcdesc = nfs3_func_desc[pdupreq->rq_proc];
+          pfuncdesc = &nfs3_func_desc[pdupreq->rq_proc];
           break;
 
         case NFS_V4:
-          funcdesc = nfs4_func_desc[pdupreq->rq_proc];
+          pfuncdesc = &nfs4_func_desc[pdupreq->rq_proc];
           break;
 
         default:
@@ -214,11 +197,11 @@ static int _remove_dupreq(hash_buffer_t *buffkey, dupreq_entry_t *pdupreq,
       switch (pdupreq->rq_vers)
         {
         case MOUNT_V1:
-          funcdesc = mnt1_func_desc[pdupreq->rq_proc];
+          pfuncdesc = &mnt1_func_desc[pdupreq->rq_proc];
           break;
 
         case MOUNT_V3:
-          funcdesc = mnt3_func_desc[pdupreq->rq_proc];
+          pfuncdesc = &mnt3_func_desc[pdupreq->rq_proc];
           break;
 
         default:
@@ -236,7 +219,7 @@ static int _remove_dupreq(hash_buffer_t *buffkey, dupreq_entry_t *pdupreq,
       switch (pdupreq->rq_vers)
         {
         case NLM4_VERS:
-          funcdesc = nlm4_func_desc[pdupreq->rq_proc];
+          pfuncdesc = &nlm4_func_desc[pdupreq->rq_proc];
           break;
         }                       /* switch( pdupreq->vers ) */
     }
@@ -248,11 +231,11 @@ static int _remove_dupreq(hash_buffer_t *buffkey, dupreq_entry_t *pdupreq,
       switch (pdupreq->rq_vers)
         {
         case RQUOTAVERS:
-          funcdesc = rquota1_func_desc[pdupreq->rq_proc];
+          pfuncdesc = &rquota1_func_desc[pdupreq->rq_proc];
           break;
 
         case EXT_RQUOTAVERS:
-          funcdesc = rquota2_func_desc[pdupreq->rq_proc];
+          pfuncdesc = &rquota2_func_desc[pdupreq->rq_proc];
           break;
         }                       /* switch( pdupreq->vers ) */
     }
@@ -265,225 +248,249 @@ static int _remove_dupreq(hash_buffer_t *buffkey, dupreq_entry_t *pdupreq,
                (int)pdupreq->rq_prog);
     }
 
-  /* Call the free function */
-  if (nfs_req_status == NFS_REQ_OK)
-    funcdesc.free_function(&(pdupreq->res_nfs));
-
-  /* Send the entry back to the pool */
-  ReleaseToPool(pdupreq, dupreq_pool);
-
-  return DUPREQ_SUCCESS;
-}
-
-int nfs_dupreq_delete(long xid, struct svc_req *ptr_req, SVCXPRT *xprt,
-                      struct prealloc_pool *dupreq_pool)
-{
-  int status;
-
-  hash_buffer_t buffkey;
-  hash_buffer_t buffval;
-  dupreq_key_t dupkey;
-  dupreq_entry_t *pdupreq;
-
-  /* Get the socket address for the key */
-  if(copy_xprt_addr(&dupkey.addr, xprt) == 0)
-    return DUPREQ_NOT_FOUND;
-
-  dupkey.xid = xid;
-  dupkey.checksum = 0;
-
-  /* I have to keep an integer as key, I wil use the pointer buffkey->pdata for this,
-   * this also means that buffkey->len will be 0 */
-  buffkey.pdata = (caddr_t) &dupkey;
-  buffkey.len = sizeof(dupreq_key_t);
-
-  if(HashTable_Get(ht_dupreq, &buffkey, &buffval) == HASHTABLE_SUCCESS)
-    {
-      pdupreq = (dupreq_entry_t *) buffval.pdata;
-
-      /* reset timestamp */
-      pdupreq->timestamp = time(NULL);
-
-      status = DUPREQ_SUCCESS;
-    }
-  else {
-    return DUPREQ_NOT_FOUND;
-  }
-
-  LogDupReq("REMOVING", &pdupreq->addr, pdupreq->xid, pdupreq->rq_prog);
-
-  status = _remove_dupreq(&buffkey, pdupreq, dupreq_pool, ! NFS_REQ_OK);
-  return status;
-}
+  return pfuncdesc;
+}                               /* nfs_dupreq_func_desc */
 
 /**
  *
- * clean_entry_dupreq: cleans an entry in the dupreq cache.
+ * nfs_dupreq_release: retires an entry of a client cache.
  *
- * cleans an entry in the dupreq cache.
+ * The partition lock must be held.
  *
- * @param pentry [INOUT] entry to be cleaned.
- * @param addparam [IN] additional parameter used for cleaning.
+ * @param ppart [INOUT] the partition of the client
+ * @param pclient [INOUT] the client the entry belongs to
+ * @param pdupreq [INOUT] the entry to retire
+ * @param nfs_req_status [IN] NFS_REQ_OK if the entry holds a reply to be freed
  *
- * @return 0 if ok, other values mean an error.
+ * @return nothing (void function)
  *
  */
-int clean_entry_dupreq(LRU_entry_t * pentry, void *addparam)
+static void nfs_dupreq_release(dupreq_partition_t * ppart,
+                               dupreq_client_t * pclient,
+                               dupreq_entry_t * pdupreq, int nfs_req_status)
 {
-  hash_buffer_t buffkey;
-  struct prealloc_pool *dupreq_pool = (struct prealloc_pool *) addparam;
-  dupreq_entry_t *pdupreq = (dupreq_entry_t *) (pentry->buffdata.pdata);
-  dupreq_key_t dupkey;
-
-  /* Get the socket address for the key */
-  memcpy((char *)&dupkey.addr, (char *)&pdupreq->addr, sizeof(dupkey.addr));
-  dupkey.xid = pdupreq->xid;
-  dupkey.checksum = pdupreq->checksum;
-
-  /* I have to keep an integer as key, I wil use the pointer buffkey->pdata for this,
-   * this also means that buffkey->len will be 0 */
-  buffkey.pdata = (caddr_t) &dupkey;
-  buffkey.len = sizeof(dupreq_key_t);
+  /* Call the free function */
+  if(nfs_req_status == NFS_REQ_OK)
+    nfs_dupreq_func_desc(pdupreq)->free_function(&(pdupreq->res_nfs));
 
-  LogDupReq("Garbage collection on", &pdupreq->addr, pdupreq->xid, pdupreq->rq_prog);
+  pdupreq->valid = FALSE;
+  pdupreq->processing = 0;
 
-  return _remove_dupreq(&buffkey, pdupreq, dupreq_pool, NFS_REQ_OK);
-}                               /* clean_entry_dupreq */
+  pclient->nb_valid -= 1;
+  ppart->stats.nb_entries -= 1;
+  ppart->stats.ok.nb_del += 1;
+}                               /* nfs_dupreq_release */
 
 /**
  *
- *  dupreq_rbt_hash_func: computes the hash value for the entry in dupreq cache.
- *
- * Computes the hash value for the entry in dupreq cache. In fact, it just use the Xid modulo the hash array size.
- * This function is called internal in the HasTable_* function
- *
- * @param hparam [IN] hash table parameter.
- * @param buffcleff[in] pointer to the hash key buffer
+ * nfs_dupreq_partition: gets the partition a client address belongs to.
  *
- * @return the computed hash value.
+ * @param paddr [IN] the client address, its port is ignored
  *
- * @see HashTable_Init
+ * @return the partition.
  *
  */
-unsigned long dupreq_value_hash_func(hash_parameter_t * p_hparam,
-                                     hash_buffer_t * buffclef)
+static dupreq_partition_t *nfs_dupreq_partition(sockaddr_t * paddr)
 {
-  dupreq_key_t *pdupkey = (dupreq_key_t *)(buffclef->pdata);
-  unsigned long addr_hash = hash_sockaddr((sockaddr_t *) &pdupkey->addr, CHECK_PORT);
-
-  return (((unsigned long)pdupkey->xid + addr_hash)^(pdupkey->checksum)) % p_hparam->index_size;
-}                               /*  dupreq_value_hash_func */
+  return &dupreq_partitions[hash_sockaddr(paddr, IGNORE_PORT) % dupreq_nb_partitions];
+}                               /* nfs_dupreq_partition */
 
 /**
  *
- *  dupreq_rbt_hash_func: computes the rbt value for the entry in dupreq cache.
- *
- * Computes the rbt value for the entry in dupreq cache. In fact, it just use the Xid
- * itself (which is an unsigned integer) as the rbt value.
- * This function is called internal in the HasTable_* function
+ * nfs_dupreq_client: finds the cache of a client in its partition.
  *
- * @param hparam [IN] hash table parameter.
- * @param buffcleff[in] pointer to the hash key buffer
+ * The partition lock must be held.
  *
- * @return the computed rbt value.
+ * @param ppart [INOUT] the partition of the client
+ * @param paddr [IN] the client address, its port is ignored
+ * @param create [IN] TRUE if the cache is to be created when missing
  *
- * @see HashTable_Init
+ * @return the client cache, NULL if not found or not allocated.
  *
  */
-unsigned long dupreq_rbt_hash_func(hash_parameter_t * p_hparam, hash_buffer_t * buffclef)
+static dupreq_client_t *nfs_dupreq_client(dupreq_partition_t * ppart,
+                                          sockaddr_t * paddr, int create)
 {
-  dupreq_key_t *pdupkey = (dupreq_key_t *)(buffclef->pdata);
+  dupreq_client_t *pclient;
+
+  for(pclient = ppart->clients; pclient != NULL; pclient = pclient->next)
+    if(cmp_sockaddr(&pclient->addr, paddr, IGNORE_PORT))
+      return pclient;
+
+  if(!create)
+    return NULL;
+
+  pclient = (dupreq_client_t *) Mem_Alloc_Label(sizeof(dupreq_client_t),
+                                                "dupreq_client_t");
+  if(pclient == NULL)
+    return NULL;
+
+  pclient->entries = (dupreq_entry_t *) Mem_Calloc_Label(dupreq_nb_entries,
+                                                         sizeof(dupreq_entry_t),
+                                                         "dupreq_entry_t");
+  if(pclient->entries == NULL)
+    {
+      Mem_Free(pclient);
+      return NULL;
+    }
+
+  memcpy(&pclient->addr, paddr, sizeof(sockaddr_t));
+  pclient->last_used = time(NULL);
+  pclient->nb_valid = 0;
+  pclient->nb_transports = 0;
+  pclient->nb_entries = dupreq_nb_entries;
+
+  pclient->next = ppart->clients;
+  ppart->clients = pclient;
+  ppart->nb_clients += 1;
 
-  unsigned long addr_hash = hash_sockaddr((sockaddr_t *) &pdupkey->addr, CHECK_PORT);
+  LogDupReq("New client cache for", paddr, 0, 0);
 
-  return (((unsigned long)pdupkey->xid + addr_hash)^(pdupkey->checksum)) % p_hparam->index_size;
-}                               /* dupreq_rbt_hash_func */
+  return pclient;
+}                               /* nfs_dupreq_client */
 
 /**
  *
- * compare_req: compares the xid, ip, and port stored in the key buffers.
- * may also compare the checksum if the relevant option was enabled during
- * compile.
+ * nfs_dupreq_transport: sizes the cache of a client for the transport of a request.
  *
- * compare the xid, ip, and port stored in the key buffers. This function is
- * to be used as 'compare_key' field in
- * the hashtable storing the nfs duplicated requests.
+ * Each transport of a client (a TCP connection or an UDP socket, told apart by
+ * their port) has its own xid sequence. Their xids share the slots of the
+ * cache, which is doubled when a new transport would make it hold fewer than
+ * nb_entries_per_client slots per transport. Doubling keeps every cached entry
+ * in a slot of its own: slot i moves to slot i or i + the former size.
+ * Up to DUPREQ_MAX_TRANSPORTS transports are accounted for.
  *
- * @param buff1 [IN] first key
- * @param buff2 [IN] second key
+ * The partition lock must be held.
  *
- * @return 0 if keys are identifical, 1 if they are different.
+ * @param pclient [INOUT] the client cache
+ * @param paddr [IN] the address the request came from
+ *
+ * @return nothing (void function). The cache keeps its size if it can't grow.
  *
  */
-int compare_req(hash_buffer_t * buff1, hash_buffer_t * buff2)
+static void nfs_dupreq_transport(dupreq_client_t * pclient, sockaddr_t * paddr)
 {
-  dupreq_key_t *key1 = (dupreq_key_t *)(buff1->pdata);
-  dupreq_key_t *key2 = (dupreq_key_t *)(buff2->pdata);
-
-  if (key1->xid != key2->xid)
-    return 1;
-  if (cmp_sockaddr(&key1->addr, &key2->addr, CHECK_PORT) == 0)
-    return 1;
-  if (key1->checksum != key2->checksum)
-    return 1;
-  return 0;
-}                               /* compare_xid */
+  dupreq_entry_t *entries;
+  int port = get_port(paddr);
+  unsigned int i;
+
+  for(i = 0; i < pclient->nb_transports; i++)
+    if(pclient->ports[i] == port)
+      return;
+
+  if(pclient->nb_transports == DUPREQ_MAX_TRANSPORTS)
+    return;
+
+  pclient->ports[pclient->nb_transports] = port;
+  pclient->nb_transports += 1;
+
+  if(pclient->nb_transports * dupreq_nb_entries <= pclient->nb_entries)
+    return;
+
+  entries = (dupreq_entry_t *) Mem_Calloc_Label(2 * pclient->nb_entries,
+                                                sizeof(dupreq_entry_t),
+                                                "dupreq_entry_t");
+  if(entries == NULL)
+    {
+      LogDupReq("Cannot grow the cache of", paddr, 0, 0);
+      return;
+    }
+
+  for(i = 0; i < pclient->nb_entries; i++)
+    if(pclient->entries[i].valid)
+      entries[pclient->entries[i].xid & (2 * pclient->nb_entries - 1)] =
+          pclient->entries[i];
+
+  Mem_Free(pclient->entries);
+  pclient->entries = entries;
+  pclient->nb_entries *= 2;
+
+  LogDupReq("Cache grown for a new transport of", paddr, 0, 0);
+}                               /* nfs_dupreq_transport */
 
 /**
  *
- * display_req_key: displays the key stored in the buffer.
+ * nfs_dupreq_lookup: finds a cached request.
  *
- * displays the key stored in the buffer. This function is to be used as 'key_to_str' field in
- * the hashtable storing the nfs duplicated requests.
+ * The partition lock must be held.
  *
- * @param buff1 [IN]  buffer to display
- * @param buff2 [OUT] output string
+ * @param ppart [INOUT] the partition of the client
+ * @param paddr [IN] the client address
+ * @param xid [IN] the transfer id of the request
+ * @param ppclient [OUT] the client the entry belongs to
  *
- * @return number of character written.
+ * @return the entry, NULL if the request is not cached.
  *
  */
-int display_req_key(hash_buffer_t * pbuff, char *str)
+static dupreq_entry_t *nfs_dupreq_lookup(dupreq_partition_t * ppart,
+                                         sockaddr_t * paddr, long xid,
+                                         dupreq_client_t ** ppclient)
 {
-  dupreq_key_t *pdupkey = (dupreq_key_t *)(pbuff->pdata);
-  char namebuf[SOCK_NAME_MAX];
+  dupreq_client_t *pclient;
+  dupreq_entry_t *pdupreq;
 
-  sprint_sockaddr(&pdupkey->addr, namebuf, sizeof(namebuf));
+  if((pclient = nfs_dupreq_client(ppart, paddr, FALSE)) == NULL)
+    return NULL;
 
-  return sprintf("addr=%s xid=%ld checksum=%d",
-                 namebuf, pdupkey->xid, pdupkey->checksum);
+  pdupreq = &pclient->entries[xid & (pclient->nb_entries - 1)];
 
-}
+  if(!pdupreq->valid || pdupreq->xid != xid || pdupreq->checksum != 0 ||
+     !cmp_sockaddr(&pdupreq->addr, paddr, IGNORE_PORT))
+    return NULL;
+
+  *ppclient = pclient;
+  return pdupreq;
+}                               /* nfs_dupreq_lookup */
 
 /**
  *
- * display_req_val: displays the value stored in the buffer.
+ * nfs_dupreq_delete: removes a request that will not be answered.
  *
- * displays the value stored in the buffer. This function is to be used as 'val_to_str' field in
- * the hashtable storing the nfs duplicated requests.
+ * @param xid [IN] the transfer id of the request
+ * @param ptr_req [IN] the request
+ * @param xprt [IN] the transport the request came from
  *
- * @param buff1 [IN]  buffer to display
- * @param buff2 [OUT] output string
- *
- * @return number of character written.
+ * @return DUPREQ_SUCCESS if successfull, DUPREQ_NOT_FOUND if the request is not cached.
  *
  */
-int display_req_val(hash_buffer_t * pbuff, char *str)
+int nfs_dupreq_delete(long xid, struct svc_req *ptr_req, SVCXPRT *xprt)
 {
-  dupreq_entry_t *pdupreq = (dupreq_entry_t *)(pbuff->pdata);
-  char namebuf[SOCK_NAME_MAX];
+  dupreq_partition_t *ppart;
+  dupreq_client_t *pclient = NULL;
+  dupreq_entry_t *pdupreq;
+  sockaddr_t addr;
+
+  /* Get the socket address for the key */
+  if(copy_xprt_addr(&addr, xprt) == 0)
+    return DUPREQ_NOT_FOUND;
 
-  sprint_sockaddr(&pdupreq->addr, namebuf, sizeof(namebuf));
+  ppart = nfs_dupreq_partition(&addr);
 
-  return sprintf("addr=%s xid=%ld checksum=%d rq_prog=%lu rq_vers=%lu rq_proc=%lu",
-                 namebuf, pdupreq->xid, pdupreq->checksum,
-                 pdupreq->rq_prog, pdupreq->rq_vers, pdupreq->rq_proc);
-}
+  P(ppart->lock);
+
+  if((pdupreq = nfs_dupreq_lookup(ppart, &addr, xid, &pclient)) == NULL)
+    {
+      ppart->stats.notfound.nb_del += 1;
+      V(ppart->lock);
+      return DUPREQ_NOT_FOUND;
+    }
+
+  LogDupReq("REMOVING", &pdupreq->addr, pdupreq->xid, pdupreq->rq_prog);
+
+  /* The reply was not built, there is nothing to free */
+  nfs_dupreq_release(ppart, pclient, pdupreq, !NFS_REQ_OK);
+
+  V(ppart->lock);
+
+  return DUPREQ_SUCCESS;
+}                               /* nfs_dupreq_delete */
 
 /**
  *
- * nfs_Init_dupreq: Init the hashtable and LRU for duplicate request cache
+ * nfs_Init_dupreq: Init the partitions of the duplicate request cache
  *
- * Perform all the required initialization for hashtable and LRU for duplicate request cache
+ * Perform all the required initialization for the duplicate request cache.
+ * The client caches themselves are allocated on their first request.
  *
  * @param param [IN] parameter used to init the duplicate request cache
  *
@@ -492,13 +499,29 @@ int display_req_val(hash_buffer_t * pbuff, char *str)
  */
 int nfs_Init_dupreq(nfs_rpc_dupreq_parameter_t param)
 {
-  if((ht_dupreq = HashTable_Init(param.hash_param)) == NULL)
+  unsigned int i;
+
+  dupreq_nb_partitions = param.hash_param.index_size;
+  dupreq_nb_entries = param.nb_entries_per_client;
+
+  if((dupreq_partitions =
+      (dupreq_partition_t *) Mem_Calloc_Label(dupreq_nb_partitions,
+                                              sizeof(dupreq_partition_t),
+                                              "dupreq_partition_t")) == NULL)
     {
       LogCrit(COMPONENT_DUPREQ,
-              "Cannot init the duplicate request hash table");
+              "Cannot init the duplicate request cache partitions");
       return -1;
     }
 
+  for(i = 0; i < dupreq_nb_partitions; i++)
+    if(pthread_mutex_init(&dupreq_partitions[i].lock, NULL) != 0)
+      {
+        LogCrit(COMPONENT_DUPREQ,
+                "Cannot init the lock of duplicate request cache partition %u", i);
+        return -1;
+      }
+
   return DUPREQ_SUCCESS;
 }                               /* nfs_Init_dupreq */
 
@@ -506,12 +529,21 @@ int nfs_Init_dupreq(nfs_rpc_dupreq_parameter_t param)
  *
  * nfs_dupreq_add_not_finished: adds an entry in the duplicate requests cache.
  *
- * Adds an entry in the duplicate requests cache.
+ * Adds an entry in the cache of the client. The slot of the request is
+ * chosen by its xid, a finished request found there is retired: the client
+ * moved about nb_entries_per_client xids past it on one of its transports. A request that is found already
+ * finished is marked as being processed again while its reply is resent, the
+ * caller then has to call nfs_dupreq_finish.
  *
  * @param xid [IN] the transfer id to be used as key
- * @param pnfsreq [IN] the request pointer to cache
+ * @param ptr_req [IN] the request to cache
+ * @param xprt [IN] the transport the request came from
+ * @param res_nfs [OUT] the cached reply if DUPREQ_ALREADY_EXISTS is returned
  *
  * @return DUPREQ_SUCCESS if successfull\n.
+ * @return DUPREQ_ALREADY_EXISTS if the request was already answered.
+ * @return DUPREQ_BEING_PROCESSED if the request is being processed by another thread.
+ * @return DUPREQ_NOT_CACHED if the slot is held by a request being processed.
  * @return DUPREQ_INSERT_MALLOC_ERROR if an error occured during the insertion process.
  *
  */
@@ -519,158 +551,140 @@ int nfs_Init_dupreq(nfs_rpc_dupreq_parameter_t param)
 int nfs_dupreq_add_not_finished(long xid,
                                 struct svc_req *ptr_req,
                                 SVCXPRT *xprt,
-                                struct prealloc_pool *dupreq_pool,
                                 nfs_res_t *res_nfs)
 {
-  hash_buffer_t buffkey;
-  hash_buffer_t buffval;
-  hash_buffer_t buffdata;
-  dupreq_entry_t *pdupreq = NULL;
-  int status = 0;
-  dupreq_key_t *pdupkey = NULL;
-  
-  /* Entry to be cached */
-  GetFromPool(pdupreq, dupreq_pool, dupreq_entry_t);
-  if(pdupreq == NULL)
+  dupreq_partition_t *ppart;
+  dupreq_client_t *pclient;
+  dupreq_entry_t *pdupreq;
+  sockaddr_t addr;
+  time_t now = time(NULL);
+  int status;
+
+  /* Get the socket address for the key and the request */
+  if(copy_xprt_addr(&addr, xprt) == 0)
     return DUPREQ_INSERT_MALLOC_ERROR;
 
-  memset(pdupreq, 0, sizeof(*pdupreq));
-  if(pthread_mutex_init(&pdupreq->dupreq_mutex, NULL) == -1)
-    {
-      ReleaseToPool(pdupreq, dupreq_pool);
-      return DUPREQ_INSERT_MALLOC_ERROR;
-    }
+  ppart = nfs_dupreq_partition(&addr);
 
-  if((pdupkey = (dupreq_key_t *) Mem_Alloc(sizeof(dupreq_key_t))) == NULL)
+  P(ppart->lock);
+
+  if((pclient = nfs_dupreq_client(ppart, &addr, TRUE)) == NULL)
     {
-      ReleaseToPool(pdupreq, dupreq_pool);
+      ppart->stats.err.nb_set += 1;
+      V(ppart->lock);
       return DUPREQ_INSERT_MALLOC_ERROR;
     }
 
-  /* Get the socket address for the key and the request */
-  if(copy_xprt_addr(&pdupkey->addr, xprt) == 0 ||
-     copy_xprt_addr(&pdupreq->addr, xprt) == 0)
+  pclient->last_used = now;
+  nfs_dupreq_transport(pclient, &addr);
+  pdupreq = &pclient->entries[xid & (pclient->nb_entries - 1)];
+
+  if(pdupreq->valid)
     {
-      Mem_Free(pdupkey);
-      ReleaseToPool(pdupreq, dupreq_pool);
-      return DUPREQ_INSERT_MALLOC_ERROR;
-    }
+      if(pdupreq->xid == xid && pdupreq->checksum == 0 &&
+         cmp_sockaddr(&pdupreq->addr, &addr, IGNORE_PORT))
+        {
+          ppart->stats.ok.nb_test += 1;
 
-  pdupkey->xid = xid;
-  pdupreq->xid = xid;
+          if(pdupreq->processing == 1)
+            status = DUPREQ_BEING_PROCESSED;
+          else
+            {
+              *res_nfs = pdupreq->res_nfs;
+              pdupreq->processing = 1;
+              pdupreq->timestamp = now;
+              status = DUPREQ_ALREADY_EXISTS;
+            }
 
-  /* Checksum the request */
-  pdupkey->checksum = 0;
-  pdupreq->checksum = 0;
+          V(ppart->lock);
+          return status;
+        }
+
+      if(pdupreq->processing == 1)
+        {
+          /* Far more requests in flight than the cache can hold */
+          ppart->stats.err.nb_set += 1;
+          V(ppart->lock);
+          LogDupReq("Slot busy, not caching", &addr, xid, ptr_req->rq_prog);
+          return DUPREQ_NOT_CACHED;
+        }
 
-  /* I have to keep an integer as key, I wil use the pointer buffkey->pdata for this,
-   * this also means that buffkey->len will be 0 */
-  buffkey.pdata = (caddr_t) pdupkey;
-  buffkey.len = sizeof(dupreq_key_t);
+      LogDupReq("Out of the xid window", &pdupreq->addr, pdupreq->xid,
+                pdupreq->rq_prog);
+      nfs_dupreq_release(ppart, pclient, pdupreq, NFS_REQ_OK);
+    }
 
-  /* I build the data with the request pointer that should be in state 'IN USE' */
+  memcpy(&pdupreq->addr, &addr, sizeof(sockaddr_t));
+  pdupreq->xid = xid;
+  pdupreq->checksum = 0;
   pdupreq->rq_prog = ptr_req->rq_prog;
   pdupreq->rq_vers = ptr_req->rq_vers;
   pdupreq->rq_proc = ptr_req->rq_proc;
-  pdupreq->timestamp = time(NULL);
+  pdupreq->timestamp = now;
   pdupreq->processing = 1;
-  buffdata.pdata = (caddr_t) pdupreq;
-  buffdata.len = sizeof(dupreq_entry_t);
+  pdupreq->valid = TRUE;
 
-  LogDupReq("Add Not Finished", &pdupreq->addr, pdupreq->xid, pdupreq->rq_prog);
+  pclient->nb_valid += 1;
+  ppart->stats.nb_entries += 1;
+  ppart->stats.ok.nb_set += 1;
 
-  status = HashTable_Test_And_Set(ht_dupreq, &buffkey, &buffdata,
-                                  HASHTABLE_SET_HOW_SET_NO_OVERWRITE);
+  V(ppart->lock);
 
-  if (status == HASHTABLE_ERROR_KEY_ALREADY_EXISTS)
-    {
-      if(HashTable_Get(ht_dupreq, &buffkey, &buffval) == HASHTABLE_SUCCESS)
-        {
-          P(((dupreq_entry_t *)buffval.pdata)->dupreq_mutex);
-          if ( ((dupreq_entry_t *)buffval.pdata)->processing == 1)
-            {
-              status = DUPREQ_BEING_PROCESSED;
-            }
-          else
-            {
-              *res_nfs = ((dupreq_entry_t *) buffval.pdata)->res_nfs;
-              status = DUPREQ_ALREADY_EXISTS;
-            }
-          V(((dupreq_entry_t *)buffval.pdata)->dupreq_mutex);
-        }
-      else
-        status = DUPREQ_NOT_FOUND;
-    }
-  else if (status == HASHTABLE_INSERT_MALLOC_ERROR)
-      status = DUPREQ_INSERT_MALLOC_ERROR;
-  else
-    status = DUPREQ_SUCCESS;
-  if (status != DUPREQ_SUCCESS)
-    ReleaseToPool(pdupreq, dupreq_pool);
-  return status;
+  LogDupReq("Add Not Finished", &addr, xid, ptr_req->rq_prog);
+
+  return DUPREQ_SUCCESS;
 }                               /* nfs_dupreq_add_not_finished */
 
 /**
  *
  * nfs_dupreq_finish: Changes the being_processed flag in a dupreq to 0 and
- * adds the reply info to the buffval.
+ * adds the reply info to the entry.
  *
  * Changes the being_processed flag in a dupreq to 0 and adds the reply info
- * to the buffval. Used after the duplicate request has already been added to
+ * to the entry. Used after the duplicate request has already been added to
  * the dupreq cache but has not been fully processed yet.
  *
  * @param xid [IN] the transfer id to be used as key
- * @param pnfsreq [IN] the request pointer to cache
+ * @param ptr_req [IN] the request
+ * @param xprt [IN] the transport the request came from
+ * @param p_res_nfs [IN] the reply to cache
  *
  * @return DUPREQ_SUCCESS if successfull\n.
- * @return DUPREQ_INSERT_MALLOC_ERROR if an error occured during the insertion process.
+ * @return DUPREQ_NOT_FOUND if the request is not cached.
  *
  */
 
 int nfs_dupreq_finish(long xid,
                       struct svc_req *ptr_req,
                       SVCXPRT *xprt,
-                      nfs_res_t * p_res_nfs,
-                      LRU_list_t * lru_dupreq)
+                      nfs_res_t * p_res_nfs)
 {
-  hash_buffer_t buffkey;
-  hash_buffer_t buffval;
-  LRU_entry_t *pentry = NULL;
-  LRU_status_t lru_status;
-  dupreq_key_t dupkey;
+  dupreq_partition_t *ppart;
+  dupreq_client_t *pclient = NULL;
   dupreq_entry_t *pdupreq;
+  sockaddr_t addr;
 
   /* Get the socket address for the key */
-  if(copy_xprt_addr(&dupkey.addr, xprt) == 0)
+  if(copy_xprt_addr(&addr, xprt) == 0)
     return DUPREQ_NOT_FOUND;
 
-  dupkey.xid = xid;
-  dupkey.checksum = 0;
+  ppart = nfs_dupreq_partition(&addr);
 
-  /* I have to keep an integer as key, I wil use the pointer buffkey->pdata for this,
-   * this also means that buffkey->len will be 0 */
-  buffkey.pdata = (caddr_t) &dupkey;
-  buffkey.len = sizeof(dupreq_key_t);
-  if(HashTable_Get(ht_dupreq, &buffkey, &buffval) != HASHTABLE_SUCCESS)
-    return DUPREQ_NOT_FOUND;
+  P(ppart->lock);
 
-  pdupreq = (dupreq_entry_t *)buffval.pdata;
+  if((pdupreq = nfs_dupreq_lookup(ppart, &addr, xid, &pclient)) == NULL)
+    {
+      V(ppart->lock);
+      return DUPREQ_NOT_FOUND;
+    }
 
   LogDupReq("Finish", &pdupreq->addr, pdupreq->xid, pdupreq->rq_prog);
 
-  P(pdupreq->dupreq_mutex);
-
   pdupreq->res_nfs = *p_res_nfs;
   pdupreq->timestamp = time(NULL);
   pdupreq->processing = 0;
 
-  V(pdupreq->dupreq_mutex);
-
-  /* Add it to lru list */
-  if((pentry = LRU_new_entry(lru_dupreq, &lru_status)) == NULL)
-    return DUPREQ_INSERT_MALLOC_ERROR;
-  pentry->buffdata.pdata = buffval.pdata;
-  pentry->buffdata.len = buffval.len;
+  V(ppart->lock);
 
   return DUPREQ_SUCCESS;
 }                               /* nfs_dupreq_finish */
@@ -689,32 +703,30 @@ int nfs_dupreq_finish(long xid,
  */
 nfs_res_t nfs_dupreq_get(long xid, struct svc_req *ptr_req, SVCXPRT *xprt, int *pstatus)
 {
-  hash_buffer_t buffkey;
-  hash_buffer_t buffval;
+  dupreq_partition_t *ppart;
+  dupreq_client_t *pclient = NULL;
+  dupreq_entry_t *pdupreq;
+  sockaddr_t addr;
   nfs_res_t res_nfs;
-  dupreq_key_t dupkey;
 
   memset(&res_nfs, 0, sizeof(res_nfs));
 
   /* Get the socket address for the key */
-  if(copy_xprt_addr(&dupkey.addr, xprt) == 0)
+  if(copy_xprt_addr(&addr, xprt) == 0)
     {
       *pstatus = DUPREQ_NOT_FOUND;
       return res_nfs;
     }
 
-  dupkey.xid = xid;
-  dupkey.checksum = 0;
+  ppart = nfs_dupreq_partition(&addr);
+
+  P(ppart->lock);
 
-  /* I have to keep an integer as key, I wil use the pointer buffkey->pdata for this,
-   * this also means that buffkey->len will be 0 */
-  buffkey.pdata = (caddr_t) &dupkey;
-  buffkey.len = sizeof(dupreq_key_t);
-  if(HashTable_Get(ht_dupreq, &buffkey, &buffval) == HASHTABLE_SUCCESS)
+  if((pdupreq = nfs_dupreq_lookup(ppart, &addr, xid, &pclient)) != NULL)
     {
-      dupreq_entry_t *pdupreq = (dupreq_entry_t *)buffval.pdata;
       /* reset timestamp */
       pdupreq->timestamp = time(NULL);
+      ppart->stats.ok.nb_get += 1;
 
       *pstatus = DUPREQ_SUCCESS;
       res_nfs = pdupreq->res_nfs;
@@ -722,53 +734,124 @@ nfs_res_t nfs_dupreq_get(long xid, struct svc_req *ptr_req, SVCXPRT *xprt, int *
     }
   else
     {
-      LogDupReq("Failed to get dupreq entry", &dupkey.addr, dupkey.xid, ptr_req->rq_prog);
+      ppart->stats.notfound.nb_get += 1;
+      LogDupReq("Failed to get dupreq entry", &addr, xid, ptr_req->rq_prog);
       *pstatus = DUPREQ_NOT_FOUND;
     }
+
+  V(ppart->lock);
+
   return res_nfs;
 }                               /* nfs_dupreq_get */
 
 /**
  *
- * nfs_dupreq_gc_function: Tests is an entry in dupreq cache is to be set invalid (has expired).
- *
- * Tests is an entry in dupreq cache is to be set invalid (has expired).
+ * nfs_dupreq_gc: retires the expired entries and the idle clients.
  *
- * @param pentry [IN] pointer to the entry to test
+ * Retires the finished entries older than expiration_dupreq, and frees the
+ * caches of the clients that sent nothing for as long. The workers call it
+ * every nb_before_gc requests, it runs at most once a second and locks one
+ * partition at a time.
  *
- * @return 1 if entry must be set invalid, 0 if not.
- *
- * @see LRU_invalidate_by_function
- * @see LRU_gc_invalid
+ * @return nothing (void function)
  *
  */
-int nfs_dupreq_gc_function(LRU_entry_t * pentry, void *addparam)
+void nfs_dupreq_gc(void)
 {
-  dupreq_entry_t *pdupreq = NULL;
+  dupreq_partition_t *ppart;
+  dupreq_client_t *pclient;
+  dupreq_client_t **ppnext;
+  time_t now = time(NULL);
+  unsigned int i, j;
+
+  if(now == dupreq_last_gc)
+    return;
+  dupreq_last_gc = now;
+
+  for(i = 0; i < dupreq_nb_partitions; i++)
+    {
+      ppart = &dupreq_partitions[i];
 
-  pdupreq = (dupreq_entry_t *) (pentry->buffdata.pdata);
+      P(ppart->lock);
 
-  /* Test if entry is expired */
-  if(time(NULL) - pdupreq->timestamp > nfs_param.core_param.expiration_dupreq)
-    return LRU_LIST_SET_INVALID;
+      ppnext = &ppart->clients;
+      while((pclient = *ppnext) != NULL)
+        {
+          for(j = 0; j < pclient->nb_entries && pclient->nb_valid != 0; j++)
+            if(pclient->entries[j].valid && pclient->entries[j].processing == 0 &&
+               now - pclient->entries[j].timestamp > nfs_param.core_param.expiration_dupreq)
+              {
+                LogDupReq("Garbage collection on", &pclient->entries[j].addr,
+                          pclient->entries[j].xid, pclient->entries[j].rq_prog);
+                nfs_dupreq_release(ppart, pclient, &pclient->entries[j], NFS_REQ_OK);
+              }
+
+          if(pclient->nb_valid == 0 &&
+             now - pclient->last_used > nfs_param.core_param.expiration_dupreq)
+            {
+              *ppnext = pclient->next;
+              ppart->nb_clients -= 1;
+              Mem_Free(pclient->entries);
+              Mem_Free(pclient);
+            }
+          else
+            ppnext = &pclient->next;
+        }
 
-  return LRU_LIST_DO_NOT_SET_INVALID;
-}                               /* nfs_dupreq_fc_function */
+      V(ppart->lock);
+    }
+}                               /* nfs_dupreq_gc */
 
 /**
  *
- * nfs_dupreq_get_stats: gets the hash table statistics for the duplicate requests.
+ * nfs_dupreq_get_stats: gets the statistics for the duplicate requests.
  *
- * Gets the hash table statistics for the duplicate requests.
+ * Gets the statistics for the duplicate requests, in the layout of the hash
+ * tables ones. The computed part gives the number of clients per partition.
  *
  * @param phstat [OUT] pointer to the resulting stats.
  *
  * @return nothing (void function)
  *
- * @see HashTable_GetStats
- *
  */
 void nfs_dupreq_get_stats(hash_stat_t * phstat)
 {
-  HashTable_GetStats(ht_dupreq, phstat);
+  dupreq_partition_t *ppart;
+  unsigned int i;
+  unsigned int total = 0;
+
+  memset(phstat, 0, sizeof(hash_stat_t));
+  phstat->computed.min_rbt_num_node = ~0U;
+
+  for(i = 0; i < dupreq_nb_partitions; i++)
+    {
+      ppart = &dupreq_partitions[i];
+
+      P(ppart->lock);
+
+      phstat->dynamic.nb_entries += ppart->stats.nb_entries;
+
+      phstat->dynamic.ok.nb_set += ppart->stats.ok.nb_set;
+      phstat->dynamic.ok.nb_test += ppart->stats.ok.nb_test;
+      phstat->dynamic.ok.nb_get += ppart->stats.ok.nb_get;
+      phstat->dynamic.ok.nb_del += ppart->stats.ok.nb_del;
+
+      phstat->dynamic.err.nb_set += ppart->stats.err.nb_set;
+
+      phstat->dynamic.notfound.nb_get += ppart->stats.notfound.nb_get;
+      phstat->dynamic.notfound.nb_del += ppart->stats.notfound.nb_del;
+
+      if(ppart->nb_clients < phstat->computed.min_rbt_num_node)
+        phstat->computed.min_rbt_num_node = ppart->nb_clients;
+      if(ppart->nb_clients > phstat->computed.max_rbt_num_node)
+        phstat->computed.max_rbt_num_node = ppart->nb_clients;
+      total += ppart->nb_clients;
+
+      V(ppart->lock);
+    }
+
+  if(dupreq_nb_partitions != 0)
+    phstat->computed.average_rbt_num_node = total / dupreq_nb_partitions;
+  else
+    phstat->computed.min_rbt_num_node = 0;
 }                               /* nfs_dupreq_get_stats */
@@ -53,6 +53,9 @@
 #include <pthread.h>
 #include <fcntl.h>
 #include <sys/file.h>           /* for having FNDELAY */
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 #include <pwd.h>
 #include <grp.h>
 
@@ -75,6 +78,9 @@ pthread_mutex_t *mutex_cond_xprt;
 pthread_cond_t *condvar_xprt;
 SVCXPRT **Xports;
 fd_set Svc_fdset;
+#ifdef HAVE_SYS_EPOLL_H
+int Svc_epollfd = -1;
+#endif
 
 const char *str_sock_type(int st)
 {
@@ -488,8 +494,76 @@ void InitRPC(int num_sock)
 
   FD_ZERO(&Svc_fdset);
 
+#ifdef HAVE_SYS_EPOLL_H
+  /* The size is only a hint for the kernel */
+  if((Svc_epollfd = epoll_create(num_sock)) == -1)
+    LogFatal(COMPONENT_RPC,
+             "epoll_create failed, errno=%d (%s)", errno, strerror(errno));
+#endif
+
 #ifdef _USE_TIRPC
   /* RW_lock need to be initialized */
   rw_lock_init(&Svc_fd_lock);
 #endif
 }
+
+/**
+ *
+ * Svc_epoll_add: adds a socket to the dispatcher's event set.
+ *
+ * The socket is watched in edge-triggered mode, so the dispatcher has to drain
+ * it before going back to epoll_wait. Without epoll this is a no-op, Svc_fdset
+ * is the only event set.
+ *
+ * @param sock [IN] the socket to be watched.
+ *
+ * @return TRUE if ok, FALSE otherwise.
+ *
+ */
+int Svc_epoll_add(int sock)
+{
+#ifdef HAVE_SYS_EPOLL_H
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.fd = sock;
+
+  if(epoll_ctl(Svc_epollfd, EPOLL_CTL_ADD, sock, &ev) == -1)
+    {
+      /* A transport re-registered on the same socket is not an error */
+      if(errno == EEXIST)
+        return TRUE;
+
+      LogCrit(COMPONENT_RPC,
+              "Cannot add socket %d to the epoll set, errno=%d (%s)",
+              sock, errno, strerror(errno));
+      return FALSE;
+    }
+#endif
+  return TRUE;
+}                               /* Svc_epoll_add */
+
+/**
+ *
+ * Svc_epoll_del: removes a socket from the dispatcher's event set.
+ *
+ * @param sock [IN] the socket that should no longer be watched.
+ *
+ * @return nothing (void function).
+ *
+ */
+void Svc_epoll_del(int sock)
+{
+#ifdef HAVE_SYS_EPOLL_H
+  struct epoll_event ev;
+
+  /* Kernels before 2.6.9 require a non NULL event even for EPOLL_CTL_DEL */
+  memset(&ev, 0, sizeof(ev));
+  if(epoll_ctl(Svc_epollfd, EPOLL_CTL_DEL, sock, &ev) == -1 && errno != ENOENT
+     && errno != EBADF)
+    LogDebug(COMPONENT_RPC,
+             "Cannot remove socket %d from the epoll set, errno=%d (%s)",
+             sock, errno, strerror(errno));
+#endif
+}                               /* Svc_epoll_del */
@@ -0,0 +1,309 @@
+/*****
+ * Connection scaling benchmark for the RPC dispatcher.
+ *
+ * Opens a large number of idle TCP connections to a running server, then
+ * drives NULL calls over a set of active connections from a single epoll loop
+ * and reports the call rate and the mean latency.
+ *
+ * usage: test_conn_scaling [-h host] [-p port] [-P prog] [-V vers]
+ *                          [-i nb_idle] [-a nb_active] [-t seconds]
+ *
+ * Defaults are 10000 idle and 1000 active connections to the NFSv3 service
+ * of 127.0.0.1:2049 during 10 seconds.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define NULL_CALL_LEN 40        /* 10 XDR words, AUTH_NONE credential and verifier */
+#define REPLY_BUF_LEN 512
+#define MAX_EVENTS    512
+
+typedef struct bench_conn__
+{
+  int fd;
+  unsigned int xid;
+  unsigned int got;
+  unsigned char buf[REPLY_BUF_LEN];
+  struct timeval sent;
+} bench_conn_t;
+
+static unsigned long long nb_calls = 0;
+static unsigned long long total_latency = 0;   /* microseconds */
+static unsigned long long max_latency = 0;
+static unsigned long long nb_errors = 0;
+
+static int open_conn(struct sockaddr_in *addr)
+{
+  int fd;
+  int one = 1;
+
+  if((fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) == -1)
+    return -1;
+
+  if(connect(fd, (struct sockaddr *)addr, sizeof(*addr)) == -1)
+    {
+      close(fd);
+      return -1;
+    }
+
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return fd;
+}
+
+static int send_null_call(bench_conn_t *conn, unsigned int prog, unsigned int vers)
+{
+  unsigned int call[1 + NULL_CALL_LEN / 4];
+
+  conn->xid += 1;
+  call[0] = htonl(0x80000000 | NULL_CALL_LEN);  /* last fragment */
+  call[1] = htonl(conn->xid);
+  call[2] = htonl(0);           /* CALL */
+  call[3] = htonl(2);           /* RPC version */
+  call[4] = htonl(prog);
+  call[5] = htonl(vers);
+  call[6] = htonl(0);           /* NULL procedure */
+  call[7] = htonl(0);           /* AUTH_NONE */
+  call[8] = htonl(0);
+  call[9] = htonl(0);           /* AUTH_NONE verifier */
+  call[10] = htonl(0);
+
+  conn->got = 0;
+  gettimeofday(&conn->sent, NULL);
+
+  if(write(conn->fd, call, sizeof(call)) != sizeof(call))
+    return -1;
+
+  return 0;
+}
+
+/* Returns 1 when a full reply was received, 0 if more data is needed, -1 on error */
+static int recv_reply(bench_conn_t *conn)
+{
+  ssize_t len;
+  unsigned int mark;
+  unsigned int reclen;
+  struct timeval now;
+  unsigned long long latency;
+
+  for(;;)
+    {
+      len = read(conn->fd, conn->buf + conn->got, REPLY_BUF_LEN - conn->got);
+      if(len < 0)
+        return (errno == EAGAIN) ? 0 : -1;
+      if(len == 0)
+        return -1;
+      conn->got += len;
+
+      if(conn->got < 8)
+        continue;
+
+      memcpy(&mark, conn->buf, sizeof(mark));
+      reclen = ntohl(mark) & 0x7fffffff;
+      if(reclen + 4 > REPLY_BUF_LEN)
+        return -1;
+      if(conn->got < reclen + 4)
+        continue;
+
+      memcpy(&mark, conn->buf + 4, sizeof(mark));
+      if(ntohl(mark) != conn->xid)
+        return -1;
+
+      gettimeofday(&now, NULL);
+      latency = (now.tv_sec - conn->sent.tv_sec) * 1000000ULL
+          + now.tv_usec - conn->sent.tv_usec;
+      total_latency += latency;
+      if(latency > max_latency)
+        max_latency = latency;
+      nb_calls += 1;
+      return 1;
+    }
+}
+
+#ifndef HAVE_SYS_EPOLL_H
+int main(int argc, char *argv[])
+{
+  fprintf(stderr, "%s needs epoll\n", argv[0]);
+  return 1;
+}
+#else
+int main(int argc, char *argv[])
+{
+  struct sockaddr_in addr;
+  struct rlimit rl;
+  struct epoll_event ev;
+  struct epoll_event events[MAX_EVENTS];
+  struct timeval start, now;
+  bench_conn_t *active;
+  int *idle;
+  char *host = "127.0.0.1";
+  unsigned short port = 2049;
+  unsigned int prog = 100003;
+  unsigned int vers = 3;
+  int nb_idle = 10000;
+  int nb_active = 1000;
+  int duration = 10;
+  int nb_idle_ok = 0;
+  int nb_active_ok = 0;
+  int epfd;
+  int opt;
+  int i, n;
+  double elapsed;
+
+  while((opt = getopt(argc, argv, "h:p:P:V:i:a:t:")) != EOF)
+    {
+      switch (opt)
+        {
+        case 'h':
+          host = optarg;
+          break;
+        case 'p':
+          port = (unsigned short)atoi(optarg);
+          break;
+        case 'P':
+          prog = (unsigned int)atoi(optarg);
+          break;
+        case 'V':
+          vers = (unsigned int)atoi(optarg);
+          break;
+        case 'i':
+          nb_idle = atoi(optarg);
+          break;
+        case 'a':
+          nb_active = atoi(optarg);
+          break;
+        case 't':
+          duration = atoi(optarg);
+          break;
+        default:
+          fprintf(stderr,
+                  "usage: %s [-h host] [-p port] [-P prog] [-V vers] [-i nb_idle] [-a nb_active] [-t seconds]\n",
+                  argv[0]);
+          exit(1);
+        }
+    }
+
+  /* We need one descriptor per connection, plus some slack */
+  rl.rlim_cur = rl.rlim_max = nb_idle + nb_active + 64;
+  if(setrlimit(RLIMIT_NOFILE, &rl) == -1)
+    fprintf(stderr, "Warning: could not raise RLIMIT_NOFILE to %lu (%s)\n",
+            (unsigned long)rl.rlim_cur, strerror(errno));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if(inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+    {
+      fprintf(stderr, "Bad address %s\n", host);
+      exit(1);
+    }
+
+  idle = (int *)malloc(nb_idle * sizeof(int));
+  active = (bench_conn_t *)calloc(nb_active, sizeof(bench_conn_t));
+  if(idle == NULL || active == NULL)
+    {
+      fprintf(stderr, "Allocation failed\n");
+      exit(1);
+    }
+
+  /* Idle connections: connected, never used */
+  gettimeofday(&start, NULL);
+  for(i = 0; i < nb_idle; i++)
+    if((idle[nb_idle_ok] = open_conn(&addr)) != -1)
+      nb_idle_ok += 1;
+  gettimeofday(&now, NULL);
+  elapsed = (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1000000.0;
+  printf("idle connections:   %d/%d established in %.3f s\n", nb_idle_ok, nb_idle,
+         elapsed);
+
+  if((epfd = epoll_create(nb_active + 1)) == -1)
+    {
+      fprintf(stderr, "epoll_create failed (%s)\n", strerror(errno));
+      exit(1);
+    }
+
+  /* Active connections: one outstanding NULL call each */
+  for(i = 0; i < nb_active; i++)
+    {
+      bench_conn_t *conn = &active[nb_active_ok];
+
+      if((conn->fd = open_conn(&addr)) == -1)
+        continue;
+
+      fcntl(conn->fd, F_SETFL, fcntl(conn->fd, F_GETFL) | O_NONBLOCK);
+      conn->xid = (unsigned int)i << 16;
+
+      memset(&ev, 0, sizeof(ev));
+      ev.events = EPOLLIN;
+      ev.data.ptr = conn;
+      if(epoll_ctl(epfd, EPOLL_CTL_ADD, conn->fd, &ev) == -1)
+        {
+          close(conn->fd);
+          continue;
+        }
+      nb_active_ok += 1;
+    }
+  printf("active connections: %d/%d established\n", nb_active_ok, nb_active);
+
+  if(nb_active_ok == 0)
+    exit(1);
+
+  gettimeofday(&start, NULL);
+  for(i = 0; i < nb_active_ok; i++)
+    if(send_null_call(&active[i], prog, vers) == -1)
+      nb_errors += 1;
+
+  do
+    {
+      n = epoll_wait(epfd, events, MAX_EVENTS, 1000);
+      for(i = 0; i < n; i++)
+        {
+          bench_conn_t *conn = (bench_conn_t *) events[i].data.ptr;
+
+          switch (recv_reply(conn))
+            {
+            case 1:
+              if(send_null_call(conn, prog, vers) == 0)
+                break;
+              /* fall through */
+            case -1:
+              nb_errors += 1;
+              epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, &ev);
+              close(conn->fd);
+              break;
+            default:
+              break;
+            }
+        }
+      gettimeofday(&now, NULL);
+      elapsed = (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1000000.0;
+    }
+  while(elapsed < duration);
+
+  printf("calls:              %llu in %.3f s (%.0f calls/s)\n", nb_calls, elapsed,
+         nb_calls / elapsed);
+  printf("latency:            mean %.1f us, max %llu us\n",
+         nb_calls ? (double)total_latency / nb_calls : 0.0, max_latency);
+  printf("errors:             %llu\n", nb_errors);
+
+  for(i = 0; i < nb_idle_ok; i++)
+    close(idle[i]);
+
+  return (nb_errors == 0) ? 0 : 2;
+}
+#endif                          /* HAVE_SYS_EPOLL_H */
@@ -0,0 +1,277 @@
+/*****
+ * test the duplicate request cache of nfs_dupreq.c.
+ *
+ * Requests are cached per client address whatever the port, in slots chosen
+ * by xid: a cache of 4 entries keeps the replies of the last 4 xids. The cache
+ * of a client gets 4 entries per transport (port) it uses.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <sys/types.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "rpcal.h"
+#include "nfs_core.h"
+#include "nfs_dupreq.h"
+#include "nfs_proto_functions.h"
+
+#define NB_ENTRIES 4
+
+nfs_parameter_t nfs_param;
+
+static int nb_freed = 0;
+
+static void test_free(nfs_res_t * pres)
+{
+  nb_freed += 1;
+}
+
+#define TEST_DESC { NULL, test_free, NULL, NULL, "test", CAN_BE_DUP }
+#define TEST_DESCS { TEST_DESC, TEST_DESC, TEST_DESC, TEST_DESC, TEST_DESC, \
+                     TEST_DESC, TEST_DESC, TEST_DESC, TEST_DESC, TEST_DESC, \
+                     TEST_DESC, TEST_DESC, TEST_DESC, TEST_DESC, TEST_DESC, \
+                     TEST_DESC, TEST_DESC, TEST_DESC, TEST_DESC, TEST_DESC, \
+                     TEST_DESC, TEST_DESC, TEST_DESC, TEST_DESC }
+
+nfs_function_desc_t nfs2_func_desc[] = TEST_DESCS;
+nfs_function_desc_t nfs3_func_desc[] = TEST_DESCS;
+nfs_function_desc_t nfs4_func_desc[] = TEST_DESCS;
+nfs_function_desc_t mnt1_func_desc[] = TEST_DESCS;
+nfs_function_desc_t mnt3_func_desc[] = TEST_DESCS;
+#ifdef _USE_NLM
+nfs_function_desc_t nlm4_func_desc[] = TEST_DESCS;
+#endif
+#ifdef _USE_QUOTA
+nfs_function_desc_t rquota1_func_desc[] = TEST_DESCS;
+nfs_function_desc_t rquota2_func_desc[] = TEST_DESCS;
+#endif
+
+int fridgethr_get( pthread_t * pthrid, void *(*thrfunc)(void*), void * thrarg )
+{
+  return 0;
+}
+
+void *rpc_tcp_socket_manager_thread(void *Arg)
+{
+  return NULL;
+}
+
+int rpc_tcp_reactor_register(int tcp_sock)
+{
+  return 0;
+}
+
+void Fatal(void)
+{
+    return;
+}
+
+#define EQUALS(a, b, msg) do {                    \
+  if ((a) != (b)) {                               \
+      printf(msg "\n");                           \
+      exit(1);                                    \
+    }                                             \
+} while(0)
+
+static SVCXPRT xprt;
+static struct sockaddr_in caller;
+static struct svc_req req;
+
+/* Make the next requests come from ip:port */
+static void from(char *ip, int port)
+{
+  memset(&caller, 0, sizeof(caller));
+  caller.sin_family = AF_INET;
+  caller.sin_port = htons(port);
+  inet_pton(AF_INET, ip, &caller.sin_addr);
+
+#ifdef _USE_TIRPC
+  xprt.xp_rtaddr.buf = (char *)&caller;
+  xprt.xp_rtaddr.len = sizeof(caller);
+#else
+  memcpy(&xprt.xp_raddr, &caller, sizeof(caller));
+#endif
+}
+
+static int add(long xid)
+{
+  nfs_res_t res;
+
+  return nfs_dupreq_add_not_finished(xid, &req, &xprt, &res);
+}
+
+/* Add a new request and answer it with a reply holding its xid */
+static void answer(long xid)
+{
+  nfs_res_t res;
+
+  EQUALS(nfs_dupreq_add_not_finished(xid, &req, &xprt, &res), DUPREQ_SUCCESS,
+         "a new request is not cached");
+  memset(&res, 0, sizeof(res));
+  res.res_attr2.status = (nfsstat2) xid;
+  EQUALS(nfs_dupreq_finish(xid, &req, &xprt, &res), DUPREQ_SUCCESS,
+         "a cached request can't be finished");
+}
+
+static int cached(long xid)
+{
+  nfs_res_t res;
+  int status;
+
+  res = nfs_dupreq_get(xid, &req, &xprt, &status);
+  if(status == DUPREQ_SUCCESS)
+    EQUALS(res.res_attr2.status, (nfsstat2) xid, "the reply is not the cached one");
+
+  return status == DUPREQ_SUCCESS;
+}
+
+static unsigned int nb_entries(void)
+{
+  hash_stat_t hstat;
+
+  nfs_dupreq_get_stats(&hstat);
+  return hstat.dynamic.nb_entries;
+}
+
+void init()
+{
+  nfs_rpc_dupreq_parameter_t param;
+
+  nfs_param.core_param.program[P_NFS] = 100003;
+  nfs_param.core_param.program[P_MNT] = 100005;
+  nfs_param.core_param.expiration_dupreq = 180;
+
+  memset(&param, 0, sizeof(param));
+  param.hash_param.index_size = 3;
+  param.nb_entries_per_client = NB_ENTRIES;
+  EQUALS(nfs_Init_dupreq(param), DUPREQ_SUCCESS, "init failed");
+
+  req.rq_prog = 100003;
+  req.rq_vers = 3;
+  req.rq_proc = 2;
+}
+
+void replay()
+{
+  nfs_res_t res;
+
+  from("192.168.1.1", 700);
+
+  EQUALS(add(1), DUPREQ_SUCCESS, "xid 1 is not new");
+  EQUALS(add(1), DUPREQ_BEING_PROCESSED, "xid 1 is not being processed");
+
+  memset(&res, 0, sizeof(res));
+  res.res_attr2.status = (nfsstat2) 1;
+  EQUALS(nfs_dupreq_finish(1, &req, &xprt, &res), DUPREQ_SUCCESS, "xid 1 not finished");
+
+  /* A retransmission gets the reply, and holds it while resending it */
+  memset(&res, 0, sizeof(res));
+  EQUALS(nfs_dupreq_add_not_finished(1, &req, &xprt, &res), DUPREQ_ALREADY_EXISTS,
+         "xid 1 is not a retransmission");
+  EQUALS(res.res_attr2.status, (nfsstat2) 1, "xid 1 reply is not the cached one");
+  EQUALS(add(1), DUPREQ_BEING_PROCESSED, "xid 1 is not held while resent");
+  EQUALS(nfs_dupreq_finish(1, &req, &xprt, &res), DUPREQ_SUCCESS, "xid 1 not released");
+  EQUALS(cached(1), 1, "xid 1 is not cached");
+
+  /* A retransmission over a new connection comes from another port */
+  from("192.168.1.1", 701);
+  EQUALS(cached(1), 1, "xid 1 not found from another port");
+
+  /* Another client has its own cache */
+  from("192.168.1.2", 700);
+  answer(1);
+  EQUALS(cached(1), 1, "xid 1 of the second client is not cached");
+  from("192.168.1.1", 700);
+  EQUALS(cached(1), 1, "xid 1 of the first client was retired");
+  EQUALS(nb_entries(), 2, "2 requests should be cached");
+}
+
+void window()
+{
+  long xid;
+
+  from("192.168.1.1", 700);
+
+  /* xid 1 is retired by xid 1 + NB_ENTRIES, and its reply freed */
+  nb_freed = 0;
+  for(xid = 2; xid <= NB_ENTRIES + 1; xid++)
+    answer(xid);
+
+  EQUALS(cached(1), 0, "xid 1 is still cached");
+  EQUALS(nb_freed, 1, "the reply of xid 1 was not freed");
+  for(xid = 2; xid <= NB_ENTRIES + 1; xid++)
+    EQUALS(cached(xid), 1, "a request of the window was retired");
+
+  /* A slot held by a request being processed is not taken */
+  EQUALS(add(NB_ENTRIES + 2), DUPREQ_SUCCESS, "xid 6 is not new");
+  EQUALS(add(2 * NB_ENTRIES + 2), DUPREQ_NOT_CACHED, "xid 10 took a busy slot");
+  EQUALS(cached(2 * NB_ENTRIES + 2), 0, "xid 10 is cached");
+
+  /* A dropped request is removed without freeing any reply */
+  nb_freed = 0;
+  EQUALS(nfs_dupreq_delete(NB_ENTRIES + 2, &req, &xprt), DUPREQ_SUCCESS, "xid 6 not deleted");
+  EQUALS(nfs_dupreq_delete(NB_ENTRIES + 2, &req, &xprt), DUPREQ_NOT_FOUND, "xid 6 deleted twice");
+  EQUALS(nb_freed, 0, "the dropped request reply was freed");
+  /* xids 3 to 5 of the first client, xid 1 of the second one */
+  EQUALS(nb_entries(), NB_ENTRIES, "the cache of the client is not bounded");
+}
+
+void gc()
+{
+  hash_stat_t hstat;
+
+  from("192.168.1.1", 700);
+  EQUALS(add(100), DUPREQ_SUCCESS, "xid 100 is not new");
+
+  /* Everything finished expires, and the client without request is freed */
+  nb_freed = 0;
+  nfs_param.core_param.expiration_dupreq = -1;
+  nfs_dupreq_gc();
+
+  nfs_dupreq_get_stats(&hstat);
+  EQUALS(hstat.dynamic.nb_entries, 1, "only xid 100 should remain");
+  EQUALS(nb_freed, NB_ENTRIES - 1, "the expired replies were not freed");
+  EQUALS(hstat.computed.max_rbt_num_node, 1, "the idle client was not freed");
+  EQUALS(add(100), DUPREQ_BEING_PROCESSED, "xid 100 was collected");
+}
+
+void transports()
+{
+  nfs_res_t res;
+
+  nfs_param.core_param.expiration_dupreq = 180;
+
+  /* The xid sequences of two transports don't retire each other's requests */
+  from("192.168.1.3", 800);
+  answer(1);
+  from("192.168.1.3", 801);
+  answer(NB_ENTRIES + 1);
+  EQUALS(cached(1), 1, "xid 1 was retired by another transport");
+  EQUALS(cached(NB_ENTRIES + 1), 1, "xid 5 is not cached");
+
+  /* Growing again for a third transport keeps what is cached */
+  from("192.168.1.3", 802);
+  memset(&res, 0, sizeof(res));
+  EQUALS(nfs_dupreq_add_not_finished(1, &req, &xprt, &res), DUPREQ_ALREADY_EXISTS,
+         "xid 1 is not a retransmission on a new transport");
+  EQUALS(res.res_attr2.status, (nfsstat2) 1, "xid 1 reply is not the cached one");
+  EQUALS(nfs_dupreq_finish(1, &req, &xprt, &res), DUPREQ_SUCCESS, "xid 1 not released");
+  EQUALS(cached(NB_ENTRIES + 1), 1, "xid 5 was lost while growing");
+  answer(2 * NB_ENTRIES + 1);
+  EQUALS(cached(1), 1, "xid 1 was retired with 3 transports");
+  EQUALS(cached(NB_ENTRIES + 1), 1, "xid 5 was retired with 3 transports");
+}
+
+int main()
+{
+    init();
+    replay();
+    window();
+    gc();
+    transports();
+
+    return 0;
+}
@@ -20,6 +20,11 @@ void *rpc_tcp_socket_manager_thread(void *Arg)
   return NULL;
 }
 
+int rpc_tcp_reactor_register(int tcp_sock)
+{
+  return 0;
+}
+
 
 void Fatal(void) 
 {
@@ -0,0 +1,302 @@
+/*****
+ * Packet rate benchmark for the UDP receivers.
+ *
+ * Drives NULL calls from many UDP sockets, each with its own source port so
+ * that SO_REUSEPORT spreads them over the receiver threads of the server.
+ * Every socket keeps a window of calls in flight. Calls are sent with sendmmsg
+ * and replies fetched with recvmmsg from a single epoll loop. A socket with no
+ * reply for LOSS_TIMEOUT_MS counts its window as lost and sends a new one.
+ *
+ * usage: test_udp_rate [-h host] [-p port] [-P prog] [-V vers]
+ *                      [-s nb_sockets] [-w window] [-t seconds]
+ *
+ * Defaults are 64 sockets with 8 calls in flight each, to the NFSv3 service
+ * of 127.0.0.1:2049 during 10 seconds. Use -P 100021 -V 4 for NLM.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define NULL_CALL_WORDS 10      /* AUTH_NONE credential and verifier */
+#define REPLY_BUF_LEN   512
+#define MAX_WINDOW      64
+#define MAX_EVENTS      512
+#define LOSS_TIMEOUT_MS 200
+
+typedef struct bench_sock__
+{
+  int fd;
+  unsigned int xid;
+  unsigned int in_flight;
+  struct timeval last_reply;
+} bench_sock_t;
+
+static unsigned long long nb_replies = 0;
+static unsigned long long nb_sent = 0;
+static unsigned long long nb_lost = 0;
+static unsigned long long nb_errors = 0;
+
+static unsigned int prog = 100003;
+static unsigned int vers = 3;
+
+static unsigned int calls[MAX_WINDOW][NULL_CALL_WORDS];
+static struct iovec call_iovs[MAX_WINDOW];
+static struct mmsghdr call_msgs[MAX_WINDOW];
+
+static char replies[MAX_WINDOW][REPLY_BUF_LEN];
+static struct iovec reply_iovs[MAX_WINDOW];
+static struct mmsghdr reply_msgs[MAX_WINDOW];
+
+static long elapsed_ms(struct timeval *from, struct timeval *to)
+{
+  return (to->tv_sec - from->tv_sec) * 1000 + (to->tv_usec - from->tv_usec) / 1000;
+}
+
+/* Sends nb NULL calls on a connected socket with one sendmmsg */
+static void send_calls(bench_sock_t *bs, unsigned int nb)
+{
+  unsigned int i;
+  int sent;
+
+  for(i = 0; i < nb; i++)
+    {
+      bs->xid += 1;
+      calls[i][0] = htonl(bs->xid);
+      calls[i][1] = htonl(0);   /* CALL */
+      calls[i][2] = htonl(2);   /* RPC version */
+      calls[i][3] = htonl(prog);
+      calls[i][4] = htonl(vers);
+      calls[i][5] = htonl(0);   /* NULL procedure */
+      calls[i][6] = htonl(0);   /* AUTH_NONE */
+      calls[i][7] = htonl(0);
+      calls[i][8] = htonl(0);   /* AUTH_NONE verifier */
+      calls[i][9] = htonl(0);
+    }
+
+  sent = sendmmsg(bs->fd, call_msgs, nb, 0);
+  if(sent < 0)
+    {
+      nb_errors += 1;
+      return;
+    }
+
+  bs->in_flight += sent;
+  nb_sent += sent;
+}
+
+/* Fetches the replies waiting on a socket and sends as many new calls */
+static void recv_replies(bench_sock_t *bs)
+{
+  unsigned int mtype;
+  int nb;
+  int i;
+  int got = 0;
+
+  for(;;)
+    {
+      nb = recvmmsg(bs->fd, reply_msgs, MAX_WINDOW, MSG_DONTWAIT, NULL);
+      if(nb <= 0)
+        break;
+
+      for(i = 0; i < nb; i++)
+        {
+          memcpy(&mtype, replies[i] + 4, sizeof(mtype));
+          if(reply_msgs[i].msg_len < 24 || ntohl(mtype) != 1)
+            {
+              nb_errors += 1;
+              continue;
+            }
+          got += 1;
+        }
+    }
+
+  if(got == 0)
+    return;
+
+  nb_replies += got;
+  bs->in_flight = (got > bs->in_flight) ? 0 : bs->in_flight - got;
+  gettimeofday(&bs->last_reply, NULL);
+  send_calls(bs, got > MAX_WINDOW ? MAX_WINDOW : got);
+}
+
+int main(int argc, char *argv[])
+{
+  struct sockaddr_in addr;
+  struct epoll_event ev;
+  struct epoll_event events[MAX_EVENTS];
+  struct timeval start, now, last_check;
+  bench_sock_t *socks;
+  char *host = "127.0.0.1";
+  unsigned short port = 2049;
+  unsigned int window = 8;
+  int nb_socks = 64;
+  int nb_socks_ok = 0;
+  int duration = 10;
+  int epfd;
+  int opt;
+  int i, n;
+  double elapsed;
+
+  while((opt = getopt(argc, argv, "h:p:P:V:s:w:t:")) != EOF)
+    {
+      switch (opt)
+        {
+        case 'h':
+          host = optarg;
+          break;
+        case 'p':
+          port = (unsigned short)atoi(optarg);
+          break;
+        case 'P':
+          prog = (unsigned int)atoi(optarg);
+          break;
+        case 'V':
+          vers = (unsigned int)atoi(optarg);
+          break;
+        case 's':
+          nb_socks = atoi(optarg);
+          break;
+        case 'w':
+          window = (unsigned int)atoi(optarg);
+          break;
+        case 't':
+          duration = atoi(optarg);
+          break;
+        default:
+          fprintf(stderr,
+                  "usage: %s [-h host] [-p port] [-P prog] [-V vers] [-s nb_sockets] [-w window] [-t seconds]\n",
+                  argv[0]);
+          exit(1);
+        }
+    }
+
+  if(window == 0 || window > MAX_WINDOW)
+    {
+      fprintf(stderr, "The window must be between 1 and %d\n", MAX_WINDOW);
+      exit(1);
+    }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if(inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+    {
+      fprintf(stderr, "Bad address %s\n", host);
+      exit(1);
+    }
+
+  for(i = 0; i < MAX_WINDOW; i++)
+    {
+      call_iovs[i].iov_base = calls[i];
+      call_iovs[i].iov_len = sizeof(calls[i]);
+      call_msgs[i].msg_hdr.msg_iov = &call_iovs[i];
+      call_msgs[i].msg_hdr.msg_iovlen = 1;
+
+      reply_iovs[i].iov_base = replies[i];
+      reply_iovs[i].iov_len = REPLY_BUF_LEN;
+      reply_msgs[i].msg_hdr.msg_iov = &reply_iovs[i];
+      reply_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+  socks = (bench_sock_t *)calloc(nb_socks, sizeof(bench_sock_t));
+  if(socks == NULL)
+    {
+      fprintf(stderr, "Allocation failed\n");
+      exit(1);
+    }
+
+  if((epfd = epoll_create(nb_socks + 1)) == -1)
+    {
+      fprintf(stderr, "epoll_create failed (%s)\n", strerror(errno));
+      exit(1);
+    }
+
+  /* Connected sockets: each one gets its own source port */
+  for(i = 0; i < nb_socks; i++)
+    {
+      bench_sock_t *bs = &socks[nb_socks_ok];
+
+      if((bs->fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1)
+        continue;
+
+      if(connect(bs->fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+        {
+          close(bs->fd);
+          continue;
+        }
+
+      fcntl(bs->fd, F_SETFL, fcntl(bs->fd, F_GETFL) | O_NONBLOCK);
+      bs->xid = (unsigned int)i << 20;
+
+      memset(&ev, 0, sizeof(ev));
+      ev.events = EPOLLIN;
+      ev.data.ptr = bs;
+      if(epoll_ctl(epfd, EPOLL_CTL_ADD, bs->fd, &ev) == -1)
+        {
+          close(bs->fd);
+          continue;
+        }
+      nb_socks_ok += 1;
+    }
+  printf("sockets:            %d/%d, %u calls in flight each\n", nb_socks_ok,
+         nb_socks, window);
+
+  if(nb_socks_ok == 0)
+    exit(1);
+
+  gettimeofday(&start, NULL);
+  last_check = start;
+  for(i = 0; i < nb_socks_ok; i++)
+    {
+      socks[i].last_reply = start;
+      send_calls(&socks[i], window);
+    }
+
+  do
+    {
+      n = epoll_wait(epfd, events, MAX_EVENTS, LOSS_TIMEOUT_MS / 2);
+      for(i = 0; i < n; i++)
+        recv_replies((bench_sock_t *) events[i].data.ptr);
+
+      gettimeofday(&now, NULL);
+
+      /* A silent socket has lost its calls, or the server dropped them */
+      if(elapsed_ms(&last_check, &now) >= LOSS_TIMEOUT_MS / 2)
+        {
+          for(i = 0; i < nb_socks_ok; i++)
+            if(elapsed_ms(&socks[i].last_reply, &now) >= LOSS_TIMEOUT_MS)
+              {
+                nb_lost += socks[i].in_flight;
+                socks[i].in_flight = 0;
+                socks[i].last_reply = now;
+                send_calls(&socks[i], window);
+              }
+          last_check = now;
+        }
+
+      elapsed = (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1000000.0;
+    }
+  while(elapsed < duration);
+
+  printf("calls sent:         %llu\n", nb_sent);
+  printf("replies:            %llu in %.3f s (%.0f packets/s)\n", nb_replies, elapsed,
+         nb_replies / elapsed);
+  printf("lost:               %llu\n", nb_lost);
+  printf("errors:             %llu\n", nb_errors);
+
+  for(i = 0; i < nb_socks_ok; i++)
+    close(socks[i].fd);
+
+  return (nb_errors == 0) ? 0 : 2;
+}
@@ -37,10 +37,43 @@
 #endif
 
 #include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <errno.h>
 #include "RW_Lock.h"
 
+/* Number of reader slots, shared by all the locks */
+#define RW_LOCK_READER_SLOTS 1024
+
+/* Slots per cache line, threads reading the same lock use different lines */
+#define RW_LOCK_SLOTS_PER_LINE 8
+
+/* Locks a thread may hold at once through its reader slots */
+#define RW_LOCK_THREAD_HELD 8
+
+/* Readers through mutexProtect before the reader bias is restored */
+#define RW_LOCK_BIAS_DELAY 256
+
+/* Spins of a writer waiting for the reader slots before it sleeps */
+#define RW_LOCK_REVOKE_SPINS 64
+
+typedef struct rw_lock_thread__
+{
+  unsigned int id;
+  unsigned int nb_held;
+  rw_lock_t *held_lock[RW_LOCK_THREAD_HELD];
+  unsigned int held_slot[RW_LOCK_THREAD_HELD];
+} rw_lock_thread_t;
+
+static rw_lock_t *volatile rw_lock_readers[RW_LOCK_READER_SLOTS];
+
+static pthread_key_t rw_lock_thread_key;
+static pthread_once_t rw_lock_once = PTHREAD_ONCE_INIT;
+static unsigned int rw_lock_thread_count = 0;
+
 /*
  * Debugging function
  */
@@ -53,11 +86,198 @@ static void print_lock(char *s, rw_lock_t * plock)
                plock->nbw_active, plock->nbw_waiting);
 }                               /* print_lock */
 
+static void rw_lock_thread_free(void *ptr)
+{
+  free(ptr);
+}                               /* rw_lock_thread_free */
+
+static void rw_lock_key_init(void)
+{
+  if(pthread_key_create(&rw_lock_thread_key, rw_lock_thread_free) != 0)
+    LogCrit(COMPONENT_RW_LOCK, "Can't create the key for the reader slots");
+}                               /* rw_lock_key_init */
+
+/*
+ * Get the reader slots context of the calling thread, NULL if it can't be
+ * allocated: the caller then goes through mutexProtect.
+ */
+static rw_lock_thread_t *rw_lock_thread(void)
+{
+  rw_lock_thread_t *pthr;
+
+  if(pthread_once(&rw_lock_once, rw_lock_key_init) != 0)
+    return NULL;
+
+  pthr = (rw_lock_thread_t *) pthread_getspecific(rw_lock_thread_key);
+  if(pthr != NULL)
+    return pthr;
+
+  pthr = (rw_lock_thread_t *) malloc(sizeof(rw_lock_thread_t));
+  if(pthr == NULL)
+    return NULL;
+
+  memset(pthr, 0, sizeof(rw_lock_thread_t));
+  pthr->id = __sync_fetch_and_add(&rw_lock_thread_count, 1);
+
+  if(pthread_setspecific(rw_lock_thread_key, pthr) != 0)
+    {
+      free(pthr);
+      return NULL;
+    }
+
+  return pthr;
+}                               /* rw_lock_thread */
+
+/*
+ * The slot of a lock for the thread of a given id. Consecutive threads get
+ * different cache lines for the same lock, and a lock only ever uses one slot
+ * per line.
+ */
+static unsigned int rw_lock_slot(rw_lock_t * plock, unsigned int id)
+{
+  unsigned long h = ((unsigned long)plock >> 4) * 2654435761UL;
+
+  return (unsigned int)((h ^ (h >> 16)) + id * RW_LOCK_SLOTS_PER_LINE)
+      % RW_LOCK_READER_SLOTS;
+}                               /* rw_lock_slot */
+
+/*
+ * Take the lock for reading through a reader slot, without writing to the
+ * lock. Returns 0 if the lock is held, EBUSY if the caller must go through
+ * mutexProtect.
+ */
+static int rw_lock_fast_read(rw_lock_t * plock)
+{
+  rw_lock_thread_t *pthr;
+  unsigned int slot;
+
+  if(!plock->rbias)
+    return EBUSY;
+
+  if((pthr = rw_lock_thread()) == NULL || pthr->nb_held == RW_LOCK_THREAD_HELD)
+    return EBUSY;
+
+  slot = rw_lock_slot(plock, pthr->id);
+
+  /* The compare and swap is a full barrier: either the writer clearing rbias
+   * sees the slot, or we see rbias cleared */
+  if(!__sync_bool_compare_and_swap(&rw_lock_readers[slot], NULL, plock))
+    return EBUSY;
+
+  if(!plock->rbias)
+    {
+      rw_lock_readers[slot] = NULL;
+      return EBUSY;
+    }
+
+  pthr->held_lock[pthr->nb_held] = plock;
+  pthr->held_slot[pthr->nb_held] = slot;
+  pthr->nb_held++;
+
+  return 0;
+}                               /* rw_lock_fast_read */
+
+/*
+ * Release a lock taken by rw_lock_fast_read. Returns EBUSY if the caller does
+ * not hold it through a reader slot.
+ */
+static int rw_lock_fast_release(rw_lock_t * plock)
+{
+  rw_lock_thread_t *pthr;
+  unsigned int i;
+
+  /* Before the key is created, rw_lock_thread_key may name another key */
+  if(pthread_once(&rw_lock_once, rw_lock_key_init) != 0)
+    return EBUSY;
+
+  if((pthr = (rw_lock_thread_t *) pthread_getspecific(rw_lock_thread_key)) == NULL)
+    return EBUSY;
+
+  for(i = 0; i < pthr->nb_held; i++)
+    if(pthr->held_lock[i] == plock)
+      {
+        __sync_synchronize();
+        rw_lock_readers[pthr->held_slot[i]] = NULL;
+
+        pthr->nb_held--;
+        pthr->held_lock[i] = pthr->held_lock[pthr->nb_held];
+        pthr->held_slot[i] = pthr->held_slot[pthr->nb_held];
+
+        return 0;
+      }
+
+  return EBUSY;
+}                               /* rw_lock_fast_release */
+
+/*
+ * Called by a writer that owns the lock: turn the reader bias off and wait
+ * for the readers holding the lock through their slots. If wait is false,
+ * returns EBUSY instead of waiting for them.
+ */
+static int rw_lock_revoke(rw_lock_t * plock, int wait)
+{
+  unsigned int i;
+  unsigned int spins = 0;
+
+  plock->nbr_slow = 0;
+
+  if(!plock->rbias)
+    return 0;
+
+  plock->rbias = 0;
+  __sync_synchronize();
+
+  for(i = 0; i < RW_LOCK_READER_SLOTS / RW_LOCK_SLOTS_PER_LINE; i++)
+    while(rw_lock_readers[rw_lock_slot(plock, i)] == plock)
+      {
+        if(!wait)
+          return EBUSY;
+
+        if(spins++ < RW_LOCK_REVOKE_SPINS)
+          sched_yield();
+        else
+          usleep(100);
+      }
+
+  return 0;
+}                               /* rw_lock_revoke */
+
+/*
+ * Wake up the threads waiting for the lock once a writer left it.
+ * mutexProtect must be held.
+ */
+static void rw_lock_wakeup(rw_lock_t * plock)
+{
+  if(plock->nbw_waiting > 0)
+    {
+
+      print_lock("V_w.4 redacteur libere un lecteur", plock);
+
+      /* There are waiting writters, but no waiting readers, I let a writter go */
+      pthread_cond_signal(&(plock->condWrite));
+
+      print_lock("V_w.5", plock);
+
+    }
+  else if(plock->nbr_waiting > 0)
+    {
+      /* if readers are waiting, let them go */
+      print_lock("V_w.2 redacteur libere les lecteurs", plock);
+      pthread_cond_broadcast(&(plock->condRead));
+
+      print_lock("V_w.3", plock);
+
+    }
+}                               /* rw_lock_wakeup */
+
 /* 
  * Take the lock for reading 
  */
 int P_r(rw_lock_t * plock)
 {
+  if(rw_lock_fast_read(plock) == 0)
+    return 0;
+
   P(plock->mutexProtect);
 
   print_lock("P_r.1", plock);
@@ -65,13 +285,18 @@ int P_r(rw_lock_t * plock)
   plock->nbr_waiting++;
 
   /* no new read lock is granted if writters are waiting or active */
-  if(plock->nbw_active > 0 || plock->nbw_waiting > 0)
+  while(plock->nbw_active > 0 || plock->nbw_waiting > 0)
     pthread_cond_wait(&(plock->condRead), &(plock->mutexProtect));
 
   /* There is no active or waiting writters, readers can go ... */
   plock->nbr_waiting--;
   plock->nbr_active++;
 
+  /* No writer showed up for a while, readers may use their slots again */
+  if(!plock->rbias && plock->nbw_waiting == 0 &&
+     ++plock->nbr_slow >= RW_LOCK_BIAS_DELAY)
+    plock->rbias = 1;
+
   V(plock->mutexProtect);
 
   print_lock("P_r.end", plock);
@@ -84,6 +309,9 @@ int P_r(rw_lock_t * plock)
  */
 int V_r(rw_lock_t * plock)
 {
+  if(rw_lock_fast_release(plock) == 0)
+    return 0;
+
   P(plock->mutexProtect);
 
   print_lock("V_r.1", plock);
@@ -126,42 +354,68 @@ int P_w(rw_lock_t * plock)
 
   V(plock->mutexProtect);
 
+  rw_lock_revoke(plock, 1);
+
+  plock->seq++;
+  __sync_synchronize();
+
   print_lock("P_w.end", plock);
   return 0;
 }                               /* P_w */
 
 /*
- * Release the lock after writting 
+ * Take the lock for writting only if this can be done without waiting,
+ * returns EBUSY otherwise
  */
-int V_w(rw_lock_t * plock)
+int P_w_try(rw_lock_t * plock)
 {
   P(plock->mutexProtect);
 
-  print_lock("V_w.1", plock);
+  print_lock("P_w_try.1", plock);
 
-  /* I was the active writter, I am not it any more */
-  plock->nbw_active--;
+  if(plock->nbr_active > 0 || plock->nbw_active > 0 || plock->nbw_waiting > 0)
+    {
+      V(plock->mutexProtect);
+      return EBUSY;
+    }
 
-  if(plock->nbw_waiting > 0)
+  plock->nbw_active++;
+
+  V(plock->mutexProtect);
+
+  if(rw_lock_revoke(plock, 0) != 0)
     {
+      P(plock->mutexProtect);
+      plock->nbw_active--;
+      rw_lock_wakeup(plock);
+      V(plock->mutexProtect);
+      return EBUSY;
+    }
 
-      print_lock("V_w.4 redacteur libere un lecteur", plock);
+  plock->seq++;
+  __sync_synchronize();
 
-      /* There are waiting writters, but no waiting readers, I let a writter go */
-      pthread_cond_signal(&(plock->condWrite));
+  print_lock("P_w_try.end", plock);
+  return 0;
+}                               /* P_w_try */
 
-      print_lock("V_w.5", plock);
+/*
+ * Release the lock after writting 
+ */
+int V_w(rw_lock_t * plock)
+{
+  __sync_synchronize();
+  plock->seq++;
 
-    }
-  else if(plock->nbr_waiting > 0)
-    {
-      /* if readers are waiting, let them go */
-      print_lock("V_w.2 redacteur libere les lecteurs", plock);
-      pthread_cond_broadcast(&(plock->condRead));
+  P(plock->mutexProtect);
 
-      print_lock("V_w.3", plock);
+  print_lock("V_w.1", plock);
+
+  /* I was the active writter, I am not it any more */
+  plock->nbw_active--;
+
+  rw_lock_wakeup(plock);
 
-    }
   V(plock->mutexProtect);
 
   print_lock("V_w.end", plock);
@@ -172,6 +426,9 @@ int V_w(rw_lock_t * plock)
 /* Roughly, downgrading a writer lock is making a V_w atomically followed by a P_r */
 int rw_lock_downgrade(rw_lock_t * plock)
 {
+  __sync_synchronize();
+  plock->seq++;
+
   P(plock->mutexProtect);
 
   print_lock("downgrade.1", plock);
@@ -201,6 +458,51 @@ int rw_lock_downgrade(rw_lock_t * plock)
 
 }                               /* rw_lock_downgrade */
 
+/**
+ *
+ * rw_lock_seq_begin: starts a lockless read of the data protected by a lock.
+ *
+ * The data may change under the reader: it must only be used once
+ * rw_lock_seq_retry told it was consistent.
+ *
+ * @param plock [IN] the lock protecting the data.
+ * @param pseq [OUT] the sequence to give to rw_lock_seq_retry.
+ *
+ * @return 0 if the read may start, EBUSY if a writer holds the lock: the
+ * caller should then take it with P_r.
+ *
+ */
+int rw_lock_seq_begin(rw_lock_t * plock, unsigned int *pseq)
+{
+  unsigned int seq = plock->seq;
+
+  __sync_synchronize();
+
+  if(seq & 1)
+    return EBUSY;
+
+  *pseq = seq;
+  return 0;
+}                               /* rw_lock_seq_begin */
+
+/**
+ *
+ * rw_lock_seq_retry: ends a lockless read started by rw_lock_seq_begin.
+ *
+ * @param plock [IN] the lock protecting the data.
+ * @param seq [IN] the sequence returned by rw_lock_seq_begin.
+ *
+ * @return 0 if no writer held the lock during the read, 1 if what was read
+ * must be thrown away.
+ *
+ */
+int rw_lock_seq_retry(rw_lock_t * plock, unsigned int seq)
+{
+  __sync_synchronize();
+
+  return plock->seq != seq;
+}                               /* rw_lock_seq_retry */
+
 /*
  * Routine for initializing a lock
  */
@@ -229,6 +531,10 @@ int rw_lock_init(rw_lock_t * plock)
   plock->nbw_waiting = 0;
   plock->nbw_active = 0;
 
+  plock->nbr_slow = 0;
+  plock->rbias = 0;
+  plock->seq = 0;
+
   return 0;
 }                               /* rw_lock_init */
 
@@ -27,6 +27,14 @@
  * Revision 1.1.1.1  2003/12/17 10:29:49  deniel
  * Recreation de la base 
  *
+ *
+ * Without arguments, checks the consistency of the data seen by readers,
+ * lockless readers and writers, then looks for deadlocks.
+ *
+ * test_rw -b [max_threads [seconds]] measures the read throughput of a lock
+ * shared by 1 to max_threads threads, with no writer and with 1% of writes.
+ * pthread_rwlock_t is measured as a reference.
+ *
  */
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -37,19 +45,55 @@
 #include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sched.h>
 #include "RW_Lock.h"
 #include "log_macros.h"
+#include "MesureTemps.h"
 
 #define MAX_WRITTERS 3
 #define MAX_READERS 5
 #define NB_ITER 40
 #define MARGE_SECURITE 10
 
+#define CHECK_READERS 4
+#define CHECK_SEQ_READERS 2
+#define CHECK_WRITTERS 2
+#define CHECK_ITER 100000
+
+#define BENCH_MAX_THREADS 64
+#define BENCH_SECONDS 1
+#define BENCH_WRITE_PERIOD 100
+
 rw_lock_t lock;
 
 int OkWrite = 0;
 int OkRead = 0;
 
+/* Data protected by lock during the consistency check and the benchmark */
+volatile unsigned long data_a = 0;
+volatile unsigned long data_b = 0;
+
+int check_failed = 0;
+unsigned long check_writes = 0;
+unsigned long check_seq_retries = 0;
+
+typedef enum bench_mode__
+{
+  BENCH_RW_LOCK,
+  BENCH_RW_LOCK_SEQ,
+  BENCH_PTHREAD_RWLOCK
+} bench_mode_t;
+
+char *bench_mode_names[] = { "rw_lock_t P_r", "rw_lock_t seqlock", "pthread_rwlock_t" };
+
+pthread_rwlock_t bench_rwlock;
+bench_mode_t bench_mode;
+int bench_write_period;
+volatile int bench_go = 0;
+volatile int bench_stop = 0;
+unsigned long bench_ops[BENCH_MAX_THREADS * 64];
+
 void *thread_writter(void *arg)
 {
   int duree_sleep = 1;
@@ -82,6 +126,320 @@ void *thread_reader(void *arg)
   return NULL;
 }                               /* thread_writter */
 
+void *thread_check_reader(void *arg)
+{
+  int i;
+
+  for(i = 0; i < CHECK_ITER; i++)
+    {
+      P_r(&lock);
+      if(data_a != data_b)
+        check_failed = 1;
+      V_r(&lock);
+    }
+
+  return NULL;
+}                               /* thread_check_reader */
+
+void *thread_check_seq_reader(void *arg)
+{
+  int i;
+  unsigned int seq;
+  unsigned long a, b;
+
+  for(i = 0; i < CHECK_ITER; i++)
+    {
+      if(rw_lock_seq_begin(&lock, &seq) != 0)
+        {
+          __sync_fetch_and_add(&check_seq_retries, 1);
+          continue;
+        }
+
+      a = data_a;
+      b = data_b;
+
+      if(rw_lock_seq_retry(&lock, seq))
+        __sync_fetch_and_add(&check_seq_retries, 1);
+      else if(a != b)
+        check_failed = 1;
+    }
+
+  return NULL;
+}                               /* thread_check_seq_reader */
+
+void *thread_check_writter(void *arg)
+{
+  int i;
+
+  for(i = 0; i < CHECK_ITER / 100; i++)
+    {
+      switch (i % 3)
+        {
+        case 0:
+          P_w(&lock);
+          data_a += 1;
+          sched_yield();
+          data_b += 1;
+          check_writes += 1;
+          V_w(&lock);
+          break;
+
+        case 1:
+          if(P_w_try(&lock) != 0)
+            break;
+          data_a += 1;
+          data_b += 1;
+          check_writes += 1;
+          V_w(&lock);
+          break;
+
+        case 2:
+          P_w(&lock);
+          data_a += 1;
+          data_b += 1;
+          check_writes += 1;
+          rw_lock_downgrade(&lock);
+          if(data_a != data_b)
+            check_failed = 1;
+          V_r(&lock);
+          break;
+        }
+      sched_yield();
+    }
+
+  return NULL;
+}                               /* thread_check_writter */
+
+/* A reader must not take the log context of its thread for its reader slots */
+void *thread_check_log_context(void *arg)
+{
+  rw_lock_t *plock = (rw_lock_t *) arg;
+
+  SetNameFunction("check_log_context");
+
+  P_r(plock);
+  V_r(plock);
+
+  return NULL;
+}                               /* thread_check_log_context */
+
+int check_log_context(pthread_attr_t * pattr)
+{
+  rw_lock_t ctx_lock;
+  pthread_t thr;
+
+  rw_lock_init(&ctx_lock);
+
+  if(pthread_create(&thr, pattr, thread_check_log_context, &ctx_lock) != 0)
+    return 1;
+  pthread_join(thr, NULL);
+
+  if(ctx_lock.nbr_active != 0)
+    {
+      LogTest("RW_Lock test FAIL: reader released through another thread key");
+      return 1;
+    }
+
+  rw_lock_destroy(&ctx_lock);
+
+  return 0;
+}                               /* check_log_context */
+
+/* Readers, lockless readers and writers must never see a half done write */
+int check_consistency(pthread_attr_t * pattr)
+{
+  pthread_t thr[CHECK_READERS + CHECK_SEQ_READERS + CHECK_WRITTERS];
+  int i, nb = 0;
+
+  for(i = 0; i < CHECK_READERS; i++)
+    if(pthread_create(&thr[nb++], pattr, thread_check_reader, NULL) != 0)
+      return 1;
+  for(i = 0; i < CHECK_SEQ_READERS; i++)
+    if(pthread_create(&thr[nb++], pattr, thread_check_seq_reader, NULL) != 0)
+      return 1;
+  for(i = 0; i < CHECK_WRITTERS; i++)
+    if(pthread_create(&thr[nb++], pattr, thread_check_writter, NULL) != 0)
+      return 1;
+
+  for(i = 0; i < nb; i++)
+    pthread_join(thr[i], NULL);
+
+  LogTest("%lu writes, %lu lockless reads retried", check_writes, check_seq_retries);
+
+  if(check_failed || data_a != check_writes || data_b != check_writes)
+    {
+      LogTest("RW_Lock test FAIL: inconsistent data a=%lu b=%lu writes=%lu",
+              data_a, data_b, check_writes);
+      return 1;
+    }
+
+  /* Readers alone end up going through the reader slots */
+  for(i = 0; i < 1000; i++)
+    {
+      P_r(&lock);
+      V_r(&lock);
+    }
+
+  if(!lock.rbias || lock.nbr_active != 0)
+    {
+      LogTest("RW_Lock test FAIL: reader bias not restored");
+      return 1;
+    }
+
+  P_w(&lock);
+  if(lock.rbias || (lock.seq & 1) == 0)
+    {
+      LogTest("RW_Lock test FAIL: writer did not revoke the reader bias");
+      return 1;
+    }
+  V_w(&lock);
+
+  return 0;
+}                               /* check_consistency */
+
+void *thread_bench(void *arg)
+{
+  unsigned long *pops = (unsigned long *)arg;
+  unsigned long ops = 0;
+  unsigned long a = 0, b = 0;
+  unsigned int seq;
+
+  while(!bench_go)
+    sched_yield();
+
+  while(!bench_stop)
+    {
+      ops += 1;
+
+      if(bench_write_period != 0 && ops % bench_write_period == 0)
+        {
+          if(bench_mode == BENCH_PTHREAD_RWLOCK)
+            pthread_rwlock_wrlock(&bench_rwlock);
+          else
+            P_w(&lock);
+
+          data_a += 1;
+          data_b += 1;
+
+          if(bench_mode == BENCH_PTHREAD_RWLOCK)
+            pthread_rwlock_unlock(&bench_rwlock);
+          else
+            V_w(&lock);
+
+          continue;
+        }
+
+      switch (bench_mode)
+        {
+        case BENCH_RW_LOCK:
+          P_r(&lock);
+          a = data_a;
+          b = data_b;
+          V_r(&lock);
+          break;
+
+        case BENCH_RW_LOCK_SEQ:
+          if(rw_lock_seq_begin(&lock, &seq) == 0)
+            {
+              a = data_a;
+              b = data_b;
+              if(!rw_lock_seq_retry(&lock, seq))
+                break;
+            }
+          P_r(&lock);
+          a = data_a;
+          b = data_b;
+          V_r(&lock);
+          break;
+
+        case BENCH_PTHREAD_RWLOCK:
+          pthread_rwlock_rdlock(&bench_rwlock);
+          a = data_a;
+          b = data_b;
+          pthread_rwlock_unlock(&bench_rwlock);
+          break;
+        }
+
+      if(a != b)
+        check_failed = 1;
+    }
+
+  *pops = ops;
+  return NULL;
+}                               /* thread_bench */
+
+/* Returns the number of operations per second of nb_threads in a mode */
+double bench_run(pthread_attr_t * pattr, bench_mode_t mode, int write_period,
+                 int nb_threads, int seconds)
+{
+  pthread_t thr[BENCH_MAX_THREADS];
+  struct Temps debut, fin;
+  unsigned long total = 0;
+  int i;
+
+  bench_mode = mode;
+  bench_write_period = write_period;
+  bench_go = 0;
+  bench_stop = 0;
+
+  /* Counters are a cache line apart */
+  for(i = 0; i < nb_threads; i++)
+    if(pthread_create(&thr[i], pattr, thread_bench, &bench_ops[i * 64]) != 0)
+      {
+        LogTest("RW_Lock Test FAILED: Bad allocation thread");
+        exit(1);
+      }
+
+  MesureTemps(&debut, NULL);
+  bench_go = 1;
+  sleep(seconds);
+  bench_stop = 1;
+  MesureTemps(&fin, &debut);
+
+  for(i = 0; i < nb_threads; i++)
+    {
+      pthread_join(thr[i], NULL);
+      total += bench_ops[i * 64];
+    }
+
+  return total / (fin.secondes + fin.micro_secondes / 1000000.0);
+}                               /* bench_run */
+
+void bench(pthread_attr_t * pattr, int max_threads, int seconds)
+{
+  int nb_threads, mode, write_period;
+
+  pthread_rwlock_init(&bench_rwlock, NULL);
+
+  for(write_period = 0; write_period <= BENCH_WRITE_PERIOD;
+      write_period += BENCH_WRITE_PERIOD)
+    {
+      printf("\n%s, Mops/s\n", write_period == 0 ? "Readers only" : "1% of writes");
+      printf("%8s", "threads");
+      for(mode = BENCH_RW_LOCK; mode <= BENCH_PTHREAD_RWLOCK; mode++)
+        printf(" %18s", bench_mode_names[mode]);
+      printf("\n");
+
+      for(nb_threads = 1; nb_threads <= max_threads; nb_threads *= 2)
+        {
+          printf("%8d", nb_threads);
+          for(mode = BENCH_RW_LOCK; mode <= BENCH_PTHREAD_RWLOCK; mode++)
+            {
+              printf(" %18.2f",
+                     bench_run(pattr, mode, write_period, nb_threads, seconds) / 1e6);
+              fflush(stdout);
+            }
+          printf("\n");
+        }
+    }
+
+  if(check_failed)
+    {
+      LogTest("RW_Lock test FAIL: inconsistent data during the benchmark");
+      exit(1);
+    }
+}                               /* bench */
+
 int main(int argc, char *argv[])
 {
   SetDefaultLogging("TEST");
@@ -98,6 +456,27 @@ int main(int argc, char *argv[])
 
   LogTest("Init lock: %d", rw_lock_init(&lock));
 
+  /* Must run before any reader slot is used: it needs the key not created */
+  if(check_log_context(&attr_thr))
+    exit(1);
+
+  if(argc > 1 && !strcmp(argv[1], "-b"))
+    {
+      int max_threads = argc > 2 ? atoi(argv[2]) : BENCH_MAX_THREADS;
+      int seconds = argc > 3 ? atoi(argv[3]) : BENCH_SECONDS;
+
+      if(max_threads < 1 || max_threads > BENCH_MAX_THREADS)
+        max_threads = BENCH_MAX_THREADS;
+      if(seconds < 1)
+        seconds = BENCH_SECONDS;
+
+      bench(&attr_thr, max_threads, seconds);
+      exit(0);
+    }
+
+  if(check_consistency(&attr_thr))
+    exit(1);
+
   LogTest("ESTIMATED TIME OF TEST: %d s",
          (MAX_WRITTERS + MAX_READERS) * NB_ITER + MARGE_SECURITE);
   fflush(stdout);
@@ -0,0 +1,560 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs4_deleg.c
+ * \brief   NFSv4 read delegations: grant policy, conflicts and recalls.
+ *
+ * nfs4_deleg.c : A read delegation is a state of type STATE_TYPE_DELEG in
+ * the state list of the file. It is granted at OPEN time to a client that
+ * has opened the file for reading several times in a row, as long as no
+ * one has the file opened for writing and no delegation of the file was
+ * recalled during the last lease.
+ *
+ * A conflicting OPEN, or a modification of the file by NFSv3 or NFSv4,
+ * queues a recall of the delegations held by the other clients and gets
+ * STATE_DELEG_RECALLED, which the protocols turn into NFS4ERR_DELAY or
+ * NFS3ERR_JUKEBOX. The recall thread sends CB_RECALL for each queued
+ * recall; a delegation still there a lease after its recall is revoked,
+ * it no longer conflicts and is dropped by the next worker that meets it.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs_core.h"
+#include "nfs4.h"
+#include "sal_functions.h"
+
+#define NFS4_DELEG_MIN_OPENS    2       /* Read opens in a row before granting */
+#define NFS4_DELEG_RETRY_DELAY  2       /* Seconds between two CB_RECALL attempts */
+
+typedef struct state_deleg_recall_entry__
+{
+  struct glist_head list;
+  char other[OTHERSIZE];
+  state_deleg_recall_t recall;
+  time_t queued;                /* When the recall was decided */
+  time_t next_send;             /* When to send CB_RECALL, 0 once sent */
+} state_deleg_recall_entry_t;
+
+static pthread_mutex_t deleg_recall_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t deleg_recall_cond = PTHREAD_COND_INITIALIZER;
+static struct glist_head deleg_recall_list = { &deleg_recall_list, &deleg_recall_list };
+
+/**
+ *
+ * state_deleg_same_client: tells if a state belongs to a given client.
+ *
+ * @param pstate   [IN] the state
+ * @param clientid [IN] the client, 0 if unknown
+ *
+ * @return TRUE if the state is owned by this client.
+ *
+ */
+static int state_deleg_same_client(state_t * pstate, clientid4 clientid)
+{
+  if(clientid == 0 || pstate->state_powner == NULL)
+    return FALSE;
+
+  if(pstate->state_powner->so_type != STATE_LOCK_OWNER_NFSV4)
+    return FALSE;
+
+  return pstate->state_powner->so_owner.so_nfs4_owner.so_clientid == clientid;
+}                               /* state_deleg_same_client */
+
+/**
+ *
+ * state_deleg_wanted: decides if a delegation is worth granting.
+ *
+ * Accounts an OPEN of the file in its history: a delegation is worth it if
+ * the client opened the file for reading at least NFS4_DELEG_MIN_OPENS times
+ * in a row, and if no delegation of the file was recalled for a lease.
+ * Opening for writing clears the history.
+ *
+ * @param pheur        [INOUT] open history of the file
+ * @param clientid     [IN]    client opening the file
+ * @param share_access [IN]    OPEN4_SHARE_ACCESS_* of the OPEN
+ * @param now          [IN]    current time
+ *
+ * @return TRUE if a read delegation should be granted.
+ *
+ */
+int state_deleg_wanted(cache_inode_deleg_heuristics_t * pheur,
+                       clientid4 clientid, unsigned int share_access, time_t now)
+{
+  if(share_access & OPEN4_SHARE_ACCESS_WRITE)
+    {
+      pheur->clientid = clientid;
+      pheur->nb_opens = 0;
+      return FALSE;
+    }
+
+  if(pheur->clientid == clientid)
+    pheur->nb_opens += 1;
+  else
+    {
+      pheur->clientid = clientid;
+      pheur->nb_opens = 1;
+    }
+
+  if(pheur->last_recall != 0 &&
+     now - pheur->last_recall < (time_t) nfs_param.nfsv4_param.lease_lifetime)
+    return FALSE;
+
+  return pheur->nb_opens >= NFS4_DELEG_MIN_OPENS;
+}                               /* state_deleg_wanted */
+
+/**
+ *
+ * state_deleg_recall_one: queues the recall of a delegation.
+ *
+ * The lock of the related pentry must be held for writing. Does nothing if
+ * the delegation is already being recalled.
+ *
+ * @param pstate [INOUT] the delegation
+ *
+ */
+static void state_deleg_recall_one(state_t * pstate)
+{
+  state_deleg_recall_entry_t *pentry_recall;
+  cache_entry_t *pentry = pstate->state_pentry;
+  time_t now;
+
+  if(pstate->state_data.deleg.d_recall_time != 0)
+    return;
+
+  now = time(NULL);
+  pstate->state_data.deleg.d_recall_time = now;
+  pentry->object.file.deleg_heuristics.last_recall = now;
+  pentry->object.file.deleg_heuristics.nb_opens = 0;
+
+  pentry_recall = (state_deleg_recall_entry_t *)
+      Mem_Alloc_Label(sizeof(state_deleg_recall_entry_t), "state_deleg_recall");
+
+  if(pentry_recall == NULL)
+    {
+      /* Nothing will tell the client, but the file must not stay blocked */
+      LogCrit(COMPONENT_STATE,
+              "Can't allocate a delegation recall, revoking the delegation of pentry %p",
+              pentry);
+      pstate->state_data.deleg.d_revoked = TRUE;
+      return;
+    }
+
+  memcpy(pentry_recall->other, pstate->stateid_other, OTHERSIZE);
+  pentry_recall->recall.sdr_clientid =
+      pstate->state_powner->so_owner.so_nfs4_owner.so_clientid;
+  pentry_recall->recall.sdr_stateid.seqid = pstate->state_seqid;
+  memcpy(pentry_recall->recall.sdr_stateid.other, pstate->stateid_other, OTHERSIZE);
+  pentry_recall->recall.sdr_fh_len = pstate->state_data.deleg.d_fh_len;
+  memcpy(pentry_recall->recall.sdr_fh, pstate->state_data.deleg.d_fh,
+         pstate->state_data.deleg.d_fh_len);
+  pentry_recall->queued = now;
+  pentry_recall->next_send = now;
+
+  LogDebug(COMPONENT_STATE,
+           "Recalling delegation of client %"PRIx64" on pentry %p",
+           pentry_recall->recall.sdr_clientid, pentry);
+
+  P(deleg_recall_mutex);
+  glist_add_tail(&deleg_recall_list, &pentry_recall->list);
+  pthread_cond_signal(&deleg_recall_cond);
+  V(deleg_recall_mutex);
+}                               /* state_deleg_recall_one */
+
+/**
+ *
+ * state_deleg_recall_conflicts: recalls the delegations conflicting with a state.
+ *
+ * The lock of pentry must be held for writing. The delegations of the client
+ * asking for the state are left alone, as are the revoked ones.
+ *
+ * @param pentry      [INOUT] the file
+ * @param clientid    [IN]    client asking for the state, 0 if unknown
+ * @param state_type  [IN]    type of the candidate state
+ * @param pstate_data [IN]    data of the candidate state
+ *
+ * @return the number of delegations being recalled.
+ *
+ */
+unsigned int state_deleg_recall_conflicts(cache_entry_t * pentry,
+                                          clientid4 clientid,
+                                          state_type_t state_type,
+                                          state_data_t * pstate_data)
+{
+  state_t *piter_state;
+  unsigned int nb_recalled = 0;
+
+  for(piter_state = pentry->object.file.pstate_head; piter_state != NULL;
+      piter_state = piter_state->state_next)
+    {
+      if(piter_state->state_type != STATE_TYPE_DELEG ||
+         piter_state->state_data.deleg.d_revoked ||
+         state_deleg_same_client(piter_state, clientid))
+        continue;
+
+      if(!state_conflict(piter_state, state_type, pstate_data))
+        continue;
+
+      state_deleg_recall_one(piter_state);
+      nb_recalled += 1;
+    }
+
+  return nb_recalled;
+}                               /* state_deleg_recall_conflicts */
+
+/**
+ *
+ * state_deleg_purge_revoked: drops the revoked delegations of a file.
+ *
+ * @param pentry  [INOUT] the file
+ * @param pclient [INOUT] cache inode client, for the state pool
+ *
+ */
+static void state_deleg_purge_revoked(cache_entry_t * pentry,
+                                      cache_inode_client_t * pclient)
+{
+  state_t *piter_state;
+  state_status_t status;
+  char other[OTHERSIZE];
+  int found;
+
+  do
+    {
+      found = FALSE;
+
+      P_r(&pentry->lock);
+      for(piter_state = pentry->object.file.pstate_head; piter_state != NULL;
+          piter_state = piter_state->state_next)
+        if(piter_state->state_type == STATE_TYPE_DELEG &&
+           piter_state->state_data.deleg.d_revoked)
+          {
+            memcpy(other, piter_state->stateid_other, OTHERSIZE);
+            found = TRUE;
+            break;
+          }
+      V_r(&pentry->lock);
+
+      if(found && state_del_by_key(other, pclient, &status) != STATE_SUCCESS)
+        found = FALSE;
+    }
+  while(found);
+}                               /* state_deleg_purge_revoked */
+
+/**
+ *
+ * state_deleg_grant: grants a read delegation after an OPEN, if worth it.
+ *
+ * Updates the open history of the file, and adds a delegation state to
+ * the file if state_deleg_wanted agrees, if the client does not already
+ * hold one and if no delegation of the file is being recalled. The caller
+ * is expected to have checked that the client can be called back.
+ *
+ * @param pentry       [INOUT] the file just opened
+ * @param powner       [IN]    open owner of the OPEN
+ * @param share_access [IN]    OPEN4_SHARE_ACCESS_* of the OPEN
+ * @param pfh          [IN]    file handle of the file, used by CB_RECALL
+ * @param pclient      [INOUT] cache inode client
+ * @param pcontext     [IN]    FSAL credentials
+ * @param ppstate      [OUT]   the new delegation
+ * @param pstatus      [OUT]   STATE_SUCCESS if granted, STATE_STATE_CONFLICT
+ *                             if not worth it, or the error of state_add
+ *
+ * @return the same as *pstatus
+ *
+ */
+state_status_t state_deleg_grant(cache_entry_t * pentry,
+                                 state_owner_t * powner,
+                                 unsigned int share_access,
+                                 nfs_fh4 * pfh,
+                                 cache_inode_client_t * pclient,
+                                 fsal_op_context_t * pcontext,
+                                 state_t ** ppstate,
+                                 state_status_t * pstatus)
+{
+  state_data_t candidate_data;
+  state_t *piter_state;
+  clientid4 clientid;
+  int wanted;
+
+  if(pstatus == NULL)
+    return STATE_INVALID_ARGUMENT;
+
+  *ppstate = NULL;
+
+  if(!nfs_param.nfsv4_param.allow_delegations || powner == NULL ||
+     powner->so_type != STATE_LOCK_OWNER_NFSV4 ||
+     pentry->internal_md.type != REGULAR_FILE || pfh->nfs_fh4_len > NFS4_FHSIZE)
+    {
+      *pstatus = STATE_NOT_SUPPORTED;
+      return *pstatus;
+    }
+
+  clientid = powner->so_owner.so_nfs4_owner.so_clientid;
+
+  state_deleg_purge_revoked(pentry, pclient);
+
+  P_w(&pentry->lock);
+
+  wanted = state_deleg_wanted(&pentry->object.file.deleg_heuristics,
+                              clientid, share_access, time(NULL));
+
+  for(piter_state = pentry->object.file.pstate_head;
+      wanted && piter_state != NULL; piter_state = piter_state->state_next)
+    if(piter_state->state_type == STATE_TYPE_DELEG &&
+       (state_deleg_same_client(piter_state, clientid) ||
+        piter_state->state_data.deleg.d_recall_time != 0))
+      wanted = FALSE;
+
+  V_w(&pentry->lock);
+
+  if(!wanted)
+    {
+      *pstatus = STATE_STATE_CONFLICT;
+      return *pstatus;
+    }
+
+  memset(&candidate_data, 0, sizeof(candidate_data));
+  candidate_data.deleg.d_type = OPEN_DELEGATE_READ;
+  candidate_data.deleg.d_fh_len = pfh->nfs_fh4_len;
+  memcpy(candidate_data.deleg.d_fh, pfh->nfs_fh4_val, pfh->nfs_fh4_len);
+
+  /* state_add refuses the delegation if someone has the file opened for writing */
+  if(state_add(pentry, STATE_TYPE_DELEG, &candidate_data, powner,
+               pclient, pcontext, ppstate, pstatus) != STATE_SUCCESS)
+    return *pstatus;
+
+  P_w(&pentry->lock);
+  (*ppstate)->state_seqid = 1;
+  V_w(&pentry->lock);
+
+  LogDebug(COMPONENT_STATE,
+           "Granted a read delegation to client %"PRIx64" on pentry %p",
+           clientid, pentry);
+
+  return *pstatus;
+}                               /* state_deleg_grant */
+
+/**
+ *
+ * state_deleg_break: recalls the delegations before a file is modified.
+ *
+ * To be called before a SETATTR, a WRITE without open state, a REMOVE or a
+ * RENAME alters the file.
+ *
+ * @param pentry   [INOUT] the file about to be modified
+ * @param clientid [IN]    client modifying the file, 0 if unknown
+ * @param pclient  [INOUT] cache inode client
+ * @param pstatus  [OUT]   STATE_SUCCESS, or STATE_DELEG_RECALLED if the
+ *                         modification has to wait for delegations to be
+ *                         returned
+ *
+ * @return the same as *pstatus
+ *
+ */
+state_status_t state_deleg_break(cache_entry_t * pentry,
+                                 clientid4 clientid,
+                                 cache_inode_client_t * pclient,
+                                 state_status_t * pstatus)
+{
+  state_data_t candidate_data;
+  unsigned int nb_recalled;
+
+  if(pstatus == NULL)
+    return STATE_INVALID_ARGUMENT;
+
+  *pstatus = STATE_SUCCESS;
+
+  if(!nfs_param.nfsv4_param.allow_delegations || pentry == NULL ||
+     pentry->internal_md.type != REGULAR_FILE)
+    return *pstatus;
+
+  state_deleg_purge_revoked(pentry, pclient);
+
+  memset(&candidate_data, 0, sizeof(candidate_data));
+  candidate_data.share.share_access = OPEN4_SHARE_ACCESS_WRITE;
+
+  P_w(&pentry->lock);
+  nb_recalled = state_deleg_recall_conflicts(pentry, clientid,
+                                             STATE_TYPE_SHARE, &candidate_data);
+  V_w(&pentry->lock);
+
+  if(nb_recalled != 0)
+    *pstatus = STATE_DELEG_RECALLED;
+
+  return *pstatus;
+}                               /* state_deleg_break */
+
+/**
+ *
+ * state_deleg_revoke: revokes a delegation not returned in time.
+ *
+ * @param other [IN] stateid.other of the delegation
+ *
+ */
+static void state_deleg_revoke(char other[OTHERSIZE])
+{
+  state_t *pstate;
+  cache_entry_t *pentry;
+
+  if(!nfs4_State_Get_Pointer(other, &pstate) ||
+     (pentry = pstate->state_pentry) == NULL)
+    return;
+
+  P_w(&pentry->lock);
+  if(pstate->state_type == STATE_TYPE_DELEG &&
+     !memcmp(pstate->stateid_other, other, OTHERSIZE))
+    {
+      LogEvent(COMPONENT_STATE,
+               "Delegation of client %"PRIx64" on pentry %p not returned within a lease, revoked",
+               pstate->state_powner->so_owner.so_nfs4_owner.so_clientid, pentry);
+      pstate->state_data.deleg.d_revoked = TRUE;
+    }
+  V_w(&pentry->lock);
+}                               /* state_deleg_revoke */
+
+/**
+ *
+ * state_deleg_recall_get: gets the next recall to send.
+ *
+ * Called by the recall thread. Forgets the recalls whose delegation was
+ * returned, revokes the delegations recalled for more than a lease, and
+ * waits up to delay seconds for a CB_RECALL to send. A recall is handed
+ * over again every NFS4_DELEG_RETRY_DELAY seconds until
+ * state_deleg_recall_sent is called for it.
+ *
+ * @param precall [OUT] the recall to send
+ * @param delay   [IN]  maximum wait in seconds
+ *
+ * @return TRUE if precall is to be sent, FALSE if there is none.
+ *
+ */
+int state_deleg_recall_get(state_deleg_recall_t * precall, unsigned int delay)
+{
+  struct glist_head *glist, *glistn;
+  struct glist_head expired;
+  state_deleg_recall_entry_t *pentry_recall;
+  state_t *pstate;
+  struct timeval tv;
+  struct timespec timeout;
+  time_t now;
+  int found = FALSE;
+
+  init_glist(&expired);
+
+  gettimeofday(&tv, NULL);
+  timeout.tv_sec = tv.tv_sec + delay;
+  timeout.tv_nsec = tv.tv_usec * 1000;
+
+  P(deleg_recall_mutex);
+
+  while(!found)
+    {
+      now = time(NULL);
+
+      glist_for_each_safe(glist, glistn, &deleg_recall_list)
+        {
+          pentry_recall = glist_entry(glist, state_deleg_recall_entry_t, list);
+
+          if(!nfs4_State_Get_Pointer(pentry_recall->other, &pstate) ||
+             pstate->state_type != STATE_TYPE_DELEG)
+            {
+              /* Returned */
+              glist_del(&pentry_recall->list);
+              Mem_Free(pentry_recall);
+              continue;
+            }
+
+          if(now - pentry_recall->queued >= (time_t) nfs_param.nfsv4_param.lease_lifetime)
+            {
+              /* Revoked once the mutex is released, to respect the lock order */
+              glist_del(&pentry_recall->list);
+              glist_add_tail(&expired, &pentry_recall->list);
+              continue;
+            }
+
+          if(!found && pentry_recall->next_send != 0 && pentry_recall->next_send <= now)
+            {
+              *precall = pentry_recall->recall;
+              pentry_recall->next_send = now + NFS4_DELEG_RETRY_DELAY;
+              found = TRUE;
+            }
+        }
+
+      if(found || !glist_empty(&expired))
+        break;
+
+      if(pthread_cond_timedwait(&deleg_recall_cond, &deleg_recall_mutex, &timeout) != 0)
+        break;
+    }
+
+  V(deleg_recall_mutex);
+
+  glist_for_each_safe(glist, glistn, &expired)
+    {
+      pentry_recall = glist_entry(glist, state_deleg_recall_entry_t, list);
+      state_deleg_revoke(pentry_recall->other);
+      glist_del(&pentry_recall->list);
+      Mem_Free(pentry_recall);
+    }
+
+  return found;
+}                               /* state_deleg_recall_get */
+
+/**
+ *
+ * state_deleg_recall_sent: records that the client got its CB_RECALL.
+ *
+ * @param precall [IN] the recall, as returned by state_deleg_recall_get
+ *
+ */
+void state_deleg_recall_sent(state_deleg_recall_t * precall)
+{
+  struct glist_head *glist;
+  state_deleg_recall_entry_t *pentry_recall;
+
+  P(deleg_recall_mutex);
+
+  glist_for_each(glist, &deleg_recall_list)
+    {
+      pentry_recall = glist_entry(glist, state_deleg_recall_entry_t, list);
+
+      if(!memcmp(pentry_recall->other, precall->sdr_stateid.other, OTHERSIZE))
+        {
+          pentry_recall->next_send = 0;
+          break;
+        }
+    }
+
+  V(deleg_recall_mutex);
+}                               /* state_deleg_recall_sent */
@@ -32,6 +32,20 @@
  *
  * nfs4_lease.c : Some functions to manage NFSv4 leases
  *
+ * The lease of each client is kept in a hierarchical timing wheel of
+ * NFS4_LEASE_WHEEL_LEVELS levels of NFS4_LEASE_WHEEL_SIZE slots: a slot of
+ * the first level holds the leases expiring in a given second, a slot of
+ * the next level those expiring in the next NFS4_LEASE_WHEEL_SIZE seconds
+ * interval, and so on. Renewing a lease moves it to another slot. Each
+ * second, the reaper thread expires the leases of the current slot of the
+ * first level, after having spread those of the higher levels whose interval
+ * begins over the lower levels.
+ *
+ * A lease also links the states, the NFSv4 owners and the NFSv4.1 sessions
+ * of its client, so that the reaper releases the locks, opens and delegations
+ * of an expired client, destroys its sessions and then forgets it, instead of
+ * keeping them until someone trips on them.
+ *
  * $Header: /cea/home/cvs/cvs/SHERPA/BaseCvs/GANESHA/src/MainNFSD/nfs_tools.c,v 1.43 2006/01/20 07:39:22 leibovic Exp $
  *
  * $Log$
@@ -45,53 +59,587 @@
 #include "solaris_port.h"
 #endif
 
+#include <pthread.h>
 #include "log_macros.h"
 #include "stuff_alloc.h"
 #include "nfs_core.h"
 #include "nfs4.h"
+#include "cache_inode.h"
 #include "sal_functions.h"
 
+#define NFS4_LEASE_WHEEL_BITS   6
+#define NFS4_LEASE_WHEEL_SIZE   (1 << NFS4_LEASE_WHEEL_BITS)
+#define NFS4_LEASE_WHEEL_MASK   (NFS4_LEASE_WHEEL_SIZE - 1)
+#define NFS4_LEASE_WHEEL_LEVELS 3       /* slots of 1s, 64s and 4096s */
+#define NFS4_LEASE_WHEEL_SPAN   ((time_t) 1 << (NFS4_LEASE_WHEEL_BITS * NFS4_LEASE_WHEEL_LEVELS))
+
+#define NFS4_LEASE_HASH_SIZE    1021
+
+/* The lease of a client */
+typedef struct nfs4_lease__
+{
+  clientid4 clientid;
+  time_t deadline;              /* expires once the wheel reaches it */
+  struct glist_head wheel_list; /* in a slot of the wheel */
+  struct glist_head states;     /* state_lease_list of the states of the client */
+  struct glist_head owners;     /* so_lease_list of its NFSv4 owners */
+#ifdef _USE_NFS4_1
+  struct glist_head sessions;   /* session_lease_list of its sessions */
+#endif
+  int has_context;
+  fsal_op_context_t context;    /* of the last state added, to release the locks */
+  struct nfs4_lease__ *next;    /* in the hash */
+} nfs4_lease_t;
+
+static pthread_mutex_t lease_mutex = PTHREAD_MUTEX_INITIALIZER;
+static nfs4_lease_t *lease_hash[NFS4_LEASE_HASH_SIZE];
+static struct glist_head lease_wheel[NFS4_LEASE_WHEEL_LEVELS][NFS4_LEASE_WHEEL_SIZE];
+static time_t lease_wheel_now = 0;      /* last second expired */
+static unsigned int lease_nb_clients = 0;
+static time_t (*lease_clock)(time_t *) = time;
+
+/**
+ *
+ * nfs4_lease_init: initializes the timing wheel.
+ *
+ * @param now [IN] current time, the wheel starts from there
+ *
+ */
+void nfs4_lease_init(time_t now)
+{
+  int level, slot;
+
+  P(lease_mutex);
+
+  for(level = 0; level < NFS4_LEASE_WHEEL_LEVELS; level++)
+    for(slot = 0; slot < NFS4_LEASE_WHEEL_SIZE; slot++)
+      init_glist(&lease_wheel[level][slot]);
+
+  lease_wheel_now = now;
+
+  V(lease_mutex);
+}                               /* nfs4_lease_init */
+
+/**
+ *
+ * nfs4_lease_set_clock: replaces the clock of the leases.
+ *
+ * Lets the tests run the wheel on a simulated clock. Called before
+ * nfs4_lease_init.
+ *
+ * @param clock [IN] function returning the current time, as time(2)
+ *
+ */
+void nfs4_lease_set_clock(time_t (*clock)(time_t *))
+{
+  lease_clock = clock;
+}                               /* nfs4_lease_set_clock */
+
+/* Puts a lease in the slot of its deadline, lease_mutex held */
+static void nfs4_lease_place(nfs4_lease_t * please)
+{
+  time_t slot_time = please->deadline;
+  time_t delta = please->deadline - lease_wheel_now;
+  int level;
+
+  /* A lease due now only comes from a slot being spread, before the current
+   * slot of the first level is expired.
+   */
+  if(delta < 0)
+    {
+      /* Overdue, expired at the next tick */
+      slot_time = lease_wheel_now + 1;
+      delta = 1;
+    }
+  else if(delta >= NFS4_LEASE_WHEEL_SPAN)
+    {
+      /* Beyond the wheel, placed again when its slot is spread */
+      slot_time = lease_wheel_now + NFS4_LEASE_WHEEL_SPAN - 1;
+      delta = NFS4_LEASE_WHEEL_SPAN - 1;
+    }
+
+  for(level = 0; level < NFS4_LEASE_WHEEL_LEVELS - 1; level++)
+    if(delta < ((time_t) 1 << (NFS4_LEASE_WHEEL_BITS * (level + 1))))
+      break;
+
+  glist_add_tail(&lease_wheel[level]
+                 [(slot_time >> (NFS4_LEASE_WHEEL_BITS * level)) & NFS4_LEASE_WHEEL_MASK],
+                 &please->wheel_list);
+}                               /* nfs4_lease_place */
+
+/* Sets the deadline of a lease and moves it in the wheel, lease_mutex held */
+static void nfs4_lease_touch(nfs4_lease_t * please, time_t now)
+{
+  time_t deadline = now + nfs_param.nfsv4_param.lease_lifetime + 1;
+
+  if(deadline == please->deadline)
+    return;
+
+  please->deadline = deadline;
+  glist_del(&please->wheel_list);
+  nfs4_lease_place(please);
+}                               /* nfs4_lease_touch */
+
+/* Spreads a slot of a higher level over the lower ones, lease_mutex held */
+static void nfs4_lease_cascade(int level, int slot)
+{
+  struct glist_head *glist, *glistn;
+  struct glist_head moved;
+
+  init_glist(&moved);
+  glist_add_list_tail(&moved, &lease_wheel[level][slot]);
+  init_glist(&lease_wheel[level][slot]);
+
+  glist_for_each_safe(glist, glistn, &moved)
+    {
+      glist_del(glist);
+      nfs4_lease_place(glist_entry(glist, nfs4_lease_t, wheel_list));
+    }
+}                               /* nfs4_lease_cascade */
+
+/**
+ *
+ * nfs4_lease_advance: turns the wheel up to the current time.
+ *
+ * Moves the leases whose deadline is reached to the expired list. The caller
+ * holds lease_mutex.
+ *
+ * @param now      [IN]    current time
+ * @param pexpired [INOUT] list the expired leases are added to
+ *
+ */
+static void nfs4_lease_advance(time_t now, struct glist_head *pexpired)
+{
+  struct glist_head *glist, *glistn;
+  struct glist_head *pslot;
+  nfs4_lease_t *please;
+  int level;
+
+  while(lease_wheel_now < now)
+    {
+      lease_wheel_now++;
+
+      /* Spread the higher levels first, they may feed the lower ones */
+      for(level = NFS4_LEASE_WHEEL_LEVELS - 1; level > 0; level--)
+        if((lease_wheel_now & (((time_t) 1 << (NFS4_LEASE_WHEEL_BITS * level)) - 1)) == 0)
+          nfs4_lease_cascade(level,
+                             (lease_wheel_now >> (NFS4_LEASE_WHEEL_BITS * level)) &
+                             NFS4_LEASE_WHEEL_MASK);
+
+      pslot = &lease_wheel[0][lease_wheel_now & NFS4_LEASE_WHEEL_MASK];
+
+      glist_for_each_safe(glist, glistn, pslot)
+        {
+          please = glist_entry(glist, nfs4_lease_t, wheel_list);
+          glist_del(glist);
+
+          if(please->deadline <= lease_wheel_now)
+            glist_add_tail(pexpired, glist);
+          else
+            nfs4_lease_place(please);
+        }
+    }
+}                               /* nfs4_lease_advance */
+
+/* Finds, or creates, the lease of a client, lease_mutex held */
+static nfs4_lease_t *nfs4_lease_lookup(clientid4 clientid, int create)
+{
+  nfs4_lease_t *please;
+  unsigned int h = (unsigned int)(clientid % NFS4_LEASE_HASH_SIZE);
+
+  for(please = lease_hash[h]; please != NULL; please = please->next)
+    if(please->clientid == clientid)
+      return please;
+
+  if(!create)
+    return NULL;
+
+  please = (nfs4_lease_t *) Mem_Alloc_Label(sizeof(nfs4_lease_t), "nfs4_lease_t");
+  if(please == NULL)
+    {
+      LogCrit(COMPONENT_STATE,
+              "Could not allocate the lease of client %"PRIx64, clientid);
+      return NULL;
+    }
+
+  please->clientid = clientid;
+  please->deadline = 0;
+  please->has_context = FALSE;
+  init_glist(&please->wheel_list);
+  init_glist(&please->states);
+  init_glist(&please->owners);
+#ifdef _USE_NFS4_1
+  init_glist(&please->sessions);
+#endif
+
+  please->next = lease_hash[h];
+  lease_hash[h] = please;
+  lease_nb_clients++;
+
+  return please;
+}                               /* nfs4_lease_lookup */
+
+/* Forgets the lease of a client, lease_mutex held */
+static void nfs4_lease_unhash(nfs4_lease_t * please)
+{
+  nfs4_lease_t **pprev;
+
+  for(pprev = &lease_hash[please->clientid % NFS4_LEASE_HASH_SIZE]; *pprev != NULL;
+      pprev = &(*pprev)->next)
+    if(*pprev == please)
+      {
+        *pprev = please->next;
+        lease_nb_clients--;
+        break;
+      }
+}                               /* nfs4_lease_unhash */
+
+/**
+ *
+ * nfs4_lease_renew: renews the lease of a client.
+ *
+ * Called by SETCLIENTID, SETCLIENTID_CONFIRM, RENEW, EXCHANGE_ID, SEQUENCE
+ * and by the operations using a stateid of the client. The lease is created
+ * at the first call.
+ *
+ * @param clientid [IN] the client
+ *
+ */
+void nfs4_lease_renew(clientid4 clientid)
+{
+  nfs4_lease_t *please;
+
+  P(lease_mutex);
+
+  please = nfs4_lease_lookup(clientid, TRUE);
+  if(please != NULL)
+    nfs4_lease_touch(please, lease_clock(NULL));
+
+  V(lease_mutex);
+}                               /* nfs4_lease_renew */
+
+/**
+ *
+ * nfs4_lease_state: links a state to the lease of its client, or unlinks it.
+ *
+ * Adding a state renews the lease.
+ *
+ * @param pstate   [INOUT] the state, owned by an NFSv4 owner
+ * @param pcontext [IN]    FSAL credentials of the operation adding the state
+ * @param add      [IN]    TRUE when the state is added, FALSE when deleted
+ *
+ */
+void nfs4_lease_state(state_t * pstate, fsal_op_context_t * pcontext, int add)
+{
+  nfs4_lease_t *please;
+
+  if(add)
+    {
+      pstate->state_lease_list.next = NULL;
+      pstate->state_lease_list.prev = NULL;
+
+      if(pstate->state_powner == NULL ||
+         pstate->state_powner->so_type != STATE_LOCK_OWNER_NFSV4)
+        return;
+    }
+
+  P(lease_mutex);
+
+  if(!add)
+    glist_del(&pstate->state_lease_list);
+  else if((please = nfs4_lease_lookup(pstate->state_powner->so_owner.so_nfs4_owner.so_clientid,
+                                      TRUE)) != NULL)
+    {
+      glist_add_tail(&please->states, &pstate->state_lease_list);
+
+      if(pcontext != NULL)
+        {
+          please->context = *pcontext;
+          please->has_context = TRUE;
+        }
+
+      nfs4_lease_touch(please, lease_clock(NULL));
+    }
+
+  V(lease_mutex);
+}                               /* nfs4_lease_state */
+
 /**
  *
- * nfs4_is_leased_expired
+ * nfs4_lease_owner: links an NFSv4 owner to the lease of its client, or unlinks it.
  *
- * This routine checks the availability of a lease to a cache_entry
+ * @param powner [INOUT] the owner
+ * @param add    [IN]    TRUE when the owner is created, FALSE when destroyed
  *
- * @param pstate [IN] pointer to the cache_entry to be checked.
+ */
+void nfs4_lease_owner(state_owner_t * powner, int add)
+{
+  nfs4_lease_t *please;
+
+  if(add)
+    {
+      powner->so_owner.so_nfs4_owner.so_lease_list.next = NULL;
+      powner->so_owner.so_nfs4_owner.so_lease_list.prev = NULL;
+    }
+
+  P(lease_mutex);
+
+  if(!add)
+    glist_del(&powner->so_owner.so_nfs4_owner.so_lease_list);
+  else if((please = nfs4_lease_lookup(powner->so_owner.so_nfs4_owner.so_clientid,
+                                      TRUE)) != NULL)
+    glist_add_tail(&please->owners, &powner->so_owner.so_nfs4_owner.so_lease_list);
+
+  V(lease_mutex);
+}                               /* nfs4_lease_owner */
+
+#ifdef _USE_NFS4_1
+/**
+ *
+ * nfs4_lease_session: links an NFSv4.1 session to the lease of its client, or unlinks it.
  *
- * @return 1 if expired, 0 otherwise.
+ * @param psession [INOUT] the session
+ * @param add      [IN]    TRUE when the session is created, FALSE when destroyed
  *
  */
-int nfs4_is_lease_expired(cache_entry_t * pentry)
+void nfs4_lease_session(nfs41_session_t * psession, int add)
 {
-  nfs_client_id_t nfs_clientid = {
-    .last_renew = 0
-  };
+  nfs4_lease_t *please;
 
-  if(pentry->internal_md.type != REGULAR_FILE)
-    return 0;
+  if(add)
+    {
+      psession->session_lease_list.next = NULL;
+      psession->session_lease_list.prev = NULL;
+    }
 
-#ifdef BUGAZOMEU
-  if(pentry->object.file.state_v4 == NULL)
-    return 0;
+  P(lease_mutex);
 
-  if(nfs_client_id_get(pentry->object.file.state_v4->clientid4, &nfs_clientid) !=
-     CLIENT_ID_SUCCESS)
-    return 0;                   /* No client id, manage it as non-expired */
+  if(!add)
+    glist_del(&psession->session_lease_list);
+  else if((please = nfs4_lease_lookup(psession->clientid, TRUE)) != NULL)
+    glist_add_tail(&please->sessions, &psession->session_lease_list);
 
-  LogFullDebug(COMPONENT_NFS_V4,
-               "Lease on %p for client_name = %s id=%lld",
-               pentry, nfs_clientid.client_name, nfs_clientid.clientid);
+  V(lease_mutex);
+}                               /* nfs4_lease_session */
+
+/* Unlinks the next session of an expired lease */
+static int nfs4_lease_next_session(nfs4_lease_t * please,
+                                   char sessionid[NFS4_SESSIONID_SIZE])
+{
+  nfs41_session_t *psession;
+  int found = FALSE;
 
-  LogFullDebug(COMPONENT_NFS_V4,
-               "--------- nfs4_is_lease_expired ---------> %u %u delta=%u lease=%u",
-               time(NULL), time(NULL), nfs_clientid.last_renew,
-               time(NULL) - nfs_clientid.last_renew, nfs_param.nfsv4_param.lease_lifetime);
+  P(lease_mutex);
+
+  if(!glist_empty(&please->sessions))
+    {
+      psession = glist_entry(please->sessions.next, nfs41_session_t, session_lease_list);
+      memcpy(sessionid, psession->session_id, NFS4_SESSIONID_SIZE);
+      glist_del(please->sessions.next);
+      found = TRUE;
+    }
+
+  V(lease_mutex);
+
+  return found;
+}                               /* nfs4_lease_next_session */
 #endif
 
-  /* Check is lease is still valid */
-  if(time(NULL) - nfs_clientid.last_renew > (int)nfs_param.nfsv4_param.lease_lifetime)
-    return 1;
-  else
-    return 0;
-}                               /* nfs4_is_lease_expired */
+/* Unlinks the next state of an expired lease, the locks before the others.
+ * The entry of the state is returned too: while the state is linked, it is
+ * not deleted yet, and deleting it takes the lock of this entry.
+ */
+static int nfs4_lease_next_state(nfs4_lease_t * please, int locks_only,
+                                 char other[OTHERSIZE], cache_entry_t ** ppentry)
+{
+  struct glist_head *glist;
+  state_t *pstate;
+  int found = FALSE;
+
+  P(lease_mutex);
+
+  glist_for_each(glist, &please->states)
+    {
+      pstate = glist_entry(glist, state_t, state_lease_list);
+
+      if(locks_only && pstate->state_type != STATE_TYPE_LOCK)
+        continue;
+
+      memcpy(other, pstate->stateid_other, OTHERSIZE);
+      *ppentry = pstate->state_pentry;
+      glist_del(glist);
+      found = TRUE;
+      break;
+    }
+
+  V(lease_mutex);
+
+  return found;
+}                               /* nfs4_lease_next_state */
+
+/* Unlinks the next owner of an expired lease */
+static int nfs4_lease_next_owner(nfs4_lease_t * please, state_nfs4_owner_name_t * pname)
+{
+  state_owner_t *powner;
+  int found = FALSE;
+
+  P(lease_mutex);
+
+  if(!glist_empty(&please->owners))
+    {
+      powner = glist_entry(please->owners.next, state_owner_t,
+                           so_owner.so_nfs4_owner.so_lease_list);
+
+      pname->son_clientid = powner->so_owner.so_nfs4_owner.so_clientid;
+      pname->son_owner_len = powner->so_owner_len;
+      if(pname->son_owner_len > MAXNAMLEN)
+        pname->son_owner_len = MAXNAMLEN;
+      memcpy(pname->son_owner_val, powner->so_owner_val, pname->son_owner_len);
+
+      glist_del(please->owners.next);
+      found = TRUE;
+    }
+
+  V(lease_mutex);
+
+  return found;
+}                               /* nfs4_lease_next_owner */
+
+/**
+ *
+ * nfs4_lease_release: releases the state of an expired client and forgets it.
+ *
+ * The locks are released first, then the opens and delegations, then the
+ * owners, the sessions and the client id. Each state is looked up again and
+ * released under the write lock of its entry, so that an operation of the
+ * client deleting it at the same time does not free it under the reaper.
+ *
+ * @param please        [INOUT] the expired lease, no longer in the hash
+ * @param pclient       [INOUT] cache inode client of the reaper
+ * @param clientid_pool [INOUT] pool the client id is released to
+ *
+ */
+static void nfs4_lease_release(nfs4_lease_t * please,
+                               cache_inode_client_t * pclient,
+                               struct prealloc_pool *clientid_pool)
+{
+  char other[OTHERSIZE];
+#ifdef _USE_NFS4_1
+  char sessionid[NFS4_SESSIONID_SIZE];
+  unsigned int nb_sessions = 0;
+#endif
+  state_nfs4_owner_name_t owner_name;
+  state_t *pstate;
+  cache_entry_t *pentry;
+  state_status_t state_status;
+  cache_inode_status_t cache_status;
+  unsigned int nb_states = 0, nb_owners = 0;
+  int locks_only;
+
+  for(locks_only = TRUE; locks_only >= FALSE; locks_only--)
+    while(nfs4_lease_next_state(please, locks_only, other, &pentry))
+      {
+        if(pentry == NULL)
+          continue;
+
+        P_w(&pentry->lock);
+
+        /* Deleted, or even reused for another entry, since it was unlinked */
+        if(!nfs4_State_Get_Pointer(other, &pstate) || pstate->state_pentry != pentry)
+          {
+            V_w(&pentry->lock);
+            continue;
+          }
+
+        switch (pstate->state_type)
+          {
+          case STATE_TYPE_LOCK:
+            if(please->has_context)
+              state_owner_unlock_all(&please->context, pstate->state_powner, pstate,
+                                     pclient, &state_status);
+            break;
+
+          case STATE_TYPE_SHARE:
+            cache_inode_close(pentry, pclient, &cache_status);
+            break;
+
+          default:
+            break;
+          }
+
+        if(state_del_no_mutex(pstate, pclient, &state_status) == STATE_SUCCESS)
+          nb_states++;
+
+        V_w(&pentry->lock);
+      }
+
+  while(nfs4_lease_next_owner(please, &owner_name))
+    if(destroy_nfs4_owner(pclient, &owner_name) == STATE_SUCCESS)
+      nb_owners++;
+
+#ifdef _USE_NFS4_1
+  while(nfs4_lease_next_session(please, sessionid))
+    if(nfs41_Session_Del(sessionid))
+      nb_sessions++;
+
+  if(nb_sessions > 0)
+    LogDebug(COMPONENT_STATE,
+             "%u sessions of client %"PRIx64" destroyed", nb_sessions, please->clientid);
+#endif
+
+  nfs_client_id_remove(please->clientid, clientid_pool);
+
+  LogEvent(COMPONENT_STATE,
+           "Lease of client %"PRIx64" expired, %u states and %u owners released",
+           please->clientid, nb_states, nb_owners);
+}                               /* nfs4_lease_release */
+
+/**
+ *
+ * nfs4_lease_reap: expires the leases whose deadline is reached.
+ *
+ * Called every second by the reaper thread. The expired clients are taken
+ * out of the hash at once, so that a late operation starts a new lease, then
+ * their state is released.
+ *
+ * @param pclient       [INOUT] cache inode client of the reaper
+ * @param clientid_pool [INOUT] pool the client ids are released to
+ *
+ * @return the number of expired clients.
+ *
+ */
+unsigned int nfs4_lease_reap(cache_inode_client_t * pclient,
+                             struct prealloc_pool *clientid_pool)
+{
+  struct glist_head expired;
+  struct glist_head *glist, *glistn;
+  nfs4_lease_t *please;
+  unsigned int nb_expired = 0;
+
+  init_glist(&expired);
+
+  P(lease_mutex);
+
+  nfs4_lease_advance(lease_clock(NULL), &expired);
+
+  glist_for_each(glist, &expired)
+    nfs4_lease_unhash(glist_entry(glist, nfs4_lease_t, wheel_list));
+
+  V(lease_mutex);
+
+  glist_for_each_safe(glist, glistn, &expired)
+    {
+      please = glist_entry(glist, nfs4_lease_t, wheel_list);
+      glist_del(glist);
+
+      nfs4_lease_release(please, pclient, clientid_pool);
+      Mem_Free(please);
+      nb_expired++;
+    }
+
+  if(nb_expired > 0)
+    LogDebug(COMPONENT_STATE,
+             "%u leases expired, %u clients left", nb_expired, lease_nb_clients);
+
+  return nb_expired;
+}                               /* nfs4_lease_reap */
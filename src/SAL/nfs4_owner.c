@@ -369,6 +369,9 @@ state_owner_t *create_nfs4_owner(cache_inode_client_t    * pclient,
       return NULL;
     }
 
+  nfs4_recovery_owner(powner, TRUE);
+  nfs4_lease_owner(powner, TRUE);
+
   return powner;
 }
 
@@ -393,6 +396,9 @@ state_status_t destroy_nfs4_owner(cache_inode_client_t    * pclient,
     {
       state_owner_t *powner = (state_owner_t *) old_value.pdata;
 
+      nfs4_recovery_owner(powner, FALSE);
+      nfs4_lease_owner(powner, FALSE);
+
       /* Release the owner_name (key) and owner (data) back to appropriate pools */
       nfs4_Compound_FreeOne(&powner->so_owner.so_nfs4_owner.so_resp);
       ReleaseToPool(old_value.pdata, &pclient->pool_state_owner);
@@ -0,0 +1,1032 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs4_recovery.c
+ * \brief   Journal of the NFSv4 clients and of their state, and grace period.
+ *
+ * nfs4_recovery.c : The confirmed client ids, the open and lock owners and
+ * the stateids are journaled in an append only file mapped in memory, so
+ * that after a restart the server knows which clients held state and only
+ * waits for them to reclaim it.
+ *
+ * The workers only append fixed size records to a staging buffer under a
+ * mutex; the recovery thread copies the buffer in the mapped file in
+ * batches and syncs it. Records staged since the last batch are lost on a
+ * crash, the clients they describe then do not get a grace period.
+ *
+ * The file is a header page followed by two halves. The records of the
+ * active half are checksummed with the generation of the header, whose
+ * parity gives the active half. When the active half is full, or at
+ * startup, the live clients are rewritten in the other half and the
+ * generation is then bumped, which is a single aligned store: a crash
+ * during compaction leaves the previous half valid.
+ *
+ * Each client is kept in memory with the number of owners and states it
+ * holds, a client still holding some at restart is expected to reclaim.
+ * The grace period lasts a lease, and ends as soon as all the expected
+ * clients have completed their reclaims. Without journal there is no
+ * grace period, as before.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs_core.h"
+#include "nfs4.h"
+#include "sal_functions.h"
+
+#define NFS4_RECOV_MAGIC     0x4e345243U        /* "N4RC" */
+#define NFS4_RECOV_VERSION   1
+#define NFS4_RECOV_HDR_SIZE  4096
+#define NFS4_RECOV_MIN_SIZE  (NFS4_RECOV_HDR_SIZE + 2 * 65536)
+
+#define NFS4_RECOV_STAGE_SIZE   65536
+#define NFS4_RECOV_HASH_SIZE    1021
+
+/* Record types */
+#define NFS4_RECOV_CLIENT        1      /* client confirmed, followed by its name */
+#define NFS4_RECOV_CLIENT_REMOVE 2      /* client removed with all its state */
+#define NFS4_RECOV_OWNER_ADD     3
+#define NFS4_RECOV_OWNER_DEL     4
+#define NFS4_RECOV_STATE_ADD     5
+#define NFS4_RECOV_STATE_DEL     6
+#define NFS4_RECOV_HOLD          7      /* compacted owner and state counts */
+#define NFS4_RECOV_CARRY         8      /* still expected from the previous run */
+#define NFS4_RECOV_RECLAIMED     9      /* reclaims completed */
+
+typedef struct nfs4_recov_header__
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t half_size;
+  uint64_t generation;          /* active half is generation & 1 */
+} nfs4_recov_header_t;
+
+typedef struct nfs4_recov_record__
+{
+  uint16_t type;
+  uint16_t len;                 /* whole record, multiple of 8 */
+  uint32_t checksum;
+  uint64_t clientid;
+  union
+  {
+    struct
+    {
+      uint64_t hash;
+      uint32_t is_lock;
+    } owner;
+    struct
+    {
+      char other[OTHERSIZE];
+      uint32_t type;
+    } state;
+    struct
+    {
+      uint32_t nb_owners;
+      uint32_t nb_states;
+    } hold;
+    char name[16];              /* actually len - 16 bytes */
+  } u;
+} nfs4_recov_record_t;
+
+#define NFS4_RECOV_RECORD_SIZE   sizeof(nfs4_recov_record_t)
+#define NFS4_RECOV_RECORD_HEAD   (sizeof(nfs4_recov_record_t) - 16)
+#define NFS4_RECOV_RECORD_MAX    ((NFS4_RECOV_RECORD_HEAD + NFS4_MAX_DOMAIN_LEN + 7) & ~7)
+
+/* A client known to the journal */
+typedef struct nfs4_recov_client__
+{
+  clientid4 clientid;
+  unsigned int nb_owners;
+  unsigned int nb_states;
+  int carried;                  /* expected to reclaim its state */
+  char name[NFS4_MAX_DOMAIN_LEN];
+  struct nfs4_recov_client__ *next;
+} nfs4_recov_client_t;
+
+static int recov_enabled = FALSE;
+static int recov_fd = -1;
+static char *recov_map = NULL;
+static size_t recov_map_size = 0;
+static nfs4_recov_header_t *recov_header = NULL;
+static uint64_t recov_tail = 0;         /* end of the records of the active half */
+
+static pthread_mutex_t recov_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t recov_flush_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t recov_room_cond = PTHREAD_COND_INITIALIZER;
+
+static char *recov_stage = NULL;        /* records not yet in the file */
+static char *recov_batch = NULL;        /* records being written by the flusher */
+static size_t recov_stage_len = 0;
+static int recov_compact_wanted = FALSE;
+
+static nfs4_recov_client_t *recov_clients[NFS4_RECOV_HASH_SIZE];
+static unsigned int recov_nb_clients = 0;
+
+static int recov_grace = FALSE;
+static time_t recov_grace_end = 0;
+static unsigned int recov_nb_expected = 0;
+
+static uint32_t nfs4_recovery_checksum(uint64_t generation, nfs4_recov_record_t * prec)
+{
+  uint32_t hash = 2166136261U;
+  unsigned char *p;
+  unsigned int i;
+
+  p = (unsigned char *)&generation;
+  for(i = 0; i < sizeof(generation); i++)
+    hash = (hash ^ p[i]) * 16777619U;
+
+  p = (unsigned char *)prec;
+  for(i = 0; i < prec->len; i++)
+    {
+      /* the checksum field counts as zero */
+      if(i >= offsetof(nfs4_recov_record_t, checksum)
+         && i < offsetof(nfs4_recov_record_t, checksum) + sizeof(uint32_t))
+        hash = hash * 16777619U;
+      else
+        hash = (hash ^ p[i]) * 16777619U;
+    }
+
+  return hash;
+}                               /* nfs4_recovery_checksum */
+
+static uint64_t nfs4_recovery_owner_hash(char *owner_val, unsigned int owner_len)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  unsigned int i;
+
+  for(i = 0; i < owner_len; i++)
+    hash = (hash ^ (unsigned char)owner_val[i]) * 1099511628211ULL;
+
+  return hash;
+}                               /* nfs4_recovery_owner_hash */
+
+static nfs4_recov_client_t *nfs4_recovery_lookup(clientid4 clientid, int create)
+{
+  nfs4_recov_client_t *pclient;
+  unsigned int bucket = (unsigned int)(clientid % NFS4_RECOV_HASH_SIZE);
+
+  for(pclient = recov_clients[bucket]; pclient != NULL; pclient = pclient->next)
+    if(pclient->clientid == clientid)
+      return pclient;
+
+  if(!create)
+    return NULL;
+
+  pclient = (nfs4_recov_client_t *) Mem_Calloc_Label(1, sizeof(nfs4_recov_client_t),
+                                                     "nfs4_recov_client_t");
+  if(pclient == NULL)
+    return NULL;
+
+  pclient->clientid = clientid;
+  pclient->next = recov_clients[bucket];
+  recov_clients[bucket] = pclient;
+  recov_nb_clients += 1;
+
+  return pclient;
+}                               /* nfs4_recovery_lookup */
+
+static void nfs4_recovery_forget(clientid4 clientid)
+{
+  nfs4_recov_client_t **ppclient;
+  nfs4_recov_client_t *pclient;
+
+  for(ppclient = &recov_clients[clientid % NFS4_RECOV_HASH_SIZE];
+      (pclient = *ppclient) != NULL; ppclient = &pclient->next)
+    if(pclient->clientid == clientid)
+      {
+        *ppclient = pclient->next;
+        Mem_Free(pclient);
+        recov_nb_clients -= 1;
+        return;
+      }
+}                               /* nfs4_recovery_forget */
+
+/**
+ *
+ * nfs4_recovery_fill: builds a record.
+ *
+ * Fills the record and rounds its length up to 8 bytes. The checksum is set
+ * when the record is written to the file, the generation is known then.
+ *
+ * @param prec     [OUT] record to fill, NFS4_RECOV_RECORD_MAX bytes
+ * @param type     [IN]  record type
+ * @param clientid [IN]  client the record is about
+ * @param name     [IN]  client name for NFS4_RECOV_CLIENT, NULL otherwise
+ *
+ * @return the length of the record.
+ *
+ */
+static unsigned int nfs4_recovery_fill(nfs4_recov_record_t * prec, uint16_t type,
+                                       clientid4 clientid, char *name)
+{
+  unsigned int name_len;
+
+  memset(prec, 0, NFS4_RECOV_RECORD_SIZE);
+  prec->type = type;
+  prec->clientid = clientid;
+  prec->len = NFS4_RECOV_RECORD_SIZE;
+
+  if(name != NULL)
+    {
+      name_len = strnlen(name, NFS4_MAX_DOMAIN_LEN - 1);
+      memset(prec->u.name, 0, (name_len + 8) & ~7);
+      memcpy(prec->u.name, name, name_len);
+      prec->len = NFS4_RECOV_RECORD_HEAD + ((name_len + 8) & ~7);
+      if(prec->len < NFS4_RECOV_RECORD_SIZE)
+        prec->len = NFS4_RECOV_RECORD_SIZE;
+    }
+
+  return prec->len;
+}                               /* nfs4_recovery_fill */
+
+/* Appends a record to the staging buffer, recov_mutex held */
+static void nfs4_recovery_stage(nfs4_recov_record_t * prec)
+{
+  while(recov_enabled && recov_stage_len + prec->len > NFS4_RECOV_STAGE_SIZE)
+    {
+      pthread_cond_signal(&recov_flush_cond);
+      pthread_cond_wait(&recov_room_cond, &recov_mutex);
+    }
+
+  if(!recov_enabled)
+    return;
+
+  memcpy(recov_stage + recov_stage_len, prec, prec->len);
+  recov_stage_len += prec->len;
+
+  if(recov_stage_len > NFS4_RECOV_STAGE_SIZE / 2)
+    pthread_cond_signal(&recov_flush_cond);
+}                               /* nfs4_recovery_stage */
+
+/**
+ *
+ * nfs4_recovery_write: writes records at the end of a half.
+ *
+ * Only called by the flusher, and at init. The records are checksummed with
+ * the generation of the half they are written to.
+ *
+ * @param generation [IN] generation of the half, its parity gives the half
+ * @param records    [IN] records to write
+ * @param len        [IN] their length
+ *
+ * @return 0 if written, -1 if the half is full.
+ *
+ */
+static int nfs4_recovery_write(uint64_t generation, char *records, size_t len)
+{
+  char *half;
+  char *dest;
+  nfs4_recov_record_t *prec;
+  size_t off, start;
+  long pagesize = sysconf(_SC_PAGESIZE);
+
+  if(recov_tail + len > recov_header->half_size)
+    return -1;
+
+  half = recov_map + NFS4_RECOV_HDR_SIZE
+      + (generation & 1) * recov_header->half_size;
+  dest = half + recov_tail;
+
+  memcpy(dest, records, len);
+  for(off = 0; off < len; off += prec->len)
+    {
+      prec = (nfs4_recov_record_t *) (dest + off);
+      prec->checksum = nfs4_recovery_checksum(generation, prec);
+    }
+
+  start = ((size_t) (dest - recov_map)) & ~(pagesize - 1);
+  if(msync(recov_map + start, (dest - recov_map) + len - start, MS_SYNC) != 0)
+    LogCrit(COMPONENT_STATE,
+            "NFS4 RECOVERY : msync of the journal failed, errno=%u", errno);
+
+  recov_tail += len;
+  return 0;
+}                               /* nfs4_recovery_write */
+
+/**
+ *
+ * nfs4_recovery_compact: rewrites the live clients in the other half.
+ *
+ * Builds a CLIENT record and a HOLD or CARRY record for each client, writes
+ * them at the start of the inactive half, then switches the halves. The
+ * caller holds recov_mutex: the staged records are dropped, the client
+ * table already accounts for them.
+ *
+ * @return 0 if successful, -1 if the clients do not fit in a half.
+ *
+ */
+static int nfs4_recovery_compact(void)
+{
+  nfs4_recov_client_t *pclient;
+  nfs4_recov_record_t *prec;
+  char *buffer;
+  size_t len = 0;
+  size_t max = recov_nb_clients * (NFS4_RECOV_RECORD_MAX + NFS4_RECOV_RECORD_SIZE);
+  unsigned int i;
+  int rc;
+
+  if(max > recov_header->half_size)
+    return -1;
+
+  if((buffer = (char *)Mem_Alloc_Label(max + 1, "nfs4_recov_compact")) == NULL)
+    return -1;
+
+  for(i = 0; i < NFS4_RECOV_HASH_SIZE; i++)
+    for(pclient = recov_clients[i]; pclient != NULL; pclient = pclient->next)
+      {
+        prec = (nfs4_recov_record_t *) (buffer + len);
+        len += nfs4_recovery_fill(prec, NFS4_RECOV_CLIENT, pclient->clientid,
+                                  pclient->name);
+
+        prec = (nfs4_recov_record_t *) (buffer + len);
+        if(pclient->carried)
+          len += nfs4_recovery_fill(prec, NFS4_RECOV_CARRY, pclient->clientid, NULL);
+        else if(pclient->nb_owners != 0 || pclient->nb_states != 0)
+          {
+            len += nfs4_recovery_fill(prec, NFS4_RECOV_HOLD, pclient->clientid, NULL);
+            prec->u.hold.nb_owners = pclient->nb_owners;
+            prec->u.hold.nb_states = pclient->nb_states;
+          }
+      }
+
+  /* Write in the inactive half, then make it the active one */
+  recov_tail = 0;
+  rc = nfs4_recovery_write(recov_header->generation + 1, buffer, len);
+
+  if(rc == 0)
+    {
+      recov_header->generation += 1;
+      if(msync(recov_map, NFS4_RECOV_HDR_SIZE, MS_SYNC) != 0)
+        LogCrit(COMPONENT_STATE,
+                "NFS4 RECOVERY : msync of the journal header failed, errno=%u", errno);
+    }
+
+  recov_stage_len = 0;
+  recov_compact_wanted = FALSE;
+  pthread_cond_broadcast(&recov_room_cond);
+
+  Mem_Free(buffer);
+
+  LogDebug(COMPONENT_STATE,
+           "NFS4 RECOVERY : journal compacted, %u clients in %llu bytes",
+           recov_nb_clients, (unsigned long long)len);
+
+  return rc;
+}                               /* nfs4_recovery_compact */
+
+/* Applies a record from the file to the client table, at replay */
+static void nfs4_recovery_replay_one(nfs4_recov_record_t * prec)
+{
+  nfs4_recov_client_t *pclient;
+  unsigned int name_len;
+
+  if(prec->type == NFS4_RECOV_CLIENT_REMOVE)
+    {
+      nfs4_recovery_forget(prec->clientid);
+      return;
+    }
+
+  if((pclient = nfs4_recovery_lookup(prec->clientid, TRUE)) == NULL)
+    return;
+
+  switch (prec->type)
+    {
+    case NFS4_RECOV_CLIENT:
+      name_len = prec->len - NFS4_RECOV_RECORD_HEAD;
+      if(name_len > NFS4_MAX_DOMAIN_LEN - 1)
+        name_len = NFS4_MAX_DOMAIN_LEN - 1;
+      memset(pclient->name, 0, NFS4_MAX_DOMAIN_LEN);
+      memcpy(pclient->name, prec->u.name, name_len);
+      break;
+
+    case NFS4_RECOV_OWNER_ADD:
+      pclient->nb_owners += 1;
+      break;
+
+    case NFS4_RECOV_OWNER_DEL:
+      if(pclient->nb_owners > 0)
+        pclient->nb_owners -= 1;
+      break;
+
+    case NFS4_RECOV_STATE_ADD:
+      pclient->nb_states += 1;
+      break;
+
+    case NFS4_RECOV_STATE_DEL:
+      if(pclient->nb_states > 0)
+        pclient->nb_states -= 1;
+      break;
+
+    case NFS4_RECOV_HOLD:
+      pclient->nb_owners = prec->u.hold.nb_owners;
+      pclient->nb_states = prec->u.hold.nb_states;
+      break;
+
+    case NFS4_RECOV_CARRY:
+      pclient->carried = TRUE;
+      break;
+
+    case NFS4_RECOV_RECLAIMED:
+      pclient->carried = FALSE;
+      break;
+    }
+}                               /* nfs4_recovery_replay_one */
+
+/**
+ *
+ * nfs4_recovery_replay: rebuilds the client table from the active half.
+ *
+ * Reads the records until the first one whose checksum does not match,
+ * which is the end of the journal or a record torn by a crash.
+ *
+ * @return the number of records replayed.
+ *
+ */
+static unsigned int nfs4_recovery_replay(void)
+{
+  char *half = recov_map + NFS4_RECOV_HDR_SIZE
+      + (recov_header->generation & 1) * recov_header->half_size;
+  nfs4_recov_record_t *prec;
+  unsigned int nb_records = 0;
+
+  recov_tail = 0;
+  while(recov_tail + NFS4_RECOV_RECORD_SIZE <= recov_header->half_size)
+    {
+      prec = (nfs4_recov_record_t *) (half + recov_tail);
+
+      if(prec->len < NFS4_RECOV_RECORD_SIZE || prec->len > NFS4_RECOV_RECORD_MAX
+         || (prec->len & 7) != 0 || recov_tail + prec->len > recov_header->half_size
+         || prec->checksum != nfs4_recovery_checksum(recov_header->generation, prec))
+        break;
+
+      nfs4_recovery_replay_one(prec);
+      recov_tail += prec->len;
+      nb_records += 1;
+    }
+
+  return nb_records;
+}                               /* nfs4_recovery_replay */
+
+/**
+ *
+ * nfs4_recovery_open: maps the journal file, creating it if needed.
+ *
+ * @param path [IN] path of the journal
+ * @param size [IN] size of the file
+ *
+ * @return 0 if successful, -1 otherwise.
+ *
+ */
+static int nfs4_recovery_open(char *path, size_t size)
+{
+  struct stat st;
+  int created = FALSE;
+
+  if((recov_fd = open(path, O_RDWR | O_CREAT, 0600)) < 0)
+    {
+      LogCrit(COMPONENT_STATE,
+              "NFS4 RECOVERY : could not open journal %s, errno=%u (%s)",
+              path, errno, strerror(errno));
+      return -1;
+    }
+
+  if(fstat(recov_fd, &st) != 0)
+    goto err;
+
+  /* An existing journal keeps the size it was created with */
+  if(st.st_size >= NFS4_RECOV_MIN_SIZE)
+    size = st.st_size;
+  else
+    {
+      created = TRUE;
+      if(ftruncate(recov_fd, size) != 0)
+        goto err;
+    }
+
+  recov_map = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, recov_fd, 0);
+  if(recov_map == MAP_FAILED)
+    {
+      recov_map = NULL;
+      goto err;
+    }
+  recov_map_size = size;
+  recov_header = (nfs4_recov_header_t *) recov_map;
+
+  if(!created
+     && (recov_header->magic != NFS4_RECOV_MAGIC
+         || recov_header->version != NFS4_RECOV_VERSION
+         || NFS4_RECOV_HDR_SIZE + 2 * recov_header->half_size > size))
+    {
+      LogCrit(COMPONENT_STATE,
+              "NFS4 RECOVERY : %s is not a valid journal, starting a new one", path);
+      created = TRUE;
+    }
+
+  if(created)
+    {
+      memset(recov_map, 0, NFS4_RECOV_HDR_SIZE);
+      recov_header->magic = NFS4_RECOV_MAGIC;
+      recov_header->version = NFS4_RECOV_VERSION;
+      recov_header->half_size = ((size - NFS4_RECOV_HDR_SIZE) / 2) & ~((uint64_t) 7);
+      recov_header->generation = 2;
+      /* the first record must not look valid */
+      memset(recov_map + NFS4_RECOV_HDR_SIZE, 0, NFS4_RECOV_RECORD_SIZE);
+      msync(recov_map, NFS4_RECOV_HDR_SIZE + NFS4_RECOV_RECORD_SIZE, MS_SYNC);
+    }
+
+  return 0;
+
+ err:
+  LogCrit(COMPONENT_STATE,
+          "NFS4 RECOVERY : could not map journal %s, errno=%u (%s)",
+          path, errno, strerror(errno));
+  close(recov_fd);
+  recov_fd = -1;
+  return -1;
+}                               /* nfs4_recovery_open */
+
+/**
+ *
+ * nfs4_recovery_init: replays the journal and starts the grace period.
+ *
+ * The clients that held owners or states when the server stopped, or that
+ * had not reclaimed theirs after a previous restart, are expected to
+ * reclaim. The journal is compacted to them, and the grace period started
+ * if there are any.
+ *
+ * @param path [IN] path of the journal, an empty string disables it
+ * @param size [IN] size of a new journal
+ *
+ * @return 0 if successful, -1 if the server goes on without journal.
+ *
+ */
+int nfs4_recovery_init(char *path, size_t size)
+{
+  nfs4_recov_client_t *pclient;
+  nfs4_recov_client_t **ppclient;
+  unsigned int nb_records;
+  unsigned int i;
+
+  if(path == NULL || path[0] == '\0')
+    {
+      LogEvent(COMPONENT_STATE, "NFS4 RECOVERY : no journal, no grace period");
+      return 0;
+    }
+
+  if(size < NFS4_RECOV_MIN_SIZE)
+    size = NFS4_RECOV_MIN_SIZE;
+
+  if(nfs4_recovery_open(path, size) != 0)
+    return -1;
+
+  recov_stage = (char *)Mem_Alloc_Label(NFS4_RECOV_STAGE_SIZE, "nfs4_recov_stage");
+  recov_batch = (char *)Mem_Alloc_Label(NFS4_RECOV_STAGE_SIZE, "nfs4_recov_stage");
+  if(recov_stage == NULL || recov_batch == NULL)
+    {
+      LogCrit(COMPONENT_STATE, "NFS4 RECOVERY : could not allocate the staging buffers");
+      return -1;
+    }
+
+  nb_records = nfs4_recovery_replay();
+
+  /* Keep only the clients that have something to reclaim */
+  for(i = 0; i < NFS4_RECOV_HASH_SIZE; i++)
+    for(ppclient = &recov_clients[i]; (pclient = *ppclient) != NULL;)
+      {
+        if(pclient->carried || pclient->nb_owners != 0 || pclient->nb_states != 0)
+          {
+            LogDebug(COMPONENT_STATE,
+                     "NFS4 RECOVERY : expecting client %s id=%"PRIx64" (%u owners, %u states)",
+                     pclient->name, pclient->clientid, pclient->nb_owners,
+                     pclient->nb_states);
+            pclient->carried = TRUE;
+            pclient->nb_owners = 0;
+            pclient->nb_states = 0;
+            recov_nb_expected += 1;
+            ppclient = &pclient->next;
+          }
+        else
+          {
+            *ppclient = pclient->next;
+            Mem_Free(pclient);
+            recov_nb_clients -= 1;
+          }
+      }
+
+  recov_enabled = TRUE;
+
+  if(nfs4_recovery_compact() != 0)
+    {
+      LogCrit(COMPONENT_STATE,
+              "NFS4 RECOVERY : journal %s is too small for %u clients",
+              path, recov_nb_clients);
+      recov_enabled = FALSE;
+      return -1;
+    }
+
+  if(recov_nb_expected > 0)
+    {
+      recov_grace = TRUE;
+      recov_grace_end = time(NULL) + nfs_param.nfsv4_param.lease_lifetime;
+    }
+
+  LogEvent(COMPONENT_STATE,
+           "NFS4 RECOVERY : journal %s replayed (%u records), %u clients expected, grace period %s",
+           path, nb_records, recov_nb_expected, recov_grace ? "started" : "not needed");
+
+  return 0;
+}                               /* nfs4_recovery_init */
+
+int nfs4_recovery_enabled(void)
+{
+  return recov_enabled;
+}                               /* nfs4_recovery_enabled */
+
+/* Ends the grace period, recov_mutex held */
+static void nfs4_recovery_end_grace(void)
+{
+  nfs4_recov_client_t *pclient;
+  unsigned int nb_dropped = 0;
+  unsigned int i;
+
+  recov_grace = FALSE;
+
+  /* The clients that did not come back lose their state. Compacting rather
+   * than staging a record for each of them keeps the flusher, which may be
+   * the caller, from waiting for room in the staging buffer */
+  for(i = 0; i < NFS4_RECOV_HASH_SIZE; i++)
+    for(pclient = recov_clients[i]; pclient != NULL; pclient = pclient->next)
+      if(pclient->carried)
+        {
+          pclient->carried = FALSE;
+          nb_dropped += 1;
+        }
+
+  recov_nb_expected = 0;
+
+  if(nb_dropped > 0)
+    {
+      recov_compact_wanted = TRUE;
+      pthread_cond_signal(&recov_flush_cond);
+    }
+
+  LogEvent(COMPONENT_STATE,
+           "NFS4 RECOVERY : grace period ended, %u clients did not reclaim", nb_dropped);
+}                               /* nfs4_recovery_end_grace */
+
+/**
+ *
+ * nfs4_recovery_in_grace: tells if the server is in its grace period.
+ *
+ * @return TRUE during the grace period, FALSE otherwise.
+ *
+ */
+int nfs4_recovery_in_grace(void)
+{
+  int grace;
+
+  if(!recov_grace)
+    return FALSE;
+
+  P(recov_mutex);
+  if(recov_grace && time(NULL) >= recov_grace_end)
+    nfs4_recovery_end_grace();
+  grace = recov_grace;
+  V(recov_mutex);
+
+  return grace;
+}                               /* nfs4_recovery_in_grace */
+
+/**
+ *
+ * nfs4_recovery_check_reclaim: checks an OPEN or a LOCK against the grace period.
+ *
+ * During the grace period only the reclaims of the expected clients are
+ * allowed, afterwards there is nothing left to reclaim.
+ *
+ * @param clientid [IN] client doing the operation
+ * @param reclaim  [IN] TRUE for CLAIM_PREVIOUS opens and reclaim locks
+ *
+ * @return NFS4_OK, NFS4ERR_GRACE or NFS4ERR_NO_GRACE.
+ *
+ */
+nfsstat4 nfs4_recovery_check_reclaim(clientid4 clientid, bool_t reclaim)
+{
+  nfs4_recov_client_t *pclient;
+  nfsstat4 status = NFS4_OK;
+
+  if(!nfs4_recovery_in_grace())
+    return reclaim && recov_enabled ? NFS4ERR_NO_GRACE : NFS4_OK;
+
+  P(recov_mutex);
+
+  if(!recov_grace)
+    status = reclaim ? NFS4ERR_NO_GRACE : NFS4_OK;
+  else if(!reclaim)
+    status = NFS4ERR_GRACE;
+  else if((pclient = nfs4_recovery_lookup(clientid, FALSE)) == NULL || !pclient->carried)
+    status = NFS4ERR_NO_GRACE;
+
+  V(recov_mutex);
+
+  if(status != NFS4_OK)
+    LogDebug(COMPONENT_STATE,
+             "NFS4 RECOVERY : %s by client id=%"PRIx64" refused, status=%u",
+             reclaim ? "reclaim" : "non reclaim operation", clientid, status);
+
+  return status;
+}                               /* nfs4_recovery_check_reclaim */
+
+/**
+ *
+ * nfs4_recovery_reclaim_complete: a client is done reclaiming.
+ *
+ * The grace period ends when the last expected client is done.
+ *
+ * @param clientid [IN] client done reclaiming
+ *
+ */
+void nfs4_recovery_reclaim_complete(clientid4 clientid)
+{
+  nfs4_recov_client_t *pclient;
+  nfs4_recov_record_t rec;
+
+  if(!recov_grace)
+    return;
+
+  P(recov_mutex);
+
+  if(recov_grace && (pclient = nfs4_recovery_lookup(clientid, FALSE)) != NULL
+     && pclient->carried)
+    {
+      pclient->carried = FALSE;
+      nfs4_recovery_fill(&rec, NFS4_RECOV_RECLAIMED, clientid, NULL);
+      nfs4_recovery_stage(&rec);
+
+      LogDebug(COMPONENT_STATE,
+               "NFS4 RECOVERY : client %s id=%"PRIx64" reclaimed, %u clients left",
+               pclient->name, clientid, recov_nb_expected - 1);
+
+      if(--recov_nb_expected == 0)
+        nfs4_recovery_end_grace();
+    }
+
+  V(recov_mutex);
+}                               /* nfs4_recovery_reclaim_complete */
+
+/**
+ *
+ * nfs4_recovery_client_confirm: journals a confirmed client id.
+ *
+ * @param clientid [IN] confirmed client id
+ * @param name     [IN] client name
+ *
+ */
+void nfs4_recovery_client_confirm(clientid4 clientid, char *name)
+{
+  nfs4_recov_client_t *pclient;
+  char buffer[NFS4_RECOV_RECORD_MAX];
+
+  if(!recov_enabled)
+    return;
+
+  P(recov_mutex);
+
+  if((pclient = nfs4_recovery_lookup(clientid, TRUE)) != NULL)
+    strncpy(pclient->name, name, NFS4_MAX_DOMAIN_LEN - 1);
+
+  nfs4_recovery_fill((nfs4_recov_record_t *) buffer, NFS4_RECOV_CLIENT, clientid, name);
+  nfs4_recovery_stage((nfs4_recov_record_t *) buffer);
+
+  V(recov_mutex);
+}                               /* nfs4_recovery_client_confirm */
+
+/**
+ *
+ * nfs4_recovery_client_remove: journals the removal of a client.
+ *
+ * @param clientid [IN] removed client id
+ *
+ */
+void nfs4_recovery_client_remove(clientid4 clientid)
+{
+  nfs4_recov_client_t *pclient;
+  nfs4_recov_record_t rec;
+
+  if(!recov_enabled)
+    return;
+
+  P(recov_mutex);
+
+  if((pclient = nfs4_recovery_lookup(clientid, FALSE)) != NULL)
+    {
+      if(pclient->carried && --recov_nb_expected == 0 && recov_grace)
+        nfs4_recovery_end_grace();
+      nfs4_recovery_forget(clientid);
+    }
+
+  nfs4_recovery_fill(&rec, NFS4_RECOV_CLIENT_REMOVE, clientid, NULL);
+  nfs4_recovery_stage(&rec);
+
+  V(recov_mutex);
+}                               /* nfs4_recovery_client_remove */
+
+/**
+ *
+ * nfs4_recovery_owner: journals the creation or destruction of an owner.
+ *
+ * @param powner [IN] the NFSv4 open or lock owner
+ * @param add    [IN] TRUE when created, FALSE when destroyed
+ *
+ */
+void nfs4_recovery_owner(state_owner_t * powner, int add)
+{
+  nfs4_recov_client_t *pclient;
+  nfs4_recov_record_t rec;
+  clientid4 clientid = powner->so_owner.so_nfs4_owner.so_clientid;
+
+  if(!recov_enabled)
+    return;
+
+  nfs4_recovery_fill(&rec, add ? NFS4_RECOV_OWNER_ADD : NFS4_RECOV_OWNER_DEL, clientid,
+                     NULL);
+  rec.u.owner.hash = nfs4_recovery_owner_hash(powner->so_owner_val, powner->so_owner_len);
+  rec.u.owner.is_lock = powner->so_owner.so_nfs4_owner.so_related_owner != NULL;
+
+  P(recov_mutex);
+
+  if((pclient = nfs4_recovery_lookup(clientid, TRUE)) != NULL)
+    {
+      if(add)
+        pclient->nb_owners += 1;
+      else if(pclient->nb_owners > 0)
+        pclient->nb_owners -= 1;
+    }
+
+  nfs4_recovery_stage(&rec);
+
+  V(recov_mutex);
+}                               /* nfs4_recovery_owner */
+
+/**
+ *
+ * nfs4_recovery_state: journals the creation or deletion of a stateid.
+ *
+ * @param pstate [IN] the state, with its owner
+ * @param add    [IN] TRUE when added, FALSE when deleted
+ *
+ */
+void nfs4_recovery_state(state_t * pstate, int add)
+{
+  nfs4_recov_client_t *pclient;
+  nfs4_recov_record_t rec;
+  clientid4 clientid;
+
+  if(!recov_enabled || pstate->state_powner == NULL)
+    return;
+
+  clientid = pstate->state_powner->so_owner.so_nfs4_owner.so_clientid;
+
+  nfs4_recovery_fill(&rec, add ? NFS4_RECOV_STATE_ADD : NFS4_RECOV_STATE_DEL, clientid,
+                     NULL);
+  memcpy(rec.u.state.other, pstate->stateid_other, OTHERSIZE);
+  rec.u.state.type = pstate->state_type;
+
+  P(recov_mutex);
+
+  if((pclient = nfs4_recovery_lookup(clientid, TRUE)) != NULL)
+    {
+      if(add)
+        pclient->nb_states += 1;
+      else if(pclient->nb_states > 0)
+        pclient->nb_states -= 1;
+    }
+
+  nfs4_recovery_stage(&rec);
+
+  V(recov_mutex);
+}                               /* nfs4_recovery_state */
+
+/**
+ *
+ * nfs4_recovery_wait: waits for records to flush.
+ *
+ * Returns when the staging buffer is half full, or after delay seconds.
+ *
+ * @param delay [IN] maximum wait in seconds
+ *
+ */
+void nfs4_recovery_wait(unsigned int delay)
+{
+  struct timeval now;
+  struct timespec timeout;
+
+  gettimeofday(&now, NULL);
+  timeout.tv_sec = now.tv_sec + delay;
+  timeout.tv_nsec = now.tv_usec * 1000;
+
+  P(recov_mutex);
+  if(recov_stage_len <= NFS4_RECOV_STAGE_SIZE / 2)
+    pthread_cond_timedwait(&recov_flush_cond, &recov_mutex, &timeout);
+  V(recov_mutex);
+}                               /* nfs4_recovery_wait */
+
+/**
+ *
+ * nfs4_recovery_flush: writes the staged records to the journal.
+ *
+ * Called by the recovery thread. Compacts the journal when its active half
+ * is full, and ends the grace period when it times out.
+ *
+ * @return the number of bytes written.
+ *
+ */
+size_t nfs4_recovery_flush(void)
+{
+  size_t len;
+  char *batch;
+
+  if(!recov_enabled)
+    return 0;
+
+  nfs4_recovery_in_grace();
+
+  P(recov_mutex);
+
+  if(recov_compact_wanted)
+    {
+      /* Rewrites the clients, which include what was staged */
+      if(nfs4_recovery_compact() != 0)
+        {
+          LogCrit(COMPONENT_STATE,
+                  "NFS4 RECOVERY : journal too small for %u clients, journaling stopped",
+                  recov_nb_clients);
+          recov_enabled = FALSE;
+          pthread_cond_broadcast(&recov_room_cond);
+        }
+      V(recov_mutex);
+      return 0;
+    }
+
+  /* Take the staged records, the workers go on staging in the other buffer */
+  batch = recov_stage;
+  len = recov_stage_len;
+  recov_stage = recov_batch;
+  recov_batch = batch;
+  recov_stage_len = 0;
+  pthread_cond_broadcast(&recov_room_cond);
+
+  V(recov_mutex);
+
+  if(len == 0)
+    return 0;
+
+  if(nfs4_recovery_write(recov_header->generation, batch, len) != 0)
+    {
+      /* The half is full: compaction at the next pass */
+      P(recov_mutex);
+      recov_compact_wanted = TRUE;
+      pthread_cond_signal(&recov_flush_cond);
+      V(recov_mutex);
+      return 0;
+    }
+
+  return len;
+}                               /* nfs4_recovery_flush */
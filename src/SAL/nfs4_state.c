@@ -89,6 +89,14 @@ int state_conflict(state_t      * pstate,
              (pstate->state_data.share.share_deny & pstate_data->share.share_access))
             return TRUE;
         }
+      else if(pstate->state_type == STATE_TYPE_DELEG && !pstate->state_data.deleg.d_revoked)
+        {
+          /* A read delegation lets its holder read and cache without asking */
+          if((pstate_data->share.share_access & OPEN4_SHARE_ACCESS_WRITE) ||
+             (pstate_data->share.share_deny & OPEN4_SHARE_DENY_READ) ||
+             pstate->state_data.deleg.d_type == OPEN_DELEGATE_WRITE)
+            return TRUE;
+        }
       return FALSE;
 
     case STATE_TYPE_LOCK:
@@ -98,8 +106,20 @@ int state_conflict(state_t      * pstate,
       return FALSE;              /** @todo No conflict management on layout for now */
 
     case STATE_TYPE_DELEG:
-      /* Not yet implemented for now, answer TRUE to avoid weird behavior */
-      return TRUE;
+      if(pstate->state_type == STATE_TYPE_SHARE)
+        {
+          if((pstate->state_data.share.share_access & OPEN4_SHARE_ACCESS_WRITE) ||
+             (pstate->state_data.share.share_deny & OPEN4_SHARE_DENY_READ) ||
+             pstate_data->deleg.d_type == OPEN_DELEGATE_WRITE)
+            return TRUE;
+        }
+      else if(pstate->state_type == STATE_TYPE_DELEG && !pstate->state_data.deleg.d_revoked)
+        {
+          if(pstate->state_data.deleg.d_type == OPEN_DELEGATE_WRITE ||
+             pstate_data->deleg.d_type == OPEN_DELEGATE_WRITE)
+            return TRUE;
+        }
+      return FALSE;
     }
 
   return TRUE;
@@ -138,6 +158,7 @@ state_status_t state_add(cache_entry_t         * pentry,
   state_owner_t      * powner = powner_input;
   char                 debug_str[OTHERSIZE * 2 + 1];
   bool_t               conflict_found = FALSE;
+  bool_t               deleg_conflict = FALSE;
 
   /* Sanity Check */
   if(pstatus == NULL)
@@ -210,11 +231,38 @@ state_status_t state_add(cache_entry_t         * pentry,
         {
           if(state_conflict(piter_state, state_type, pstate_data))
             {
+              /* Delegations are recalled rather than opposed to the new state */
+              if(piter_state->state_type == STATE_TYPE_DELEG &&
+                 state_type != STATE_TYPE_DELEG)
+                {
+                  deleg_conflict = TRUE;
+                  continue;
+                }
+
               conflict_found = TRUE;
               break;
             }
         }
 
+      /* Recall the delegations of the other clients, the new state will wait for them */
+      if(conflict_found == FALSE && deleg_conflict == TRUE &&
+         state_deleg_recall_conflicts(pentry,
+                                      (powner->so_type == STATE_LOCK_OWNER_NFSV4) ?
+                                      powner->so_owner.so_nfs4_owner.so_clientid : 0,
+                                      state_type, pstate_data) != 0)
+        {
+          LogDebug(COMPONENT_STATE,
+                   "new state has to wait for delegations of pentry %p to be returned",
+                   pentry);
+          *pstatus = STATE_DELEG_RECALLED;
+
+          ReleaseToPool(pnew_state, &pclient->pool_state_v4);
+
+          V_w(&pentry->lock);
+
+          return *pstatus;
+        }
+
       /* An error is to be returned if a conflict is found */
       if(conflict_found == TRUE)
         {
@@ -282,6 +330,9 @@ state_status_t state_add(cache_entry_t         * pentry,
       return *pstatus;
     }
 
+  nfs4_recovery_state(pnew_state, TRUE);
+  nfs4_lease_state(pnew_state, pcontext, TRUE);
+
   /* Copy the result */
   *ppstate = pnew_state;
 
@@ -388,6 +439,9 @@ state_status_t state_del_by_key(char                   other[OTHERSIZE],
           return *pstatus;
         }
 
+      nfs4_recovery_state(pstate, FALSE);
+      nfs4_lease_state(pstate, NULL, FALSE);
+
       /* reset the pstate field to avoid later mistakes */
       memset((char *)pstate->stateid_other, 0, OTHERSIZE);
       pstate->state_type   = STATE_TYPE_NONE;
@@ -413,55 +467,28 @@ state_status_t state_del_by_key(char                   other[OTHERSIZE],
 
 /**
  *
- * state_del: deletes a state from the hash's state
+ * state_del_no_mutex: deletes a state from the hash's state, pentry locked
  *
- * Deletes a state from the hash's state
+ * Deletes a state from the hash's state. The caller holds the write lock of
+ * the related pentry, which keeps the state from being deleted under it.
  *
- * @param pstate   [OUT]   pointer to the new state
+ * @param pstate   [INOUT] the state to delete
  * @param pclient  [INOUT] related cache inode client
  * @param pstatus  [OUT]   returned status
  *
  * @return the same as *pstatus
  *
  */
-state_status_t state_del(state_t              * pstate,
-                         cache_inode_client_t * pclient,
-                         state_status_t       * pstatus)
+state_status_t state_del_no_mutex(state_t              * pstate,
+                                  cache_inode_client_t * pclient,
+                                  state_status_t       * pstatus)
 {
-  state_t       * ptest_state = NULL;
-  cache_entry_t * pentry = NULL;
+  cache_entry_t * pentry = pstate->state_pentry;
   char            debug_str[OTHERSIZE * 2 + 1];
 
-  if(pstatus == NULL)
-    return STATE_INVALID_ARGUMENT;
-
-  if(pstate == NULL || pclient == NULL)
-    {
-      *pstatus = STATE_INVALID_ARGUMENT;
-      return *pstatus;
-    }
-
   if (isDebug(COMPONENT_STATE))
     sprint_mem(debug_str, (char *)pstate->stateid_other, OTHERSIZE);
 
-  /* Does this state exists ? */
-  if(!nfs4_State_Get_Pointer(pstate->stateid_other, &ptest_state))
-    {
-      *pstatus = STATE_NOT_FOUND;
-
-      /* stat */
-      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_DEL_STATE] += 1;
-
-      LogDebug(COMPONENT_STATE, "Could not find state %s to delete", debug_str);
-
-      return *pstatus;
-    }
-
-  /* The state exists, locks the related pentry before operating on it */
-  pentry = pstate->state_pentry;
-
-  P_w(&pentry->lock);
-
   /* Set the head counter */
   if(pstate == pentry->object.file.pstate_head)
     {
@@ -495,11 +522,12 @@ state_status_t state_del(state_t              * pstate,
 
       LogDebug(COMPONENT_STATE, "Could not delete state %s", debug_str);
 
-      V_w(&pentry->lock);
-
       return *pstatus;
     }
 
+  nfs4_recovery_state(pstate, FALSE);
+  nfs4_lease_state(pstate, NULL, FALSE);
+
   /* reset the pstate field to avoid later mistakes */
   memset((char *)pstate->stateid_other, 0, OTHERSIZE);
   pstate->state_type   = STATE_TYPE_NONE;
@@ -513,6 +541,62 @@ state_status_t state_del(state_t              * pstate,
 
   *pstatus = STATE_SUCCESS;
 
+  return *pstatus;
+}                               /* state_del_no_mutex */
+
+/**
+ *
+ * state_del: deletes a state from the hash's state
+ *
+ * Deletes a state from the hash's state
+ *
+ * @param pstate   [OUT]   pointer to the new state
+ * @param pclient  [INOUT] related cache inode client
+ * @param pstatus  [OUT]   returned status
+ *
+ * @return the same as *pstatus
+ *
+ */
+state_status_t state_del(state_t              * pstate,
+                         cache_inode_client_t * pclient,
+                         state_status_t       * pstatus)
+{
+  state_t       * ptest_state = NULL;
+  cache_entry_t * pentry = NULL;
+  char            debug_str[OTHERSIZE * 2 + 1];
+
+  if(pstatus == NULL)
+    return STATE_INVALID_ARGUMENT;
+
+  if(pstate == NULL || pclient == NULL)
+    {
+      *pstatus = STATE_INVALID_ARGUMENT;
+      return *pstatus;
+    }
+
+  if (isDebug(COMPONENT_STATE))
+    sprint_mem(debug_str, (char *)pstate->stateid_other, OTHERSIZE);
+
+  /* Does this state exists ? */
+  if(!nfs4_State_Get_Pointer(pstate->stateid_other, &ptest_state))
+    {
+      *pstatus = STATE_NOT_FOUND;
+
+      /* stat */
+      pclient->stat.func_stats.nb_err_unrecover[CACHE_INODE_DEL_STATE] += 1;
+
+      LogDebug(COMPONENT_STATE, "Could not find state %s to delete", debug_str);
+
+      return *pstatus;
+    }
+
+  /* The state exists, locks the related pentry before operating on it */
+  pentry = pstate->state_pentry;
+
+  P_w(&pentry->lock);
+
+  state_del_no_mutex(pstate, pclient, pstatus);
+
   V_w(&pentry->lock);
 
   return *pstatus;
@@ -538,6 +538,9 @@ int nfs4_Check_Stateid(stateid4        * pstate,
                "Check %s stateid found valid stateid %s - %p",
                tag, str, pstate2);
 
+  /* Using a stateid renews the lease of its client */
+  nfs4_lease_renew(pstate2->state_powner->so_owner.so_nfs4_owner.so_clientid);
+
   /* Copy stateid into current for later use */
   data->current_stateid       = *pstate;
   data->current_stateid.seqid = pstate2->state_seqid;
@@ -512,7 +512,8 @@ static state_lock_entry_t *create_state_lock_entry(cache_entry_t      * pentry,
       return NULL;
     }
 
-  new_entry->sle_ref_count  = 0;
+  /* The reference of the lock list or tree the entry goes on */
+  new_entry->sle_ref_count  = 1;
   new_entry->sle_pentry     = pentry;
   new_entry->sle_blocked    = blocked;
   new_entry->sle_owner      = powner;
@@ -676,55 +677,152 @@ static void remove_from_locklist(state_lock_entry_t *lock_entry)
         }
     }
 
+  /* Granted locks may also be on a temporary list */
+  if(lock_entry->sle_in_tree)
+    state_lock_tree_remove(&lock_entry->sle_pentry->object.file.lock_trees, lock_entry);
+
   glist_del(&lock_entry->sle_list);
+
   lock_entry_dec_ref(lock_entry);
 }
 
+/* Owners standing for several lock owners can't be looked up in the owner tree */
+static inline int wildcard_owner(state_owner_t *powner)
+{
+  if(powner == NULL)
+    return TRUE;
+
+#ifdef _USE_NLM
+  if(powner->so_type == STATE_LOCK_OWNER_NLM && powner->so_owner_len == -1)
+    return TRUE;
+#endif
+
+  return FALSE;
+}
+
+/* Collects the matching lock entries on a temporary list */
+typedef struct lock_collect_arg__
+{
+  struct glist_head * list;
+  state_owner_t     * powner;
+  bool_t              not_granted;
+} lock_collect_arg_t;
+
+static int lock_collect(state_lock_entry_t *found_entry, void *arg)
+{
+  lock_collect_arg_t *pcollect = (lock_collect_arg_t *) arg;
+
+  if(pcollect->powner != NULL && different_owners(found_entry->sle_owner, pcollect->powner))
+    return FALSE;
+
+  if(pcollect->not_granted && found_entry->sle_blocked == STATE_NON_BLOCKING)
+    return FALSE;
+
+  glist_add_tail(pcollect->list, &found_entry->sle_list);
+
+  return FALSE;
+}
+
+/* Collects the granted locks of powner (or of anyone if NULL) overlapping plock */
+static void collect_overlapping_entries(cache_entry_t     * pentry,
+                                        state_owner_t     * powner,
+                                        state_lock_desc_t * plock,
+                                        bool_t              not_granted,
+                                        struct glist_head * list)
+{
+  lock_collect_arg_t collect;
+
+  collect.list        = list;
+  collect.powner      = powner;
+  collect.not_granted = not_granted;
+
+  state_lock_tree_search(&pentry->object.file.lock_trees,
+                         wildcard_owner(powner) ? NULL : powner,
+                         plock->sld_offset,
+                         lock_end(plock),
+                         FALSE,
+                         lock_collect,
+                         &collect);
+}
+
+static void LogTree(const char    * reason,
+                    cache_entry_t * pentry)
+{
+  struct glist_head   list;
+  struct glist_head * glist, * glistn;
+  state_lock_desc_t   all;
+
+  if(isFullDebug(COMPONENT_STATE))
+    {
+      all.sld_type   = STATE_LOCK_R;
+      all.sld_offset = 0;
+      all.sld_length = 0;
+
+      init_glist(&list);
+      collect_overlapping_entries(pentry, NULL, &all, FALSE, &list);
+
+      glist_for_each_safe(glist, glistn, &list)
+        {
+          glist_del(glist);
+          LogEntry(reason, glist_entry(glist, state_lock_entry_t, sle_list));
+        }
+    }
+}
+
+static int lock_conflicts(state_lock_entry_t *found_entry, void *arg)
+{
+  LogEntry("Checking", found_entry);
+
+  /* Overlapping locks are allowed if neither is exclusive or the owner is the same,
+   * the search only returns write locks when the lock is not exclusive.
+   */
+  return different_owners(found_entry->sle_owner, (state_owner_t *) arg);
+}
+
 static state_lock_entry_t *get_overlapping_entry(cache_entry_t     * pentry,
                                                  fsal_op_context_t * pcontext,
                                                  state_owner_t     * powner,
                                                  state_lock_desc_t * plock)
 {
-  struct glist_head *glist;
-  state_lock_entry_t *found_entry = NULL;
-  uint64_t found_entry_end, plock_end = lock_end(plock);
+  /* Blocked locks are not in the lock trees */
+  return state_lock_tree_search(&pentry->object.file.lock_trees,
+                                NULL,
+                                plock->sld_offset,
+                                lock_end(plock),
+                                plock->sld_type != STATE_LOCK_W,
+                                lock_conflicts,
+                                powner);
+}
 
-  glist_for_each(glist, &pentry->object.file.lock_list)
-    {
-      found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+typedef struct lock_merge_arg__
+{
+  state_lock_entry_t * lock_entry;
+  struct glist_head  * list;
+} lock_merge_arg_t;
 
-      LogEntry("Checking", found_entry);
+static int lock_mergeable(state_lock_entry_t *check_entry, void *arg)
+{
+  lock_merge_arg_t *pmerge = (lock_merge_arg_t *) arg;
 
-      /* Skip blocked locks */
-      if(found_entry->sle_blocked == STATE_NLM_BLOCKING ||
-         found_entry->sle_blocked == STATE_NFSV4_BLOCKING)
-          continue;
+  /* Skip entry being merged - it could be in the tree */
+  if(check_entry == pmerge->lock_entry)
+    return FALSE;
 
-      found_entry_end = lock_end(&found_entry->sle_lock);
+  /* Only merge fully granted locks */
+  if(check_entry->sle_blocked != STATE_NON_BLOCKING)
+    return FALSE;
 
-      if((found_entry_end >= plock->sld_offset) &&
-         (found_entry->sle_lock.sld_offset <= plock_end))
-        {
-          /* lock overlaps see if we can allow 
-           * allow if neither lock is exclusive or the owner is the same
-           */
-          if((found_entry->sle_lock.sld_type == STATE_LOCK_W ||
-              plock->sld_type == STATE_LOCK_W) &&
-             different_owners(found_entry->sle_owner, powner)
-             )
-            {
-              /* found a conflicting lock, return it */
-              return found_entry;
-            }
-        }
-    }
+  /* Don't merge locks of different types */
+  if(check_entry->sle_lock.sld_type != pmerge->lock_entry->sle_lock.sld_type)
+    return FALSE;
 
-  return NULL;
+  glist_add_tail(pmerge->list, &check_entry->sle_list);
+
+  return FALSE;
 }
 
-/* We need to iterate over the full lock list and remove
- * any mapping entry. And l_offset = 0 and sle_lock.sld_length = 0 lock_entry
- * implies remove all entries
+/* Merges into lock_entry the locks of the same owner and type that touch or
+ * overlap it. The locks of the owner are found in the owner tree.
  */
 static void merge_lock_entry(cache_entry_t        * pentry,
                              fsal_op_context_t    * pcontext,
@@ -732,57 +830,61 @@ static void merge_lock_entry(cache_entry_t        * pentry,
 {
   state_lock_entry_t *check_entry;
   uint64_t check_entry_end;
-  uint64_t lock_entry_end;
-  struct glist_head *glist, *glistn;
+  uint64_t lock_entry_start = lock_entry->sle_lock.sld_offset;
+  uint64_t lock_entry_end   = lock_end(&lock_entry->sle_lock);
+  struct glist_head merge_list, *glist, *glistn;
+  lock_merge_arg_t merge;
+  bool_t in_tree = lock_entry->sle_in_tree;
 
   /* lock_entry might be STATE_NON_BLOCKING or STATE_GRANTING */
 
-  glist_for_each_safe(glist, glistn, &pentry->object.file.lock_list)
-    {
-      check_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+  init_glist(&merge_list);
+  merge.lock_entry = lock_entry;
+  merge.list       = &merge_list;
 
-      /* Skip entry being merged - it could be in the list */
-      if(check_entry == lock_entry)
-        continue;
+  state_lock_tree_search(&pentry->object.file.lock_trees,
+                         lock_entry->sle_owner,
+                         lock_entry_start > 0 ? lock_entry_start - 1 : 0,
+                         lock_entry_end < UINT64_MAX ? lock_entry_end + 1 : UINT64_MAX,
+                         FALSE,
+                         lock_mergeable,
+                         &merge);
 
-      if(different_owners(check_entry->sle_owner, lock_entry->sle_owner))
-        continue;
+  if(glist_empty(&merge_list))
+    /* nothing to merge */
+    return;
 
-      /* Only merge fully granted locks */
-      if(check_entry->sle_blocked != STATE_NON_BLOCKING)
-        continue;
+  /* The key of lock_entry is about to change */
+  if(in_tree)
+    state_lock_tree_remove(&pentry->object.file.lock_trees, lock_entry);
 
-      /* Don't merge locks of different types */
-      if(check_entry->sle_lock.sld_type != lock_entry->sle_lock.sld_type)
-        continue;
+  glist_for_each_safe(glist, glistn, &merge_list)
+    {
+      check_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+      glist_del(&check_entry->sle_list);
 
+      /* check_entry touches or overlaps lock_entry, expand lock_entry */
       check_entry_end = lock_end(&check_entry->sle_lock);
-      lock_entry_end  = lock_end(&lock_entry->sle_lock);
-
-      if((check_entry_end + 1) < lock_entry->sle_lock.sld_offset)
-        /* nothing to merge */
-        continue;
 
-      if((lock_entry_end + 1) < check_entry->sle_lock.sld_offset)
-        /* nothing to merge */
-        continue;
-
-      /* check_entry touches or overlaps lock_entry, expand lock_entry */
       if(lock_entry_end < check_entry_end)
         /* Expand end of lock_entry */
         lock_entry_end = check_entry_end;
 
-      if(check_entry->sle_lock.sld_offset < lock_entry->sle_lock.sld_offset)
+      if(check_entry->sle_lock.sld_offset < lock_entry_start)
         /* Expand start of lock_entry */
-        check_entry->sle_lock.sld_offset = lock_entry->sle_lock.sld_offset;
-
-      /* Compute new lock length */
-      lock_entry->sle_lock.sld_length = lock_entry_end - check_entry->sle_lock.sld_offset + 1;
+        lock_entry_start = check_entry->sle_lock.sld_offset;
 
       /* Remove merged entry */
       LogEntry("Merging", check_entry);
       remove_from_locklist(check_entry);
     }
+
+  /* Compute new lock range */
+  lock_entry->sle_lock.sld_offset = lock_entry_start;
+  lock_entry->sle_lock.sld_length = lock_entry_end - lock_entry_start + 1;
+
+  if(in_tree)
+    state_lock_tree_insert(&pentry->object.file.lock_trees, lock_entry);
 }
 
 static void free_list(struct glist_head    * list)
@@ -886,6 +988,8 @@ static bool_t subtract_lock_from_list(cache_entry_t      * pentry,
   struct glist_head *glist, *glistn;
   bool_t rc = FALSE;
 
+  *pstatus = STATE_SUCCESS;
+
   init_glist(&split_lock_list);
   init_glist(&remove_list);
 
@@ -945,31 +1049,92 @@ static bool_t subtract_lock_from_list(cache_entry_t      * pentry,
   return rc;
 }
 
-static state_status_t subtract_list_from_list(cache_entry_t     * pentry,
-                                              fsal_op_context_t * pcontext,
-                                              struct glist_head * target,
-                                              struct glist_head * source,
-                                              state_status_t    * pstatus)
+/* Subtract a lock from the granted locks of an owner, possibly splitting them. */
+static bool_t subtract_lock_from_tree(cache_entry_t      * pentry,
+                                      fsal_op_context_t  * pcontext,
+                                      state_owner_t      * powner,
+                                      state_lock_desc_t  * plock,
+                                      state_status_t     * pstatus)
 {
   state_lock_entry_t *found_entry;
+  struct glist_head overlap_list;
   struct glist_head *glist, *glistn;
+  bool_t rc;
 
-  *pstatus = STATE_SUCCESS;
+  init_glist(&overlap_list);
 
-  glist_for_each_safe(glist, glistn, source)
+  collect_overlapping_entries(pentry, powner, plock, FALSE, &overlap_list);
+
+  /* The entries removed from the list leave the tree with their last reference */
+  rc = subtract_lock_from_list(pentry,
+                               pcontext,
+                               powner,
+                               plock,
+                               pstatus,
+                               &overlap_list);
+
+  /* The list now holds the untouched entries, still in the tree, and the
+   * remaining bits of the split ones.
+   */
+  glist_for_each_safe(glist, glistn, &overlap_list)
     {
       found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+      glist_del(&found_entry->sle_list);
 
-      subtract_lock_from_list(pentry,
-                              pcontext,
-                              NULL,
-                              &found_entry->sle_lock,
-                              pstatus,
-                              target);
-      if(*pstatus != STATE_SUCCESS)
-        break;
+      if(!found_entry->sle_in_tree)
+        state_lock_tree_insert(&pentry->object.file.lock_trees, found_entry);
     }
 
+  return rc;
+}
+
+typedef struct lock_subtract_arg__
+{
+  cache_entry_t     * pentry;
+  fsal_op_context_t * pcontext;
+  struct glist_head * target;
+  state_status_t    * pstatus;
+} lock_subtract_arg_t;
+
+static int lock_subtract(state_lock_entry_t *found_entry, void *arg)
+{
+  lock_subtract_arg_t *psubtract = (lock_subtract_arg_t *) arg;
+
+  subtract_lock_from_list(psubtract->pentry,
+                          psubtract->pcontext,
+                          NULL,
+                          &found_entry->sle_lock,
+                          psubtract->pstatus,
+                          psubtract->target);
+
+  /* Stop on error */
+  return *psubtract->pstatus != STATE_SUCCESS;
+}
+
+/* Subtract the granted locks overlapping plock from a list of locks. */
+static state_status_t subtract_tree_from_list(cache_entry_t     * pentry,
+                                              fsal_op_context_t * pcontext,
+                                              state_lock_desc_t * plock,
+                                              struct glist_head * target,
+                                              state_status_t    * pstatus)
+{
+  lock_subtract_arg_t subtract;
+
+  *pstatus = STATE_SUCCESS;
+
+  subtract.pentry   = pentry;
+  subtract.pcontext = pcontext;
+  subtract.target   = target;
+  subtract.pstatus  = pstatus;
+
+  state_lock_tree_search(&pentry->object.file.lock_trees,
+                         NULL,
+                         plock->sld_offset,
+                         lock_end(plock),
+                         FALSE,
+                         lock_subtract,
+                         &subtract);
+
   return *pstatus;
 }
 
@@ -1404,9 +1569,13 @@ static void grant_blocked_locks(cache_entry_t        * pentry,
               continue;
             }
 
-          /* Grant is still in progress, keep the lock in the list */
+          /* Grant is still in progress, the FSAL lock is held, move the lock to the trees */
           if(status == STATE_SUCCESS)
-            continue;
+            {
+              glist_del(&found_entry->sle_list);
+              state_lock_tree_insert(&pentry->object.file.lock_trees, found_entry);
+              continue;
+            }
         }
 
       /* There was no call back data or the call back failed, remove lock from list */
@@ -1421,10 +1590,8 @@ void cancel_blocked_lock(cache_entry_t        * pentry,
 {
   state_cookie_entry_t *pcookie = NULL;
 
-  /* Remove the lock from the lock list*/
   LogEntry("Removing", lock_entry);
-  remove_from_locklist(lock_entry);
-  
+
   /* Mark lock as granted and detach cookie and granted call back */
   lock_entry->sle_blocked          = STATE_CANCELED;
 
@@ -1439,6 +1606,9 @@ void cancel_blocked_lock(cache_entry_t        * pentry,
   /* Don't need reference to cookie entry any more */
   if(pcookie != NULL)
     cookie_entry_dec_ref(pcookie);
+
+  /* Remove the lock from the lock list, this may release the last reference */
+  remove_from_locklist(lock_entry);
 }
 
 /**
@@ -1468,9 +1638,25 @@ void cancel_blocked_locks_range(cache_entry_t        * pentry,
                                 cache_inode_client_t * pclient)
 {
   struct glist_head  * glist, * glistn;
+  struct glist_head    granting_list;
   state_lock_entry_t * found_entry = NULL;
   uint64_t             found_entry_end, plock_end = lock_end(plock);
 
+  /* Locks being granted are in the lock trees */
+  init_glist(&granting_list);
+  collect_overlapping_entries(pentry, powner, plock, TRUE, &granting_list);
+
+  glist_for_each_safe(glist, glistn, &granting_list)
+    {
+      found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+      glist_del(&found_entry->sle_list);
+
+      LogEntry("Checking", found_entry);
+
+      /* lock overlaps, cancel it. */
+      cancel_blocked_lock(pentry, pcontext, found_entry);
+    }
+
   glist_for_each_safe(glist, glistn, &pentry->object.file.lock_list)
     {
       found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
@@ -1612,7 +1798,8 @@ inline const char *fsal_lock_op_str(fsal_lock_op_t op)
  *
  * Basically, we want to create a list of ranges to unlock. To do so
  * we create a dummy entry in a dummy list for the unlock range. Then
- * we subtract each existing lock from the dummy list.
+ * we subtract each existing lock from the dummy list. Only the granted locks
+ * overlapping the unlock range matter, they are found in the lock trees.
  *
  * The list of unlock ranges will include ranges that the original onwer
  * didn't actually have locks in. This behavior is actually helpful
@@ -1643,7 +1830,6 @@ state_status_t do_unlock_no_owner(cache_entry_t        * pentry,
 
   init_glist(&fsal_unlock_list);
 
-  unlock_entry->sle_ref_count = 1;
   glist_add_tail(&fsal_unlock_list, &unlock_entry->sle_list);
 
   LogFullDebug(COMPONENT_STATE,
@@ -1655,10 +1841,10 @@ state_status_t do_unlock_no_owner(cache_entry_t        * pentry,
   LogFullDebug(COMPONENT_STATE,
                "----------------------------------------------------------------------");
 
-  if(subtract_list_from_list(pentry,
+  if(subtract_tree_from_list(pentry,
                              pcontext,
+                             plock,
                              &fsal_unlock_list,
-                             &pentry->object.file.lock_list,
                              &status) != STATE_SUCCESS)
     {
       /* We ran out of memory while trying to build the unlock list.
@@ -1676,9 +1862,9 @@ state_status_t do_unlock_no_owner(cache_entry_t        * pentry,
 
       LogUnlock(pentry, pcontext, found_entry);
 
-      lock_params.lock_type   = fsal_lock_type(plock);
-      lock_params.lock_start  = plock->sld_offset;
-      lock_params.lock_length = plock->sld_length;
+      lock_params.lock_type   = fsal_lock_type(&found_entry->sle_lock);
+      lock_params.lock_start  = found_entry->sle_lock.sld_offset;
+      lock_params.lock_length = found_entry->sle_lock.sld_length;
       lock_params.lock_owner  = 0;
 
       fsal_status = FSAL_lock_op(cache_inode_fd(pentry),
@@ -1782,6 +1968,18 @@ state_status_t do_lock_op(cache_entry_t      * pentry,
   return status;
 }
 
+/* A granted lock of the same type that entirely overlaps the lock */
+static int lock_covers(state_lock_entry_t *found_entry, void *arg)
+{
+  state_lock_desc_t *plock = (state_lock_desc_t *) arg;
+
+  return lock_end(&found_entry->sle_lock) >= lock_end(plock) &&
+         found_entry->sle_lock.sld_offset <= plock->sld_offset &&
+         found_entry->sle_lock.sld_type == plock->sld_type &&
+         (found_entry->sle_blocked == STATE_NON_BLOCKING ||
+          found_entry->sle_blocked == STATE_GRANTING);
+}
+
 void copy_conflict(state_lock_entry_t  * found_entry,
                    state_owner_t      ** holder,   /* owner that holds conflicting lock */
                    state_lock_desc_t   * conflict) /* description of conflicting lock */
@@ -1931,70 +2129,77 @@ state_status_t state_lock(cache_entry_t         * pentry,
     }
 #endif
 
-  glist_for_each(glist, &pentry->object.file.lock_list)
+  /* Look for a lock of the owner that entirely overlaps the new entry */
+  found_entry = state_lock_tree_search(&pentry->object.file.lock_trees,
+                                       powner,
+                                       plock->sld_offset,
+                                       plock_end,
+                                       FALSE,
+                                       lock_covers,
+                                       plock);
+  if(found_entry != NULL)
     {
-      found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+#ifdef _USE_BLOCKING_LOCKS
+      /* The lock actually has the same owner, we're done */
+      if(found_entry->sle_blocked == STATE_GRANTING)
+        {
+          /* Need to handle completion of granting of this lock */
+          grant_blocked_lock(pentry,
+                             pcontext,
+                             found_entry);
+        }
+#endif
+      V(pentry->object.file.lock_list_mutex);
+      LogEntry("Found existing", found_entry);
+      *pstatus = STATE_SUCCESS;
+      return *pstatus;
+    }
 
+  found_entry = get_overlapping_entry(pentry, pcontext, powner, plock);
+
+  if(found_entry == NULL)
+    {
       /* Don't skip blocked locks for fairness */
+      glist_for_each(glist, &pentry->object.file.lock_list)
+        {
+          found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
 
-      found_entry_end = lock_end(&found_entry->sle_lock);
+          found_entry_end = lock_end(&found_entry->sle_lock);
 
-      if((found_entry_end >= plock->sld_offset) &&
-         (found_entry->sle_lock.sld_offset <= plock_end))
-        {
-          /* lock overlaps see if we can allow 
-           * allow if neither lock is exclusive or the owner is the same
-           */
-          if((found_entry->sle_lock.sld_type == STATE_LOCK_W ||
+          if((found_entry_end >= plock->sld_offset) &&
+             (found_entry->sle_lock.sld_offset <= plock_end) &&
+             (found_entry->sle_lock.sld_type == STATE_LOCK_W ||
               plock->sld_type == STATE_LOCK_W) &&
              different_owners(found_entry->sle_owner, powner))
-            {
-              /* Found a conflicting lock, break out of loop.
-               * Also indicate overlap hint.
-               */
-              allow  = FALSE;
-              overlap = TRUE;
-              break;
-            }
-        }
-
-      if(found_entry_end >= plock_end &&
-         found_entry->sle_lock.sld_offset <= plock->sld_offset &&
-         found_entry->sle_lock.sld_type == plock->sld_type &&
-         (found_entry->sle_blocked == STATE_NON_BLOCKING ||
-          found_entry->sle_blocked == STATE_GRANTING))
-        {
-          /* Found an entry that entirely overlaps the new entry 
-           * (and due to the preceding test does not prevent
-           * granting this lock - therefore there can't be any
-           * other locks that would prevent granting this lock
-           */
-          if(!different_owners(found_entry->sle_owner, powner))
-            {
- #ifdef _USE_BLOCKING_LOCKS
-             /* The lock actually has the same owner, we're done */
-              if(found_entry->sle_blocked == STATE_GRANTING)
-                {
-                  /* Need to handle completion of granting of this lock */
-                  grant_blocked_lock(pentry,
-                                     pcontext,
-                                     found_entry);
-                }
-#endif
-              V(pentry->object.file.lock_list_mutex);
-              LogEntry("Found existing", found_entry);
-              *pstatus = STATE_SUCCESS;
-              return *pstatus;
-            }
+            break;
 
-          /* Found a compatible lock with a different lock owner that
-           * fully overlaps, set hint.
-           */
-          LogEntry("state_lock Found overlapping", found_entry);
-          overlap = TRUE;
+          found_entry = NULL;
         }
     }
 
+  if(found_entry != NULL)
+    {
+      /* Found a conflicting lock, also indicate overlap hint. */
+      allow  = FALSE;
+      overlap = TRUE;
+    }
+  else if(state_lock_tree_search(&pentry->object.file.lock_trees,
+                                 NULL,
+                                 plock->sld_offset,
+                                 plock_end,
+                                 FALSE,
+                                 lock_covers,
+                                 plock) != NULL)
+    {
+      /* Found a compatible lock with a different lock owner that
+       * fully overlaps (and therefore can't prevent granting this
+       * lock), set hint.
+       */
+      LogFullDebug(COMPONENT_STATE,
+                   "state_lock Found overlapping");
+      overlap = TRUE;
+    }
+
   if(allow)
     {
       blocked = STATE_NON_BLOCKING;
@@ -2003,7 +2208,8 @@ state_status_t state_lock(cache_entry_t         * pentry,
     {
       /* TODO FSF: need to call FSAL in case blocking locks are supported */
       LogEntry("Conflicts with", found_entry);
-      LogList("Locks", &pentry->object.file.lock_list);
+      LogTree("Locks", pentry);
+      LogList("Blocked", &pentry->object.file.lock_list);
       if(blocking == STATE_NON_BLOCKING   ||
          blocking == STATE_NFSV4_BLOCKING || /* TODO FSF: look into support of NFS v4 blocking locks */
          block_data == NULL)                 /* Can't support blocking locks right now without call back */
@@ -2056,7 +2262,6 @@ state_status_t state_lock(cache_entry_t         * pentry,
           LogMajor(COMPONENT_STATE,
                    "Unable to lock FSAL, error=%s",
                    state_err_str(*pstatus));
-          lock_entry_inc_ref(found_entry);
           remove_from_locklist(found_entry);
           V(pentry->object.file.lock_list_mutex);
           return *pstatus;
@@ -2068,7 +2273,10 @@ state_status_t state_lock(cache_entry_t         * pentry,
 
   LogEntry("New entry", found_entry);
 
-  glist_add_tail(&pentry->object.file.lock_list, &found_entry->sle_list);
+  if(blocked == STATE_NON_BLOCKING)
+    state_lock_tree_insert(&pentry->object.file.lock_trees, found_entry);
+  else
+    glist_add_tail(&pentry->object.file.lock_list, &found_entry->sle_list);
 
   V(pentry->object.file.lock_list_mutex);
   if(blocked == STATE_NON_BLOCKING)
@@ -2111,13 +2319,12 @@ state_status_t state_unlock(cache_entry_t        * pentry,
                              pclient);
 #endif
 
-  /* Release the lock from cache inode lock list for pentry */
-  gotsome = subtract_lock_from_list(pentry,
+  /* Release the lock from cache inode lock trees for pentry */
+  gotsome = subtract_lock_from_tree(pentry,
                                     pcontext,
                                     powner,
                                     plock,
-                                    pstatus,
-                                    &pentry->object.file.lock_list);
+                                    pstatus);
 
   if(*pstatus != STATE_SUCCESS)
     {
@@ -2154,16 +2361,24 @@ state_status_t state_unlock(cache_entry_t        * pentry,
   LogFullDebug(COMPONENT_STATE,
                "----------------------------------------------------------------------");
 
-  V(pentry->object.file.lock_list_mutex);
-
 #ifdef _USE_BLOCKING_LOCKS
+  /* Granting moves the locks to the lock trees, keep the mutex */
   grant_blocked_locks(pentry, pcontext, pclient);
 #endif
 
+  V(pentry->object.file.lock_list_mutex);
+
   return *pstatus;
 }
 
 #ifdef _USE_BLOCKING_LOCKS
+/* The lock being granted that a cancel is about */
+static int lock_granting(state_lock_entry_t *found_entry, void *arg)
+{
+  return found_entry->sle_blocked == STATE_GRANTING &&
+         !different_lock(&found_entry->sle_lock, (state_lock_desc_t *) arg);
+}
+
 state_status_t state_cancel(cache_entry_t        * pentry,
                             fsal_op_context_t    * pcontext,
                             state_owner_t        * powner,
@@ -2172,7 +2387,7 @@ state_status_t state_cancel(cache_entry_t        * pentry,
                             state_status_t       * pstatus)
 {
   struct glist_head *glist;
-  state_lock_entry_t *found_entry;
+  state_lock_entry_t *found_entry = NULL;
 
   *pstatus = STATE_NOT_FOUND;
 
@@ -2182,15 +2397,26 @@ state_status_t state_cancel(cache_entry_t        * pentry,
     {
       found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
 
-      if(different_owners(found_entry->sle_owner, powner))
-        continue;
+      if(!different_owners(found_entry->sle_owner, powner) &&
+         found_entry->sle_blocked != STATE_NON_BLOCKING &&
+         !different_lock(&found_entry->sle_lock, plock))
+        break;
 
-      if(found_entry->sle_blocked == STATE_NON_BLOCKING)
-        continue;
+      found_entry = NULL;
+    }
 
-      if(different_lock(&found_entry->sle_lock, plock))
-        continue;
+  /* The lock may be being granted, then it is in the lock trees */
+  if(found_entry == NULL && !wildcard_owner(powner))
+    found_entry = state_lock_tree_search(&pentry->object.file.lock_trees,
+                                         powner,
+                                         plock->sld_offset,
+                                         lock_end(plock),
+                                         FALSE,
+                                         lock_granting,
+                                         plock);
 
+  if(found_entry != NULL)
+    {
       /*
        * We have matched all atribute of the existing lock.
        * Remove it (even if we were granting it).
@@ -2218,8 +2444,6 @@ state_status_t state_cancel(cache_entry_t        * pentry,
 
       /* Check to see if we can grant any blocked locks. */
       grant_blocked_locks(pentry, pcontext, pclient);
-
-      break;
     }
 
   V(pentry->object.file.lock_list_mutex);
@@ -2240,6 +2464,8 @@ state_status_t state_nlm_notify(fsal_op_context_t    * pcontext,
   cache_entry_t      * pentry;
   int                  errcnt = 0;
 
+  *pstatus = STATE_SUCCESS;
+
   while(errcnt < 100)
     {
       P(pnlmclient->slc_mutex);
@@ -2248,6 +2474,14 @@ state_status_t state_nlm_notify(fsal_op_context_t    * pcontext,
        * We pick the first lock the client holds, and use it's file.
        */
       found_entry = glist_first_entry(&pnlmclient->slc_lock_list, state_lock_entry_t, sle_client_locks);
+
+      /* If we don't find any entries, then we are done. */
+      if(found_entry == NULL)
+        {
+          V(pnlmclient->slc_mutex);
+          break;
+        }
+
       lock_entry_inc_ref(found_entry);
 
       /* Move this entry to the end of the list (this will help if errors occur) */
@@ -2256,10 +2490,6 @@ state_status_t state_nlm_notify(fsal_op_context_t    * pcontext,
 
       V(pnlmclient->slc_mutex);
 
-      /* If we don't find any entries, then we are done. */
-      if(found_entry == NULL)
-        break;
-
       /* Extract the cache inode entry from the lock entry and release the lock entry */
       pentry = found_entry->sle_pentry;
       lock_entry_dec_ref(found_entry);
@@ -2303,6 +2533,8 @@ state_status_t state_owner_unlock_all(fsal_op_context_t    * pcontext,
   cache_entry_t      * pentry;
   int                  errcnt = 0;
 
+  *pstatus = STATE_SUCCESS;
+
   while(errcnt < 100)
     {
       P(powner->so_mutex);
@@ -2311,6 +2543,14 @@ state_status_t state_owner_unlock_all(fsal_op_context_t    * pcontext,
        * We pick the first lock the client holds, and use it's file.
        */
       found_entry = glist_first_entry(&powner->so_lock_list, state_lock_entry_t, sle_owner_locks);
+
+      /* If we don't find any entries, then we are done. */
+      if(found_entry == NULL)
+        {
+          V(powner->so_mutex);
+          break;
+        }
+
       lock_entry_inc_ref(found_entry);
 
       /* Move this entry to the end of the list (this will help if errors occur) */
@@ -2319,10 +2559,6 @@ state_status_t state_owner_unlock_all(fsal_op_context_t    * pcontext,
 
       V(powner->so_mutex);
 
-      /* If we don't find any entries, then we are done. */
-      if(found_entry == NULL)
-        break;
-
       /* Extract the cache inode entry from the lock entry and release the lock entry */
       pentry = found_entry->sle_pentry;
 
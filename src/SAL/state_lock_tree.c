@@ -0,0 +1,451 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    state_lock_tree.c
+ * \brief   Interval trees of the granted byte-range locks of a file.
+ *
+ * state_lock_tree.c : The granted (and being granted) locks of a file are
+ * kept in two trees, one ordered by lock start and one ordered by owner and
+ * then by lock start, so that both the conflicts with a range and the locks
+ * of an owner in a range are found in O(log n) plus the number of locks
+ * found. The blocked requests stay in the lock list of the file.
+ *
+ * The trees are treaps: binary search trees on the key that are heaps on a
+ * pseudo random priority, which keeps them balanced in probability. Each
+ * node also holds the highest lock end of its subtree, for all the locks
+ * and for the write locks only, to skip the subtrees that end before the
+ * searched range.
+ *
+ * The lock list mutex of the file must be held to call these functions.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdint.h>
+#include <pthread.h>
+#include "log_macros.h"
+#include "sal_functions.h"
+
+#define LOCK_NODE(pentry, tree) (&(pentry)->sle_node[tree])
+
+typedef struct state_lock_query__
+{
+  state_lock_tree_t    tree;
+  state_owner_t      * powner;
+  uint64_t             start;
+  uint64_t             end;
+  bool_t               writes_only;
+  state_lock_match_t   match;
+  void               * arg;
+} state_lock_query_t;
+
+static inline uint64_t lock_tree_end(state_lock_entry_t * plock_entry)
+{
+  if(plock_entry->sle_lock.sld_length == 0)
+    return UINT64_MAX;
+  else
+    return plock_entry->sle_lock.sld_offset + plock_entry->sle_lock.sld_length - 1;
+}
+
+static int lock_tree_cmp(state_lock_tree_t    tree,
+                         state_lock_entry_t * pentry1,
+                         state_lock_entry_t * pentry2)
+{
+  if(tree == STATE_LOCK_BY_OWNER && pentry1->sle_owner != pentry2->sle_owner)
+    return (uintptr_t) pentry1->sle_owner < (uintptr_t) pentry2->sle_owner ? -1 : 1;
+
+  if(pentry1->sle_lock.sld_offset != pentry2->sle_lock.sld_offset)
+    return pentry1->sle_lock.sld_offset < pentry2->sle_lock.sld_offset ? -1 : 1;
+
+  /* Several locks may start at the same offset */
+  if(pentry1 == pentry2)
+    return 0;
+
+  return (uintptr_t) pentry1 < (uintptr_t) pentry2 ? -1 : 1;
+}
+
+/* Recomputes the highest lock ends of a node from its children */
+static void lock_tree_update(state_lock_tree_t    tree,
+                             state_lock_entry_t * plock_entry)
+{
+  state_lock_node_t * pnode = LOCK_NODE(plock_entry, tree);
+  state_lock_entry_t * child[2];
+  state_lock_node_t * pchild;
+  int i;
+
+  pnode->sln_max_end = lock_tree_end(plock_entry);
+  pnode->sln_has_w = plock_entry->sle_lock.sld_type == STATE_LOCK_W;
+  pnode->sln_max_end_w = pnode->sln_has_w ? pnode->sln_max_end : 0;
+
+  child[0] = pnode->sln_left;
+  child[1] = pnode->sln_right;
+
+  for(i = 0; i < 2; i++)
+    {
+      if(child[i] == NULL)
+        continue;
+
+      pchild = LOCK_NODE(child[i], tree);
+
+      if(pchild->sln_max_end > pnode->sln_max_end)
+        pnode->sln_max_end = pchild->sln_max_end;
+
+      if(pchild->sln_has_w &&
+         (!pnode->sln_has_w || pchild->sln_max_end_w > pnode->sln_max_end_w))
+        {
+          pnode->sln_has_w = TRUE;
+          pnode->sln_max_end_w = pchild->sln_max_end_w;
+        }
+    }
+}
+
+static state_lock_entry_t *lock_tree_rotate_right(state_lock_tree_t    tree,
+                                                  state_lock_entry_t * proot)
+{
+  state_lock_entry_t * pleft = LOCK_NODE(proot, tree)->sln_left;
+
+  LOCK_NODE(proot, tree)->sln_left = LOCK_NODE(pleft, tree)->sln_right;
+  LOCK_NODE(pleft, tree)->sln_right = proot;
+
+  lock_tree_update(tree, proot);
+  lock_tree_update(tree, pleft);
+
+  return pleft;
+}
+
+static state_lock_entry_t *lock_tree_rotate_left(state_lock_tree_t    tree,
+                                                 state_lock_entry_t * proot)
+{
+  state_lock_entry_t * pright = LOCK_NODE(proot, tree)->sln_right;
+
+  LOCK_NODE(proot, tree)->sln_right = LOCK_NODE(pright, tree)->sln_left;
+  LOCK_NODE(pright, tree)->sln_left = proot;
+
+  lock_tree_update(tree, proot);
+  lock_tree_update(tree, pright);
+
+  return pright;
+}
+
+static state_lock_entry_t *lock_tree_insert(state_lock_tree_t    tree,
+                                            state_lock_entry_t * proot,
+                                            state_lock_entry_t * plock_entry)
+{
+  state_lock_node_t * pnode;
+
+  if(proot == NULL)
+    {
+      pnode = LOCK_NODE(plock_entry, tree);
+      pnode->sln_left = NULL;
+      pnode->sln_right = NULL;
+      lock_tree_update(tree, plock_entry);
+      return plock_entry;
+    }
+
+  pnode = LOCK_NODE(proot, tree);
+
+  if(lock_tree_cmp(tree, plock_entry, proot) < 0)
+    {
+      pnode->sln_left = lock_tree_insert(tree, pnode->sln_left, plock_entry);
+      if(pnode->sln_left->sle_priority > proot->sle_priority)
+        return lock_tree_rotate_right(tree, proot);
+    }
+  else
+    {
+      pnode->sln_right = lock_tree_insert(tree, pnode->sln_right, plock_entry);
+      if(pnode->sln_right->sle_priority > proot->sle_priority)
+        return lock_tree_rotate_left(tree, proot);
+    }
+
+  lock_tree_update(tree, proot);
+
+  return proot;
+}
+
+/* Joins two trees, all the keys of pleft being lower than those of pright */
+static state_lock_entry_t *lock_tree_join(state_lock_tree_t    tree,
+                                          state_lock_entry_t * pleft,
+                                          state_lock_entry_t * pright)
+{
+  if(pleft == NULL)
+    return pright;
+
+  if(pright == NULL)
+    return pleft;
+
+  if(pleft->sle_priority > pright->sle_priority)
+    {
+      LOCK_NODE(pleft, tree)->sln_right =
+          lock_tree_join(tree, LOCK_NODE(pleft, tree)->sln_right, pright);
+      lock_tree_update(tree, pleft);
+      return pleft;
+    }
+
+  LOCK_NODE(pright, tree)->sln_left =
+      lock_tree_join(tree, pleft, LOCK_NODE(pright, tree)->sln_left);
+  lock_tree_update(tree, pright);
+  return pright;
+}
+
+static state_lock_entry_t *lock_tree_remove(state_lock_tree_t    tree,
+                                            state_lock_entry_t * proot,
+                                            state_lock_entry_t * plock_entry)
+{
+  state_lock_node_t * pnode;
+  int cmp;
+
+  if(proot == NULL)
+    {
+      LogCrit(COMPONENT_STATE,
+              "Lock entry %p not found in the lock tree", plock_entry);
+      return NULL;
+    }
+
+  pnode = LOCK_NODE(proot, tree);
+  cmp = lock_tree_cmp(tree, plock_entry, proot);
+
+  if(cmp == 0)
+    return lock_tree_join(tree, pnode->sln_left, pnode->sln_right);
+
+  if(cmp < 0)
+    pnode->sln_left = lock_tree_remove(tree, pnode->sln_left, plock_entry);
+  else
+    pnode->sln_right = lock_tree_remove(tree, pnode->sln_right, plock_entry);
+
+  lock_tree_update(tree, proot);
+
+  return proot;
+}
+
+static state_lock_entry_t *lock_tree_search(state_lock_query_t * pquery,
+                                            state_lock_entry_t * proot)
+{
+  state_lock_node_t * pnode;
+  state_lock_entry_t * pfound;
+  int owner_cmp = 0;
+
+  if(proot == NULL)
+    return NULL;
+
+  pnode = LOCK_NODE(proot, pquery->tree);
+
+  /* Nothing in this subtree reaches the searched range */
+  if(pquery->writes_only)
+    {
+      if(!pnode->sln_has_w || pnode->sln_max_end_w < pquery->start)
+        return NULL;
+    }
+  else if(pnode->sln_max_end < pquery->start)
+    return NULL;
+
+  if(pquery->tree == STATE_LOCK_BY_OWNER && proot->sle_owner != pquery->powner)
+    owner_cmp = (uintptr_t) proot->sle_owner < (uintptr_t) pquery->powner ? -1 : 1;
+
+  /* The left subtree holds lower keys */
+  if(owner_cmp >= 0)
+    {
+      pfound = lock_tree_search(pquery, pnode->sln_left);
+      if(pfound != NULL)
+        return pfound;
+    }
+
+  if(owner_cmp == 0 &&
+     proot->sle_lock.sld_offset <= pquery->end &&
+     lock_tree_end(proot) >= pquery->start &&
+     (!pquery->writes_only || proot->sle_lock.sld_type == STATE_LOCK_W) &&
+     (pquery->match == NULL || pquery->match(proot, pquery->arg)))
+    return proot;
+
+  /* The right subtree holds higher keys, starting after this one */
+  if(owner_cmp < 0 || (owner_cmp == 0 && proot->sle_lock.sld_offset <= pquery->end))
+    return lock_tree_search(pquery, pnode->sln_right);
+
+  return NULL;
+}
+
+/* Returns the number of nodes of a subtree, or -1 if it is inconsistent */
+static int lock_tree_verify(state_lock_tree_t    tree,
+                            state_lock_entry_t * proot,
+                            state_lock_entry_t * plow,
+                            state_lock_entry_t * phigh)
+{
+  state_lock_node_t * pnode;
+  state_lock_node_t   saved;
+  int nb_left, nb_right;
+
+  if(proot == NULL)
+    return 0;
+
+  pnode = LOCK_NODE(proot, tree);
+
+  if(!proot->sle_in_tree ||
+     (plow != NULL && lock_tree_cmp(tree, plow, proot) >= 0) ||
+     (phigh != NULL && lock_tree_cmp(tree, proot, phigh) >= 0) ||
+     (pnode->sln_left != NULL && pnode->sln_left->sle_priority > proot->sle_priority) ||
+     (pnode->sln_right != NULL && pnode->sln_right->sle_priority > proot->sle_priority))
+    return -1;
+
+  nb_left = lock_tree_verify(tree, pnode->sln_left, plow, proot);
+  nb_right = lock_tree_verify(tree, pnode->sln_right, proot, phigh);
+
+  if(nb_left < 0 || nb_right < 0)
+    return -1;
+
+  saved = *pnode;
+  lock_tree_update(tree, proot);
+
+  if(saved.sln_max_end != pnode->sln_max_end ||
+     saved.sln_has_w != pnode->sln_has_w ||
+     saved.sln_max_end_w != pnode->sln_max_end_w)
+    return -1;
+
+  return nb_left + nb_right + 1;
+}
+
+static state_lock_entry_t **lock_tree_root(cache_inode_lock_trees_t * ptrees,
+                                           state_lock_tree_t          tree)
+{
+  if(tree == STATE_LOCK_BY_OWNER)
+    return &ptrees->by_owner;
+  else
+    return &ptrees->by_range;
+}
+
+/**
+ *
+ * state_lock_tree_insert: adds a granted lock to the lock trees of its file.
+ *
+ * @param ptrees      [INOUT] lock trees of the file
+ * @param plock_entry [INOUT] lock to add, not yet in the trees
+ *
+ */
+void state_lock_tree_insert(cache_inode_lock_trees_t * ptrees,
+                            state_lock_entry_t       * plock_entry)
+{
+  state_lock_tree_t tree;
+
+  /* xorshift32, seeded with a non zero value */
+  if(ptrees->seed == 0)
+    ptrees->seed = 2463534242U;
+  ptrees->seed ^= ptrees->seed << 13;
+  ptrees->seed ^= ptrees->seed >> 17;
+  ptrees->seed ^= ptrees->seed << 5;
+
+  plock_entry->sle_priority = ptrees->seed;
+
+  for(tree = STATE_LOCK_BY_RANGE; tree < STATE_LOCK_NB_TREES; tree++)
+    *lock_tree_root(ptrees, tree) =
+        lock_tree_insert(tree, *lock_tree_root(ptrees, tree), plock_entry);
+
+  /* The lock list links may now be used for temporary lists */
+  init_glist(&plock_entry->sle_list);
+  plock_entry->sle_in_tree = TRUE;
+  ptrees->nb_locks += 1;
+}                               /* state_lock_tree_insert */
+
+/**
+ *
+ * state_lock_tree_remove: removes a lock from the lock trees of its file.
+ *
+ * @param ptrees      [INOUT] lock trees of the file
+ * @param plock_entry [INOUT] lock to remove, its range must not have changed
+ *                            since it was added
+ *
+ */
+void state_lock_tree_remove(cache_inode_lock_trees_t * ptrees,
+                            state_lock_entry_t       * plock_entry)
+{
+  state_lock_tree_t tree;
+
+  for(tree = STATE_LOCK_BY_RANGE; tree < STATE_LOCK_NB_TREES; tree++)
+    *lock_tree_root(ptrees, tree) =
+        lock_tree_remove(tree, *lock_tree_root(ptrees, tree), plock_entry);
+
+  plock_entry->sle_in_tree = FALSE;
+  ptrees->nb_locks -= 1;
+}                               /* state_lock_tree_remove */
+
+/**
+ *
+ * state_lock_tree_search: looks for a granted lock overlapping a range.
+ *
+ * Calls match on the locks overlapping [start, end] in the order of the
+ * tree until it returns TRUE. match must not change the trees.
+ *
+ * @param ptrees      [IN] lock trees of the file
+ * @param powner      [IN] only look at the locks of this very owner, or NULL
+ * @param start       [IN] first byte of the range
+ * @param end         [IN] last byte of the range
+ * @param writes_only [IN] only look at the write locks
+ * @param match       [IN] condition on the locks, NULL matches any lock
+ * @param arg         [IN] passed to match
+ *
+ * @return the lock match returned TRUE for, or NULL.
+ *
+ */
+state_lock_entry_t *state_lock_tree_search(cache_inode_lock_trees_t * ptrees,
+                                           state_owner_t            * powner,
+                                           uint64_t                   start,
+                                           uint64_t                   end,
+                                           bool_t                     writes_only,
+                                           state_lock_match_t         match,
+                                           void                     * arg)
+{
+  state_lock_query_t query;
+
+  query.tree = powner != NULL ? STATE_LOCK_BY_OWNER : STATE_LOCK_BY_RANGE;
+  query.powner = powner;
+  query.start = start;
+  query.end = end;
+  query.writes_only = writes_only;
+  query.match = match;
+  query.arg = arg;
+
+  return lock_tree_search(&query, *lock_tree_root(ptrees, query.tree));
+}                               /* state_lock_tree_search */
+
+/**
+ *
+ * state_lock_tree_verify: checks the consistency of the lock trees of a file.
+ *
+ * @param ptrees [IN] lock trees of the file
+ *
+ * @return 0 if both trees hold nb_locks locks in order, with the right
+ * priorities and lock ends, -1 otherwise.
+ *
+ */
+int state_lock_tree_verify(cache_inode_lock_trees_t * ptrees)
+{
+  state_lock_tree_t tree;
+
+  for(tree = STATE_LOCK_BY_RANGE; tree < STATE_LOCK_NB_TREES; tree++)
+    if(lock_tree_verify(tree, *lock_tree_root(ptrees, tree), NULL, NULL) !=
+       (int) ptrees->nb_locks)
+      return -1;
+
+  return 0;
+}                               /* state_lock_tree_verify */
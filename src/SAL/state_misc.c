@@ -101,6 +101,7 @@ const char *state_err_str(state_status_t err)
       case STATE_FILE_BIG:              return "STATE_FILE_BIG";
       case STATE_GRACE_PERIOD:          return "STATE_GRACE_PERIOD";
       case STATE_CACHE_INODE_ERR:       return "STATE_CACHE_INODE_ERR";
+      case STATE_DELEG_RECALLED:        return "STATE_DELEG_RECALLED";
     }
   return "unknown";
 }
@@ -377,6 +378,7 @@ nfsstat4 nfs4_Errno_state(state_status_t error)
       break;
 
     case STATE_FSAL_DELAY:
+    case STATE_DELEG_RECALLED:
       nfserror = NFS4ERR_DELAY;
       break;
 
@@ -520,6 +522,7 @@ nfsstat3 nfs3_Errno_state(state_status_t error)
       break;
 
     case STATE_FSAL_DELAY:
+    case STATE_DELEG_RECALLED:
       nfserror = NFS3ERR_JUKEBOX;
       break;
 
@@ -673,6 +676,7 @@ nfsstat2 nfs2_Errno_state(state_status_t error)
     case STATE_LOCK_DEADLOCK:
     case STATE_NOT_SUPPORTED:
     case STATE_FSAL_DELAY:
+    case STATE_DELEG_RECALLED:
     case STATE_BAD_COOKIE:
     case STATE_FILE_BIG:
     case STATE_GRACE_PERIOD:
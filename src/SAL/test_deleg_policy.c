@@ -0,0 +1,290 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    test_deleg_policy.c
+ * \brief   Benchmark of the delegation policy on a simulated build tree.
+ *
+ * A build client compiles nb_sources sources, each of them including
+ * NB_INCLUDES headers among NB_HEADERS, the first ones being the most
+ * popular, and writes an object file per source. The tree is built twice, as
+ * a full build followed by an incremental one. Meanwhile an editor client
+ * rewrites a header every EDIT_PERIOD sources.
+ *
+ * Each OPEN of the build client costs an OPEN, a GETATTR (close to open
+ * revalidation) and a CLOSE, unless the client holds a delegation of the
+ * file: it then opens it and trusts its cached attributes locally. Grants go
+ * through state_deleg_wanted and recalls through state_conflict, as in
+ * state_deleg_grant and state_add. A recall costs a CB_RECALL, a DELEGRETURN
+ * and the OPEN of the editor answered with NFS4ERR_DELAY.
+ *
+ * Usage: test_deleg_policy [nb_sources]
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs4.h"
+#include "nfs_core.h"
+#include "cache_inode.h"
+#include "sal_functions.h"
+
+#define NB_SOURCES_DEFAULT 2000
+#define NB_HEADERS         500
+#define NB_INCLUDES        40
+#define NB_BUILDS          2
+#define EDIT_PERIOD        50
+
+#define BUILD_CLIENT  1
+#define EDITOR_CLIENT 2
+
+typedef struct test_counters__
+{
+  unsigned long open;
+  unsigned long getattr;
+  unsigned long close;
+  unsigned long write;
+  unsigned long cb_recall;
+  unsigned long delegreturn;
+  unsigned long grants;
+} test_counters_t;
+
+typedef struct test_file__
+{
+  cache_inode_deleg_heuristics_t heur;
+  state_t deleg;                /* The delegation of the build client, if held */
+  int held;
+} test_file_t;
+
+extern nfs_parameter_t nfs_param;
+
+static unsigned int test_seed = 12345;
+
+static unsigned int test_rand(void)
+{
+  test_seed = test_seed * 1103515245 + 12345;
+  return (test_seed >> 16) & 0x7fff;
+}                               /* test_rand */
+
+/* Headers near 0 are included much more often than the others */
+static unsigned int test_pick_header(void)
+{
+  unsigned int r = test_rand() % NB_HEADERS;
+
+  return (r * (test_rand() % NB_HEADERS)) / NB_HEADERS;
+}                               /* test_pick_header */
+
+static void test_open_read(test_file_t * pfile, int use_deleg, time_t now,
+                           test_counters_t * pcount)
+{
+  if(pfile->held)
+    return;
+
+  pcount->open += 1;
+  pcount->getattr += 1;
+  pcount->close += 1;
+
+  if(use_deleg &&
+     state_deleg_wanted(&pfile->heur, BUILD_CLIENT, OPEN4_SHARE_ACCESS_READ, now))
+    {
+      memset(&pfile->deleg, 0, sizeof(state_t));
+      pfile->deleg.state_type = STATE_TYPE_DELEG;
+      pfile->deleg.state_data.deleg.d_type = OPEN_DELEGATE_READ;
+      pfile->held = TRUE;
+      pcount->grants += 1;
+    }
+}                               /* test_open_read */
+
+static void test_open_write(test_file_t * pfile, clientid4 clientid, int use_deleg,
+                            time_t now, test_counters_t * pcount)
+{
+  state_data_t candidate;
+
+  memset(&candidate, 0, sizeof(candidate));
+  candidate.share.share_access = OPEN4_SHARE_ACCESS_WRITE;
+  candidate.share.share_deny = OPEN4_SHARE_DENY_NONE;
+
+  if(pfile->held && state_conflict(&pfile->deleg, STATE_TYPE_SHARE, &candidate))
+    {
+      /* Recalled, the OPEN is answered NFS4ERR_DELAY and retried */
+      pcount->open += 1;
+      pcount->cb_recall += 1;
+      pcount->delegreturn += 1;
+      pfile->heur.last_recall = now;
+      pfile->heur.nb_opens = 0;
+      pfile->held = FALSE;
+    }
+
+  if(use_deleg)
+    state_deleg_wanted(&pfile->heur, clientid, OPEN4_SHARE_ACCESS_WRITE, now);
+
+  pcount->open += 1;
+  pcount->write += 1;
+  pcount->close += 1;
+}                               /* test_open_write */
+
+static void test_build(unsigned int nb_sources, int use_deleg, test_counters_t * pcount)
+{
+  test_file_t *files;
+  test_file_t object;
+  unsigned int build, src, inc;
+  time_t now = 1000000;
+
+  files = (test_file_t *) calloc(NB_HEADERS + nb_sources, sizeof(test_file_t));
+  if(files == NULL)
+    {
+      fprintf(stderr, "Can't allocate %u files\n", NB_HEADERS + nb_sources);
+      exit(1);
+    }
+
+  memset(&object, 0, sizeof(object));
+  memset(pcount, 0, sizeof(test_counters_t));
+  test_seed = 12345;
+
+  for(build = 0; build < NB_BUILDS; build++)
+    for(src = 0; src < nb_sources; src++)
+      {
+        /* One second per translation unit */
+        now += 1;
+
+        test_open_read(&files[NB_HEADERS + src], use_deleg, now, pcount);
+
+        for(inc = 0; inc < NB_INCLUDES; inc++)
+          test_open_read(&files[test_pick_header()], use_deleg, now, pcount);
+
+        test_open_write(&object, BUILD_CLIENT, use_deleg, now, pcount);
+
+        if(src % EDIT_PERIOD == EDIT_PERIOD - 1)
+          test_open_write(&files[test_pick_header()], EDITOR_CLIENT, use_deleg,
+                          now, pcount);
+      }
+
+  free(files);
+}                               /* test_build */
+
+static unsigned long test_total(test_counters_t * pcount)
+{
+  return pcount->open + pcount->getattr + pcount->close + pcount->write +
+      pcount->cb_recall + pcount->delegreturn;
+}                               /* test_total */
+
+static void test_print(char *name, test_counters_t * pcount)
+{
+  printf("%-18s %9lu %9lu %9lu %7lu %9lu %11lu %9lu\n", name,
+         pcount->open, pcount->getattr, pcount->close, pcount->write,
+         pcount->cb_recall, pcount->delegreturn, test_total(pcount));
+}                               /* test_print */
+
+/* The conflicts state_add relies on */
+static int test_conflicts(void)
+{
+  state_t deleg;
+  state_data_t data;
+  int rc = 0;
+
+  memset(&deleg, 0, sizeof(deleg));
+  deleg.state_type = STATE_TYPE_DELEG;
+  deleg.state_data.deleg.d_type = OPEN_DELEGATE_READ;
+
+  memset(&data, 0, sizeof(data));
+  data.share.share_access = OPEN4_SHARE_ACCESS_READ;
+  if(state_conflict(&deleg, STATE_TYPE_SHARE, &data))
+    {
+      fprintf(stderr, "a read OPEN recalls a read delegation\n");
+      rc = 1;
+    }
+
+  data.share.share_deny = OPEN4_SHARE_DENY_READ;
+  if(!state_conflict(&deleg, STATE_TYPE_SHARE, &data))
+    {
+      fprintf(stderr, "a DENY_READ OPEN does not recall a read delegation\n");
+      rc = 1;
+    }
+
+  data.share.share_access = OPEN4_SHARE_ACCESS_WRITE;
+  data.share.share_deny = OPEN4_SHARE_DENY_NONE;
+  if(!state_conflict(&deleg, STATE_TYPE_SHARE, &data))
+    {
+      fprintf(stderr, "a write OPEN does not recall a read delegation\n");
+      rc = 1;
+    }
+
+  deleg.state_data.deleg.d_revoked = TRUE;
+  if(state_conflict(&deleg, STATE_TYPE_SHARE, &data))
+    {
+      fprintf(stderr, "a revoked delegation is recalled\n");
+      rc = 1;
+    }
+
+  return rc;
+}                               /* test_conflicts */
+
+int main(int argc, char *argv[])
+{
+  unsigned int nb_sources = NB_SOURCES_DEFAULT;
+  test_counters_t without, with;
+  unsigned long before, after;
+
+  if(argc > 1)
+    nb_sources = atoi(argv[1]);
+
+  SetNamePgm("test_deleg_policy");
+  SetDefaultLogging("TEST");
+  SetNameFunction("main");
+  InitLogging();
+
+  nfs_param.nfsv4_param.lease_lifetime = 60;
+  nfs_param.nfsv4_param.allow_delegations = TRUE;
+
+  if(test_conflicts())
+    exit(1);
+
+  test_build(nb_sources, FALSE, &without);
+  test_build(nb_sources, TRUE, &with);
+
+  printf("%u sources, %u headers, %u includes per source, %u builds, an edit every %u sources\n",
+         nb_sources, NB_HEADERS, NB_INCLUDES, NB_BUILDS, EDIT_PERIOD);
+  printf("%-18s %9s %9s %9s %7s %9s %11s %9s\n", "", "OPEN", "GETATTR", "CLOSE",
+         "WRITE", "CB_RECALL", "DELEGRETURN", "total");
+  test_print("no delegation", &without);
+  test_print("read delegations", &with);
+  printf("%lu delegations granted\n", with.grants);
+
+  before = without.open + without.getattr;
+  after = with.open + with.getattr;
+  printf("OPEN+GETATTR: %lu -> %lu (-%.1f%%), all round trips: %lu -> %lu (-%.1f%%)\n",
+         before, after, 100.0 * (before - after) / before,
+         test_total(&without), test_total(&with),
+         100.0 * (test_total(&without) - test_total(&with)) / test_total(&without));
+
+  if(test_total(&with) >= test_total(&without))
+    {
+      fprintf(stderr, "Delegations do not save any round trip\n");
+      exit(1);
+    }
+
+  exit(0);
+}                               /* main */
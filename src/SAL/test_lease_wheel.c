@@ -0,0 +1,201 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    test_lease_wheel.c
+ * \brief   Check of the lease timing wheel on a simulated clock.
+ *
+ * nb_clients clients come and go, each of them renewing its lease at random
+ * intervals, sometimes longer than the lease lifetime, and the reaper runs
+ * every second of a simulated clock, sometimes late by a few seconds. A
+ * model of the leases tells how many of them the reaper must expire each
+ * time: those not renewed within the lifetime, no sooner and no later. The
+ * check is done with a lifetime spread over the first level of the wheel and
+ * with one spread over the second level.
+ *
+ * Usage: test_lease_wheel [nb_clients]
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs4.h"
+#include "nfs_core.h"
+#include "cache_inode.h"
+#include "sal_functions.h"
+
+#define NB_CLIENTS_DEFAULT 2000
+#define LATE_PERIOD        97   /* the reaper is late every LATE_PERIOD seconds */
+#define LATE_DELAY         7
+
+typedef struct test_client__
+{
+  time_t start;                 /* first renewal */
+  time_t stop;                  /* no renewal after it */
+  time_t next_renew;
+  time_t deadline;              /* of the model, 0 when not leased */
+} test_client_t;
+
+extern nfs_parameter_t nfs_param;
+extern void nfs_set_param_default();
+
+static time_t test_now;
+
+static time_t test_clock(time_t * t)
+{
+  if(t != NULL)
+    *t = test_now;
+
+  return test_now;
+}                               /* test_clock */
+
+/* Runs the wheel with a lease lifetime, returns the number of errors */
+static unsigned int test_lifetime(test_client_t * clients, unsigned int nb_clients,
+                                  clientid4 base, time_t lifetime)
+{
+  unsigned int i;
+  unsigned int expected, expired;
+  unsigned long nb_leases = 0, nb_expired = 0;
+  unsigned int nb_errors = 0;
+  time_t end = test_now + 6 * lifetime;    /* all the clients stopped and expired */
+  unsigned long tick = 0;
+
+  nfs_param.nfsv4_param.lease_lifetime = lifetime;
+
+  for(i = 0; i < nb_clients; i++)
+    {
+      clients[i].start = test_now + 1 + random() % lifetime;
+      clients[i].stop = clients[i].start + random() % (3 * lifetime);
+      clients[i].next_renew = clients[i].start;
+      clients[i].deadline = 0;
+    }
+
+  while(test_now < end)
+    {
+      test_now += (++tick % LATE_PERIOD) == 0 ? LATE_DELAY : 1;
+
+      for(i = 0; i < nb_clients; i++)
+        {
+          if(clients[i].next_renew > test_now || clients[i].next_renew > clients[i].stop)
+            continue;
+
+          if(clients[i].deadline == 0)
+            nb_leases++;
+
+          nfs4_lease_renew(base + i);
+          clients[i].deadline = test_now + lifetime + 1;
+
+          /* Sometimes later than the lease lifetime */
+          clients[i].next_renew = test_now + 1 + random() % (lifetime + lifetime / 4);
+        }
+
+      expected = 0;
+      for(i = 0; i < nb_clients; i++)
+        if(clients[i].deadline != 0 && clients[i].deadline <= test_now)
+          {
+            clients[i].deadline = 0;
+            expected++;
+          }
+
+      expired = nfs4_lease_reap(NULL, NULL);
+      nb_expired += expired;
+
+      if(expired != expected)
+        {
+          fprintf(stderr, "lifetime %ld, time %ld: %u leases expired, %u expected\n",
+                  (long)lifetime, (long)test_now, expired, expected);
+          nb_errors++;
+        }
+    }
+
+  if(nb_expired != nb_leases)
+    {
+      fprintf(stderr, "lifetime %ld: %lu leases never expired\n",
+              (long)lifetime, nb_leases - nb_expired);
+      nb_errors++;
+    }
+
+  printf("lifetime %5lds: %lu leases, %lu expired, %u errors\n",
+         (long)lifetime, nb_leases, nb_expired, nb_errors);
+
+  return nb_errors;
+}                               /* test_lifetime */
+
+int main(int argc, char *argv[])
+{
+  unsigned int nb_clients = NB_CLIENTS_DEFAULT;
+  test_client_t *clients;
+  unsigned int nb_errors = 0;
+
+  if(argc > 1)
+    nb_clients = atoi(argv[1]);
+
+  SetNamePgm("test_lease_wheel");
+  SetDefaultLogging("TEST");
+  SetNameFunction("main");
+  InitLogging();
+  SetComponentLogLevel(COMPONENT_STATE, NIV_CRIT);
+
+#ifndef _NO_BUDDY_SYSTEM
+  if(BuddyInit(NULL) != BUDDY_SUCCESS)
+    {
+      fprintf(stderr, "Memory manager could not be initialized\n");
+      exit(1);
+    }
+#endif
+
+  /* The reaper forgets the client ids of the expired clients */
+  nfs_set_param_default();
+  if(nfs_Init_client_id(nfs_param.client_id_param) != 0 ||
+     nfs_Init_client_id_reverse(nfs_param.client_id_param) != 0)
+    {
+      fprintf(stderr, "Client id cache could not be initialized\n");
+      exit(1);
+    }
+
+  if((clients = (test_client_t *) malloc(nb_clients * sizeof(test_client_t))) == NULL)
+    exit(1);
+
+  srandom(1);
+
+  /* Not aligned on a slot of any level */
+  test_now = 1234567;
+  nfs4_lease_set_clock(test_clock);
+  nfs4_lease_init(test_now);
+
+  nb_errors += test_lifetime(clients, nb_clients, 1, 90);
+  nb_errors += test_lifetime(clients, nb_clients, 1 + nb_clients, 5000);
+
+  free(clients);
+
+  if(nb_errors != 0)
+    {
+      fprintf(stderr, "%u errors\n", nb_errors);
+      exit(1);
+    }
+
+  exit(0);
+}                               /* main */
@@ -0,0 +1,604 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    test_state_lock.c
+ * \brief   Stress test of the byte-range lock manager.
+ *
+ * Drives state_lock, state_test, state_unlock, state_owner_unlock_all and
+ * state_nlm_notify the way the NLM and NFSv4 lock operations do, with NLM
+ * owners of a same client and NFSv4 lock owners:
+ *
+ * - random LOCK/LOCKT/LOCKU on a small range of a file, each result being
+ *   checked against a byte per byte model of the locks, and the lock trees
+ *   against the model and for consistency;
+ *
+ * - LOCKT/LOCK/LOCKU next to the nb_records record locks of a database
+ *   owner, timed for growing numbers of records;
+ *
+ * - NB_THREADS threads locking and unlocking records in their own parts of
+ *   a same file, none of which may conflict.
+ *
+ * The FSAL and cache inode calls of the lock manager are replaced by the
+ * functions below, which grant every lock: only the lock lists of the
+ * server are tested.
+ *
+ * Usage: test_state_lock [nb_records] [nb_ops]
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs_core.h"
+#include "cache_inode.h"
+#include "sal_functions.h"
+#include "MesureTemps.h"
+
+#define NB_RECORDS_DEFAULT 100000
+#define NB_OPS_DEFAULT     200000
+#define MODEL_SIZE         256
+#define MODEL_MAX_LEN      32
+#define NB_NLM_OWNERS      4
+#define NB_NFS4_OWNERS     4
+#define NB_OWNERS          (NB_NLM_OWNERS + NB_NFS4_OWNERS)
+#define NB_THREADS         16
+#define THREAD_RECORDS     1000
+
+#define MODEL_R 1
+#define MODEL_W 2
+
+static state_nlm_client_t test_nlm_client;
+static state_owner_t test_owners[NB_OWNERS];
+static unsigned char test_model[NB_OWNERS][MODEL_SIZE];
+static fsal_op_context_t test_context;
+static cache_inode_client_t test_client;
+
+/* The file system used by the test: every lock is granted */
+
+cache_inode_status_t cache_inode_open(cache_entry_t * pentry,
+                                      cache_inode_client_t * pclient,
+                                      fsal_openflags_t openflags,
+                                      fsal_op_context_t * pcontext,
+                                      cache_inode_status_t * pstatus)
+{
+  *pstatus = CACHE_INODE_SUCCESS;
+  return *pstatus;
+}                               /* cache_inode_open */
+
+fsal_file_t *cache_inode_fd(cache_entry_t * pentry)
+{
+  return &pentry->object.file.open_fd.fd;
+}                               /* cache_inode_fd */
+
+fsal_status_t FSAL_lock_op(fsal_file_t * p_file_descriptor,
+                           fsal_handle_t * p_filehandle,
+                           fsal_op_context_t * p_context,
+                           void *p_owner,
+                           fsal_lock_op_t lock_op,
+                           fsal_lock_param_t request_lock,
+                           fsal_lock_param_t * conflicting_lock)
+{
+  fsal_status_t status = { ERR_FSAL_NO_ERROR, 0 };
+
+  return status;
+}                               /* FSAL_lock_op */
+
+fsal_status_t FSAL_DigestHandle(fsal_export_context_t * p_expcontext,
+                                fsal_digesttype_t output_type,
+                                fsal_handle_t * in_fsal_handle, caddr_t out_buff)
+{
+  fsal_status_t status = { ERR_FSAL_NO_ERROR, 0 };
+
+  memset(out_buff, 0, sizeof(uint64_t));
+  return status;
+}                               /* FSAL_DigestHandle */
+
+static cache_entry_t *test_new_file(void)
+{
+  cache_entry_t *pentry = (cache_entry_t *) calloc(1, sizeof(cache_entry_t));
+
+  if(pentry == NULL)
+    {
+      LogTest("Can't allocate a file");
+      exit(1);
+    }
+
+  init_glist(&pentry->object.file.lock_list);
+  pthread_mutex_init(&pentry->object.file.lock_list_mutex, NULL);
+
+  return pentry;
+}                               /* test_new_file */
+
+static void test_init_owner(state_owner_t * powner, state_owner_type_t type, int id)
+{
+  memset(powner, 0, sizeof(*powner));
+  powner->so_type = type;
+  init_glist(&powner->so_lock_list);
+  pthread_mutex_init(&powner->so_mutex, NULL);
+
+  /* Held by the test, the owners are never released */
+  powner->so_refcount = 1;
+  powner->so_owner_len = sprintf(powner->so_owner_val, "test owner %d", id);
+
+  if(type == STATE_LOCK_OWNER_NLM)
+    {
+      powner->so_owner.so_nlm_owner.so_client = &test_nlm_client;
+      powner->so_owner.so_nlm_owner.so_nlm_svid = id;
+    }
+  else
+    powner->so_owner.so_nfs4_owner.so_clientid = id;
+}                               /* test_init_owner */
+
+static void test_init_owners(void)
+{
+  int i;
+
+  memset(&test_nlm_client, 0, sizeof(test_nlm_client));
+  pthread_mutex_init(&test_nlm_client.slc_mutex, NULL);
+  init_glist(&test_nlm_client.slc_lock_list);
+  test_nlm_client.slc_refcount = 1;
+  test_nlm_client.slc_nlm_caller_name_len =
+      sprintf(test_nlm_client.slc_nlm_caller_name, "nlmclient");
+
+  for(i = 0; i < NB_NLM_OWNERS; i++)
+    test_init_owner(&test_owners[i], STATE_LOCK_OWNER_NLM, i);
+
+  for(i = NB_NLM_OWNERS; i < NB_OWNERS; i++)
+    test_init_owner(&test_owners[i], STATE_LOCK_OWNER_NFSV4, i);
+}                               /* test_init_owners */
+
+static void test_random_lock(state_lock_desc_t * plock)
+{
+  plock->sld_type = random() % 2 ? STATE_LOCK_W : STATE_LOCK_R;
+  plock->sld_offset = random() % (MODEL_SIZE - MODEL_MAX_LEN);
+
+  /* Sometimes up to the end of file, the only locks going past the model */
+  if(random() % 20 == 0)
+    plock->sld_length = 0;
+  else
+    plock->sld_length = 1 + random() % MODEL_MAX_LEN;
+}                               /* test_random_lock */
+
+static uint64_t test_model_end(state_lock_desc_t * plock)
+{
+  if(plock->sld_length == 0 || plock->sld_offset + plock->sld_length > MODEL_SIZE)
+    return MODEL_SIZE;
+
+  return plock->sld_offset + plock->sld_length;
+}                               /* test_model_end */
+
+static int test_model_conflict(int owner, state_lock_desc_t * plock)
+{
+  uint64_t i;
+  int o;
+
+  for(o = 0; o < NB_OWNERS; o++)
+    {
+      if(o == owner)
+        continue;
+
+      for(i = plock->sld_offset; i < test_model_end(plock); i++)
+        if((test_model[o][i] & MODEL_W) ||
+           (plock->sld_type == STATE_LOCK_W && test_model[o][i] != 0))
+          return TRUE;
+    }
+
+  return FALSE;
+}                               /* test_model_conflict */
+
+static void test_model_set(int owner, state_lock_desc_t * plock, int lock)
+{
+  uint64_t i;
+
+  for(i = plock->sld_offset; i < test_model_end(plock); i++)
+    {
+      if(!lock)
+        test_model[owner][i] = 0;
+      else if(plock->sld_type == STATE_LOCK_W)
+        test_model[owner][i] |= MODEL_W;
+      else
+        test_model[owner][i] |= MODEL_R;
+    }
+}                               /* test_model_set */
+
+static int test_has_type(state_lock_entry_t * plock_entry, void *arg)
+{
+  return plock_entry->sle_lock.sld_type == *(state_lock_type_t *) arg;
+}                               /* test_has_type */
+
+/* Compares the locks of each owner in the trees with the model */
+static int test_check_model(cache_entry_t * pentry)
+{
+  state_lock_type_t type;
+  int owner, held;
+  uint64_t i;
+
+  for(owner = 0; owner < NB_OWNERS; owner++)
+    for(i = 0; i < MODEL_SIZE; i++)
+      {
+        held = 0;
+
+        type = STATE_LOCK_R;
+        if(state_lock_tree_search(&pentry->object.file.lock_trees, &test_owners[owner],
+                                  i, i, FALSE, test_has_type, &type) != NULL)
+          held |= MODEL_R;
+
+        type = STATE_LOCK_W;
+        if(state_lock_tree_search(&pentry->object.file.lock_trees, &test_owners[owner],
+                                  i, i, TRUE, test_has_type, &type) != NULL)
+          held |= MODEL_W;
+
+        if(held != test_model[owner][i])
+          {
+            LogTest("ERROR: owner %d holds %d at %llu, the model says %d",
+                    owner, held, (unsigned long long) i, test_model[owner][i]);
+            return 1;
+          }
+      }
+
+  return 0;
+}                               /* test_check_model */
+
+static int test_random_ops(unsigned int nb_ops)
+{
+  cache_entry_t *pentry = test_new_file();
+  state_lock_desc_t lock, conflict;
+  state_owner_t *holder;
+  state_status_t status;
+  unsigned int op, nb_conflicts = 0;
+  int owner, expected, r;
+
+  memset(test_model, 0, sizeof(test_model));
+
+  for(op = 0; op < nb_ops; op++)
+    {
+      owner = random() % NB_OWNERS;
+      test_random_lock(&lock);
+      expected = test_model_conflict(owner, &lock);
+      r = random() % 100;
+
+      if(r < 40)
+        {
+          state_lock(pentry, &test_context, &test_owners[owner], NULL,
+                     STATE_NON_BLOCKING, NULL, &lock, &holder, &conflict,
+                     &test_client, &status);
+
+          if(status == STATE_LOCK_CONFLICT)
+            state_release_lock_owner(holder);
+          else if(status == STATE_SUCCESS)
+            test_model_set(owner, &lock, TRUE);
+
+          if(status != (expected ? STATE_LOCK_CONFLICT : STATE_SUCCESS))
+            {
+              LogTest("ERROR: op %u LOCK returned %s, %s expected", op,
+                      state_err_str(status), expected ? "a conflict" : "success");
+              return 1;
+            }
+        }
+      else if(r < 60)
+        {
+          state_test(pentry, &test_context, &test_owners[owner], &lock, &holder,
+                     &conflict, &test_client, &status);
+
+          if(status == STATE_LOCK_CONFLICT)
+            state_release_lock_owner(holder);
+
+          if(status != (expected ? STATE_LOCK_CONFLICT : STATE_SUCCESS))
+            {
+              LogTest("ERROR: op %u LOCKT returned %s, %s expected", op,
+                      state_err_str(status), expected ? "a conflict" : "success");
+              return 1;
+            }
+        }
+      else if(r < 95)
+        {
+          state_unlock(pentry, &test_context, &test_owners[owner], NULL, &lock,
+                       &test_client, &status);
+          test_model_set(owner, &lock, FALSE);
+        }
+      else if(r < 98)
+        {
+          /* RELEASE_LOCKOWNER */
+          owner = NB_NLM_OWNERS + random() % NB_NFS4_OWNERS;
+          state_owner_unlock_all(&test_context, &test_owners[owner], NULL,
+                                 &test_client, &status);
+          memset(test_model[owner], 0, MODEL_SIZE);
+        }
+      else
+        {
+          /* SM_NOTIFY of the NLM client */
+          state_nlm_notify(&test_context, &test_nlm_client, &test_client, &status);
+          memset(test_model, 0, NB_NLM_OWNERS * MODEL_SIZE);
+        }
+
+      if(status != STATE_SUCCESS && status != STATE_LOCK_CONFLICT)
+        {
+          LogTest("ERROR: op %u returned %s", op, state_err_str(status));
+          return 1;
+        }
+
+      if(expected)
+        nb_conflicts++;
+
+      if(state_lock_tree_verify(&pentry->object.file.lock_trees) != 0)
+        {
+          LogTest("ERROR: op %u left inconsistent lock trees", op);
+          return 1;
+        }
+
+      if(op % 100 == 99 && test_check_model(pentry) != 0)
+        return 1;
+    }
+
+  LogTest("random ops : OK, %u ops, %u conflicts, %u locks left",
+          nb_ops, nb_conflicts, pentry->object.file.lock_trees.nb_locks);
+
+  return 0;
+}                               /* test_random_ops */
+
+static int test_records(unsigned int nb_records, unsigned int nb_ops)
+{
+  cache_entry_t *pentry = test_new_file();
+  state_owner_t *pdatabase = &test_owners[NB_NLM_OWNERS];
+  state_owner_t *pother = &test_owners[0];
+  state_lock_desc_t lock, conflict;
+  state_owner_t *holder;
+  state_status_t status;
+  struct Temps debut, fin;
+  unsigned int i, nb_locked = 0, step;
+  double secs;
+
+  lock.sld_type = STATE_LOCK_W;
+  lock.sld_length = 1;
+
+  for(step = 1000; nb_locked < nb_records; step *= 10)
+    {
+      /* The database locks every other byte */
+      for(; nb_locked < step && nb_locked < nb_records; nb_locked++)
+        {
+          lock.sld_offset = 2 * (uint64_t) nb_locked;
+          if(state_lock(pentry, &test_context, pdatabase, NULL, STATE_NON_BLOCKING, NULL,
+                        &lock, &holder, &conflict, &test_client,
+                        &status) != STATE_SUCCESS)
+            {
+              LogTest("ERROR: record %u not locked: %s", nb_locked, state_err_str(status));
+              return 1;
+            }
+        }
+
+      /* Another owner tests a record, then locks and unlocks the next byte */
+      MesureTemps(&debut, NULL);
+      for(i = 0; i < nb_ops; i += 3)
+        {
+          lock.sld_offset = 2 * (uint64_t) (random() % nb_locked);
+          if(state_test(pentry, &test_context, pother, &lock, &holder, &conflict,
+                        &test_client, &status) != STATE_LOCK_CONFLICT)
+            {
+              LogTest("ERROR: no conflict on record %llu",
+                      (unsigned long long) lock.sld_offset);
+              return 1;
+            }
+          state_release_lock_owner(holder);
+
+          lock.sld_offset += 1;
+          if(state_lock(pentry, &test_context, pother, NULL, STATE_NON_BLOCKING, NULL,
+                        &lock, &holder, &conflict, &test_client,
+                        &status) != STATE_SUCCESS ||
+             state_unlock(pentry, &test_context, pother, NULL, &lock, &test_client,
+                          &status) != STATE_SUCCESS)
+            {
+              LogTest("ERROR: between records: %s", state_err_str(status));
+              return 1;
+            }
+        }
+      MesureTemps(&fin, &debut);
+      secs = fin.secondes + fin.micro_secondes / 1000000.0;
+
+      LogTest("%8u records : %.0f ns per LOCKT/LOCK/LOCKU", nb_locked,
+              nb_ops ? secs * 1e9 / nb_ops : 0.0);
+
+      if(state_lock_tree_verify(&pentry->object.file.lock_trees) != 0 ||
+         pentry->object.file.lock_trees.nb_locks != nb_locked)
+        {
+          LogTest("ERROR: inconsistent lock trees with %u records", nb_locked);
+          return 1;
+        }
+    }
+
+  state_owner_unlock_all(&test_context, pdatabase, NULL, &test_client, &status);
+
+  if(pentry->object.file.lock_trees.nb_locks != 0)
+    {
+      LogTest("ERROR: %u records left after unlock all",
+              pentry->object.file.lock_trees.nb_locks);
+      return 1;
+    }
+
+  free(pentry);
+  return 0;
+}                               /* test_records */
+
+typedef struct test_thread_arg__
+{
+  cache_entry_t *pentry;
+  state_owner_t owner;
+  unsigned int id;
+  unsigned int nb_ops;
+  int rc;
+} test_thread_arg_t;
+
+static void *test_thread(void *arg)
+{
+  test_thread_arg_t *parg = (test_thread_arg_t *) arg;
+  state_lock_desc_t lock, conflict;
+  state_owner_t *holder;
+  state_status_t status;
+  unsigned int i, seed = parg->id;
+  uint64_t base = (uint64_t) parg->id * THREAD_RECORDS * 2;
+
+  SetNameFunction("test_thread");
+
+  for(i = 0; i < parg->nb_ops; i++)
+    {
+      lock.sld_type = rand_r(&seed) % 2 ? STATE_LOCK_W : STATE_LOCK_R;
+      lock.sld_offset = base + rand_r(&seed) % (THREAD_RECORDS * 2);
+      lock.sld_length = 1 + rand_r(&seed) % 4;
+
+      if(lock.sld_offset + lock.sld_length > base + THREAD_RECORDS * 2)
+        lock.sld_length = base + THREAD_RECORDS * 2 - lock.sld_offset;
+
+      if(rand_r(&seed) % 2)
+        state_lock(parg->pentry, &test_context, &parg->owner, NULL, STATE_NON_BLOCKING,
+                   NULL, &lock, &holder, &conflict, &test_client, &status);
+      else
+        state_unlock(parg->pentry, &test_context, &parg->owner, NULL, &lock,
+                     &test_client, &status);
+
+      if(status != STATE_SUCCESS)
+        {
+          LogTest("ERROR: thread %u got %s", parg->id, state_err_str(status));
+          parg->rc = 1;
+          return NULL;
+        }
+    }
+
+  state_owner_unlock_all(&test_context, &parg->owner, NULL, &test_client, &status);
+
+  parg->rc = 0;
+  return NULL;
+}                               /* test_thread */
+
+static int test_threads(unsigned int nb_ops)
+{
+  cache_entry_t *pentry = test_new_file();
+  test_thread_arg_t args[NB_THREADS];
+  pthread_t threads[NB_THREADS];
+  struct Temps debut, fin;
+  double secs;
+  unsigned int i;
+  int rc = 0;
+
+  MesureTemps(&debut, NULL);
+
+  for(i = 0; i < NB_THREADS; i++)
+    {
+      args[i].pentry = pentry;
+      args[i].id = i;
+      args[i].nb_ops = nb_ops / NB_THREADS;
+      test_init_owner(&args[i].owner, STATE_LOCK_OWNER_NFSV4, 100 + i);
+
+      if(pthread_create(&threads[i], NULL, test_thread, &args[i]) != 0)
+        {
+          LogTest("Can't create thread %u", i);
+          exit(1);
+        }
+    }
+
+  for(i = 0; i < NB_THREADS; i++)
+    {
+      pthread_join(threads[i], NULL);
+      rc |= args[i].rc;
+    }
+
+  MesureTemps(&fin, &debut);
+  secs = fin.secondes + fin.micro_secondes / 1000000.0;
+
+  if(rc == 0 &&
+     (state_lock_tree_verify(&pentry->object.file.lock_trees) != 0 ||
+      pentry->object.file.lock_trees.nb_locks != 0))
+    {
+      LogTest("ERROR: %u locks left by the threads", pentry->object.file.lock_trees.nb_locks);
+      rc = 1;
+    }
+
+  if(rc == 0)
+    free(pentry);
+
+  if(rc == 0)
+    LogTest("threads : OK, %u threads, %.0f ops/s", NB_THREADS,
+            secs > 0 ? nb_ops / secs : 0.0);
+
+  return rc;
+}                               /* test_threads */
+
+int main(int argc, char *argv[])
+{
+  unsigned int nb_records = NB_RECORDS_DEFAULT;
+  unsigned int nb_ops = NB_OPS_DEFAULT;
+  state_status_t status;
+#ifdef _USE_BLOCKING_LOCKS
+  hash_parameter_t cookie_param;
+#endif
+
+  if(argc > 1)
+    nb_records = atoi(argv[1]);
+  if(argc > 2)
+    nb_ops = atoi(argv[2]);
+
+  SetNamePgm("test_state_lock");
+  SetDefaultLogging("TEST");
+  SetNameFunction("main");
+  InitLogging();
+
+#ifdef _USE_BLOCKING_LOCKS
+  /* As in nfs_set_param_default, no cookie is used by the test */
+  memset(&cookie_param, 0, sizeof(cookie_param));
+  cookie_param.index_size = PRIME_STATE_ID;
+  cookie_param.alphabet_length = 10;
+  cookie_param.nb_node_prealloc = NB_PREALLOC_HASH_STATE_ID;
+  cookie_param.hash_func_key = lock_cookie_value_hash_func;
+  cookie_param.hash_func_rbt = lock_cookie_rbt_hash_func;
+  cookie_param.compare_key = compare_lock_cookie_key;
+  cookie_param.key_to_str = display_lock_cookie_key;
+  cookie_param.val_to_str = display_lock_cookie_val;
+  cookie_param.name = "Lock Cookie";
+
+  if(state_lock_init(&status, cookie_param) != STATE_SUCCESS)
+#else
+  if(state_lock_init(&status) != STATE_SUCCESS)
+#endif
+    {
+      LogTest("Can't init the lock manager: %s", state_err_str(status));
+      exit(1);
+    }
+
+  srandom(1);
+  memset(&test_context, 0, sizeof(test_context));
+  memset(&test_client, 0, sizeof(test_client));
+  test_init_owners();
+
+  if(test_random_ops(nb_ops) != 0)
+    exit(1);
+
+  if(test_records(nb_records, nb_ops) != 0)
+    exit(1);
+
+  if(test_threads(nb_ops) != 0)
+    exit(1);
+
+  exit(0);
+}                               /* main */
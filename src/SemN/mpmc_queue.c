@@ -0,0 +1,400 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    mpmc_queue.c
+ * \brief   Bounded multi-producer multi-consumer queue with a parking owner.
+ *
+ * Each cell of the ring carries a sequence number telling whether it may be
+ * filled (seq == position) or read (seq == position + 1). A producer claims a
+ * position by moving the tail with a compare and swap, fills the cell, then
+ * publishes it by updating its sequence number. Readers claim a position the
+ * same way on the head: the owner of the queue is usually alone to do so, but
+ * idle threads may steal from it.
+ *
+ * The consumer parks on the 'sleeping' word (a futex on Linux, a condition
+ * variable elsewhere). It sets the word before checking the tail one last time,
+ * and the producers read it after their compare and swap, which is a full
+ * barrier: either the consumer sees the new request, or the producer sees the
+ * consumer asleep and wakes it up.
+ *
+ * Producers finding the ring full park on the 'full' word the same way: they
+ * set it before trying to push one last time, and the readers check it after
+ * giving a cell back.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <limits.h>
+#ifdef LINUX
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+#include "mpmc_queue.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+/* Stores are not reordered with other stores, nor loads with other loads */
+#define mpmc_release_barrier() __asm__ __volatile__("":::"memory")
+#define mpmc_acquire_barrier() __asm__ __volatile__("":::"memory")
+#else
+#define mpmc_release_barrier() __sync_synchronize()
+#define mpmc_acquire_barrier() __sync_synchronize()
+#endif
+
+#ifdef LINUX
+#ifndef FUTEX_WAIT_PRIVATE
+#define FUTEX_WAIT_PRIVATE FUTEX_WAIT
+#define FUTEX_WAKE_PRIVATE FUTEX_WAKE
+#endif
+
+static void mpmc_park(mpmc_queue_t * q)
+{
+  /* Returns at once if the word is no longer 1, spurious returns are fine */
+  syscall(SYS_futex, &q->sleeping, FUTEX_WAIT_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static void mpmc_unpark(mpmc_queue_t * q)
+{
+  syscall(SYS_futex, &q->sleeping, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static void mpmc_park_full(mpmc_queue_t * q)
+{
+  syscall(SYS_futex, &q->full, FUTEX_WAIT_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static void mpmc_unpark_full(mpmc_queue_t * q)
+{
+  /* Several producers may be waiting, each retries its push */
+  syscall(SYS_futex, &q->full, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+#else
+static void mpmc_park(mpmc_queue_t * q)
+{
+  pthread_mutex_lock(&q->park_mutex);
+  while(q->sleeping)
+    pthread_cond_wait(&q->park_cond, &q->park_mutex);
+  pthread_mutex_unlock(&q->park_mutex);
+}
+
+static void mpmc_unpark(mpmc_queue_t * q)
+{
+  pthread_mutex_lock(&q->park_mutex);
+  pthread_cond_signal(&q->park_cond);
+  pthread_mutex_unlock(&q->park_mutex);
+}
+
+static void mpmc_park_full(mpmc_queue_t * q)
+{
+  pthread_mutex_lock(&q->park_mutex);
+  while(q->full)
+    pthread_cond_wait(&q->full_cond, &q->park_mutex);
+  pthread_mutex_unlock(&q->park_mutex);
+}
+
+static void mpmc_unpark_full(mpmc_queue_t * q)
+{
+  pthread_mutex_lock(&q->park_mutex);
+  pthread_cond_broadcast(&q->full_cond);
+  pthread_mutex_unlock(&q->park_mutex);
+}
+#endif                          /* LINUX */
+
+/**
+ *
+ * mpmc_queue_init: initializes a queue.
+ *
+ * @param q    [OUT] the queue to be initialized.
+ * @param size [IN]  the number of cells, rounded up to a power of 2.
+ *
+ * @return 0 if successful, an errno value otherwise.
+ *
+ */
+int mpmc_queue_init(mpmc_queue_t * q, unsigned int size)
+{
+  unsigned int nb_cells = 2;
+  unsigned int i;
+
+  if(q == NULL || size == 0)
+    return EINVAL;
+
+  while(nb_cells < size)
+    nb_cells <<= 1;
+
+  if((q->cells = (mpmc_cell_t *) malloc(nb_cells * sizeof(mpmc_cell_t))) == NULL)
+    return ENOMEM;
+
+  for(i = 0; i < nb_cells; i++)
+    {
+      q->cells[i].seq = i;
+      q->cells[i].data = NULL;
+    }
+
+  q->mask = nb_cells - 1;
+  q->tail = 0;
+  q->head = 0;
+  q->sleeping = 0;
+  q->kicked = 0;
+  q->full = 0;
+
+#ifndef LINUX
+  if(pthread_mutex_init(&q->park_mutex, NULL) != 0)
+    return errno;
+  if(pthread_cond_init(&q->park_cond, NULL) != 0)
+    return errno;
+  if(pthread_cond_init(&q->full_cond, NULL) != 0)
+    return errno;
+#endif
+
+  return 0;
+}                               /* mpmc_queue_init */
+
+/**
+ *
+ * mpmc_queue_destroy: releases the resources of a queue.
+ *
+ * The queue must not be used anymore. Pending pointers are dropped.
+ *
+ * @param q [INOUT] the queue to be destroyed.
+ *
+ * @return nothing (void function)
+ *
+ */
+void mpmc_queue_destroy(mpmc_queue_t * q)
+{
+  free(q->cells);
+  q->cells = NULL;
+
+#ifndef LINUX
+  pthread_mutex_destroy(&q->park_mutex);
+  pthread_cond_destroy(&q->park_cond);
+  pthread_cond_destroy(&q->full_cond);
+#endif
+}                               /* mpmc_queue_destroy */
+
+/**
+ *
+ * mpmc_queue_push: appends a pointer to a queue. May be called by any thread.
+ *
+ * @param q    [INOUT] the queue.
+ * @param data [IN]    the pointer to be queued.
+ *
+ * @return 0 if successful, -1 if the queue is full.
+ *
+ */
+int mpmc_queue_push(mpmc_queue_t * q, void *data)
+{
+  mpmc_cell_t *cell;
+  unsigned int pos;
+  unsigned int seq;
+  int dif;
+
+  pos = q->tail;
+  for(;;)
+    {
+      cell = &q->cells[pos & q->mask];
+      seq = cell->seq;
+      mpmc_acquire_barrier();
+      dif = (int)(seq - pos);
+
+      if(dif == 0)
+        {
+          if(__sync_bool_compare_and_swap(&q->tail, pos, pos + 1))
+            break;
+        }
+      else if(dif < 0)
+        {
+          /* No reader has freed this cell yet: the ring is full */
+          return -1;
+        }
+
+      /* Another producer took this position */
+      pos = q->tail;
+    }
+
+  cell->data = data;
+  mpmc_release_barrier();
+  cell->seq = pos + 1;
+
+  if(q->sleeping && __sync_bool_compare_and_swap(&q->sleeping, 1, 0))
+    mpmc_unpark(q);
+
+  return 0;
+}                               /* mpmc_queue_push */
+
+/**
+ *
+ * mpmc_queue_push_wait: appends a pointer to a queue, parking while the queue
+ * is full. May be called by any thread but the owner of the queue, which
+ * would wait for itself.
+ *
+ * @param q    [INOUT] the queue.
+ * @param data [IN]    the pointer to be queued.
+ *
+ * @return the number of times the caller parked, 0 if the queue had room.
+ *
+ */
+int mpmc_queue_push_wait(mpmc_queue_t * q, void *data)
+{
+  int nb_waits = 0;
+
+  while(mpmc_queue_push(q, data) != 0)
+    {
+      q->full = 1;
+      __sync_synchronize();
+
+      /* A reader may have made room before seeing the word */
+      if(mpmc_queue_push(q, data) == 0)
+        break;
+
+      mpmc_park_full(q);
+      nb_waits++;
+    }
+
+  return nb_waits;
+}                               /* mpmc_queue_push_wait */
+
+/**
+ *
+ * mpmc_queue_pop: removes the oldest pointer of a queue. May be called by any
+ * thread, the owner of the queue or a thread stealing work from it.
+ *
+ * @param q [INOUT] the queue.
+ *
+ * @return the pointer, or NULL if nothing was published yet.
+ *
+ */
+void *mpmc_queue_pop(mpmc_queue_t * q)
+{
+  mpmc_cell_t *cell;
+  unsigned int pos;
+  unsigned int seq;
+  int dif;
+  void *data;
+
+  pos = q->head;
+  for(;;)
+    {
+      cell = &q->cells[pos & q->mask];
+      seq = cell->seq;
+      mpmc_acquire_barrier();
+      dif = (int)(seq - (pos + 1));
+
+      if(dif == 0)
+        {
+          if(__sync_bool_compare_and_swap(&q->head, pos, pos + 1))
+            break;
+        }
+      else if(dif < 0)
+        {
+          /* Empty, or the producer of this cell has not published it yet */
+          return NULL;
+        }
+
+      /* Another reader took this position */
+      pos = q->head;
+    }
+
+  data = cell->data;
+  mpmc_release_barrier();
+
+  /* Give the cell back to the producers, one lap ahead */
+  cell->seq = pos + q->mask + 1;
+
+  /* Read the word after the cell is given back: either a producer parking on
+   * a full ring sees the room, or it is woken up here */
+  __sync_synchronize();
+  if(q->full && __sync_bool_compare_and_swap(&q->full, 1, 0))
+    mpmc_unpark_full(q);
+
+  return data;
+}                               /* mpmc_queue_pop */
+
+/**
+ *
+ * mpmc_queue_length: number of pointers queued (claimed by a producer and not
+ * popped yet). The value may be stale by the time it is used.
+ *
+ * @param q [IN] the queue.
+ *
+ * @return the number of queued pointers.
+ *
+ */
+unsigned int mpmc_queue_length(mpmc_queue_t * q)
+{
+  unsigned int head = q->head;
+
+  /* Read the head first: readers may move it while the tail is read, but
+   * never past the tail, so the difference cannot wrap */
+  mpmc_acquire_barrier();
+  return q->tail - head;
+}                               /* mpmc_queue_length */
+
+/**
+ *
+ * mpmc_queue_wait: parks the consumer. Consumer only.
+ *
+ * With MPMC_WAIT_DATA, returns when the queue is not empty or after a call to
+ * mpmc_queue_wakeup. With MPMC_WAIT_KICK, only mpmc_queue_wakeup matters, a
+ * push may still end the wait early. In both cases the caller must check again
+ * what it was waiting for.
+ *
+ * @param q    [INOUT] the queue.
+ * @param what [IN]    MPMC_WAIT_DATA or MPMC_WAIT_KICK.
+ *
+ * @return nothing (void function)
+ *
+ */
+void mpmc_queue_wait(mpmc_queue_t * q, int what)
+{
+  q->sleeping = 1;
+  __sync_synchronize();
+
+  if(!q->kicked && (what == MPMC_WAIT_KICK || q->tail == q->head))
+    mpmc_park(q);
+
+  q->sleeping = 0;
+  q->kicked = 0;
+}                               /* mpmc_queue_wait */
+
+/**
+ *
+ * mpmc_queue_wakeup: wakes the consumer up, or prevents its next wait from
+ * blocking if it is not parked yet. May be called by any thread, typically
+ * after a change the consumer has to notice.
+ *
+ * @param q [INOUT] the queue.
+ *
+ * @return nothing (void function)
+ *
+ */
+void mpmc_queue_wakeup(mpmc_queue_t * q)
+{
+  q->kicked = 1;
+  __sync_synchronize();
+
+  if(q->sleeping && __sync_bool_compare_and_swap(&q->sleeping, 1, 0))
+    mpmc_unpark(q);
+}                               /* mpmc_queue_wakeup */
@@ -32,7 +32,7 @@ syn region affect matchgroup=Quote start=/=/ end=/;/ skip=/ / contains=value_.*
 syn match keyname "\I\i*" contained contains=known_keyname
 
 " Known parameters for GANESHA
-syn keyword known_keyname contained Alphabet_Length Attr_Expiration_Time Cache_Directory Core_Dump_Size DebugLevel Df_HighWater Df_LowWater DirData_Prealloc_PoolSize Directory_Expiration_Time Directory_Lifetime Drop_IO_Errors Drop_Inval_Errors Dump_Stats_Per_Client DupReq_Expiration Emergency_Grace_Delay Entry_Prealloc_PoolSize Entry_Prealloc_PoolSize Expiration_Time FH_Expire File_Lifetime Inactivity_Before_Flush Index_Size KeytabPath LRU_DupReq_Prealloc_PoolSize LRU_Nb_Call_Gc_invalid LRU_Nb_Call_Gc_invalid LRU_Pending_Job_Prealloc_PoolSize LRU_Prealloc_PoolSize LRU_Prealloc_PoolSize Lease_Lifetime Lifetime LogFile MNT_Port MNT_Program Map Map Max_Fd NFS_Port NFS_Program NbEntries_HighWater NbEntries_LowWater Nb_Before_GC Nb_Call_Before_GC Nb_Call_Before_GC Nb_Client_Id_Prealloc Nb_DupReq_Before_GC Nb_DupReq_Prealloc Nb_IP_Stats_Prealloc Nb_MaxConcurrentGC Nb_Worker OpenFile_Retention ParentData_Prealloc_PoolSize Pending_Job_Prealloc Prealloc_Node_Pool_Size Prealloc_Node_Pool_Size PrincipalName Refresh_FSAL_Force Returns_ERR_FH_EXPIRED Runtime_Interval State_v4_Prealloc_PoolSize Stats_File_Path Stats_Per_Client_Directory Stats_Update_Delay Symlink_Expiration_Time Use_Getattr_Directory_Invalidation Use_OpenClose_cache Use_Test_Access AuthMech BusyDelay BusyRetries CredentialLifetime DB_Host DB_Login DB_Name DB_Port DB_keytab DebugLevel DebugPath Enable_Extra_Alloc Enable_GC Enable_OnDemand_Alloc Export_FSAL_calls_detail Export_buddy_stats Export_cache_inode_calls_detail Export_cache_stats Export_maps_stats Export_nfs_calls_detail Export_requests_stats GC_Keep_Factor GC_Keep_Min KeytabPath LogFile MaxConnections Max_FS_calls NFS_Port NFS_Proto NFS_RecvSize NFS_SendSize NFS_Service NumRetries Open_by_FH_Working_Dir Page_Size PrincipalName Product_Id Retry_SleepTime ReturnInconsistentDirent Snmp_Agentx_Socket Snmp_adm_log Srv_Addr auth_phrase auth_proto auth_xdev_export cansettime client_name community dot_dot_root enable_descriptions enc_phrase enc_proto fs_root_group fs_root_mode fs_root_owner link_support maxread maxwrite microsec_timeout nb_retries predefined_dir snmp_getbulk_count snmp_server snmp_version symlink_support umask username Access Access_Type Anonymous_root_uid Cache_Data Export_id FS_Specific Filesystem_id MaxCacheSize MaxOffsetRead MaxOffsetWrite MaxRead MaxWrite NFS_Protocols NOSGID NOSUID Path PrefRead PrefReaddir PrefWrite PrivilegedPort Pseudo Root_Access SecType Tag Transport_Protocols
+syn keyword known_keyname contained Affinity_Max_Pending Alphabet_Length Async_Log Async_Log_Overflow Async_Log_Ring_Size Attr_Expiration_Time Backend Cache_Directory Core_Dump_Size DebugLevel Df_HighWater Df_LowWater DirData_Prealloc_PoolSize Directory_Expiration_Time Directory_Lifetime Drop_IO_Errors Drop_Inval_Errors Dump_Stats_Per_Client DupReq_Expiration Emergency_Grace_Delay Entry_Prealloc_PoolSize Entry_Prealloc_PoolSize Expiration_Time FH_Expire File_Lifetime Inactivity_Before_Flush Index_Size KeytabPath LRU_DupReq_Prealloc_PoolSize LRU_Nb_Call_Gc_invalid LRU_Nb_Call_Gc_invalid LRU_Pending_Job_Prealloc_PoolSize Pending_Queue_Size LRU_Prealloc_PoolSize LRU_Prealloc_PoolSize Lease_Lifetime Lifetime LogFile MNT_Port MNT_Program Map Map Max_Fd NFS_Port NFS_Program NbEntries_HighWater NbEntries_LowWater Nb_Before_GC Nb_Call_Before_GC Nb_Call_Before_GC Nb_Client_Id_Prealloc Nb_DupReq_Before_GC Nb_DupReq_Prealloc Nb_IP_Stats_Prealloc Nb_MaxConcurrentGC Nb_Worker OpenFile_Retention ParentData_Prealloc_PoolSize Pending_Job_Prealloc Prealloc_Node_Pool_Size Prealloc_Node_Pool_Size PrincipalName Refresh_FSAL_Force Returns_ERR_FH_EXPIRED Runtime_Interval State_v4_Prealloc_PoolSize Stats_File_Path Stats_Per_Client_Directory Stats_Update_Delay Symlink_Expiration_Time Use_Getattr_Directory_Invalidation Unstable_Flush_Delay Unstable_Write_Budget Use_OpenClose_cache Use_Test_Access AuthMech BusyDelay BusyRetries CredentialLifetime DB_Host DB_Login DB_Name DB_Port DB_keytab DebugLevel DebugPath Enable_Extra_Alloc Enable_GC Enable_OnDemand_Alloc Export_FSAL_calls_detail Export_buddy_stats Export_cache_inode_calls_detail Export_cache_stats Export_maps_stats Export_nfs_calls_detail Export_requests_stats GC_Keep_Factor GC_Keep_Min KeytabPath LogFile MaxConnections Max_FS_calls NFS_Port NFS_Proto NFS_RecvSize NFS_SendSize NFS_Service NumRetries Open_by_FH_Working_Dir Page_Size PrincipalName Product_Id Retry_SleepTime ReturnInconsistentDirent Snmp_Agentx_Socket Snmp_adm_log Srv_Addr auth_phrase auth_proto auth_xdev_export cansettime client_name community dot_dot_root enable_descriptions enc_phrase enc_proto fs_root_group fs_root_mode fs_root_owner link_support maxread maxwrite microsec_timeout nb_retries predefined_dir snmp_getbulk_count snmp_server snmp_version symlink_support umask username Access Access_Type Anonymous_root_uid Cache_Data Export_id FS_Specific Filesystem_id MaxCacheSize MaxOffsetRead MaxOffsetWrite MaxRead MaxWrite NFS_Protocols NOSGID NOSUID Path PrefRead PrefReaddir PrefWrite PrivilegedPort Pseudo Root_Access SecType Tag Transport_Protocols
 
 " Block
 syn region block start=/{/ end=/}/ contains=affect,comment,keyname
@@ -70,6 +70,9 @@
 #define FSAL_PROXY_SEND_BUFFER_SIZE   32768
 #define FSAL_PROXY_RECV_BUFFER_SIZE   32768
 #define FSAL_PROXY_NFS_V4             4
+
+#define FSAL_PROXY_BACKEND_CONNS      4
+#define FSAL_PROXY_MERGE_MAX_OPS      32
 #define FSAL_PROXY_RETRY_SLEEPTIME    10
 
 #include "fsal_glue_const.h"
@@ -170,6 +173,8 @@ typedef struct
   unsigned int srv_timeout;
   unsigned short srv_port;
   unsigned int use_privileged_client_port ;
+  unsigned int nb_backend_conns;   /* pool shared by the workers, 0 for one client per worker */
+  bool_t merge_compounds;
   char srv_proto[MAXNAMLEN];
   char local_principal[MAXNAMLEN];
   char remote_principal[MAXNAMLEN];
@@ -54,6 +54,12 @@
 
 typedef struct hashparameter__ *p_hash_parameter_t;
 
+typedef enum hash_backend__
+{
+  HASHTABLE_BACKEND_RBT = 0,    /**< Red-black trees, one rw-lock per tree (default). */
+  HASHTABLE_BACKEND_OPEN = 1    /**< Open addressing, lookups take no lock. */
+} hash_backend_t;
+
 typedef int (*ref_func)(void *);
 
 typedef struct hashparameter__
@@ -69,6 +75,7 @@ typedef struct hashparameter__
   int (*key_to_str) (hash_buffer_t *, char *);                                  /**< Function used to convert a key to a string. */
   int (*val_to_str) (hash_buffer_t *, char *);                                  /**< Function used to convert a value to a string. */
   char *name;                                                                   /**< Name of this hash table. */
+  hash_backend_t backend;                                                       /**< How the entries of an index are stored. */
 } hash_parameter_t;
 
 typedef unsigned long (*hash_function_t) (hash_parameter_t *, hash_buffer_t *);
@@ -113,6 +120,7 @@ typedef struct hashtable__
   rw_lock_t *array_lock;                /**< Array of rw-locks for MT-safe management */
   struct prealloc_pool *node_prealloc;  /**< Pre-allocated nodes, ready to use for new entries (array of size parameter.nb_node_prealloc) */
   struct prealloc_pool *pdata_prealloc; /**< Pre-allocated pdata buffers  ready to use for new entries */
+  struct hash_oa_segment__ *array_oa;   /**< Open addressing tables (of size parameter.index_size), for HASHTABLE_BACKEND_OPEN */
 } hash_table_t;
 
 typedef enum hashtable_set_how__
@@ -162,4 +170,31 @@ int HashTable_DelRef(hash_table_t * ht, hash_buffer_t * buffkey,
                      hash_buffer_t * p_usedbuffkey, hash_buffer_t * p_usedbuffdata,
                      int (*put_ref)(hash_buffer_t *) );
 
+int HashTable_Str2Backend(char *str, hash_backend_t * pbackend);
+
+/*
+ * Open addressing backend (HashTable_oa.c), called by the functions above once
+ * the hash values are computed.
+ *
+ * HashTable_Get and HashTable_Test_And_Set with HASHTABLE_SET_HOW_TEST_ONLY take
+ * no lock: they may compare the key against an entry that is being deleted, and
+ * retry once the writer is done. HashTable_Del and an overwriting HashTable_Set
+ * wait for such lookups before they return, so the key they removed can be
+ * freed then.
+ */
+int HashTable_OA_Init(hash_table_t * ht);
+int HashTable_OA_Test_And_Set(hash_table_t * ht, hash_buffer_t * buffkey,
+                              hash_buffer_t * buffval, hashtable_set_how_t how,
+                              unsigned int hashval, unsigned long rbt_value);
+int HashTable_OA_GetRef(hash_table_t * ht, hash_buffer_t * buffkey, hash_buffer_t * buffval,
+                        void (*get_ref)(hash_buffer_t *),
+                        unsigned int hashval, unsigned long rbt_value);
+int HashTable_OA_DelRef(hash_table_t * ht, hash_buffer_t * buffkey,
+                        hash_buffer_t * p_usedbuffkey, hash_buffer_t * p_usedbuffdata,
+                        int (*put_ref)(hash_buffer_t *),
+                        unsigned int hashval, unsigned long rbt_value);
+int HashTable_OA_Delall(hash_table_t * ht,
+                        int (*free_func)(hash_buffer_t, hash_buffer_t) );
+void HashTable_OA_Log(log_components_t component, hash_table_t * ht);
+
 #endif                          /* _HASHTABLE_H */
@@ -48,13 +48,26 @@
       LogFullDebug(COMPONENT_RW_LOCK, "  --> Error V: %d %d", rc, errno );  \
   } while (0)
 
-/* Type representing the lock itself */
+/* Type representing the lock itself.
+ *
+ * Readers first try to publish themselves in a process wide table of reader
+ * slots when rbias is set, which costs no write to the lock itself. Writers
+ * clear rbias and wait for the slots holding the lock to drain. Readers go
+ * through mutexProtect when the bias is off, and it is turned on again after
+ * RW_LOCK_BIAS_DELAY such readers in a row without any writer.
+ *
+ * seq is odd while a writer holds the lock, so that lockless readers can
+ * validate what they read with rw_lock_seq_begin and rw_lock_seq_retry.
+ */
 typedef struct _RW_LOCK
 {
   unsigned int nbr_active;
   unsigned int nbr_waiting;
   unsigned int nbw_active;
   unsigned int nbw_waiting;
+  unsigned int nbr_slow;
+  volatile unsigned int rbias;
+  volatile unsigned int seq;
   pthread_mutex_t mutexProtect;
   pthread_cond_t condWrite;
   pthread_cond_t condRead;
@@ -64,10 +77,13 @@ typedef struct _RW_LOCK
 int rw_lock_init(rw_lock_t * plock);
 int rw_lock_destroy(rw_lock_t * plock);
 int P_w(rw_lock_t * plock);
+int P_w_try(rw_lock_t * plock);
 int V_w(rw_lock_t * plock);
 int P_r(rw_lock_t * plock);
 int V_r(rw_lock_t * plock);
 int rw_lock_downgrade(rw_lock_t * plock);
 int rw_lock_upgrade(rw_lock_t * plock);
+int rw_lock_seq_begin(rw_lock_t * plock, unsigned int *pseq);
+int rw_lock_seq_retry(rw_lock_t * plock, unsigned int seq);
 
 #endif                          /* _RW_LOCK */
@@ -0,0 +1,76 @@
+/*
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    SlabAlloc.h
+ * \brief   Size-class slab allocator behind the preallocated pools.
+ *
+ * SlabAlloc: the preallocated pools of stuff_alloc.h (MakePool, GetFromPool,
+ * ReleaseToPool) get their entries from slab caches shared by every pool of
+ * the same entry size and constructor, instead of BuddyCalloc'ing a new block
+ * each time they run out of entries.
+ *
+ * The free list of a pool is the magazine of the thread using it: GetFromPool
+ * and ReleaseToPool never leave it, except to refill it with pa_num entries
+ * when it is empty (SlabFillPool) or to give pa_num entries back when it holds
+ * more than 2 * pa_num (SlabDrainPool), so that entries released by another
+ * thread than the one which got them do not pile up in its pools.
+ *
+ * Each slab cache has a depot per NUMA node. Slabs are filled (thus touched
+ * first) by a thread running on their node, and entries go back to the depot
+ * of their slab's node: to its free list if the releasing thread runs on the
+ * same node, to its lock-free remote-free queue otherwise.
+ *
+ */
+
+#ifndef _SLAB_ALLOC_H
+#define _SLAB_ALLOC_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* Number of NUMA node depots of a slab cache, higher nodes share them */
+#define SLAB_MAX_NODES   8
+
+/* Number of different slab caches (entry size and constructor couples) */
+#define SLAB_MAX_CACHES  128
+
+/* Size classes are multiple of a cache line, so that entries used by
+ * different threads never share one */
+#define SLAB_ALIGN       64
+
+/* Minimal size of a slab, slabs are aligned on their size */
+#define SLAB_SIZE_MIN    (64 * 1024)
+
+/* Minimal number of entries in a slab */
+#define SLAB_MIN_ENTRIES 16
+
+struct slab_cache;
+struct prealloc_pool;
+
+struct slab_cache *SlabCacheGet(size_t entry_size, void (*ctor) (void *entry));
+
+void SlabFillPool(struct prealloc_pool *pool);
+
+void SlabDrainPool(struct prealloc_pool *pool);
+
+void SlabDumpMem(FILE * output);
+
+#endif                          /* _SLAB_ALLOC_H */
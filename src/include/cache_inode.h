@@ -62,6 +62,7 @@
 #include "nlm4.h"
 #endif
 #include "nlm_list.h"
+#include "mpmc_queue.h"
 #ifdef _USE_NFS4_1
 #include "nfs41_session.h"
 #endif                          /* _USE_NFS4_1 */
@@ -87,8 +88,16 @@ typedef struct cache_inode_client_t cache_inode_client_t;
 /* #define CHILDREN_ARRAY_SIZE 64 */
 #define CHILDREN_ARRAY_SIZE 16
 #define NB_CHUNCK_READDIR 4     /* Should be equal to FSAL_READDIR_SIZE divided by CHILDREN_ARRAY_SIZE */
-
-#define CACHE_INODE_UNSTABLE_BUFFERSIZE 100*1024*1024
+#define CACHE_INODE_DIR_INDEX_MIN 64  /* Initial number of buckets of the name index of a directory */
+#define CACHE_INODE_DIR_CHUNKS_MIN 16 /* Initial size of the DIR_CONTINUE array of a directory */
+#define CACHE_INODE_GC_NB_SHARDS 32   /* Number of independently locked GC rings, a power of 2 */
+#define CACHE_INODE_GC_MAX_REF   3    /* Saturation of the per entry reference counter of the GC */
+#define CACHE_INODE_GC_BATCH     64   /* Entries chosen in a GC ring each time its lock is taken */
+
+#define CACHE_INODE_UNSTABLE_EXTENT_SIZE (1024*1024)     /* Dirty extents never cross a multiple of this size  */
+#define CACHE_INODE_UNSTABLE_EXTENT_MIN  (64*1024)       /* Smallest buffer allocated for a dirty extent       */
+#define CACHE_INODE_UNSTABLE_BUDGET      (256*1024*1024) /* Default memory budget for all the unstable writes  */
+#define CACHE_INODE_UNSTABLE_FLUSH_DELAY 1               /* Default idle time before dirty data is flushed     */
 #define DIR_ENTRY_NAMLEN 1024
 
 #define CACHE_INODE_TIME( pentry ) (pentry->internal_md.read_time > pentry->internal_md.mod_time)?pentry->internal_md.read_time:pentry->internal_md.mod_time
@@ -187,6 +196,8 @@ typedef struct cache_inode_client_parameter__
   time_t retention;                                    /**< Fd retention duration                            */
   unsigned int use_cache;                              /** Do we cache fd or not ?                           */
   unsigned int use_fsal_hash ;                         /** Do we rely on FSAL to hash handle or not ?        */
+  fsal_size_t unstable_budget;                         /**< Memory for unstable writes, shared by all files  */
+  time_t unstable_flush_delay;                         /**< Idle time before unstable writes are flushed     */
 } cache_inode_client_parameter_t;
 
 typedef struct cache_inode_opened_file__
@@ -265,13 +276,58 @@ struct cache_inode_symlink__
   fsal_path_t content;                                    /**< Content of the link */
 };
 
+typedef enum cache_inode_gc_state__
+{
+  CACHE_INODE_GC_DETACHED = 0,  /**< Not known by the GC                             */
+  CACHE_INODE_GC_RINGED   = 1,  /**< Linked in the ring of its GC shard              */
+  CACHE_INODE_GC_EVICTING = 2   /**< Chosen as a victim by the GC, out of its ring   */
+} cache_inode_gc_state_t;
+
+typedef struct cache_inode_gc_node__
+{
+  cache_entry_t *prev;                    /**< Previous entry in the ring of the GC shard     */
+  cache_entry_t *next;                    /**< Next entry in the ring of the GC shard         */
+  volatile unsigned int refcount;         /**< Accesses not yet aged by the clock hand        */
+  volatile cache_inode_gc_state_t state;  /**< Is the entry known by the GC ?                 */
+  cache_inode_client_t *powner;           /**< Client whose pools the entry was taken from    */
+  caddr_t recycle_key;                    /**< Hash key, given back to powner with the entry  */
+} cache_inode_gc_node_t;
+
+typedef struct cache_inode_unstable_extent__
+{
+  uint64_t offset;                                /**< Offset of the dirty range in the file              */
+  uint32_t length;                                /**< Length of the dirty range                          */
+  uint32_t capacity;                              /**< Size of the allocated buffer                       */
+  caddr_t buffer;                                 /**< Data not yet written to the FSAL                   */
+  struct cache_inode_unstable_extent__ *next;     /**< Next extent of the file, by increasing offsets     */
+} cache_inode_unstable_extent_t;
+
 typedef struct cache_inode_unstable_data__
 {
-  caddr_t buffer;
-  uint64_t offset;
-  uint32_t length;
+  cache_inode_unstable_extent_t *extents;         /**< Disjoint dirty ranges, sorted by offset            */
+  cache_entry_t *pentry;                          /**< The file these data belong to                      */
+  struct cache_inode_unstable_data__ *prev_dirty; /**< Previous file in the list of dirty files           */
+  struct cache_inode_unstable_data__ *next_dirty; /**< Next file in the list of dirty files               */
+  time_t last_write;                              /**< Epoch time of the last buffered write              */
+  unsigned int flush_pass;                        /**< Last flusher pass that visited the file            */
+  fsal_op_context_t context;                      /**< Credentials of the last writer, used to flush      */
 } cache_inode_unstable_data_t;
 
+typedef struct cache_inode_deleg_heuristics__
+{
+  uint64_t clientid;                              /**< Client which opened the file most recently         */
+  unsigned int nb_opens;                          /**< Number of read opens in a row by this client       */
+  time_t last_recall;                             /**< Epoch time of the last delegation recall (or 0)    */
+} cache_inode_deleg_heuristics_t;
+
+typedef struct cache_inode_lock_trees__
+{
+  struct state_lock_entry_t *by_range;            /**< Interval tree of the granted locks, by start        */
+  struct state_lock_entry_t *by_owner;            /**< Same locks, by owner then by start                  */
+  unsigned int nb_locks;                          /**< Number of granted locks                             */
+  unsigned int seed;                              /**< Source of the priorities of the tree nodes          */
+} cache_inode_lock_trees_t;
+
 struct cache_entry_t
 {
   union cache_inode_fsobj__
@@ -291,9 +347,11 @@ struct cache_entry_t
       void *pentry_content;                                          /**< Entry in file content cache (NULL if not cached)     */
       void *pstate_head;                                             /**< Pointer used for the head of the state chain         */
       void *pstate_tail;                                             /**< Current pointer for the state chain                  */
-      struct glist_head lock_list;                                   /**< Pointers for lock list                               */
-      pthread_mutex_t lock_list_mutex;                               /**< Mutex to protect lock list                           */
-      cache_inode_unstable_data_t unstable_data;                     /**< Unstable data, for use with WRITE/COMMIT             */
+      struct glist_head lock_list;                                   /**< Blocked lock requests, in arrival order              */
+      cache_inode_lock_trees_t lock_trees;                           /**< Granted locks (see SAL/state_lock_tree.c)            */
+      pthread_mutex_t lock_list_mutex;                               /**< Mutex to protect lock list and lock trees            */
+      cache_inode_unstable_data_t *unstable_data;                    /**< Unstable data, for use with WRITE/COMMIT (or NULL)   */
+      cache_inode_deleg_heuristics_t deleg_heuristics;               /**< Open history, used to decide on delegations          */
     } file;                                   /**< file related filed     */
 
     struct cache_inode_symlink__ symlink;     /**< symlink related field  */
@@ -309,6 +367,12 @@ struct cache_entry_t
       unsigned int nbdircont;                   /**< Number of DIR_CONT associated with the DIR_BEGIN        */
       cache_inode_flag_t has_been_readdir;      /**< True if a full readdir was performed on the directory   */
       char *referral;                           /**< NULL is not a referral, is not this a 'referral string' */
+      struct cache_inode_dir_entry__ **dir_index;   /**< Buckets of the name index of the active dirents         */
+      unsigned int dir_index_size;              /**< Number of buckets in dir_index, a power of 2 (0 if none) */
+      unsigned int dir_index_count;             /**< Number of dirents in dir_index                          */
+      struct cache_inode_dir_entry__ *pdir_free;    /**< Free dirent slots of the dir_chain, up to end of dir    */
+      cache_entry_t **pdir_chunks;              /**< DIR_CONTINUE of the dir_chain, by dir_cont_pos (cookie / CHILDREN_ARRAY_SIZE) */
+      unsigned int dir_chunks_size;             /**< Number of slots in pdir_chunks                          */
 
       struct cache_inode_dir_data__
       {
@@ -317,6 +381,9 @@ struct cache_entry_t
           cache_inode_entry_valid_state_t active;       /**< A flag to get the validity state for the direntry   */
           cache_entry_t *pentry;                        /**< Pointer to the cached entry (if direntry is active) */
           fsal_name_t name;                             /**< Name of the entry                                   */
+          unsigned int name_hash;                       /**< Hash of the name, for the name index                */
+          cache_entry_t *pdir_chain;                    /**< DIR_BEGINNING or DIR_CONTINUE holding this slot     */
+          struct cache_inode_dir_entry__ *next;         /**< Next dirent in the index bucket if active, next free slot if not */
         } dir_entries[CHILDREN_ARRAY_SIZE];             /**< Array of cached directory entries                   */
       } *pdir_data;
 
@@ -344,8 +411,7 @@ struct cache_entry_t
 
   rw_lock_t lock;                             /**< a reader-writter lock used to protect the data     */
   cache_inode_internal_md_t internal_md;      /**< My metadata (from this cache's point of view)      */
-  LRU_entry_t *gc_lru_entry;                  /**< related LRU entry in the LRU list used for GC      */
-  LRU_list_t *gc_lru;                         /**< related LRU list for GC                            */
+  cache_inode_gc_node_t gc_node;              /**< position of the entry in the GC                    */
 
   struct cache_inode_parent_entry__
   {
@@ -376,10 +442,13 @@ typedef struct cache_inode_fsal_data__
 
 #define SMALL_CLIENT_INDEX 0x20000000
 #define NLM_THREAD_INDEX   0x40000000
+#define LEASE_THREAD_INDEX 0x50000000
+#define GC_THREAD_INDEX    0x60000000
+#define FLUSH_THREAD_INDEX 0x70000000
 
 struct cache_inode_client_t
 {
-  LRU_list_t *lru_gc;                                              /**< Pointer to the worker's LRU used for Garbagge collection */
+  mpmc_queue_t gc_recycle;                                         /**< Entries reclaimed by the GC, to be put back in my pools  */
   struct prealloc_pool pool_entry;                                 /**< Worker's preallocad cache entries pool                   */
   struct prealloc_pool pool_dir_data;                              /**< Worker's preallocad cache directory data pool            */
   struct prealloc_pool pool_parent;                                /**< Pool of pointers to the parent entries                   */
@@ -435,6 +504,14 @@ typedef struct cache_inode_param_gc__
   unsigned int nb_to_be_purged;
 } cache_inode_param_gc_t;
 
+typedef struct cache_inode_gc_stat__
+{
+  unsigned int nb_ringed;                     /**< Number of entries in the GC rings                      */
+  unsigned int nb_passes;                     /**< Number of reclaim passes since startup                 */
+  unsigned int nb_evicted;                    /**< Number of entries reclaimed since startup              */
+  unsigned int nb_recycled;                   /**< Number of entries given back to their owner's pools    */
+} cache_inode_gc_stat_t;
+
 typedef union cache_inode_create_arg__
 {
   fsal_path_t link_content;
@@ -833,6 +910,9 @@ cache_inode_status_t cache_inode_renew_entry(cache_entry_t * pentry,
                                              fsal_op_context_t * pcontext,
                                              cache_inode_status_t * pstatus);
 
+int cache_inode_renew_needed(cache_entry_t * pentry,
+                             cache_inode_client_t * pclient, time_t now);
+
 cache_inode_status_t cache_inode_add_cached_dirent(cache_entry_t * pdir,
                                                    fsal_name_t * pname,
                                                    cache_entry_t * pentry_added,
@@ -852,6 +932,8 @@ cache_inode_status_t cache_inode_valid(cache_entry_t * pentry,
                                        cache_inode_op_t op,
                                        cache_inode_client_t * pclient);
 
+int cache_inode_valid_uptodate(cache_entry_t * pentry, time_t now);
+
 cache_inode_status_t cache_inode_invalidate_all_cached_dirent(cache_entry_t *
                                                               pentry_parent,
                                                               hash_table_t * ht,
@@ -860,9 +942,20 @@ cache_inode_status_t cache_inode_invalidate_all_cached_dirent(cache_entry_t *
                                                               cache_inode_status_t *
                                                               pstatus);
 
+cache_inode_status_t cache_inode_dirent_index_init(cache_entry_t * pentry_dir);
+
+void cache_inode_dirent_index_release(cache_entry_t * pentry_dir);
+
+struct cache_inode_dir_entry__ *cache_inode_dirent_index_find(cache_entry_t * pentry_dir,
+                                                              fsal_name_t * pname);
+
+void cache_inode_invalidate_dirent(cache_entry_t * pdir_chain, unsigned int slot);
+
 void cache_inode_set_attributes(cache_entry_t * pentry, fsal_attrib_list_t * pattr);
 
 void cache_inode_get_attributes(cache_entry_t * pentry, fsal_attrib_list_t * pattr);
+int cache_inode_get_attributes_lockless(cache_entry_t * pentry,
+                                        fsal_attrib_list_t * pattr);
 
 cache_inode_file_type_t cache_inode_fsal_type_convert(fsal_nodetype_t type);
 
@@ -892,6 +985,16 @@ cache_inode_status_t cache_inode_gc(hash_table_t * ht,
 cache_inode_status_t cache_inode_gc_fd(cache_inode_client_t * pclient,
                                        cache_inode_status_t * pstatus);
 
+void cache_inode_gc_init(void);
+void cache_inode_gc_touch(cache_entry_t * pentry);
+int cache_inode_gc_touched(cache_entry_t * pentry);
+void cache_inode_gc_forget(cache_entry_t * pentry);
+unsigned int cache_inode_gc_reclaim(hash_table_t * ht,
+                                    cache_inode_client_t * pclient,
+                                    unsigned int nb_to_be_purged);
+unsigned int cache_inode_gc_recycle(cache_inode_client_t * pclient);
+void cache_inode_gc_get_stat(cache_inode_gc_stat_t * pstat);
+
 cache_inode_status_t cache_inode_kill_entry(cache_entry_t * pentry,
                                             hash_table_t * ht,
                                             cache_inode_client_t * pclient,
@@ -905,6 +1008,26 @@ int cache_inode_gc_suppress_file(cache_entry_t * pentry,
 cache_inode_gc_policy_t cache_inode_get_gc_policy(void);
 void cache_inode_set_gc_policy(cache_inode_gc_policy_t policy);
 
+/* Write-behind of the unstable writes */
+void cache_inode_unstable_set_policy(fsal_size_t budget, time_t flush_delay);
+time_t cache_inode_unstable_get_flush_delay(void);
+int cache_inode_unstable_write(cache_entry_t * pentry,
+                               uint64_t offset,
+                               fsal_size_t length,
+                               caddr_t buffer,
+                               cache_inode_client_t * pclient,
+                               fsal_op_context_t * pcontext);
+cache_inode_status_t cache_inode_unstable_flush(cache_entry_t * pentry,
+                                                uint64_t offset,
+                                                fsal_size_t length,
+                                                cache_inode_client_t * pclient,
+                                                fsal_op_context_t * pcontext,
+                                                cache_inode_status_t * pstatus);
+void cache_inode_unstable_truncate(cache_entry_t * pentry, fsal_size_t length);
+void cache_inode_unstable_discard(cache_entry_t * pentry);
+unsigned int cache_inode_unstable_flush_pass(cache_inode_client_t * pclient);
+void cache_inode_unstable_wait(time_t seconds);
+
 /* Parsing functions */
 cache_inode_status_t cache_inode_read_conf_hash_parameter(config_file_t in_config,
                                                           cache_inode_parameter_t *
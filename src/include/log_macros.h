@@ -93,6 +93,17 @@ typedef struct cleanup_list_element
 void RegisterCleanup(cleanup_list_element *clean);
 void Cleanup(void);
 void Fatal(void);
+
+/* What a thread does when its asynchronous log ring is full */
+typedef enum log_overflow_policy
+{
+  LOG_OVERFLOW_DROP = 0,           /* Drop the message, drops are counted and reported */
+  LOG_OVERFLOW_BLOCK               /* Wait for the writer thread to make room */
+} log_overflow_policy_t;
+
+int StartAsyncLogging(unsigned int ring_size, log_overflow_policy_t policy);
+void LogFlush(void);
+
 int SetComponentLogFile(log_components_t component, char *name);
 void SetComponentLogBuffer(log_components_t component, char *buffer);
 void SetComponentLogLevel(log_components_t component, int level_to_set);
@@ -134,6 +145,13 @@ typedef struct log_component_info
   char *comp_buffer;
 } log_component_info;
 
+/* The verbose levels are usually off, keep their test out of the way */
+#ifdef __GNUC__
+#define log_unlikely(cond) __builtin_expect(!!(cond), 0)
+#else
+#define log_unlikely(cond) (cond)
+#endif
+
 #define ReturnLevelComponent(component) LogComponents[component].comp_log_level
 
 log_component_info __attribute__ ((__unused__)) LogComponents[COMPONENT_COUNT];
@@ -195,7 +213,7 @@ log_component_info __attribute__ ((__unused__)) LogComponents[COMPONENT_COUNT];
 
 #define LogInfo(component, format, args...) \
   do { \
-    if (LogComponents[component].comp_log_level >= NIV_INFO) \
+    if (log_unlikely(LogComponents[component].comp_log_level >= NIV_INFO)) \
       DisplayLogComponentLevel(component, (char *) __FUNCTION__, NIV_INFO, \
                                "%s: INFO: " format, \
                                LogComponents[component].comp_str, ## args ); \
@@ -203,7 +221,7 @@ log_component_info __attribute__ ((__unused__)) LogComponents[COMPONENT_COUNT];
 
 #define LogDebug(component, format, args...) \
   do { \
-    if (LogComponents[component].comp_log_level >= NIV_DEBUG) \
+    if (log_unlikely(LogComponents[component].comp_log_level >= NIV_DEBUG)) \
       DisplayLogComponentLevel(component,  (char *)__FUNCTION__, NIV_DEBUG, \
                                "%s: DEBUG: " format, \
                                LogComponents[component].comp_str, ## args ); \
@@ -211,7 +229,7 @@ log_component_info __attribute__ ((__unused__)) LogComponents[COMPONENT_COUNT];
 
 #define LogFullDebug(component, format, args...) \
   do { \
-    if (LogComponents[component].comp_log_level >= NIV_FULL_DEBUG) \
+    if (log_unlikely(LogComponents[component].comp_log_level >= NIV_FULL_DEBUG)) \
       DisplayLogComponentLevel(component, (char *)__FUNCTION__, NIV_FULL_DEBUG, \
                                "%s: FULLDEBUG: " format, \
                                LogComponents[component].comp_str, ## args ); \
@@ -0,0 +1,62 @@
+/**
+ *
+ * \file    mpmc_queue.h
+ * \brief   Bounded multi-producer multi-consumer queue with a parking owner.
+ *
+ * A fixed size ring of pointers. Any number of threads may push or pop, but
+ * only one thread (the owner of the queue) may wait on it: other threads pop
+ * to steal work from a busy owner. A push or a pop is a single compare and
+ * swap when it does not race, and never takes a lock. An idle owner parks in
+ * mpmc_queue_wait and is woken up by the next push or by mpmc_queue_wakeup.
+ * Producers finding the ring full may park in mpmc_queue_push_wait until a
+ * pop makes room.
+ *
+ */
+
+#ifndef _MPMC_QUEUE_H
+#define _MPMC_QUEUE_H
+
+#include <pthread.h>
+
+#define MPMC_CACHE_LINE 64
+
+/* What mpmc_queue_wait waits for */
+#define MPMC_WAIT_DATA 0        /**< something to pop, or a wakeup */
+#define MPMC_WAIT_KICK 1        /**< a wakeup only, the content is ignored */
+
+typedef struct mpmc_cell__
+{
+  volatile unsigned int seq;
+  void *data;
+} mpmc_cell_t;
+
+typedef struct mpmc_queue__
+{
+  mpmc_cell_t *cells;
+  unsigned int mask;                       /**< number of cells - 1, a power of 2 minus 1 */
+  char pad0[MPMC_CACHE_LINE];
+
+  volatile unsigned int tail;              /**< next cell to fill, moved by the producers */
+  char pad1[MPMC_CACHE_LINE];
+
+  volatile unsigned int head;              /**< next cell to read, moved by the readers */
+  volatile int sleeping;                   /**< the consumer is parked (futex word) */
+  volatile int kicked;                     /**< mpmc_queue_wakeup was called */
+  volatile int full;                       /**< producers are parked on a full ring (futex word) */
+#ifndef LINUX
+  pthread_mutex_t park_mutex;
+  pthread_cond_t park_cond;
+  pthread_cond_t full_cond;
+#endif
+} mpmc_queue_t;
+
+int mpmc_queue_init(mpmc_queue_t * q, unsigned int size);
+void mpmc_queue_destroy(mpmc_queue_t * q);
+int mpmc_queue_push(mpmc_queue_t * q, void *data);
+int mpmc_queue_push_wait(mpmc_queue_t * q, void *data);
+void *mpmc_queue_pop(mpmc_queue_t * q);
+unsigned int mpmc_queue_length(mpmc_queue_t * q);
+void mpmc_queue_wait(mpmc_queue_t * q, int what);
+void mpmc_queue_wakeup(mpmc_queue_t * q);
+
+#endif                          /* _MPMC_QUEUE_H */
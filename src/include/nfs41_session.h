@@ -57,6 +57,7 @@
 #include "config_parsing.h"
 #include "nfs23.h"
 #include "nfs4.h"
+#include "nlm_list.h"
 
 #define NFS41_SESSION_PER_CLIENT 3
 #define NFS41_NB_SLOTS           3
@@ -79,6 +80,7 @@ typedef struct nfs41_session__
   channel_attrs4 fore_channel_attrs;
   channel_attrs4 back_channel_attrs;
   nfs41_session_slot_t slots[NFS41_NB_SLOTS];
+  struct glist_head session_lease_list;  /* in the lease of the client */
 } nfs41_session_t;
 
 #endif                          /* _NFS41_SESSION_H */
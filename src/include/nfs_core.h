@@ -45,6 +45,7 @@
 
 #include "rpc.h"
 #include "LRU_List.h"
+#include "mpmc_queue.h"
 #include "fsal.h"
 #ifdef _USE_MFSL
 #include "mfsl.h"
@@ -62,6 +63,7 @@
 #include "mount.h"
 #include "nfs_proto_functions.h"
 #include "nfs_dupreq.h"
+#include "xdr_arena.h"
 #include "err_LRU_List.h"
 #include "err_HashTable.h"
 
@@ -83,20 +85,27 @@
 /* Maximum thread count */
 #define NB_MAX_WORKER_THREAD 4096
 #define NB_MAX_FLUSHER_THREAD 100
+#define NB_MAX_TCP_REACTOR_THREAD 256
+#define NB_MAX_UDP_RECEIVER_THREAD 64
 
 /* NFS daemon behavior default values */
 #define NB_WORKER_THREAD_DEFAULT  16
 #define NB_FLUSHER_THREAD_DEFAULT 16
-#define NB_REQUEST_BEFORE_QUEUE_AVG  1000
+#define NB_TCP_REACTOR_THREAD_DEFAULT 4
+#define NB_UDP_RECEIVER_THREAD_DEFAULT 4
+#define NB_AFFINITY_MAX_PENDING 8      /* pending requests before a client's worker is bypassed */
 #define NB_MAX_CONCURRENT_GC 3
 #define NB_MAX_PENDING_REQUEST 30
-#define NB_PREALLOC_LRU_WORKER 100
+#define NB_PENDING_QUEUE_SIZE 1024     /* cells in a worker's request queue */
 #define NB_REQUEST_BEFORE_GC 50
+#define NB_EPOLL_EVENTS_DISPATCHER 256  /* events fetched by one epoll_wait */
+#define NB_EPOLL_EVENTS_REACTOR 64      /* events fetched by one TCP reactor's epoll_wait */
+#define NB_UDP_RECV_BATCH 16            /* datagrams fetched by one recvmmsg */
 #define PRIME_DUPREQ 17         /* has to be a prime number */
+#define NB_DUPREQ_PER_CLIENT 64 /* has to be a power of 2 */
 #define PRIME_ID_MAPPER 17      /* has to be a prime number */
 #define DUPREQ_EXPIRATION 180
 #define NB_PREALLOC_HASH_DUPREQ 100
-#define NB_PREALLOC_LRU_DUPREQ 100
 #define NB_PREALLOC_GC_DUPREQ 100
 #define NB_PREALLOC_ID_MAPPER 200
 
@@ -148,6 +157,13 @@
 #define NFS_DEFAULT_SEND_BUFFER_SIZE 32768
 #define NFS_DEFAULT_RECV_BUFFER_SIZE 32768
 
+/* Default size of each thread's ring when logging asynchronously */
+#define NFS_DEFAULT_ASYNC_LOG_RING_SIZE (256 * 1024)
+
+/* Largest RPC record accepted on a connection served by a TCP reactor (1MB of
+ * WRITE payload plus the RPC and NFS headers) */
+#define NFS_MAX_TCP_RECORD_SIZE (1024 * 1024 + 65536)
+
 /* Default 'Raw Dev' values */
 #define GANESHA_RAW_DEV_MAJOR 168
 #define GANESHA_RAW_DEV_MINOR 168
@@ -226,10 +242,8 @@ typedef char path_str_t[MAXPATHLEN] ;
 
 typedef struct nfs_worker_param__
 {
-  LRU_parameter_t lru_param;
-  LRU_parameter_t lru_dupreq;
+  unsigned int nb_pending_queue_size;
   unsigned int nb_pending_prealloc;
-  unsigned int nb_dupreq_prealloc;
   unsigned int nb_client_id_prealloc;
   unsigned int nb_ip_stats_prealloc;
   unsigned int nb_before_gc;
@@ -238,7 +252,8 @@ typedef struct nfs_worker_param__
 
 typedef struct nfs_rpc_dupreq_param__
 {
-  hash_parameter_t hash_param;
+  hash_parameter_t hash_param;  /* index_size is the number of partitions */
+  unsigned int nb_entries_per_client;
 } nfs_rpc_dupreq_parameter_t;
 
 typedef struct nfs_cache_layer_parameter__
@@ -269,7 +284,7 @@ typedef struct nfs_core_param__
   struct sockaddr_in bind_addr; // IPv4 only for now...
   unsigned int program[P_COUNT];
   unsigned int nb_worker;
-  unsigned int nb_call_before_queue_avg;
+  unsigned int nb_affinity_max_pending;
   unsigned int nb_max_concurrent_gc;
   long core_dump_size;
   int nb_max_fd;
@@ -285,9 +300,15 @@ typedef struct nfs_core_param__
   char stats_per_client_directory[MAXPATHLEN];
   char fsal_shared_library[MAXPATHLEN];
   int tcp_fridge_expiration_delay ;
+  unsigned int nb_tcp_reactor;
+  int tcp_write_timeout;             /* Seconds a non-blocking connection may stall on a reply */
+  unsigned int nb_udp_receiver;
   unsigned int core_options;
   unsigned int max_send_buffer_size; /* Size of RPC send buffer */
   unsigned int max_recv_buffer_size; /* Size of RPC recv buffer */
+  unsigned int async_log;            /* Write log files from a dedicated thread */
+  unsigned int async_log_ring_size;  /* Size of each thread's log ring */
+  log_overflow_policy_t async_log_overflow;
 } nfs_core_parameter_t;
 
 typedef struct nfs_ip_name_param__
@@ -332,6 +353,9 @@ typedef struct nfs_version4_parameter__
   unsigned int return_bad_stateid;
   char domainname[NFS4_MAX_DOMAIN_LEN];
   char idmapconf[MAXPATHLEN];
+  char recov_journal[MAXPATHLEN];       /* empty: no journal, no grace period */
+  size_t recov_journal_size;
+  unsigned int allow_delegations;
 } nfs_version4_parameter_t;
 
 typedef struct nfs_param__
@@ -395,6 +419,14 @@ typedef struct nfs_worker_stat__
   unsigned int nb_tcp_req;
   nfs_request_stat_t stat_req;
 
+  /* request queue: high-water mark, requests taken from other workers,
+   * requests taken by other workers, requests of this worker's clients
+   * sent elsewhere because it was busy */
+  unsigned int max_pending;
+  unsigned int nb_steal;
+  unsigned int nb_stolen;
+  unsigned int nb_affinity_miss;
+
   /* the last time stat have been retrieved from buddy and FSAL layers */
   time_t last_stat_update;
   fsal_statistics_t fsal_stats;
@@ -418,6 +450,9 @@ typedef struct nfs_request_data__
   char cred_area[2 * MAX_AUTH_BYTES + RQCRED_SIZE];
   nfs_res_t res_nfs;
   nfs_arg_t arg_nfs;
+  unsigned int pool_index;      /* worker whose request_pool this entry comes from */
+  xdr_arena_t arena;            /* the decoded arguments live here, reset once the request is done */
+  unsigned long long arena_buf[XDR_ARENA_SIZE / sizeof(unsigned long long)];
 } nfs_request_data_t;
 
 typedef struct nfs_client_id__
@@ -425,6 +460,7 @@ typedef struct nfs_client_id__
   char client_name[NFS4_MAX_DOMAIN_LEN];
   clientid4 clientid;
   uint32_t cb_program;
+  uint32_t cb_ident;
   char client_r_addr[SOCK_NAME_MAX];
   char client_r_netid[MAXNAMLEN];
   verifier4 verifier;
@@ -459,10 +495,8 @@ typedef enum pause_state
 typedef struct nfs_worker_data__
 {
   unsigned int worker_index;
-  LRU_list_t *pending_request;
-  LRU_list_t *duplicate_request;
+  mpmc_queue_t request_queue;   /* requests to be processed, filled by DispatchWork */
   struct prealloc_pool request_pool;
-  struct prealloc_pool dupreq_pool;
   struct prealloc_pool ip_stats_pool;
   struct prealloc_pool clientid_pool;
   cache_inode_client_t cache_inode_client;
@@ -471,8 +505,7 @@ typedef struct nfs_worker_data__
   hash_table_t *ht_ip_stats;
   pthread_mutex_t request_pool_mutex;
 
-  /* Used for blocking when request queue is empty. */
-  pthread_cond_t req_condvar;
+  /* Protects pause_state, the worker parks in mpmc_queue_wait when idle */
   pthread_mutex_t request_mutex;
 
   nfs_worker_stat_t stats;
@@ -481,6 +514,7 @@ typedef struct nfs_worker_data__
   int is_ready;
   pause_state_t pause_state;
   unsigned int gc_in_progress;
+  volatile int is_idle;         /* out of requests, may be kicked to steal some */
   unsigned int current_xid;
 #ifdef _USE_SHARED_FSAL
   fsal_op_context_t thread_fsal_context[NB_AVAILABLE_FSAL];
@@ -526,7 +560,8 @@ typedef enum process_status
 {
   PROCESS_DISPATCHED,
   PROCESS_LOST_CONN,
-  PROCESS_DONE
+  PROCESS_DONE,
+  PROCESS_DRAINED               /* non-blocking socket with nothing left to read */
 } process_status_t;
 
 typedef enum pause_reason
@@ -565,7 +600,7 @@ typedef enum worker_available_rc
  */
 enum auth_stat AuthenticateRequest(nfs_request_data_t *pnfsreq,
                                    bool_t *dispatch);
-worker_available_rc worker_available(unsigned long index, unsigned int avg_number_pending);
+worker_available_rc worker_available(unsigned long index, unsigned int max_pending);
 pause_rc pause_workers(pause_reason_t reason);
 pause_rc wake_workers(awaken_reason_t reason);
 pause_rc wait_for_workers_to_awaken();
@@ -573,12 +608,23 @@ void DispatchWork(nfs_request_data_t *pnfsreq, unsigned int worker_index);
 void *worker_thread(void *IndexArg);
 process_status_t process_rpc_request(SVCXPRT *xprt);
 void *rpc_dispatcher_thread(void *arg);
+void *rpc_tcp_socket_manager_thread(void *Arg);
+int nfs_Init_tcp_reactors(void);
+void *rpc_tcp_reactor_thread(void *IndexArg);
+int rpc_tcp_reactor_register(int tcp_sock);
+int nfs_Init_udp_receivers(void);
+void *rpc_udp_receiver_thread(void *IndexArg);
 void *admin_thread(void *arg);
 void *stats_thread(void *IndexArg);
 void *long_processing_thread(void *arg);
 void *stat_exporter_thread(void *IndexArg);
 int stats_snmp(nfs_worker_data_t * workers_data_local);
 void *file_content_gc_thread(void *IndexArg);
+void *cache_inode_gc_thread(void *Arg);
+void *cache_inode_flush_thread(void *Arg);
+void *nfs4_recovery_thread(void *Arg);
+void *nfs4_deleg_recall_thread(void *Arg);
+void *nfs4_lease_reaper_thread(void *Arg);
 void *nfs_file_content_flush_thread(void *flush_data_arg);
 
 void nfs_operate_on_sigusr1() ;
@@ -631,6 +677,15 @@ int export_client_match(sockaddr_t *hostaddr,
                         exportlist_client_t *clients,
                         exportlist_client_entry_t * pclient_found,
                         unsigned int export_option);
+int export_client_match_index(sockaddr_t *hostaddr,
+                              char *ipstring,
+                              exportlist_client_t *clients,
+                              struct export_access_matcher *pmatcher,
+                              unsigned int export_option);
+int export_client_match_entry(sockaddr_t *hostaddr,
+                              char *ipstring,
+                              exportlist_client_entry_t * pentry,
+                              unsigned int i);
 int export_client_matchv6(struct in6_addr *paddrv6,
                           exportlist_client_t *clients,
                           exportlist_client_entry_t * pclient_found,
@@ -648,15 +703,8 @@ void Print_param_in_log();
 
 void nfs_reset_stats(void);
 
-int display_req_key(hash_buffer_t * pbuff, char *str);
-int display_req_val(hash_buffer_t * pbuff, char *str);
-int compare_req(hash_buffer_t * buff1, hash_buffer_t * buff2);
 
-int print_entry_dupreq(LRU_data_t data, char *str);
-int clean_entry_dupreq(LRU_entry_t * pentry, void *addparam);
 
-int clean_pending_request(LRU_entry_t * pentry, void *addparam);
-int print_pending_request(LRU_data_t data, char *str);
 
 void auth_stat2str(enum auth_stat, char *str);
 
@@ -679,6 +727,9 @@ int nfs_client_id_set(clientid4 clientid,
                       nfs_client_id_t client_record,
                       struct prealloc_pool *clientid_pool);
 
+int nfs4_cb_recall_usable(nfs_client_id_t * pclientid);
+int nfs4_cb_recall_send(state_deleg_recall_t * precall);
+
 int nfs_client_id_compute(char *name, clientid4 * pclientid);
 int nfs_client_id_basic_compute(char *name, clientid4 * pclientid);
 
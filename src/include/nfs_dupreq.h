@@ -53,7 +53,10 @@ typedef unsigned long u_long;
 #include "fsal.h"
 #include "nfs_tools.h"
 
-typedef struct dupreq_key__
+/* A cached request. The key (xid, addr, checksum) is stored inline. The
+ * entries of a client are indexed by xid modulo the size of its cache, so a
+ * new xid retires the request sent nb_entries_per_client xids before it. */
+typedef struct dupreq_entry__
 {
   /* Each NFS request is identified by the client by an xid.
    * The same xids can be recycled by the same client or used
@@ -61,8 +64,8 @@ typedef struct dupreq_key__
    * cache useful. */
   long xid;
 
-  /* The IP and port are also used to identify duplicate requests.
-   * This is much much stronger. */
+  /* The IP is also used to identify duplicate requests. The port is not:
+   * a request retransmitted over a new connection comes from a new port. */
   sockaddr_t addr;
 
   /* In very rare cases, ip/port/xid is not enough. In databases
@@ -70,15 +73,8 @@ typedef struct dupreq_key__
    * In those cases a checksum of the first 200 bytes of the request
    * should be used */
   int checksum;
-} dupreq_key_t;
-
-typedef struct dupreq_entry__
-{
-  long xid;
-  sockaddr_t addr;
-  int checksum;
 
-  pthread_mutex_t dupreq_mutex;
+  int valid;      /* the slot holds a request */
   int processing; /* if currently being processed, this should be = 1 */
 
   nfs_res_t res_nfs;
@@ -88,31 +84,47 @@ typedef struct dupreq_entry__
   time_t timestamp;
 } dupreq_entry_t;
 
-unsigned int get_rpc_xid(struct svc_req *reqp);
+/* The bounded cache of a client, whatever port or transport it uses, so that
+ * a retransmission over a new TCP connection still finds its reply */
+/* Transports of a client the cache is sized for */
+#define DUPREQ_MAX_TRANSPORTS 8
+
+typedef struct dupreq_client__
+{
+  sockaddr_t addr;              /* compared without the port */
+  time_t last_used;
+  unsigned int nb_valid;
+  struct dupreq_client__ *next;
+  unsigned int nb_transports;
+  int ports[DUPREQ_MAX_TRANSPORTS];     /* one per transport seen */
+  unsigned int nb_entries;      /* nb_entries_per_client per transport, a power of 2 */
+  dupreq_entry_t *entries;
+} dupreq_client_t;
+
+/* The clients are spread among partitions, each with its own lock */
+typedef struct dupreq_partition__
+{
+  pthread_mutex_t lock;
+  dupreq_client_t *clients;
+  unsigned int nb_clients;
+  hash_stat_dynamic_t stats;
+} dupreq_partition_t;
 
-int compare_req(hash_buffer_t * buff1, hash_buffer_t * buff2);
-int print_entry_dupreq(LRU_data_t data, char *str);
-int clean_entry_dupreq(LRU_entry_t * pentry, void *addparam);
-int nfs_dupreq_gc_function(LRU_entry_t * pentry, void *addparam);
+unsigned int get_rpc_xid(struct svc_req *reqp);
 
 nfs_res_t nfs_dupreq_get(long xid, struct svc_req *ptr_req, SVCXPRT *xprt, int *pstatus);
-int nfs_dupreq_delete(long xid, struct svc_req *ptr_req, SVCXPRT *xprt,
-                      struct prealloc_pool *dupreq_pool);
+int nfs_dupreq_delete(long xid, struct svc_req *ptr_req, SVCXPRT *xprt);
 int nfs_dupreq_add_not_finished(long xid,
 				struct svc_req *ptr_req,
 				SVCXPRT *xprt,
-				struct prealloc_pool *dupreq_pool,
 				nfs_res_t *res_nfs);
 
 int nfs_dupreq_finish(long xid,
 		      struct svc_req *ptr_req,
 		      SVCXPRT *xprt,
-		      nfs_res_t * p_res_nfs,
-		      LRU_list_t * lru_dupreq);
+		      nfs_res_t * p_res_nfs);
 
-unsigned long dupreq_value_hash_func(hash_parameter_t * p_hparam,
-                                     hash_buffer_t * buffclef);
-unsigned long dupreq_rbt_hash_func(hash_parameter_t * p_hparam, hash_buffer_t * buffclef);
+void nfs_dupreq_gc(void);
 void nfs_dupreq_get_stats(hash_stat_t * phstat);
 
 #define DUPREQ_SUCCESS             0
@@ -120,5 +132,6 @@ void nfs_dupreq_get_stats(hash_stat_t * phstat);
 #define DUPREQ_NOT_FOUND           2
 #define DUPREQ_BEING_PROCESSED     3
 #define DUPREQ_ALREADY_EXISTS      4
+#define DUPREQ_NOT_CACHED          5
 
 #endif                          /* _NFS_DUPREQ_H */
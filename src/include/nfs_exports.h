@@ -193,6 +193,9 @@ typedef struct exportlist__
   exportlist_client_t clients;  /* allowed clients                                   */
   struct exportlist__ *next;    /* next entry                                        */
    unsigned int fsalid ;
+  nfs_latency_histogram_t **latency_shards;     /* per worker latency histograms, allocated on first use */
+  struct export_access_matcher *access_matcher; /* compiled client list, NULL if not compiled */
+  struct export_access_cache *access_cache;     /* per client access verdicts, allocated on first use */
 } exportlist_t;
 
 /* Used to record the uid and gid of the client that made a request. */
@@ -340,6 +343,32 @@ typedef struct compoud_data
 
 /* Export list related functions */
 exportlist_t *nfs_Get_export_by_id(exportlist_t * exportroot, unsigned short exportid);
+void nfs_export_latency_record(exportlist_t * pexport, unsigned int worker_index,
+                               unsigned int latency);
+void nfs_export_latency_free(exportlist_t * pexport);
+
+/* Verdicts of export_client_match_entry */
+#define EXPORT_CLIENT_NO_MATCH 0
+#define EXPORT_CLIENT_MATCH    1
+#define EXPORT_CLIENT_STOP     2        /* the rest of the client list must be ignored */
+
+/* Keys of the access verdict cache, besides the client address */
+#define EXPORT_ACCESS_CACHE_ROOT  0x1
+#define EXPORT_ACCESS_CACHE_WRITE 0x2
+
+int nfs_export_access_compile(exportlist_t * pexport);
+void nfs_export_access_free(exportlist_t * pexport);
+int nfs_export_access_match(struct export_access_matcher *pmatcher,
+                            sockaddr_t *hostaddr,
+                            char *ipstring,
+                            exportlist_client_t *clients,
+                            unsigned int export_option, int *pindex);
+int nfs_export_access_cache_get(exportlist_t * pexport, in_addr_t addr,
+                                unsigned int flags, int *pverdict, int *pindex,
+                                exportlist_access_type_t * paccess_type);
+void nfs_export_access_cache_set(exportlist_t * pexport, in_addr_t addr,
+                                 unsigned int flags, int verdict, int index,
+                                 exportlist_access_type_t access_type);
 int nfs_check_anon(exportlist_client_entry_t * pexport_client,
                     exportlist_t * pexport,
                     struct user_cred *user_credentials);
@@ -1219,6 +1219,46 @@ static const fattr4_dent_t __attribute__ ((__unused__)) fattr4tab[] =
 #define NFS_MAXPATHLEN MAXPATHLEN
 #define DEFAULT_DOMAIN "localdomain"
 #define DEFAULT_IDMAPCONF "/etc/idmapd.conf"
+#define DEFAULT_RECOV_JOURNAL "/var/lib/nfs/ganesha/v4recov.journal"
+#define DEFAULT_RECOV_JOURNAL_SIZE (8 * 1024 * 1024)
+
+/*
+ * Precompiled attribute bitmaps: a plan is the flat list of the encoders of the
+ * attributes requested by a bitmap4, in the order they go on the wire. Only
+ * the attributes which depend on the FSAL attributes, the export and the file
+ * handle have an encoder: a bitmap asking for another one (statfs based
+ * attributes, fs_locations, acl...) has no plan and goes through
+ * nfs4_FSALattr_To_Fattr_Switch.
+ */
+
+/* Plans only know the attributes of the first two words of a bitmap */
+#define NFS4_FATTR_PLAN_MAX_ENTRIES 64
+
+/* Number of plans kept in the cache, must be a power of 2 */
+#define NFS4_FATTR_PLAN_CACHE_SIZE  64
+
+/* Returns the number of bytes written in buff, 0 if the attribute could not be encoded */
+typedef u_int(*nfs4_fattr_encoder_t) (exportlist_t * pexport,
+                                      fsal_attrib_list_t * pattr,
+                                      nfs_fh4 * objFH, char *buff);
+
+typedef struct nfs4_fattr_plan_entry__
+{
+  uint32_t attr;                /* The attribute to encode                  */
+  u_int size;                   /* Its encoded size, 0 if not known upfront */
+  nfs4_fattr_encoder_t encode;
+} nfs4_fattr_plan_entry_t;
+
+typedef struct nfs4_fattr_plan__
+{
+  uint32_t bitmap[2];           /* The requested bitmap                           */
+  uint32_t result[2];           /* The returned bitmap, if no encoder fails       */
+  uint_t nb_entries;
+  uint_t nb_prefix;             /* The first nb_prefix entries have a known size  */
+  u_int prefix_len;             /* and are encoded in the first prefix_len bytes  */
+  nfs4_fattr_plan_entry_t entries[NFS4_FATTR_PLAN_MAX_ENTRIES];
+} nfs4_fattr_plan_t;
+
 #endif                          /* _NFS_PROTO_FUNCTIONS_H */
 
 #define NFS_REQ_OK   0
@@ -1507,6 +1547,19 @@ int nfs4_FSALattr_To_Fattr(exportlist_t * pexport,
                            fattr4 * Fattr,
                            compound_data_t * data, nfs_fh4 * objFH, bitmap4 * Bitmap);
 
+int nfs4_FSALattr_To_Fattr_Switch(exportlist_t * pexport,
+                                  fsal_attrib_list_t * pattr,
+                                  fattr4 * Fattr,
+                                  compound_data_t * data,
+                                  nfs_fh4 * objFH, bitmap4 * Bitmap);
+
+nfs4_fattr_plan_t *nfs4_Fattr_Plan(bitmap4 * Bitmap, nfs4_fattr_plan_t * pscratch);
+
+int nfs4_FSALattr_To_Fattr_Plan(nfs4_fattr_plan_t * pplan,
+                                exportlist_t * pexport,
+                                fsal_attrib_list_t * pattr,
+                                fattr4 * Fattr, nfs_fh4 * objFH);
+
                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                 /* time_how4          * mtime_set, *//* Out: How to set mtime */
                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                         /* time_how4          * atimen_set ) ; *//* Out: How to set atime */
 
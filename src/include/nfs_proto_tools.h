@@ -107,6 +107,10 @@ void nfs_SetPreOpAttr(fsal_attrib_list_t * pfsal_attr, pre_op_attr * pattr);
 
 int nfs_RetryableError(cache_inode_status_t cache_status);
 
+caddr_t nfs_read_buffer_get(size_t size);
+void nfs_read_buffer_hold(caddr_t data);
+void nfs_read_buffer_release(caddr_t data);
+
 int nfs3_Sattr_To_FSAL_attr(fsal_attrib_list_t * pFSALattr, sattr3 * psattr);
 
 void nfs_SetWccData(fsal_op_context_t * pcontext,
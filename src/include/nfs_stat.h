@@ -70,6 +70,10 @@ extern char *rquota_functions_names[];
 #define NFS_V40_NB_OPERATION 39
 #define NFS_V41_NB_OPERATION 58
 
+/* COMPOUND sub-operations, indexed by operation number (v4.0 and v4.1 share the numbering) */
+#define NFS_V4_NB_OP_NUMBER (NFS_V41_NB_OPERATION + 1)
+extern char *nfsv4_op_names[];
+
 #define ERR_STAT_NO_ERROR 0
 #define ERR_STAT_ERROR    1
 
@@ -99,6 +103,43 @@ typedef struct nfs_request_stat_item__
   unsigned int tot_await_time;
 } nfs_request_stat_item_t;
 
+/* Log-linear latency histograms: latencies (in microseconds) below 2^NFS_LATENCY_SUB_BITS
+ * have their own bucket, then each power of two is split in 2^NFS_LATENCY_SUB_BITS
+ * buckets, so the relative error on a percentile is below 1/2^NFS_LATENCY_SUB_BITS. */
+#define NFS_LATENCY_SUB_BITS   4
+#define NFS_LATENCY_NB_BUCKETS ((33 - NFS_LATENCY_SUB_BITS) << NFS_LATENCY_SUB_BITS)
+
+typedef struct nfs_latency_histogram__
+{
+  unsigned int count[NFS_LATENCY_NB_BUCKETS];
+} nfs_latency_histogram_t;
+
+/* One of these per worker: only its worker writes in it, the stat exporter merges them */
+typedef struct nfs_latency_stat__
+{
+  nfs_latency_histogram_t nfs3[NFS_V3_NB_COMMAND];
+  nfs_latency_histogram_t nfs4[NFS_V4_NB_COMMAND];
+  nfs_latency_histogram_t nfs4_op[NFS_V4_NB_OP_NUMBER];
+} nfs_latency_stat_t;
+
+static inline unsigned int nfs_latency_bucket(unsigned int latency)
+{
+  unsigned int shift;
+
+  if(latency < (1 << NFS_LATENCY_SUB_BITS))
+    return latency;
+
+  shift = 31 - __builtin_clz(latency) - NFS_LATENCY_SUB_BITS;
+
+  return ((shift + 1) << NFS_LATENCY_SUB_BITS) +
+      ((latency >> shift) & ((1 << NFS_LATENCY_SUB_BITS) - 1));
+}                               /* nfs_latency_bucket */
+
+static inline void nfs_latency_record(nfs_latency_histogram_t * phisto, unsigned int latency)
+{
+  phisto->count[nfs_latency_bucket(latency)] += 1;
+}                               /* nfs_latency_record */
+
 typedef struct nfs_request_stat__
 {
   unsigned int nb_mnt1_req;
@@ -121,6 +162,7 @@ typedef struct nfs_request_stat__
   nfs_request_stat_item_t stat_req_nlm4[NLM_V4_NB_OPERATION];
   nfs_request_stat_item_t stat_req_rquota1[RQUOTA_NB_COMMAND];
   nfs_request_stat_item_t stat_req_rquota2[RQUOTA_NB_COMMAND];
+  nfs_latency_stat_t *platency;
 } nfs_request_stat_t;
 
 typedef enum
@@ -141,7 +183,9 @@ typedef enum
   PER_SERVER_DETAIL,
   PER_CLIENT,
   PER_SHARE,
-  PER_CLIENTSHARE
+  PER_CLIENTSHARE,
+  PER_SERVER_LATENCY,
+  PER_SHARE_LATENCY
 } nfs_stat_client_req_type_t;
 
 typedef struct
@@ -162,4 +206,13 @@ void set_max_latency(nfs_request_stat_item_t *cur_stat, unsigned int val);
 
 struct timeval time_diff(struct timeval time_from, struct timeval time_to);
 
+void nfs_latency_merge(nfs_latency_histogram_t * pdest, nfs_latency_histogram_t * psrc);
+
+unsigned long long nfs_latency_total(nfs_latency_histogram_t * phisto);
+
+unsigned int nfs_latency_percentile(nfs_latency_histogram_t * phisto,
+                                    unsigned long long total, double percentile);
+
+unsigned int nfs_latency_max(nfs_latency_histogram_t * phisto);
+
 #endif                          /* _NFS_STAT_H */
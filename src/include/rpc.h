@@ -59,6 +59,8 @@ extern struct netconfig *getnetconfigent(const char *netid);
 extern void freenetconfigent(struct netconfig *);
 extern SVCXPRT *Svc_vc_create(int, u_int, u_int);
 extern SVCXPRT *Svc_dg_create(int, u_int, u_int);
+extern int Svc_dg_enablebatch(SVCXPRT *, u_int);
+extern void Svc_vc_setwritetimeout(int seconds);
 
 #if !defined(_NO_BUDDY_SYSTEM) && defined(_DEBUG_MEMLEAKS)
 extern int CheckXprt(SVCXPRT *xprt);
@@ -143,6 +145,13 @@ enum auth_stat Rpcsecgss__authenticate(register struct svc_req *rqst,
 
 extern fd_set Svc_fdset;
 
+#ifdef HAVE_SYS_EPOLL_H
+/* Event set used by the dispatcher, it mirrors Svc_fdset without the FD_SETSIZE limit */
+extern int Svc_epollfd;
+#endif
+extern int Svc_epoll_add(int sock);
+extern void Svc_epoll_del(int sock);
+
 /* Declare the various RPC transport dynamic arrays */
 extern SVCXPRT         **Xports;
 extern pthread_mutex_t  *mutex_cond_xprt;
@@ -119,9 +119,22 @@ typedef struct state_lock_t
 
 typedef struct state_deleg__
 {
-  unsigned int nothing;
+  open_delegation_type4 d_type;                                          /**< Type of delegation (only READ is granted)            */
+  time_t d_recall_time;                                                  /**< When a recall was queued, 0 if not recalled          */
+  bool_t d_revoked;                                                      /**< Not returned within a lease, waiting to be dropped   */
+  u_int d_fh_len;                                                        /**< Length of the file handle known by the client        */
+  char d_fh[NFS4_FHSIZE];                                                /**< File handle to be sent back in CB_RECALL             */
 } state_deleg_t;
 
+/* A recall, as handed over to the thread sending CB_RECALL */
+typedef struct state_deleg_recall_t
+{
+  clientid4 sdr_clientid;                              /**< Client holding the delegation                        */
+  stateid4  sdr_stateid;                               /**< Delegation stateid                                   */
+  u_int     sdr_fh_len;                                /**< Length of the file handle                            */
+  char      sdr_fh[NFS4_FHSIZE];                       /**< File handle of the delegated file                    */
+} state_deleg_recall_t;
+
 typedef struct state_layout__
 {
 #ifdef _USE_PNFS
@@ -200,6 +213,7 @@ struct state_nfs4_owner_t
   cache_entry_t     * so_last_pentry;   /** < Last file operated on by this state owner */
   nfs_resop4          so_resp;          /** < Saved response                            */
   state_owner_t     * so_related_owner;
+  struct glist_head   so_lease_list;    /** < In the owners of the client's lease     */
 };
 
 /* Undistinguished lock owner type */
@@ -246,6 +260,7 @@ struct state_t
   state_t       * state_next;                /**< Next entry in the state list               */
   state_t       * state_prev;                /**< Prev entry in the state list               */
   cache_entry_t * state_pentry;              /**< Related pentry                             */
+  struct glist_head state_lease_list;        /**< In the states of the client's lease        */
 };
 
 /*
@@ -297,6 +312,7 @@ typedef enum state_status_t
   STATE_FILE_BIG              = 41,
   STATE_GRACE_PERIOD          = 42,
   STATE_CACHE_INODE_ERR       = 43,
+  STATE_DELEG_RECALLED        = 44,
 } state_status_t;
 
 typedef enum state_blocking_t
@@ -324,6 +340,28 @@ typedef struct state_lock_desc_t
 
 typedef struct state_lock_entry_t   state_lock_entry_t;
 
+/* The granted locks of a file are kept in two interval trees */
+typedef enum state_lock_tree_t
+{
+  STATE_LOCK_BY_RANGE = 0,
+  STATE_LOCK_BY_OWNER = 1
+} state_lock_tree_t;
+
+#define STATE_LOCK_NB_TREES 2
+
+typedef struct state_lock_node_t
+{
+  state_lock_entry_t * sln_left;
+  state_lock_entry_t * sln_right;
+  uint64_t             sln_max_end;        /**< Highest lock end in the subtree          */
+  uint64_t             sln_max_end_w;      /**< Highest write lock end in the subtree    */
+  bool_t               sln_has_w;          /**< The subtree holds write locks            */
+} state_lock_node_t;
+
+/* Called on the locks found by state_lock_tree_search, TRUE stops the search */
+typedef int (*state_lock_match_t)(state_lock_entry_t * plock_entry,
+                                  void               * arg);
+
 #ifdef _USE_BLOCKING_LOCKS
 typedef struct state_cookie_entry_t state_cookie_entry_t;
 #endif
@@ -385,6 +423,9 @@ struct state_lock_entry_t
   state_t              * sle_state;
   state_lock_desc_t      sle_lock;
   pthread_mutex_t        sle_mutex;
+  bool_t                 sle_in_tree;      /**< Granted, in the lock trees rather than the lock list */
+  unsigned int           sle_priority;     /**< Heap priority of the tree nodes                      */
+  state_lock_node_t      sle_node[STATE_LOCK_NB_TREES];
 };
 
 #ifdef _USE_BLOCKING_LOCKS
@@ -157,8 +157,6 @@ int nfs4_State_Get_Pointer(char other[OTHERSIZE], state_t * *pstate_data);
 int nfs4_State_Del(char other[OTHERSIZE]);
 void nfs_State_PrintAll(void);
 
-int nfs4_is_lease_expired(cache_entry_t * pentry);
-
 int display_state_id_val(hash_buffer_t * pbuff, char *str);
 int display_state_id_key(hash_buffer_t * pbuff, char *str);
 
@@ -212,6 +210,72 @@ bool_t Check_nfs4_seqid(state_owner_t   * powner,
                         nfs_resop4      * resp,
                         const char      * tag);
 
+/******************************************************************************
+ *
+ * NFSv4 Delegation functions
+ *
+ ******************************************************************************/
+
+int state_deleg_wanted(cache_inode_deleg_heuristics_t * pheur,
+                       clientid4 clientid, unsigned int share_access, time_t now);
+
+unsigned int state_deleg_recall_conflicts(cache_entry_t * pentry,
+                                          clientid4 clientid,
+                                          state_type_t state_type,
+                                          state_data_t * pstate_data);
+
+state_status_t state_deleg_grant(cache_entry_t * pentry,
+                                 state_owner_t * powner,
+                                 unsigned int share_access,
+                                 nfs_fh4 * pfh,
+                                 cache_inode_client_t * pclient,
+                                 fsal_op_context_t * pcontext,
+                                 state_t ** ppstate,
+                                 state_status_t * pstatus);
+
+state_status_t state_deleg_break(cache_entry_t * pentry,
+                                 clientid4 clientid,
+                                 cache_inode_client_t * pclient,
+                                 state_status_t * pstatus);
+
+int state_deleg_recall_get(state_deleg_recall_t * precall, unsigned int delay);
+void state_deleg_recall_sent(state_deleg_recall_t * precall);
+
+/******************************************************************************
+ *
+ * NFSv4 Lease functions
+ *
+ ******************************************************************************/
+
+void nfs4_lease_init(time_t now);
+void nfs4_lease_set_clock(time_t (*clock)(time_t *));
+void nfs4_lease_renew(clientid4 clientid);
+void nfs4_lease_state(state_t * pstate, fsal_op_context_t * pcontext, int add);
+void nfs4_lease_owner(state_owner_t * powner, int add);
+#ifdef _USE_NFS4_1
+void nfs4_lease_session(nfs41_session_t * psession, int add);
+#endif
+unsigned int nfs4_lease_reap(cache_inode_client_t * pclient,
+                             struct prealloc_pool *clientid_pool);
+
+/******************************************************************************
+ *
+ * NFSv4 Recovery functions
+ *
+ ******************************************************************************/
+
+int nfs4_recovery_init(char *path, size_t size);
+int nfs4_recovery_enabled(void);
+int nfs4_recovery_in_grace(void);
+nfsstat4 nfs4_recovery_check_reclaim(clientid4 clientid, bool_t reclaim);
+void nfs4_recovery_reclaim_complete(clientid4 clientid);
+void nfs4_recovery_client_confirm(clientid4 clientid, char *name);
+void nfs4_recovery_client_remove(clientid4 clientid);
+void nfs4_recovery_owner(state_owner_t * powner, int add);
+void nfs4_recovery_state(state_t * pstate, int add);
+void nfs4_recovery_wait(unsigned int delay);
+size_t nfs4_recovery_flush(void);
+
 /******************************************************************************
  *
  * Lock functions
@@ -233,6 +297,22 @@ void LogLock(log_components_t     component,
              state_owner_t      * powner,
              state_lock_desc_t  * plock);
 
+void state_lock_tree_insert(cache_inode_lock_trees_t * ptrees,
+                            state_lock_entry_t       * plock_entry);
+
+void state_lock_tree_remove(cache_inode_lock_trees_t * ptrees,
+                            state_lock_entry_t       * plock_entry);
+
+state_lock_entry_t *state_lock_tree_search(cache_inode_lock_trees_t * ptrees,
+                                           state_owner_t            * powner,
+                                           uint64_t                   start,
+                                           uint64_t                   end,
+                                           bool_t                     writes_only,
+                                           state_lock_match_t         match,
+                                           void                     * arg);
+
+int state_lock_tree_verify(cache_inode_lock_trees_t * ptrees);
+
 #ifdef _USE_BLOCKING_LOCKS
 /**
  *
@@ -362,6 +442,10 @@ state_status_t state_del(state_t              * pstate,
                          cache_inode_client_t * pclient,
                          state_status_t       * pstatus);
 
+state_status_t state_del_no_mutex(state_t              * pstate,
+                                  cache_inode_client_t * pclient,
+                                  state_status_t       * pstatus);
+
 state_status_t state_find_by_owner(cache_entry_t         * pentry,
                                    open_owner4           * powner,
                                    state_t              ** ppstate,
@@ -133,6 +133,8 @@ typedef struct prealloc_pool
   int                     pa_num;         // optimized number of entries per block
   int                     pa_blocks;      // number of blocks allocated
   int                     pa_allocated;   // number of entries preallocated
+  int                     pa_count;       // number of entries in the free list
+  struct slab_cache      *pa_slab;        // slab cache the entries come from
 } prealloc_pool;
 
 #define IsPoolPreallocated(pool) ((pool)->pa_num == 0 || (pool)->pa_allocated > 0)
@@ -145,6 +147,40 @@ typedef struct prealloc_pool
  
 #if defined(_NO_BUDDY_SYSTEM) || !defined(_DEBUG_MEMLEAKS)
 
+#ifndef _NO_BUDDY_SYSTEM
+
+#include "SlabAlloc.h"
+
+/**
+ *
+ * FillPool: Gets entries for a pool of pre-allocated entries.
+ *
+ * This macro gets pa_num entries from the pool's slab cache, which allocates
+ * and constructs a new slab if none are available. See SlabAlloc.h.
+ *
+ * @param pool the preallocted pool that we want to fill.
+ * @param fi   dummy parameter for the file
+ * @param fu   dummy parameter for the function
+ * @param li   dummy parameter for the line number
+ * @param str  dummy parameter for the string version of the type
+ *
+ * @return  nothing (this is a macro)
+ *
+ */
+#define FillPool(pool, fi, fu, li, str)                      \
+  SlabFillPool(pool)
+
+#define GetPoolSlabCache(size, ctor)  SlabCacheGet(size, ctor)
+
+/* A pool gives entries back to its slab cache when it has too many of them */
+#define DrainPool(pool)                                      \
+do {                                                         \
+  if ((pool)->pa_count > 2 * (pool)->pa_num)                 \
+    SlabDrainPool(pool);                                     \
+} while (0)
+
+#else
+
 /**
  *
  * FillPool: Allocates entries for a pool of pre-allocated entries.
@@ -153,8 +189,6 @@ typedef struct prealloc_pool
  * the pool as an arry and then chains all the entries together. If a
  * constructor has been defined for the pool, it will be invoked on each entry.
  *
- * If BuddyMalloc is used, it is supposed to be already initialised.
- *
  * @param pool the preallocted pool that we want to fill.
  * @param fi   dummy parameter for the file
  * @param fu   dummy parameter for the function
@@ -173,6 +207,7 @@ do {                                                         \
   if (mem != NULL)                                           \
     {                                                        \
       (pool)->pa_allocated += num;                           \
+      (pool)->pa_count += num;                               \
       (pool)->pa_blocks++;                                   \
       while (num > 0)                                        \
         {                                                    \
@@ -187,6 +222,12 @@ do {                                                         \
     }                                                        \
 } while (0)
 
+#define GetPoolSlabCache(size, ctor)  NULL
+
+#define DrainPool(pool)
+
+#endif                          /* _NO_BUDDY_SYSTEM */
+
 /**
  *
  * InitPool: Initializes a pool of pre-allocated entries.
@@ -210,6 +251,7 @@ do {                                                         \
   (pool)->pa_size        = sizeof(type);                     \
   size = (pool)->pa_size + size_prealloc_header64;           \
   (pool)->pa_num         = GetPreferedPool(num_alloc, size); \
+  (pool)->pa_slab        = GetPoolSlabCache(sizeof(type), ctor); \
 } while (0)
 
 /**
@@ -249,6 +291,7 @@ do {                                                         \
     {                                                        \
       prealloc_header *h = (pool)->pa_free;                  \
       (pool)->pa_free = h->pa_next;                          \
+      (pool)->pa_count--;                                    \
       h->pa_next = h;                                        \
       entry = get_prealloc_entry(h, type);                   \
     }                                                        \
@@ -261,7 +304,8 @@ do {                                                         \
  * ReleaseToPool: Releases an entry and puts it back to the pool.
  *
  * When an entry is no used any more, this macro is used to put it back to the
- * pool, so that it could be reuse later.
+ * pool, so that it could be reuse later. A pool holding more than twice pa_num
+ * entries gives pa_num of them back to its slab cache.
  *
  * @param entry the entry to be released.
  * @param pool the pool to which the entry belongs.
@@ -276,6 +320,8 @@ do {                                                         \
     (pool)->pa_destructor(entry);                            \
   h->pa_next = (pool)->pa_free;                              \
   (pool)->pa_free = h;                                       \
+  (pool)->pa_count++;                                        \
+  DrainPool(pool);                                           \
 } while (0)
 
 #else
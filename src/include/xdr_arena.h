@@ -0,0 +1,71 @@
+/**
+ *
+ * \file    xdr_arena.h
+ * \brief   Per-request bump arena for the XDR decoders.
+ *
+ * The variable length fields of a request (names, opaques, the COMPOUND
+ * argarray...) are carved from an arena owned by the request instead of being
+ * allocated one by one. The arena is made current for the calling thread
+ * around svc_getargs and SVC_FREEARGS: the free pass then skips the memory of
+ * the arena, which is given back in one step by xdr_arena_reset once the
+ * request is done. Without a current arena, the decoders allocate as usual.
+ *
+ * The generated decoders define XDR_ARENA_DECODERS before including this file,
+ * so that their calls to xdr_bytes, xdr_string, xdr_array, xdr_pointer and
+ * xdr_reference go through the arena.
+ *
+ */
+
+#ifndef _XDR_ARENA_H
+#define _XDR_ARENA_H
+
+#include "rpc.h"
+
+#define XDR_ARENA_SIZE 4096     /* bytes held inline by a request */
+#define XDR_ARENA_ALIGN 8
+
+typedef struct xdr_arena_chunk__
+{
+  struct xdr_arena_chunk__ *next;
+  size_t size;
+  size_t used;
+} xdr_arena_chunk_t;
+
+typedef struct xdr_arena__
+{
+  char *base;                   /**< the inline buffer */
+  size_t size;
+  size_t used;
+  xdr_arena_chunk_t *chunks;    /**< allocated when the inline buffer is full */
+  unsigned int nb_chunks;
+} xdr_arena_t;
+
+void xdr_arena_init(xdr_arena_t * parena, char *buffer, size_t size);
+void xdr_arena_reset(xdr_arena_t * parena);
+void *xdr_arena_alloc(xdr_arena_t * parena, size_t size);
+int xdr_arena_owns(xdr_arena_t * parena, void *ptr);
+
+void xdr_arena_set_current(xdr_arena_t * parena);
+xdr_arena_t *xdr_arena_get_current(void);
+
+bool_t xdr_arena_bytes(XDR * xdrs, char **cpp, u_int * sizep, u_int maxsize);
+bool_t xdr_arena_string(XDR * xdrs, char **cpp, u_int maxsize);
+bool_t xdr_arena_array(XDR * xdrs, caddr_t * addrp, u_int * sizep, u_int maxsize,
+                       u_int elsize, xdrproc_t elproc);
+bool_t xdr_arena_reference(XDR * xdrs, caddr_t * pp, u_int size, xdrproc_t proc);
+bool_t xdr_arena_pointer(XDR * xdrs, char **objpp, u_int objsize, xdrproc_t xdrobj);
+
+#ifdef XDR_ARENA_DECODERS
+#define xdr_bytes(xdrs, cpp, sizep, maxsize) \
+        xdr_arena_bytes(xdrs, cpp, sizep, maxsize)
+#define xdr_string(xdrs, cpp, maxsize) \
+        xdr_arena_string(xdrs, cpp, maxsize)
+#define xdr_array(xdrs, addrp, sizep, maxsize, elsize, elproc) \
+        xdr_arena_array(xdrs, addrp, sizep, maxsize, elsize, elproc)
+#define xdr_reference(xdrs, pp, size, proc) \
+        xdr_arena_reference(xdrs, pp, size, proc)
+#define xdr_pointer(xdrs, objpp, objsize, xdrobj) \
+        xdr_arena_pointer(xdrs, objpp, objsize, xdrobj)
+#endif                          /* XDR_ARENA_DECODERS */
+
+#endif                          /* _XDR_ARENA_H */
@@ -1527,6 +1527,7 @@ int fn_Cache_inode_callstat(int argc,   /* IN : number of args in argv */
 {
   int i;
   hash_stat_t hstat;
+  cache_inode_gc_stat_t gcstat;
 
   cmdCacheInode_thr_info_t *context;
 
@@ -1577,11 +1578,10 @@ int fn_Cache_inode_callstat(int argc,   /* IN : number of args in argv */
           hstat.computed.max_rbt_num_node, hstat.computed.average_rbt_num_node);
   fprintf(output,
           "------------------------------------------------------------------------------\n");
+  cache_inode_gc_get_stat(&gcstat);
   fprintf(output,
-          "Client LRU_GC: nb_entry=%d, nb_invalid=%d, nb_call_gc=%d, param.nb_call_gc_invalid=%d\n",
-          context->client.lru_gc->nb_entry, context->client.lru_gc->nb_invalid,
-          context->client.lru_gc->nb_call_gc,
-          context->client.lru_gc->parameter.nb_call_gc_invalid);
+          "GC: nb_ringed=%u, nb_passes=%u, nb_evicted=%u, nb_recycled=%u\n",
+          gcstat.nb_ringed, gcstat.nb_passes, gcstat.nb_evicted, gcstat.nb_recycled);
   fprintf(output,
           "------------------------------------------------------------------------------\n");
 
@@ -1992,6 +1992,8 @@ static int BuildExportEntry(config_item_t block, exportlist_t ** pp_export)
    }
 #endif
 
+  /* Compile the client list, the linear walk is kept if this fails */
+  nfs_export_access_compile(p_entry);
 
   *pp_export = p_entry;
 
@@ -2027,6 +2029,9 @@ exportlist_t *BuildDefaultExport()
   p_entry->options = 0;
   p_entry->status = EXPORTLIST_OK;
   p_entry->clients.num_clients = 0;
+  p_entry->latency_shards = NULL;
+  p_entry->access_matcher = NULL;
+  p_entry->access_cache = NULL;
   p_entry->access_type = ACCESSTYPE_RW;
   p_entry->anonymous_uid = (uid_t) ANON_UID;
   p_entry->MaxOffsetWrite = (fsal_off_t) 0;
@@ -2080,6 +2085,8 @@ exportlist_t *BuildDefaultExport()
       return NULL;
     }
 
+  nfs_export_access_compile(p_entry);
+
   LogEvent(COMPONENT_CONFIG,
            "NFS READ_EXPORT: Export %d (%s) successfully parsed",
            p_entry->id, p_entry->fullpath);
@@ -2175,19 +2182,164 @@ int ReadExports(config_file_t in_config,        /* The file that contains the ex
 }
 
 /**
- * function for matching a specific option in the client export list.
+ *
+ * export_client_match_entry: matches a client against one entry of a client list.
+ *
+ * The caller checks that the entry has the options it is looking for.
+ *
+ * @param hostaddr [IN] the client address
+ * @param ipstring [IN] the client address as a string, for the wildcards
+ * @param pentry   [IN] the client list entry
+ * @param i        [IN] position of the entry in its list, for the logs
+ *
+ * @return EXPORT_CLIENT_MATCH if the client matches the entry, EXPORT_CLIENT_STOP if the
+ * rest of the client list must be ignored, EXPORT_CLIENT_NO_MATCH otherwise.
+ *
  */
-int export_client_match(sockaddr_t *hostaddr,
-			char *ipstring,
-			exportlist_client_t *clients,
-			exportlist_client_entry_t * pclient_found,
-			unsigned int export_option)
+int export_client_match_entry(sockaddr_t *hostaddr,
+                              char *ipstring,
+                              exportlist_client_entry_t * pentry,
+                              unsigned int i)
 {
-  unsigned int i;
   int rc;
   char hostname[MAXHOSTNAMELEN];
   in_addr_t addr = get_in_addr(hostaddr);
 
+  switch (pentry->type)
+    {
+    case HOSTIF_CLIENT:
+
+      if(pentry->client.hostif.clientaddr == addr)
+        {
+          LogFullDebug(COMPONENT_DISPATCH, "This matches host address");
+          return EXPORT_CLIENT_MATCH;
+        }
+      break;
+
+    case NETWORK_CLIENT:
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "Test net %d.%d.%d.%d in %d.%d.%d.%d ??",
+                   (unsigned int)(pentry->client.network.netaddr >> 24),
+                   (unsigned int)((pentry->client.network.netaddr >> 16) & 0xFF),
+                   (unsigned int)((pentry->client.network.netaddr >> 8) & 0xFF),
+                   (unsigned int)(pentry->client.network.netaddr & 0xFF),
+                   (unsigned int)(addr >> 24),
+                   (unsigned int)(addr >> 16) & 0xFF,
+                   (unsigned int)(addr >> 8) & 0xFF,
+                   (unsigned int)(addr & 0xFF));
+
+      if((pentry->client.network.netmask & addr) == pentry->client.network.netaddr)
+        {
+          LogFullDebug(COMPONENT_DISPATCH, "This matches network address");
+          return EXPORT_CLIENT_MATCH;
+        }
+      break;
+
+    case NETGROUP_CLIENT:
+      /* Try to get the entry from th IP/name cache */
+      if((rc = nfs_ip_name_get(hostaddr, hostname)) != IP_NAME_SUCCESS)
+        {
+          if(rc == IP_NAME_NOT_FOUND)
+            {
+              /* IPaddr was not cached, add it to the cache */
+              if(nfs_ip_name_add(hostaddr, hostname) != IP_NAME_SUCCESS)
+                {
+                  /* Major failure, name could not be resolved */
+                  break;
+                }
+            }
+        }
+
+      /* At this point 'hostname' should contain the name that was found */
+      if(innetgr(pentry->client.netgroup.netgroupname, hostname, NULL, NULL) == 1)
+        return EXPORT_CLIENT_MATCH;
+      break;
+
+    case WILDCARDHOST_CLIENT:
+      /* Now checking for IP wildcards */
+      if(fnmatch(pentry->client.wildcard.wildcard, ipstring, FNM_PATHNAME) == 0)
+        return EXPORT_CLIENT_MATCH;
+
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "Did not match the ip address with a wildcard.");
+
+      /* Try to get the entry from th IP/name cache */
+      if((rc = nfs_ip_name_get(hostaddr, hostname)) != IP_NAME_SUCCESS)
+        {
+          if(rc == IP_NAME_NOT_FOUND)
+            {
+              /* IPaddr was not cached, add it to the cache */
+              if(nfs_ip_name_add(hostaddr, hostname) != IP_NAME_SUCCESS)
+                {
+                  /* Major failure, name could not be resolved */
+                  LogFullDebug(COMPONENT_DISPATCH,
+                               "Could not resolve hostame for addr %u.%u.%u.%u ... not checking if a hostname wildcard matches",
+                               (unsigned int)(addr & 0xFF),
+                               (unsigned int)(addr >> 8) & 0xFF,
+                               (unsigned int)(addr >> 16) & 0xFF,
+                               (unsigned int)(addr >> 24));
+                  break;
+                }
+            }
+        }
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "Wildcarded hostname: testing if '%s' matches '%s'",
+                   hostname, pentry->client.wildcard.wildcard);
+
+      /* At this point 'hostname' should contain the name that was found */
+      if(fnmatch(pentry->client.wildcard.wildcard, hostname, FNM_PATHNAME) == 0)
+        return EXPORT_CLIENT_MATCH;
+      LogFullDebug(COMPONENT_DISPATCH, "'%s' not matching '%s'",
+                   hostname, pentry->client.wildcard.wildcard);
+      break;
+
+    case GSSPRINCIPAL_CLIENT:
+      /** @toto BUGAZOMEU a completer lors de l'integration de RPCSEC_GSS */
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "----------> Unsupported type GSS_PRINCIPAL_CLIENT");
+      return EXPORT_CLIENT_STOP;
+      break;
+
+    case BAD_CLIENT:
+      LogDebug(COMPONENT_DISPATCH,
+               "Bad client in position %u seen in export list", i);
+      break;
+
+    default:
+      LogCrit(COMPONENT_DISPATCH,
+              "Unsupported client in position %u in export list with type %u", i,
+              pentry->type);
+      break;
+    }                           /* switch */
+
+  return EXPORT_CLIENT_NO_MATCH;
+}                               /* export_client_match_entry */
+
+/**
+ *
+ * export_client_match_index: looks for the first entry of a client list matching a client.
+ *
+ * Uses the compiled form of the client list when there is one and it can
+ * answer for this option, walks the list otherwise.
+ *
+ * @param hostaddr      [IN] the client address
+ * @param ipstring      [IN] the client address as a string, for the wildcards
+ * @param clients       [IN] the client list
+ * @param pmatcher      [IN] compiled form of the client list, may be NULL
+ * @param export_option [IN] the options the entry must have
+ *
+ * @return the position of the entry in the client list, -1 if none matches.
+ *
+ */
+int export_client_match_index(sockaddr_t *hostaddr,
+                              char *ipstring,
+                              exportlist_client_t *clients,
+                              struct export_access_matcher *pmatcher,
+                              unsigned int export_option)
+{
+  unsigned int i;
+  int index;
+
   if(export_option & EXPORT_OPTION_ROOT)
     LogFullDebug(COMPONENT_DISPATCH,
                  "Looking for root access entries");
@@ -2200,6 +2352,11 @@ int export_client_match(sockaddr_t *hostaddr,
     LogFullDebug(COMPONENT_DISPATCH,
                  "Looking for nonroot access write entries");
 
+  if(pmatcher != NULL &&
+     nfs_export_access_match(pmatcher, hostaddr, ipstring, clients, export_option,
+                             &index))
+    return index;
+
   for(i = 0; i < clients->num_clients; i++)
     {
       /* Make sure the client entry has the permission flags we're looking for
@@ -2208,133 +2365,37 @@ int export_client_match(sockaddr_t *hostaddr,
          ((clients->clientarray[i].options & EXPORT_OPTION_ROOT) != (export_option & EXPORT_OPTION_ROOT)))
         continue;
 
-      switch (clients->clientarray[i].type)
+      switch (export_client_match_entry(hostaddr, ipstring, &clients->clientarray[i], i))
         {
-        case HOSTIF_CLIENT:
-
-          if(clients->clientarray[i].client.hostif.clientaddr == addr)
-            {
-              LogFullDebug(COMPONENT_DISPATCH, "This matches host address");
-              *pclient_found = clients->clientarray[i];
-              return TRUE;
-            }
-          break;
+        case EXPORT_CLIENT_MATCH:
+          return (int)i;
 
-        case NETWORK_CLIENT:
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "Test net %d.%d.%d.%d in %d.%d.%d.%d ??",
-                       (unsigned int)(clients->clientarray[i].client.network.netaddr >> 24),
-                       (unsigned int)((clients->clientarray[i].client.network.netaddr >> 16) & 0xFF),
-                       (unsigned int)((clients->clientarray[i].client.network.netaddr >> 8) & 0xFF),
-                       (unsigned int)(clients->clientarray[i].client.network.netaddr & 0xFF),
-                       (unsigned int)(addr >> 24),
-                       (unsigned int)(addr >> 16) & 0xFF,
-                       (unsigned int)(addr >> 8) & 0xFF,
-                       (unsigned int)(addr & 0xFF));
-
-          if((clients->clientarray[i].client.network.netmask & addr) ==
-             clients->clientarray[i].client.network.netaddr)
-            {
-              LogFullDebug(COMPONENT_DISPATCH, "This matches network address");
-              *pclient_found = clients->clientarray[i];
-              return TRUE;
-            }
-          break;
-
-        case NETGROUP_CLIENT:
-          /* Try to get the entry from th IP/name cache */
-          if((rc = nfs_ip_name_get(hostaddr, hostname)) != IP_NAME_SUCCESS)
-            {
-              if(rc == IP_NAME_NOT_FOUND)
-                {
-                  /* IPaddr was not cached, add it to the cache */
-                  if(nfs_ip_name_add(hostaddr, hostname) != IP_NAME_SUCCESS)
-                    {
-                      /* Major failure, name could not be resolved */
-                      break;
-                    }
-                }
-            }
-
-          /* At this point 'hostname' should contain the name that was found */
-          if(innetgr
-             (clients->clientarray[i].client.netgroup.netgroupname, hostname,
-              NULL, NULL) == 1)
-            {
-              *pclient_found = clients->clientarray[i];
-              return TRUE;
-            }
-          break;
-
-        case WILDCARDHOST_CLIENT:
-          /* Now checking for IP wildcards */
-          if(fnmatch
-             (clients->clientarray[i].client.wildcard.wildcard, ipstring,
-              FNM_PATHNAME) == 0)
-            {
-              *pclient_found = clients->clientarray[i];
-              return TRUE;
-            }
-
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "Did not match the ip address with a wildcard.");
-
-          /* Try to get the entry from th IP/name cache */
-          if((rc = nfs_ip_name_get(hostaddr, hostname)) != IP_NAME_SUCCESS)
-            {
-              if(rc == IP_NAME_NOT_FOUND)
-                {
-                  /* IPaddr was not cached, add it to the cache */
-                  if(nfs_ip_name_add(hostaddr, hostname) != IP_NAME_SUCCESS)
-                    {
-                      /* Major failure, name could not be resolved */
-                      LogFullDebug(COMPONENT_DISPATCH,
-                                   "Could not resolve hostame for addr %u.%u.%u.%u ... not checking if a hostname wildcard matches",
-                                   (unsigned int)(addr & 0xFF),
-                                   (unsigned int)(addr >> 8) & 0xFF,
-                                   (unsigned int)(addr >> 16) & 0xFF,
-                                   (unsigned int)(addr >> 24));
-                      break;
-                    }
-                }
-            }
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "Wildcarded hostname: testing if '%s' matches '%s'",
-                       hostname, clients->clientarray[i].client.wildcard.wildcard);
-
-          /* At this point 'hostname' should contain the name that was found */
-          if(fnmatch
-             (clients->clientarray[i].client.wildcard.wildcard, hostname,
-              FNM_PATHNAME) == 0)
-            {
-              *pclient_found = clients->clientarray[i];
-              return TRUE;
-            }
-          LogFullDebug(COMPONENT_DISPATCH, "'%s' not matching '%s'",
-                       hostname, clients->clientarray[i].client.wildcard.wildcard);
-          break;
+        case EXPORT_CLIENT_STOP:
+          return -1;
+        }
+    }                           /* for */
 
-        case GSSPRINCIPAL_CLIENT:
-          /** @toto BUGAZOMEU a completer lors de l'integration de RPCSEC_GSS */
-          LogFullDebug(COMPONENT_DISPATCH,
-                       "----------> Unsupported type GSS_PRINCIPAL_CLIENT");
-          return FALSE;
-          break;
+  /* no export found for this option */
+  return -1;
+}                               /* export_client_match_index */
 
-       case BAD_CLIENT:
-          LogDebug(COMPONENT_DISPATCH,
-                  "Bad client in position %u seen in export list", i );
-	  continue ;
+/**
+ * function for matching a specific option in the client export list.
+ */
+int export_client_match(sockaddr_t *hostaddr,
+			char *ipstring,
+			exportlist_client_t *clients,
+			exportlist_client_entry_t * pclient_found,
+			unsigned int export_option)
+{
+  int index;
 
-        default:
-           LogCrit(COMPONENT_DISPATCH,
-                   "Unsupported client in position %u in export list with type %u", i, clients->clientarray[i].type);
-	   continue ;
-        }                       /* switch */
-    }                           /* for */
+  index = export_client_match_index(hostaddr, ipstring, clients, NULL, export_option);
+  if(index < 0)
+    return FALSE;
 
-  /* no export found for this option */
-  return FALSE;
+  *pclient_found = clients->clientarray[index];
+  return TRUE;
 
 }                               /* export_client_match */
 
@@ -2394,11 +2455,149 @@ int export_client_matchv6(struct in6_addr *paddrv6,
   return FALSE;
 }                               /* export_client_matchv6 */
 
+/**
+ *
+ * export_check_match: looks for the first entry of an export's client list matching a client.
+ *
+ * @param hostaddr      [IN]  the client address
+ * @param ipstring      [IN]  the client address as a string, for the wildcards
+ * @param pexport       [IN]  the export
+ * @param pclient_found [OUT] copy of the client entry found
+ * @param export_option [IN]  the options the entry must have
+ * @param pindex        [OUT] position of the client entry found, -1 if none
+ *
+ * @return TRUE if an entry was found, FALSE otherwise.
+ *
+ */
+static int export_check_match(sockaddr_t *hostaddr,
+                              char *ipstring,
+                              exportlist_t * pexport,
+                              exportlist_client_entry_t * pclient_found,
+                              unsigned int export_option,
+                              int *pindex)
+{
+  *pindex = export_client_match_index(hostaddr, ipstring, &(pexport->clients),
+                                      pexport->access_matcher, export_option);
+  if(*pindex < 0)
+    return FALSE;
+
+  *pclient_found = pexport->clients.clientarray[*pindex];
+  return TRUE;
+}                               /* export_check_match */
+
+/**
+ *
+ * nfs_export_check_access_v4: checks if an IPv4 client is authorized to access an export entry.
+ *
+ * The verdict only depends on the client address, on the export, on the
+ * caller being root and on the procedure making writes, so that
+ * nfs_export_check_access can cache it.
+ *
+ * @param hostaddr         [IN]    the client address
+ * @param ipstring         [IN]    the client address as a string, for the wildcards
+ * @param pexport          [INOUT] the export, its access_type may be changed
+ * @param pclient_found    [OUT]   copy of the client entry found
+ * @param user_credentials [IN]    credentials of the caller
+ * @param proc_makes_write [IN]    TRUE if the procedure makes writes
+ * @param pindex           [OUT]   position of the client entry found, -1 if none
+ *
+ * @return as nfs_export_check_access.
+ *
+ */
+static int nfs_export_check_access_v4(sockaddr_t *hostaddr,
+                                      char *ipstring,
+                                      exportlist_t * pexport,
+                                      exportlist_client_entry_t * pclient_found,
+                                      struct user_cred *user_credentials,
+                                      bool_t proc_makes_write,
+                                      int *pindex)
+{
+  *pindex = -1;
+
+  /* check if any root access export matches this client */
+  if(user_credentials->caller_uid == 0)
+    {
+      if(export_check_match(hostaddr, ipstring, pexport, pclient_found,
+                            EXPORT_OPTION_ROOT, pindex))
+        {
+          if(pexport->access_type == ACCESSTYPE_MDONLY_RO ||
+             pexport->access_type == ACCESSTYPE_MDONLY)
+            {
+              LogFullDebug(COMPONENT_DISPATCH,
+                           "Root granted MDONLY export permission");
+              return EXPORT_MDONLY_GRANTED;
+            }
+          else
+            {
+              LogFullDebug(COMPONENT_DISPATCH,
+                           "Root granted export permission");
+              return EXPORT_PERMISSION_GRANTED;
+            }
+        }
+    }
+  /* else, check if any access only export matches this client */
+  if(proc_makes_write)
+    {
+      if(export_check_match(hostaddr, ipstring, pexport, pclient_found,
+                            EXPORT_OPTION_WRITE_ACCESS, pindex))
+        {
+          LogFullDebug(COMPONENT_DISPATCH,
+                       "Write permission to export granted");
+          return EXPORT_PERMISSION_GRANTED;
+        }
+      else if(pexport->new_access_list_version &&
+              export_check_match(hostaddr, ipstring, pexport, pclient_found,
+                                 EXPORT_OPTION_MD_WRITE_ACCESS, pindex))
+        {
+          pexport->access_type = ACCESSTYPE_MDONLY;
+          LogFullDebug(COMPONENT_DISPATCH,
+                       "MDONLY export permission granted");
+          return EXPORT_MDONLY_GRANTED;
+        }
+    }
+  else
+    {
+      /* request will not write anything */
+      if(export_check_match(hostaddr, ipstring, pexport, pclient_found,
+                            EXPORT_OPTION_READ_ACCESS, pindex))
+        {
+          if(pexport->access_type == ACCESSTYPE_MDONLY_RO ||
+             pexport->access_type == ACCESSTYPE_MDONLY)
+            {
+              LogFullDebug(COMPONENT_DISPATCH,
+                           "MDONLY export permission granted - no write");
+              return EXPORT_MDONLY_GRANTED;
+            }
+          else
+            {
+              LogFullDebug(COMPONENT_DISPATCH,
+                           "Read export permission granted");
+              return EXPORT_PERMISSION_GRANTED;
+            }
+        }
+      else if(pexport->new_access_list_version &&
+              export_check_match(hostaddr, ipstring, pexport, pclient_found,
+                                 EXPORT_OPTION_MD_READ_ACCESS, pindex))
+        {
+          pexport->access_type = ACCESSTYPE_MDONLY_RO;
+          LogFullDebug(COMPONENT_DISPATCH,
+                       "MDONLY export permission granted new access list");
+          return EXPORT_MDONLY_GRANTED;
+        }
+    }
+  LogFullDebug(COMPONENT_DISPATCH,
+               "export permission denied");
+  return EXPORT_PERMISSION_DENIED;
+}                               /* nfs_export_check_access_v4 */
+
 /**
  * nfs_export_check_access: checks if a machine is authorized to access an export entry.
  *
  * Checks if a machine is authorized to access an export entry.
  *
+ * For IPv4 clients, the verdict is looked up in the access cache of the export
+ * before walking its client list, and put in it afterwards.
+ *
  * @param ssaddr        [IN]    the complete remote address (as a sockaddr_storage to be IPv6 compliant)
  * @param ptr_req       [IN]    pointer to the related RPC request.
  * @param pexpprt       [IN]    related export entry (if found, NULL otherwise).
@@ -2426,6 +2625,10 @@ int nfs_export_check_access(sockaddr_t *hostaddr,
   int rc;
   char ipstring[SOCK_NAME_MAX];
   int ipvalid;
+  in_addr_t addr;
+  unsigned int cache_flags;
+  int index;
+  exportlist_access_type_t access_type;
 
   if (pexport != NULL)
     {
@@ -2437,11 +2640,6 @@ int nfs_export_check_access(sockaddr_t *hostaddr,
         return EXPORT_WRITE_ATTEMPT_WHEN_MDONLY_RO;
     }
 
-  ipstring[0] = '\0';
-  ipvalid = sprint_sockip(hostaddr, ipstring, sizeof(ipstring));
-  LogFullDebug(COMPONENT_DISPATCH,
-               "nfs_export_check_access for address %s", ipstring);
-
   /* For now, no matching client is found */
   memset(pclient_found, 0, sizeof(exportlist_client_entry_t));
 
@@ -2486,14 +2684,6 @@ int nfs_export_check_access(sockaddr_t *hostaddr,
     {
 #endif                          /* _USE_TIRPC_IPV6 */
 
-      /* Use IP address as a string for wild character access checks. */
-      if(!ipvalid)
-        {
-          LogCrit(COMPONENT_DISPATCH,
-                  "Could not convert the IPv4 address to a character string.");
-          return EXPORT_PERMISSION_DENIED;
-        }
-
       if(pexport == NULL)
         {
           LogCrit(COMPONENT_DISPATCH,
@@ -2501,95 +2691,40 @@ int nfs_export_check_access(sockaddr_t *hostaddr,
           return EXPORT_PERMISSION_DENIED;
         }
 
-      /* check if any root access export matches this client */
-      if(user_credentials->caller_uid == 0)
-        {
-          if(export_client_match(hostaddr,
-                                 ipstring,
-                                 &(pexport->clients),
-                                 pclient_found,
-                                 EXPORT_OPTION_ROOT))
-            {
-              if(pexport->access_type == ACCESSTYPE_MDONLY_RO ||
-                 pexport->access_type == ACCESSTYPE_MDONLY)
-                {
-                  LogFullDebug(COMPONENT_DISPATCH,
-                               "Root granted MDONLY export permission");
-                  return EXPORT_MDONLY_GRANTED;
-                }
-              else
-                {
-                  LogFullDebug(COMPONENT_DISPATCH,
-                               "Root granted export permission");
-                  return EXPORT_PERMISSION_GRANTED;
-                }
-            }
-        }
-      /* else, check if any access only export matches this client */
-      if(proc_makes_write)
+      addr = get_in_addr(hostaddr);
+      cache_flags = (user_credentials->caller_uid == 0 ? EXPORT_ACCESS_CACHE_ROOT : 0)
+          | (proc_makes_write ? EXPORT_ACCESS_CACHE_WRITE : 0);
+
+      if(nfs_export_access_cache_get(pexport, addr, cache_flags, &rc, &index, &access_type))
         {
-          if(export_client_match(hostaddr,
-                                 ipstring,
-                                 &(pexport->clients),
-                                 pclient_found,
-                                 EXPORT_OPTION_WRITE_ACCESS))
-            {
-              LogFullDebug(COMPONENT_DISPATCH,
-                           "Write permission to export granted");
-              return EXPORT_PERMISSION_GRANTED;
-            }
-          else if(pexport->new_access_list_version &&
-                  export_client_match(hostaddr,
-                                      ipstring,
-                                      &(pexport->clients),
-                                      pclient_found,
-                                      EXPORT_OPTION_MD_WRITE_ACCESS))
-            {
-              pexport->access_type = ACCESSTYPE_MDONLY;
-              LogFullDebug(COMPONENT_DISPATCH,
-                           "MDONLY export permission granted");
-              return EXPORT_MDONLY_GRANTED;
-            }
+          if(index >= 0)
+            *pclient_found = pexport->clients.clientarray[index];
+          if(pexport->new_access_list_version)
+            pexport->access_type = access_type;
+          LogFullDebug(COMPONENT_DISPATCH,
+                       "Export access verdict %d found in cache", rc);
+          return rc;
         }
-      else
+
+      ipstring[0] = '\0';
+      ipvalid = sprint_sockip(hostaddr, ipstring, sizeof(ipstring));
+      LogFullDebug(COMPONENT_DISPATCH,
+                   "nfs_export_check_access for address %s", ipstring);
+
+      /* Use IP address as a string for wild character access checks. */
+      if(!ipvalid)
         {
-          /* request will not write anything */
-          if(export_client_match(hostaddr,
-                                 ipstring,
-                                 &(pexport->clients),
-                                 pclient_found,
-                                 EXPORT_OPTION_READ_ACCESS))
-            {
-              if(pexport->access_type == ACCESSTYPE_MDONLY_RO ||
-                 pexport->access_type == ACCESSTYPE_MDONLY)
-                {
-                  LogFullDebug(COMPONENT_DISPATCH,
-                               "MDONLY export permission granted - no write");
-                  return EXPORT_MDONLY_GRANTED;
-                }
-              else
-                {
-                  LogFullDebug(COMPONENT_DISPATCH,
-                               "Read export permission granted");
-                  return EXPORT_PERMISSION_GRANTED;
-                }
-            }
-          else if(pexport->new_access_list_version &&
-                  export_client_match(hostaddr,
-                                      ipstring,
-                                      &(pexport->clients),
-                                      pclient_found,
-                                      EXPORT_OPTION_MD_READ_ACCESS))
-            {
-              pexport->access_type = ACCESSTYPE_MDONLY_RO;
-              LogFullDebug(COMPONENT_DISPATCH,
-                           "MDONLY export permission granted new access list");
-              return EXPORT_MDONLY_GRANTED;
-            }
+          LogCrit(COMPONENT_DISPATCH,
+                  "Could not convert the IPv4 address to a character string.");
+          return EXPORT_PERMISSION_DENIED;
         }
-      LogFullDebug(COMPONENT_DISPATCH,
-                   "export permission denied");
-      return EXPORT_PERMISSION_DENIED;
+
+      rc = nfs_export_check_access_v4(hostaddr, ipstring, pexport, pclient_found,
+                                      user_credentials, proc_makes_write, &index);
+
+      nfs_export_access_cache_set(pexport, addr, cache_flags, rc, index,
+                                  pexport->access_type);
+      return rc;
 
 #ifdef _USE_TIRPC_IPV6
     }
@@ -2600,6 +2735,9 @@ int nfs_export_check_access(sockaddr_t *hostaddr,
       memset(ten_bytes_all_0, 0, 10);
       struct sockaddr_in6 *psockaddr_in6 = (struct sockaddr_in6 *)hostaddr;
 
+      ipstring[0] = '\0';
+      ipvalid = sprint_sockip(hostaddr, ipstring, sizeof(ipstring));
+
       // if(isFulldebug(COMPONENT_DISPATCH))
         {
           char txtaddrv6[100];
@@ -2986,6 +3124,9 @@ exportlist_t *RemoveExportEntry(exportlist_t * exportEntry)
   if (exportEntry->proot_handle != NULL)
     Mem_Free(exportEntry->proot_handle);
 
+  nfs_export_latency_free(exportEntry);
+  nfs_export_access_free(exportEntry);
+
   Mem_Free(exportEntry);
   return next;
 }
@@ -48,6 +48,7 @@
 #include <string.h>
 #include <pthread.h>
 #include "nfs4.h"
+#include "sal_functions.h"
 
 #ifdef _APPLE
 #define strnlen( s, l ) strlen( s )
@@ -572,6 +573,8 @@ int nfs_client_id_remove(clientid4 clientid, struct prealloc_pool *clientid_pool
   Mem_Free(old_key.pdata);
   Mem_Free(pclientid);
 
+  nfs4_recovery_client_remove(clientid);
+
   return CLIENT_ID_SUCCESS;
 
 }                               /* nfs_client_id_remove */
@@ -0,0 +1,581 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_export_access.c
+ * \brief   Compiled client lists and access verdict cache of the exports.
+ *
+ * nfs_export_access.c : the client list of an export is compiled once when
+ * the export is built, so that export_client_match_index does not walk it for
+ * every request:
+ *
+ * - IPv4 host entries go to a hash table,
+ * - IPv4 network entries whose netmask is a prefix go to a binary trie,
+ *   looked up as a longest prefix match,
+ * - netgroups, wildcards, GSS principals and other networks stay in a short
+ *   list walked in order.
+ *
+ * Each table keeps, for each of the five options nfs_export_check_access looks
+ * for, the position of the first entry of the client list having it, so that
+ * the entry found is the one the linear walk would have found.
+ *
+ * On top of that, each export has a small direct mapped cache of the verdicts
+ * of nfs_export_check_access for its IPv4 clients, read without lock thanks to
+ * a sequence counter per slot. It goes away with the export, thus when the
+ * exports are reloaded by admin_replace_exports.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef _SOLARIS
+#include "solaris_port.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "rpc.h"
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs_core.h"
+#include "nfs_exports.h"
+
+/* Options nfs_export_check_access looks for, one class each */
+#define EXPORT_ACCESS_NB_CLASSES 5
+
+/* No entry of the client list in this class */
+#define EXPORT_ACCESS_NONE 0xFFFF
+
+/* Number of slots of the verdict cache of an export, a power of 2 */
+#define EXPORT_ACCESS_CACHE_SIZE 256
+
+static const unsigned int export_access_options[EXPORT_ACCESS_NB_CLASSES] = {
+  EXPORT_OPTION_ROOT,
+  EXPORT_OPTION_READ_ACCESS,
+  EXPORT_OPTION_WRITE_ACCESS,
+  EXPORT_OPTION_MD_READ_ACCESS,
+  EXPORT_OPTION_MD_WRITE_ACCESS
+};
+
+typedef struct export_access_host__
+{
+  unsigned int addr;
+  unsigned short used;
+  unsigned short first[EXPORT_ACCESS_NB_CLASSES];
+} export_access_host_t;
+
+typedef struct export_access_node__
+{
+  unsigned int child[2];        /* 0 if none, the root is nobody's child */
+  unsigned short first[EXPORT_ACCESS_NB_CLASSES];
+} export_access_node_t;
+
+struct export_access_matcher
+{
+  unsigned int host_bits;       /* the host table has 1 << host_bits slots */
+  export_access_host_t *hosts;
+  unsigned int nb_nodes;
+  export_access_node_t *nodes;
+  unsigned int nb_slow;
+  unsigned short slow[EXPORTS_NB_MAX_CLIENTS];  /* in client list order */
+  bool_t resolves_names;        /* some slow entries need the client's name */
+};
+
+typedef struct export_access_verdict__
+{
+  volatile unsigned int seq;    /* odd while the slot is written */
+  unsigned int addr;
+  unsigned int flags;
+  int verdict;
+  int index;
+  exportlist_access_type_t access_type;
+  time_t expire;                /* 0 for never */
+} export_access_verdict_t;
+
+struct export_access_cache
+{
+  export_access_verdict_t slots[EXPORT_ACCESS_CACHE_SIZE];
+};
+
+/**
+ *
+ * export_access_class: gives the class of an option.
+ *
+ * @param export_option [IN] the option looked for
+ *
+ * @return the class, -1 if the option is not one of the five classes.
+ *
+ */
+static int export_access_class(unsigned int export_option)
+{
+  int c;
+
+  for(c = 0; c < EXPORT_ACCESS_NB_CLASSES; c++)
+    if(export_access_options[c] == export_option)
+      return c;
+
+  return -1;
+}                               /* export_access_class */
+
+/**
+ *
+ * export_access_eligible: tells if a client entry is looked at for an option.
+ *
+ * Same test as the walk of export_client_match_index.
+ *
+ */
+static int export_access_eligible(exportlist_client_entry_t * pentry,
+                                  unsigned int export_option)
+{
+  return (pentry->options & export_option) != 0 &&
+      (pentry->options & EXPORT_OPTION_ROOT) == (export_option & EXPORT_OPTION_ROOT);
+}                               /* export_access_eligible */
+
+static unsigned int export_access_host_hash(unsigned int addr, unsigned int bits)
+{
+  return (addr * 2654435761U) >> (32 - bits);
+}                               /* export_access_host_hash */
+
+/**
+ *
+ * export_access_note: records a client entry in the per class positions of a table slot.
+ *
+ */
+static void export_access_note(unsigned short *first,
+                               exportlist_client_entry_t * pentry, unsigned int i)
+{
+  int c;
+
+  for(c = 0; c < EXPORT_ACCESS_NB_CLASSES; c++)
+    if(export_access_eligible(pentry, export_access_options[c]) && i < first[c])
+      first[c] = i;
+}                               /* export_access_note */
+
+/**
+ *
+ * export_access_prefix: gives the prefix length of a network entry.
+ *
+ * @param pnet [IN] the network entry
+ *
+ * @return the prefix length, -1 if the netmask is not a prefix, -2 if the
+ * network can match no address (netaddr has bits out of the netmask).
+ *
+ */
+static int export_access_prefix(exportlist_client_net_t * pnet)
+{
+  unsigned int hostmask = ~pnet->netmask;
+  int len = 0;
+
+  if((hostmask & (hostmask + 1)) != 0)
+    return -1;
+
+  if((pnet->netaddr & hostmask) != 0)
+    return -2;
+
+  while(len < 32 && (pnet->netmask & (0x80000000U >> len)) != 0)
+    len++;
+
+  return len;
+}                               /* export_access_prefix */
+
+/**
+ *
+ * nfs_export_access_compile: compiles the client list of an export.
+ *
+ * Must be called once the client list is complete, before the export is used.
+ *
+ * @param pexport [INOUT] the export
+ *
+ * @return 0 if successful, -1 if the client list is left uncompiled.
+ *
+ */
+int nfs_export_access_compile(exportlist_t * pexport)
+{
+  struct export_access_matcher *pmatcher;
+  exportlist_client_t *clients = &pexport->clients;
+  exportlist_client_entry_t *pentry;
+  unsigned int nb_hosts = 0;
+  unsigned int max_nodes = 1;
+  unsigned int i, n, slot, bit, depth;
+  int len;
+
+  pexport->access_matcher = NULL;
+
+  for(i = 0; i < clients->num_clients; i++)
+    {
+      pentry = &clients->clientarray[i];
+
+      if(pentry->type == HOSTIF_CLIENT)
+        nb_hosts++;
+      else if(pentry->type == NETWORK_CLIENT
+              && (len = export_access_prefix(&pentry->client.network)) >= 0)
+        max_nodes += len;
+    }
+
+  if((pmatcher = (struct export_access_matcher *)
+      Mem_Calloc_Label(1, sizeof(struct export_access_matcher),
+                       "export_access_matcher")) == NULL)
+    goto fail;
+
+  /* The host table is at most half full */
+  pmatcher->host_bits = 1;
+  while((1U << pmatcher->host_bits) < 2 * nb_hosts)
+    pmatcher->host_bits++;
+
+  if((pmatcher->hosts = (export_access_host_t *)
+      Mem_Calloc_Label(1U << pmatcher->host_bits, sizeof(export_access_host_t),
+                       "export_access_hosts")) == NULL
+     || (pmatcher->nodes = (export_access_node_t *)
+         Mem_Calloc_Label(max_nodes, sizeof(export_access_node_t),
+                          "export_access_nodes")) == NULL)
+    goto fail;
+
+  for(slot = 0; slot < (1U << pmatcher->host_bits); slot++)
+    memset(pmatcher->hosts[slot].first, 0xFF, sizeof(pmatcher->hosts[slot].first));
+  memset(pmatcher->nodes[0].first, 0xFF, sizeof(pmatcher->nodes[0].first));
+  pmatcher->nb_nodes = 1;
+
+  for(i = 0; i < clients->num_clients; i++)
+    {
+      pentry = &clients->clientarray[i];
+
+      switch (pentry->type)
+        {
+        case HOSTIF_CLIENT:
+          slot = export_access_host_hash(pentry->client.hostif.clientaddr,
+                                         pmatcher->host_bits);
+          while(pmatcher->hosts[slot].used
+                && pmatcher->hosts[slot].addr != pentry->client.hostif.clientaddr)
+            slot = (slot + 1) & ((1U << pmatcher->host_bits) - 1);
+
+          pmatcher->hosts[slot].used = TRUE;
+          pmatcher->hosts[slot].addr = pentry->client.hostif.clientaddr;
+          export_access_note(pmatcher->hosts[slot].first, pentry, i);
+          break;
+
+        case NETWORK_CLIENT:
+          len = export_access_prefix(&pentry->client.network);
+
+          if(len == -2)
+            break;
+
+          if(len == -1)
+            {
+              pmatcher->slow[pmatcher->nb_slow++] = i;
+              break;
+            }
+
+          /* Walk down the trie along the netaddr, most significant bit first */
+          for(n = 0, depth = 0; depth < (unsigned int)len; depth++)
+            {
+              bit = (pentry->client.network.netaddr >> (31 - depth)) & 1;
+
+              if(pmatcher->nodes[n].child[bit] == 0)
+                {
+                  pmatcher->nodes[n].child[bit] = pmatcher->nb_nodes;
+                  memset(pmatcher->nodes[pmatcher->nb_nodes].first, 0xFF,
+                         sizeof(pmatcher->nodes[0].first));
+                  pmatcher->nb_nodes++;
+                }
+              n = pmatcher->nodes[n].child[bit];
+            }
+          export_access_note(pmatcher->nodes[n].first, pentry, i);
+          break;
+
+        case NETGROUP_CLIENT:
+        case WILDCARDHOST_CLIENT:
+          pmatcher->resolves_names = TRUE;
+          pmatcher->slow[pmatcher->nb_slow++] = i;
+          break;
+
+        case GSSPRINCIPAL_CLIENT:
+          pmatcher->slow[pmatcher->nb_slow++] = i;
+          break;
+
+        default:
+          /* never matched by an IPv4 address */
+          break;
+        }
+    }
+
+  /* Push the positions down to the descendants, nodes are created after their
+   * parent: the deepest node reached by an address then holds the first
+   * matching network entry of each class */
+  for(n = 0; n < pmatcher->nb_nodes; n++)
+    for(bit = 0; bit < 2; bit++)
+      if(pmatcher->nodes[n].child[bit] != 0)
+        {
+          export_access_node_t *pchild = &pmatcher->nodes[pmatcher->nodes[n].child[bit]];
+          int c;
+
+          for(c = 0; c < EXPORT_ACCESS_NB_CLASSES; c++)
+            if(pmatcher->nodes[n].first[c] < pchild->first[c])
+              pchild->first[c] = pmatcher->nodes[n].first[c];
+        }
+
+  pexport->access_matcher = pmatcher;
+
+  LogDebug(COMPONENT_CONFIG,
+           "Export %d: client list compiled, %u hosts, %u trie nodes, %u other entries",
+           pexport->id, nb_hosts, pmatcher->nb_nodes, pmatcher->nb_slow);
+
+  return 0;
+
+ fail:
+  LogCrit(COMPONENT_CONFIG,
+          "Export %d: could not allocate its compiled client list, it will be walked",
+          pexport->id);
+
+  if(pmatcher != NULL)
+    {
+      if(pmatcher->hosts != NULL)
+        Mem_Free(pmatcher->hosts);
+      Mem_Free(pmatcher);
+    }
+  return -1;
+}                               /* nfs_export_access_compile */
+
+/**
+ *
+ * nfs_export_access_free: releases the compiled client list and the verdict cache of an export.
+ *
+ * Must be called when no worker uses the export anymore.
+ *
+ * @param pexport [INOUT] the export
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_export_access_free(exportlist_t * pexport)
+{
+  if(pexport->access_matcher != NULL)
+    {
+      Mem_Free(pexport->access_matcher->hosts);
+      Mem_Free(pexport->access_matcher->nodes);
+      Mem_Free(pexport->access_matcher);
+      pexport->access_matcher = NULL;
+    }
+
+  if(pexport->access_cache != NULL)
+    {
+      Mem_Free(pexport->access_cache);
+      pexport->access_cache = NULL;
+    }
+}                               /* nfs_export_access_free */
+
+/**
+ *
+ * nfs_export_access_match: looks for the first entry of a compiled client list matching a client.
+ *
+ * @param pmatcher      [IN]  the compiled client list
+ * @param hostaddr      [IN]  the client address
+ * @param ipstring      [IN]  the client address as a string, for the wildcards
+ * @param clients       [IN]  the client list pmatcher was compiled from
+ * @param export_option [IN]  the options the entry must have
+ * @param pindex        [OUT] position of the entry found, -1 if none
+ *
+ * @return TRUE if *pindex was set, FALSE if the client list must be walked
+ * (not an IPv4 address or an option the list was not compiled for).
+ *
+ */
+int nfs_export_access_match(struct export_access_matcher *pmatcher,
+                            sockaddr_t *hostaddr,
+                            char *ipstring,
+                            exportlist_client_t *clients,
+                            unsigned int export_option, int *pindex)
+{
+  in_addr_t addr;
+  unsigned int best = EXPORT_ACCESS_NONE;
+  unsigned int slot, n, child, depth, i, k;
+  int c;
+
+#ifdef _USE_TIRPC
+  if(hostaddr->ss_family != AF_INET)
+    return FALSE;
+#endif
+
+  if((c = export_access_class(export_option)) < 0)
+    return FALSE;
+
+  addr = get_in_addr(hostaddr);
+
+  /* Host entries */
+  slot = export_access_host_hash(addr, pmatcher->host_bits);
+  while(pmatcher->hosts[slot].used)
+    {
+      if(pmatcher->hosts[slot].addr == addr)
+        {
+          best = pmatcher->hosts[slot].first[c];
+          break;
+        }
+      slot = (slot + 1) & ((1U << pmatcher->host_bits) - 1);
+    }
+
+  /* Network entries, the deepest node reached holds the answer */
+  for(n = 0, depth = 0; depth < 32; depth++)
+    {
+      child = pmatcher->nodes[n].child[(addr >> (31 - depth)) & 1];
+      if(child == 0)
+        break;
+      n = child;
+    }
+  if(pmatcher->nodes[n].first[c] < best)
+    best = pmatcher->nodes[n].first[c];
+
+  /* Other entries, only those before the best match found so far matter */
+  for(k = 0; k < pmatcher->nb_slow && pmatcher->slow[k] < best; k++)
+    {
+      i = pmatcher->slow[k];
+
+      if(!export_access_eligible(&clients->clientarray[i], export_option))
+        continue;
+
+      switch (export_client_match_entry(hostaddr, ipstring, &clients->clientarray[i], i))
+        {
+        case EXPORT_CLIENT_MATCH:
+          *pindex = (int)i;
+          return TRUE;
+
+        case EXPORT_CLIENT_STOP:
+          *pindex = -1;
+          return TRUE;
+        }
+    }
+
+  *pindex = (best == EXPORT_ACCESS_NONE) ? -1 : (int)best;
+  return TRUE;
+}                               /* nfs_export_access_match */
+
+static export_access_verdict_t *export_access_slot(struct export_access_cache *pcache,
+                                                   in_addr_t addr, unsigned int flags)
+{
+  return &pcache->slots[(((addr ^ flags) * 2654435761U) >> 16)
+                        & (EXPORT_ACCESS_CACHE_SIZE - 1)];
+}                               /* export_access_slot */
+
+/**
+ *
+ * nfs_export_access_cache_get: looks for a cached access verdict.
+ *
+ * @param pexport      [IN]  the export
+ * @param addr         [IN]  the IPv4 address of the client
+ * @param flags        [IN]  EXPORT_ACCESS_CACHE_ROOT and EXPORT_ACCESS_CACHE_WRITE
+ * @param pverdict     [OUT] the verdict of nfs_export_check_access
+ * @param pindex       [OUT] position of the client entry found, -1 if none
+ * @param paccess_type [OUT] access type of the export after the verdict
+ *
+ * @return TRUE if the verdict was found, FALSE otherwise.
+ *
+ */
+int nfs_export_access_cache_get(exportlist_t * pexport, in_addr_t addr,
+                                unsigned int flags, int *pverdict, int *pindex,
+                                exportlist_access_type_t * paccess_type)
+{
+  export_access_verdict_t *pslot;
+  unsigned int seq;
+  time_t expire;
+  int found;
+
+  if(pexport->access_cache == NULL)
+    return FALSE;
+
+  pslot = export_access_slot(pexport->access_cache, addr, flags);
+
+  seq = pslot->seq;
+  if(seq & 1)
+    return FALSE;
+  __sync_synchronize();
+
+  found = (seq != 0 && pslot->addr == addr && pslot->flags == flags);
+  *pverdict = pslot->verdict;
+  *pindex = pslot->index;
+  *paccess_type = pslot->access_type;
+  expire = pslot->expire;
+
+  /* The slot must not have been written meanwhile */
+  __sync_synchronize();
+  if(pslot->seq != seq || !found)
+    return FALSE;
+
+  return expire == 0 || expire > time(NULL);
+}                               /* nfs_export_access_cache_get */
+
+/**
+ *
+ * nfs_export_access_cache_set: caches an access verdict.
+ *
+ * Nothing is cached if the client list of the export is not compiled, or if
+ * another thread is writing the same slot. Verdicts that depended on the
+ * name of the client expire with the IP/name cache.
+ *
+ * @param pexport     [INOUT] the export
+ * @param addr        [IN]    the IPv4 address of the client
+ * @param flags       [IN]    EXPORT_ACCESS_CACHE_ROOT and EXPORT_ACCESS_CACHE_WRITE
+ * @param verdict     [IN]    the verdict of nfs_export_check_access
+ * @param index       [IN]    position of the client entry found, -1 if none
+ * @param access_type [IN]    access type of the export after the verdict
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_export_access_cache_set(exportlist_t * pexport, in_addr_t addr,
+                                 unsigned int flags, int verdict, int index,
+                                 exportlist_access_type_t access_type)
+{
+  struct export_access_cache *pcache;
+  export_access_verdict_t *pslot;
+  unsigned int seq;
+
+  if(pexport->access_matcher == NULL)
+    return;
+
+  if((pcache = pexport->access_cache) == NULL)
+    {
+      if((pcache = (struct export_access_cache *)
+          Mem_Calloc_Label(1, sizeof(struct export_access_cache),
+                           "export_access_cache")) == NULL)
+        return;
+
+      if(!__sync_bool_compare_and_swap(&pexport->access_cache, NULL, pcache))
+        {
+          Mem_Free(pcache);
+          pcache = pexport->access_cache;
+        }
+    }
+
+  pslot = export_access_slot(pcache, addr, flags);
+
+  seq = pslot->seq;
+  if((seq & 1) || !__sync_bool_compare_and_swap(&pslot->seq, seq, seq + 1))
+    return;
+
+  pslot->addr = addr;
+  pslot->flags = flags;
+  pslot->verdict = verdict;
+  pslot->index = index;
+  pslot->access_type = access_type;
+  pslot->expire = pexport->access_matcher->resolves_names ?
+      time(NULL) + nfs_param.ip_name_param.expiration_time : 0;
+
+  __sync_synchronize();
+  pslot->seq = seq + 2;
+}                               /* nfs_export_access_cache_set */
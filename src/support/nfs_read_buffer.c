@@ -0,0 +1,205 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * ---------------------------------------
+ */
+
+/**
+ * \file    nfs_read_buffer.c
+ * \brief   Pooled buffers for the data of READ replies.
+ *
+ * nfs_read_buffer.c : Pooled buffers for the data of READ replies.
+ *
+ * READ data is read by the FSAL straight into one of these buffers, which is
+ * then handed as is to the XDR encoder: on TCP, large opaque data is sent
+ * from the buffer with writev and never copied (see Xdrrec_putbytes).
+ *
+ * Buffers are page aligned, so that the FSAL can do direct I/O in them, and
+ * reference counted, so that whoever sends the data can keep it after the
+ * reply has been freed. Released buffers are kept in free lists, one per
+ * power of 2 size, and reused without going through the allocator.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "log_macros.h"
+#include "nfs_proto_tools.h"
+
+/* The header of a buffer sits in the page before its data */
+#define NFS_READ_BUFFER_ALIGN    4096
+#define NFS_READ_BUFFER_MIN_SHIFT 12    /* 4KB */
+#define NFS_READ_BUFFER_MAX_SHIFT 20    /* 1MB */
+#define NFS_READ_BUFFER_NB_CLASS  (NFS_READ_BUFFER_MAX_SHIFT - NFS_READ_BUFFER_MIN_SHIFT + 1)
+
+/* Memory kept in the free list of each size */
+#define NFS_READ_BUFFER_POOL_BYTES (32 * 1024 * 1024)
+
+typedef struct nfs_read_buffer__
+{
+  struct nfs_read_buffer__ *next;     /* in the free list */
+  unsigned int refcount;
+  int class;                          /* -1 if too large to be pooled */
+} nfs_read_buffer_t;
+
+typedef struct nfs_read_buffer_pool__
+{
+  pthread_mutex_t lock;
+  nfs_read_buffer_t *free_list;
+  unsigned int nb_free;
+  unsigned int nb_max_free;
+} nfs_read_buffer_pool_t;
+
+static nfs_read_buffer_pool_t read_buffer_pool[NFS_READ_BUFFER_NB_CLASS];
+static pthread_once_t read_buffer_once = PTHREAD_ONCE_INIT;
+
+static void nfs_read_buffer_init(void)
+{
+  int i;
+
+  for(i = 0; i < NFS_READ_BUFFER_NB_CLASS; i++)
+    {
+      pthread_mutex_init(&read_buffer_pool[i].lock, NULL);
+      read_buffer_pool[i].free_list = NULL;
+      read_buffer_pool[i].nb_free = 0;
+      read_buffer_pool[i].nb_max_free =
+          NFS_READ_BUFFER_POOL_BYTES >> (NFS_READ_BUFFER_MIN_SHIFT + i);
+    }
+}                               /* nfs_read_buffer_init */
+
+#define nfs_read_buffer_data(pbuff) ((caddr_t) (pbuff) + NFS_READ_BUFFER_ALIGN)
+#define nfs_read_buffer_header(data) \
+  ((nfs_read_buffer_t *) ((caddr_t) (data) - NFS_READ_BUFFER_ALIGN))
+
+/**
+ *
+ * nfs_read_buffer_get: gets a buffer for the data of a READ.
+ *
+ * Gets a page aligned buffer of at least size bytes, with one reference.
+ *
+ * @param size [IN] the size of the buffer.
+ *
+ * @return the buffer, or NULL if no memory is available.
+ *
+ */
+caddr_t nfs_read_buffer_get(size_t size)
+{
+  nfs_read_buffer_t *pbuff = NULL;
+  nfs_read_buffer_pool_t *pool;
+  int class = 0;
+  void *mem;
+
+  pthread_once(&read_buffer_once, nfs_read_buffer_init);
+
+  while(class < NFS_READ_BUFFER_NB_CLASS &&
+        size > (1UL << (NFS_READ_BUFFER_MIN_SHIFT + class)))
+    class++;
+
+  if(class < NFS_READ_BUFFER_NB_CLASS)
+    {
+      pool = &read_buffer_pool[class];
+
+      P(pool->lock);
+      if((pbuff = pool->free_list) != NULL)
+        {
+          pool->free_list = pbuff->next;
+          pool->nb_free -= 1;
+        }
+      V(pool->lock);
+
+      size = 1UL << (NFS_READ_BUFFER_MIN_SHIFT + class);
+    }
+  else
+    class = -1;
+
+  if(pbuff == NULL)
+    {
+      if(posix_memalign(&mem, NFS_READ_BUFFER_ALIGN, NFS_READ_BUFFER_ALIGN + size) != 0)
+        {
+          LogCrit(COMPONENT_NFSPROTO, "Could not allocate a %llu bytes READ buffer",
+                  (unsigned long long)size);
+          return NULL;
+        }
+
+      pbuff = (nfs_read_buffer_t *) mem;
+      pbuff->class = class;
+    }
+
+  pbuff->next = NULL;
+  pbuff->refcount = 1;
+
+  return nfs_read_buffer_data(pbuff);
+}                               /* nfs_read_buffer_get */
+
+/**
+ *
+ * nfs_read_buffer_hold: takes one more reference on a buffer.
+ *
+ * @param data [IN] a buffer returned by nfs_read_buffer_get.
+ *
+ */
+void nfs_read_buffer_hold(caddr_t data)
+{
+  __sync_fetch_and_add(&nfs_read_buffer_header(data)->refcount, 1);
+}                               /* nfs_read_buffer_hold */
+
+/**
+ *
+ * nfs_read_buffer_release: releases one reference on a buffer.
+ *
+ * Releases one reference on a buffer. The last reference puts it back in
+ * its free list, or frees it if the free list is full.
+ *
+ * @param data [IN] a buffer returned by nfs_read_buffer_get, NULL is allowed.
+ *
+ */
+void nfs_read_buffer_release(caddr_t data)
+{
+  nfs_read_buffer_t *pbuff;
+  nfs_read_buffer_pool_t *pool;
+
+  if(data == NULL)
+    return;
+
+  pbuff = nfs_read_buffer_header(data);
+
+  if(__sync_sub_and_fetch(&pbuff->refcount, 1) != 0)
+    return;
+
+  if(pbuff->class >= 0)
+    {
+      pool = &read_buffer_pool[pbuff->class];
+
+      P(pool->lock);
+      if(pool->nb_free < pool->nb_max_free)
+        {
+          pbuff->next = pool->free_list;
+          pool->free_list = pbuff;
+          pool->nb_free += 1;
+          pbuff = NULL;
+        }
+      V(pool->lock);
+    }
+
+  if(pbuff != NULL)
+    free(pbuff);
+}                               /* nfs_read_buffer_release */
@@ -169,10 +169,6 @@ int nfs_read_worker_conf(config_file_t in_config, nfs_worker_parameter_t * ppara
         {
           pparam->nb_before_gc = atoi(key_value);
         }
-      else if(!strcasecmp(key_name, "Nb_DupReq_Prealloc"))
-        {
-          pparam->nb_dupreq_prealloc = atoi(key_value);
-        }
       else if(!strcasecmp(key_name, "Nb_DupReq_Before_GC"))
         {
           pparam->nb_dupreq_before_gc = atoi(key_value);
@@ -185,13 +181,19 @@ int nfs_read_worker_conf(config_file_t in_config, nfs_worker_parameter_t * ppara
         {
           pparam->nb_ip_stats_prealloc = atoi(key_value);
         }
-      else if(!strcasecmp(key_name, "LRU_Pending_Job_Prealloc_PoolSize"))
+      else if(!strcasecmp(key_name, "Pending_Queue_Size") ||
+              !strcasecmp(key_name, "LRU_Pending_Job_Prealloc_PoolSize"))
         {
-          pparam->lru_param.nb_entry_prealloc = atoi(key_value);
+          /* The pending jobs used to be kept in a LRU, the old key is still accepted */
+          pparam->nb_pending_queue_size = atoi(key_value);
         }
-      else if(!strcasecmp(key_name, "LRU_DupReq_Prealloc_PoolSize"))
+      else if(!strcasecmp(key_name, "Nb_DupReq_Prealloc") ||
+              !strcasecmp(key_name, "LRU_DupReq_Prealloc_PoolSize"))
         {
-          pparam->lru_dupreq.nb_entry_prealloc = atoi(key_value);
+          /* The duplicate request cache is sized by Entries_Per_Client in
+           * NFS_DupReq_Hash, the keys are accepted and ignored */
+          LogEvent(COMPONENT_CONFIG,
+                   "NFS_Worker_Param: %s is obsolete and ignored", key_name);
         }
       else
         {
@@ -269,9 +271,15 @@ int nfs_read_core_conf(config_file_t in_config, nfs_core_parameter_t * pparam)
         {
           pparam->nb_worker = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Affinity_Max_Pending"))
+        {
+          pparam->nb_affinity_max_pending = atoi(key_value);
+        }
       else if(!strcasecmp(key_name, "Nb_Call_Before_Queue_Avg"))
         {
-          pparam->nb_call_before_queue_avg = atoi(key_value);
+          /* Queue lengths are no longer averaged, the key is accepted and ignored */
+          LogEvent(COMPONENT_CONFIG,
+                   "NFS_Core_Param: %s is obsolete and ignored", key_name);
         }
       else if(!strcasecmp(key_name, "Nb_MaxConcurrentGC"))
         {
@@ -442,6 +450,18 @@ int nfs_read_core_conf(config_file_t in_config, nfs_core_parameter_t * pparam)
         {
           pparam->tcp_fridge_expiration_delay = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Nb_TCP_Reactor"))
+        {
+          pparam->nb_tcp_reactor = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "TCP_Write_Timeout"))
+        {
+          pparam->tcp_write_timeout = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Nb_UDP_Receiver"))
+        {
+          pparam->nb_udp_receiver = atoi(key_value);
+        }
       else if(!strcasecmp(key_name, "Dump_Stats_Per_Client"))
         {
           pparam->dump_stats_per_client = StrToBoolean(key_value);
@@ -462,6 +482,28 @@ int nfs_read_core_conf(config_file_t in_config, nfs_core_parameter_t * pparam)
         {
           pparam->max_recv_buffer_size = atoi(key_value);
         }      
+      else if(!strcasecmp(key_name, "Async_Log"))
+        {
+          pparam->async_log = StrToBoolean(key_value);
+        }
+      else if(!strcasecmp(key_name, "Async_Log_Ring_Size"))
+        {
+          pparam->async_log_ring_size = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Async_Log_Overflow"))
+        {
+          if(!strcasecmp(key_value, "DROP"))
+            pparam->async_log_overflow = LOG_OVERFLOW_DROP;
+          else if(!strcasecmp(key_value, "BLOCK"))
+            pparam->async_log_overflow = LOG_OVERFLOW_BLOCK;
+          else
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "Invalid value for %s: %s (item %s), expected DROP or BLOCK",
+                      key_name, key_value, CONF_LABEL_NFS_CORE);
+              return -1;
+            }
+        }
       else
         {
           LogCrit(COMPONENT_CONFIG,
@@ -547,6 +589,20 @@ int nfs_read_dupreq_hash_conf(config_file_t in_config,
         {
           pparam->hash_param.nb_node_prealloc = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Backend"))
+        {
+          if(HashTable_Str2Backend(key_value, &pparam->hash_param.backend) != 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "Invalid value for %s: %s (item %s), expected RBT or Open_Addressing",
+                      key_name, key_value, CONF_LABEL_NFS_DUPREQ);
+              return -1;
+            }
+        }
+      else if(!strcasecmp(key_name, "Entries_Per_Client"))
+        {
+          pparam->nb_entries_per_client = atoi(key_value);
+        }
       else
         {
           LogCrit(COMPONENT_CONFIG,
@@ -710,6 +766,16 @@ int nfs_read_client_id_conf(config_file_t in_config, nfs_client_id_parameter_t *
         {
           pparam->hash_param.nb_node_prealloc = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Backend"))
+        {
+          if(HashTable_Str2Backend(key_value, &pparam->hash_param.backend) != 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "Invalid value for %s: %s (item %s), expected RBT or Open_Addressing",
+                      key_name, key_value, CONF_LABEL_CLIENT_ID);
+              return -1;
+            }
+        }
       else
         {
           LogCrit(COMPONENT_CONFIG,
@@ -784,6 +850,16 @@ int nfs_read_state_id_conf(config_file_t in_config, nfs_state_id_parameter_t * p
         {
           pparam->hash_param.nb_node_prealloc = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Backend"))
+        {
+          if(HashTable_Str2Backend(key_value, &pparam->hash_param.backend) != 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "Invalid value for %s: %s (item %s), expected RBT or Open_Addressing",
+                      key_name, key_value, CONF_LABEL_STATE_ID);
+              return -1;
+            }
+        }
       else
         {
           LogCrit(COMPONENT_CONFIG,
@@ -847,6 +923,16 @@ int nfs_read_session_id_conf(config_file_t in_config, nfs_session_id_parameter_t
         {
           pparam->hash_param.nb_node_prealloc = atoi(key_value);
         }
+      else if(!strcasecmp(key_name, "Backend"))
+        {
+          if(HashTable_Str2Backend(key_value, &pparam->hash_param.backend) != 0)
+            {
+              LogCrit(COMPONENT_CONFIG,
+                      "Invalid value for %s: %s (item %s), expected RBT or Open_Addressing",
+                      key_name, key_value, CONF_LABEL_SESSION_ID);
+              return -1;
+            }
+        }
       else
         {
           LogCrit(COMPONENT_CONFIG,
@@ -1207,6 +1293,18 @@ int nfs_read_version4_conf(config_file_t in_config, nfs_version4_parameter_t * p
         {
           pparam->return_bad_stateid = StrToBoolean(key_value);
         }
+      else if(!strcasecmp(key_name, "Recovery_Journal"))
+        {
+          strncpy(pparam->recov_journal, key_value, MAXPATHLEN);
+        }
+      else if(!strcasecmp(key_name, "Recovery_Journal_Size"))
+        {
+          pparam->recov_journal_size = atoi(key_value);
+        }
+      else if(!strcasecmp(key_name, "Delegations"))
+        {
+          pparam->allow_delegations = StrToBoolean(key_value);
+        }
       else
         {
           LogCrit(COMPONENT_CONFIG,
@@ -1233,8 +1331,8 @@ int nfs_read_version4_conf(config_file_t in_config, nfs_version4_parameter_t * p
 void Print_param_worker_in_log(nfs_worker_parameter_t * pparam)
 {
   LogInfo(COMPONENT_INIT,
-          "NFS PARAM : worker_param.lru_param.nb_entry_prealloc = %d",
-          pparam->lru_param.nb_entry_prealloc);
+          "NFS PARAM : worker_param.nb_pending_queue_size = %d",
+          pparam->nb_pending_queue_size);
   LogInfo(COMPONENT_INIT,
           "NFS PARAM : worker_param.nb_pending_prealloc = %d",
           pparam->nb_pending_prealloc);
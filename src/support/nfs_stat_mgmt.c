@@ -96,6 +96,7 @@ void nfs_stat_update(nfs_stat_type_t type,
                      nfs_request_latency_stat_t * lstat_req)
 {
   nfs_request_stat_item_t *pitem = NULL;
+  nfs_latency_histogram_t *phisto = NULL;
   int up_counter = 1;
 
   /* Don't increase counters when updating await time. */
@@ -116,12 +117,16 @@ void nfs_stat_update(nfs_stat_type_t type,
 
         case NFS_V3:
           pitem = &pstat_req->stat_req_nfs3[preq->rq_proc];
+          if(pstat_req->platency != NULL)
+            phisto = &pstat_req->platency->nfs3[preq->rq_proc];
           if(up_counter)
             pstat_req->nb_nfs3_req += 1;
           break;
 
         case NFS_V4:
           pitem = &pstat_req->stat_req_nfs4[preq->rq_proc];
+          if(pstat_req->platency != NULL)
+            phisto = &pstat_req->platency->nfs4[preq->rq_proc];
           if(up_counter)
             pstat_req->nb_nfs4_req += 1;
 
@@ -234,6 +239,9 @@ void nfs_stat_update(nfs_stat_type_t type,
         {
           pitem->min_latency = lstat_req->latency;
         }
+
+      if(phisto != NULL)
+        nfs_latency_record(phisto, lstat_req->latency);
     }
   else if(lstat_req->type == AWAIT_TIME)
     {
@@ -263,3 +271,206 @@ void nfs_stat_update(nfs_stat_type_t type,
   return;
 
 }                               /* nfs_stat_update */
+
+/**
+ *
+ * nfs_latency_merge: adds a latency histogram to another one.
+ *
+ * Adds a latency histogram to another one. The source may be updated by its worker
+ * in the meantime: the merge then misses a few requests, which does no harm.
+ *
+ * @param pdest [INOUT] the histogram to add to
+ * @param psrc  [IN]    the histogram to add
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_latency_merge(nfs_latency_histogram_t * pdest, nfs_latency_histogram_t * psrc)
+{
+  unsigned int i;
+
+  for(i = 0; i < NFS_LATENCY_NB_BUCKETS; i++)
+    pdest->count[i] += psrc->count[i];
+}                               /* nfs_latency_merge */
+
+/**
+ *
+ * nfs_latency_total: number of latencies recorded in a histogram.
+ *
+ * @param phisto [IN] the histogram
+ *
+ * @return the number of recorded latencies.
+ *
+ */
+unsigned long long nfs_latency_total(nfs_latency_histogram_t * phisto)
+{
+  unsigned long long total = 0;
+  unsigned int i;
+
+  for(i = 0; i < NFS_LATENCY_NB_BUCKETS; i++)
+    total += phisto->count[i];
+
+  return total;
+}                               /* nfs_latency_total */
+
+/**
+ *
+ * nfs_latency_bucket_max: highest latency falling in a bucket.
+ *
+ * @param bucket [IN] the bucket index
+ *
+ * @return the highest latency, in microseconds, counted in this bucket.
+ *
+ */
+static unsigned int nfs_latency_bucket_max(unsigned int bucket)
+{
+  unsigned int shift;
+  unsigned int sub;
+
+  if(bucket < (1 << NFS_LATENCY_SUB_BITS))
+    return bucket;
+
+  shift = (bucket >> NFS_LATENCY_SUB_BITS) - 1;
+  sub = bucket & ((1 << NFS_LATENCY_SUB_BITS) - 1);
+
+  return (((1U << NFS_LATENCY_SUB_BITS) + sub + 1) << shift) - 1;
+}                               /* nfs_latency_bucket_max */
+
+/**
+ *
+ * nfs_latency_percentile: latency under which a given fraction of the requests completed.
+ *
+ * @param phisto     [IN] the histogram
+ * @param total      [IN] the number of latencies in the histogram (see nfs_latency_total)
+ * @param percentile [IN] the fraction of requests, between 0 and 1
+ *
+ * @return the latency in microseconds, with a relative error below 1/2^NFS_LATENCY_SUB_BITS,
+ * or 0 if the histogram is empty.
+ *
+ */
+unsigned int nfs_latency_percentile(nfs_latency_histogram_t * phisto,
+                                    unsigned long long total, double percentile)
+{
+  unsigned long long rank;
+  unsigned long long seen = 0;
+  unsigned int i;
+
+  if(total == 0)
+    return 0;
+
+  rank = (unsigned long long)(percentile * total + 0.5);
+  if(rank == 0)
+    rank = 1;
+
+  for(i = 0; i < NFS_LATENCY_NB_BUCKETS; i++)
+    {
+      seen += phisto->count[i];
+      if(seen >= rank)
+        return nfs_latency_bucket_max(i);
+    }
+
+  return nfs_latency_max(phisto);
+}                               /* nfs_latency_percentile */
+
+/**
+ *
+ * nfs_latency_max: highest latency recorded in a histogram.
+ *
+ * @param phisto [IN] the histogram
+ *
+ * @return the latency in microseconds, or 0 if the histogram is empty.
+ *
+ */
+unsigned int nfs_latency_max(nfs_latency_histogram_t * phisto)
+{
+  int i;
+
+  for(i = NFS_LATENCY_NB_BUCKETS - 1; i >= 0; i--)
+    if(phisto->count[i] != 0)
+      return nfs_latency_bucket_max(i);
+
+  return 0;
+}                               /* nfs_latency_max */
+
+/**
+ *
+ * nfs_export_latency_record: records the latency of a request on an export.
+ *
+ * Records the latency of a request in the export's histogram owned by the worker.
+ * The array of histograms and the worker's histogram are allocated on first use, so
+ * that unused exports cost nothing, and no two workers ever write the same counters.
+ *
+ * @param pexport      [INOUT] the export the request was made on
+ * @param worker_index [IN]    the index of the worker that processed the request
+ * @param latency      [IN]    the latency in microseconds
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_export_latency_record(exportlist_t * pexport, unsigned int worker_index,
+                               unsigned int latency)
+{
+  nfs_latency_histogram_t **shards = pexport->latency_shards;
+  nfs_latency_histogram_t *phisto;
+
+  if(worker_index >= nfs_param.core_param.nb_worker)
+    return;
+
+  if(shards == NULL)
+    {
+      shards = (nfs_latency_histogram_t **)
+          Mem_Calloc_Label(nfs_param.core_param.nb_worker,
+                           sizeof(nfs_latency_histogram_t *), "export latency shards");
+      if(shards == NULL)
+        return;
+
+      /* Another worker may have installed its own array in the meantime */
+      if(!__sync_bool_compare_and_swap(&pexport->latency_shards, NULL, shards))
+        {
+          Mem_Free(shards);
+          shards = pexport->latency_shards;
+        }
+    }
+
+  if((phisto = shards[worker_index]) == NULL)
+    {
+      phisto = (nfs_latency_histogram_t *)
+          Mem_Alloc_Label(sizeof(nfs_latency_histogram_t), "export latency histogram");
+      if(phisto == NULL)
+        return;
+
+      memset(phisto, 0, sizeof(nfs_latency_histogram_t));
+
+      /* The stat exporter must not see the histogram before it is zeroed */
+      __sync_synchronize();
+      shards[worker_index] = phisto;
+    }
+
+  nfs_latency_record(phisto, latency);
+}                               /* nfs_export_latency_record */
+
+/**
+ *
+ * nfs_export_latency_free: releases the latency histograms of an export.
+ *
+ * Must be called when no worker uses the export anymore.
+ *
+ * @param pexport [INOUT] the export
+ *
+ * @return nothing (void function)
+ *
+ */
+void nfs_export_latency_free(exportlist_t * pexport)
+{
+  unsigned int i;
+
+  if(pexport->latency_shards == NULL)
+    return;
+
+  for(i = 0; i < nfs_param.core_param.nb_worker; i++)
+    if(pexport->latency_shards[i] != NULL)
+      Mem_Free(pexport->latency_shards[i]);
+
+  Mem_Free(pexport->latency_shards);
+  pexport->latency_shards = NULL;
+}                               /* nfs_export_latency_free */
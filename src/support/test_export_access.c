@@ -0,0 +1,267 @@
+/*
+ * vim:expandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * \file    test_export_access.c
+ * \brief   Checks the compiled client lists against the linear walk.
+ *
+ * Builds random client lists of hosts, networks and GSS principals, checks
+ * that the compiled list finds the same entry as the linear walk for random
+ * addresses close to the listed ones, then times both and checks the access
+ * verdict cache.
+ *
+ * Usage: test_export_access [nb_loops]
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include "rpc.h"
+#include "log_macros.h"
+#include "stuff_alloc.h"
+#include "nfs_core.h"
+#include "nfs_exports.h"
+#include "MesureTemps.h"
+
+#define NB_LISTS 200
+#define NB_ADDRS 2000
+#define NB_LOOPS_DEFAULT 1000000
+
+static const unsigned int test_options[] = {
+  EXPORT_OPTION_ROOT,
+  EXPORT_OPTION_READ_ACCESS,
+  EXPORT_OPTION_WRITE_ACCESS,
+  EXPORT_OPTION_MD_READ_ACCESS,
+  EXPORT_OPTION_MD_WRITE_ACCESS
+};
+
+#define NB_OPTIONS (sizeof(test_options) / sizeof(unsigned int))
+
+/* Addresses are taken in 10.x.y.z, so that they meet the listed ones */
+static unsigned int random_addr(void)
+{
+  return 0x0A000000U | (random() & 0x0303FF);
+}                               /* random_addr */
+
+static void random_entry(exportlist_client_entry_t * pentry)
+{
+  unsigned int len;
+
+  memset(pentry, 0, sizeof(exportlist_client_entry_t));
+
+  /* Any mix of the options, with or without root */
+  pentry->options = random() & (EXPORT_OPTION_ROOT | EXPORT_OPTION_READ_ACCESS
+                                | EXPORT_OPTION_WRITE_ACCESS
+                                | EXPORT_OPTION_MD_READ_ACCESS
+                                | EXPORT_OPTION_MD_WRITE_ACCESS);
+
+  switch (random() % 10)
+    {
+    case 0:
+      pentry->type = GSSPRINCIPAL_CLIENT;
+      break;
+
+    case 1:
+      /* a netmask which is not a prefix */
+      pentry->type = NETWORK_CLIENT;
+      pentry->client.network.netmask = 0xFFFF00FFU;
+      pentry->client.network.netaddr = random_addr() & 0xFFFF00FFU;
+      break;
+
+    case 2:
+    case 3:
+    case 4:
+      pentry->type = NETWORK_CLIENT;
+      len = 8 + random() % 25;
+      pentry->client.network.netmask = 0xFFFFFFFFU << (32 - len);
+      pentry->client.network.netaddr = random_addr() & pentry->client.network.netmask;
+      break;
+
+    default:
+      pentry->type = HOSTIF_CLIENT;
+      pentry->client.hostif.clientaddr = random_addr();
+      break;
+    }
+}                               /* random_entry */
+
+static void make_addr(sockaddr_t * phostaddr, char *ipstring, unsigned int addr)
+{
+  struct sockaddr_in *psin = (struct sockaddr_in *)phostaddr;
+
+  memset(phostaddr, 0, sizeof(sockaddr_t));
+  psin->sin_family = AF_INET;
+  psin->sin_addr.s_addr = addr;
+  sprintf(ipstring, "%u.%u.%u.%u", addr >> 24, (addr >> 16) & 0xFF,
+          (addr >> 8) & 0xFF, addr & 0xFF);
+}                               /* make_addr */
+
+int main(int argc, char *argv[])
+{
+  static exportlist_t export;
+  sockaddr_t hostaddr;
+  char ipstring[SOCK_NAME_MAX];
+  unsigned int addr;
+  struct Temps debut;
+  struct Temps fin;
+  double secs_walk;
+  double secs_compiled;
+  unsigned int nb_loops = NB_LOOPS_DEFAULT;
+  unsigned int l, a, o, i;
+  int index_walk, index_compiled, verdict, index;
+  exportlist_access_type_t access_type;
+  int rc = 0;
+
+  if(argc > 1)
+    nb_loops = (unsigned int)atoi(argv[1]);
+
+#ifndef _NO_BUDDY_SYSTEM
+  if(BuddyInit(NULL) != BUDDY_SUCCESS)
+    {
+      fprintf(stderr, "Error while initializing Buddy system allocator\n");
+      exit(1);
+    }
+#endif
+
+  SetNamePgm("test_export_access");
+  SetDefaultLogging("TEST");
+  SetNameFunction("main");
+  InitLogging();
+
+  srandom(152);
+
+  /* Same entry found by the compiled list and the walk */
+  for(l = 0; l < NB_LISTS && rc == 0; l++)
+    {
+      memset(&export, 0, sizeof(export));
+      export.clients.num_clients = 1 + random() % EXPORTS_NB_MAX_CLIENTS;
+      for(i = 0; i < export.clients.num_clients; i++)
+        random_entry(&export.clients.clientarray[i]);
+
+      if(nfs_export_access_compile(&export) != 0)
+        {
+          LogTest("ERROR: could not compile client list %u", l);
+          exit(1);
+        }
+
+      for(a = 0; a < NB_ADDRS; a++)
+        {
+          make_addr(&hostaddr, ipstring, random_addr());
+
+          for(o = 0; o < NB_OPTIONS; o++)
+            {
+              index_walk = export_client_match_index(&hostaddr, ipstring, &export.clients,
+                                                     NULL, test_options[o]);
+              index_compiled = export_client_match_index(&hostaddr, ipstring,
+                                                         &export.clients,
+                                                         export.access_matcher,
+                                                         test_options[o]);
+              if(index_walk != index_compiled)
+                {
+                  LogTest("ERROR: list %u, address %s, option %x: walk found %d, compiled list %d",
+                          l, ipstring, test_options[o], index_walk, index_compiled);
+                  rc = 1;
+                }
+            }
+        }
+
+      nfs_export_access_free(&export);
+    }
+
+  if(rc == 0)
+    LogTest("OK: compiled lists agree with the walk on %u lists", NB_LISTS);
+
+  /* Timed lookups in a list of hosts and networks ending with the client */
+  memset(&export, 0, sizeof(export));
+  export.clients.num_clients = EXPORTS_NB_MAX_CLIENTS;
+  for(i = 0; i < EXPORTS_NB_MAX_CLIENTS; i++)
+    {
+      export.clients.clientarray[i].options = EXPORT_OPTION_READ_ACCESS;
+      if(i & 1)
+        {
+          export.clients.clientarray[i].type = NETWORK_CLIENT;
+          export.clients.clientarray[i].client.network.netaddr = 0xAC100000U | (i << 8);
+          export.clients.clientarray[i].client.network.netmask = 0xFFFFFF00U;
+        }
+      else
+        {
+          export.clients.clientarray[i].type = HOSTIF_CLIENT;
+          export.clients.clientarray[i].client.hostif.clientaddr = 0xC0A80000U | i;
+        }
+    }
+  addr = 0xC0A80000U | (EXPORTS_NB_MAX_CLIENTS - 2);
+  nfs_export_access_compile(&export);
+  make_addr(&hostaddr, ipstring, addr);
+
+  MesureTemps(&debut, NULL);
+  for(i = 0; i < nb_loops; i++)
+    export_client_match_index(&hostaddr, ipstring, &export.clients, NULL,
+                              EXPORT_OPTION_READ_ACCESS);
+  MesureTemps(&fin, &debut);
+  secs_walk = fin.secondes + fin.micro_secondes / 1000000.0;
+
+  MesureTemps(&debut, NULL);
+  for(i = 0; i < nb_loops; i++)
+    export_client_match_index(&hostaddr, ipstring, &export.clients,
+                              export.access_matcher, EXPORT_OPTION_READ_ACCESS);
+  MesureTemps(&fin, &debut);
+  secs_compiled = fin.secondes + fin.micro_secondes / 1000000.0;
+
+  LogTest("%u entries: walk %.0f ns/lookup, compiled list %.0f ns/lookup",
+          EXPORTS_NB_MAX_CLIENTS,
+          nb_loops ? secs_walk * 1e9 / nb_loops : 0.0,
+          nb_loops ? secs_compiled * 1e9 / nb_loops : 0.0);
+
+  /* Verdict cache */
+  if(nfs_export_access_cache_get(&export, addr, 0, &verdict, &index, &access_type))
+    {
+      LogTest("ERROR: verdict found in an empty cache");
+      rc = 1;
+    }
+
+  nfs_export_access_cache_set(&export, addr, 0, EXPORT_PERMISSION_GRANTED,
+                              EXPORTS_NB_MAX_CLIENTS - 2, ACCESSTYPE_RW);
+
+  if(!nfs_export_access_cache_get(&export, addr, 0, &verdict, &index, &access_type)
+     || verdict != EXPORT_PERMISSION_GRANTED || index != EXPORTS_NB_MAX_CLIENTS - 2
+     || access_type != ACCESSTYPE_RW)
+    {
+      LogTest("ERROR: cached verdict not found");
+      rc = 1;
+    }
+
+  if(nfs_export_access_cache_get(&export, addr, EXPORT_ACCESS_CACHE_WRITE,
+                                 &verdict, &index, &access_type))
+    {
+      LogTest("ERROR: verdict found for other flags");
+      rc = 1;
+    }
+
+  nfs_export_access_free(&export);
+
+  if(rc == 0)
+    LogTest("OK: verdict cache");
+
+  exit(rc);
+}                               /* main */
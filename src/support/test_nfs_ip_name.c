@@ -46,6 +46,11 @@ void *rpc_tcp_socket_manager_thread(void *Arg)
   return NULL;
 }
 
+int rpc_tcp_reactor_register(int tcp_sock)
+{
+  return 0;
+}
+
 void create_ipv4(char * ip, int port, struct sockaddr_in * addr) 
 {
     memset(addr, 0, sizeof(struct sockaddr_in));